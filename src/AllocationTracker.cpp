@@ -0,0 +1,387 @@
+#include "stdafx.h"
+#include "AllocationTracker.h"
+#include "Platform.h"
+
+// ImGui.
+#ifndef PORTABLE_CORE
+#include "imgui.h"
+#endif
+
+// Limits of the fixed size bookkeeping. Nothing in here may allocate.
+static const unsigned int MAX_SCOPES = 32;
+static const unsigned int MAX_STACKS = 4;
+static const unsigned int MAX_STACK_DEPTH = 16;
+
+/// <summary>
+/// Allocations of a single scope within the current frame.
+/// </summary>
+struct ScopeStats {
+    const char* name;
+    UINT64 allocCount;
+    UINT64 allocBytes;
+};
+
+/// <summary>
+/// Captured call stack of a single allocation.
+/// </summary>
+struct CapturedStack {
+    size_t size;
+    unsigned int depth;
+    void* frames[MAX_STACK_DEPTH];
+};
+
+/// <summary>
+/// State of the tracker. Counters are atomics since any thread can allocate. Scope
+/// and stack data is only written by the render thread.
+/// </summary>
+struct AllocationTrackerState {
+    std::atomic<bool> enabled{ true };
+    std::atomic<UINT64> allocCount{ 0 };
+    std::atomic<UINT64> allocBytes{ 0 };
+    std::atomic<UINT64> freeCount{ 0 };
+    std::atomic<UINT64> otherThreadAllocCount{ 0 };
+    std::atomic<std::thread::id> renderThreadId{};
+
+    UINT64 frameIdx = 0;
+    unsigned int framesSinceReset = 0;
+    unsigned int warmUpFrames = 60;
+    bool assertOnAllocation = false;
+    bool captureStacks = false;
+    UINT64 violationFrames = 0;
+    AllocationTracker::FrameStats lastFrame;
+
+    ScopeStats scopes[MAX_SCOPES];
+    unsigned int scopeCount = 0;
+    CapturedStack stacks[MAX_STACKS];
+    unsigned int stackCount = 0;
+};
+
+// Zero-initialized (tracking disabled) until its constructor ran, so allocations
+// during static initialization are harmless.
+static AllocationTrackerState g_state;
+
+// Innermost scope of the current thread.
+static thread_local const char* t_scopeName = nullptr;
+
+
+/*
+ * AllocationTracker::Scope::Scope
+ */
+AllocationTracker::Scope::Scope(const char* name) {
+    m_previousName = t_scopeName;
+    t_scopeName = name;
+}
+
+
+/*
+ * AllocationTracker::Scope::~Scope
+ */
+AllocationTracker::Scope::~Scope() {
+    t_scopeName = m_previousName;
+}
+
+
+/*
+ * AllocationTracker::BeginFrame
+ */
+void AllocationTracker::BeginFrame() {
+    g_state.renderThreadId = std::this_thread::get_id();
+    g_state.allocCount = 0;
+    g_state.allocBytes = 0;
+    g_state.freeCount = 0;
+    g_state.otherThreadAllocCount = 0;
+    g_state.scopeCount = 0;
+    g_state.stackCount = 0;
+}
+
+
+/*
+ * AllocationTracker::EndFrame
+ */
+void AllocationTracker::EndFrame() {
+    FrameStats stats;
+    stats.frameIdx = g_state.frameIdx;
+    stats.allocCount = g_state.allocCount;
+    stats.allocBytes = g_state.allocBytes;
+    stats.freeCount = g_state.freeCount;
+    stats.otherThreadAllocCount = g_state.otherThreadAllocCount;
+    g_state.lastFrame = stats;
+    g_state.frameIdx++;
+
+    // Allocations during warm-up are fine (caches, ImGui, first uploads, ...).
+    if (g_state.framesSinceReset < g_state.warmUpFrames) {
+        g_state.framesSinceReset++;
+        return;
+    }
+
+    if (stats.allocCount > 0) {
+        g_state.violationFrames++;
+        report(stats);
+        assert(!g_state.assertOnAllocation && "Allocation in steady-state frame.");
+    }
+}
+
+
+/*
+ * AllocationTracker::SetEnabled
+ */
+void AllocationTracker::SetEnabled(bool enabled) {
+    g_state.enabled = enabled;
+}
+
+
+/*
+ * AllocationTracker::SetWarmUpFrames
+ */
+void AllocationTracker::SetWarmUpFrames(unsigned int frameCnt) {
+    g_state.warmUpFrames = frameCnt;
+}
+
+
+/*
+ * AllocationTracker::SetAssertOnAllocation
+ */
+void AllocationTracker::SetAssertOnAllocation(bool assertOnAllocation) {
+    g_state.assertOnAllocation = assertOnAllocation;
+}
+
+
+/*
+ * AllocationTracker::SetCaptureStacks
+ */
+void AllocationTracker::SetCaptureStacks(bool captureStacks) {
+    // The first capture may load the unwinder, which allocates. Do it now, outside
+    // of the operator new hook.
+    if (captureStacks) {
+        void* frame;
+        Platform::CaptureStack(0, 1, &frame);
+    }
+    g_state.captureStacks = captureStacks;
+}
+
+
+/*
+ * AllocationTracker::Reset
+ */
+void AllocationTracker::Reset() {
+    g_state.framesSinceReset = 0;
+}
+
+
+/*
+ * AllocationTracker::GetLastFrameStats
+ */
+AllocationTracker::FrameStats AllocationTracker::GetLastFrameStats() {
+    return g_state.lastFrame;
+}
+
+
+/*
+ * AllocationTracker::GetViolationFrameCount
+ */
+UINT64 AllocationTracker::GetViolationFrameCount() {
+    return g_state.violationFrames;
+}
+
+
+/*
+ * AllocationTracker::DefineImGui
+ */
+#ifndef PORTABLE_CORE
+void AllocationTracker::DefineImGui() {
+#if TRACK_ALLOCATIONS
+    bool enabled = g_state.enabled;
+    if (ImGui::Checkbox("Track Allocations", &enabled)) {
+        SetEnabled(enabled);
+        Reset();
+    }
+    if (!enabled) {
+        return;
+    }
+
+    ImGui::Text("Allocations: %llu (%llu bytes), other threads: %llu",
+        g_state.lastFrame.allocCount, g_state.lastFrame.allocBytes,
+        g_state.lastFrame.otherThreadAllocCount);
+    if (g_state.framesSinceReset < g_state.warmUpFrames) {
+        ImGui::Text("Warm-up: %u/%u frames", g_state.framesSinceReset,
+            g_state.warmUpFrames);
+    } else {
+        ImGui::Text("Allocating frames: %llu", g_state.violationFrames);
+    }
+    ImGui::Checkbox("Assert on allocation", &g_state.assertOnAllocation);
+    ImGui::SameLine();
+    ImGui::Checkbox("Capture stacks", &g_state.captureStacks);
+#else
+    ImGui::TextDisabled("Allocation tracking is compiled out (TRACK_ALLOCATIONS).");
+#endif
+}
+#endif
+
+
+/*
+ * AllocationTracker::OnAllocation
+ */
+void AllocationTracker::OnAllocation(size_t size) {
+    if (!g_state.enabled) {
+        return;
+    }
+
+    // Only the render thread counts towards the frame. Loading and worker threads
+    // are allowed to allocate.
+    if (std::this_thread::get_id() != g_state.renderThreadId) {
+        g_state.otherThreadAllocCount++;
+        return;
+    }
+    g_state.allocCount++;
+    g_state.allocBytes += size;
+
+    // Attribute to the innermost scope. Lookup by pointer, since names are
+    // string literals.
+    const char* name = t_scopeName ? t_scopeName : "(no scope)";
+    unsigned int scopeIdx = 0;
+    while (scopeIdx < g_state.scopeCount && g_state.scopes[scopeIdx].name != name) {
+        scopeIdx++;
+    }
+    if (scopeIdx < MAX_SCOPES) {
+        if (scopeIdx == g_state.scopeCount) {
+            g_state.scopes[scopeIdx] = { name, 0, 0 };
+            g_state.scopeCount++;
+        }
+        g_state.scopes[scopeIdx].allocCount++;
+        g_state.scopes[scopeIdx].allocBytes += size;
+    }
+
+    // Capture call stack of the first few allocations. Skip this function and the
+    // operator new hook.
+    if (g_state.captureStacks && g_state.stackCount < MAX_STACKS
+            && g_state.framesSinceReset >= g_state.warmUpFrames) {
+        CapturedStack& stack = g_state.stacks[g_state.stackCount++];
+        stack.size = size;
+        stack.depth = Platform::CaptureStack(2, MAX_STACK_DEPTH, stack.frames);
+    }
+}
+
+
+/*
+ * AllocationTracker::OnFree
+ */
+void AllocationTracker::OnFree() {
+    if (!g_state.enabled || std::this_thread::get_id() != g_state.renderThreadId) {
+        return;
+    }
+    g_state.freeCount++;
+}
+
+
+/*
+ * AllocationTracker::report
+ */
+void AllocationTracker::report(const FrameStats& stats) {
+    // snprintf into stack buffers, so reporting itself does not allocate.
+    char line[256];
+    snprintf(line, sizeof(line),
+        "AllocationTracker: frame %llu allocated %llu times (%llu bytes), %llu frees.\n",
+        static_cast<unsigned long long>(stats.frameIdx),
+        static_cast<unsigned long long>(stats.allocCount),
+        static_cast<unsigned long long>(stats.allocBytes),
+        static_cast<unsigned long long>(stats.freeCount));
+    OutputDebugStringA(line);
+
+    for (unsigned int i = 0; i < g_state.scopeCount; i++) {
+        snprintf(line, sizeof(line), "    %-32s %6llu allocs %10llu bytes\n",
+            g_state.scopes[i].name,
+            static_cast<unsigned long long>(g_state.scopes[i].allocCount),
+            static_cast<unsigned long long>(g_state.scopes[i].allocBytes));
+        OutputDebugStringA(line);
+    }
+
+    // Raw return addresses. Can be resolved in the debugger (Go To Disassembly).
+    for (unsigned int i = 0; i < g_state.stackCount; i++) {
+        const CapturedStack& stack = g_state.stacks[i];
+        snprintf(line, sizeof(line), "    Stack of allocation %u (%zu bytes):\n", i,
+            stack.size);
+        OutputDebugStringA(line);
+        for (unsigned int frame = 0; frame < stack.depth; frame++) {
+            snprintf(line, sizeof(line), "        0x%p\n", stack.frames[frame]);
+            OutputDebugStringA(line);
+        }
+    }
+}
+
+
+#if TRACK_ALLOCATIONS
+// Global operator new/delete replacements. Based on the required signatures from
+// https://en.cppreference.com/w/cpp/memory/new/operator_new
+void* operator new(size_t size) {
+    AllocationTracker::OnAllocation(size);
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    AllocationTracker::OnAllocation(size);
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    AllocationTracker::OnAllocation(size);
+    void* ptr = Platform::AlignedAlloc(size, static_cast<size_t>(alignment));
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+    if (ptr) {
+        AllocationTracker::OnFree();
+        free(ptr);
+    }
+}
+
+void operator delete[](void* ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    if (ptr) {
+        AllocationTracker::OnFree();
+        Platform::AlignedFree(ptr);
+    }
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept {
+    operator delete(ptr, alignment);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t alignment) noexcept {
+    operator delete(ptr, alignment);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t alignment) noexcept {
+    operator delete(ptr, alignment);
+}
+#endif
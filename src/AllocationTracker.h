@@ -0,0 +1,122 @@
+#pragma once
+
+// Replaces the global operator new/delete with counting versions. On in debug
+// builds only, so release builds keep the allocator of the CRT. Define as 1 or 0
+// in the project settings to override.
+#ifndef TRACK_ALLOCATIONS
+#ifdef _DEBUG
+#define TRACK_ALLOCATIONS 1
+#else
+#define TRACK_ALLOCATIONS 0
+#endif
+#endif
+
+/// <summary>
+/// Counts heap allocations per frame, in order to keep the render loop free of
+/// allocations once it reached a steady state.
+/// </summary>
+/// <remarks>
+/// The global operator new/delete are replaced in AllocationTracker.cpp. All
+/// bookkeeping inside of the hooks uses atomics and fixed size arrays, so the
+/// tracker itself never allocates. Only allocations of the render thread count
+/// towards a frame; they are attributed to the innermost AllocationTracker::Scope.
+/// Other threads are merely counted. Every render thread allocation of a frame after
+/// the warm-up phase gets reported (and optionally asserted).
+/// </remarks>
+class AllocationTracker {
+public:
+    /// <summary>
+    /// Allocation counts of a single frame.
+    /// </summary>
+    struct FrameStats {
+        UINT64 frameIdx = 0;
+        UINT64 allocCount = 0;
+        UINT64 allocBytes = 0;
+        UINT64 freeCount = 0;
+        UINT64 otherThreadAllocCount = 0;   // Not counted in allocCount.
+    };
+
+    /// <summary>
+    /// Attributes all allocations of the current thread to a named scope while the
+    /// object is alive. The name has to be a string literal.
+    /// </summary>
+    class Scope {
+    public:
+        Scope(const char* name);
+        ~Scope();
+    private:
+        const char* m_previousName;
+    };
+
+    /// <summary>
+    /// Marks the beginning of a frame. The calling thread is treated as the render
+    /// thread for counting, scope attribution and call stack capturing.
+    /// </summary>
+    static void BeginFrame();
+
+    /// <summary>
+    /// Marks the end of a frame. Reports the allocations of the frame, if it is past
+    /// the warm-up phase.
+    /// </summary>
+    static void EndFrame();
+
+    /// <summary>
+    /// Enables or disables counting. Counting is enabled by default.
+    /// </summary>
+    static void SetEnabled(bool enabled);
+
+    /// <summary>
+    /// Number of frames after start-up (and after Reset()) in which allocations are
+    /// expected and therefore ignored.
+    /// </summary>
+    static void SetWarmUpFrames(unsigned int frameCnt);
+
+    /// <summary>
+    /// If true, a frame past warm-up that allocates triggers an assert.
+    /// </summary>
+    static void SetAssertOnAllocation(bool assertOnAllocation);
+
+    /// <summary>
+    /// If true, the call stacks of the first allocations of the render thread are
+    /// captured and printed in the report.
+    /// </summary>
+    static void SetCaptureStacks(bool captureStacks);
+
+    /// <summary>
+    /// Restarts the warm-up phase. Should be called after events that are allowed
+    /// to allocate (scene change, resize, ...).
+    /// </summary>
+    static void Reset();
+
+    /// <summary>
+    /// Returns the counts of the last completed frame.
+    /// </summary>
+    static FrameStats GetLastFrameStats();
+
+    /// <summary>
+    /// Returns the number of frames past warm-up that allocated.
+    /// </summary>
+    static UINT64 GetViolationFrameCount();
+
+    /// <summary>
+    /// Defines ImGui elements with the allocation counts. Has to be called inside of
+    /// an ImGui window.
+    /// </summary>
+    static void DefineImGui();
+
+    /// <summary>
+    /// Called by the operator new hooks.
+    /// </summary>
+    static void OnAllocation(size_t size);
+
+    /// <summary>
+    /// Called by the operator delete hooks.
+    /// </summary>
+    static void OnFree();
+
+private:
+    /// <summary>
+    /// Writes the allocations of the frame that just ended to the debug output.
+    /// </summary>
+    static void report(const FrameStats& stats);
+};
@@ -0,0 +1,1153 @@
+#include "stdafx.h"
+#include "Benchmark.h"
+#include "SceneMath.h"
+#include "MeshGeometry.h"
+#include "TransformSystem.h"
+#include "Platform.h"
+#include "SceneGraph.h"
+#include "Bvh.h"
+#include "OcclusionCuller.h"
+#include "HiZCuller.h"
+#include "TiledLightCuller.h"
+#include "ClusteredLightCuller.h"
+#include "LightBvh.h"
+#include "LightLod.h"
+#include "LightPool.h"
+#include "LightAnimation.h"
+#include "Pvs.h"
+#include "MeshChunker.h"
+#include "RenderStats.h"
+
+// The assimp conversion only exists in the application.
+#ifndef PORTABLE_CORE
+#include "ModelClass.h"
+#endif
+
+// Results of every kernel are accumulated in here, so the compiler can not drop the
+// work as dead code.
+static volatile float g_sink = 0.0f;
+
+#ifndef PORTABLE_CORE
+/// <summary>
+/// Creates an assimp mesh similar to what the OBJ importer produces (triangles,
+/// normals, one UV channel, tangents and bitangents).
+/// </summary>
+/// <param name="vertexCnt">Number of vertices. Rounded down to a multiple of 3.
+/// </param>
+/// <returns>The mesh. Owns all its arrays.</returns>
+static std::unique_ptr<aiMesh> createSyntheticMesh(unsigned int vertexCnt) {
+    vertexCnt -= vertexCnt % 3;
+    std::unique_ptr<aiMesh> mesh = std::make_unique<aiMesh>();
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mNumVertices = vertexCnt;
+    mesh->mVertices = new aiVector3D[vertexCnt];
+    mesh->mNormals = new aiVector3D[vertexCnt];
+    mesh->mTangents = new aiVector3D[vertexCnt];
+    mesh->mBitangents = new aiVector3D[vertexCnt];
+    mesh->mTextureCoords[0] = new aiVector3D[vertexCnt];
+    mesh->mNumUVComponents[0] = 2;
+
+    std::default_random_engine generator(42);
+    std::uniform_real_distribution<float> randomFloats(-1.0f, 1.0f);
+    for (unsigned int i = 0; i < vertexCnt; i++) {
+        mesh->mVertices[i] = aiVector3D(randomFloats(generator),
+            randomFloats(generator), randomFloats(generator));
+        mesh->mNormals[i] = aiVector3D(0.0f, 1.0f, 0.0f);
+        mesh->mTangents[i] = aiVector3D(1.0f, 0.0f, 0.0f);
+        mesh->mBitangents[i] = aiVector3D(0.0f, 0.0f, 1.0f);
+        mesh->mTextureCoords[0][i] = aiVector3D(randomFloats(generator),
+            randomFloats(generator), 0.0f);
+    }
+
+    mesh->mNumFaces = vertexCnt / 3;
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+        mesh->mFaces[i].mNumIndices = 3;
+        mesh->mFaces[i].mIndices = new unsigned int[3] { 3 * i, 3 * i + 1, 3 * i + 2 };
+    }
+
+    return mesh;
+}
+#endif
+
+
+/// <summary>
+/// Appends the 12 triangles of a box to an occluder mesh.
+/// </summary>
+static void addOccluderBox(const sm::Vector3& boxMin, const sm::Vector3& boxMax,
+        std::vector<sm::Vector3>& positions, std::vector<UINT32>& indices) {
+    UINT32 first = static_cast<UINT32>(positions.size());
+    for (UINT32 i = 0; i < 8; i++) {
+        positions.push_back(sm::Vector3((i & 1) ? boxMax.x : boxMin.x,
+            (i & 2) ? boxMax.y : boxMin.y, (i & 4) ? boxMax.z : boxMin.z));
+    }
+    const std::array<UINT32, 36> boxIndices = {
+        0, 1, 3, 0, 3, 2,   4, 6, 7, 4, 7, 5,   0, 4, 5, 0, 5, 1,
+        2, 3, 7, 2, 7, 6,   0, 2, 6, 0, 6, 4,   1, 5, 7, 1, 7, 3 };
+    for (UINT32 index : boxIndices) {
+        indices.push_back(first + index);
+    }
+}
+
+
+/*
+ * Benchmark::RunCommand
+ */
+int Benchmark::RunCommand(const std::vector<std::string>& arguments) {
+    std::filesystem::path directory = std::filesystem::current_path();
+    if (!arguments.empty() && arguments[0] == "--benchmark") {
+        std::vector<Result> results = RunAll();
+        Report(results);
+        BenchmarkStore::Save(CreateResultSet(results), arguments.size() > 1 ?
+            arguments[1] : (directory / "benchmark_results.json").string());
+        return 0;
+    }
+    if (!arguments.empty() && arguments[0] == "--benchmark-compare") {
+        if (arguments.size() < 3) {
+            throw std::invalid_argument(
+                "Usage: --benchmark-compare <base.json> <current.json> [report.txt]");
+        }
+        BenchmarkStore::ResultSet base = BenchmarkStore::Load(arguments[1]);
+        BenchmarkStore::ResultSet current = BenchmarkStore::Load(arguments[2]);
+        std::vector<BenchmarkStore::Comparison> comparisons =
+            BenchmarkStore::Compare(base, current);
+        BenchmarkStore::WriteComparison(base, current, comparisons,
+            arguments.size() > 3 ? arguments[3] :
+            (directory / "benchmark_comparison.txt").string());
+        for (const BenchmarkStore::Comparison& comparison : comparisons) {
+            if (comparison.verdict == BenchmarkStore::Verdict::REGRESSION) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+    throw std::invalid_argument(
+        "Usage: --benchmark [output.json] | --benchmark-compare <base.json> "
+        "<current.json> [report.txt]");
+}
+
+
+/*
+ * Benchmark::RunAll
+ */
+std::vector<Benchmark::Result> Benchmark::RunAll(unsigned int repetitions) {
+    std::vector<Result> results;
+    std::default_random_engine generator(42);
+    std::uniform_real_distribution<float> randomFloats(-1.0f, 1.0f);
+
+    // Realistic: Sponza today. Stress: what a large scene could throw at us.
+    const std::array<std::pair<const char*, unsigned int>, 2> matrixSizes = {
+        std::make_pair("realistic", 1000u), std::make_pair("stress", 1000000u) };
+    const std::array<std::pair<const char*, unsigned int>, 2> modelSizes = {
+        std::make_pair("realistic", 1000u), std::make_pair("stress", 100000u) };
+    const std::array<std::pair<const char*, unsigned int>, 2> lightSizes = {
+        std::make_pair("realistic", 32u), std::make_pair("stress", 100000u) };
+    const std::array<std::pair<const char*, unsigned int>, 2> kernelSizes = {
+        std::make_pair("realistic", 64u), std::make_pair("stress", 65536u) };
+    const std::array<std::pair<const char*, unsigned int>, 2> vertexSizes = {
+        std::make_pair("realistic", 30000u), std::make_pair("stress", 3000000u) };
+    const std::array<std::pair<const char*, std::pair<UINT32, UINT32>>, 2> depthSizes = {
+        std::make_pair("realistic", std::make_pair(480u, 270u)),
+        std::make_pair("stress", std::make_pair(960u, 540u)) };
+    const std::array<std::pair<const char*, unsigned int>, 2> tiledLightSizes = {
+        std::make_pair("realistic", 1024u), std::make_pair("stress", 65536u) };
+    const std::array<std::pair<const char*, unsigned int>, 2> clusteredLightSizes = {
+        std::make_pair("realistic", 1024u), std::make_pair("stress", 100000u) };
+    const std::array<std::pair<const char*, unsigned int>, 2> animatedLightSizes = {
+        std::make_pair("realistic", 1024u), std::make_pair("stress", 262144u) };
+    const std::array<std::pair<const char*, unsigned int>, 2> pvsSizes = {
+        std::make_pair("realistic", 1000u), std::make_pair("stress", 10000u) };
+    const std::array<std::pair<const char*, int>, 2> sphereRes = {
+        std::make_pair("realistic", 64), std::make_pair("stress", 1024) };
+    const std::array<std::pair<const char*, int>, 2> torusRes = {
+        std::make_pair("realistic", 64), std::make_pair("stress", 1024) };
+
+    // Camera set-up of Sponza.
+    sm::Matrix projMat = sm::Matrix::CreatePerspectiveFieldOfView(dx::XM_PI / 4.0f,
+        1400.0f / 800.0f, 3.0f, 300.0f);
+    sm::Vector3 lightPos = sm::Vector3(0.0f, 200.0f, 0.0f);
+    dx::BoundingBox sponzaBounds(sm::Vector3::Zero, sm::Vector3(150.0f, 60.0f, 80.0f));
+
+    // Shadow frustum fitting. One call per view matrix (camera position).
+    for (const auto& size : matrixSizes) {
+        unsigned int count = size.second / 10;
+        std::vector<sm::Matrix> viewMats(count);
+        for (sm::Matrix& viewMat : viewMats) {
+            sm::Vector3 pos(100.0f * randomFloats(generator), 10.0f,
+                50.0f * randomFloats(generator));
+            sm::Vector3 target = pos + sm::Vector3(randomFloats(generator), 0.1f,
+                randomFloats(generator));
+            viewMat = sm::Matrix::CreateLookAt(pos, target, sm::Vector3::Up);
+        }
+        results.push_back(measure("ComputeShadowMatrices", size.first, count,
+                repetitions, [&]() {
+            sm::Matrix lightViewMat;
+            sm::Matrix lightProjMat;
+            float sum = 0.0f;
+            for (const sm::Matrix& viewMat : viewMats) {
+                SceneMath::ComputeShadowMatrices(viewMat, projMat, lightPos, 300.0f,
+                    sponzaBounds, lightViewMat, lightProjMat);
+                sum += lightProjMat._11;
+            }
+            g_sink = g_sink + sum;
+        }));
+    }
+
+    // Model matrix composition and normal matrix.
+    for (const auto& size : matrixSizes) {
+        unsigned int count = size.second;
+        std::vector<ModelState> states(count);
+        for (ModelState& state : states) {
+            state = ModelState(1.0f + randomFloats(generator),
+                sm::Vector3(randomFloats(generator), randomFloats(generator),
+                    randomFloats(generator)) * 100.0f,
+                sm::Vector4(randomFloats(generator), randomFloats(generator),
+                    randomFloats(generator), 1.0f));
+        }
+        std::vector<sm::Matrix> modelMats(count);
+        std::vector<sm::Matrix> normalMats(count);
+        sm::Matrix viewMat = sm::Matrix::CreateLookAt(sm::Vector3(70.0f, 4.0f, 1.0f),
+            sm::Vector3::Zero, sm::Vector3::Up);
+
+        results.push_back(measure("ComputeModelMatrix", size.first, count,
+                repetitions, [&]() {
+            for (unsigned int i = 0; i < count; i++) {
+                modelMats[i] = TransformSystem::ComputeModelMatrix(states[i]);
+            }
+            g_sink = g_sink + modelMats[count - 1]._11;
+        }));
+
+        results.push_back(measure("ComputeNormalMatrix", size.first, count,
+                repetitions, [&]() {
+            for (unsigned int i = 0; i < count; i++) {
+                normalMats[i] = TransformSystem::ComputeNormalMatrix(modelMats[i], viewMat);
+            }
+            g_sink = g_sink + normalMats[count - 1]._11;
+        }));
+
+        results.push_back(measure("ComputeNormalMatrixReference", size.first, count,
+                repetitions, [&]() {
+            for (unsigned int i = 0; i < count; i++) {
+                normalMats[i] = TransformSystem::ComputeNormalMatrixReference(modelMats[i],
+                    viewMat);
+            }
+            g_sink = g_sink + normalMats[count - 1]._11;
+        }));
+    }
+
+    // Batched transform updates (TransformSystem::Update). A moving camera makes all
+    // transforms dirty. Items per second are the transform throughput.
+    for (const auto& size : modelSizes) {
+        unsigned int count = size.second;
+        TransformSystem transforms;
+        for (unsigned int i = 0; i < count; i++) {
+            transforms.Create(ModelState(1.0f + randomFloats(generator),
+                sm::Vector3(randomFloats(generator), randomFloats(generator),
+                    randomFloats(generator)) * 100.0f,
+                sm::Vector4(randomFloats(generator), randomFloats(generator),
+                    randomFloats(generator), 1.0f)));
+        }
+        float cameraX = 70.0f;
+        auto moveCamera = [&]() {
+            cameraX += 0.01f;
+            transforms.SetViewMatrix(sm::Matrix::CreateLookAt(
+                sm::Vector3(cameraX, 4.0f, 1.0f), sm::Vector3::Zero, sm::Vector3::Up));
+        };
+
+        transforms.SetUseAvx2(false);
+        results.push_back(measure("TransformUpdateScalar", size.first, count,
+                repetitions, [&]() {
+            moveCamera();
+            transforms.Update();
+        }));
+
+        if (Platform::IsAvx2Supported()) {
+            transforms.SetUseAvx2(true);
+            results.push_back(measure("TransformUpdateAvx2", size.first, count,
+                    repetitions, [&]() {
+                moveCamera();
+                transforms.Update();
+            }));
+        }
+
+        // Nothing changed: has to be (almost) free.
+        results.push_back(measure("TransformUpdateStatic", size.first, count,
+                repetitions, [&]() {
+            transforms.Update();
+        }));
+    }
+
+    // Scene graph propagation. Deep: a single chain. Wide: one root with all other
+    // nodes as children. Full updates recompute every node, incremental updates move
+    // 1% of the nodes.
+    for (const auto& size : modelSizes) {
+        unsigned int count = size.second;
+        for (int shape = 0; shape < 2; shape++) {
+            bool deep = shape == 0;
+            SceneGraph graph;
+            for (unsigned int i = 0; i < count; i++) {
+                UINT32 parent = i == 0 ? SceneGraph::NO_PARENT : (deep ? i - 1 : 0);
+                UINT32 node = graph.AddNode(parent, sm::Matrix::CreateTranslation(
+                    randomFloats(generator), randomFloats(generator),
+                    randomFloats(generator)), "");
+                graph.SetLocalBounds(node, dx::BoundingBox(sm::Vector3::Zero,
+                    sm::Vector3(0.5f, 0.5f, 0.5f)));
+            }
+            graph.Update();
+
+            std::string shapeName = deep ? "Deep" : "Wide";
+            float angle = 0.0f;
+            results.push_back(measure("SceneGraphFull" + shapeName, size.first, count,
+                    repetitions, [&]() {
+                angle += 0.01f;
+                graph.SetLocalMatrix(0, sm::Matrix::CreateRotationY(angle));
+                graph.Update();
+                g_sink = g_sink + graph.GetWorldMatrix(count - 1)._41;
+            }));
+
+            std::uniform_int_distribution<unsigned int> randomNodes(0, count - 1);
+            unsigned int dirtyCnt = std::max(1u, count / 100);
+            std::vector<UINT32> dirtyNodes(dirtyCnt);
+            results.push_back(measure("SceneGraphIncremental" + shapeName, size.first,
+                    count, repetitions, [&]() {
+                angle += 0.01f;
+                for (UINT32& node : dirtyNodes) {
+                    node = randomNodes(generator);
+                    graph.SetLocalMatrix(node, sm::Matrix::CreateRotationY(angle));
+                }
+                graph.Update();
+                g_sink = g_sink + float(graph.GetLastUpdateCount());
+            }));
+        }
+    }
+
+    // Frustum culling of boxes spread over the Sponza volume. Roughly a third is
+    // visible from the camera. Flat (SIMD) and hierarchical (BVH).
+    for (const auto& size : matrixSizes) {
+        unsigned int count = size.second;
+        std::vector<dx::BoundingBox> boxes(count);
+        FrustumCuller culler;
+        for (dx::BoundingBox& box : boxes) {
+            box = dx::BoundingBox(sm::Vector3(randomFloats(generator) * 150.0f,
+                randomFloats(generator) * 60.0f, randomFloats(generator) * 80.0f),
+                sm::Vector3(1.0f + randomFloats(generator) * 0.5f));
+            culler.AddBox(box);
+        }
+        sm::Matrix viewProj = sm::Matrix::CreateLookAt(sm::Vector3(0.0f, 4.0f, -6.0f),
+            sm::Vector3(100.0f, 4.0f, -6.0f), sm::Vector3::Up) * projMat;
+        FrustumCuller::Planes planes = FrustumCuller::ExtractPlanes(viewProj);
+        std::vector<UINT32> visible;
+        visible.reserve(count);
+
+        // Contribution culling at 1080p: boxes below 4 pixels are dropped.
+        FrustumCuller::Contribution contribution = FrustumCuller::ComputeContribution(
+            viewProj, 1920.0f, 1080.0f, 4.0f);
+
+        const std::array<std::pair<const char*, FrustumCuller::Path>, 3> paths = {
+            std::make_pair("FrustumCullScalar", FrustumCuller::Path::SCALAR),
+            std::make_pair("FrustumCullSse", FrustumCuller::Path::SSE),
+            std::make_pair("FrustumCullAvx", FrustumCuller::Path::AVX) };
+        for (const auto& path : paths) {
+            culler.SetPath(path.second);
+            if (culler.GetPath() != path.second) {
+                continue;   // Not supported by this CPU.
+            }
+            results.push_back(measure(path.first, size.first, count, repetitions,
+                    [&]() {
+                culler.Cull(planes, visible);
+                g_sink = g_sink + float(visible.size());
+            }));
+            results.push_back(measure(std::string(path.first) + "Contribution",
+                    size.first, count, repetitions, [&]() {
+                culler.Cull(planes, contribution, visible);
+                g_sink = g_sink + float(visible.size());
+            }));
+        }
+
+        Bvh bvh;
+        results.push_back(measure("BvhBuild", size.first, count, repetitions, [&]() {
+            bvh.Build(boxes);
+            g_sink = g_sink + float(bvh.GetNodeCount());
+        }));
+        results.push_back(measure("BvhCull", size.first, count, repetitions, [&]() {
+            bvh.Cull(planes, visible);
+            g_sink = g_sink + float(visible.size());
+        }));
+
+        // 1% of the boxes move (e.g. a few animated models), the rest stays.
+        std::uniform_int_distribution<unsigned int> randomBoxes(0, count - 1);
+        unsigned int movingCnt = std::max(1u, count / 100);
+        results.push_back(measure("BvhRefit", size.first, count, repetitions, [&]() {
+            for (unsigned int i = 0; i < movingCnt; i++) {
+                UINT32 box = randomBoxes(generator);
+                boxes[box].Center.y += randomFloats(generator) * 0.1f;
+                bvh.SetPrimitiveBounds(box, boxes[box]);
+            }
+            bvh.Refit();
+            g_sink = g_sink + bvh.GetBounds().Center.y;
+        }));
+    }
+
+    // Occlusion culling on a Sponza-like layout: an atrium with rows of pillars, an
+    // arcade behind them and outer walls. Occludees are spread over the whole
+    // volume. The camera walks a fixed path through the atrium.
+    {
+        std::vector<sm::Vector3> positions;
+        std::vector<UINT32> indices;
+        for (float z : { -20.0f, 20.0f }) {
+            for (float x = -110.0f; x <= 110.0f; x += 20.0f) {
+                addOccluderBox(sm::Vector3(x - 2.0f, -60.0f, z - 2.0f),
+                    sm::Vector3(x + 2.0f, 60.0f, z + 2.0f), positions, indices);
+            }
+            // Floor of the gallery above the arcade.
+            addOccluderBox(sm::Vector3(-130.0f, 10.0f, z - 2.0f),
+                sm::Vector3(130.0f, 14.0f, z + 2.0f), positions, indices);
+        }
+        for (float z : { -45.0f, 45.0f }) {
+            addOccluderBox(sm::Vector3(-150.0f, -60.0f, z - 1.0f),
+                sm::Vector3(150.0f, 60.0f, z + 1.0f), positions, indices);
+        }
+        for (float x : { -140.0f, 140.0f }) {
+            addOccluderBox(sm::Vector3(x - 1.0f, -60.0f, -45.0f),
+                sm::Vector3(x + 1.0f, 60.0f, 45.0f), positions, indices);
+        }
+
+        const unsigned int frameCnt = 60;
+        std::vector<sm::Matrix> viewProjs(frameCnt);
+        for (unsigned int i = 0; i < frameCnt; i++) {
+            float t = float(i) / frameCnt;
+            sm::Vector3 pos(-100.0f + 200.0f * t, 4.0f, 5.0f * std::sin(t * 6.0f));
+            float yaw = t * dx::XM_2PI;
+            viewProjs[i] = sm::Matrix::CreateLookAt(pos,
+                pos + sm::Vector3(std::cos(yaw), 0.0f, std::sin(yaw)), sm::Vector3::Up) *
+                projMat;
+        }
+
+        for (const auto& size : modelSizes) {
+            std::vector<dx::BoundingBox> boxes(size.second);
+            for (dx::BoundingBox& box : boxes) {
+                box = dx::BoundingBox(sm::Vector3(randomFloats(generator) * 150.0f,
+                    randomFloats(generator) * 60.0f, randomFloats(generator) * 45.0f),
+                    sm::Vector3(1.0f + randomFloats(generator) * 0.5f));
+            }
+
+            // Culling rate over the path: hidden boxes of the ones in the frustum.
+            OcclusionCuller culler;
+            size_t frustumCnt = 0;
+            UINT64 occludedCnt = 0;
+            for (const sm::Matrix& viewProj : viewProjs) {
+                FrustumCuller::Planes planes = FrustumCuller::ExtractPlanes(viewProj);
+                culler.BeginFrame(viewProj);
+                culler.AddOccluder(positions.data(), positions.size(),
+                    sizeof(sm::Vector3), indices.data(), indices.size(),
+                    sm::Matrix::Identity);
+                culler.Rasterize();
+                for (const dx::BoundingBox& box : boxes) {
+                    if (FrustumCuller::TestBox(planes, box)) {
+                        frustumCnt++;
+                        occludedCnt += culler.TestBox(box) ? 0 : 1;
+                    }
+                }
+            }
+            char line[128];
+            snprintf(line, sizeof(line), "Occlusion culling (%s): %.1f%% of %zu boxes "
+                "in the frustum hidden\n", size.first,
+                frustumCnt ? 100.0 * occludedCnt / frustumCnt : 0.0, frustumCnt);
+            OutputDebugStringA(line);
+
+            // Time per frame of the whole path: occluders and occludee tests.
+            const std::array<std::tuple<const char*, OcclusionCuller::Path, UINT32>, 3>
+                    paths = {
+                std::make_tuple("OcclusionCullScalar", OcclusionCuller::Path::SCALAR, 1u),
+                std::make_tuple("OcclusionCullAvx2", OcclusionCuller::Path::AVX2, 1u),
+                std::make_tuple("OcclusionCullAvx2Threads", OcclusionCuller::Path::AVX2,
+                    std::thread::hardware_concurrency()) };
+            for (const auto& path : paths) {
+                culler.SetPath(std::get<1>(path));
+                if (culler.GetPath() != std::get<1>(path)) {
+                    continue;   // Not supported by this CPU.
+                }
+                culler.SetThreadCount(std::get<2>(path));
+                results.push_back(measure(std::get<0>(path), size.first, frameCnt,
+                        repetitions, [&]() {
+                    for (const sm::Matrix& viewProj : viewProjs) {
+                        culler.BeginFrame(viewProj);
+                        culler.AddOccluder(positions.data(), positions.size(),
+                            sizeof(sm::Vector3), indices.data(), indices.size(),
+                            sm::Matrix::Identity);
+                        culler.Rasterize();
+                        UINT32 visibleCnt = 0;
+                        for (const dx::BoundingBox& box : boxes) {
+                            visibleCnt += culler.TestBox(box) ? 1 : 0;
+                        }
+                        g_sink = g_sink + float(visibleCnt);
+                    }
+                }));
+            }
+        }
+    }
+
+    // Reprojected depth occlusion culling. The depth is the G-buffer of 1080p
+    // (realistic) or 4K (stress) after the 4x4 downsampling of DepthReadback: a far
+    // background with random rectangles of closer surfaces. The camera moved and
+    // turned a bit since the depth was rendered.
+    for (size_t sizeIdx = 0; sizeIdx < depthSizes.size(); sizeIdx++) {
+        const auto& size = depthSizes[sizeIdx];
+        UINT32 width = size.second.first;
+        UINT32 height = size.second.second;
+        std::vector<float> depth(size_t(width) * height, 1.0f);
+        std::uniform_real_distribution<float> randomDepths(0.9f, 0.999f);
+        for (int i = 0; i < 200; i++) {
+            UINT32 x0 = UINT32((randomFloats(generator) * 0.5f + 0.5f) * (width - 1));
+            UINT32 y0 = UINT32((randomFloats(generator) * 0.5f + 0.5f) * (height - 1));
+            UINT32 x1 = std::min(width, x0 + 1 + width / 8);
+            UINT32 y1 = std::min(height, y0 + 1 + height / 4);
+            float z = randomDepths(generator);
+            for (UINT32 y = y0; y < y1; y++) {
+                for (UINT32 x = x0; x < x1; x++) {
+                    float& texel = depth[size_t(y) * width + x];
+                    texel = std::min(texel, z);
+                }
+            }
+        }
+
+        sm::Matrix sourceViewProj = sm::Matrix::CreateLookAt(sm::Vector3::Zero,
+            sm::Vector3::UnitX, sm::Vector3::Up) * projMat;
+        sm::Matrix viewProj = sm::Matrix::CreateLookAt(sm::Vector3(0.5f, 0.0f, 0.2f),
+            sm::Vector3(1.5f, 0.0f, 0.22f), sm::Vector3::Up) * projMat;
+
+        HiZCuller culler;
+        const std::array<std::pair<const char*, HiZCuller::Path>, 2> paths = {
+            std::make_pair("HiZUpdateScalar", HiZCuller::Path::SCALAR),
+            std::make_pair("HiZUpdateSse", HiZCuller::Path::SSE) };
+        for (const auto& path : paths) {
+            culler.SetPath(path.second);
+            results.push_back(measure(path.first, size.first, width * height,
+                    repetitions, [&]() {
+                culler.SetDepth(depth.data(), width, height, width * sizeof(float),
+                    sourceViewProj);
+                culler.Update(viewProj);
+                g_sink = g_sink + culler.GetMaxDepth(culler.GetLevelCount() - 1)[0];
+            }));
+        }
+
+        // Occludees in front of the camera, some behind the rectangles.
+        std::vector<dx::BoundingBox> boxes(modelSizes[sizeIdx].second);
+        for (dx::BoundingBox& box : boxes) {
+            box = dx::BoundingBox(sm::Vector3(150.0f + randomFloats(generator) * 140.0f,
+                randomFloats(generator) * 40.0f, randomFloats(generator) * 60.0f),
+                sm::Vector3(1.0f + randomFloats(generator) * 0.5f));
+        }
+        results.push_back(measure("HiZTestBox", size.first, UINT32(boxes.size()),
+                repetitions, [&]() {
+            UINT32 visibleCnt = 0;
+            for (const dx::BoundingBox& box : boxes) {
+                visibleCnt += culler.TestBox(box) ? 1 : 0;
+            }
+            g_sink = g_sink + float(visibleCnt);
+        }));
+    }
+
+    // Tiled light culling of 1080p with the lights spread over Sponza. The depth
+    // bounds of the tiles are random surfaces between the middle and the back of the
+    // atrium, each tile a little deep. Items are the lights.
+    for (const auto& size : tiledLightSizes) {
+        std::vector<sm::Vector4> lights(size.second);
+        for (sm::Vector4& light : lights) {
+            light = sm::Vector4(130.0f * randomFloats(generator),
+                15.0f * randomFloats(generator) + 10.0f, 50.0f * randomFloats(generator),
+                6.0f + 4.0f * randomFloats(generator));
+        }
+        sm::Matrix viewMat = sm::Matrix::CreateLookAt(sm::Vector3(-100.0f, 10.0f, 0.0f),
+            sm::Vector3(0.0f, 12.0f, 5.0f), sm::Vector3::Up);
+
+        TiledLightCuller culler;
+        culler.Resize(1920, 1080);
+        std::vector<float> minDepth(size_t(culler.GetTilesX()) * culler.GetTilesY());
+        std::vector<float> maxDepth(minDepth.size());
+        std::uniform_real_distribution<float> randomDepths(0.97f, 0.995f);
+        for (size_t i = 0; i < minDepth.size(); i++) {
+            maxDepth[i] = randomDepths(generator);
+            minDepth[i] = maxDepth[i] - 0.01f;
+        }
+
+        culler.Cull(viewMat, projMat, lights);
+        size_t unboundedCnt = culler.GetLightIndices().size();
+        culler.SetDepthBounds(minDepth.data(), maxDepth.data(), culler.GetTilesX());
+        culler.Cull(viewMat, projMat, lights);
+        char line[160];
+        snprintf(line, sizeof(line), "Tiled light culling (%s): %u of %zu lights on "
+            "screen, %.1f lights per tile, %.1f without depth bounds\n", size.first,
+            culler.GetVisibleLightCount(), lights.size(),
+            double(culler.GetLightIndices().size()) / culler.GetTileRanges().size(),
+            double(unboundedCnt) / culler.GetTileRanges().size());
+        OutputDebugStringA(line);
+
+        const std::array<std::tuple<const char*, TiledLightCuller::Path, UINT32>, 3>
+                paths = {
+            std::make_tuple("TiledLightCullScalar", TiledLightCuller::Path::SCALAR, 1u),
+            std::make_tuple("TiledLightCullSse", TiledLightCuller::Path::SSE, 1u),
+            std::make_tuple("TiledLightCullSseThreads", TiledLightCuller::Path::SSE,
+                std::thread::hardware_concurrency()) };
+        for (const auto& path : paths) {
+            culler.SetPath(std::get<1>(path));
+            culler.SetThreadCount(std::get<2>(path));
+            results.push_back(measure(std::get<0>(path), size.first, UINT32(lights.size()),
+                    repetitions, [&]() {
+                culler.Cull(viewMat, projMat, lights);
+                g_sink = g_sink + float(culler.GetLightIndices().size());
+            }));
+        }
+    }
+
+    // Clustered light assignment with the lights of the tiled culling. The full
+    // kernels reassign all lights as after a camera move, the incremental one moves
+    // 1% of the lights back and forth. Items are the lights.
+    for (const auto& size : clusteredLightSizes) {
+        std::vector<sm::Vector4> lights(size.second);
+        for (sm::Vector4& light : lights) {
+            light = sm::Vector4(130.0f * randomFloats(generator),
+                15.0f * randomFloats(generator) + 10.0f, 50.0f * randomFloats(generator),
+                6.0f + 4.0f * randomFloats(generator));
+        }
+        sm::Matrix viewMat = sm::Matrix::CreateLookAt(sm::Vector3(-100.0f, 10.0f, 0.0f),
+            sm::Vector3(0.0f, 12.0f, 5.0f), sm::Vector3::Up);
+
+        ClusteredLightCuller culler;
+        culler.SetProjection(projMat);
+        culler.SetView(viewMat);
+        culler.SetLights(lights);
+        culler.Update();
+        char line[160];
+        snprintf(line, sizeof(line), "Clustered light assignment (%s): %zu lights, "
+            "%.1f lights per cluster\n", size.first, lights.size(),
+            double(culler.GetLightIndices().size()) / culler.GetClusterRanges().size());
+        OutputDebugStringA(line);
+
+        const std::array<std::pair<const char*, UINT32>, 2> paths = {
+            std::make_pair("ClusteredLightAssign", 1u),
+            std::make_pair("ClusteredLightAssignThreads",
+                std::thread::hardware_concurrency()) };
+        for (const auto& path : paths) {
+            culler.SetThreadCount(path.second);
+            results.push_back(measure(path.first, size.first, UINT32(lights.size()),
+                    repetitions, [&]() {
+                culler.SetLights(lights);
+                culler.Update();
+                g_sink = g_sink + float(culler.GetLightIndices().size());
+            }));
+        }
+
+        std::vector<UINT32> movedLights;
+        for (UINT32 i = 0; i < lights.size(); i += 100) {
+            movedLights.push_back(i);
+        }
+        float offset = 2.0f;
+        results.push_back(measure("ClusteredLightAssignIncremental", size.first,
+                UINT32(movedLights.size()), repetitions, [&]() {
+            offset = -offset;
+            for (UINT32 i : movedLights) {
+                lights[i].x += offset;
+                culler.SetLight(i, lights[i]);
+            }
+            culler.Update();
+            g_sink = g_sink + float(culler.GetLightIndices().size());
+        }));
+    }
+
+    // Light BVH over the lights of the clustered assignment. The refit moves all
+    // lights as the light animation does, the queries are compared with testing
+    // every light. Items are the lights.
+    for (const auto& size : clusteredLightSizes) {
+        std::vector<sm::Vector4> lights(size.second);
+        for (sm::Vector4& light : lights) {
+            light = sm::Vector4(130.0f * randomFloats(generator),
+                15.0f * randomFloats(generator) + 10.0f, 50.0f * randomFloats(generator),
+                6.0f + 4.0f * randomFloats(generator));
+        }
+        sm::Matrix viewMat = sm::Matrix::CreateLookAt(sm::Vector3(-100.0f, 10.0f, 0.0f),
+            sm::Vector3(0.0f, 12.0f, 5.0f), sm::Vector3::Up);
+        FrustumCuller::Planes planes = FrustumCuller::ExtractPlanes(viewMat * projMat);
+        UINT32 lightCnt = UINT32(lights.size());
+
+        LightBvh bvh;
+        results.push_back(measure("LightBvhBuild", size.first, lightCnt, repetitions,
+                [&]() {
+            bvh.Build(lights);
+            g_sink = g_sink + float(bvh.GetBvh().GetNodeCount());
+        }));
+
+        float offset = 0.5f;
+        results.push_back(measure("LightBvhRefit", size.first, lightCnt, repetitions,
+                [&]() {
+            offset = -offset;
+            for (UINT32 i = 0; i < lightCnt; i++) {
+                lights[i].x += offset;
+                bvh.SetLight(i, lights[i]);
+            }
+            bvh.Refit();
+            g_sink = g_sink + bvh.GetBvh().GetBounds().Center.x;
+        }));
+
+        std::vector<UINT32> result;
+        result.reserve(lightCnt);
+        results.push_back(measure("LightBvhFrustum", size.first, lightCnt, repetitions,
+                [&]() {
+            bvh.QueryFrustum(planes, result);
+            g_sink = g_sink + float(result.size());
+        }));
+        results.push_back(measure("LightFrustumBruteForce", size.first, lightCnt,
+                repetitions, [&]() {
+            result.clear();
+            for (UINT32 i = 0; i < lightCnt; i++) {
+                const sm::Vector4& light = lights[i];
+                bool isInside = true;
+                for (const sm::Vector4& plane : planes) {
+                    isInside &= plane.x * light.x + plane.y * light.y +
+                        plane.z * light.z + plane.w >= -light.w;
+                }
+                if (isInside) {
+                    result.push_back(i);
+                }
+            }
+            g_sink = g_sink + float(result.size());
+        }));
+
+        // The reach of a light of average size around a light.
+        results.push_back(measure("LightBvhSphere", size.first, lightCnt, repetitions,
+                [&]() {
+            const sm::Vector4& light = lights[generator() % lightCnt];
+            bvh.QuerySphere(sm::Vector3(light.x, light.y, light.z), 6.0f, result);
+            g_sink = g_sink + float(result.size());
+        }));
+        results.push_back(measure("LightBvhRaycast", size.first, lightCnt, repetitions,
+                [&]() {
+            sm::Vector3 direction(randomFloats(generator), 0.1f * randomFloats(generator),
+                randomFloats(generator));
+            float t = FLT_MAX;
+            g_sink = g_sink + float(bvh.RaycastNearest(sm::Vector3(-100.0f, 10.0f, 0.0f),
+                direction, t));
+        }));
+    }
+
+    // Light LOD over generated lights, seen from the end of the atrium at 800 pixels
+    // of height. The error of every budget is reported for points around random
+    // lights, with the attenuation of the shaders. Items are the lights.
+    for (const auto& size : clusteredLightSizes) {
+        std::vector<SceneMath::Light> generated = SceneMath::GenerateLights(
+            size.second, 42);
+        std::vector<sm::Vector4> lights;
+        std::vector<sm::Vector3> colors;
+        for (const SceneMath::Light& light : generated) {
+            lights.push_back(sm::Vector4(light.Position.x, light.Position.y,
+                light.Position.z, 0.5f * light.Scale.x));
+            colors.push_back(sm::Vector3(light.Color.x, light.Color.y, light.Color.z));
+        }
+        std::vector<sm::Vector3> points(256);
+        for (sm::Vector3& point : points) {
+            const sm::Vector4& light = lights[generator() % lights.size()];
+            sm::Vector3 offset(randomFloats(generator), randomFloats(generator),
+                randomFloats(generator));
+            point = sm::Vector3(light.x, light.y, light.z) + light.w * offset;
+        }
+        sm::Vector3 viewPos(-100.0f, 10.0f, 0.0f);
+        float pixelScale = 0.5f * 800.0f * projMat._22;
+        UINT32 lightCnt = UINT32(lights.size());
+
+        LightLod lod;
+        lod.Build(lights, colors);
+        const std::array<std::pair<const char*, float>, 3> budgets = {
+            std::make_pair("LightLodUpdate1px", 1.0f),
+            std::make_pair("LightLodUpdate4px", 4.0f),
+            std::make_pair("LightLodUpdate16px", 16.0f) };
+        for (const auto& budget : budgets) {
+            LightLod::Settings settings;
+            settings.maxMergeSize = budget.second;
+            lod.SetSettings(settings);
+            results.push_back(measure(budget.first, size.first, lightCnt, repetitions,
+                    [&]() {
+                lod.Update(viewPos, pixelScale);
+                g_sink = g_sink + float(lod.GetVirtualLights().size());
+            }));
+            char line[160];
+            snprintf(line, sizeof(line), "%s (%s): %zu lights kept, %zu merged into "
+                "%zu virtual lights, error %.4f\n", budget.first, size.first,
+                lod.GetKeptLights().size(), lod.GetMergedLights().size(),
+                lod.GetVirtualLights().size(),
+                lod.ComputeError(points, SceneMath::ComputeLightAttenuation));
+            OutputDebugStringA(line);
+        }
+    }
+
+    // Potentially visible sets of the atrium above, with every wall and every
+    // occludee box as a mesh of its own. Cells cover the ground floor of the atrium
+    // and the arcades. Items are the cells for baking and the frames of the camera
+    // path for the lookup.
+    {
+        std::vector<std::pair<sm::Vector3, sm::Vector3>> walls;
+        for (float z : { -20.0f, 20.0f }) {
+            for (float x = -110.0f; x <= 110.0f; x += 20.0f) {
+                walls.push_back({ sm::Vector3(x - 2.0f, -60.0f, z - 2.0f),
+                    sm::Vector3(x + 2.0f, 60.0f, z + 2.0f) });
+            }
+            walls.push_back({ sm::Vector3(-130.0f, 10.0f, z - 2.0f),
+                sm::Vector3(130.0f, 14.0f, z + 2.0f) });
+        }
+        for (float z : { -45.0f, 45.0f }) {
+            walls.push_back({ sm::Vector3(-150.0f, -60.0f, z - 1.0f),
+                sm::Vector3(150.0f, 60.0f, z + 1.0f) });
+        }
+        for (float x : { -140.0f, 140.0f }) {
+            walls.push_back({ sm::Vector3(x - 1.0f, -60.0f, -45.0f),
+                sm::Vector3(x + 1.0f, 60.0f, 45.0f) });
+        }
+
+        const unsigned int frameCnt = 60;
+        std::vector<sm::Vector3> eyes(frameCnt);
+        std::vector<sm::Matrix> viewProjs(frameCnt);
+        for (unsigned int i = 0; i < frameCnt; i++) {
+            float t = float(i) / frameCnt;
+            eyes[i] = sm::Vector3(-100.0f + 200.0f * t, 4.0f, 5.0f * std::sin(t * 6.0f));
+            float yaw = t * dx::XM_2PI;
+            viewProjs[i] = sm::Matrix::CreateLookAt(eyes[i],
+                eyes[i] + sm::Vector3(std::cos(yaw), 0.0f, std::sin(yaw)),
+                sm::Vector3::Up) * projMat;
+        }
+
+        Pvs::Settings settings;
+        settings.volume = dx::BoundingBox(sm::Vector3(0.0f, 5.0f, 0.0f),
+            sm::Vector3(140.0f, 15.0f, 44.0f));
+        for (const auto& size : pvsSizes) {
+            Pvs pvs;
+            std::vector<sm::Vector3> positions;
+            std::vector<UINT32> indices;
+            for (const auto& wall : walls) {
+                positions.clear();
+                indices.clear();
+                addOccluderBox(wall.first, wall.second, positions, indices);
+                pvs.AddMesh(positions.data(), positions.size(), sizeof(sm::Vector3),
+                    indices.data(), indices.size(), sm::Matrix::Identity, true);
+            }
+            std::vector<dx::BoundingBox> boxes(size.second);
+            for (dx::BoundingBox& box : boxes) {
+                box = dx::BoundingBox(sm::Vector3(randomFloats(generator) * 150.0f,
+                    randomFloats(generator) * 60.0f, randomFloats(generator) * 45.0f),
+                    sm::Vector3(1.0f + randomFloats(generator) * 0.5f));
+                positions.clear();
+                indices.clear();
+                addOccluderBox(sm::Vector3(box.Center) - sm::Vector3(box.Extents),
+                    sm::Vector3(box.Center) + sm::Vector3(box.Extents), positions,
+                    indices);
+                pvs.AddMesh(positions.data(), positions.size(), sizeof(sm::Vector3),
+                    indices.data(), indices.size(), sm::Matrix::Identity, false);
+            }
+
+            // Baked once up front for the number of cells.
+            pvs.Bake(settings);
+            results.push_back(measure("PvsBake", size.first, pvs.GetCellCount(),
+                    repetitions, [&]() {
+                pvs.Bake(settings);
+                g_sink = g_sink + float(pvs.GetSetCount());
+            }));
+
+            std::vector<UINT32> visibleMeshes;
+            results.push_back(measure("PvsLookup", size.first, frameCnt, repetitions,
+                    [&]() {
+                for (const sm::Vector3& eye : eyes) {
+                    pvs.GetVisibleMeshes(pvs.FindCell(eye), visibleMeshes);
+                    g_sink = g_sink + float(visibleMeshes.size());
+                }
+            }));
+
+            // Culling rate over the path: boxes in the frustum that are not in the
+            // set of the camera cell.
+            size_t frustumCnt = 0;
+            UINT64 culledCnt = 0;
+            std::vector<bool> isVisible(pvs.GetMeshCount());
+            for (unsigned int i = 0; i < frameCnt; i++) {
+                FrustumCuller::Planes planes = FrustumCuller::ExtractPlanes(viewProjs[i]);
+                pvs.GetVisibleMeshes(pvs.FindCell(eyes[i]), visibleMeshes);
+                isVisible.assign(isVisible.size(), false);
+                for (UINT32 mesh : visibleMeshes) {
+                    isVisible[mesh] = true;
+                }
+                for (UINT32 box = 0; box < boxes.size(); box++) {
+                    if (FrustumCuller::TestBox(planes, boxes[box])) {
+                        frustumCnt++;
+                        culledCnt += isVisible[walls.size() + box] ? 0 : 1;
+                    }
+                }
+            }
+            char line[192];
+            snprintf(line, sizeof(line), "PVS (%s): %u cells, %u sets, %zu bytes, "
+                "%.1f%% of %zu boxes in the frustum culled\n", size.first,
+                pvs.GetCellCount(), pvs.GetSetCount(), pvs.GetCompressedSize(),
+                frustumCnt ? 100.0 * culledCnt / frustumCnt : 0.0, frustumCnt);
+            OutputDebugStringA(line);
+        }
+    }
+
+    // Procedural meshes. Vertices and indices are reused, like a real caller would.
+    {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        for (const auto& size : sphereRes) {
+            int res = size.second;
+            unsigned int vertexCnt = (2 * res + 1) * (res + 1);
+            results.push_back(measure("GenerateSphereGeometry", size.first, vertexCnt,
+                    repetitions, [&]() {
+                MeshGeometry::GenerateSphereGeometry(2 * res, res, vertices, indices);
+                g_sink = g_sink + vertices.back().Position.x;
+            }));
+        }
+        for (const auto& size : torusRes) {
+            int res = size.second;
+            unsigned int vertexCnt = (res + 1) * (res + 1);
+            results.push_back(measure("GenerateTorusGeometry", size.first, vertexCnt,
+                    repetitions, [&]() {
+                MeshGeometry::GenerateTorusGeometry(res, res, vertices, indices);
+                g_sink = g_sink + vertices.back().Position.x;
+            }));
+        }
+    }
+
+    // SSAO sample kernel.
+    for (const auto& size : kernelSizes) {
+        unsigned int count = size.second;
+        results.push_back(measure("GenerateSSAOKernel", size.first, count,
+                repetitions, [&]() {
+            std::vector<sm::Vector4> kernel = SceneMath::GenerateSSAOKernel(count, 42);
+            g_sink = g_sink + kernel.back().x;
+        }));
+    }
+
+    // Light generation.
+    for (const auto& size : lightSizes) {
+        unsigned int count = size.second;
+        results.push_back(measure("GenerateLights", size.first, count,
+                repetitions, [&]() {
+            std::vector<SceneMath::Light> lights =
+                SceneMath::GenerateLights(count, 42);
+            g_sink = g_sink + lights.back().Position.x;
+        }));
+    }
+
+    // Light pool churn: every repetition removes 1% of the lights from random places
+    // and adds them again, then copies the dirty range as an upload would. Items are
+    // the removed lights.
+    for (const auto& size : lightSizes) {
+        std::vector<SceneMath::Light> lights = SceneMath::GenerateLights(size.second,
+            42);
+        LightPool pool;
+        std::vector<LightPool::Handle> handles;
+        for (const SceneMath::Light& light : lights) {
+            handles.push_back(pool.Add(sm::Vector3(light.Position.x, light.Position.y,
+                light.Position.z), 0.5f * light.Scale.x,
+                sm::Vector3(light.Color.x, light.Color.y, light.Color.z)));
+        }
+        pool.ClearDirty();
+        std::vector<LightPool::PackedLight> uploadTarget(pool.GetCount());
+        UINT32 churnCnt = std::max(size.second / 100, 1u);
+        results.push_back(measure("LightPoolChurn", size.first, churnCnt, repetitions,
+                [&]() {
+            for (UINT32 i = 0; i < churnCnt; i++) {
+                size_t slot = generator() % handles.size();
+                const SceneMath::Light& light = lights[slot];
+                pool.Remove(handles[slot]);
+                handles[slot] = pool.Add(sm::Vector3(light.Position.x,
+                    light.Position.y, light.Position.z), 0.5f * light.Scale.x,
+                    sm::Vector3(light.Color.x, light.Color.y, light.Color.z));
+            }
+            std::copy(pool.GetLights().begin() + pool.GetDirtyBegin(),
+                pool.GetLights().begin() + pool.GetDirtyEnd(),
+                uploadTarget.begin() + pool.GetDirtyBegin());
+            g_sink = g_sink + float(pool.GetDirtyEnd() - pool.GetDirtyBegin());
+            pool.ClearDirty();
+        }));
+    }
+
+    // Light animation, a frame at 60 Hz. Items are the lights, reported as lights
+    // per millisecond as well.
+    for (const auto& size : animatedLightSizes) {
+        LightAnimation animation;
+        animation.Resize(size.second);
+        animation.SetBounds(sm::Vector3(-111.0f, -6.0f, -49.0f),
+            sm::Vector3(139.0f, 23.0f, 54.0f));
+        for (UINT32 i = 0; i < size.second; i++) {
+            sm::Vector3 position(14.0f + 125.0f * randomFloats(generator),
+                8.5f + 14.5f * randomFloats(generator),
+                2.5f + 51.5f * randomFloats(generator));
+            sm::Vector3 velocity(10.0f * randomFloats(generator),
+                randomFloats(generator), 10.0f * randomFloats(generator));
+            animation.SetLight(i, position, velocity, sm::Vector3(1.0f), 1.0f, 16.0f,
+                0.5f + 0.5f * randomFloats(generator), 2.0f + randomFloats(generator));
+        }
+
+        const std::array<std::pair<const char*, LightAnimation::Path>, 2> paths = {
+            std::make_pair("LightAnimationScalar", LightAnimation::Path::SCALAR),
+            std::make_pair("LightAnimationAvx2", LightAnimation::Path::AVX2) };
+        for (const auto& path : paths) {
+            animation.SetPath(path.second);
+            if (animation.GetPath() != path.second) {
+                continue;
+            }
+            results.push_back(measure(path.first, size.first, size.second, repetitions,
+                    [&]() {
+                animation.Update(1.0f / 60.0f);
+                g_sink = g_sink + animation.GetRadius()[0];
+            }));
+            char line[160];
+            snprintf(line, sizeof(line), "%s (%s): %.0f lights per ms\n", path.first,
+                size.first, 1.0e6 / results.back().nsPerItem);
+            OutputDebugStringA(line);
+        }
+    }
+
+#ifndef PORTABLE_CORE
+    // Assimp to Mesh vertex conversion (processMesh without the buffer upload).
+    for (const auto& size : vertexSizes) {
+        std::unique_ptr<aiMesh> mesh = createSyntheticMesh(size.second);
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        results.push_back(measure("ConvertMeshData", size.first, mesh->mNumVertices,
+                repetitions, [&]() {
+            ModelClass::ConvertMeshData(mesh.get(), vertices, indices);
+            g_sink = g_sink + vertices.back().Position.x;
+        }));
+    }
+#endif
+
+    // Load-time split of a mesh that spans the whole scene: a tessellated floor of
+    // the size of Sponza, slightly uneven. Chunks as for Sponza.
+    for (const auto& size : vertexSizes) {
+        UINT32 side = static_cast<UINT32>(std::sqrt(float(size.second)));
+        std::vector<sm::Vector3> positions;
+        std::vector<UINT32> indices;
+        for (UINT32 z = 0; z < side; z++) {
+            for (UINT32 x = 0; x < side; x++) {
+                positions.push_back(sm::Vector3(300.0f * x / (side - 1) - 150.0f,
+                    randomFloats(generator) * 0.1f, 120.0f * z / (side - 1) - 60.0f));
+            }
+        }
+        for (UINT32 z = 0; z + 1 < side; z++) {
+            for (UINT32 x = 0; x + 1 < side; x++) {
+                UINT32 corner = z * side + x;
+                indices.insert(indices.end(), { corner, corner + side, corner + 1,
+                    corner + 1, corner + side, corner + side + 1 });
+            }
+        }
+
+        const UINT32 chunkTriangleCnt = 4096;
+        std::vector<MeshChunker::Chunk> chunks;
+        results.push_back(measure("MeshChunkerSplit", size.first,
+                UINT32(indices.size() / 3), repetitions, [&]() {
+            MeshChunker::Split(positions.data(), positions.size(), sizeof(sm::Vector3),
+                indices.data(), indices.size(), chunkTriangleCnt, chunks);
+            g_sink = g_sink + float(chunks.size());
+        }));
+
+        // Bounds of a random triangle relative to the unsplit floor.
+        dx::BoundingBox bounds;
+        dx::BoundingBox::CreateFromPoints(bounds, positions.size(), positions.data(),
+            sizeof(sm::Vector3));
+        double sourceArea = indices.size() / 3.0 * MeshChunker::GetSurfaceArea(bounds);
+        double chunkArea = 0.0;
+        for (const MeshChunker::Chunk& chunk : chunks) {
+            chunkArea += chunk.indices.size() / 3.0 *
+                MeshChunker::GetSurfaceArea(chunk.bounds);
+        }
+        char line[128];
+        snprintf(line, sizeof(line), "Mesh chunks (%s): %zu chunks, triangle bounds "
+            "area %.1f%% of unsplit\n", size.first, chunks.size(),
+            100.0 * chunkArea / sourceArea);
+        OutputDebugStringA(line);
+    }
+
+    return results;
+}
+
+
+/*
+ * Benchmark::CreateResultSet
+ */
+BenchmarkStore::ResultSet Benchmark::CreateResultSet(const std::vector<Result>& results) {
+    BenchmarkStore::ResultSet resultSet = BenchmarkStore::CreateResultSet("cpu_kernels");
+    for (const Result& result : results) {
+        BenchmarkStore::Metric metric;
+        metric.name = result.kernel + "/" + result.size;
+        metric.unit = "ms";
+        metric.itemCnt = result.itemCnt;
+        metric.samples = result.samplesMs;
+        resultSet.metrics.push_back(metric);
+    }
+    RenderStats::AppendMetrics(resultSet);
+    return resultSet;
+}
+
+
+/*
+ * Benchmark::Report
+ */
+void Benchmark::Report(const std::vector<Result>& results) {
+    char line[256];
+    snprintf(line, sizeof(line), "%-32s %-10s %10s %12s %12s %12s %12s\n", "Kernel",
+        "Size", "Items", "Median ms", "Min ms", "ns/item", "M items/s");
+    OutputDebugStringA(line);
+    for (const Result& result : results) {
+        double millionsPerSecond = result.nsPerItem > 0.0 ? 1000.0 / result.nsPerItem :
+            0.0;
+        snprintf(line, sizeof(line), "%-32s %-10s %10u %12.4f %12.4f %12.3f %12.2f\n",
+            result.kernel.c_str(), result.size.c_str(), result.itemCnt,
+            result.medianMs, result.minMs, result.nsPerItem, millionsPerSecond);
+        OutputDebugStringA(line);
+    }
+}
+
+
+/*
+ * Benchmark::measure
+ */
+Benchmark::Result Benchmark::measure(const std::string& kernel,
+        const std::string& size, unsigned int itemCnt, unsigned int repetitions,
+        const std::function<void()>& work) {
+    Result result;
+    result.kernel = kernel;
+    result.size = size;
+    result.itemCnt = itemCnt;
+
+    // Warm-up (caches, first-touch of output memory).
+    work();
+
+    result.samplesMs.reserve(repetitions);
+    for (unsigned int i = 0; i < repetitions; i++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        work();
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        result.samplesMs.push_back(elapsed.count());
+    }
+
+    // Statistics.
+    std::vector<double> sorted = result.samplesMs;
+    std::sort(sorted.begin(), sorted.end());
+    size_t cnt = sorted.size();
+    if (cnt == 0) {
+        return result;
+    }
+    result.minMs = sorted.front();
+    result.medianMs = (cnt % 2) ? sorted[cnt / 2]
+        : 0.5 * (sorted[cnt / 2 - 1] + sorted[cnt / 2]);
+    double sum = 0.0;
+    for (double sample : sorted) {
+        sum += sample;
+    }
+    result.meanMs = sum / cnt;
+    double squaredSum = 0.0;
+    for (double sample : sorted) {
+        squaredSum += (sample - result.meanMs) * (sample - result.meanMs);
+    }
+    result.stdDevMs = (cnt > 1) ? std::sqrt(squaredSum / (cnt - 1)) : 0.0;
+    result.nsPerItem = itemCnt ? result.medianMs * 1.0e6 / itemCnt : 0.0;
+
+    return result;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "BenchmarkStore.h"
+
+/// <summary>
+/// Microbenchmarks for the CPU-side kernels of the renderer (matrix math, mesh
+/// generation, light and sample generation, mesh conversion).
+/// </summary>
+/// <remarks>
+/// Started by passing --benchmark on the command line of the application or of
+/// the portable benchmark (see CMakeLists.txt). No window or device gets created.
+/// Every kernel runs at a realistic size (what Sponza uses per frame or at
+/// start-up) and at a stress size. Results are stored via BenchmarkStore, so they
+/// can be compared between builds.
+/// </remarks>
+class Benchmark {
+public:
+    /// <summary>
+    /// Measurements of a single kernel at a single size.
+    /// </summary>
+    struct Result {
+        std::string kernel;
+        std::string size;               // "realistic" or "stress".
+        unsigned int itemCnt = 0;       // Matrices, lights, vertices, ...
+        std::vector<double> samplesMs;  // One entry per repetition.
+        double minMs = 0.0;
+        double medianMs = 0.0;
+        double meanMs = 0.0;
+        double stdDevMs = 0.0;
+        double nsPerItem = 0.0;         // Based on the median.
+    };
+
+    /// <summary>
+    /// Runs a benchmark mode of the command line:
+    ///   --benchmark [output.json]
+    ///   --benchmark-compare &lt;base.json&gt; &lt;current.json&gt; [report.txt]
+    /// Files default to the working directory.
+    /// </summary>
+    /// <param name="arguments">Arguments without the program name.</param>
+    /// <returns>Exit code. 1 if the comparison found a significant regression.
+    /// </returns>
+    static int RunCommand(const std::vector<std::string>& arguments);
+
+    /// <summary>
+    /// Runs all kernels at all sizes.
+    /// </summary>
+    /// <param name="repetitions">Measured repetitions per kernel and size. One
+    /// additional warm-up run is not measured.</param>
+    /// <returns>One result per kernel and size.</returns>
+    static std::vector<Result> RunAll(unsigned int repetitions = 15);
+
+    /// <summary>
+    /// Converts results into a result set that can be saved and compared. Metrics
+    /// are named "kernel/size". The render counters of the frames recorded so far
+    /// (see RenderStats::AppendMetrics) are added as well.
+    /// </summary>
+    /// <param name="results">Results of RunAll().</param>
+    /// <returns>Result set with machine information and git revision.</returns>
+    static BenchmarkStore::ResultSet CreateResultSet(const std::vector<Result>& results);
+
+    /// <summary>
+    /// Writes a human readable summary to the debug output.
+    /// </summary>
+    /// <param name="results">Results of RunAll().</param>
+    static void Report(const std::vector<Result>& results);
+
+private:
+    /// <summary>
+    /// Times a kernel and computes the statistics of the samples.
+    /// </summary>
+    /// <param name="kernel">Name of the kernel.</param>
+    /// <param name="size">Size label.</param>
+    /// <param name="itemCnt">Number of items processed by one call of work.</param>
+    /// <param name="repetitions">Measured repetitions.</param>
+    /// <param name="work">Function that runs the kernel once.</param>
+    /// <returns>Measurements.</returns>
+    static Result measure(const std::string& kernel, const std::string& size,
+        unsigned int itemCnt, unsigned int repetitions,
+        const std::function<void()>& work);
+};
@@ -0,0 +1,22 @@
+#include "stdafx.h"
+#include "Benchmark.h"
+
+/// <summary>
+/// Entry point of the portable benchmark (see CMakeLists.txt). Takes the same
+/// arguments as the benchmark modes of the application:
+///   --benchmark [output.json]
+///   --benchmark-compare &lt;base.json&gt; &lt;current.json&gt; [report.txt]
+/// </summary>
+/// <returns>1 if the comparison found a significant regression.</returns>
+int main(int argc, char* argv[]) {
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    if (arguments.empty()) {
+        arguments.push_back("--benchmark");
+    }
+    try {
+        return Benchmark::RunCommand(arguments);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+}
@@ -0,0 +1,575 @@
+#include "stdafx.h"
+#include "BenchmarkStore.h"
+#include "Platform.h"
+
+/// <summary>
+/// Minimal JSON value. Only what the result files need (objects, arrays, strings,
+/// numbers). Object members keep their order.
+/// </summary>
+struct JsonValue {
+    enum class Type { NUL, NUMBER, STRING, ARRAY, OBJECT, BOOLEAN };
+    Type type = Type::NUL;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    /// <summary>
+    /// Returns the member with the given name or a null value.
+    /// </summary>
+    const JsonValue& operator[](const std::string& name) const {
+        static const JsonValue nullValue;
+        for (const auto& member : object) {
+            if (member.first == name) {
+                return member.second;
+            }
+        }
+        return nullValue;
+    }
+};
+
+/// <summary>
+/// Recursive descent parser for JsonValue.
+/// </summary>
+class JsonParser {
+public:
+    JsonParser(const std::string& text) : m_text(text), m_pos(0) {}
+
+    JsonValue Parse() {
+        JsonValue value = parseValue();
+        skipWhitespace();
+        if (m_pos != m_text.size()) {
+            fail("Unexpected trailing characters");
+        }
+        return value;
+    }
+
+private:
+    void fail(const std::string& msg) {
+        throw std::invalid_argument("JSON: " + msg + " at offset " +
+            std::to_string(m_pos) + ".");
+    }
+
+    void skipWhitespace() {
+        while (m_pos < m_text.size() && isspace(static_cast<unsigned char>(m_text[m_pos]))) {
+            m_pos++;
+        }
+    }
+
+    void expect(char c) {
+        skipWhitespace();
+        if (m_pos >= m_text.size() || m_text[m_pos] != c) {
+            fail(std::string("Expected '") + c + "'");
+        }
+        m_pos++;
+    }
+
+    JsonValue parseValue() {
+        skipWhitespace();
+        if (m_pos >= m_text.size()) {
+            fail("Unexpected end");
+        }
+
+        JsonValue value;
+        char c = m_text[m_pos];
+        if (c == '{') {
+            value.type = JsonValue::Type::OBJECT;
+            m_pos++;
+            skipWhitespace();
+            if (m_text[m_pos] == '}') {
+                m_pos++;
+                return value;
+            }
+            while (true) {
+                skipWhitespace();
+                std::string name = parseString();
+                expect(':');
+                value.object.emplace_back(name, parseValue());
+                skipWhitespace();
+                if (m_pos < m_text.size() && m_text[m_pos] == ',') {
+                    m_pos++;
+                    continue;
+                }
+                expect('}');
+                return value;
+            }
+        } else if (c == '[') {
+            value.type = JsonValue::Type::ARRAY;
+            m_pos++;
+            skipWhitespace();
+            if (m_text[m_pos] == ']') {
+                m_pos++;
+                return value;
+            }
+            while (true) {
+                value.array.push_back(parseValue());
+                skipWhitespace();
+                if (m_pos < m_text.size() && m_text[m_pos] == ',') {
+                    m_pos++;
+                    continue;
+                }
+                expect(']');
+                return value;
+            }
+        } else if (c == '"') {
+            value.type = JsonValue::Type::STRING;
+            value.string = parseString();
+        } else if (m_text.compare(m_pos, 4, "true") == 0) {
+            value.type = JsonValue::Type::BOOLEAN;
+            value.number = 1.0;
+            m_pos += 4;
+        } else if (m_text.compare(m_pos, 5, "false") == 0) {
+            value.type = JsonValue::Type::BOOLEAN;
+            m_pos += 5;
+        } else if (m_text.compare(m_pos, 4, "null") == 0) {
+            m_pos += 4;
+        } else {
+            value.type = JsonValue::Type::NUMBER;
+            const char* start = m_text.c_str() + m_pos;
+            char* end = nullptr;
+            value.number = strtod(start, &end);
+            if (end == start) {
+                fail("Invalid value");
+            }
+            m_pos += end - start;
+        }
+        return value;
+    }
+
+    std::string parseString() {
+        if (m_pos >= m_text.size() || m_text[m_pos] != '"') {
+            fail("Expected string");
+        }
+        m_pos++;
+        std::string result;
+        while (m_pos < m_text.size() && m_text[m_pos] != '"') {
+            char c = m_text[m_pos++];
+            if (c == '\\' && m_pos < m_text.size()) {
+                char escaped = m_text[m_pos++];
+                switch (escaped) {
+                case 'n': result += '\n'; break;
+                case 't': result += '\t'; break;
+                case 'r': result += '\r'; break;
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'u': result += parseCodeUnit(); break;
+                default: result += escaped; break;
+                }
+            } else {
+                result += c;
+            }
+        }
+        if (m_pos >= m_text.size()) {
+            fail("Unterminated string");
+        }
+        m_pos++;
+        return result;
+    }
+
+    /// <summary>
+    /// Reads the four hex digits of a \u escape. Only code units below 0x80 are
+    /// written by Save(), anything else is not supported.
+    /// </summary>
+    char parseCodeUnit() {
+        if (m_pos + 4 > m_text.size()) {
+            fail("Unterminated escape");
+        }
+        std::string digits = m_text.substr(m_pos, 4);
+        char* end = nullptr;
+        unsigned long codeUnit = strtoul(digits.c_str(), &end, 16);
+        if (end != digits.c_str() + 4 || codeUnit >= 0x80) {
+            fail("Unsupported escape");
+        }
+        m_pos += 4;
+        return static_cast<char>(codeUnit);
+    }
+
+    const std::string& m_text;
+    size_t m_pos;
+};
+
+/// <summary>
+/// Escapes quotes, backslashes and control characters for JSON output.
+/// </summary>
+static std::string escapeJson(const std::string& str) {
+    std::string result;
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (c == '\n') {
+            result += "\\n";
+        } else if (c == '\t') {
+            result += "\\t";
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+            result += escaped;
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+
+/*
+ * BenchmarkStore::CreateResultSet
+ */
+BenchmarkStore::ResultSet BenchmarkStore::CreateResultSet(const std::string& source) {
+    ResultSet resultSet;
+    resultSet.source = source;
+    resultSet.gitRevision = queryGitRevision();
+    resultSet.machine = queryMachineInfo();
+
+    std::time_t now = std::time(nullptr);
+    std::tm utc = Platform::ToUtc(now);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    resultSet.timestamp = timestamp;
+
+    return resultSet;
+}
+
+
+/*
+ * BenchmarkStore::Save
+ */
+void BenchmarkStore::Save(const ResultSet& resultSet, const std::string& path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::invalid_argument("Could not open " + path + " for writing.");
+    }
+
+    const MachineInfo& machine = resultSet.machine;
+    const Config& config = resultSet.config;
+    file.precision(6);
+    file << std::fixed;
+    file << "{\n"
+        << "  \"format\": 1,\n"
+        << "  \"source\": \"" << escapeJson(resultSet.source) << "\",\n"
+        << "  \"timestamp\": \"" << escapeJson(resultSet.timestamp) << "\",\n"
+        << "  \"git_revision\": \"" << escapeJson(resultSet.gitRevision) << "\",\n"
+        << "  \"machine\": {\"cpu\": \"" << escapeJson(machine.cpu) << "\", "
+        << "\"logical_cores\": " << machine.logicalCores << ", "
+        << "\"memory_mb\": " << machine.memoryMB << ", "
+        << "\"compiler\": \"" << escapeJson(machine.compiler) << "\", "
+        << "\"build_config\": \"" << escapeJson(machine.buildConfig) << "\"},\n"
+        << "  \"config\": {\"width\": " << config.width << ", "
+        << "\"height\": " << config.height << ", "
+        << "\"shadow_map_size\": " << config.shadowMapSize << ", "
+        << "\"ssao_kernel_size\": " << config.ssaoKernelSize << ", "
+        << "\"light_count\": " << config.lightCount << "},\n"
+        << "  \"metrics\": [\n";
+    for (unsigned int i = 0; i < resultSet.metrics.size(); i++) {
+        const Metric& metric = resultSet.metrics[i];
+        file << "    {\"name\": \"" << escapeJson(metric.name) << "\", "
+            << "\"unit\": \"" << escapeJson(metric.unit) << "\", "
+            << "\"items\": " << metric.itemCnt << ", "
+            << "\"median\": " << Median(metric.samples) << ",\n"
+            << "     \"samples\": [";
+        for (unsigned int j = 0; j < metric.samples.size(); j++) {
+            file << (j ? ", " : "") << metric.samples[j];
+        }
+        file << "]}" << (i + 1 < resultSet.metrics.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+}
+
+
+/*
+ * BenchmarkStore::Load
+ */
+BenchmarkStore::ResultSet BenchmarkStore::Load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::invalid_argument("Could not open " + path + ".");
+    }
+    std::string text((std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+    JsonValue root = JsonParser(text).Parse();
+    if (root.type != JsonValue::Type::OBJECT || root["format"].number != 1.0) {
+        throw std::invalid_argument(path + " is not a benchmark result file.");
+    }
+
+    ResultSet resultSet;
+    resultSet.source = root["source"].string;
+    resultSet.timestamp = root["timestamp"].string;
+    resultSet.gitRevision = root["git_revision"].string;
+
+    const JsonValue& machine = root["machine"];
+    resultSet.machine.cpu = machine["cpu"].string;
+    resultSet.machine.logicalCores = static_cast<unsigned int>(
+        machine["logical_cores"].number);
+    resultSet.machine.memoryMB = static_cast<UINT64>(machine["memory_mb"].number);
+    resultSet.machine.compiler = machine["compiler"].string;
+    resultSet.machine.buildConfig = machine["build_config"].string;
+
+    const JsonValue& config = root["config"];
+    resultSet.config.width = static_cast<unsigned int>(config["width"].number);
+    resultSet.config.height = static_cast<unsigned int>(config["height"].number);
+    resultSet.config.shadowMapSize = static_cast<unsigned int>(
+        config["shadow_map_size"].number);
+    resultSet.config.ssaoKernelSize = static_cast<unsigned int>(
+        config["ssao_kernel_size"].number);
+    resultSet.config.lightCount = static_cast<unsigned int>(
+        config["light_count"].number);
+
+    for (const JsonValue& entry : root["metrics"].array) {
+        Metric metric;
+        metric.name = entry["name"].string;
+        metric.unit = entry["unit"].string;
+        metric.itemCnt = static_cast<unsigned int>(entry["items"].number);
+        for (const JsonValue& sample : entry["samples"].array) {
+            metric.samples.push_back(sample.number);
+        }
+        resultSet.metrics.push_back(metric);
+    }
+
+    return resultSet;
+}
+
+
+/*
+ * BenchmarkStore::Compare
+ */
+std::vector<BenchmarkStore::Comparison> BenchmarkStore::Compare(
+        const ResultSet& base, const ResultSet& current, double alpha,
+        double minChangePercent) {
+    std::vector<Comparison> comparisons;
+
+    for (const Metric& currentMetric : current.metrics) {
+        Comparison comparison;
+        comparison.name = currentMetric.name;
+        comparison.currentMedian = Median(currentMetric.samples);
+
+        auto baseMetric = std::find_if(base.metrics.begin(), base.metrics.end(),
+            [&](const Metric& metric) { return metric.name == currentMetric.name; });
+        if (baseMetric == base.metrics.end()) {
+            comparison.verdict = Verdict::MISSING;
+            comparisons.push_back(comparison);
+            continue;
+        }
+
+        comparison.baseMedian = Median(baseMetric->samples);
+        if (comparison.baseMedian > 0.0) {
+            comparison.changePercent = 100.0 *
+                (comparison.currentMedian - comparison.baseMedian) /
+                comparison.baseMedian;
+        }
+        comparison.pValue = MannWhitneyU(baseMetric->samples, currentMetric.samples);
+
+        if (comparison.pValue < alpha &&
+                std::abs(comparison.changePercent) >= minChangePercent) {
+            comparison.verdict = comparison.changePercent > 0.0 ?
+                Verdict::REGRESSION : Verdict::IMPROVEMENT;
+        }
+        comparisons.push_back(comparison);
+    }
+
+    // Metrics that disappeared.
+    for (const Metric& baseMetric : base.metrics) {
+        auto currentMetric = std::find_if(current.metrics.begin(),
+            current.metrics.end(),
+            [&](const Metric& metric) { return metric.name == baseMetric.name; });
+        if (currentMetric == current.metrics.end()) {
+            Comparison comparison;
+            comparison.name = baseMetric.name;
+            comparison.baseMedian = Median(baseMetric.samples);
+            comparison.verdict = Verdict::MISSING;
+            comparisons.push_back(comparison);
+        }
+    }
+
+    return comparisons;
+}
+
+
+/*
+ * BenchmarkStore::WriteComparison
+ */
+void BenchmarkStore::WriteComparison(const ResultSet& base, const ResultSet& current,
+        const std::vector<Comparison>& comparisons, const std::string& path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::invalid_argument("Could not open " + path + " for writing.");
+    }
+
+    auto describe = [](const ResultSet& resultSet) {
+        return resultSet.source + " @ " + resultSet.gitRevision + " (" +
+            resultSet.timestamp + ", " + resultSet.machine.cpu + ", " +
+            resultSet.machine.buildConfig + ")";
+    };
+
+    char line[512];
+    std::string report;
+    report += "Base:    " + describe(base) + "\n";
+    report += "Current: " + describe(current) + "\n";
+    if (base.machine.cpu != current.machine.cpu ||
+            base.machine.buildConfig != current.machine.buildConfig) {
+        report += "WARNING: Machine or build configuration differs.\n";
+    }
+    const Config& baseConfig = base.config;
+    const Config& currentConfig = current.config;
+    if (baseConfig.width != currentConfig.width ||
+            baseConfig.height != currentConfig.height ||
+            baseConfig.shadowMapSize != currentConfig.shadowMapSize ||
+            baseConfig.ssaoKernelSize != currentConfig.ssaoKernelSize ||
+            baseConfig.lightCount != currentConfig.lightCount) {
+        report += "WARNING: Renderer configuration differs.\n";
+    }
+    report += "\n";
+
+    snprintf(line, sizeof(line), "%-40s %12s %12s %9s %8s  %s\n", "Metric", "Base",
+        "Current", "Change", "p", "Verdict");
+    report += line;
+    unsigned int regressionCnt = 0;
+    for (const Comparison& comparison : comparisons) {
+        const char* verdict = "";
+        switch (comparison.verdict) {
+        case Verdict::UNCHANGED: verdict = "unchanged"; break;
+        case Verdict::REGRESSION: verdict = "REGRESSION"; regressionCnt++; break;
+        case Verdict::IMPROVEMENT: verdict = "improvement"; break;
+        case Verdict::MISSING: verdict = "missing"; break;
+        }
+        snprintf(line, sizeof(line), "%-40s %12.4f %12.4f %+8.2f%% %8.4f  %s\n",
+            comparison.name.c_str(), comparison.baseMedian, comparison.currentMedian,
+            comparison.changePercent, comparison.pValue, verdict);
+        report += line;
+    }
+    report += "\n" + std::to_string(regressionCnt) + " significant regression(s).\n";
+
+    file << report;
+    OutputDebugStringA(report.c_str());
+}
+
+
+/*
+ * BenchmarkStore::MannWhitneyU
+ */
+double BenchmarkStore::MannWhitneyU(const std::vector<double>& a,
+        const std::vector<double>& b) {
+    size_t n1 = a.size();
+    size_t n2 = b.size();
+    if (n1 == 0 || n2 == 0) {
+        return 1.0;
+    }
+
+    // Rank the pooled samples. Ties get the average rank.
+    std::vector<std::pair<double, int>> pooled;
+    pooled.reserve(n1 + n2);
+    for (double value : a) {
+        pooled.emplace_back(value, 0);
+    }
+    for (double value : b) {
+        pooled.emplace_back(value, 1);
+    }
+    std::sort(pooled.begin(), pooled.end());
+
+    size_t n = pooled.size();
+    double rankSumA = 0.0;
+    double tieCorrection = 0.0;
+    for (size_t i = 0; i < n;) {
+        size_t j = i;
+        while (j < n && pooled[j].first == pooled[i].first) {
+            j++;
+        }
+        double rank = 0.5 * (i + 1 + j);    // Average of ranks i+1 ... j.
+        double tieCnt = static_cast<double>(j - i);
+        tieCorrection += tieCnt * tieCnt * tieCnt - tieCnt;
+        for (size_t k = i; k < j; k++) {
+            if (pooled[k].second == 0) {
+                rankSumA += rank;
+            }
+        }
+        i = j;
+    }
+
+    // Normal approximation with tie and continuity correction.
+    double u = rankSumA - n1 * (n1 + 1) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double variance = n1 * n2 / 12.0 *
+        ((n + 1) - tieCorrection / (static_cast<double>(n) * (n - 1)));
+    if (variance <= 0.0) {
+        return 1.0;
+    }
+    double z = (std::abs(u - mean) - 0.5) / std::sqrt(variance);
+    z = std::max(z, 0.0);
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+
+/*
+ * BenchmarkStore::Median
+ */
+double BenchmarkStore::Median(std::vector<double> samples) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    size_t half = samples.size() / 2;
+    std::nth_element(samples.begin(), samples.begin() + half, samples.end());
+    double median = samples[half];
+    if (samples.size() % 2 == 0) {
+        median = 0.5 * (median +
+            *std::max_element(samples.begin(), samples.begin() + half));
+    }
+    return median;
+}
+
+
+/*
+ * BenchmarkStore::queryGitRevision
+ */
+std::string BenchmarkStore::queryGitRevision() {
+    std::string gitDir = (std::filesystem::current_path() / ".git").string() + "/";
+    std::ifstream headFile(gitDir + "HEAD");
+    std::string head;
+    if (!std::getline(headFile, head)) {
+        return "unknown";
+    }
+
+    // Detached HEAD contains the hash directly.
+    const std::string refPrefix = "ref: ";
+    if (head.compare(0, refPrefix.size(), refPrefix) != 0) {
+        return head;
+    }
+    std::string ref = head.substr(refPrefix.size());
+
+    // Loose ref.
+    std::ifstream refFile(gitDir + ref);
+    std::string hash;
+    if (std::getline(refFile, hash)) {
+        return hash;
+    }
+
+    // Packed ref ("<hash> <ref>" per line).
+    std::ifstream packedRefs(gitDir + "packed-refs");
+    std::string line;
+    while (std::getline(packedRefs, line)) {
+        size_t space = line.find(' ');
+        if (space != std::string::npos && line.substr(space + 1) == ref) {
+            return line.substr(0, space);
+        }
+    }
+    return "unknown";
+}
+
+
+/*
+ * BenchmarkStore::queryMachineInfo
+ */
+BenchmarkStore::MachineInfo BenchmarkStore::queryMachineInfo() {
+    MachineInfo machine;
+
+    machine.cpu = Platform::GetCpuName();
+    machine.logicalCores = std::thread::hardware_concurrency();
+    machine.memoryMB = Platform::GetPhysicalMemory() / (1024 * 1024);
+    machine.compiler = Platform::GetCompilerName();
+#if defined( DEBUG ) || defined( _DEBUG )
+    machine.buildConfig = "Debug";
+#else
+    machine.buildConfig = "Release";
+#endif
+
+    return machine;
+}
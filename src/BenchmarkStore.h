@@ -0,0 +1,155 @@
+#pragma once
+
+/// <summary>
+/// Stores benchmark results together with the circumstances they were measured in
+/// and compares two result sets for statistically significant changes.
+/// </summary>
+/// <remarks>
+/// The file format is JSON. A result set consists of machine information, the git
+/// revision, the renderer configuration and a list of metrics. Every metric keeps
+/// all its samples, so the comparison can work on the distributions instead of
+/// single numbers. Any benchmark (CPU kernels, frame timings, ...) can write
+/// metrics, the comparison only relies on the metric names.
+/// Significance is tested with a two-sided Mann-Whitney U test (normal
+/// approximation with tie correction). A change is only reported, if it is
+/// significant AND the medians differ by more than a minimum relative change.
+/// </remarks>
+class BenchmarkStore {
+public:
+    /// <summary>
+    /// Machine the benchmark ran on.
+    /// </summary>
+    struct MachineInfo {
+        std::string cpu;
+        unsigned int logicalCores = 0;
+        UINT64 memoryMB = 0;
+        std::string compiler;
+        std::string buildConfig;    // "Debug" or "Release".
+    };
+
+    /// <summary>
+    /// Renderer configuration. CPU benchmarks use the defaults of the application.
+    /// </summary>
+    struct Config {
+        unsigned int width = 1400;
+        unsigned int height = 800;
+        unsigned int shadowMapSize = 4096;
+        unsigned int ssaoKernelSize = 64;
+        unsigned int lightCount = 32;
+    };
+
+    /// <summary>
+    /// A measured quantity with all its samples. Lower is better.
+    /// </summary>
+    struct Metric {
+        std::string name;
+        std::string unit = "ms";
+        unsigned int itemCnt = 0;
+        std::vector<double> samples;
+    };
+
+    /// <summary>
+    /// Everything that gets written to/read from disk.
+    /// </summary>
+    struct ResultSet {
+        std::string source;         // Benchmark that produced the set.
+        std::string timestamp;      // UTC, ISO 8601.
+        std::string gitRevision;
+        MachineInfo machine;
+        Config config;
+        std::vector<Metric> metrics;
+    };
+
+    /// <summary>
+    /// Outcome of the comparison of a single metric.
+    /// </summary>
+    enum class Verdict {
+        UNCHANGED,
+        REGRESSION,
+        IMPROVEMENT,
+        MISSING         // Metric only exists in one of the sets.
+    };
+
+    /// <summary>
+    /// Comparison of a single metric.
+    /// </summary>
+    struct Comparison {
+        std::string name;
+        double baseMedian = 0.0;
+        double currentMedian = 0.0;
+        double changePercent = 0.0;     // Positive means slower.
+        double pValue = 1.0;
+        Verdict verdict = Verdict::UNCHANGED;
+    };
+
+    /// <summary>
+    /// Creates an empty result set with machine information, git revision and
+    /// timestamp filled in.
+    /// </summary>
+    /// <param name="source">Name of the benchmark.</param>
+    /// <returns>Result set without metrics.</returns>
+    static ResultSet CreateResultSet(const std::string& source);
+
+    /// <summary>
+    /// Writes a result set to disk.
+    /// </summary>
+    /// <param name="resultSet">The results.</param>
+    /// <param name="path">Full path of the file.</param>
+    static void Save(const ResultSet& resultSet, const std::string& path);
+
+    /// <summary>
+    /// Reads a result set from disk. Throws std::invalid_argument, if the file can
+    /// not be read or parsed.
+    /// </summary>
+    /// <param name="path">Full path of the file.</param>
+    /// <returns>The results.</returns>
+    static ResultSet Load(const std::string& path);
+
+    /// <summary>
+    /// Compares all metrics of two result sets.
+    /// </summary>
+    /// <param name="base">Reference results.</param>
+    /// <param name="current">Results to check.</param>
+    /// <param name="alpha">Significance level.</param>
+    /// <param name="minChangePercent">Minimum relative change of the median to be
+    /// reported.</param>
+    /// <returns>One comparison per metric.</returns>
+    static std::vector<Comparison> Compare(const ResultSet& base,
+        const ResultSet& current, double alpha = 0.05, double minChangePercent = 2.0);
+
+    /// <summary>
+    /// Writes a human readable comparison to a text file and the debug output.
+    /// </summary>
+    /// <param name="base">Reference results.</param>
+    /// <param name="current">Results that were checked.</param>
+    /// <param name="comparisons">Result of Compare().</param>
+    /// <param name="path">Full path of the file.</param>
+    static void WriteComparison(const ResultSet& base, const ResultSet& current,
+        const std::vector<Comparison>& comparisons, const std::string& path);
+
+    /// <summary>
+    /// Two-sided Mann-Whitney U test.
+    /// </summary>
+    /// <param name="a">First sample.</param>
+    /// <param name="b">Second sample.</param>
+    /// <returns>p-value. 1 if one of the samples is empty.</returns>
+    static double MannWhitneyU(const std::vector<double>& a,
+        const std::vector<double>& b);
+
+    /// <summary>
+    /// Returns the median of the samples.
+    /// </summary>
+    static double Median(std::vector<double> samples);
+
+private:
+    /// <summary>
+    /// Reads the current commit from the .git directory in the working directory.
+    /// </summary>
+    /// <returns>Commit hash or "unknown".</returns>
+    static std::string queryGitRevision();
+
+    /// <summary>
+    /// Queries CPU, memory and build information.
+    /// </summary>
+    static MachineInfo queryMachineInfo();
+};
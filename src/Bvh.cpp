@@ -0,0 +1,658 @@
+#include "stdafx.h"
+#include "Bvh.h"
+
+static const UINT32 NO_PARENT = UINT32_MAX;
+static const UINT32 ALL_PLANES = 0x3F;
+
+
+/// <summary>
+/// Tests a box against the planes in a mask. Planes that contain the whole box are
+/// removed from the mask, the descendants of a node do not have to test them again.
+/// </summary>
+/// <returns>False if the box is outside of one of the planes.</returns>
+static bool testPlanes(const FrustumCuller::Planes& planes, UINT32& planeMask,
+        const sm::Vector3& boxMin, const sm::Vector3& boxMax) {
+    for (UINT32 p = 0; p < 6; p++) {
+        if (!(planeMask & (1u << p))) {
+            continue;
+        }
+        // Corner furthest along the normal (p-vertex) and opposite (n-vertex).
+        // Using corners instead of center and extents keeps the test monotonic: a
+        // box inside of another never gets a result the outer box did not get.
+        const sm::Vector4& plane = planes[p];
+        float pDistance = plane.x * (plane.x >= 0.0f ? boxMax.x : boxMin.x) +
+            plane.y * (plane.y >= 0.0f ? boxMax.y : boxMin.y) +
+            plane.z * (plane.z >= 0.0f ? boxMax.z : boxMin.z) + plane.w;
+        if (pDistance < 0.0f) {
+            return false;
+        }
+        float nDistance = plane.x * (plane.x >= 0.0f ? boxMin.x : boxMax.x) +
+            plane.y * (plane.y >= 0.0f ? boxMin.y : boxMax.y) +
+            plane.z * (plane.z >= 0.0f ? boxMin.z : boxMax.z) + plane.w;
+        if (nDistance >= 0.0f) {
+            planeMask &= ~(1u << p);
+        }
+    }
+    return true;
+}
+
+
+/// <summary>
+/// Squared distance of a point to a box. Zero inside.
+/// </summary>
+static float distanceSquared(const sm::Vector3& point, const sm::Vector3& boxMin,
+        const sm::Vector3& boxMax) {
+    sm::Vector3 offset = point - sm::Vector3::Min(sm::Vector3::Max(point, boxMin),
+        boxMax);
+    return offset.Dot(offset);
+}
+
+
+/// <summary>
+/// Intersects a ray with a box (slab test).
+/// </summary>
+/// <param name="invDirection">1 / direction per axis, infinite for 0.</param>
+/// <param name="entryT">Output. Where the ray enters the box, 0 if it starts
+/// inside.</param>
+/// <returns>True if the ray hits the box within [0, maxT].</returns>
+static bool intersectRay(const sm::Vector3& origin, const sm::Vector3& invDirection,
+        float maxT, const sm::Vector3& boxMin, const sm::Vector3& boxMax, float& entryT) {
+    float tNear = 0.0f;
+    float tFar = maxT;
+    for (int axis = 0; axis < 3; axis++) {
+        float o = (&origin.x)[axis];
+        float inv = (&invDirection.x)[axis];
+        float t0 = ((&boxMin.x)[axis] - o) * inv;
+        float t1 = ((&boxMax.x)[axis] - o) * inv;
+        // NaN (0 * inf on a slab border) does not shrink the interval.
+        tNear = std::max(tNear, std::min(t0, t1));
+        tFar = std::min(tFar, std::max(t0, t1));
+    }
+    entryT = tNear;
+    return tNear <= tFar;
+}
+
+
+/// <summary>
+/// Surface area of a box. Zero for empty (inverted) boxes.
+/// </summary>
+static float surfaceArea(const sm::Vector3& boxMin, const sm::Vector3& boxMax) {
+    sm::Vector3 size = boxMax - boxMin;
+    if (size.x < 0.0f || size.y < 0.0f || size.z < 0.0f) {
+        return 0.0f;
+    }
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+
+/*
+ * Bvh::TestBox
+ */
+bool Bvh::TestBox(const FrustumCuller::Planes& planes, const sm::Vector3& boxMin,
+        const sm::Vector3& boxMax) {
+    UINT32 planeMask = ALL_PLANES;
+    return testPlanes(planes, planeMask, boxMin, boxMax);
+}
+
+
+/*
+ * Bvh::Build
+ */
+void Bvh::Build(const std::vector<dx::BoundingBox>& primBounds) {
+    Clear();
+    UINT32 primCnt = static_cast<UINT32>(primBounds.size());
+    if (primCnt == 0) {
+        return;
+    }
+
+    std::vector<BuildPrim> buildPrims(primCnt);
+    m_primMins.resize(primCnt);
+    m_primMaxs.resize(primCnt);
+    m_primIndices.resize(primCnt);
+    m_primLeaves.resize(primCnt);
+    for (UINT32 i = 0; i < primCnt; i++) {
+        sm::Vector3 center = primBounds[i].Center;
+        sm::Vector3 extents = primBounds[i].Extents;
+        m_primMins[i] = center - extents;
+        m_primMaxs[i] = center + extents;
+        buildPrims[i] = { m_primMins[i], m_primMaxs[i], center, i };
+    }
+
+    // At most 2 * primCnt - 1 nodes, plus the unused second node of the root pair.
+    m_pairs.reserve(primCnt);
+    m_parents.reserve(2 * static_cast<size_t>(primCnt));
+    m_pairs.emplace_back();
+    m_parents.assign(2, NO_PARENT);
+    m_nodeCount = 2;
+    Node& root = node(0);
+    root.first = 0;
+    root.primCount = primCnt;
+    computeBuildBounds(root, buildPrims);
+
+    // Depth-first, so children get higher indices than their parents.
+    std::vector<std::pair<UINT32, UINT32>> stack = { { 0, 0 } };   // Node, depth.
+    while (!stack.empty()) {
+        std::pair<UINT32, UINT32> entry = stack.back();
+        stack.pop_back();
+        if (entry.second < MAX_DEPTH && split(entry.first, buildPrims)) {
+            UINT32 left = node(entry.first).first;
+            stack.push_back({ left + 1, entry.second + 1 });
+            stack.push_back({ left, entry.second + 1 });
+            continue;
+        }
+
+        const Node& leaf = node(entry.first);
+        for (UINT32 i = leaf.first; i < leaf.first + leaf.primCount; i++) {
+            m_primIndices[i] = buildPrims[i].index;
+            m_primLeaves[buildPrims[i].index] = entry.first;
+        }
+    }
+
+    m_dirtyFlags.assign(m_nodeCount, 0);
+}
+
+
+/*
+ * Bvh::Clear
+ */
+void Bvh::Clear() {
+    *this = Bvh();
+}
+
+
+/*
+ * Bvh::SetPrimitiveBounds
+ */
+void Bvh::SetPrimitiveBounds(UINT32 prim, const dx::BoundingBox& bounds) {
+    sm::Vector3 center = bounds.Center;
+    sm::Vector3 extents = bounds.Extents;
+    m_primMins[prim] = center - extents;
+    m_primMaxs[prim] = center + extents;
+
+    UINT32 leaf = m_primLeaves[prim];
+    if (!m_dirtyFlags[leaf]) {
+        m_dirtyFlags[leaf] = 1;
+        m_dirtyNodes.push_back(leaf);
+    }
+}
+
+
+/*
+ * Bvh::Refit
+ */
+void Bvh::Refit() {
+    // Leaves from their primitives. Collect the ancestors, shared ones only once.
+    size_t leafCnt = m_dirtyNodes.size();
+    for (size_t i = 0; i < leafCnt; i++) {
+        UINT32 leaf = m_dirtyNodes[i];
+        computeLeafBounds(node(leaf));
+        for (UINT32 ancestor = m_parents[leaf];
+                ancestor != NO_PARENT && !m_dirtyFlags[ancestor];
+                ancestor = m_parents[ancestor]) {
+            m_dirtyFlags[ancestor] = 1;
+            m_dirtyNodes.push_back(ancestor);
+        }
+    }
+
+    // Inner nodes from their children. Deepest first (higher index).
+    std::sort(m_dirtyNodes.begin() + leafCnt, m_dirtyNodes.end(),
+        std::greater<UINT32>());
+    for (size_t i = leafCnt; i < m_dirtyNodes.size(); i++) {
+        Node& inner = node(m_dirtyNodes[i]);
+        const NodePair& children = m_pairs[inner.first / 2];
+        inner.boundsMin = sm::Vector3::Min(children.nodes[0].boundsMin,
+            children.nodes[1].boundsMin);
+        inner.boundsMax = sm::Vector3::Max(children.nodes[0].boundsMax,
+            children.nodes[1].boundsMax);
+    }
+
+    for (UINT32 nodeIdx : m_dirtyNodes) {
+        m_dirtyFlags[nodeIdx] = 0;
+    }
+    m_dirtyNodes.clear();
+}
+
+
+/*
+ * Bvh::Cull
+ */
+void Bvh::Cull(const FrustumCuller::Planes& planes, std::vector<UINT32>& visible) const {
+    visible.clear();
+    if (m_nodeCount == 0) {
+        return;
+    }
+
+    // Every pop pushes at most two nodes one level deeper.
+    struct StackEntry {
+        UINT32 node;
+        UINT32 planeMask;   // Planes that do not contain the node yet.
+    };
+    std::array<StackEntry, MAX_DEPTH + 2> stack;
+    UINT32 stackSize = 0;
+    stack[stackSize++] = { 0, ALL_PLANES };
+
+    while (stackSize > 0) {
+        StackEntry entry = stack[--stackSize];
+        const Node& current = node(entry.node);
+        UINT32 planeMask = entry.planeMask;
+        if (planeMask != 0 &&
+                !testPlanes(planes, planeMask, current.boundsMin, current.boundsMax)) {
+            continue;
+        }
+
+        if (current.primCount > 0) {
+            for (UINT32 i = current.first; i < current.first + current.primCount; i++) {
+                UINT32 prim = m_primIndices[i];
+                UINT32 primMask = planeMask;
+                if (primMask == 0 ||
+                        testPlanes(planes, primMask, m_primMins[prim], m_primMaxs[prim])) {
+                    visible.push_back(prim);
+                }
+            }
+        } else {
+            assert(stackSize + 2 <= stack.size());
+            stack[stackSize++] = { current.first + 1, planeMask };
+            stack[stackSize++] = { current.first, planeMask };
+        }
+    }
+}
+
+
+/*
+ * Bvh::QueryBox
+ */
+void Bvh::QueryBox(const sm::Vector3& boxMin, const sm::Vector3& boxMax,
+        std::vector<UINT32>& result) const {
+    result.clear();
+    if (m_nodeCount == 0) {
+        return;
+    }
+
+    auto overlaps = [&boxMin, &boxMax](const sm::Vector3& otherMin,
+            const sm::Vector3& otherMax) {
+        return otherMin.x <= boxMax.x && otherMax.x >= boxMin.x &&
+            otherMin.y <= boxMax.y && otherMax.y >= boxMin.y &&
+            otherMin.z <= boxMax.z && otherMax.z >= boxMin.z;
+    };
+    std::array<UINT32, MAX_DEPTH + 2> stack;
+    UINT32 stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& current = node(stack[--stackSize]);
+        if (!overlaps(current.boundsMin, current.boundsMax)) {
+            continue;
+        }
+        if (current.primCount > 0) {
+            for (UINT32 i = current.first; i < current.first + current.primCount; i++) {
+                UINT32 prim = m_primIndices[i];
+                if (overlaps(m_primMins[prim], m_primMaxs[prim])) {
+                    result.push_back(prim);
+                }
+            }
+        } else {
+            assert(stackSize + 2 <= stack.size());
+            stack[stackSize++] = current.first + 1;
+            stack[stackSize++] = current.first;
+        }
+    }
+}
+
+
+/*
+ * Bvh::QuerySphere
+ */
+void Bvh::QuerySphere(const sm::Vector3& center, float radius,
+        std::vector<UINT32>& result) const {
+    result.clear();
+    if (m_nodeCount == 0) {
+        return;
+    }
+
+    float radiusSquared = radius * radius;
+    std::array<UINT32, MAX_DEPTH + 2> stack;
+    UINT32 stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& current = node(stack[--stackSize]);
+        if (distanceSquared(center, current.boundsMin, current.boundsMax) >
+                radiusSquared) {
+            continue;
+        }
+        if (current.primCount > 0) {
+            for (UINT32 i = current.first; i < current.first + current.primCount; i++) {
+                UINT32 prim = m_primIndices[i];
+                if (distanceSquared(center, m_primMins[prim], m_primMaxs[prim]) <=
+                        radiusSquared) {
+                    result.push_back(prim);
+                }
+            }
+        } else {
+            assert(stackSize + 2 <= stack.size());
+            stack[stackSize++] = current.first + 1;
+            stack[stackSize++] = current.first;
+        }
+    }
+}
+
+
+/*
+ * Bvh::Raycast
+ */
+UINT32 Bvh::Raycast(const sm::Vector3& origin, const sm::Vector3& direction,
+        float& maxT, const std::function<bool(UINT32 prim, float& t)>& intersect) const {
+    if (m_nodeCount == 0) {
+        return NO_PRIMITIVE;
+    }
+
+    sm::Vector3 invDirection(1.0f / direction.x, 1.0f / direction.y,
+        1.0f / direction.z);
+    struct StackEntry {
+        UINT32 node;
+        float entryT;
+    };
+    std::array<StackEntry, MAX_DEPTH + 2> stack;
+    UINT32 stackSize = 0;
+    float rootT;
+    if (!intersectRay(origin, invDirection, maxT, node(0).boundsMin, node(0).boundsMax,
+            rootT)) {
+        return NO_PRIMITIVE;
+    }
+    stack[stackSize++] = { 0, rootT };
+
+    UINT32 nearest = NO_PRIMITIVE;
+    while (stackSize > 0) {
+        StackEntry entry = stack[--stackSize];
+        if (entry.entryT > maxT) {
+            continue;   // A closer hit was found after the node was pushed.
+        }
+        const Node& current = node(entry.node);
+        if (current.primCount > 0) {
+            for (UINT32 i = current.first; i < current.first + current.primCount; i++) {
+                UINT32 prim = m_primIndices[i];
+                float primT;
+                if (intersectRay(origin, invDirection, maxT, m_primMins[prim],
+                        m_primMaxs[prim], primT) && intersect(prim, maxT)) {
+                    nearest = prim;
+                }
+            }
+            continue;
+        }
+
+        // The nearer child is popped first.
+        std::array<StackEntry, 2> children;
+        UINT32 childCnt = 0;
+        for (UINT32 child = current.first; child < current.first + 2; child++) {
+            float childT;
+            if (intersectRay(origin, invDirection, maxT, node(child).boundsMin,
+                    node(child).boundsMax, childT)) {
+                children[childCnt++] = { child, childT };
+            }
+        }
+        if (childCnt == 2 && children[0].entryT < children[1].entryT) {
+            std::swap(children[0], children[1]);
+        }
+        assert(stackSize + childCnt <= stack.size());
+        for (UINT32 i = 0; i < childCnt; i++) {
+            stack[stackSize++] = children[i];
+        }
+    }
+    return nearest;
+}
+
+
+/*
+ * Bvh::Traverse
+ */
+void Bvh::Traverse(const std::function<bool(const sm::Vector3& boundsMin,
+        const sm::Vector3& boundsMax, UINT32 first, UINT32 count, bool isLeaf)>& visit)
+        const {
+    if (m_nodeCount == 0) {
+        return;
+    }
+
+    // The children split the range of their parent where the leftmost leaf of the
+    // right child starts. Every node is on the left chain of one right child (or
+    // the root), so finding those starts visits each node once at most.
+    struct StackEntry {
+        UINT32 node;
+        UINT32 first;
+        UINT32 end;
+    };
+    std::array<StackEntry, MAX_DEPTH + 2> stack;
+    UINT32 stackSize = 0;
+    stack[stackSize++] = { 0, 0, static_cast<UINT32>(m_primIndices.size()) };
+    while (stackSize > 0) {
+        StackEntry entry = stack[--stackSize];
+        const Node& current = node(entry.node);
+        bool isLeaf = current.primCount > 0;
+        assert(!isLeaf || (entry.first == current.first &&
+            entry.end - entry.first == current.primCount));
+        if (!visit(current.boundsMin, current.boundsMax, entry.first,
+                entry.end - entry.first, isLeaf) || isLeaf) {
+            continue;
+        }
+
+        const Node* leftmost = &node(current.first + 1);
+        while (leftmost->primCount == 0) {
+            leftmost = &node(leftmost->first);
+        }
+        assert(stackSize + 2 <= stack.size());
+        stack[stackSize++] = { current.first + 1, leftmost->first, entry.end };
+        stack[stackSize++] = { current.first, entry.first, leftmost->first };
+    }
+}
+
+
+/*
+ * Bvh::GetOrderedPrimitives
+ */
+const std::vector<UINT32>& Bvh::GetOrderedPrimitives() const {
+    return m_primIndices;
+}
+
+
+/*
+ * Bvh::GetPrimitiveCount
+ */
+UINT32 Bvh::GetPrimitiveCount() const {
+    return static_cast<UINT32>(m_primMins.size());
+}
+
+
+/*
+ * Bvh::GetNodeCount
+ */
+UINT32 Bvh::GetNodeCount() const {
+    // Node 1 is unused.
+    return m_nodeCount > 0 ? m_nodeCount - 1 : 0;
+}
+
+
+/*
+ * Bvh::GetBounds
+ */
+dx::BoundingBox Bvh::GetBounds() const {
+    if (m_nodeCount == 0) {
+        return dx::BoundingBox();
+    }
+    const Node& root = node(0);
+    return dx::BoundingBox((root.boundsMin + root.boundsMax) * 0.5f,
+        (root.boundsMax - root.boundsMin) * 0.5f);
+}
+
+
+/*
+ * Bvh::ComputeCost
+ */
+float Bvh::ComputeCost() const {
+    if (m_nodeCount == 0) {
+        return 0.0f;
+    }
+    float cost = 0.0f;
+    for (UINT32 nodeIdx = 0; nodeIdx < m_nodeCount; nodeIdx++) {
+        if (nodeIdx == 1) {
+            continue;
+        }
+        const Node& current = node(nodeIdx);
+        float area = surfaceArea(current.boundsMin, current.boundsMax);
+        cost += current.primCount > 0 ? area * current.primCount : area;
+    }
+    float rootArea = surfaceArea(node(0).boundsMin, node(0).boundsMax);
+    return rootArea > 0.0f ? cost / rootArea : 0.0f;
+}
+
+
+/*
+ * Bvh::node
+ */
+Bvh::Node& Bvh::node(UINT32 idx) {
+    return m_pairs[idx / 2].nodes[idx % 2];
+}
+
+
+/*
+ * Bvh::node
+ */
+const Bvh::Node& Bvh::node(UINT32 idx) const {
+    return m_pairs[idx / 2].nodes[idx % 2];
+}
+
+
+/*
+ * Bvh::computeLeafBounds
+ */
+void Bvh::computeLeafBounds(Node& leaf) const {
+    leaf.boundsMin = sm::Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+    leaf.boundsMax = sm::Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (UINT32 i = leaf.first; i < leaf.first + leaf.primCount; i++) {
+        UINT32 prim = m_primIndices[i];
+        leaf.boundsMin = sm::Vector3::Min(leaf.boundsMin, m_primMins[prim]);
+        leaf.boundsMax = sm::Vector3::Max(leaf.boundsMax, m_primMaxs[prim]);
+    }
+}
+
+
+/*
+ * Bvh::computeBuildBounds
+ */
+void Bvh::computeBuildBounds(Node& target, const std::vector<BuildPrim>& buildPrims) {
+    target.boundsMin = sm::Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+    target.boundsMax = sm::Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (UINT32 i = target.first; i < target.first + target.primCount; i++) {
+        target.boundsMin = sm::Vector3::Min(target.boundsMin, buildPrims[i].boundsMin);
+        target.boundsMax = sm::Vector3::Max(target.boundsMax, buildPrims[i].boundsMax);
+    }
+}
+
+
+/*
+ * Bvh::split
+ */
+bool Bvh::split(UINT32 nodeIdx, std::vector<BuildPrim>& buildPrims) {
+    UINT32 first = node(nodeIdx).first;
+    UINT32 primCnt = node(nodeIdx).primCount;
+    if (primCnt <= MAX_LEAF_SIZE) {
+        return false;
+    }
+
+    // Bins are placed over the bounds of the centroids, not of the primitives.
+    sm::Vector3 centroidMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    sm::Vector3 centroidMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (UINT32 i = first; i < first + primCnt; i++) {
+        centroidMin = sm::Vector3::Min(centroidMin, buildPrims[i].centroid);
+        centroidMax = sm::Vector3::Max(centroidMax, buildPrims[i].centroid);
+    }
+
+    // Find the split with the lowest SAH cost over all axes. The cost is relative
+    // (area of the parent and traversal cost are the same for all splits).
+    struct Bin {
+        sm::Vector3 boundsMin = sm::Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+        sm::Vector3 boundsMax = sm::Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        UINT32 primCount = 0;
+    };
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    UINT32 bestBin = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float axisMin = (&centroidMin.x)[axis];
+        float extent = (&centroidMax.x)[axis] - axisMin;
+        if (extent <= 0.0f) {
+            continue;
+        }
+        float binScale = BIN_COUNT / extent;
+
+        std::array<Bin, BIN_COUNT> bins;
+        for (UINT32 i = first; i < first + primCnt; i++) {
+            const BuildPrim& prim = buildPrims[i];
+            UINT32 binIdx = std::min(BIN_COUNT - 1, static_cast<UINT32>(
+                ((&prim.centroid.x)[axis] - axisMin) * binScale));
+            Bin& bin = bins[binIdx];
+            bin.boundsMin = sm::Vector3::Min(bin.boundsMin, prim.boundsMin);
+            bin.boundsMax = sm::Vector3::Max(bin.boundsMax, prim.boundsMax);
+            bin.primCount++;
+        }
+
+        // Sweep from the right, then from the left. Split i keeps bins [0, i].
+        std::array<float, BIN_COUNT - 1> rightCosts;
+        Bin right;
+        for (UINT32 i = BIN_COUNT - 1; i > 0; i--) {
+            right.boundsMin = sm::Vector3::Min(right.boundsMin, bins[i].boundsMin);
+            right.boundsMax = sm::Vector3::Max(right.boundsMax, bins[i].boundsMax);
+            right.primCount += bins[i].primCount;
+            rightCosts[i - 1] = right.primCount == 0 ? -1.0f :
+                right.primCount * surfaceArea(right.boundsMin, right.boundsMax);
+        }
+        Bin left;
+        for (UINT32 i = 0; i < BIN_COUNT - 1; i++) {
+            left.boundsMin = sm::Vector3::Min(left.boundsMin, bins[i].boundsMin);
+            left.boundsMax = sm::Vector3::Max(left.boundsMax, bins[i].boundsMax);
+            left.primCount += bins[i].primCount;
+            if (left.primCount == 0 || rightCosts[i] < 0.0f) {
+                continue;   // Empty side.
+            }
+            float cost = left.primCount * surfaceArea(left.boundsMin, left.boundsMax) +
+                rightCosts[i];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = i;
+            }
+        }
+    }
+
+    UINT32 leftCnt;
+    if (bestAxis >= 0) {
+        float axisMin = (&centroidMin.x)[bestAxis];
+        float binScale = BIN_COUNT / ((&centroidMax.x)[bestAxis] - axisMin);
+        auto middle = std::partition(buildPrims.begin() + first,
+            buildPrims.begin() + first + primCnt, [&](const BuildPrim& prim) {
+                return std::min(BIN_COUNT - 1, static_cast<UINT32>(
+                    ((&prim.centroid.x)[bestAxis] - axisMin) * binScale)) <= bestBin;
+            });
+        leftCnt = static_cast<UINT32>(middle - (buildPrims.begin() + first));
+    } else {
+        // All centroids in one point. Any split is as good as any other.
+        leftCnt = primCnt / 2;
+    }
+
+    // Children as a new pair.
+    UINT32 left = m_nodeCount;
+    m_pairs.emplace_back();
+    m_parents.push_back(nodeIdx);
+    m_parents.push_back(nodeIdx);
+    m_nodeCount += 2;
+
+    Node& leftNode = node(left);
+    leftNode.first = first;
+    leftNode.primCount = leftCnt;
+    computeBuildBounds(leftNode, buildPrims);
+    Node& rightNode = node(left + 1);
+    rightNode.first = first + leftCnt;
+    rightNode.primCount = primCnt - leftCnt;
+    computeBuildBounds(rightNode, buildPrims);
+
+    Node& parent = node(nodeIdx);
+    parent.first = left;
+    parent.primCount = 0;
+    return true;
+}
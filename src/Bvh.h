@@ -0,0 +1,204 @@
+#pragma once
+#include "FrustumCuller.h"
+
+/// <summary>
+/// Bounding volume hierarchy over axis-aligned boxes (primitives), e.g. the world
+/// bounds of meshes. Used to cull many primitives with few box tests.
+/// </summary>
+/// <remarks>
+/// Built top-down with binned SAH. Nodes are 32 bytes and siblings are stored as
+/// 64-byte aligned pairs, so a traversal step tests both children from a single
+/// cache line. The primitives of every subtree are a contiguous range of the index
+/// list.
+/// Moving primitives only requires a refit (SetPrimitiveBounds() and Refit()), which
+/// keeps the topology. The quality degrades if primitives move far, rebuild then.
+/// Besides frustum culling, the hierarchy answers box, sphere and nearest-hit ray
+/// queries against the bounds of the primitives.
+/// </remarks>
+class Bvh {
+public:
+    /// <summary>
+    /// Leaves do not get split below this number of primitives.
+    /// </summary>
+    static const UINT32 MAX_LEAF_SIZE = 4;
+
+    /// <summary>
+    /// Number of bins per axis for the SAH split search.
+    /// </summary>
+    static const UINT32 BIN_COUNT = 16;
+
+    /// <summary>
+    /// Maximum depth. Deeper subtrees become (large) leaves. Bounds the traversal
+    /// stack.
+    /// </summary>
+    static const UINT32 MAX_DEPTH = 64;
+
+    /// <summary>
+    /// Result of Raycast() if nothing was hit.
+    /// </summary>
+    static const UINT32 NO_PRIMITIVE = UINT32_MAX;
+
+    /// <summary>
+    /// Tests a box given as min/max corners against frustum planes. Reference for
+    /// the traversal, which uses the same test on its nodes.
+    /// </summary>
+    /// <returns>True if the box is (potentially) visible.</returns>
+    static bool TestBox(const FrustumCuller::Planes& planes, const sm::Vector3& boxMin,
+        const sm::Vector3& boxMax);
+
+    /// <summary>
+    /// Builds the hierarchy from scratch.
+    /// </summary>
+    /// <param name="primBounds">Bounds per primitive. The index of a primitive is
+    /// its index in here.</param>
+    void Build(const std::vector<dx::BoundingBox>& primBounds);
+
+    /// <summary>
+    /// Removes all primitives and nodes.
+    /// </summary>
+    void Clear();
+
+    /// <summary>
+    /// Changes the bounds of a primitive. The nodes above it are recomputed with the
+    /// next Refit().
+    /// </summary>
+    void SetPrimitiveBounds(UINT32 prim, const dx::BoundingBox& bounds);
+
+    /// <summary>
+    /// Recomputes the bounds of all nodes above primitives that changed.
+    /// </summary>
+    void Refit();
+
+    /// <summary>
+    /// Collects all primitives that are (potentially) visible. Subtrees outside of a
+    /// plane are skipped, subtrees inside of all planes are accepted without further
+    /// tests. The result is the same as testing every primitive with TestBox().
+    /// </summary>
+    /// <param name="planes">Frustum planes (see FrustumCuller::ExtractPlanes).
+    /// </param>
+    /// <param name="visible">Output. Cleared first, in no particular order.</param>
+    void Cull(const FrustumCuller::Planes& planes, std::vector<UINT32>& visible) const;
+
+    /// <summary>
+    /// Collects all primitives whose bounds overlap a box.
+    /// </summary>
+    /// <param name="result">Output. Cleared first, in no particular order.</param>
+    void QueryBox(const sm::Vector3& boxMin, const sm::Vector3& boxMax,
+        std::vector<UINT32>& result) const;
+
+    /// <summary>
+    /// Collects all primitives whose bounds intersect a sphere.
+    /// </summary>
+    /// <param name="result">Output. Cleared first, in no particular order.</param>
+    void QuerySphere(const sm::Vector3& center, float radius,
+        std::vector<UINT32>& result) const;
+
+    /// <summary>
+    /// Finds the nearest primitive along a ray. Nodes are visited front to back and
+    /// skipped if they start behind the nearest hit so far.
+    /// </summary>
+    /// <param name="origin">Start of the ray.</param>
+    /// <param name="direction">Direction of the ray, t is measured in its length.
+    /// </param>
+    /// <param name="maxT">Input: end of the ray. Output: t of the nearest hit.</param>
+    /// <param name="intersect">Intersects a primitive whose bounds the ray hits.
+    /// Returns true and lowers t if the primitive is hit before t.</param>
+    /// <returns>The nearest primitive that was hit or NO_PRIMITIVE.</returns>
+    UINT32 Raycast(const sm::Vector3& origin, const sm::Vector3& direction, float& maxT,
+        const std::function<bool(UINT32 prim, float& t)>& intersect) const;
+
+    /// <summary>
+    /// Visits the nodes top-down, e.g. to cut the hierarchy where its nodes get
+    /// small enough.
+    /// </summary>
+    /// <param name="visit">Gets the bounds of a node and the primitives of its
+    /// subtree, the range [first, first + count) of GetOrderedPrimitives(). Returns
+    /// true to visit the children, which leaves do not have.</param>
+    void Traverse(const std::function<bool(const sm::Vector3& boundsMin,
+        const sm::Vector3& boundsMax, UINT32 first, UINT32 count, bool isLeaf)>& visit)
+        const;
+
+    /// <summary>
+    /// Returns the primitives ordered by leaf, so every subtree is a range.
+    /// </summary>
+    const std::vector<UINT32>& GetOrderedPrimitives() const;
+
+    UINT32 GetPrimitiveCount() const;
+    UINT32 GetNodeCount() const;
+
+    /// <summary>
+    /// Returns the bounds of the root node, i.e. of all primitives.
+    /// </summary>
+    dx::BoundingBox GetBounds() const;
+
+    /// <summary>
+    /// Returns the SAH cost of the hierarchy (expected number of node and primitive
+    /// tests for a random ray, relative to the root). Lower is better.
+    /// </summary>
+    float ComputeCost() const;
+
+private:
+    /// <summary>
+    /// Leaf if primCount > 0 (primitives [first, first + primCount) of the index
+    /// list), otherwise the children are the nodes first and first + 1.
+    /// </summary>
+    struct Node {
+        sm::Vector3 boundsMin;
+        UINT32 first;
+        sm::Vector3 boundsMax;
+        UINT32 primCount;
+    };
+
+    /// <summary>
+    /// Siblings. Node i is nodes[i & 1] of pair i / 2. The root is node 0, node 1 is
+    /// unused.
+    /// </summary>
+    struct alignas(64) NodePair {
+        Node nodes[2];
+    };
+
+    Node& node(UINT32 idx);
+    const Node& node(UINT32 idx) const;
+
+    /// <summary>
+    /// Computes the bounds of a node from its primitives.
+    /// </summary>
+    void computeLeafBounds(Node& leaf) const;
+
+    /// <summary>
+    /// Primitive during the build. Partitioned in place, so the primitives of a node
+    /// are contiguous in memory.
+    /// </summary>
+    struct BuildPrim {
+        sm::Vector3 boundsMin;
+        sm::Vector3 boundsMax;
+        sm::Vector3 centroid;
+        UINT32 index;
+    };
+
+    /// <summary>
+    /// Splits a node with binned SAH, unless it is small enough to be a leaf.
+    /// </summary>
+    /// <returns>True if the node was split.</returns>
+    bool split(UINT32 nodeIdx, std::vector<BuildPrim>& buildPrims);
+
+    /// <summary>
+    /// Computes the bounds of a range of build primitives.
+    /// </summary>
+    static void computeBuildBounds(Node& target, const std::vector<BuildPrim>& buildPrims);
+
+    // Nodes in pairs, parent per node.
+    std::vector<NodePair> m_pairs;
+    std::vector<UINT32> m_parents;
+    UINT32 m_nodeCount = 0;
+
+    // Primitives, in the order of the input.
+    std::vector<sm::Vector3> m_primMins;
+    std::vector<sm::Vector3> m_primMaxs;
+    std::vector<UINT32> m_primIndices;  // Ordered by leaf.
+    std::vector<UINT32> m_primLeaves;   // Leaf per primitive.
+
+    // Refit tracking.
+    std::vector<UINT8> m_dirtyFlags;    // Per node.
+    std::vector<UINT32> m_dirtyNodes;
+};
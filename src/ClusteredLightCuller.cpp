@@ -0,0 +1,580 @@
+#include "stdafx.h"
+#include "ClusteredLightCuller.h"
+#include "WorkerPool.h"
+
+
+// Lights a thread transforms at once.
+static const UINT32 LIGHT_BLOCK_SIZE = 256;
+
+
+/*
+ * ClusteredLightCuller::ClusteredLightCuller
+ */
+ClusteredLightCuller::ClusteredLightCuller(UINT32 clustersX, UINT32 clustersY,
+        UINT32 clustersZ) : m_clustersX(clustersX), m_clustersY(clustersY),
+        m_clustersZ(clustersZ) {
+    assert(clustersX > 0 && clustersY > 0 && clustersZ > 0);
+    size_t clusterCnt = static_cast<size_t>(clustersX) * clustersY * clustersZ;
+    m_clusterLights.resize(clusterCnt);
+    m_clusterRanges.assign(clusterCnt, { 0, 0 });
+    m_sliceLights.resize(clustersZ);
+    m_sliceCandidates.resize(clustersZ);
+
+    // Something valid until the first SetProjection().
+    SetProjection(sm::Matrix::CreatePerspectiveFieldOfView(dx::XM_PI / 4.0f, 1.0f, 1.0f,
+        100.0f));
+}
+
+
+/*
+ * ClusteredLightCuller::SetProjection
+ */
+void ClusteredLightCuller::SetProjection(const sm::Matrix& projMat) {
+    assert(projMat._34 == -1.0f && projMat._44 == 0.0f);
+    if (projMat == m_projMat && !m_clusterMin.empty()) {
+        return;
+    }
+    m_projMat = projMat;
+
+    // z/w = -_33 + _43 / depth is 0 at the near and 1 at the far plane.
+    m_nearPlane = projMat._43 / projMat._33;
+    m_farPlane = projMat._43 / (projMat._33 + 1.0f);
+    m_sliceScale = m_clustersZ / std::log(m_farPlane / m_nearPlane);
+    m_sliceBias = -std::log(m_nearPlane) * m_sliceScale;
+    computeClusterBounds();
+    m_reassignAll = true;
+}
+
+
+/*
+ * ClusteredLightCuller::SetView
+ */
+void ClusteredLightCuller::SetView(const sm::Matrix& viewMat) {
+    if (viewMat != m_viewMat) {
+        m_viewMat = viewMat;
+        m_isViewChanged = true;
+    }
+}
+
+
+/*
+ * ClusteredLightCuller::SetLights
+ */
+void ClusteredLightCuller::SetLights(const std::vector<sm::Vector4>& lights) {
+    // The same lights keep their indices, only the ones that differ are changed.
+    if (lights.size() == m_lights.size()) {
+        for (UINT32 i = 0; i < lights.size(); i++) {
+            if (lights[i] != m_lights[i]) {
+                SetLight(i, lights[i]);
+            }
+        }
+        return;
+    }
+    m_lights = lights;
+    m_viewCenters.resize(lights.size());
+    m_newFootprints.resize(lights.size());
+    m_isChanged.assign(lights.size(), false);
+    m_isMoved.assign(lights.size(), 0);
+    m_isCandidate.assign(lights.size(), 0);
+    m_changedLights.clear();
+    m_reassignAll = true;
+}
+
+
+/*
+ * ClusteredLightCuller::SetLight
+ */
+void ClusteredLightCuller::SetLight(UINT32 idx, const sm::Vector4& light) {
+    m_lights[idx] = light;
+    if (!m_isChanged[idx]) {
+        m_isChanged[idx] = true;
+        m_changedLights.push_back(idx);
+    }
+}
+
+
+/*
+ * ClusteredLightCuller::SetLightBvh
+ */
+void ClusteredLightCuller::SetLightBvh(const LightBvh* lightBvh) {
+    m_lightBvh = lightBvh;
+}
+
+
+/*
+ * ClusteredLightCuller::Update
+ */
+void ClusteredLightCuller::Update() {
+    // Start from empty clusters, every light is new.
+    if (m_reassignAll) {
+        for (std::vector<UINT32>& lights : m_clusterLights) {
+            lights.clear();
+        }
+        m_footprints.assign(m_lights.size(), Footprint());
+    }
+
+    // After a change of the view every light may have moved in view space. The
+    // ones that did not, and the ones outside of the frustum before and after,
+    // keep their clusters. The BVH finds the lights that may be inside, the others
+    // are not transformed at all.
+    bool transformAll = m_reassignAll || m_isViewChanged;
+    bool useCandidates = transformAll && m_lightBvh != nullptr;
+    if (useCandidates) {
+        assert(m_lightBvh->GetCount() == m_lights.size());
+        if (m_threadCnt <= 1) {
+            for (UINT32 z = 0; z < m_clustersZ; z++) {
+                querySlice(z);
+            }
+        } else {
+            std::atomic<UINT32> nextSlice = 0;
+            WorkerPool::Get().Run(m_threadCnt, [this, &nextSlice](unsigned int) {
+                for (UINT32 z = nextSlice++; z < m_clustersZ; z = nextSlice++) {
+                    querySlice(z);
+                }
+            });
+        }
+        collectCandidates();
+    }
+    const std::vector<UINT32>& transformLights = useCandidates ? m_candidateLights :
+        m_changedLights;
+    bool transformList = !transformAll || useCandidates;
+    size_t transformCnt = transformList ? transformLights.size() : m_lights.size();
+    m_transformedLightCnt = static_cast<UINT32>(transformCnt);
+    UINT32 blockCnt = static_cast<UINT32>(
+        (transformCnt + LIGHT_BLOCK_SIZE - 1) / LIGHT_BLOCK_SIZE);
+    auto computeBlock = [this, &transformLights, transformList, transformCnt](
+            UINT32 block) {
+        size_t first = static_cast<size_t>(block) * LIGHT_BLOCK_SIZE;
+        size_t last = std::min(first + LIGHT_BLOCK_SIZE, transformCnt);
+        for (size_t i = first; i < last; i++) {
+            UINT32 light = transformList ? transformLights[i] : static_cast<UINT32>(i);
+            const sm::Vector4& sphere = m_lights[light];
+            sm::Vector3 viewCenter = sm::Vector3::Transform(
+                sm::Vector3(sphere.x, sphere.y, sphere.z), m_viewMat);
+            if (!m_reassignAll && !m_isChanged[light] &&
+                    viewCenter == m_viewCenters[light]) {
+                m_isMoved[light] = 0;
+                continue;
+            }
+            m_viewCenters[light] = viewCenter;
+            m_newFootprints[light] = computeFootprint(viewCenter, sphere.w);
+            const Footprint& oldFootprint = m_footprints[light];
+            m_isMoved[light] = oldFootprint.x0 <= oldFootprint.x1 ||
+                m_newFootprints[light].x0 <= m_newFootprints[light].x1;
+        }
+    };
+
+    // Lights that no cluster gets or loses are left out.
+    auto collectMovedLights = [this, transformAll, useCandidates]() {
+        for (UINT32 light : m_changedLights) {
+            m_isChanged[light] = false;
+        }
+        if (useCandidates) {
+            m_changedLights.clear();
+            for (UINT32 light : m_candidateLights) {
+                if (m_isMoved[light]) {
+                    m_changedLights.push_back(light);
+                }
+            }
+        } else if (transformAll) {
+            m_changedLights.clear();
+            for (UINT32 light = 0; light < m_lights.size(); light++) {
+                if (m_isMoved[light]) {
+                    m_changedLights.push_back(light);
+                }
+            }
+        } else {
+            m_changedLights.erase(std::remove_if(m_changedLights.begin(),
+                m_changedLights.end(), [this](UINT32 light) {
+                    return !m_isMoved[light];
+                }), m_changedLights.end());
+        }
+        m_reassignedLightCnt = static_cast<UINT32>(m_changedLights.size());
+    };
+
+    // A slice gets a light if the light leaves or enters any of its clusters.
+    auto binSlices = [this]() {
+        for (std::vector<UINT32>& lights : m_sliceLights) {
+            lights.clear();
+        }
+        for (UINT32 light : m_changedLights) {
+            const Footprint& oldFootprint = m_footprints[light];
+            const Footprint& newFootprint = m_newFootprints[light];
+            for (INT32 z = oldFootprint.z0; z <= oldFootprint.z1; z++) {
+                m_sliceLights[z].push_back(light);
+            }
+            for (INT32 z = newFootprint.z0; z <= newFootprint.z1; z++) {
+                if (z < oldFootprint.z0 || z > oldFootprint.z1) {
+                    m_sliceLights[z].push_back(light);
+                }
+            }
+        }
+    };
+
+    if (m_threadCnt <= 1) {
+        for (UINT32 block = 0; block < blockCnt; block++) {
+            computeBlock(block);
+        }
+        collectMovedLights();
+        binSlices();
+        for (UINT32 z = 0; z < m_clustersZ; z++) {
+            updateSlice(z);
+        }
+    } else {
+        // Threads take the next free block of lights, then the next free slice.
+        std::atomic<UINT32> nextBlock = 0;
+        std::atomic<UINT32> nextSlice = 0;
+        WorkerPool& pool = WorkerPool::Get();
+        pool.Run(m_threadCnt, [&nextBlock, blockCnt, &computeBlock](unsigned int) {
+            for (UINT32 block = nextBlock++; block < blockCnt; block = nextBlock++) {
+                computeBlock(block);
+            }
+        });
+        collectMovedLights();
+        binSlices();
+        if (!m_changedLights.empty()) {
+            pool.Run(m_threadCnt, [this, &nextSlice](unsigned int) {
+                for (UINT32 z = nextSlice++; z < m_clustersZ; z = nextSlice++) {
+                    updateSlice(z);
+                }
+            });
+        }
+    }
+
+    bool isAssignmentChanged = m_reassignAll || !m_changedLights.empty();
+    for (UINT32 light : m_changedLights) {
+        m_footprints[light] = m_newFootprints[light];
+    }
+    m_changedLights.clear();
+    m_reassignAll = false;
+    m_isViewChanged = false;
+    if (!isAssignmentChanged) {
+        return;
+    }
+
+    // Compaction.
+    UINT32 offset = 0;
+    for (size_t cluster = 0; cluster < m_clusterLights.size(); cluster++) {
+        UINT32 count = static_cast<UINT32>(m_clusterLights[cluster].size());
+        m_clusterRanges[cluster] = { offset, count };
+        offset += count;
+    }
+    m_lightIndices.resize(offset);
+    for (size_t cluster = 0; cluster < m_clusterLights.size(); cluster++) {
+        std::copy(m_clusterLights[cluster].begin(), m_clusterLights[cluster].end(),
+            m_lightIndices.begin() + m_clusterRanges[cluster].offset);
+    }
+}
+
+
+/*
+ * ClusteredLightCuller::SetThreadCount
+ */
+void ClusteredLightCuller::SetThreadCount(UINT32 threadCnt) {
+    m_threadCnt = std::max(threadCnt, 1u);
+}
+
+
+/*
+ * ClusteredLightCuller::GetClustersX
+ */
+UINT32 ClusteredLightCuller::GetClustersX() const {
+    return m_clustersX;
+}
+
+
+/*
+ * ClusteredLightCuller::GetClustersY
+ */
+UINT32 ClusteredLightCuller::GetClustersY() const {
+    return m_clustersY;
+}
+
+
+/*
+ * ClusteredLightCuller::GetClustersZ
+ */
+UINT32 ClusteredLightCuller::GetClustersZ() const {
+    return m_clustersZ;
+}
+
+
+/*
+ * ClusteredLightCuller::GetClusterIndex
+ */
+UINT32 ClusteredLightCuller::GetClusterIndex(UINT32 x, UINT32 y, UINT32 z) const {
+    return (z * m_clustersY + y) * m_clustersX + x;
+}
+
+
+/*
+ * ClusteredLightCuller::GetClusterBounds
+ */
+dx::BoundingBox ClusteredLightCuller::GetClusterBounds(UINT32 cluster) const {
+    dx::BoundingBox bounds;
+    dx::BoundingBox::CreateFromPoints(bounds, m_clusterMin[cluster],
+        m_clusterMax[cluster]);
+    return bounds;
+}
+
+
+/*
+ * ClusteredLightCuller::GetSliceScale
+ */
+float ClusteredLightCuller::GetSliceScale() const {
+    return m_sliceScale;
+}
+
+
+/*
+ * ClusteredLightCuller::GetSliceBias
+ */
+float ClusteredLightCuller::GetSliceBias() const {
+    return m_sliceBias;
+}
+
+
+/*
+ * ClusteredLightCuller::GetClusterRanges
+ */
+const std::vector<ClusteredLightCuller::ClusterRange>&
+        ClusteredLightCuller::GetClusterRanges() const {
+    return m_clusterRanges;
+}
+
+
+/*
+ * ClusteredLightCuller::GetLightIndices
+ */
+const std::vector<UINT32>& ClusteredLightCuller::GetLightIndices() const {
+    return m_lightIndices;
+}
+
+
+/*
+ * ClusteredLightCuller::GetReassignedLightCount
+ */
+UINT32 ClusteredLightCuller::GetReassignedLightCount() const {
+    return m_reassignedLightCnt;
+}
+
+
+/*
+ * ClusteredLightCuller::GetTransformedLightCount
+ */
+UINT32 ClusteredLightCuller::GetTransformedLightCount() const {
+    return m_transformedLightCnt;
+}
+
+
+/*
+ * ClusteredLightCuller::computeClusterBounds
+ */
+void ClusteredLightCuller::computeClusterBounds() {
+    size_t clusterCnt = static_cast<size_t>(m_clustersX) * m_clustersY * m_clustersZ;
+    m_clusterMin.resize(clusterCnt);
+    m_clusterMax.resize(clusterCnt);
+    m_sliceMin.assign(m_clustersZ, sm::Vector3(FLT_MAX));
+    m_sliceMax.assign(m_clustersZ, sm::Vector3(-FLT_MAX));
+
+    // A tile is bounded by planes through the eye, x / depth is constant on them.
+    // The box of a cluster spans its tile at the near and at the far depth.
+    for (UINT32 z = 0; z < m_clustersZ; z++) {
+        float nearDepth = m_nearPlane * std::pow(m_farPlane / m_nearPlane,
+            float(z) / m_clustersZ);
+        float farDepth = m_nearPlane * std::pow(m_farPlane / m_nearPlane,
+            float(z + 1) / m_clustersZ);
+        for (UINT32 y = 0; y < m_clustersY; y++) {
+            float top = 1.0f - 2.0f * y / m_clustersY;
+            float bottom = 1.0f - 2.0f * (y + 1) / m_clustersY;
+            float slopeY0 = (bottom + m_projMat._32) / m_projMat._22;
+            float slopeY1 = (top + m_projMat._32) / m_projMat._22;
+            for (UINT32 x = 0; x < m_clustersX; x++) {
+                float left = -1.0f + 2.0f * x / m_clustersX;
+                float right = -1.0f + 2.0f * (x + 1) / m_clustersX;
+                float slopeX0 = (left + m_projMat._31) / m_projMat._11;
+                float slopeX1 = (right + m_projMat._31) / m_projMat._11;
+
+                UINT32 cluster = GetClusterIndex(x, y, z);
+                m_clusterMin[cluster] = sm::Vector3(
+                    std::min(slopeX0 * nearDepth, slopeX0 * farDepth),
+                    std::min(slopeY0 * nearDepth, slopeY0 * farDepth), -farDepth);
+                m_clusterMax[cluster] = sm::Vector3(
+                    std::max(slopeX1 * nearDepth, slopeX1 * farDepth),
+                    std::max(slopeY1 * nearDepth, slopeY1 * farDepth), -nearDepth);
+                m_sliceMin[z] = sm::Vector3::Min(m_sliceMin[z], m_clusterMin[cluster]);
+                m_sliceMax[z] = sm::Vector3::Max(m_sliceMax[z], m_clusterMax[cluster]);
+            }
+        }
+    }
+}
+
+
+/*
+ * ClusteredLightCuller::computeFootprint
+ */
+ClusteredLightCuller::Footprint ClusteredLightCuller::computeFootprint(
+        const sm::Vector3& viewCenter, float radius) const {
+    Footprint footprint;
+    float depth = -viewCenter.z;
+    if (depth + radius < m_nearPlane || depth - radius > m_farPlane) {
+        return footprint;
+    }
+
+    // Rectangle of the tangents like TiledLightCuller, spheres around the eye
+    // cover the whole screen.
+    float x0 = 0.0f;
+    float x1 = float(m_clustersX);
+    float y0 = 0.0f;
+    float y1 = float(m_clustersY);
+    if (depth > radius) {
+        float denom = depth * depth - radius * radius;
+        float rootX = std::sqrt(viewCenter.x * viewCenter.x + denom);
+        float rootY = std::sqrt(viewCenter.y * viewCenter.y + denom);
+        float minX = (viewCenter.x * depth - radius * rootX) / denom;
+        float maxX = (viewCenter.x * depth + radius * rootX) / denom;
+        float minY = (viewCenter.y * depth - radius * rootY) / denom;
+        float maxY = (viewCenter.y * depth + radius * rootY) / denom;
+        x0 = (minX * m_projMat._11 - m_projMat._31 + 1.0f) * 0.5f * m_clustersX;
+        x1 = (maxX * m_projMat._11 - m_projMat._31 + 1.0f) * 0.5f * m_clustersX;
+        y0 = (1.0f - (maxY * m_projMat._22 - m_projMat._32)) * 0.5f * m_clustersY;
+        y1 = (1.0f - (minY * m_projMat._22 - m_projMat._32)) * 0.5f * m_clustersY;
+        if (x1 < 0.0f || x0 >= m_clustersX || y1 < 0.0f || y0 >= m_clustersY) {
+            return footprint;
+        }
+    }
+
+    // One more cluster on every side against rounding, testCluster() decides.
+    auto clampCluster = [](float value, UINT32 clusterCnt) {
+        return static_cast<INT32>(std::min(std::max(value, 0.0f), clusterCnt - 1.0f));
+    };
+    float minSlice = std::log(std::max(depth - radius, m_nearPlane)) * m_sliceScale +
+        m_sliceBias;
+    float maxSlice = std::log(std::min(depth + radius, m_farPlane)) * m_sliceScale +
+        m_sliceBias;
+    footprint.x0 = clampCluster(x0 - 1.0f, m_clustersX);
+    footprint.x1 = clampCluster(x1 + 1.0f, m_clustersX);
+    footprint.y0 = clampCluster(y0 - 1.0f, m_clustersY);
+    footprint.y1 = clampCluster(y1 + 1.0f, m_clustersY);
+    footprint.z0 = clampCluster(minSlice - 1.0f, m_clustersZ);
+    footprint.z1 = clampCluster(maxSlice + 1.0f, m_clustersZ);
+    return footprint;
+}
+
+
+/*
+ * ClusteredLightCuller::testCluster
+ */
+bool ClusteredLightCuller::testCluster(UINT32 cluster, const sm::Vector3& viewCenter,
+        float radius) const {
+    // Distance to the nearest point of the box.
+    sm::Vector3 nearest = sm::Vector3::Min(sm::Vector3::Max(viewCenter,
+        m_clusterMin[cluster]), m_clusterMax[cluster]);
+    sm::Vector3 offset = viewCenter - nearest;
+    return offset.x * offset.x + offset.y * offset.y + offset.z * offset.z <=
+        radius * radius;
+}
+
+
+/*
+ * ClusteredLightCuller::querySlice
+ */
+void ClusteredLightCuller::querySlice(UINT32 z) {
+    // The faces of the box in view space, moved into world space. The view has no
+    // scale, the normals keep their length.
+    const sm::Vector3& boxMin = m_sliceMin[z];
+    const sm::Vector3& boxMax = m_sliceMax[z];
+    FrustumCuller::Planes viewPlanes = {
+        sm::Vector4(1.0f, 0.0f, 0.0f, -boxMin.x),
+        sm::Vector4(-1.0f, 0.0f, 0.0f, boxMax.x),
+        sm::Vector4(0.0f, 1.0f, 0.0f, -boxMin.y),
+        sm::Vector4(0.0f, -1.0f, 0.0f, boxMax.y),
+        sm::Vector4(0.0f, 0.0f, 1.0f, -boxMin.z),
+        sm::Vector4(0.0f, 0.0f, -1.0f, boxMax.z) };
+    sm::Matrix toWorld = m_viewMat.Transpose();
+    FrustumCuller::Planes planes;
+    for (size_t i = 0; i < planes.size(); i++) {
+        planes[i] = sm::Vector4::Transform(viewPlanes[i], toWorld);
+    }
+    m_lightBvh->QueryFrustum(planes, m_sliceCandidates[z]);
+}
+
+
+/*
+ * ClusteredLightCuller::collectCandidates
+ */
+void ClusteredLightCuller::collectCandidates() {
+    m_candidateLights.clear();
+    auto add = [this](UINT32 light) {
+        if (!m_isCandidate[light]) {
+            m_isCandidate[light] = 1;
+            m_candidateLights.push_back(light);
+        }
+    };
+    for (const std::vector<UINT32>& lights : m_sliceCandidates) {
+        for (UINT32 light : lights) {
+            add(light);
+        }
+    }
+
+    // The assigned lights may have left the slices. Changed lights are transformed
+    // like without a change of the view.
+    if (!m_reassignAll) {
+        for (UINT32 light : m_lightIndices) {
+            add(light);
+        }
+    }
+    for (UINT32 light : m_changedLights) {
+        add(light);
+    }
+    for (UINT32 light : m_candidateLights) {
+        m_isCandidate[light] = 0;
+    }
+    std::sort(m_candidateLights.begin(), m_candidateLights.end());
+}
+
+
+/*
+ * ClusteredLightCuller::updateSlice
+ */
+void ClusteredLightCuller::updateSlice(UINT32 z) {
+    INT32 slice = static_cast<INT32>(z);
+    for (UINT32 light : m_sliceLights[z]) {
+        const Footprint& oldFootprint = m_footprints[light];
+        if (slice >= oldFootprint.z0 && slice <= oldFootprint.z1) {
+            for (INT32 y = oldFootprint.y0; y <= oldFootprint.y1; y++) {
+                for (INT32 x = oldFootprint.x0; x <= oldFootprint.x1; x++) {
+                    UINT32 cluster = GetClusterIndex(x, y, z);
+                    std::vector<UINT32>& lights = m_clusterLights[cluster];
+                    auto it = std::lower_bound(lights.begin(), lights.end(), light);
+                    if (it != lights.end() && *it == light) {
+                        lights.erase(it);
+                    }
+                }
+            }
+        }
+
+        const Footprint& newFootprint = m_newFootprints[light];
+        if (slice < newFootprint.z0 || slice > newFootprint.z1) {
+            continue;
+        }
+        const sm::Vector3& viewCenter = m_viewCenters[light];
+        float radius = m_lights[light].w;
+        for (INT32 y = newFootprint.y0; y <= newFootprint.y1; y++) {
+            for (INT32 x = newFootprint.x0; x <= newFootprint.x1; x++) {
+                UINT32 cluster = GetClusterIndex(x, y, z);
+                if (!testCluster(cluster, viewCenter, radius)) {
+                    continue;
+                }
+                // Lights mostly arrive in ascending order.
+                std::vector<UINT32>& lights = m_clusterLights[cluster];
+                if (lights.empty() || lights.back() < light) {
+                    lights.push_back(light);
+                } else {
+                    lights.insert(std::lower_bound(lights.begin(), lights.end(), light),
+                        light);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,222 @@
+#pragma once
+#include "LightBvh.h"
+
+/// <summary>
+/// Assigns point lights to the clusters of a froxel grid: the view frustum divided
+/// into tiles on screen and exponential slices in depth, so lights are culled in
+/// depth without needing the depth buffer.
+/// </summary>
+/// <remarks>
+/// Slice k spans the view depths near * (far / near)^(k / Z) to the next slice.
+/// A light is added to a cluster if its bounding sphere intersects the view space
+/// bounding box of the cluster, a conservative test. Candidates are the clusters of
+/// the slices and the screen rectangle the sphere projects to.
+/// The assignment is kept in view space and updated incrementally: only lights
+/// that moved in view space are removed from their old clusters and inserted into
+/// the new ones. Without a change of the view these are the lights that changed;
+/// after one, all lights are transformed again, but those outside of the frustum
+/// before and after keep their (empty) assignment. With a LightBvh over the same
+/// lights, the lights outside of the frustum are not even transformed: every slice
+/// queries the BVH with the box around its clusters, and only the lights it finds
+/// and the ones assigned before are transformed. Only a new projection or a new
+/// number of lights reassigns all of them. The lists of the clusters are kept in
+/// ascending order, so an incremental update gives the same lists as a full one.
+/// The slices are processed in parallel, each by a single thread. No Direct3D is
+/// involved.
+/// </remarks>
+class ClusteredLightCuller {
+public:
+    /// <summary>
+    /// Lights of a cluster in GetLightIndices().
+    /// </summary>
+    struct ClusterRange {
+        UINT32 offset;
+        UINT32 count;
+    };
+
+    /// <summary>
+    /// Constructor.
+    /// </summary>
+    /// <param name="clustersX">Tiles per row of the screen.</param>
+    /// <param name="clustersY">Tiles per column of the screen.</param>
+    /// <param name="clustersZ">Depth slices.</param>
+    ClusteredLightCuller(UINT32 clustersX = 16, UINT32 clustersY = 9,
+        UINT32 clustersZ = 24);
+
+    /// <summary>
+    /// Sets the projection. Reassigns all lights on the next Update() if it changed.
+    /// </summary>
+    /// <param name="projMat">Perspective projection matrix (right-handed, D3D depth
+    /// range 0-1). Near and far plane bound the slices.</param>
+    void SetProjection(const sm::Matrix& projMat);
+
+    /// <summary>
+    /// Sets the view. If it changed, the next Update() reassigns the lights that
+    /// moved in view space.
+    /// </summary>
+    /// <param name="viewMat">View matrix (right-handed).</param>
+    void SetView(const sm::Matrix& viewMat);
+
+    /// <summary>
+    /// Replaces all lights. With the same number of lights only the ones that differ
+    /// are changed, like SetLight().
+    /// </summary>
+    /// <param name="lights">Bounding spheres, world space center in xyz and radius
+    /// in w.</param>
+    void SetLights(const std::vector<sm::Vector4>& lights);
+
+    /// <summary>
+    /// Changes a single light. Only the changed lights are reinserted by Update().
+    /// </summary>
+    void SetLight(UINT32 idx, const sm::Vector4& light);
+
+    /// <summary>
+    /// Sets a BVH over the same bounding spheres as SetLights() and SetLight(), which
+    /// has to be refit before every Update(). After a change of the view, Update()
+    /// queries it per slice instead of transforming all lights.
+    /// </summary>
+    /// <param name="lightBvh">The BVH, nullptr to transform all lights.</param>
+    void SetLightBvh(const LightBvh* lightBvh);
+
+    /// <summary>
+    /// Assigns the lights that moved in view space, or all lights after a change of
+    /// the projection or of their number, and rebuilds the index list.
+    /// </summary>
+    void Update();
+
+    /// <summary>
+    /// Number of threads for the slices. 1 assigns on the calling thread.
+    /// </summary>
+    void SetThreadCount(UINT32 threadCnt);
+
+    UINT32 GetClustersX() const;
+    UINT32 GetClustersY() const;
+    UINT32 GetClustersZ() const;
+
+    /// <summary>
+    /// Returns the index of a cluster, x fastest, then y (top row first), then z
+    /// (nearest slice first).
+    /// </summary>
+    UINT32 GetClusterIndex(UINT32 x, UINT32 y, UINT32 z) const;
+
+    /// <summary>
+    /// Returns the view space bounds of a cluster, the volume the lights are tested
+    /// against.
+    /// </summary>
+    dx::BoundingBox GetClusterBounds(UINT32 cluster) const;
+
+    /// <summary>
+    /// Returns the slice of a view depth: slice = log(depth) * scale + bias, clamped
+    /// to the slices.
+    /// </summary>
+    float GetSliceScale() const;
+    float GetSliceBias() const;
+
+    /// <summary>
+    /// Returns the lights per cluster of the last Update().
+    /// </summary>
+    const std::vector<ClusterRange>& GetClusterRanges() const;
+
+    /// <summary>
+    /// Returns the light indices of all clusters, back to back.
+    /// </summary>
+    const std::vector<UINT32>& GetLightIndices() const;
+
+    /// <summary>
+    /// Returns the number of lights the last Update() (re)assigned.
+    /// </summary>
+    UINT32 GetReassignedLightCount() const;
+
+    /// <summary>
+    /// Returns the number of lights the last Update() transformed into view space.
+    /// </summary>
+    UINT32 GetTransformedLightCount() const;
+
+private:
+    /// <summary>
+    /// Candidate clusters of a light (inclusive). Empty if x0 > x1.
+    /// </summary>
+    struct Footprint {
+        INT32 x0 = 0;
+        INT32 y0 = 0;
+        INT32 z0 = 0;
+        INT32 x1 = -1;
+        INT32 y1 = -1;
+        INT32 z1 = -1;
+    };
+
+    /// <summary>
+    /// Computes the view space bounds of all clusters.
+    /// </summary>
+    void computeClusterBounds();
+
+    /// <summary>
+    /// Computes the candidate clusters of a light.
+    /// </summary>
+    Footprint computeFootprint(const sm::Vector3& viewCenter, float radius) const;
+
+    /// <summary>
+    /// Returns true if a sphere intersects the bounds of a cluster.
+    /// </summary>
+    bool testCluster(UINT32 cluster, const sm::Vector3& viewCenter, float radius) const;
+
+    /// <summary>
+    /// Queries the BVH for the lights that reach the box around the clusters of a
+    /// slice.
+    /// </summary>
+    void querySlice(UINT32 z);
+
+    /// <summary>
+    /// Collects the lights to transform after a change of the view: the ones the
+    /// slices found, the assigned ones and the changed ones, sorted.
+    /// </summary>
+    void collectCandidates();
+
+    /// <summary>
+    /// Removes the changed lights of a slice from their old clusters and inserts
+    /// them into the new ones.
+    /// </summary>
+    void updateSlice(UINT32 z);
+
+    UINT32 m_clustersX;
+    UINT32 m_clustersY;
+    UINT32 m_clustersZ;
+    UINT32 m_threadCnt = 1;
+
+    // Projection.
+    sm::Matrix m_projMat;
+    sm::Matrix m_viewMat;
+    float m_nearPlane = 0.0f;
+    float m_farPlane = 0.0f;
+    float m_sliceScale = 0.0f;
+    float m_sliceBias = 0.0f;
+    std::vector<sm::Vector3> m_clusterMin;  // View space bounds per cluster.
+    std::vector<sm::Vector3> m_clusterMax;
+    std::vector<sm::Vector3> m_sliceMin;    // View space bounds per slice.
+    std::vector<sm::Vector3> m_sliceMax;
+    bool m_reassignAll = true;
+    bool m_isViewChanged = false;
+
+    // Lights.
+    std::vector<sm::Vector4> m_lights;
+    std::vector<sm::Vector3> m_viewCenters;
+    std::vector<Footprint> m_footprints;        // Of the current assignment.
+    std::vector<Footprint> m_newFootprints;     // Scratch memory of Update().
+    std::vector<UINT32> m_changedLights;
+    std::vector<bool> m_isChanged;
+    std::vector<UINT8> m_isMoved;               // Per light, written by threads.
+    std::vector<std::vector<UINT32>> m_sliceLights; // Changed lights per slice.
+    UINT32 m_reassignedLightCnt = 0;
+    UINT32 m_transformedLightCnt = 0;
+
+    // Lights to transform after a change of the view, found by the BVH.
+    const LightBvh* m_lightBvh = nullptr;
+    std::vector<std::vector<UINT32>> m_sliceCandidates;
+    std::vector<UINT32> m_candidateLights;
+    std::vector<UINT8> m_isCandidate;
+
+    // Assignment.
+    std::vector<std::vector<UINT32>> m_clusterLights;
+    std::vector<ClusterRange> m_clusterRanges;
+    std::vector<UINT32> m_lightIndices;
+};
@@ -0,0 +1,155 @@
+#include "stdafx.h"
+#include "DepthReadback.h"
+#include "Helper.h"
+#include "ResourceRegistry.h"
+#include "RenderStats.h"
+
+
+/*
+ * DepthReadback::Init
+ */
+void DepthReadback::Init(wrl::ComPtr<ID3D11Device> d3dDevice,
+        wrl::ComPtr<ID3D11DeviceContext> d3dContext, UINT32 sourceWidth,
+        UINT32 sourceHeight) {
+    m_d3dDevice = d3dDevice;
+    m_d3dContext = d3dContext;
+    m_width = (sourceWidth + FACTOR - 1) / FACTOR;
+    m_height = (sourceHeight + FACTOR - 1) / FACTOR;
+
+    // Render target of the downsampling.
+    D3D11_TEXTURE2D_DESC textureDesc = {};
+    textureDesc.Width = m_width;
+    textureDesc.Height = m_height;
+    textureDesc.MipLevels = 1;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = DXGI_FORMAT_R32_FLOAT;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+    textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+    HRESULT hr = m_d3dDevice->CreateTexture2D(&textureDesc, nullptr,
+        m_target.ReleaseAndGetAddressOf());
+    assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_target.Get(), ResourceRegistry::Category::OTHER,
+        "DepthReadback::m_target");
+    hr = m_d3dDevice->CreateRenderTargetView(m_target.Get(), nullptr,
+        m_targetRTV.ReleaseAndGetAddressOf());
+    assert(SUCCEEDED(hr));
+
+    // Ring of copies the CPU can read.
+    textureDesc.Usage = D3D11_USAGE_STAGING;
+    textureDesc.BindFlags = 0;
+    textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    for (Slot& slot : m_slots) {
+        hr = m_d3dDevice->CreateTexture2D(&textureDesc, nullptr,
+            slot.texture.ReleaseAndGetAddressOf());
+        assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(slot.texture.Get(),
+            ResourceRegistry::Category::OTHER, "DepthReadback::m_slots");
+        slot.pending = false;
+    }
+
+    // Sizes for the pixel shader. Only change with the size of the depth buffer.
+    std::array<UINT32, 4> constants = { sourceWidth, sourceHeight, FACTOR, 0 };
+    D3D11_BUFFER_DESC bufferDesc = {};
+    bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    bufferDesc.ByteWidth = sizeof(constants);
+    bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    D3D11_SUBRESOURCE_DATA initData = {};
+    initData.pSysMem = constants.data();
+    hr = m_d3dDevice->CreateBuffer(&bufferDesc, &initData,
+        m_constBuffer.ReleaseAndGetAddressOf());
+    assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_constBuffer.Get(),
+        ResourceRegistry::Category::CONSTANT_BUFFER, "DepthReadback::m_constBuffer");
+
+    Helper::CreateVertexShader(L"\\src\\shader\\DepthDownsample_vs.hlsl",
+        m_vertexShaderByteCode, m_vertexShader, m_d3dDevice);
+    Helper::CreatePixelShader(L"\\src\\shader\\DepthDownsample_ps.hlsl",
+        m_pixelShaderByteCode, m_pixelShader, m_d3dDevice);
+}
+
+
+/*
+ * DepthReadback::Downsample
+ */
+void DepthReadback::Downsample(ID3D11ShaderResourceView* depthSRV,
+        const sm::Matrix& viewProj) {
+    // A single triangle, generated in the vertex shader.
+    D3D11_VIEWPORT viewport = { 0.0f, 0.0f, float(m_width), float(m_height), 0.0f,
+        1.0f };
+    m_d3dContext->OMSetRenderTargets(1, m_targetRTV.GetAddressOf(), nullptr);
+    m_d3dContext->OMSetDepthStencilState(nullptr, 0);
+    m_d3dContext->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+    m_d3dContext->RSSetViewports(1, &viewport);
+    m_d3dContext->RSSetState(nullptr);
+    m_d3dContext->IASetInputLayout(nullptr);
+    m_d3dContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    m_d3dContext->VSSetShader(m_vertexShader.Get(), nullptr, 0);
+    m_d3dContext->PSSetShader(m_pixelShader.Get(), nullptr, 0);
+    m_d3dContext->PSSetConstantBuffers(0, 1, m_constBuffer.GetAddressOf());
+    m_d3dContext->PSSetShaderResources(0, 1, &depthSRV);
+    RenderStats::Draw(m_d3dContext.Get(), 3);
+    RenderStats::Add(RenderStats::Counter::SHADER_SWITCHES, 2);
+    RenderStats::Add(RenderStats::Counter::BUFFER_BINDS);
+    RenderStats::Add(RenderStats::Counter::SRV_BINDS);
+
+    ID3D11ShaderResourceView* nullSRV = nullptr;
+    m_d3dContext->PSSetShaderResources(0, 1, &nullSRV);
+
+    // The copy runs after the downsampling on the GPU, Read() picks it up later.
+    Slot& slot = m_slots[m_nextSlot];
+    m_d3dContext->CopyResource(slot.texture.Get(), m_target.Get());
+    slot.viewProj = viewProj;
+    slot.frame = m_frame++;
+    slot.pending = true;
+    m_nextSlot = (m_nextSlot + 1) % RING_SIZE;
+}
+
+
+/*
+ * DepthReadback::Read
+ */
+bool DepthReadback::Read(HiZCuller& hiZCuller) {
+    // Newest copy first. Copies older than a read one are outdated.
+    for (UINT32 age = 1; age <= RING_SIZE; age++) {
+        Slot& slot = m_slots[(m_nextSlot + RING_SIZE - age) % RING_SIZE];
+        if (!slot.pending) {
+            break;
+        }
+
+        D3D11_MAPPED_SUBRESOURCE mappedResource;
+        HRESULT hr = m_d3dContext->Map(slot.texture.Get(), 0, D3D11_MAP_READ,
+            D3D11_MAP_FLAG_DO_NOT_WAIT, &mappedResource);
+        if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+            continue;
+        }
+        assert(SUCCEEDED(hr));
+        hiZCuller.SetDepth(static_cast<const float*>(mappedResource.pData), m_width,
+            m_height, mappedResource.RowPitch, slot.viewProj);
+        m_d3dContext->Unmap(slot.texture.Get(), 0);
+
+        for (Slot& older : m_slots) {
+            if (older.frame <= slot.frame) {
+                older.pending = false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+
+/*
+ * DepthReadback::GetWidth
+ */
+UINT32 DepthReadback::GetWidth() const {
+    return m_width;
+}
+
+
+/*
+ * DepthReadback::GetHeight
+ */
+UINT32 DepthReadback::GetHeight() const {
+    return m_height;
+}
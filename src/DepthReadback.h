@@ -0,0 +1,89 @@
+#pragma once
+#include "HiZCuller.h"
+
+/// <summary>
+/// Copies a downsampled depth buffer from the GPU to the CPU without stalling, e.g.
+/// for occlusion culling with HiZCuller.
+/// </summary>
+/// <remarks>
+/// The depth is reduced on the GPU to the farthest depth of FACTOR x FACTOR texels
+/// and copied into one of RING_SIZE staging textures. A copy is read a few frames
+/// later, once the GPU finished it (D3D11_MAP_FLAG_DO_NOT_WAIT). The CPU therefore
+/// sees the depth with a latency of at least one frame, together with the view
+/// projection matrix it was rendered with.
+/// </remarks>
+class DepthReadback {
+public:
+    /// <summary>
+    /// Downsampling factor per axis.
+    /// </summary>
+    static const UINT32 FACTOR = 4;
+
+    /// <summary>
+    /// Number of copies in flight.
+    /// </summary>
+    static const UINT32 RING_SIZE = 3;
+
+    /// <summary>
+    /// Creates the resources for a depth buffer. Call again if its size changes.
+    /// </summary>
+    /// <param name="d3dDevice">D3D11 device.</param>
+    /// <param name="d3dContext">D3D11 context.</param>
+    /// <param name="sourceWidth">Width of the depth buffer.</param>
+    /// <param name="sourceHeight">Height of the depth buffer.</param>
+    void Init(wrl::ComPtr<ID3D11Device> d3dDevice,
+        wrl::ComPtr<ID3D11DeviceContext> d3dContext, UINT32 sourceWidth,
+        UINT32 sourceHeight);
+
+    /// <summary>
+    /// Downsamples the depth buffer and starts the copy to the CPU. Binds its own
+    /// render target, viewport and shaders; nothing is restored.
+    /// </summary>
+    /// <param name="depthSRV">Depth buffer. Must not be bound as depth stencil view.
+    /// </param>
+    /// <param name="viewProj">View projection matrix the depth was rendered with.
+    /// </param>
+    void Downsample(ID3D11ShaderResourceView* depthSRV, const sm::Matrix& viewProj);
+
+    /// <summary>
+    /// Passes the newest finished copy to a culler, if there is one that was not
+    /// read yet. Never waits for the GPU.
+    /// </summary>
+    /// <returns>True if the culler got new depth.</returns>
+    bool Read(HiZCuller& hiZCuller);
+
+    UINT32 GetWidth() const;
+    UINT32 GetHeight() const;
+
+private:
+    /// <summary>
+    /// Staging texture and the frame it holds.
+    /// </summary>
+    struct Slot {
+        wrl::ComPtr<ID3D11Texture2D> texture;
+        sm::Matrix viewProj;
+        UINT64 frame = 0;
+        bool pending = false;   // Copied but not read yet.
+    };
+
+    // Size of the downsampled depth.
+    UINT32 m_width = 0;
+    UINT32 m_height = 0;
+
+    wrl::ComPtr<ID3D11Texture2D> m_target;
+    wrl::ComPtr<ID3D11RenderTargetView> m_targetRTV;
+    wrl::ComPtr<ID3D11Buffer> m_constBuffer;
+    std::array<Slot, RING_SIZE> m_slots;
+    UINT32 m_nextSlot = 0;
+    UINT64 m_frame = 0;
+
+    // Shaders.
+    wrl::ComPtr<ID3DBlob> m_vertexShaderByteCode;
+    wrl::ComPtr<ID3DBlob> m_pixelShaderByteCode;
+    wrl::ComPtr<ID3D11VertexShader> m_vertexShader;
+    wrl::ComPtr<ID3D11PixelShader> m_pixelShader;
+
+    // Direct3D stuff.
+    wrl::ComPtr<ID3D11Device> m_d3dDevice;
+    wrl::ComPtr<ID3D11DeviceContext> m_d3dContext;
+};
@@ -0,0 +1,361 @@
+#include "stdafx.h"
+#include "FrustumCuller.h"
+#include "Platform.h"
+
+// SSE and AVX.
+#include <immintrin.h>
+
+
+/*
+ * FrustumCuller::ExtractPlanes
+ */
+FrustumCuller::Planes FrustumCuller::ExtractPlanes(const sm::Matrix& viewProj) {
+    // Clip space is p * viewProj. The planes are sums/differences of its columns
+    // (Gribb/Hartmann), with 0 <= z <= w for the depth range of D3D.
+    sm::Vector4 col0(viewProj._11, viewProj._21, viewProj._31, viewProj._41);
+    sm::Vector4 col1(viewProj._12, viewProj._22, viewProj._32, viewProj._42);
+    sm::Vector4 col2(viewProj._13, viewProj._23, viewProj._33, viewProj._43);
+    sm::Vector4 col3(viewProj._14, viewProj._24, viewProj._34, viewProj._44);
+
+    Planes planes = {
+        col3 + col0,    // Left.
+        col3 - col0,    // Right.
+        col3 + col1,    // Bottom.
+        col3 - col1,    // Top.
+        col2,           // Near.
+        col3 - col2     // Far.
+    };
+    for (sm::Vector4& plane : planes) {
+        float length = sm::Vector3(plane.x, plane.y, plane.z).Length();
+        plane /= length;
+    }
+    return planes;
+}
+
+
+/*
+ * FrustumCuller::DisablePlane
+ */
+void FrustumCuller::DisablePlane(Planes& planes, PlaneIdx plane) {
+    planes[plane] = sm::Vector4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+
+/*
+ * FrustumCuller::SweepPlanes
+ */
+FrustumCuller::Planes FrustumCuller::SweepPlanes(const Planes& planes,
+        const sm::Vector3& direction) {
+    Planes sweptPlanes = planes;
+    for (UINT32 p = 0; p < sweptPlanes.size(); p++) {
+        const sm::Vector4& plane = sweptPlanes[p];
+        if (plane.x * direction.x + plane.y * direction.y + plane.z * direction.z > 0.0f) {
+            DisablePlane(sweptPlanes, static_cast<PlaneIdx>(p));
+        }
+    }
+    return sweptPlanes;
+}
+
+
+/*
+ * FrustumCuller::TestBox
+ */
+bool FrustumCuller::TestBox(const Planes& planes, const dx::BoundingBox& box) {
+    for (const sm::Vector4& plane : planes) {
+        // Signed distance of the center and projected radius of the box.
+        float distance = plane.x * box.Center.x + plane.y * box.Center.y +
+            plane.z * box.Center.z + plane.w;
+        float radius = fabsf(plane.x) * box.Extents.x + fabsf(plane.y) * box.Extents.y +
+            fabsf(plane.z) * box.Extents.z;
+        if (distance + radius < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+ * FrustumCuller::ComputeContribution
+ */
+FrustumCuller::Contribution FrustumCuller::ComputeContribution(
+        const sm::Matrix& viewProj, float viewportWidth, float viewportHeight,
+        float minPixels) {
+    // A sphere of radius r at clip space w spans r * |column| / w in NDC along x and
+    // y. The columns only hold the scale of the projection, the view is a rotation.
+    float scaleX = sm::Vector3(viewProj._11, viewProj._21, viewProj._31).Length();
+    float scaleY = sm::Vector3(viewProj._12, viewProj._22, viewProj._32).Length();
+    float pixelsPerRadius = std::max(scaleX * viewportWidth, scaleY * viewportHeight);
+
+    Contribution contribution;
+    contribution.depth = sm::Vector4(viewProj._14, viewProj._24, viewProj._34,
+        viewProj._44);
+    contribution.minRadius = pixelsPerRadius > 0.0f ? minPixels / pixelsPerRadius :
+        0.0f;
+    return contribution;
+}
+
+
+/*
+ * FrustumCuller::TestContribution
+ */
+bool FrustumCuller::TestContribution(const Contribution& contribution,
+        const dx::BoundingBox& box) {
+    // Compares squared radii, the batched paths do the same without a square root.
+    float w = contribution.depth.x * box.Center.x + contribution.depth.y * box.Center.y +
+        contribution.depth.z * box.Center.z + contribution.depth.w;
+    float minRadius = contribution.minRadius * w;
+    float radiusSq = box.Extents.x * box.Extents.x + box.Extents.y * box.Extents.y +
+        box.Extents.z * box.Extents.z;
+    return minRadius <= 0.0f || radiusSq >= minRadius * minRadius;
+}
+
+
+/*
+ * FrustumCuller::GetBestPath
+ */
+FrustumCuller::Path FrustumCuller::GetBestPath() {
+    return Platform::IsAvx2Supported() ? Path::AVX : Path::SSE;
+}
+
+
+/*
+ * FrustumCuller::Clear
+ */
+void FrustumCuller::Clear() {
+    m_centerX.clear();
+    m_centerY.clear();
+    m_centerZ.clear();
+    m_extentX.clear();
+    m_extentY.clear();
+    m_extentZ.clear();
+}
+
+
+/*
+ * FrustumCuller::AddBox
+ */
+UINT32 FrustumCuller::AddBox(const dx::BoundingBox& box) {
+    m_centerX.push_back(box.Center.x);
+    m_centerY.push_back(box.Center.y);
+    m_centerZ.push_back(box.Center.z);
+    m_extentX.push_back(box.Extents.x);
+    m_extentY.push_back(box.Extents.y);
+    m_extentZ.push_back(box.Extents.z);
+    return static_cast<UINT32>(m_centerX.size() - 1);
+}
+
+
+/*
+ * FrustumCuller::SetBox
+ */
+void FrustumCuller::SetBox(UINT32 idx, const dx::BoundingBox& box) {
+    m_centerX[idx] = box.Center.x;
+    m_centerY[idx] = box.Center.y;
+    m_centerZ[idx] = box.Center.z;
+    m_extentX[idx] = box.Extents.x;
+    m_extentY[idx] = box.Extents.y;
+    m_extentZ[idx] = box.Extents.z;
+}
+
+
+/*
+ * FrustumCuller::GetCount
+ */
+size_t FrustumCuller::GetCount() const {
+    return m_centerX.size();
+}
+
+
+/*
+ * FrustumCuller::SetPath
+ */
+void FrustumCuller::SetPath(Path path) {
+    m_path = path == Path::AVX && !Platform::IsAvx2Supported() ? Path::SSE : path;
+}
+
+
+/*
+ * FrustumCuller::GetPath
+ */
+FrustumCuller::Path FrustumCuller::GetPath() const {
+    return m_path;
+}
+
+
+/*
+ * FrustumCuller::Cull
+ */
+void FrustumCuller::Cull(const Planes& planes, std::vector<UINT32>& visible) const {
+    Cull(planes, Contribution(), visible);
+}
+
+
+/*
+ * FrustumCuller::Cull
+ */
+void FrustumCuller::Cull(const Planes& planes, const Contribution& contribution,
+        std::vector<UINT32>& visible) const {
+    visible.clear();
+    switch (m_path) {
+    case Path::AVX:
+        cullAvx(planes, contribution, visible);
+        break;
+    case Path::SSE:
+        cullSse(planes, contribution, visible);
+        break;
+    default:
+        cullScalar(planes, contribution, 0, visible);
+    }
+}
+
+
+/*
+ * FrustumCuller::cullScalar
+ */
+void FrustumCuller::cullScalar(const Planes& planes, const Contribution& contribution,
+        size_t first, std::vector<UINT32>& visible) const {
+    for (size_t i = first; i < m_centerX.size(); i++) {
+        dx::BoundingBox box(sm::Vector3(m_centerX[i], m_centerY[i], m_centerZ[i]),
+            sm::Vector3(m_extentX[i], m_extentY[i], m_extentZ[i]));
+        if (TestBox(planes, box) && TestContribution(contribution, box)) {
+            visible.push_back(static_cast<UINT32>(i));
+        }
+    }
+}
+
+
+/*
+ * FrustumCuller::cullSse
+ */
+void FrustumCuller::cullSse(const Planes& planes, const Contribution& contribution,
+        std::vector<UINT32>& visible) const {
+    // Broadcast plane components once. Absolute values for the projected radius.
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    __m128 absX[6], absY[6], absZ[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = _mm_set1_ps(planes[p].x);
+        planeY[p] = _mm_set1_ps(planes[p].y);
+        planeZ[p] = _mm_set1_ps(planes[p].z);
+        planeW[p] = _mm_set1_ps(planes[p].w);
+        absX[p] = _mm_set1_ps(fabsf(planes[p].x));
+        absY[p] = _mm_set1_ps(fabsf(planes[p].y));
+        absZ[p] = _mm_set1_ps(fabsf(planes[p].z));
+    }
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 depthX = _mm_set1_ps(contribution.depth.x);
+    const __m128 depthY = _mm_set1_ps(contribution.depth.y);
+    const __m128 depthZ = _mm_set1_ps(contribution.depth.z);
+    const __m128 depthW = _mm_set1_ps(contribution.depth.w);
+    const __m128 minRadiusPerW = _mm_set1_ps(contribution.minRadius);
+
+    size_t count = m_centerX.size();
+    size_t batchEnd = count - count % 4;
+    for (size_t i = 0; i < batchEnd; i += 4) {
+        __m128 cx = _mm_loadu_ps(&m_centerX[i]);
+        __m128 cy = _mm_loadu_ps(&m_centerY[i]);
+        __m128 cz = _mm_loadu_ps(&m_centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&m_extentX[i]);
+        __m128 ey = _mm_loadu_ps(&m_extentY[i]);
+        __m128 ez = _mm_loadu_ps(&m_extentZ[i]);
+
+        // Lanes stay set while the box is inside of all planes tested so far.
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            // Same order of operations as TestBox(), so results match exactly.
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                _mm_mul_ps(planeZ[p], cz)), planeW[p]);
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex),
+                _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+            inside = _mm_and_ps(inside,
+                _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        // Contribution, as in TestContribution().
+        __m128 w = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(depthX, cx),
+            _mm_mul_ps(depthY, cy)), _mm_mul_ps(depthZ, cz)), depthW);
+        __m128 minRadius = _mm_mul_ps(minRadiusPerW, w);
+        __m128 radiusSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)),
+            _mm_mul_ps(ez, ez));
+        inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmple_ps(minRadius, zero),
+            _mm_cmpge_ps(radiusSq, _mm_mul_ps(minRadius, minRadius))));
+
+        int mask = _mm_movemask_ps(inside);
+        while (mask) {
+            unsigned long lane;
+            _BitScanForward(&lane, mask);
+            visible.push_back(static_cast<UINT32>(i + lane));
+            mask &= mask - 1;
+        }
+    }
+
+    cullScalar(planes, contribution, batchEnd, visible);
+}
+
+
+/*
+ * FrustumCuller::cullAvx
+ */
+AVX2_FUNCTION
+void FrustumCuller::cullAvx(const Planes& planes, const Contribution& contribution,
+        std::vector<UINT32>& visible) const {
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    __m256 absX[6], absY[6], absZ[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = _mm256_set1_ps(planes[p].x);
+        planeY[p] = _mm256_set1_ps(planes[p].y);
+        planeZ[p] = _mm256_set1_ps(planes[p].z);
+        planeW[p] = _mm256_set1_ps(planes[p].w);
+        absX[p] = _mm256_set1_ps(fabsf(planes[p].x));
+        absY[p] = _mm256_set1_ps(fabsf(planes[p].y));
+        absZ[p] = _mm256_set1_ps(fabsf(planes[p].z));
+    }
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 depthX = _mm256_set1_ps(contribution.depth.x);
+    const __m256 depthY = _mm256_set1_ps(contribution.depth.y);
+    const __m256 depthZ = _mm256_set1_ps(contribution.depth.z);
+    const __m256 depthW = _mm256_set1_ps(contribution.depth.w);
+    const __m256 minRadiusPerW = _mm256_set1_ps(contribution.minRadius);
+
+    size_t count = m_centerX.size();
+    size_t batchEnd = count - count % 8;
+    for (size_t i = 0; i < batchEnd; i += 8) {
+        __m256 cx = _mm256_loadu_ps(&m_centerX[i]);
+        __m256 cy = _mm256_loadu_ps(&m_centerY[i]);
+        __m256 cz = _mm256_loadu_ps(&m_centerZ[i]);
+        __m256 ex = _mm256_loadu_ps(&m_extentX[i]);
+        __m256 ey = _mm256_loadu_ps(&m_extentY[i]);
+        __m256 ez = _mm256_loadu_ps(&m_extentZ[i]);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                _mm256_mul_ps(planeX[p], cx), _mm256_mul_ps(planeY[p], cy)),
+                _mm256_mul_ps(planeZ[p], cz)), planeW[p]);
+            __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absX[p], ex),
+                _mm256_mul_ps(absY[p], ey)), _mm256_mul_ps(absZ[p], ez));
+            inside = _mm256_and_ps(inside,
+                _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+        }
+
+        __m256 w = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(depthX, cx),
+            _mm256_mul_ps(depthY, cy)), _mm256_mul_ps(depthZ, cz)), depthW);
+        __m256 minRadius = _mm256_mul_ps(minRadiusPerW, w);
+        __m256 radiusSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, ex),
+            _mm256_mul_ps(ey, ey)), _mm256_mul_ps(ez, ez));
+        inside = _mm256_and_ps(inside, _mm256_or_ps(
+            _mm256_cmp_ps(minRadius, zero, _CMP_LE_OQ),
+            _mm256_cmp_ps(radiusSq, _mm256_mul_ps(minRadius, minRadius), _CMP_GE_OQ)));
+
+        int mask = _mm256_movemask_ps(inside);
+        while (mask) {
+            unsigned long lane;
+            _BitScanForward(&lane, mask);
+            visible.push_back(static_cast<UINT32>(i + lane));
+            mask &= mask - 1;
+        }
+    }
+
+    cullScalar(planes, contribution, batchEnd, visible);
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+/// <summary>
+/// Tests many axis-aligned bounding boxes against a view frustum at once and
+/// returns the indices of the visible ones.
+/// </summary>
+/// <remarks>
+/// Boxes are stored as structure of arrays (centers and extents per axis), so the
+/// plane tests run on 4 (SSE) or 8 (AVX) boxes per instruction. A box is culled if
+/// it lies completely on the outside of any of the six planes. The test is
+/// conservative: boxes that intersect the frustum are never culled, boxes near a
+/// frustum corner may be kept although they are outside.
+/// Optionally, boxes are also culled by their contribution: the bounding sphere of
+/// the box is projected and boxes smaller than a number of pixels are dropped.
+/// The AVX path is used on CPUs with AVX2 (see Platform::IsAvx2Supported),
+/// SSE is always available on x64. The scalar path is the reference.
+/// </remarks>
+class FrustumCuller {
+public:
+    /// <summary>
+    /// Implementation of the plane tests.
+    /// </summary>
+    enum class Path {
+        SCALAR,
+        SSE,
+        AVX
+    };
+
+    /// <summary>
+    /// Six frustum planes (left, right, bottom, top, near, far). A point p is inside
+    /// of a plane if dot(plane.xyz, p) + plane.w >= 0.
+    /// </summary>
+    typedef std::array<sm::Vector4, 6> Planes;
+
+    /// <summary>
+    /// Index of a plane in Planes.
+    /// </summary>
+    enum PlaneIdx : UINT32 {
+        LEFT_PLANE,
+        RIGHT_PLANE,
+        BOTTOM_PLANE,
+        TOP_PLANE,
+        NEAR_PLANE,
+        FAR_PLANE
+    };
+
+    /// <summary>
+    /// Parameters of the contribution culling, see ComputeContribution().
+    /// </summary>
+    struct Contribution {
+        sm::Vector4 depth;          // Clip space w of a point p: dot(depth.xyz, p) +
+                                    // depth.w.
+        float minRadius = 0.0f;     // Radius per unit of w below which a bounding
+                                    // sphere is culled. 0 disables the test.
+    };
+
+    /// <summary>
+    /// Extracts the normalized frustum planes of a view projection matrix (row
+    /// vectors, D3D depth range 0-1).
+    /// </summary>
+    static Planes ExtractPlanes(const sm::Matrix& viewProj);
+
+    /// <summary>
+    /// Replaces a plane by one that contains everything, e.g. the near plane of a
+    /// light frustum to keep casters between the light and the frustum.
+    /// </summary>
+    static void DisablePlane(Planes& planes, PlaneIdx plane);
+
+    /// <summary>
+    /// Returns planes that reject a box only if the box swept along a direction
+    /// (to infinity) misses the frustum. Used to keep shadow casters whose shadow
+    /// may fall into the view of the camera.
+    /// </summary>
+    /// <remarks>
+    /// A box outside of a plane stays outside while moving along the direction, if
+    /// the direction does not point towards the inside of the plane. Planes that the
+    /// sweep can cross get disabled. The test remains conservative.
+    /// </remarks>
+    /// <param name="planes">Frustum planes.</param>
+    /// <param name="direction">Sweep direction, e.g. the direction of the light.
+    /// </param>
+    static Planes SweepPlanes(const Planes& planes, const sm::Vector3& direction);
+
+    /// <summary>
+    /// Tests a single box. Reference for the batched paths.
+    /// </summary>
+    /// <returns>True if the box is (potentially) visible.</returns>
+    static bool TestBox(const Planes& planes, const dx::BoundingBox& box);
+
+    /// <summary>
+    /// Computes the contribution culling of a view. Works for perspective and
+    /// orthographic projections.
+    /// </summary>
+    /// <param name="viewProj">View projection matrix.</param>
+    /// <param name="viewportWidth">Width of the render target in pixels.</param>
+    /// <param name="viewportHeight">Height of the render target in pixels.</param>
+    /// <param name="minPixels">Projected diameter in pixels below which bounding
+    /// spheres are culled. 0 disables the test.</param>
+    static Contribution ComputeContribution(const sm::Matrix& viewProj,
+        float viewportWidth, float viewportHeight, float minPixels);
+
+    /// <summary>
+    /// Tests the projected size of the bounding sphere of a box. Reference for the
+    /// batched paths.
+    /// </summary>
+    /// <remarks>
+    /// The projected radius is approximated by the radius over the depth (w) of the
+    /// center, which overestimates spheres off the view axis. Spheres around or
+    /// behind the eye are always kept.
+    /// </remarks>
+    /// <returns>True if the box is large enough.</returns>
+    static bool TestContribution(const Contribution& contribution,
+        const dx::BoundingBox& box);
+
+    /// <summary>
+    /// Returns the fastest path of this CPU.
+    /// </summary>
+    static Path GetBestPath();
+
+    /// <summary>
+    /// Removes all boxes.
+    /// </summary>
+    void Clear();
+
+    /// <summary>
+    /// Appends a box.
+    /// </summary>
+    /// <returns>Index of the box.</returns>
+    UINT32 AddBox(const dx::BoundingBox& box);
+
+    /// <summary>
+    /// Replaces a box.
+    /// </summary>
+    void SetBox(UINT32 idx, const dx::BoundingBox& box);
+
+    /// <summary>
+    /// Returns the number of boxes.
+    /// </summary>
+    size_t GetCount() const;
+
+    /// <summary>
+    /// Selects the implementation of the plane tests. AVX falls back to SSE if not
+    /// supported.
+    /// </summary>
+    void SetPath(Path path);
+
+    /// <summary>
+    /// Returns the implementation of the plane tests.
+    /// </summary>
+    Path GetPath() const;
+
+    /// <summary>
+    /// Collects the indices of all boxes that are (potentially) visible.
+    /// </summary>
+    /// <param name="planes">Frustum planes.</param>
+    /// <param name="visible">Output. Cleared first, indices in ascending order.
+    /// </param>
+    void Cull(const Planes& planes, std::vector<UINT32>& visible) const;
+
+    /// <summary>
+    /// Collects the indices of all boxes that are (potentially) visible and large
+    /// enough on screen.
+    /// </summary>
+    /// <param name="planes">Frustum planes.</param>
+    /// <param name="contribution">Contribution culling of the view.</param>
+    /// <param name="visible">Output. Cleared first, indices in ascending order.
+    /// </param>
+    void Cull(const Planes& planes, const Contribution& contribution,
+        std::vector<UINT32>& visible) const;
+
+private:
+    void cullScalar(const Planes& planes, const Contribution& contribution,
+        size_t first, std::vector<UINT32>& visible) const;
+    void cullSse(const Planes& planes, const Contribution& contribution,
+        std::vector<UINT32>& visible) const;
+    void cullAvx(const Planes& planes, const Contribution& contribution,
+        std::vector<UINT32>& visible) const;
+
+    // Boxes (structure of arrays).
+    std::vector<float> m_centerX;
+    std::vector<float> m_centerY;
+    std::vector<float> m_centerZ;
+    std::vector<float> m_extentX;
+    std::vector<float> m_extentY;
+    std::vector<float> m_extentZ;
+
+    Path m_path = GetBestPath();
+};
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "Graphics.h"
+#include "Telemetry.h"
 
 /*
  * Graphics::Graphics
@@ -14,6 +15,8 @@ Graphics::Graphics(HWND * hwnd, int wWidth, int wHeight,
     m_wHeight = wHeight;
     m_controls = controls;
     m_useVsync = true;
+    m_startTime = std::chrono::steady_clock::now();
+    m_firstFramePresented = false;
 
     // Init all graphics related resources.
     initD3D11();
@@ -23,6 +26,18 @@ Graphics::Graphics(HWND * hwnd, int wWidth, int wHeight,
 
     // Init ImGui.
     initImGui();
+
+    // Stream frame statistics to external readers.
+    Telemetry::Initialize();
+    m_lastFrameTime = std::chrono::steady_clock::now();
+}
+
+
+/*
+ * Graphics::~Graphics
+ */
+Graphics::~Graphics() {
+    Telemetry::Shutdown();
 }
 
 
@@ -52,6 +67,8 @@ void Graphics::changeScene(unsigned int index) {
 
         // Init the selected scene.
         m_Scene->Init();
+        AllocationTracker::Reset();
+        RenderStats::Reset();
 
         // Remember index.
         m_sceneIdx = index;
@@ -94,7 +111,9 @@ void Graphics::initD3D11(){
     swapChainDesc.Windowed = true;
 
     D3D_FEATURE_LEVEL featureLevel;
-    UINT flags = D3D11_CREATE_DEVICE_SINGLETHREADED;// TODO: Change to MT in future.
+    // Free-threaded device, since the scene initialization creates resources on
+    // multiple threads. The immediate context is still only used by one thread.
+    UINT flags = 0;
 #if defined( DEBUG ) || defined( _DEBUG )
     flags |= D3D11_CREATE_DEVICE_DEBUG;
 #endif
@@ -229,12 +248,11 @@ void Graphics::defineApplicationGUI(){
     ImGui::Begin("D3D11 Project");
 
     // Scene selection. TODO: Create convenience function for ImGui::BeginCombo.
-    std::string currentItem = m_sceneNames[m_sceneIdx];
-    if (ImGui::BeginCombo("Scene", currentItem.c_str())) {
+    // Compare indices instead of copying names, to keep the frame allocation free.
+    if (ImGui::BeginCombo("Scene", m_sceneNames[m_sceneIdx].c_str())) {
         for (int n = 0; n < m_sceneNames.size(); n++) {
-            bool isSelected = (currentItem == m_sceneNames[n]);
+            bool isSelected = (n == m_sceneIdx);
             if (ImGui::Selectable(m_sceneNames[n].c_str(), isSelected)) {
-                currentItem = m_sceneNames[n];
                 changeScene(n);
             }
             if (isSelected) {
@@ -252,6 +270,7 @@ void Graphics::defineApplicationGUI(){
     // TODO: Use real frame times.
     const float my_values[] = { 0.2f, 0.1f, 1.0f, 0.5f, 0.9f, 2.2f };
     ImGui::PlotLines("Frame Times", my_values, IM_ARRAYSIZE(my_values));
+    AllocationTracker::DefineImGui();
 
     // Render log.
     ImGui::TextColored(ImVec4(1, 1, 0, 1), "Log:");
@@ -266,6 +285,9 @@ void Graphics::defineApplicationGUI(){
     // End of imgui definitions.
     ImGui::End();
 
+    // GPU memory usage of all registered resources.
+    ResourceRegistry::DefineImGui();
+
     // Process state changes.
 }
 
@@ -283,6 +305,12 @@ HRESULT Graphics::reportLiveObjects() {
  * Graphics::RenderFrame
  */
 void Graphics::RenderFrame(){    
+    // Count heap allocations of this frame.
+    AllocationTracker::BeginFrame();
+
+    // Publish draw/state-change counts of the previous frame.
+    RenderStats::BeginFrame();
+
     // Clear.
     m_d3dContext->ClearRenderTargetView(
         m_d3dFrameBufferView.Get(), dx::XMVECTOR(dx::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f)).m128_f32);
@@ -300,13 +328,18 @@ void Graphics::RenderFrame(){
 
 #if RENDER_GUI
     // Define the application GUI.
-    defineApplicationGUI();
+    {
+        AllocationTracker::Scope scope("Graphics::defineApplicationGUI");
+        defineApplicationGUI();
+    }
 #endif
 
 #if RENDER_SCENE
     // Render scene.
-    m_Scene->Render(m_d3dFrameBufferView, m_d3dDepthStencilView);
-
+    {
+        AllocationTracker::Scope scope("Scene::Render");
+        m_Scene->Render(m_d3dFrameBufferView, m_d3dDepthStencilView);
+    }
 #endif
 
 #if RENDER_GUI
@@ -316,8 +349,11 @@ void Graphics::RenderFrame(){
     pUDA->BeginEvent(L"ImGui");
 
     // Rendering of the Dear ImGui elements.
-    ImGui::Render();
-    ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+    {
+        AllocationTracker::Scope scope("ImGui::Render");
+        ImGui::Render();
+        ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+    }
 
     pUDA->EndEvent();
     pUDA->Release();
@@ -326,6 +362,26 @@ void Graphics::RenderFrame(){
     // Present the frame (swap the buffers after ALL draw calls). Change to
     // Present(0,0) to disable vSync.
     m_d3dSwapChain->Present(m_useVsync, 0);
+
+    // Measure start-up time once.
+    if (!m_firstFramePresented) {
+        m_firstFramePresented = true;
+        std::chrono::duration<float, std::milli> elapsed =
+            std::chrono::steady_clock::now() - m_startTime;
+        std::string msg = "Application: Time to first frame: " +
+            std::to_string(elapsed.count()) + " ms.";
+        m_log.push_back(msg);
+        OutputDebugStringA((msg + "\n").c_str());
+    }
+
+    // Report allocations if the frame is past warm-up.
+    AllocationTracker::EndFrame();
+
+    // Publish the statistics of this frame. Never blocks.
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::duration<float, std::milli> frameTime = now - m_lastFrameTime;
+    m_lastFrameTime = now;
+    Telemetry::PublishFrame(frameTime.count());
 }
 
 
@@ -417,5 +473,8 @@ void Graphics::ResizeWindow(int& width, int& height) {
         m_wWidth = width;
         m_wHeight = height;
         m_Scene->NotifyResolution(m_viewport);
+
+        // Recreating the resources is allowed to allocate.
+        AllocationTracker::Reset();
     }
 }
@@ -5,6 +5,7 @@
 #include "imgui_impl_win32.h"
 #include "imgui_impl_dx11.h"
 #include "Helper.h"
+#include "AllocationTracker.h"
 
 // Scenes. TODO: Move into separate file.
 #include "SponzaScene.h"
@@ -19,6 +20,7 @@ class Graphics {
 public:
     Graphics(HWND* hwnd, int wWidth, int wHeight,
         std::shared_ptr <InputControls> controls);
+    ~Graphics();
 
     /// <summary>
     /// Performs all D3D11 related calls to render a frame.
@@ -107,6 +109,13 @@ private:
     // GUI elements.
     bool m_useVsync;
 
+    // Start-up time measurement (construction until first Present()).
+    std::chrono::steady_clock::time_point m_startTime;
+    bool m_firstFramePresented;
+
+    // End of the previous frame (telemetry).
+    std::chrono::steady_clock::time_point m_lastFrameTime;
+
     // Controls.
     std::shared_ptr <InputControls> m_controls;
 };
@@ -14,6 +14,19 @@ std::wstring Helper::ConvertUtf8ToWide(const std::string& str){
 }
 
 
+/*
+ * Helper::ConvertWideToUtf8
+ */
+std::string Helper::ConvertWideToUtf8(const std::wstring& wstr) {
+    int count = WideCharToMultiByte(CP_UTF8, 0, wstr.c_str(), wstr.length(), NULL, 0,
+        NULL, NULL);
+    std::string str(count, 0);
+    WideCharToMultiByte(CP_UTF8, 0, wstr.c_str(), wstr.length(), &str[0], count,
+        NULL, NULL);
+    return str;
+}
+
+
 /*
  * Helper::GetCurrentPathWstring
  */
@@ -53,29 +66,12 @@ std::string Helper::GetAssetFullPathString(std::string assetName) {
 bool Helper::CreateVertexShader(LPCWSTR path, wrl::ComPtr<ID3DBlob>& byteCodePtr,
         wrl::ComPtr<ID3D11VertexShader>& vertexShaderTarget,
         wrl::ComPtr<ID3D11Device>& d3dDevice) {
-#if defined(_DEBUG)
-    // Enable better shader debugging with the graphics debugging tools.
-    UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#else
-    UINT compileFlags = 0;
-#endif
-    // Compile the shader.
-    ID3DBlob* errorBlob = nullptr;
-    HRESULT hr = D3DCompileFromFile(
-        Helper::GetAssetFullPath(path).c_str(),
-        nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main", "vs_5_0", compileFlags,
-        0, byteCodePtr.GetAddressOf(), &errorBlob);
-    if (FAILED(hr)) {
-        if (errorBlob) {
-            OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-            errorBlob->Release();
-        }
-        assert(false);
-    }
+    // Compile the shader (or reuse an earlier compilation).
+    compileShader(path, "vs_5_0", byteCodePtr);
 
     // Create Vertex shader.
     assert(d3dDevice);
-    hr = d3dDevice->CreateVertexShader(byteCodePtr->GetBufferPointer(),
+    HRESULT hr = d3dDevice->CreateVertexShader(byteCodePtr->GetBufferPointer(),
         byteCodePtr->GetBufferSize(), 0, vertexShaderTarget.GetAddressOf());
     assert(SUCCEEDED(hr));
 
@@ -89,17 +85,50 @@ bool Helper::CreateVertexShader(LPCWSTR path, wrl::ComPtr<ID3DBlob>& byteCodePtr
 bool Helper::CreatePixelShader(LPCWSTR path, wrl::ComPtr<ID3DBlob>& byteCodePtr,
         wrl::ComPtr<ID3D11PixelShader>& pixelShaderTarget,
         wrl::ComPtr<ID3D11Device>& d3dDevice) {
+    // Compile the pixel shader (or reuse an earlier compilation).
+    compileShader(path, "ps_5_0", byteCodePtr);
+
+    // Create Pixel shader.
+    assert(d3dDevice);
+    HRESULT hr = d3dDevice->CreatePixelShader(byteCodePtr->GetBufferPointer(),
+        byteCodePtr->GetBufferSize(), 0, pixelShaderTarget.GetAddressOf());
+    assert(SUCCEEDED(hr));
+
+    return SUCCEEDED(hr);
+}
+
+
+/*
+ * Helper::compileShader
+ */
+bool Helper::compileShader(LPCWSTR path, const char* target,
+        wrl::ComPtr<ID3DBlob>& byteCodePtr) {
+    // Sponza alone has hundreds of meshes that all use the same shader files.
+    static std::mutex cacheMutex;
+    static std::unordered_map<std::wstring, wrl::ComPtr<ID3DBlob>> cache;
+    std::wstring key = std::wstring(path) + L"|" +
+        ConvertUtf8ToWide(std::string(target));
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            byteCodePtr = it->second;
+            return true;
+        }
+    }
+
 #if defined(_DEBUG)
     // Enable better shader debugging with the graphics debugging tools.
     UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #else
     UINT compileFlags = 0;
 #endif
-    // Compile the pixel shader.
+    // Compile the shader. Happens outside of the lock, so different shaders can be
+    // compiled at the same time. A racing compilation of the same file is harmless.
     ID3DBlob* errorBlob = nullptr;
     HRESULT hr = D3DCompileFromFile(
         Helper::GetAssetFullPath(path).c_str(), nullptr,
-        D3D_COMPILE_STANDARD_FILE_INCLUDE, "main", "ps_5_0", compileFlags,
+        D3D_COMPILE_STANDARD_FILE_INCLUDE, "main", target, compileFlags,
         0, byteCodePtr.GetAddressOf(), &errorBlob);
     if (FAILED(hr)) {
         if (errorBlob) {
@@ -107,15 +136,12 @@ bool Helper::CreatePixelShader(LPCWSTR path, wrl::ComPtr<ID3DBlob>& byteCodePtr,
             errorBlob->Release();
         }
         assert(false);
+        return false;
     }
 
-    // Create Pixel shader.
-    assert(d3dDevice);
-    hr = d3dDevice->CreatePixelShader(byteCodePtr->GetBufferPointer(),
-        byteCodePtr->GetBufferSize(), 0, pixelShaderTarget.GetAddressOf());
-    assert(SUCCEEDED(hr));
-
-    return SUCCEEDED(hr);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache[key] = byteCodePtr;
+    return true;
 }
 
 
@@ -23,6 +23,13 @@ public:
 	/// <returns>Converted wstring result.</returns>
 	static std::wstring ConvertUtf8ToWide(const std::string& str);
 
+	/// <summary>
+	/// Converts an std::wstring to a std::string using windows.h.
+	/// </summary>
+	/// <param name="wstr">Wstring which should be converted.</param>
+	/// <returns>Converted UTF-8 string result.</returns>
+	static std::string ConvertWideToUtf8(const std::wstring& wstr);
+
 	/// <summary>
 	/// Returns the root working directory.
 	/// </summary>
@@ -74,6 +81,18 @@ public:
 		wrl::ComPtr<ID3DBlob>& byteCodePtr,
 		wrl::ComPtr<ID3D11PixelShader>& pixelShaderTarget,
 		wrl::ComPtr<ID3D11Device>& d3dDevice);
+
+private:
+	/// <summary>
+	/// Compiles a shader or returns the byte code of an earlier compilation of the
+	/// same file and target. Thread-safe, so meshes can be created in parallel.
+	/// </summary>
+	/// <param name="path">Path to the .hlsl file.</param>
+	/// <param name="target">Shader model target (vs_5_0, ps_5_0).</param>
+	/// <param name="byteCodePtr">Ptr to byte code of shader.</param>
+	/// <returns>If compilation was successful or not.</returns>
+	static bool compileShader(LPCWSTR path, const char* target,
+		wrl::ComPtr<ID3DBlob>& byteCodePtr);
 };
 
 
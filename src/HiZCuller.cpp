@@ -0,0 +1,477 @@
+#include "stdafx.h"
+#include "HiZCuller.h"
+
+// SSE.
+#include <immintrin.h>
+
+
+/*
+ * HiZCuller::SetDepth
+ */
+void HiZCuller::SetDepth(const float* depth, UINT32 width, UINT32 height,
+        size_t rowPitch, const sm::Matrix& viewProj) {
+    assert(width > 0 && height > 0);
+    m_width = width;
+    m_height = height;
+    m_sourceViewProj = viewProj;
+    m_sourceDepth.resize(static_cast<size_t>(width) * height);
+    const UINT8* row = reinterpret_cast<const UINT8*>(depth);
+    for (UINT32 y = 0; y < height; y++, row += rowPitch) {
+        std::memcpy(&m_sourceDepth[static_cast<size_t>(y) * width], row,
+            width * sizeof(float));
+    }
+
+    // Level sizes only change with the size of the depth.
+    if (m_levelSizes.empty() || m_levelSizes[0] != std::make_pair(width, height)) {
+        m_levelSizes.clear();
+        UINT32 levelWidth = width;
+        UINT32 levelHeight = height;
+        while (true) {
+            m_levelSizes.push_back({ levelWidth, levelHeight });
+            if (levelWidth == 1 && levelHeight == 1) {
+                break;
+            }
+            levelWidth = (levelWidth + 1) / 2;
+            levelHeight = (levelHeight + 1) / 2;
+        }
+        m_minLevels.assign(m_levelSizes.size(), {});
+        m_maxLevels.assign(m_levelSizes.size(), {});
+        for (size_t i = 0; i < m_levelSizes.size(); i++) {
+            size_t texelCnt = static_cast<size_t>(m_levelSizes[i].first) *
+                m_levelSizes[i].second;
+            m_minLevels[i].resize(texelCnt);
+            m_maxLevels[i].resize(texelCnt);
+        }
+        m_reprojected.resize(m_sourceDepth.size());
+    }
+}
+
+
+/*
+ * HiZCuller::HasDepth
+ */
+bool HiZCuller::HasDepth() const {
+    return !m_sourceDepth.empty();
+}
+
+
+/*
+ * HiZCuller::Update
+ */
+void HiZCuller::Update(const sm::Matrix& viewProj) {
+    assert(HasDepth());
+    m_viewProj = viewProj;
+
+    // A camera that did not move needs no reprojection and leaves no holes.
+    m_isReprojected = viewProj != m_sourceViewProj;
+    if (!m_isReprojected) {
+        m_maxLevels[0] = m_sourceDepth;
+        m_holeCnt = 0;
+    } else {
+        reproject(m_sourceViewProj.Invert() * viewProj);
+        fillHoles();
+    }
+    m_minLevels[0] = m_maxLevels[0];
+
+    for (UINT32 level = 1; level < m_levelSizes.size(); level++) {
+        reduceLevel(level);
+    }
+}
+
+
+/*
+ * HiZCuller::TestBox
+ */
+bool HiZCuller::TestBox(const dx::BoundingBox& box) const {
+    if (m_maxLevels.empty()) {
+        return true;
+    }
+
+    // Screen rectangle and depth range of the corners.
+    std::array<sm::Vector3, 8> corners;
+    box.GetCorners(corners.data());
+    float minX = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float minY = FLT_MAX;
+    float maxY = -FLT_MAX;
+    float minZ = FLT_MAX;
+    float maxZ = -FLT_MAX;
+    for (const sm::Vector3& corner : corners) {
+        sm::Vector4 clip = sm::Vector4::Transform(
+            sm::Vector4(corner.x, corner.y, corner.z, 1.0f), m_viewProj);
+        if (clip.z < 0.0f || clip.w <= 0.0f) {
+            return true;    // Crosses the near plane.
+        }
+        float screenX = (clip.x / clip.w * 0.5f + 0.5f) * m_width;
+        float screenY = (0.5f - clip.y / clip.w * 0.5f) * m_height;
+        minX = std::min(minX, screenX);
+        maxX = std::max(maxX, screenX);
+        minY = std::min(minY, screenY);
+        maxY = std::max(maxY, screenY);
+        minZ = std::min(minZ, clip.z / clip.w);
+        maxZ = std::max(maxZ, clip.z / clip.w);
+    }
+    if (maxX < 0.0f || minX >= m_width || maxY < 0.0f || minY >= m_height) {
+        return true;    // Off screen, left to the frustum culling.
+    }
+
+    std::array<UINT32, 4> rect = {
+        static_cast<UINT32>(std::max(0.0f, std::floor(minX))),
+        static_cast<UINT32>(std::max(0.0f, std::floor(minY))),
+        static_cast<UINT32>(std::min(m_width - 1.0f, std::floor(maxX))),
+        static_cast<UINT32>(std::min(m_height - 1.0f, std::floor(maxY))) };
+
+    // Start at the finest level where the rectangle overlaps at most 2x2 texels.
+    UINT32 level = 0;
+    while (level + 1 < m_levelSizes.size() &&
+            ((rect[2] >> level) - (rect[0] >> level) > 1 ||
+            (rect[3] >> level) - (rect[1] >> level) > 1)) {
+        level++;
+    }
+    return testTexels(level, rect[0] >> level, rect[1] >> level, rect[2] >> level,
+        rect[3] >> level, rect, minZ, maxZ, MAX_REFINE_LEVELS);
+}
+
+
+/*
+ * HiZCuller::SetPath
+ */
+void HiZCuller::SetPath(Path path) {
+    m_path = path;
+}
+
+
+/*
+ * HiZCuller::GetPath
+ */
+HiZCuller::Path HiZCuller::GetPath() const {
+    return m_path;
+}
+
+
+/*
+ * HiZCuller::GetWidth
+ */
+UINT32 HiZCuller::GetWidth() const {
+    return m_width;
+}
+
+
+/*
+ * HiZCuller::GetHeight
+ */
+UINT32 HiZCuller::GetHeight() const {
+    return m_height;
+}
+
+
+/*
+ * HiZCuller::GetLevelCount
+ */
+UINT32 HiZCuller::GetLevelCount() const {
+    return static_cast<UINT32>(m_levelSizes.size());
+}
+
+
+/*
+ * HiZCuller::GetMinDepth
+ */
+const std::vector<float>& HiZCuller::GetMinDepth(UINT32 level) const {
+    return m_minLevels[level];
+}
+
+
+/*
+ * HiZCuller::GetMaxDepth
+ */
+const std::vector<float>& HiZCuller::GetMaxDepth(UINT32 level) const {
+    return m_maxLevels[level];
+}
+
+
+/*
+ * HiZCuller::GetHoleCount
+ */
+UINT32 HiZCuller::GetHoleCount() const {
+    return m_holeCnt;
+}
+
+
+/*
+ * HiZCuller::GetTileMaxDepth
+ */
+void HiZCuller::GetTileMaxDepth(UINT32 screenWidth, UINT32 screenHeight,
+        UINT32 tileSize, std::vector<float>& maxDepth) const {
+    assert(screenWidth > 0 && screenHeight > 0 && tileSize > 0);
+    UINT32 tilesX = (screenWidth + tileSize - 1) / tileSize;
+    UINT32 tilesY = (screenHeight + tileSize - 1) / tileSize;
+    maxDepth.assign(static_cast<size_t>(tilesX) * tilesY, 1.0f);
+    if (m_levelSizes.empty()) {
+        return;
+    }
+
+    // Texels that overlap the screen pixels [begin, end), plus the border.
+    const UINT32 border = m_isReprojected ? 1 : 0;
+    auto toFirst = [border](UINT32 begin, UINT32 levelSize, UINT32 screenSize) {
+        UINT32 first = static_cast<UINT32>(UINT64(begin) * levelSize / screenSize);
+        return first > border ? first - border : 0;
+    };
+    auto toLast = [border](UINT32 end, UINT32 levelSize, UINT32 screenSize) {
+        UINT32 last = static_cast<UINT32>((UINT64(end) * levelSize + screenSize - 1) /
+            screenSize);
+        return std::min(last + border, levelSize);
+    };
+    const std::vector<float>& level = m_maxLevels[0];
+    for (UINT32 tileY = 0; tileY < tilesY; tileY++) {
+        UINT32 y0 = toFirst(tileY * tileSize, m_height, screenHeight);
+        UINT32 y1 = toLast(std::min((tileY + 1) * tileSize, screenHeight), m_height,
+            screenHeight);
+        for (UINT32 tileX = 0; tileX < tilesX; tileX++) {
+            UINT32 x0 = toFirst(tileX * tileSize, m_width, screenWidth);
+            UINT32 x1 = toLast(std::min((tileX + 1) * tileSize, screenWidth), m_width,
+                screenWidth);
+            float tileDepth = 0.0f;
+            for (UINT32 y = y0; y < y1; y++) {
+                const float* row = &level[static_cast<size_t>(y) * m_width];
+                tileDepth = std::max(tileDepth, *std::max_element(row + x0, row + x1));
+            }
+            maxDepth[static_cast<size_t>(tileY) * tilesX + tileX] = tileDepth;
+        }
+    }
+}
+
+
+/*
+ * HiZCuller::reproject
+ */
+void HiZCuller::reproject(const sm::Matrix& reprojMat) {
+    std::fill(m_reprojected.begin(), m_reprojected.end(), -1.0f);
+    for (UINT32 y = 0; y < m_height; y++) {
+        if (m_path == Path::SSE) {
+            reprojectRowSse(y, reprojMat);
+        } else {
+            reprojectRowScalar(y, reprojMat);
+        }
+    }
+}
+
+
+/*
+ * HiZCuller::reprojectRowScalar
+ */
+void HiZCuller::reprojectRowScalar(UINT32 y, const sm::Matrix& reprojMat) {
+    const sm::Matrix& m = reprojMat;
+    float scaleX = 2.0f / m_width;
+    float scaleY = 2.0f / m_height;
+
+    // (ndcX, ndcY, z, 1) * reprojMat, the y and w terms are the same for the row.
+    float ndcY = 1.0f - (float(y) + 0.5f) * scaleY;
+    float rowX = ndcY * m._21 + m._41;
+    float rowY = ndcY * m._22 + m._42;
+    float rowZ = ndcY * m._23 + m._43;
+    float rowW = ndcY * m._24 + m._44;
+
+    const float* row = &m_sourceDepth[static_cast<size_t>(y) * m_width];
+    for (UINT32 x = 0; x < m_width; x++) {
+        float z = row[x];
+        if (z >= 1.0f) {
+            continue;   // Nothing was drawn, hides nothing.
+        }
+        float ndcX = (float(x) + 0.5f) * scaleX - 1.0f;
+        scatter(ndcX * m._11 + z * m._31 + rowX, ndcX * m._12 + z * m._32 + rowY,
+            ndcX * m._13 + z * m._33 + rowZ, ndcX * m._14 + z * m._34 + rowW);
+    }
+}
+
+
+/*
+ * HiZCuller::reprojectRowSse
+ */
+void HiZCuller::reprojectRowSse(UINT32 y, const sm::Matrix& reprojMat) {
+    const sm::Matrix& m = reprojMat;
+    float scaleX = 2.0f / m_width;
+    float scaleY = 2.0f / m_height;
+
+    float ndcY = 1.0f - (float(y) + 0.5f) * scaleY;
+    float rowX = ndcY * m._21 + m._41;
+    float rowY = ndcY * m._22 + m._42;
+    float rowZ = ndcY * m._23 + m._43;
+    float rowW = ndcY * m._24 + m._44;
+    const __m128 rowTerms[4] = { _mm_set1_ps(rowX), _mm_set1_ps(rowY),
+        _mm_set1_ps(rowZ), _mm_set1_ps(rowW) };
+    const __m128 xTerms[4] = { _mm_set1_ps(m._11), _mm_set1_ps(m._12),
+        _mm_set1_ps(m._13), _mm_set1_ps(m._14) };
+    const __m128 zTerms[4] = { _mm_set1_ps(m._31), _mm_set1_ps(m._32),
+        _mm_set1_ps(m._33), _mm_set1_ps(m._34) };
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 scale = _mm_set1_ps(scaleX);
+    const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+    const float* row = &m_sourceDepth[static_cast<size_t>(y) * m_width];
+    UINT32 x = 0;
+    alignas(16) std::array<std::array<float, 4>, 4> clip;
+    for (; x + 4 <= m_width; x += 4) {
+        __m128 z = _mm_loadu_ps(row + x);
+        int drawnMask = _mm_movemask_ps(_mm_cmplt_ps(z, one));
+        if (drawnMask == 0) {
+            continue;
+        }
+
+        // Same order of operations as the scalar path.
+        __m128 pixelX = _mm_add_ps(_mm_set1_ps(float(x)), laneOffsets);
+        __m128 ndcX = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(pixelX, half), scale), one);
+        for (int c = 0; c < 4; c++) {
+            _mm_store_ps(clip[c].data(), _mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(ndcX, xTerms[c]), _mm_mul_ps(z, zTerms[c])), rowTerms[c]));
+        }
+        for (int lane = 0; lane < 4; lane++) {
+            if (drawnMask & (1 << lane)) {
+                scatter(clip[0][lane], clip[1][lane], clip[2][lane], clip[3][lane]);
+            }
+        }
+    }
+
+    // Remainder.
+    for (; x < m_width; x++) {
+        float z = row[x];
+        if (z >= 1.0f) {
+            continue;
+        }
+        float ndcX = (float(x) + 0.5f) * scaleX - 1.0f;
+        scatter(ndcX * m._11 + z * m._31 + rowX, ndcX * m._12 + z * m._32 + rowY,
+            ndcX * m._13 + z * m._33 + rowZ, ndcX * m._14 + z * m._34 + rowW);
+    }
+}
+
+
+/*
+ * HiZCuller::scatter
+ */
+void HiZCuller::scatter(float clipX, float clipY, float clipZ, float clipW) {
+    if (clipW <= 0.0f || clipZ < 0.0f) {
+        return;     // Behind the near plane of the current view.
+    }
+    float screenX = (clipX / clipW * 0.5f + 0.5f) * m_width;
+    float screenY = (0.5f - clipY / clipW * 0.5f) * m_height;
+    if (!(screenX >= 0.0f && screenX < m_width && screenY >= 0.0f &&
+            screenY < m_height)) {
+        return;
+    }
+
+    // Farthest point per pixel.
+    float& target = m_reprojected[static_cast<size_t>(screenY) * m_width +
+        static_cast<size_t>(screenX)];
+    target = std::max(target, std::min(clipZ / clipW, 1.0f));
+}
+
+
+/*
+ * HiZCuller::fillHoles
+ */
+void HiZCuller::fillHoles() {
+    // A hole can be a crack of a surface that came closer, but just as well a
+    // disocclusion that shows something far behind its neighbours. Only the far
+    // plane is safe for both.
+    std::vector<float>& depth = m_maxLevels[0];
+    m_holeCnt = 0;
+    for (size_t i = 0; i < depth.size(); i++) {
+        if (m_reprojected[i] >= 0.0f) {
+            depth[i] = m_reprojected[i];
+        } else {
+            depth[i] = 1.0f;
+            m_holeCnt++;
+        }
+    }
+}
+
+
+/*
+ * HiZCuller::reduceLevel
+ */
+void HiZCuller::reduceLevel(UINT32 level) {
+    UINT32 srcWidth = m_levelSizes[level - 1].first;
+    UINT32 srcHeight = m_levelSizes[level - 1].second;
+    UINT32 dstWidth = m_levelSizes[level].first;
+    UINT32 dstHeight = m_levelSizes[level].second;
+    const std::vector<float>& srcMin = m_minLevels[level - 1];
+    const std::vector<float>& srcMax = m_maxLevels[level - 1];
+    std::vector<float>& dstMin = m_minLevels[level];
+    std::vector<float>& dstMax = m_maxLevels[level];
+
+    for (UINT32 y = 0; y < dstHeight; y++) {
+        // Odd sizes repeat the last row and column.
+        size_t row0 = static_cast<size_t>(2 * y) * srcWidth;
+        size_t row1 = static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth;
+        size_t dstRow = static_cast<size_t>(y) * dstWidth;
+
+        // 8 source texels of two rows become 4 texels.
+        UINT32 x = 0;
+        if (m_path == Path::SSE) {
+            for (; 2 * x + 8 <= srcWidth && x + 4 <= dstWidth; x += 4) {
+                size_t src0 = row0 + 2 * x;
+                size_t src1 = row1 + 2 * x;
+                __m128 max0 = _mm_max_ps(_mm_loadu_ps(&srcMax[src0]),
+                    _mm_loadu_ps(&srcMax[src1]));
+                __m128 max1 = _mm_max_ps(_mm_loadu_ps(&srcMax[src0 + 4]),
+                    _mm_loadu_ps(&srcMax[src1 + 4]));
+                _mm_storeu_ps(&dstMax[dstRow + x], _mm_max_ps(
+                    _mm_shuffle_ps(max0, max1, _MM_SHUFFLE(2, 0, 2, 0)),
+                    _mm_shuffle_ps(max0, max1, _MM_SHUFFLE(3, 1, 3, 1))));
+
+                __m128 min0 = _mm_min_ps(_mm_loadu_ps(&srcMin[src0]),
+                    _mm_loadu_ps(&srcMin[src1]));
+                __m128 min1 = _mm_min_ps(_mm_loadu_ps(&srcMin[src0 + 4]),
+                    _mm_loadu_ps(&srcMin[src1 + 4]));
+                _mm_storeu_ps(&dstMin[dstRow + x], _mm_min_ps(
+                    _mm_shuffle_ps(min0, min1, _MM_SHUFFLE(2, 0, 2, 0)),
+                    _mm_shuffle_ps(min0, min1, _MM_SHUFFLE(3, 1, 3, 1))));
+            }
+        }
+        for (; x < dstWidth; x++) {
+            size_t x0 = 2 * x;
+            size_t x1 = std::min(2 * x + 1, srcWidth - 1);
+            dstMax[dstRow + x] = std::max({ srcMax[row0 + x0], srcMax[row0 + x1],
+                srcMax[row1 + x0], srcMax[row1 + x1] });
+            dstMin[dstRow + x] = std::min({ srcMin[row0 + x0], srcMin[row0 + x1],
+                srcMin[row1 + x0], srcMin[row1 + x1] });
+        }
+    }
+}
+
+
+/*
+ * HiZCuller::testTexels
+ */
+bool HiZCuller::testTexels(UINT32 level, UINT32 x0, UINT32 y0, UINT32 x1, UINT32 y1,
+        const std::array<UINT32, 4>& rect, float boxMinZ, float boxMaxZ,
+        UINT32 refineCnt) const {
+    UINT32 levelWidth = m_levelSizes[level].first;
+    for (UINT32 y = y0; y <= y1; y++) {
+        for (UINT32 x = x0; x <= x1; x++) {
+            size_t i = static_cast<size_t>(y) * levelWidth + x;
+            if (m_maxLevels[level][i] < boxMinZ) {
+                continue;   // Every occluder of the texel is in front of the box.
+            }
+
+            // In front of all occluders of the texel, or no finer level to look at.
+            if (boxMaxZ < m_minLevels[level][i] || level == 0 || refineCnt == 0) {
+                return true;
+            }
+
+            // Children of the texel that overlap the rectangle.
+            UINT32 child = level - 1;
+            UINT32 childX0 = std::max(2 * x, rect[0] >> child);
+            UINT32 childY0 = std::max(2 * y, rect[1] >> child);
+            UINT32 childX1 = std::min({ 2 * x + 1, rect[2] >> child,
+                m_levelSizes[child].first - 1 });
+            UINT32 childY1 = std::min({ 2 * y + 1, rect[3] >> child,
+                m_levelSizes[child].second - 1 });
+            if (testTexels(child, childX0, childY0, childX1, childY1, rect, boxMinZ,
+                    boxMaxZ, refineCnt - 1)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+/// <summary>
+/// Occlusion culling against the depth buffer of a previous frame. The depth is
+/// reprojected into the current view, reduced into a hierarchical-Z pyramid and
+/// bounding boxes are tested against it.
+/// </summary>
+/// <remarks>
+/// Depth is z/w of D3D (0 near, 1 far). Every texel of the previous depth is
+/// reprojected as a point, the farthest point per target pixel is kept. Pixels
+/// without a point (disocclusions, cracks of surfaces that came closer) get the far
+/// plane (depth 1), so they never hide anything. Points keep the farthest depth of
+/// their texel, but a surface that became visible next to an edge since can still
+/// be farther than the point that landed on it.
+/// Each level of the pyramid holds the minimum and maximum depth of 2x2 texels of
+/// the level below. A box is hidden if it is behind the maximum depth of every
+/// texel it overlaps. The minimum depth accepts boxes in front of all occluders
+/// without refining further. Scalar and SSE produce the same results.
+/// </remarks>
+class HiZCuller {
+public:
+    /// <summary>
+    /// Number of finer levels a box test descends into before it gives up and
+    /// reports the box as visible.
+    /// </summary>
+    static const UINT32 MAX_REFINE_LEVELS = 3;
+
+    /// <summary>
+    /// Implementation of the reprojection and the pyramid reduction.
+    /// </summary>
+    enum class Path {
+        SCALAR,
+        SSE
+    };
+
+    /// <summary>
+    /// Sets the depth of a previous frame.
+    /// </summary>
+    /// <param name="depth">First row of the depth. Copied.</param>
+    /// <param name="width">Texels per row.</param>
+    /// <param name="height">Number of rows.</param>
+    /// <param name="rowPitch">Bytes between two rows.</param>
+    /// <param name="viewProj">View projection matrix the depth was rendered with.
+    /// </param>
+    void SetDepth(const float* depth, UINT32 width, UINT32 height, size_t rowPitch,
+        const sm::Matrix& viewProj);
+
+    /// <summary>
+    /// Returns true once SetDepth() was called.
+    /// </summary>
+    bool HasDepth() const;
+
+    /// <summary>
+    /// Reprojects the depth into the current view and builds the pyramid. Call
+    /// before TestBox().
+    /// </summary>
+    /// <param name="viewProj">View projection matrix of the current frame.</param>
+    void Update(const sm::Matrix& viewProj);
+
+    /// <summary>
+    /// Tests a box against the pyramid.
+    /// </summary>
+    /// <param name="box">World space bounds.</param>
+    /// <returns>False if the box is completely hidden. True if it may be visible,
+    /// which includes boxes that intersect the near plane or lie off screen, and
+    /// all boxes before the first Update().</returns>
+    bool TestBox(const dx::BoundingBox& box) const;
+
+    void SetPath(Path path);
+    Path GetPath() const;
+
+    UINT32 GetWidth() const;
+    UINT32 GetHeight() const;
+    UINT32 GetLevelCount() const;
+
+    /// <summary>
+    /// Returns the minimum or maximum depth of a level of the pyramid (row-major,
+    /// top row first). Level 0 is the reprojected depth.
+    /// </summary>
+    const std::vector<float>& GetMinDepth(UINT32 level) const;
+    const std::vector<float>& GetMaxDepth(UINT32 level) const;
+
+    /// <summary>
+    /// Returns the number of pixels of the last Update() that no point was
+    /// reprojected into.
+    /// </summary>
+    UINT32 GetHoleCount() const;
+
+    /// <summary>
+    /// Computes the farthest depth of level 0 over the tiles of a screen the depth
+    /// was downsampled from. A tile gets the maximum of all texels that overlap it.
+    /// After a reprojection it gets the texels around them as well: a surface that
+    /// came out from behind an edge can lie in a texel that another point landed in.
+    /// </summary>
+    /// <param name="screenWidth">Width of the screen in pixels.</param>
+    /// <param name="screenHeight">Height of the screen in pixels.</param>
+    /// <param name="tileSize">Pixels per side of a tile.</param>
+    /// <param name="maxDepth">Receives the depth per tile (row-major, top row first).
+    /// </param>
+    void GetTileMaxDepth(UINT32 screenWidth, UINT32 screenHeight, UINT32 tileSize,
+        std::vector<float>& maxDepth) const;
+
+private:
+    /// <summary>
+    /// Scatters the previous depth into m_reprojected. Empty pixels stay negative.
+    /// </summary>
+    /// <param name="reprojMat">Previous NDC to current clip space.</param>
+    void reproject(const sm::Matrix& reprojMat);
+    void reprojectRowScalar(UINT32 y, const sm::Matrix& reprojMat);
+    void reprojectRowSse(UINT32 y, const sm::Matrix& reprojMat);
+
+    /// <summary>
+    /// Scatters a reprojected point into m_reprojected.
+    /// </summary>
+    void scatter(float clipX, float clipY, float clipZ, float clipW);
+
+    /// <summary>
+    /// Copies m_reprojected into level 0 of the pyramid, holes at the far plane.
+    /// </summary>
+    void fillHoles();
+
+    /// <summary>
+    /// Computes a level of the pyramid from the level below.
+    /// </summary>
+    void reduceLevel(UINT32 level);
+
+    /// <summary>
+    /// Tests the texels [x0, x1] x [y0, y1] of a level, refining into the level
+    /// below where the result is not clear.
+    /// </summary>
+    /// <param name="rect">Screen rectangle of the box in texels of level 0 (x0, y0,
+    /// x1, y1), all inclusive.</param>
+    /// <returns>True if the box may be visible in one of the texels.</returns>
+    bool testTexels(UINT32 level, UINT32 x0, UINT32 y0, UINT32 x1, UINT32 y1,
+        const std::array<UINT32, 4>& rect, float boxMinZ, float boxMaxZ,
+        UINT32 refineCnt) const;
+
+    Path m_path = Path::SSE;
+
+    // Depth of the previous frame.
+    std::vector<float> m_sourceDepth;
+    UINT32 m_width = 0;
+    UINT32 m_height = 0;
+    sm::Matrix m_sourceViewProj;
+
+    // Current frame.
+    sm::Matrix m_viewProj;
+    std::vector<float> m_reprojected;   // Scatter target, negative if empty.
+    UINT32 m_holeCnt = 0;
+    bool m_isReprojected = false;
+
+    // Pyramid. Level i has ceil(width / 2^i) x ceil(height / 2^i) texels.
+    std::vector<std::vector<float>> m_minLevels;
+    std::vector<std::vector<float>> m_maxLevels;
+    std::vector<std::pair<UINT32, UINT32>> m_levelSizes;
+};
@@ -0,0 +1,298 @@
+#include "stdafx.h"
+#include "LightAnimation.h"
+#include "Platform.h"
+
+// AVX2.
+#include <immintrin.h>
+
+
+// Largest relative dimming of the flicker.
+static const float FLICKER_DEPTH = 0.6f;
+
+
+/*
+ * LightAnimation::LightAnimation
+ */
+LightAnimation::LightAnimation() {
+    m_path = Platform::IsAvx2Supported() ? Path::AVX2 : Path::SCALAR;
+}
+
+
+/*
+ * LightAnimation::Resize
+ */
+void LightAnimation::Resize(UINT32 lightCnt) {
+    m_lightCnt = lightCnt;
+    for (std::vector<float>* values : { &m_positionX, &m_positionY, &m_positionZ,
+            &m_velocityX, &m_velocityY, &m_velocityZ, &m_colorR, &m_colorG, &m_colorB,
+            &m_baseIntensity, &m_intensity, &m_baseRadius, &m_radius, &m_flickerPhase,
+            &m_flickerRate }) {
+        values->resize(lightCnt, 0.0f);
+    }
+}
+
+
+/*
+ * LightAnimation::SetBounds
+ */
+void LightAnimation::SetBounds(const sm::Vector3& boundsMin,
+        const sm::Vector3& boundsMax) {
+    m_boundsMin = boundsMin;
+    m_boundsMax = boundsMax;
+}
+
+
+/*
+ * LightAnimation::SetLight
+ */
+void LightAnimation::SetLight(UINT32 idx, const sm::Vector3& position,
+        const sm::Vector3& velocity, const sm::Vector3& color, float intensity,
+        float radius, float flickerPhase, float flickerRate) {
+    m_positionX[idx] = position.x;
+    m_positionY[idx] = position.y;
+    m_positionZ[idx] = position.z;
+    m_velocityX[idx] = velocity.x;
+    m_velocityY[idx] = velocity.y;
+    m_velocityZ[idx] = velocity.z;
+    m_colorR[idx] = color.x;
+    m_colorG[idx] = color.y;
+    m_colorB[idx] = color.z;
+    m_baseIntensity[idx] = intensity;
+    m_intensity[idx] = intensity;
+    m_baseRadius[idx] = radius;
+    m_radius[idx] = radius;
+    m_flickerPhase[idx] = flickerPhase;
+    m_flickerRate[idx] = flickerRate;
+}
+
+
+/*
+ * LightAnimation::Update
+ */
+void LightAnimation::Update(float dt) {
+    UINT32 vectorEnd = 0;
+    if (m_path == Path::AVX2) {
+        vectorEnd = m_lightCnt & ~7u;
+        updateAvx2(dt, 0, vectorEnd);
+    }
+    updateScalar(dt, vectorEnd, m_lightCnt);
+}
+
+
+/*
+ * LightAnimation::WriteLights
+ */
+void LightAnimation::WriteLights(UINT32 first, UINT32 last,
+        LightPool::PackedLight* dest) const {
+    for (UINT32 i = first; i < last; i++, dest++) {
+        dest->positionRadius = sm::Vector4(m_positionX[i], m_positionY[i],
+            m_positionZ[i], m_radius[i]);
+        dest->color = LightPool::PackColor(m_intensity[i] *
+            sm::Vector3(m_colorR[i], m_colorG[i], m_colorB[i]));
+    }
+}
+
+
+/*
+ * LightAnimation::WriteInstances
+ */
+void LightAnimation::WriteInstances(const std::vector<UINT32>& lights, void* dest,
+        UINT32 stride) const {
+    UINT8* instance = static_cast<UINT8*>(dest);
+    for (UINT32 i : lights) {
+        float* values = reinterpret_cast<float*>(instance);
+        float scale = 2.0f * m_radius[i];
+        values[0] = m_positionX[i];
+        values[1] = m_positionY[i];
+        values[2] = m_positionZ[i];
+        values[3] = scale;
+        values[4] = scale;
+        values[5] = scale;
+        values[6] = m_intensity[i] * m_colorR[i];
+        values[7] = m_intensity[i] * m_colorG[i];
+        values[8] = m_intensity[i] * m_colorB[i];
+        instance += stride;
+    }
+}
+
+
+/*
+ * LightAnimation::SetPath
+ */
+void LightAnimation::SetPath(Path path) {
+    m_path = path == Path::AVX2 && !Platform::IsAvx2Supported() ?
+        Path::SCALAR : path;
+}
+
+
+/*
+ * LightAnimation::GetPath
+ */
+LightAnimation::Path LightAnimation::GetPath() const {
+    return m_path;
+}
+
+
+/*
+ * LightAnimation::GetCount
+ */
+UINT32 LightAnimation::GetCount() const {
+    return m_lightCnt;
+}
+
+
+/*
+ * LightAnimation::GetPositionX
+ */
+const float* LightAnimation::GetPositionX() const {
+    return m_positionX.data();
+}
+
+
+/*
+ * LightAnimation::GetPositionY
+ */
+const float* LightAnimation::GetPositionY() const {
+    return m_positionY.data();
+}
+
+
+/*
+ * LightAnimation::GetPositionZ
+ */
+const float* LightAnimation::GetPositionZ() const {
+    return m_positionZ.data();
+}
+
+
+/*
+ * LightAnimation::GetColorR
+ */
+const float* LightAnimation::GetColorR() const {
+    return m_colorR.data();
+}
+
+
+/*
+ * LightAnimation::GetColorG
+ */
+const float* LightAnimation::GetColorG() const {
+    return m_colorG.data();
+}
+
+
+/*
+ * LightAnimation::GetColorB
+ */
+const float* LightAnimation::GetColorB() const {
+    return m_colorB.data();
+}
+
+
+/*
+ * LightAnimation::GetIntensity
+ */
+const float* LightAnimation::GetIntensity() const {
+    return m_intensity.data();
+}
+
+
+/*
+ * LightAnimation::GetRadius
+ */
+const float* LightAnimation::GetRadius() const {
+    return m_radius.data();
+}
+
+
+/*
+ * LightAnimation::updateScalar
+ */
+void LightAnimation::updateScalar(float dt, UINT32 first, UINT32 last) {
+    // Mirrors a coordinate that left the bounds back into them.
+    auto move = [dt](float& position, float& velocity, float boundMin, float boundMax) {
+        float moved = position + velocity * dt;
+        if (moved < boundMin) {
+            moved = (boundMin + boundMin) - moved;
+            velocity = -velocity;
+        } else if (moved > boundMax) {
+            moved = (boundMax + boundMax) - moved;
+            velocity = -velocity;
+        }
+        position = moved;
+    };
+
+    for (UINT32 i = first; i < last; i++) {
+        move(m_positionX[i], m_velocityX[i], m_boundsMin.x, m_boundsMax.x);
+        move(m_positionY[i], m_velocityY[i], m_boundsMin.y, m_boundsMax.y);
+        move(m_positionZ[i], m_velocityZ[i], m_boundsMin.z, m_boundsMax.z);
+
+        // A pulse of 4 * phase * (1 - phase), squared to stay bright for longer.
+        float phase = m_flickerPhase[i] + m_flickerRate[i] * dt;
+        phase = phase - std::floor(phase);
+        m_flickerPhase[i] = phase;
+        float pulse = 4.0f * phase * (1.0f - phase);
+        float flicker = 1.0f - FLICKER_DEPTH * (pulse * pulse);
+        m_intensity[i] = m_baseIntensity[i] * flicker;
+        m_radius[i] = m_baseRadius[i] * std::sqrt(flicker);
+    }
+}
+
+
+/// <summary>
+/// Moves 8 lights along one axis and reflects them at the bounds. Same as the
+/// scalar move, the two reflections exclude each other.
+/// </summary>
+AVX2_FUNCTION
+static void moveAvx2(float* positions, float* velocities, float boundMin,
+        float boundMax, float dt, UINT32 i) {
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    __m256 velocity = _mm256_loadu_ps(velocities + i);
+    __m256 moved = _mm256_add_ps(_mm256_loadu_ps(positions + i),
+        _mm256_mul_ps(velocity, _mm256_set1_ps(dt)));
+    __m256 lower = _mm256_set1_ps(boundMin);
+    __m256 upper = _mm256_set1_ps(boundMax);
+    __m256 isBelow = _mm256_cmp_ps(moved, lower, _CMP_LT_OQ);
+    __m256 isAbove = _mm256_cmp_ps(moved, upper, _CMP_GT_OQ);
+    __m256 reflected = _mm256_blendv_ps(
+        _mm256_sub_ps(_mm256_add_ps(upper, upper), moved),
+        _mm256_sub_ps(_mm256_add_ps(lower, lower), moved), isBelow);
+    __m256 isOutside = _mm256_or_ps(isBelow, isAbove);
+    _mm256_storeu_ps(positions + i, _mm256_blendv_ps(moved, reflected, isOutside));
+    _mm256_storeu_ps(velocities + i, _mm256_xor_ps(velocity,
+        _mm256_and_ps(isOutside, signBit)));
+}
+
+
+/*
+ * LightAnimation::updateAvx2
+ */
+AVX2_FUNCTION
+void LightAnimation::updateAvx2(float dt, UINT32 first, UINT32 last) {
+    const __m256 dtVec = _mm256_set1_ps(dt);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 four = _mm256_set1_ps(4.0f);
+    const __m256 flickerDepth = _mm256_set1_ps(FLICKER_DEPTH);
+
+    for (UINT32 i = first; i < last; i += 8) {
+        moveAvx2(m_positionX.data(), m_velocityX.data(), m_boundsMin.x, m_boundsMax.x,
+            dt, i);
+        moveAvx2(m_positionY.data(), m_velocityY.data(), m_boundsMin.y, m_boundsMax.y,
+            dt, i);
+        moveAvx2(m_positionZ.data(), m_velocityZ.data(), m_boundsMin.z, m_boundsMax.z,
+            dt, i);
+
+        __m256 phase = _mm256_add_ps(_mm256_loadu_ps(&m_flickerPhase[i]),
+            _mm256_mul_ps(_mm256_loadu_ps(&m_flickerRate[i]), dtVec));
+        phase = _mm256_sub_ps(phase, _mm256_floor_ps(phase));
+        _mm256_storeu_ps(&m_flickerPhase[i], phase);
+        __m256 pulse = _mm256_mul_ps(_mm256_mul_ps(four, phase),
+            _mm256_sub_ps(one, phase));
+        __m256 flicker = _mm256_sub_ps(one,
+            _mm256_mul_ps(flickerDepth, _mm256_mul_ps(pulse, pulse)));
+        _mm256_storeu_ps(&m_intensity[i],
+            _mm256_mul_ps(_mm256_loadu_ps(&m_baseIntensity[i]), flicker));
+        _mm256_storeu_ps(&m_radius[i],
+            _mm256_mul_ps(_mm256_loadu_ps(&m_baseRadius[i]), _mm256_sqrt_ps(flicker)));
+    }
+}
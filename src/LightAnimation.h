@@ -0,0 +1,137 @@
+#pragma once
+#include "LightPool.h"
+
+/// <summary>
+/// Moves and flickers many point lights per frame, e.g. for stress tests of the
+/// light culling and the lighting passes.
+/// </summary>
+/// <remarks>
+/// The lights are stored as structure of arrays (position, velocity, color,
+/// intensity, radius and flicker state per component), so the AVX2 path updates 8
+/// lights per instruction. Every step moves the lights along their velocity and
+/// reflects them at the bounds, advances their flicker phase and derives intensity
+/// and radius from it. The flicker curve is a smooth pulse of the phase that dims
+/// a light by up to 60%. The radius scales with the square root of the
+/// intensity, which keeps it at or above the distance at which the dimmed light
+/// falls below the cutoff of SceneMath::ComputeLightRadius(). The AVX2 path
+/// produces exactly the same values as the scalar reference. No Direct3D is
+/// involved.
+/// </remarks>
+class LightAnimation {
+public:
+    /// <summary>
+    /// Implementation of Update().
+    /// </summary>
+    enum class Path {
+        SCALAR,
+        AVX2
+    };
+
+    /// <summary>
+    /// Constructor. Selects AVX2 if supported.
+    /// </summary>
+    LightAnimation();
+
+    /// <summary>
+    /// Sets the number of lights. New lights are black and do not move.
+    /// </summary>
+    void Resize(UINT32 lightCnt);
+
+    /// <summary>
+    /// Sets the box the lights move in.
+    /// </summary>
+    void SetBounds(const sm::Vector3& boundsMin, const sm::Vector3& boundsMax);
+
+    /// <summary>
+    /// Sets the state of a light.
+    /// </summary>
+    /// <param name="idx">Index of the light.</param>
+    /// <param name="position">World space position, inside the bounds.</param>
+    /// <param name="velocity">Units per second.</param>
+    /// <param name="color">Color at full intensity.</param>
+    /// <param name="intensity">Intensity without flicker.</param>
+    /// <param name="radius">Radius without flicker.</param>
+    /// <param name="flickerPhase">Start of the flicker, [0, 1).</param>
+    /// <param name="flickerRate">Flickers per second.</param>
+    void SetLight(UINT32 idx, const sm::Vector3& position, const sm::Vector3& velocity,
+        const sm::Vector3& color, float intensity, float radius, float flickerPhase,
+        float flickerRate);
+
+    /// <summary>
+    /// Advances all lights by a time step. A light must not move further than the
+    /// size of the bounds in a single step.
+    /// </summary>
+    /// <param name="dt">Seconds.</param>
+    void Update(float dt);
+
+    /// <summary>
+    /// Writes lights into packed lights, e.g. straight into the lights of a pool.
+    /// The color is multiplied by the intensity.
+    /// </summary>
+    /// <param name="first">First light to write.</param>
+    /// <param name="last">End of the lights to write.</param>
+    /// <param name="dest">Packed light of the first light.</param>
+    void WriteLights(UINT32 first, UINT32 last, LightPool::PackedLight* dest) const;
+
+    /// <summary>
+    /// Writes lights as instances of light volumes: 3 floats each of position, scale
+    /// (twice the radius) and color times intensity, e.g. straight into a mapped
+    /// instance buffer.
+    /// </summary>
+    /// <param name="lights">Indices of the lights to write.</param>
+    /// <param name="dest">Instance of the first light.</param>
+    /// <param name="stride">Bytes from one instance to the next.</param>
+    void WriteInstances(const std::vector<UINT32>& lights, void* dest,
+        UINT32 stride) const;
+
+    /// <summary>
+    /// Selects the implementation. AVX2 falls back to SCALAR if not supported.
+    /// </summary>
+    void SetPath(Path path);
+    Path GetPath() const;
+
+    UINT32 GetCount() const;
+
+    // Per light, GetCount() values each.
+    const float* GetPositionX() const;
+    const float* GetPositionY() const;
+    const float* GetPositionZ() const;
+    const float* GetColorR() const;
+    const float* GetColorG() const;
+    const float* GetColorB() const;
+    const float* GetIntensity() const;
+    const float* GetRadius() const;
+
+private:
+    /// <summary>
+    /// Advances the lights [first, last).
+    /// </summary>
+    void updateScalar(float dt, UINT32 first, UINT32 last);
+
+    /// <summary>
+    /// Advances the lights [first, last), last - first a multiple of 8.
+    /// </summary>
+    void updateAvx2(float dt, UINT32 first, UINT32 last);
+
+    UINT32 m_lightCnt = 0;
+    Path m_path;
+    sm::Vector3 m_boundsMin;
+    sm::Vector3 m_boundsMax;
+
+    // Per light.
+    std::vector<float> m_positionX;
+    std::vector<float> m_positionY;
+    std::vector<float> m_positionZ;
+    std::vector<float> m_velocityX;
+    std::vector<float> m_velocityY;
+    std::vector<float> m_velocityZ;
+    std::vector<float> m_colorR;
+    std::vector<float> m_colorG;
+    std::vector<float> m_colorB;
+    std::vector<float> m_baseIntensity;     // Without flicker.
+    std::vector<float> m_intensity;
+    std::vector<float> m_baseRadius;
+    std::vector<float> m_radius;
+    std::vector<float> m_flickerPhase;
+    std::vector<float> m_flickerRate;
+};
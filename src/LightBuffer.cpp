@@ -0,0 +1,115 @@
+#include "stdafx.h"
+#include "LightBuffer.h"
+#include "ResourceRegistry.h"
+#include "RenderStats.h"
+
+
+/*
+ * LightBuffer::Init
+ */
+void LightBuffer::Init(wrl::ComPtr<ID3D11Device> d3dDevice,
+        wrl::ComPtr<ID3D11DeviceContext> d3dContext) {
+    m_d3dDevice = d3dDevice;
+    m_d3dContext = d3dContext;
+    m_capacity = 0;
+    resize(1);
+}
+
+
+/*
+ * LightBuffer::Upload
+ */
+void LightBuffer::Upload(LightPool& pool) {
+    m_uploadedBytes = 0;
+    UINT32 begin = pool.GetDirtyBegin();
+    UINT32 end = pool.GetDirtyEnd();
+    if (pool.GetCount() > m_capacity) {
+        resize(pool.GetCount());
+        begin = 0;
+        end = pool.GetCount();
+    }
+    pool.ClearDirty();
+    if (begin == end) {
+        return;
+    }
+
+    // Map() of a staging buffer waits for the GPU to finish its last copy from it,
+    // which the other buffer gave a frame of time.
+    const UINT32 stride = sizeof(LightPool::PackedLight);
+    ID3D11Buffer* stagingBuffer = m_stagingBuffers[m_stagingIdx].Get();
+    m_stagingIdx = (m_stagingIdx + 1) % m_stagingBuffers.size();
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    HRESULT hr = m_d3dContext->Map(stagingBuffer, 0, D3D11_MAP_WRITE, 0,
+        &mappedResource);
+    assert(SUCCEEDED(hr));
+    std::memcpy(static_cast<BYTE*>(mappedResource.pData) + begin * stride,
+        &pool.GetLights()[begin], static_cast<size_t>(end - begin) * stride);
+    m_d3dContext->Unmap(stagingBuffer, 0);
+
+    D3D11_BOX box = { begin * stride, 0, 0, end * stride, 1, 1 };
+    m_d3dContext->CopySubresourceRegion(m_buffer.Get(), 0, begin * stride, 0, 0,
+        stagingBuffer, 0, &box);
+    m_uploadedBytes = static_cast<UINT64>(end - begin) * stride;
+    RenderStats::AddUpload(m_uploadedBytes);
+}
+
+
+/*
+ * LightBuffer::GetSrv
+ */
+wrl::ComPtr<ID3D11ShaderResourceView> LightBuffer::GetSrv() const {
+    return m_srv;
+}
+
+
+/*
+ * LightBuffer::GetUploadedBytes
+ */
+UINT64 LightBuffer::GetUploadedBytes() const {
+    return m_uploadedBytes;
+}
+
+
+/*
+ * LightBuffer::resize
+ */
+void LightBuffer::resize(UINT32 lightCnt) {
+    // Grow by half of the size, so adding a few lights at a time does not recreate
+    // the buffers every frame.
+    m_capacity = std::max(lightCnt + lightCnt / 2, m_capacity);
+    const UINT32 stride = sizeof(LightPool::PackedLight);
+
+    D3D11_BUFFER_DESC bufferDesc = {};
+    bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    bufferDesc.ByteWidth = m_capacity * stride;
+    bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    bufferDesc.StructureByteStride = stride;
+    HRESULT hr = m_d3dDevice->CreateBuffer(&bufferDesc, nullptr,
+        m_buffer.ReleaseAndGetAddressOf());
+    assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_buffer.Get(), ResourceRegistry::Category::OTHER,
+        "LightBuffer::m_buffer");
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    srvDesc.Buffer.FirstElement = 0;
+    srvDesc.Buffer.NumElements = m_capacity;
+    hr = m_d3dDevice->CreateShaderResourceView(m_buffer.Get(), &srvDesc,
+        m_srv.ReleaseAndGetAddressOf());
+    assert(SUCCEEDED(hr));
+
+    D3D11_BUFFER_DESC stagingDesc = {};
+    stagingDesc.Usage = D3D11_USAGE_STAGING;
+    stagingDesc.ByteWidth = m_capacity * stride;
+    stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    for (wrl::ComPtr<ID3D11Buffer>& stagingBuffer : m_stagingBuffers) {
+        hr = m_d3dDevice->CreateBuffer(&stagingDesc, nullptr,
+            stagingBuffer.ReleaseAndGetAddressOf());
+        assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(stagingBuffer.Get(),
+            ResourceRegistry::Category::OTHER, "LightBuffer::m_stagingBuffers");
+    }
+    m_stagingIdx = 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "LightPool.h"
+
+/// <summary>
+/// GPU copy of a LightPool: a structured buffer with a shader resource view, kept
+/// up to date by uploading only the lights that changed.
+/// </summary>
+/// <remarks>
+/// The changed range is written into one of two staging buffers and copied into
+/// the structured buffer on the GPU. The staging buffers alternate every upload,
+/// so the CPU never writes into the one the GPU may still be copying from. The
+/// buffers grow by half when the pool outgrows them, which uploads all lights.
+/// </remarks>
+class LightBuffer {
+public:
+    /// <summary>
+    /// Creates the buffers for a single light.
+    /// </summary>
+    void Init(wrl::ComPtr<ID3D11Device> d3dDevice,
+        wrl::ComPtr<ID3D11DeviceContext> d3dContext);
+
+    /// <summary>
+    /// Uploads the dirty range of a pool and clears it.
+    /// </summary>
+    void Upload(LightPool& pool);
+
+    /// <summary>
+    /// Returns the view of the lights, StructuredBuffer of LightPool::PackedLight.
+    /// Changes when the buffer grows.
+    /// </summary>
+    wrl::ComPtr<ID3D11ShaderResourceView> GetSrv() const;
+
+    /// <summary>
+    /// Returns the bytes of the last Upload().
+    /// </summary>
+    UINT64 GetUploadedBytes() const;
+
+private:
+    /// <summary>
+    /// Recreates the buffers for at least a number of lights.
+    /// </summary>
+    void resize(UINT32 lightCnt);
+
+    wrl::ComPtr<ID3D11Buffer> m_buffer;
+    wrl::ComPtr<ID3D11ShaderResourceView> m_srv;
+    std::array<wrl::ComPtr<ID3D11Buffer>, 2> m_stagingBuffers;
+    UINT32 m_stagingIdx = 0;        // Staging buffer of the next upload.
+    UINT32 m_capacity = 0;          // Lights.
+    UINT64 m_uploadedBytes = 0;
+
+    // Direct3D stuff.
+    wrl::ComPtr<ID3D11Device> m_d3dDevice;
+    wrl::ComPtr<ID3D11DeviceContext> m_d3dContext;
+};
@@ -0,0 +1,182 @@
+#include "stdafx.h"
+#include "LightBvh.h"
+
+
+// Refits between two checks of the cost. The check visits every node.
+static const UINT32 COST_CHECK_INTERVAL = 16;
+
+// Growth of the cost since the build that triggers a rebuild.
+static const float REBUILD_COST_FACTOR = 1.5f;
+
+
+/*
+ * LightBvh::Build
+ */
+void LightBvh::Build(const std::vector<sm::Vector4>& lights) {
+    m_lights = lights;
+    m_bounds.resize(lights.size());
+    for (size_t i = 0; i < lights.size(); i++) {
+        m_bounds[i] = toBox(lights[i]);
+    }
+    m_bvh.Build(m_bounds);
+    m_builtCost = m_bvh.ComputeCost();
+    m_refitCnt = 0;
+    m_buildCnt++;
+}
+
+
+/*
+ * LightBvh::Clear
+ */
+void LightBvh::Clear() {
+    m_bvh.Clear();
+    m_lights.clear();
+    m_bounds.clear();
+    m_builtCost = 0.0f;
+    m_refitCnt = 0;
+}
+
+
+/*
+ * LightBvh::SetLight
+ */
+void LightBvh::SetLight(UINT32 idx, const sm::Vector4& light) {
+    m_lights[idx] = light;
+    m_bounds[idx] = toBox(light);
+    m_bvh.SetPrimitiveBounds(idx, m_bounds[idx]);
+}
+
+
+/*
+ * LightBvh::Refit
+ */
+void LightBvh::Refit() {
+    m_bvh.Refit();
+    if (++m_refitCnt % COST_CHECK_INTERVAL == 0 &&
+            m_bvh.ComputeCost() > m_builtCost * REBUILD_COST_FACTOR) {
+        m_bvh.Build(m_bounds);
+        m_builtCost = m_bvh.ComputeCost();
+        m_refitCnt = 0;
+        m_buildCnt++;
+    }
+}
+
+
+/*
+ * LightBvh::QuerySphere
+ */
+void LightBvh::QuerySphere(const sm::Vector3& center, float radius,
+        std::vector<UINT32>& result) const {
+    m_bvh.QuerySphere(center, radius, result);
+    auto isOutside = [this, &center, radius](UINT32 idx) {
+        const sm::Vector4& light = m_lights[idx];
+        float reach = radius + light.w;
+        return sm::Vector3::DistanceSquared(center,
+            sm::Vector3(light.x, light.y, light.z)) > reach * reach;
+    };
+    result.erase(std::remove_if(result.begin(), result.end(), isOutside),
+        result.end());
+}
+
+
+/*
+ * LightBvh::QueryBox
+ */
+void LightBvh::QueryBox(const sm::Vector3& boxMin, const sm::Vector3& boxMax,
+        std::vector<UINT32>& result) const {
+    m_bvh.QueryBox(boxMin, boxMax, result);
+    auto isOutside = [this, &boxMin, &boxMax](UINT32 idx) {
+        const sm::Vector4& light = m_lights[idx];
+        sm::Vector3 center(light.x, light.y, light.z);
+        sm::Vector3 nearest = sm::Vector3::Min(sm::Vector3::Max(center, boxMin), boxMax);
+        return sm::Vector3::DistanceSquared(center, nearest) > light.w * light.w;
+    };
+    result.erase(std::remove_if(result.begin(), result.end(), isOutside),
+        result.end());
+}
+
+
+/*
+ * LightBvh::QueryFrustum
+ */
+void LightBvh::QueryFrustum(const FrustumCuller::Planes& planes,
+        std::vector<UINT32>& result) const {
+    m_bvh.Cull(planes, result);
+    auto isOutside = [this, &planes](UINT32 idx) {
+        const sm::Vector4& light = m_lights[idx];
+        for (const sm::Vector4& plane : planes) {
+            if (plane.x * light.x + plane.y * light.y + plane.z * light.z + plane.w <
+                    -light.w) {
+                return true;
+            }
+        }
+        return false;
+    };
+    result.erase(std::remove_if(result.begin(), result.end(), isOutside),
+        result.end());
+}
+
+
+/*
+ * LightBvh::RaycastNearest
+ */
+UINT32 LightBvh::RaycastNearest(const sm::Vector3& origin,
+        const sm::Vector3& direction, float& maxT) const {
+    float a = direction.Dot(direction);
+    if (a == 0.0f) {
+        return NO_LIGHT;
+    }
+    auto intersect = [this, &origin, &direction, a](UINT32 idx, float& t) {
+        // |origin + t * direction - center|^2 = radius^2, entry is the smaller root.
+        const sm::Vector4& light = m_lights[idx];
+        sm::Vector3 offset = origin - sm::Vector3(light.x, light.y, light.z);
+        float b = offset.Dot(direction);
+        float c = offset.Dot(offset) - light.w * light.w;
+        float discriminant = b * b - a * c;
+        if (discriminant < 0.0f) {
+            return false;
+        }
+        float root = std::sqrt(discriminant);
+        float exitT = (-b + root) / a;
+        float entryT = std::max((-b - root) / a, 0.0f);
+        if (exitT < 0.0f || entryT >= t) {
+            return false;
+        }
+        t = entryT;
+        return true;
+    };
+    return m_bvh.Raycast(origin, direction, maxT, intersect);
+}
+
+
+/*
+ * LightBvh::GetCount
+ */
+UINT32 LightBvh::GetCount() const {
+    return static_cast<UINT32>(m_lights.size());
+}
+
+
+/*
+ * LightBvh::GetBuildCount
+ */
+UINT32 LightBvh::GetBuildCount() const {
+    return m_buildCnt;
+}
+
+
+/*
+ * LightBvh::GetBvh
+ */
+const Bvh& LightBvh::GetBvh() const {
+    return m_bvh;
+}
+
+
+/*
+ * LightBvh::toBox
+ */
+dx::BoundingBox LightBvh::toBox(const sm::Vector4& light) {
+    return dx::BoundingBox(sm::Vector3(light.x, light.y, light.z),
+        sm::Vector3(light.w, light.w, light.w));
+}
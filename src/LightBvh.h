@@ -0,0 +1,102 @@
+#pragma once
+#include "Bvh.h"
+
+/// <summary>
+/// Bounding volume hierarchy over the bounding spheres of point lights. Answers
+/// which lights reach a sphere, a box or a frustum and which light a ray enters
+/// first, without testing every light.
+/// </summary>
+/// <remarks>
+/// The hierarchy (see Bvh) is built over the boxes around the spheres. Queries
+/// traverse the boxes and then test the spheres exactly, so the results are the
+/// same as testing every sphere. Moving or resizing lights only refits the boxes.
+/// Refits keep the topology, which gets worse the further lights move: every few
+/// refits the cost of the hierarchy is compared with its cost after the last build
+/// and the hierarchy is rebuilt if it grew too much. No Direct3D is involved.
+/// </remarks>
+class LightBvh {
+public:
+    /// <summary>
+    /// Result of RaycastNearest() if no light was hit.
+    /// </summary>
+    static const UINT32 NO_LIGHT = Bvh::NO_PRIMITIVE;
+
+    /// <summary>
+    /// Builds the hierarchy from scratch.
+    /// </summary>
+    /// <param name="lights">Bounding spheres, world space center in xyz and radius
+    /// in w. The index of a light is its index in here.</param>
+    void Build(const std::vector<sm::Vector4>& lights);
+
+    /// <summary>
+    /// Removes all lights.
+    /// </summary>
+    void Clear();
+
+    /// <summary>
+    /// Changes the bounding sphere of a light. Takes effect with the next Refit().
+    /// </summary>
+    void SetLight(UINT32 idx, const sm::Vector4& light);
+
+    /// <summary>
+    /// Updates the hierarchy after SetLight(). Rebuilds it if refits degraded it.
+    /// </summary>
+    void Refit();
+
+    /// <summary>
+    /// Collects all lights whose sphere intersects another sphere.
+    /// </summary>
+    /// <param name="result">Output. Cleared first, in no particular order.</param>
+    void QuerySphere(const sm::Vector3& center, float radius,
+        std::vector<UINT32>& result) const;
+
+    /// <summary>
+    /// Collects all lights whose sphere intersects a box.
+    /// </summary>
+    /// <param name="result">Output. Cleared first, in no particular order.</param>
+    void QueryBox(const sm::Vector3& boxMin, const sm::Vector3& boxMax,
+        std::vector<UINT32>& result) const;
+
+    /// <summary>
+    /// Collects all lights whose sphere is not outside of a frustum plane.
+    /// </summary>
+    /// <param name="planes">Normalized frustum planes (see
+    /// FrustumCuller::ExtractPlanes).</param>
+    /// <param name="result">Output. Cleared first, in no particular order.</param>
+    void QueryFrustum(const FrustumCuller::Planes& planes,
+        std::vector<UINT32>& result) const;
+
+    /// <summary>
+    /// Finds the light whose sphere a ray enters first. A ray starting inside of
+    /// spheres hits them at t = 0.
+    /// </summary>
+    /// <param name="origin">Start of the ray.</param>
+    /// <param name="direction">Direction of the ray, t is measured in its length.
+    /// </param>
+    /// <param name="maxT">Input: end of the ray. Output: t of the hit.</param>
+    /// <returns>Index of the light or NO_LIGHT.</returns>
+    UINT32 RaycastNearest(const sm::Vector3& origin, const sm::Vector3& direction,
+        float& maxT) const;
+
+    UINT32 GetCount() const;
+
+    /// <summary>
+    /// Returns the number of Build() calls, including rebuilds by Refit().
+    /// </summary>
+    UINT32 GetBuildCount() const;
+
+    const Bvh& GetBvh() const;
+
+private:
+    /// <summary>
+    /// Box around a sphere.
+    /// </summary>
+    static dx::BoundingBox toBox(const sm::Vector4& light);
+
+    Bvh m_bvh;
+    std::vector<sm::Vector4> m_lights;
+    std::vector<dx::BoundingBox> m_bounds;  // Per light, input of rebuilds.
+    float m_builtCost = 0.0f;               // Bvh::ComputeCost() after the build.
+    UINT32 m_refitCnt = 0;                  // Since the build.
+    UINT32 m_buildCnt = 0;
+};
@@ -0,0 +1,233 @@
+#include "stdafx.h"
+#include "LightLod.h"
+
+
+/*
+ * LightLod::Build
+ */
+void LightLod::Build(const std::vector<sm::Vector4>& lights,
+        const std::vector<sm::Vector3>& colors) {
+    assert(lights.size() == colors.size());
+    m_lights = lights;
+    m_colors = colors;
+    std::vector<sm::Vector4> centers(lights.size());
+    for (size_t i = 0; i < lights.size(); i++) {
+        centers[i] = sm::Vector4(lights[i].x, lights[i].y, lights[i].z, 0.0f);
+    }
+    m_centers.Build(centers);
+}
+
+
+/*
+ * LightLod::Clear
+ */
+void LightLod::Clear() {
+    m_centers.Clear();
+    m_lights.clear();
+    m_colors.clear();
+    m_keptLights.clear();
+    m_virtualLights.clear();
+    m_mergedLights.clear();
+    m_visitedNodeCnt = 0;
+}
+
+
+/*
+ * LightLod::SetLight
+ */
+void LightLod::SetLight(UINT32 idx, const sm::Vector4& light, const sm::Vector3& color) {
+    m_lights[idx] = light;
+    m_colors[idx] = color;
+    m_centers.SetLight(idx, sm::Vector4(light.x, light.y, light.z, 0.0f));
+}
+
+
+/*
+ * LightLod::Refit
+ */
+void LightLod::Refit() {
+    m_centers.Refit();
+}
+
+
+/*
+ * LightLod::GetCount
+ */
+UINT32 LightLod::GetCount() const {
+    return static_cast<UINT32>(m_lights.size());
+}
+
+
+/*
+ * LightLod::SetSettings
+ */
+void LightLod::SetSettings(const Settings& settings) {
+    m_settings = settings;
+}
+
+
+/*
+ * LightLod::GetSettings
+ */
+const LightLod::Settings& LightLod::GetSettings() const {
+    return m_settings;
+}
+
+
+/*
+ * LightLod::Update
+ */
+void LightLod::Update(const sm::Vector3& viewPos, float pixelScale) {
+    m_keptLights.clear();
+    m_virtualLights.clear();
+    m_mergedLights.clear();
+    m_visitedNodeCnt = 0;
+
+    // Kept lights are flagged, collecting the flags keeps them in order.
+    const std::vector<UINT32>& ordered = m_centers.GetBvh().GetOrderedPrimitives();
+    m_isKept.assign(m_lights.size(), 0);
+    auto keep = [this, &ordered](UINT32 first, UINT32 count) {
+        for (UINT32 i = first; i < first + count; i++) {
+            m_isKept[ordered[i]] = 1;
+        }
+    };
+    auto visit = [this, &viewPos, pixelScale, &keep](const sm::Vector3& boundsMin,
+            const sm::Vector3& boundsMax, UINT32 first, UINT32 count, bool isLeaf) {
+        m_visitedNodeCnt++;
+        if (count == 1) {
+            keep(first, count);
+            return false;
+        }
+
+        // Distance to the nearest point of the sphere around the centers.
+        float size = sm::Vector3::Distance(boundsMin, boundsMax);
+        float distance = sm::Vector3::Distance((boundsMin + boundsMax) * 0.5f, viewPos) -
+            0.5f * size;
+        if (distance >= m_settings.minDistance &&
+                size * pixelScale <= m_settings.maxMergeSize * distance) {
+            merge(first, count);
+            return false;
+        }
+        if (isLeaf) {
+            keep(first, count);
+            return false;
+        }
+        return true;
+    };
+    m_centers.GetBvh().Traverse(visit);
+    for (UINT32 i = 0; i < m_isKept.size(); i++) {
+        if (m_isKept[i]) {
+            m_keptLights.push_back(i);
+        }
+    }
+}
+
+
+/*
+ * LightLod::GetKeptLights
+ */
+const std::vector<UINT32>& LightLod::GetKeptLights() const {
+    return m_keptLights;
+}
+
+
+/*
+ * LightLod::GetVirtualLights
+ */
+const std::vector<LightLod::VirtualLight>& LightLod::GetVirtualLights() const {
+    return m_virtualLights;
+}
+
+
+/*
+ * LightLod::GetMergedLights
+ */
+const std::vector<UINT32>& LightLod::GetMergedLights() const {
+    return m_mergedLights;
+}
+
+
+/*
+ * LightLod::GetVisitedNodeCount
+ */
+UINT32 LightLod::GetVisitedNodeCount() const {
+    return m_visitedNodeCnt;
+}
+
+
+/*
+ * LightLod::ComputeError
+ */
+float LightLod::ComputeError(const std::vector<sm::Vector3>& points,
+        const std::function<float(float dist, float radius)>& attenuation) const {
+    auto arriving = [&attenuation](const sm::Vector3& point, const sm::Vector3& position,
+            float radius, const sm::Vector3& color) {
+        float dist = sm::Vector3::Distance(point, position);
+        return dist < radius ? color * attenuation(dist, radius) : sm::Vector3::Zero;
+    };
+
+    double errorSum = 0.0;
+    double referenceSum = 0.0;
+    for (const sm::Vector3& point : points) {
+        sm::Vector3 reference = sm::Vector3::Zero;
+        for (size_t i = 0; i < m_lights.size(); i++) {
+            const sm::Vector4& light = m_lights[i];
+            reference += arriving(point, sm::Vector3(light.x, light.y, light.z),
+                light.w, m_colors[i]);
+        }
+        sm::Vector3 merged = sm::Vector3::Zero;
+        for (UINT32 i : m_keptLights) {
+            const sm::Vector4& light = m_lights[i];
+            merged += arriving(point, sm::Vector3(light.x, light.y, light.z), light.w,
+                m_colors[i]);
+        }
+        for (const VirtualLight& virtualLight : m_virtualLights) {
+            merged += arriving(point, virtualLight.position, virtualLight.radius,
+                virtualLight.color);
+        }
+        errorSum += sm::Vector3::DistanceSquared(reference, merged);
+        referenceSum += reference.LengthSquared();
+    }
+    return referenceSum > 0.0 ? float(std::sqrt(errorSum / referenceSum)) : 0.0f;
+}
+
+
+/*
+ * LightLod::merge
+ */
+void LightLod::merge(UINT32 first, UINT32 count) {
+    const std::vector<UINT32>& ordered = m_centers.GetBvh().GetOrderedPrimitives();
+    VirtualLight virtualLight;
+    virtualLight.first = static_cast<UINT32>(m_mergedLights.size());
+    virtualLight.count = count;
+    m_mergedLights.insert(m_mergedLights.end(), ordered.begin() + first,
+        ordered.begin() + first + count);
+
+    // Brightness weighted centroid. Black lights fall back to the plain one.
+    sm::Vector3 color = sm::Vector3::Zero;
+    sm::Vector3 weightedSum = sm::Vector3::Zero;
+    sm::Vector3 sum = sm::Vector3::Zero;
+    float weightSum = 0.0f;
+    for (UINT32 i = first; i < first + count; i++) {
+        const sm::Vector4& light = m_lights[ordered[i]];
+        const sm::Vector3& lightColor = m_colors[ordered[i]];
+        sm::Vector3 position(light.x, light.y, light.z);
+        float weight = lightColor.x + lightColor.y + lightColor.z;
+        color += lightColor;
+        weightedSum += weight * position;
+        sum += position;
+        weightSum += weight;
+    }
+    virtualLight.color = color;
+    virtualLight.position = weightSum > 0.0f ? weightedSum / weightSum :
+        sum / float(count);
+
+    virtualLight.radius = 0.0f;
+    for (UINT32 i = first; i < first + count; i++) {
+        const sm::Vector4& light = m_lights[ordered[i]];
+        virtualLight.radius = std::max(virtualLight.radius, light.w +
+            sm::Vector3::Distance(virtualLight.position,
+                sm::Vector3(light.x, light.y, light.z)));
+    }
+    m_virtualLights.push_back(virtualLight);
+}
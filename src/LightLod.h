@@ -0,0 +1,130 @@
+#pragma once
+#include "LightBvh.h"
+
+/// <summary>
+/// Level of detail for many point lights: lights far from the camera are merged
+/// into few virtual lights every frame, so distant groups of small lights do not
+/// cost full shading work each.
+/// </summary>
+/// <remarks>
+/// The lights are clustered by a hierarchy over their centers (a LightBvh with
+/// radius 0). Update() cuts it top-down: a node whose lights span at most
+/// Settings::maxMergeSize pixels, seen from the camera, and that is at least
+/// Settings::minDistance away becomes a single virtual light, otherwise its
+/// children are visited. Leaves that are too large keep their lights. Only the
+/// nodes above the cut are visited, so the cost is bounded by the size of the cut
+/// plus the merged lights. A virtual light conserves the energy of its lights: its
+/// color is their sum, placed at their centroid weighted by brightness. Its radius
+/// bounds the spheres of all of them. No Direct3D is involved.
+/// </remarks>
+class LightLod {
+public:
+    /// <summary>
+    /// Error budget of the merging.
+    /// </summary>
+    struct Settings {
+        float maxMergeSize = 2.0f;      // Pixels the merged lights may span.
+        float minDistance = 60.0f;      // Nearer lights are never merged.
+    };
+
+    /// <summary>
+    /// Aggregate of merged lights.
+    /// </summary>
+    struct VirtualLight {
+        sm::Vector3 position;
+        float radius;
+        sm::Vector3 color;
+        UINT32 first;       // Merged lights in GetMergedLights(), [first, first + count).
+        UINT32 count;
+    };
+
+    /// <summary>
+    /// Builds the hierarchy from scratch.
+    /// </summary>
+    /// <param name="lights">Bounding spheres, world space center in xyz and radius
+    /// in w. The index of a light is its index in here.</param>
+    /// <param name="colors">Color per light, including its intensity.</param>
+    void Build(const std::vector<sm::Vector4>& lights,
+        const std::vector<sm::Vector3>& colors);
+
+    /// <summary>
+    /// Removes all lights.
+    /// </summary>
+    void Clear();
+
+    /// <summary>
+    /// Changes a light. Takes effect with the next Refit().
+    /// </summary>
+    void SetLight(UINT32 idx, const sm::Vector4& light, const sm::Vector3& color);
+
+    /// <summary>
+    /// Updates the hierarchy after SetLight().
+    /// </summary>
+    void Refit();
+
+    UINT32 GetCount() const;
+
+    void SetSettings(const Settings& settings);
+    const Settings& GetSettings() const;
+
+    /// <summary>
+    /// Merges the distant lights for a view.
+    /// </summary>
+    /// <param name="viewPos">Position of the camera.</param>
+    /// <param name="pixelScale">Pixels per unit at a distance of 1, e.g. half the
+    /// screen height times _22 of the projection matrix.</param>
+    void Update(const sm::Vector3& viewPos, float pixelScale);
+
+    /// <summary>
+    /// Returns the lights of the last Update() that were not merged, ascending.
+    /// </summary>
+    const std::vector<UINT32>& GetKeptLights() const;
+
+    /// <summary>
+    /// Returns the virtual lights of the last Update().
+    /// </summary>
+    const std::vector<VirtualLight>& GetVirtualLights() const;
+
+    /// <summary>
+    /// Returns the lights of all virtual lights, back to back.
+    /// </summary>
+    const std::vector<UINT32>& GetMergedLights() const;
+
+    /// <summary>
+    /// Returns the number of nodes the last Update() visited.
+    /// </summary>
+    UINT32 GetVisitedNodeCount() const;
+
+    /// <summary>
+    /// Compares the lighting of the last Update() with the unmerged lights: the
+    /// light arriving at some points, summed over all lights, without normals.
+    /// Tests every light at every point.
+    /// </summary>
+    /// <param name="points">Where the lighting is compared, e.g. surface points.
+    /// </param>
+    /// <param name="attenuation">Falloff of the lighting shaders for a distance and
+    /// a light radius.</param>
+    /// <returns>Root mean square error relative to the root mean square of the
+    /// unmerged lighting.</returns>
+    float ComputeError(const std::vector<sm::Vector3>& points,
+        const std::function<float(float dist, float radius)>& attenuation) const;
+
+private:
+    /// <summary>
+    /// Adds a virtual light for the lights [first, first + count) of the
+    /// hierarchy.
+    /// </summary>
+    void merge(UINT32 first, UINT32 count);
+
+    Settings m_settings;
+    LightBvh m_centers;                     // Over the centers, radius 0.
+    std::vector<sm::Vector4> m_lights;
+    std::vector<sm::Vector3> m_colors;
+    std::vector<UINT8> m_isKept;            // Per light, scratch of Update().
+
+    // Result.
+    std::vector<UINT32> m_keptLights;
+    std::vector<VirtualLight> m_virtualLights;
+    std::vector<UINT32> m_mergedLights;
+    UINT32 m_visitedNodeCnt = 0;
+};
@@ -0,0 +1,233 @@
+#include "stdafx.h"
+#include "LightPool.h"
+
+
+// Matches the Light struct of PackedLight.hlsli.
+static_assert(sizeof(LightPool::PackedLight) == 20, "Unexpected light layout");
+
+
+/*
+ * LightPool::PackColor
+ */
+UINT32 LightPool::PackColor(const sm::Vector3& color) {
+    // As DXGI_FORMAT_R9G9B9E5_SHAREDEXP: the exponent of the brightest channel, biased
+    // by 15, scales 9 bit mantissas. A mantissa that rounds up to 512 takes the next
+    // exponent.
+    auto clamp = [](float value) {
+        return std::min(std::max(value, 0.0f), MAX_COLOR);
+    };
+    sm::Vector3 clamped(clamp(color.x), clamp(color.y), clamp(color.z));
+    float brightest = std::max(std::max(clamped.x, clamped.y), clamped.z);
+    int exponent = 0;
+    std::frexp(brightest, &exponent);
+    exponent = std::max(exponent, -15) + 15;
+    auto toMantissa = [&exponent](float value) {
+        return static_cast<UINT32>(std::ldexp(value, 24 - exponent) + 0.5f);
+    };
+    if (toMantissa(brightest) == 512) {
+        exponent++;
+    }
+    return toMantissa(clamped.x) | (toMantissa(clamped.y) << 9) |
+        (toMantissa(clamped.z) << 18) | (static_cast<UINT32>(exponent) << 27);
+}
+
+
+/*
+ * LightPool::UnpackColor
+ */
+sm::Vector3 LightPool::UnpackColor(UINT32 color) {
+    float scale = std::ldexp(1.0f, static_cast<int>(color >> 27) - 24);
+    return sm::Vector3(float(color & 0x1FF), float((color >> 9) & 0x1FF),
+        float((color >> 18) & 0x1FF)) * scale;
+}
+
+
+/*
+ * LightPool::Add
+ */
+LightPool::Handle LightPool::Add(const sm::Vector3& position, float radius,
+        const sm::Vector3& color) {
+    UINT32 index = static_cast<UINT32>(m_lights.size());
+    Handle handle = m_freeSlot;
+    if (handle != INVALID_HANDLE) {
+        UINT32 nextSlot = m_slots[handle];
+        m_freeSlot = nextSlot == INVALID_HANDLE ? INVALID_HANDLE : nextSlot & ~FREE_SLOT;
+        m_slots[handle] = index;
+    } else {
+        handle = static_cast<Handle>(m_slots.size());
+        assert(handle < FREE_SLOT);
+        m_slots.push_back(index);
+    }
+
+    PackedLight light;
+    light.positionRadius = sm::Vector4(position.x, position.y, position.z, radius);
+    light.color = PackColor(color);
+    m_lights.push_back(light);
+    m_handles.push_back(handle);
+    markDirty(index);
+    m_isResized = true;
+    return handle;
+}
+
+
+/*
+ * LightPool::Remove
+ */
+void LightPool::Remove(Handle handle) {
+    assert(IsValid(handle));
+    UINT32 index = m_slots[handle];
+    UINT32 lastIndex = static_cast<UINT32>(m_lights.size()) - 1;
+    if (index != lastIndex) {
+        m_lights[index] = m_lights[lastIndex];
+        m_handles[index] = m_handles[lastIndex];
+        m_slots[m_handles[index]] = index;
+        markDirty(index);
+    }
+    m_lights.pop_back();
+    m_handles.pop_back();
+    m_dirtyEnd = std::min(m_dirtyEnd, lastIndex);
+    m_dirtyBegin = std::min(m_dirtyBegin, m_dirtyEnd);
+    m_isResized = true;
+
+    // The end of the free list is INVALID_HANDLE, which has FREE_SLOT set as well.
+    m_slots[handle] = FREE_SLOT | m_freeSlot;
+    m_freeSlot = handle;
+}
+
+
+/*
+ * LightPool::Clear
+ */
+void LightPool::Clear() {
+    m_lights.clear();
+    m_handles.clear();
+    m_slots.clear();
+    m_freeSlot = INVALID_HANDLE;
+    m_dirtyBegin = 0;
+    m_dirtyEnd = 0;
+    m_isResized = true;
+}
+
+
+/*
+ * LightPool::SetPosition
+ */
+void LightPool::SetPosition(Handle handle, const sm::Vector3& position) {
+    UINT32 index = GetIndex(handle);
+    sm::Vector4& positionRadius = m_lights[index].positionRadius;
+    positionRadius = sm::Vector4(position.x, position.y, position.z, positionRadius.w);
+    markDirty(index);
+}
+
+
+/*
+ * LightPool::SetLight
+ */
+void LightPool::SetLight(Handle handle, const sm::Vector3& position, float radius,
+        const sm::Vector3& color) {
+    UINT32 index = GetIndex(handle);
+    m_lights[index].positionRadius = sm::Vector4(position.x, position.y, position.z,
+        radius);
+    m_lights[index].color = PackColor(color);
+    markDirty(index);
+}
+
+
+/*
+ * LightPool::EditLights
+ */
+LightPool::PackedLight* LightPool::EditLights(UINT32 begin, UINT32 end) {
+    assert(begin < end && end <= m_lights.size());
+    markDirty(begin);
+    markDirty(end - 1);
+    return &m_lights[begin];
+}
+
+
+/*
+ * LightPool::IsValid
+ */
+bool LightPool::IsValid(Handle handle) const {
+    return handle < m_slots.size() && (m_slots[handle] & FREE_SLOT) == 0;
+}
+
+
+/*
+ * LightPool::GetIndex
+ */
+UINT32 LightPool::GetIndex(Handle handle) const {
+    assert(IsValid(handle));
+    return m_slots[handle];
+}
+
+
+/*
+ * LightPool::GetHandle
+ */
+LightPool::Handle LightPool::GetHandle(UINT32 index) const {
+    return m_handles[index];
+}
+
+
+/*
+ * LightPool::GetCount
+ */
+UINT32 LightPool::GetCount() const {
+    return static_cast<UINT32>(m_lights.size());
+}
+
+
+/*
+ * LightPool::GetLights
+ */
+const std::vector<LightPool::PackedLight>& LightPool::GetLights() const {
+    return m_lights;
+}
+
+
+/*
+ * LightPool::GetDirtyBegin
+ */
+UINT32 LightPool::GetDirtyBegin() const {
+    return m_dirtyBegin;
+}
+
+
+/*
+ * LightPool::GetDirtyEnd
+ */
+UINT32 LightPool::GetDirtyEnd() const {
+    return m_dirtyEnd;
+}
+
+
+/*
+ * LightPool::IsResized
+ */
+bool LightPool::IsResized() const {
+    return m_isResized;
+}
+
+
+/*
+ * LightPool::ClearDirty
+ */
+void LightPool::ClearDirty() {
+    m_dirtyBegin = 0;
+    m_dirtyEnd = 0;
+    m_isResized = false;
+}
+
+
+/*
+ * LightPool::markDirty
+ */
+void LightPool::markDirty(UINT32 index) {
+    if (m_dirtyBegin == m_dirtyEnd) {
+        m_dirtyBegin = index;
+        m_dirtyEnd = index + 1;
+    } else {
+        m_dirtyBegin = std::min(m_dirtyBegin, index);
+        m_dirtyEnd = std::max(m_dirtyEnd, index + 1);
+    }
+}
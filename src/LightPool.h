@@ -0,0 +1,136 @@
+#pragma once
+
+/// <summary>
+/// CPU side storage of the point lights that can grow and shrink at runtime. The
+/// lights are kept back to back in a compact layout, ready to be copied into a
+/// structured buffer.
+/// </summary>
+/// <remarks>
+/// Lights are referenced by handles that stay valid until the light is removed.
+/// Removing a light moves the last light into its place, so the array never has
+/// holes and its index of a light can change. Free handles are chained into a
+/// list and reused by Add(). The lights written since ClearDirty() form a single
+/// range, the part of the array that has to be uploaded. No Direct3D is involved.
+/// </remarks>
+class LightPool {
+public:
+    /// <summary>
+    /// A light as the shaders read it.
+    /// </summary>
+    struct PackedLight {
+        sm::Vector4 positionRadius;     // World space position and radius.
+        UINT32 color;                   // RGB9E5, see PackColor().
+    };
+
+    typedef UINT32 Handle;
+    static const Handle INVALID_HANDLE = UINT32_MAX;
+
+    /// <summary>
+    /// Largest channel of a packed color, 511 / 512 * 2^16.
+    /// </summary>
+    static constexpr float MAX_COLOR = 65408.0f;
+
+    /// <summary>
+    /// Packs a color including its intensity into RGB9E5: 9 bit mantissas of red
+    /// (lowest bits), green and blue with a shared 5 bit exponent. Channels may
+    /// exceed 1, e.g. the summed colors of merged lights, and are clamped to
+    /// [0, MAX_COLOR]. Each channel is exact to a 512th of the brightest one.
+    /// </summary>
+    static UINT32 PackColor(const sm::Vector3& color);
+
+    /// <summary>
+    /// Unpacks an RGB9E5 color.
+    /// </summary>
+    static sm::Vector3 UnpackColor(UINT32 color);
+
+    /// <summary>
+    /// Adds a light to the end of the array.
+    /// </summary>
+    /// <returns>Handle of the light.</returns>
+    Handle Add(const sm::Vector3& position, float radius, const sm::Vector3& color);
+
+    /// <summary>
+    /// Removes a light. The last light takes its place in the array.
+    /// </summary>
+    void Remove(Handle handle);
+
+    /// <summary>
+    /// Removes all lights. Handles given out before become invalid.
+    /// </summary>
+    void Clear();
+
+    /// <summary>
+    /// Moves a light.
+    /// </summary>
+    void SetPosition(Handle handle, const sm::Vector3& position);
+
+    /// <summary>
+    /// Changes all of a light, e.g. of an animated one.
+    /// </summary>
+    void SetLight(Handle handle, const sm::Vector3& position, float radius,
+        const sm::Vector3& color);
+
+    /// <summary>
+    /// Returns lights for writing, e.g. of many animated lights at once, and adds
+    /// them to the dirty range.
+    /// </summary>
+    /// <returns>Lights [begin, end) of GetLights().</returns>
+    PackedLight* EditLights(UINT32 begin, UINT32 end);
+
+    /// <summary>
+    /// Returns true if a handle belongs to a light that was not removed.
+    /// </summary>
+    bool IsValid(Handle handle) const;
+
+    /// <summary>
+    /// Returns the index of a light in GetLights().
+    /// </summary>
+    UINT32 GetIndex(Handle handle) const;
+
+    /// <summary>
+    /// Returns the handle of the light at an index of GetLights().
+    /// </summary>
+    Handle GetHandle(UINT32 index) const;
+
+    UINT32 GetCount() const;
+
+    /// <summary>
+    /// Returns all lights, back to back.
+    /// </summary>
+    const std::vector<PackedLight>& GetLights() const;
+
+    /// <summary>
+    /// Returns the lights written since ClearDirty(), indices [begin, end). Empty if
+    /// begin == end. Removed lights at the end are not part of it.
+    /// </summary>
+    UINT32 GetDirtyBegin() const;
+    UINT32 GetDirtyEnd() const;
+
+    /// <summary>
+    /// Returns true if lights were added or removed since ClearDirty(). The number of
+    /// lights changed, not only their content.
+    /// </summary>
+    bool IsResized() const;
+
+    /// <summary>
+    /// Marks all lights as uploaded.
+    /// </summary>
+    void ClearDirty();
+
+private:
+    /// <summary>
+    /// Adds a light index to the dirty range.
+    /// </summary>
+    void markDirty(UINT32 index);
+
+    // A slot per handle. Free slots have FREE_SLOT set and hold the next free one.
+    static const UINT32 FREE_SLOT = 0x80000000u;
+
+    std::vector<PackedLight> m_lights;
+    std::vector<Handle> m_handles;      // Of every light.
+    std::vector<UINT32> m_slots;        // Index of the light per handle.
+    UINT32 m_freeSlot = INVALID_HANDLE;
+    UINT32 m_dirtyBegin = 0;
+    UINT32 m_dirtyEnd = 0;
+    bool m_isResized = false;
+};
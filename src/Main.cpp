@@ -1,5 +1,10 @@
 #include "stdafx.h"
 #include "Application.h"
+#include "Benchmark.h"
+#include "Telemetry.h"
+
+// CommandLineToArgvW.
+#include <shellapi.h>
 
 /// <summary>
 /// Entry point of a Win32 application. Taken from
@@ -18,6 +23,29 @@
 /// <returns>Status code of application.</returns>
 int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
         _In_ PWSTR pCmdLine, _In_ int nCmdShow){
+    // Benchmark modes. Run instead of the application:
+    //   --benchmark [output.json]
+    //   --benchmark-compare <base.json> <current.json> [report.txt]
+    // The compare mode returns 1 if a significant regression was found.
+    // Telemetry reader. Attaches to a running instance and prints its frames as CSV:
+    //   --telemetry-reader [output.csv]
+    int argCnt = 0;
+    LPWSTR* args = CommandLineToArgvW(GetCommandLineW(), &argCnt);
+    std::vector<std::string> arguments;
+    for (int i = 1; args && i < argCnt; i++) {
+        arguments.push_back(Helper::ConvertWideToUtf8(args[i]));
+    }
+    LocalFree(args);
+
+    if (!arguments.empty() && (arguments[0] == "--benchmark" ||
+            arguments[0] == "--benchmark-compare")) {
+        return Benchmark::RunCommand(arguments);
+    }
+
+    if (!arguments.empty() && arguments[0] == "--telemetry-reader") {
+        return Telemetry::RunReader(arguments.size() > 1 ? arguments[1] : "");
+    }
+
     // Create an application which performs the basic Win32 application loop and
     // message handling. This application contains the d3dRenderer for D3D11 stuff.
     std::unique_ptr<Application> app = std::make_unique<Application>(1400,800);
@@ -23,6 +23,12 @@ Mesh::Mesh(
     m_matDefinition = matDefinition;
     m_vertexLayout = vertexLayout;
 
+    // Bounds for culling.
+    if (!m_vertices.empty()) {
+        dx::BoundingBox::CreateFromPoints(m_bounds, m_vertices.size(),
+            &m_vertices[0].Position, sizeof(Vertex));
+    }
+
     // Instanced rendering information.
     m_instanceStride = 0;
     m_instanceCount = 0;
@@ -42,6 +48,12 @@ Mesh::Mesh(
         };
     }
 
+    // Resolve the shader slot of every texture. Avoids string compares in Draw().
+    m_textureSlots.resize(m_textures.size());
+    for (unsigned int texIdx = 0; texIdx < m_textures.size(); texIdx++) {
+        m_textureSlots[texIdx] = getTextureSlot(m_textures[texIdx].type);
+    }
+
     // Setup shaders for rendering the mesh.
     setupShaders(vertexShaderName, pixelShaderName);
 
@@ -98,36 +110,35 @@ void Mesh::Draw(bool depthPass) {
 
     // Bind textures. This will only be performed for models that were loaded from
     // disk --> ModelClass::BaseType::LOADED
+    // Slots were resolved from the texture type once in the constructor.
+    UINT64 srvBindCnt = 0;
     for (unsigned int texIdx = 0; texIdx < m_textures.size(); texIdx++) {
-        std::string name = m_textures[texIdx].type;
-        if (name == "texture_ambient") {
-            m_d3dContext->PSSetShaderResources(0, 1, m_textures[texIdx].srv.GetAddressOf());
-        } else if (name == "texture_diffuse") {
-            m_d3dContext->PSSetShaderResources(1, 1, m_textures[texIdx].srv.GetAddressOf());
-        } else if (name == "texture_specular") {
-            m_d3dContext->PSSetShaderResources(2, 1, m_textures[texIdx].srv.GetAddressOf());
-        } else if (name == "texture_normal") {
-            m_d3dContext->PSSetShaderResources(3, 1, m_textures[texIdx].srv.GetAddressOf());
-        } else if (name == "texture_bump") {
-            m_d3dContext->PSSetShaderResources(4, 1, m_textures[texIdx].srv.GetAddressOf());
-        } else if (name == "texture_dissolve") {
-            m_d3dContext->PSSetShaderResources(5, 1, m_textures[texIdx].srv.GetAddressOf());
-        } else if (name == "texture_emissive") {
-            m_d3dContext->PSSetShaderResources(6, 1, m_textures[texIdx].srv.GetAddressOf());
+        int slot = m_textureSlots[texIdx];
+        if (slot >= 0) {
+            m_d3dContext->PSSetShaderResources(slot, 1,
+                m_textures[texIdx].srv.GetAddressOf());
+            srvBindCnt++;
         }
     }
 
     // Make the draw call.
+    UINT indexCnt = static_cast<UINT>(m_indices.size());
     if (m_usesInstancing) {
         // Draw index+instanced primitives. Uses currently bound vertex, index and
         // instance buffer.
-        m_d3dContext->DrawIndexedInstanced(m_indices.size(),m_instanceCount, 0, 0, 0);
+        RenderStats::DrawIndexedInstanced(m_d3dContext.Get(), indexCnt,
+            m_instanceCount);
     } else {
         // Draw indexed, non-instanced primitives. Uses currently bound vertex and index
         // buffer.
-        m_d3dContext->DrawIndexed(m_indices.size(), 0, 0);
+        RenderStats::DrawIndexed(m_d3dContext.Get(), indexCnt);
     }
 
+    // Instrumentation. Index, vertex (+instance) and material buffer.
+    RenderStats::Add(RenderStats::Counter::SHADER_SWITCHES, 2);
+    RenderStats::Add(RenderStats::Counter::BUFFER_BINDS, m_usesInstancing ? 4 : 3);
+    RenderStats::Add(RenderStats::Counter::SRV_BINDS, srvBindCnt);
+
     // Cleanup.
     ID3D11ShaderResourceView* nullSRV[10] = { nullptr };
     m_d3dContext->VSSetShaderResources(0, 10, nullSRV);
@@ -167,6 +178,8 @@ void Mesh::setupMesh() {
     hr = m_d3dDevice->CreateBuffer(&vertexBufferDesc, &vertexInitData,
         m_vertexBuffer.GetAddressOf());
     assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_vertexBuffer.Get(),
+        ResourceRegistry::Category::VERTEX_BUFFER, "m_vertexBuffer");
 
     // Fill in a buffer description.
     D3D11_BUFFER_DESC indexBufferDesc;
@@ -186,6 +199,8 @@ void Mesh::setupMesh() {
     hr = m_d3dDevice->CreateBuffer(&indexBufferDesc, &indexInitData,
         m_indexBuffer.GetAddressOf());
     assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_indexBuffer.Get(),
+        ResourceRegistry::Category::INDEX_BUFFER, "m_indexBuffer");
 
     // Init texture sampler settings.
     D3D11_SAMPLER_DESC samplerDesc;
@@ -234,6 +249,8 @@ void Mesh::setupMesh() {
     hr = m_d3dDevice->CreateBuffer(&cbPSDesc, &constInitDataPS,
         m_constBufferPS.GetAddressOf());
     assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_constBufferPS.Get(),
+        ResourceRegistry::Category::CONSTANT_BUFFER, "m_constBufferPS");
 }
 
 
@@ -262,6 +279,69 @@ void Mesh::setupShaders(std::wstring vertexShaderName,
 }
 
 
+/*
+ * Mesh::getTextureSlot
+ */
+int Mesh::getTextureSlot(const std::string& type) {
+    if (type == "texture_ambient") {
+        return 0;
+    } else if (type == "texture_diffuse") {
+        return 1;
+    } else if (type == "texture_specular") {
+        return 2;
+    } else if (type == "texture_normal") {
+        return 3;
+    } else if (type == "texture_bump") {
+        return 4;
+    } else if (type == "texture_dissolve") {
+        return 5;
+    } else if (type == "texture_emissive") {
+        return 6;
+    }
+    return -1;
+}
+
+
+/*
+ * Mesh::GetBounds
+ */
+const dx::BoundingBox& Mesh::GetBounds() const {
+    return m_bounds;
+}
+
+
+/*
+ * Mesh::GetVertices
+ */
+const std::vector<Vertex>& Mesh::GetVertices() const {
+    return m_vertices;
+}
+
+
+/*
+ * Mesh::GetIndices
+ */
+const std::vector<unsigned int>& Mesh::GetIndices() const {
+    return m_indices;
+}
+
+
+/*
+ * Mesh::IsOpaque
+ */
+bool Mesh::IsOpaque() const {
+    if (m_matDefinition.matDissolveFactor < 1.0f) {
+        return false;
+    }
+    for (const Texture& texture : m_textures) {
+        if (texture.type == "texture_dissolve") {
+            return false;
+        }
+    }
+    return true;
+}
+
+
 /*
  * Mesh::SetupInstancing
  */
@@ -1,62 +1,9 @@
 #pragma once
 #include "Helper.h"
+#include "ResourceRegistry.h"
+#include "RenderStats.h"
 #include "DirectXMesh.h"
-
-/// <summary>
-/// Describes contents of a vertex.
-/// </summary>
-/// <remarks>
-/// Currently used for all possible models. Sometimes space is wasted. TODO: Improve.
-/// </remarks>
-__declspec(align(16)) struct Vertex {
-    sm::Vector3 Position;
-    sm::Vector2 TexCoords;
-
-    // Normal Mapping.
-    sm::Vector3 Normal;     // Object/model space.
-    sm::Vector3 Tangent;    // Object/model space.
-    sm::Vector3 Bitangent;  // Object/model space.
-
-    Vertex(sm::Vector3 pos, sm::Vector2 texCoords, sm::Vector3 normal,
-            sm::Vector3 tangent, sm::Vector3 bitangent) {
-        Position = pos;
-        TexCoords = texCoords;
-
-        Normal = normal;
-        Tangent = tangent;
-        Bitangent = bitangent;
-    }
-
-    // For supporting cube, sphere, ...
-    Vertex(sm::Vector3 pos, sm::Vector3 normal, sm::Vector2 texCoords) {
-        Position = pos;
-        TexCoords = texCoords;
-
-        Normal = normal;
-        Tangent = sm::Vector3(0.0,0.0,0.0);
-        Bitangent = sm::Vector3(0.0, 0.0, 0.0);
-    }
-
-    // For custom mesh.
-    Vertex(sm::Vector3 pos, sm::Vector2 texCoords) {
-        Position = pos;
-        TexCoords = texCoords;
-
-        Normal = sm::Vector3(0.0, 0.0, 0.0);
-        Tangent = sm::Vector3(0.0, 0.0, 0.0);
-        Bitangent = sm::Vector3(0.0, 0.0, 0.0);
-    }
-
-    // Default.
-    Vertex() {
-        Position = sm::Vector3(0.0,0.0,0.0);
-        TexCoords = sm::Vector2(0.0, 0.0);
-
-        Normal = sm::Vector3(0.0, 0.0, 0.0);
-        Tangent = sm::Vector3(0.0, 0.0, 0.0);
-        Bitangent = sm::Vector3(0.0, 0.0, 0.0);
-    }
-};
+#include "Vertex.h"
 
 /// <summary>
 /// Important information about a texture. Assimp will use this structure.
@@ -128,6 +75,23 @@ public:
     /// not.</param>
     void Draw(bool depthPass);
 
+    /// <summary>
+    /// Returns the axis-aligned bounding box of the vertices in model space.
+    /// </summary>
+    const dx::BoundingBox& GetBounds() const;
+
+    /// <summary>
+    /// Returns the vertex data on the CPU, e.g. for software rasterization.
+    /// </summary>
+    const std::vector<Vertex>& GetVertices() const;
+    const std::vector<unsigned int>& GetIndices() const;
+
+    /// <summary>
+    /// Returns false if parts of the mesh may be see-through (dissolve texture or
+    /// factor). Only opaque meshes can hide others.
+    /// </summary>
+    bool IsOpaque() const;
+
     /// <summary>
     /// Init instance buffer for instanced rendering of this mesh.
     /// </summary>
@@ -149,10 +113,19 @@ private:
     /// <param name="pixelShaderName">Path to pixel shader.</param>
     void setupShaders(std::wstring vertexShaderName, std::wstring pixelShaderName);
 
+    /// <summary>
+    /// Returns the pixel shader slot of a texture type.
+    /// </summary>
+    /// <param name="type">Type of the texture (texture_diffuse, ...).</param>
+    /// <returns>Slot index. -1 for unknown types.</returns>
+    static int getTextureSlot(const std::string& type);
+
     // Mesh data.
     std::vector<Vertex>       m_vertices;
     std::vector<unsigned int> m_indices;
     std::vector<Texture>      m_textures;
+    std::vector<int>          m_textureSlots;   // Pixel shader slot per texture.
+    dx::BoundingBox           m_bounds;
 
     // Vertex and Index Buffer on GPU.
     wrl::ComPtr<ID3D11Buffer> m_vertexBuffer;
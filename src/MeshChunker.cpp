@@ -0,0 +1,105 @@
+#include "stdafx.h"
+#include "MeshChunker.h"
+
+
+/*
+ * MeshChunker::Split
+ */
+void MeshChunker::Split(const sm::Vector3* positions, size_t positionCnt,
+        size_t positionStride, const UINT32* indices, size_t indexCnt,
+        UINT32 maxTriangleCnt, std::vector<Chunk>& chunks) {
+    assert(maxTriangleCnt > 0);
+    chunks.clear();
+    auto position = [positions, positionStride](UINT32 vertex) -> const sm::Vector3& {
+        return *reinterpret_cast<const sm::Vector3*>(
+            reinterpret_cast<const UINT8*>(positions) + vertex * positionStride);
+    };
+
+    size_t triangleCnt = indexCnt / 3;
+    std::vector<UINT32> triangles(triangleCnt);
+    std::vector<sm::Vector3> centroids(triangleCnt);
+    for (UINT32 tri = 0; tri < triangleCnt; tri++) {
+        triangles[tri] = tri;
+        centroids[tri] = (position(indices[3 * tri]) + position(indices[3 * tri + 1]) +
+            position(indices[3 * tri + 2])) / 3.0f;
+    }
+
+    // Ranges of the triangle list. The left half is processed first, so chunks
+    // that are next to each other in space mostly are in the list as well.
+    std::vector<std::pair<size_t, size_t>> leaves;
+    std::vector<std::pair<size_t, size_t>> stack = { { 0, triangleCnt } };
+    while (!stack.empty()) {
+        std::pair<size_t, size_t> range = stack.back();
+        stack.pop_back();
+        size_t rangeCnt = range.second - range.first;
+        if (rangeCnt > maxTriangleCnt) {
+            sm::Vector3 centroidMin(FLT_MAX);
+            sm::Vector3 centroidMax(-FLT_MAX);
+            for (size_t i = range.first; i < range.second; i++) {
+                centroidMin = sm::Vector3::Min(centroidMin, centroids[triangles[i]]);
+                centroidMax = sm::Vector3::Max(centroidMax, centroids[triangles[i]]);
+            }
+            sm::Vector3 size = centroidMax - centroidMin;
+            int axis = (size.x >= size.y && size.x >= size.z) ? 0 :
+                (size.y >= size.z ? 1 : 2);
+
+            // All centroids in one point: no split separates anything.
+            if ((&size.x)[axis] > 0.0f) {
+                size_t middle = range.first + rangeCnt / 2;
+                std::nth_element(triangles.begin() + range.first,
+                    triangles.begin() + middle, triangles.begin() + range.second,
+                    [&centroids, axis](UINT32 a, UINT32 b) {
+                        return (&centroids[a].x)[axis] < (&centroids[b].x)[axis];
+                    });
+                stack.push_back({ middle, range.second });
+                stack.push_back({ range.first, middle });
+                continue;
+            }
+        }
+        leaves.push_back(range);
+    }
+
+    // Chunk vertex per source vertex, only valid for the chunk being built.
+    std::vector<UINT32> chunkVertices(positionCnt, UINT32_MAX);
+    chunks.resize(leaves.size());
+    for (size_t leaf = 0; leaf < leaves.size(); leaf++) {
+        Chunk& chunk = chunks[leaf];
+        auto first = triangles.begin() + leaves[leaf].first;
+        auto last = triangles.begin() + leaves[leaf].second;
+        std::sort(first, last);
+
+        chunk.indices.reserve(3 * (last - first));
+        sm::Vector3 boundsMin(FLT_MAX);
+        sm::Vector3 boundsMax(-FLT_MAX);
+        for (auto tri = first; tri != last; ++tri) {
+            for (UINT32 corner = 0; corner < 3; corner++) {
+                UINT32 vertex = indices[3 * *tri + corner];
+                if (chunkVertices[vertex] == UINT32_MAX) {
+                    chunkVertices[vertex] = static_cast<UINT32>(chunk.vertices.size());
+                    chunk.vertices.push_back(vertex);
+                    boundsMin = sm::Vector3::Min(boundsMin, position(vertex));
+                    boundsMax = sm::Vector3::Max(boundsMax, position(vertex));
+                }
+                chunk.indices.push_back(chunkVertices[vertex]);
+            }
+        }
+        for (UINT32 vertex : chunk.vertices) {
+            chunkVertices[vertex] = UINT32_MAX;
+        }
+        if (chunk.vertices.empty()) {
+            boundsMin = boundsMax = sm::Vector3::Zero;
+        }
+        dx::BoundingBox::CreateFromPoints(chunk.bounds, boundsMin, boundsMax);
+    }
+}
+
+
+/*
+ * MeshChunker::GetSurfaceArea
+ */
+double MeshChunker::GetSurfaceArea(const dx::BoundingBox& box) {
+    double x = 2.0 * box.Extents.x;
+    double y = 2.0 * box.Extents.y;
+    double z = 2.0 * box.Extents.z;
+    return 2.0 * (x * y + y * z + z * x);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+/// <summary>
+/// Splits the triangles of a mesh into spatially compact chunks, so that meshes
+/// which span a whole scene (e.g. all arches with the same material) can be culled
+/// piece by piece.
+/// </summary>
+/// <remarks>
+/// A k-d split: the triangles are divided at the median of their centroids along
+/// the longest axis of the centroid bounds until a chunk has at most the target
+/// number of triangles, so chunks end up with half to all of the target. Triangles
+/// are never cut, a chunk is a subset of the original triangles in their original
+/// order and winding. Vertices shared by triangles of different chunks are
+/// duplicated. Rendering all chunks gives exactly the original triangles.
+/// Positions are read with a stride, so any vertex type works.
+/// </remarks>
+class MeshChunker {
+public:
+    /// <summary>
+    /// Triangles of a chunk.
+    /// </summary>
+    struct Chunk {
+        std::vector<UINT32> vertices;   // Source vertex of every chunk vertex.
+        std::vector<UINT32> indices;    // Triangle list into vertices.
+        dx::BoundingBox bounds;         // Of the chunk vertices.
+    };
+
+    /// <summary>
+    /// Splits a triangle list into chunks.
+    /// </summary>
+    /// <param name="positions">First position.</param>
+    /// <param name="positionCnt">Number of positions.</param>
+    /// <param name="positionStride">Bytes between two positions.</param>
+    /// <param name="indices">Triangle list.</param>
+    /// <param name="indexCnt">Number of indices.</param>
+    /// <param name="maxTriangleCnt">Target triangles per chunk. Must not be 0.</param>
+    /// <param name="chunks">Output. Cleared first. A single chunk if the mesh is not
+    /// larger than the target.</param>
+    static void Split(const sm::Vector3* positions, size_t positionCnt,
+        size_t positionStride, const UINT32* indices, size_t indexCnt,
+        UINT32 maxTriangleCnt, std::vector<Chunk>& chunks);
+
+    /// <summary>
+    /// Returns the surface area of a box, as a measure of how likely a view sees it.
+    /// Unlike the volume, it is not zero for flat boxes.
+    /// </summary>
+    static double GetSurfaceArea(const dx::BoundingBox& box);
+};
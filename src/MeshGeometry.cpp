@@ -0,0 +1,184 @@
+#include "stdafx.h"
+#include "MeshGeometry.h"
+
+
+/*
+ * MeshGeometry::GenerateSphereGeometry
+ */
+void MeshGeometry::GenerateSphereGeometry(int resTheta, int resPhi,
+        std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    const double radiusSphere = 0.5;
+    constexpr float pi = 3.14159265358979323846f;  // TODO: Use lib.
+
+    vertices.clear();
+    indices.clear();
+    vertices.reserve((resTheta + 1) * (resPhi + 1));
+    indices.reserve(resTheta * resPhi * 6);
+
+    // Vertex-coords and uv-coords.
+    float x, y, z;
+    float u, v;
+
+    // Renaming for easier understanding.
+    int verticalResolution = resTheta;
+    int horizontalResolution = resPhi;
+
+    // Step sizes and angles for vertices calculation.
+    float verticalStep = DirectX::XMConvertToRadians(
+        180.0f / float(verticalResolution));
+    float horizontalStep = DirectX::XMConvertToRadians(
+        360.0f / float(horizontalResolution));
+    float verticalAngle = 0.0f;
+    float horizontalAngle = 0.0f;
+
+    //Calculate vertices by looping over angles.
+    for (int i = 0; i <= horizontalResolution; i++) {
+        horizontalAngle = i * horizontalStep;
+        for (int j = 0; j <= verticalResolution; j++) {
+            verticalAngle = j * verticalStep;
+
+            // Calculate vertex position.
+            x = radiusSphere * sin(verticalAngle) * cos(horizontalAngle);
+            y = radiusSphere * sin(verticalAngle) * sin(horizontalAngle);
+            z = radiusSphere * cos(verticalAngle);
+
+            // Calculate texture coordinate.
+            u = horizontalAngle / (2 * pi);
+            v = verticalAngle / (pi);
+
+            // Add to vertices. Position also acts as the normal.
+            vertices.push_back(Vertex(sm::Vector3(x, y, z), sm::Vector3(x, y, z),
+                sm::Vector2(u, v)));
+        }
+    }
+
+    // Calculate indices. Similar to http://www.songho.ca/opengl/gl_sphere.html
+    // Visualization:     (k1)----(k1+verticalResolution + 1)
+    //                     |                   |
+    //                     |                   |
+    //                    (k2)----(k2+verticalResolution+1)
+    int k1, k2;
+    for (int i = 0; i < horizontalResolution; i++) {
+        for (int j = 0; j < verticalResolution; j++) {
+            k1 = i * (verticalResolution + 1) + j;
+            k2 = k1 + 1;
+
+            // Skip geographic north pole.
+            if (j != 0) {
+                // k1 => k2 => k1+1 vertex.
+                indices.push_back(k1);
+                indices.push_back(k2);
+                indices.push_back(k1 + verticalResolution + 1);
+            }
+
+            // Skip geographic south pole.
+            if (j != (verticalResolution - 1)) {
+                // k1+1 => k2 => k2+1 vertex.
+                indices.push_back(k1 + verticalResolution + 1);
+                indices.push_back(k2);
+                indices.push_back(k2 + verticalResolution + 1);
+            }
+        }
+    }
+}
+
+/*
+ * MeshGeometry::GenerateIcosahedronGeometry
+ */
+void MeshGeometry::GenerateIcosahedronGeometry(std::vector<Vertex>& vertices,
+        std::vector<unsigned int>& indices) {
+    // The corners (0, +-1, +-phi) and their cyclic permutations span an icosahedron
+    // with edge length 2, whose faces are phi^2 / sqrt(3) from the center. Scaled
+    // down to 0.5, a little more so the rounding cannot cut into the sphere.
+    const float phi = (1.0f + std::sqrt(5.0f)) * 0.5f;
+    const float scale = 0.5f * std::sqrt(3.0f) / (phi * phi) * 1.0001f;
+    const std::array<sm::Vector3, 12> corners = {
+        sm::Vector3(-1.0f, phi, 0.0f), sm::Vector3(1.0f, phi, 0.0f),
+        sm::Vector3(-1.0f, -phi, 0.0f), sm::Vector3(1.0f, -phi, 0.0f),
+        sm::Vector3(0.0f, -1.0f, phi), sm::Vector3(0.0f, 1.0f, phi),
+        sm::Vector3(0.0f, -1.0f, -phi), sm::Vector3(0.0f, 1.0f, -phi),
+        sm::Vector3(phi, 0.0f, -1.0f), sm::Vector3(phi, 0.0f, 1.0f),
+        sm::Vector3(-phi, 0.0f, -1.0f), sm::Vector3(-phi, 0.0f, 1.0f) };
+
+    vertices.clear();
+    for (const sm::Vector3& corner : corners) {
+        // Position also acts as the normal, as for the sphere.
+        sm::Vector3 position = corner * scale;
+        vertices.push_back(Vertex(position, position, sm::Vector2(0.0f, 0.0f)));
+    }
+
+    // Counter-clockwise seen from outside, in the order of the sphere.
+    indices = {
+        0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+        1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+        3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+        4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1 };
+}
+
+/*
+ * MeshGeometry::GenerateTorusGeometry
+ */
+void MeshGeometry::GenerateTorusGeometry(int resT, int resP,
+        std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    // resT: Toroidal (big circle), resP: Poloidal (small circle).
+    const float radiusOut = 0.34f;
+    const float radiusIn = 0.16f;
+
+    // Step sizes.
+    const float outCircleStep = DirectX::XMConvertToRadians(360.0f / float(resT));
+    const float inCircleStep = DirectX::XMConvertToRadians(360.0f / float(resP));
+
+    vertices.clear();
+    indices.clear();
+    vertices.reserve((resT + 1) * (resP + 1));
+    indices.reserve(resT * (resP + 1) * 2);
+
+    // Normal and angles for vertices calculation.
+    float nx, ny, nz, normalLength;
+    float currOutAngle = 0.0f;
+    float currInAngle = 0.0f;
+
+    // Calculate vertices of torus.
+    for (int i = 0; i <= resT; i++) {
+        currInAngle = 0.0f;
+        for (int j = 0; j <= resP; j++) {
+            // Add vertex to vertex list.
+            float x = (radiusOut + radiusIn * cos(currInAngle)) * cos(currOutAngle);
+            float y = (radiusOut + radiusIn * cos(currInAngle)) * sin(currOutAngle);
+            float z = radiusIn * sin(currInAngle);
+
+            // Add normals to normal list.
+            nx = cos(currInAngle) * cos(currOutAngle);
+            ny = sin(currOutAngle) * cos(currInAngle);
+            nz = sin(currInAngle);
+            normalLength = sqrt(pow(nx, 2) + pow(ny, 2) + pow(nz, 2));
+            float normalX = nx / normalLength;
+            float normalY = ny / normalLength;
+            float normalZ = nz / normalLength;
+
+            // Add step size to inner angle.
+            currInAngle += inCircleStep;
+
+            // Add to vertices. Position also acts as the normal.
+            vertices.push_back(Vertex(sm::Vector3(x, y, z),
+                sm::Vector3(normalX, normalY, normalZ),
+                sm::Vector2(0, 0)));
+        }
+
+        // Add step size to outer angle.
+        currOutAngle += outCircleStep;
+    }
+
+    // Calculate indices of torus.
+    unsigned int currentVertexOffset = 0;
+    for (auto i = 0; i < resT; i++) {
+        for (auto j = 0; j <= resP; j++) {
+            unsigned int vertexA = currentVertexOffset;
+            indices.push_back(vertexA);
+
+            unsigned int vertexB = currentVertexOffset + resP + 1;
+            indices.push_back(vertexB);
+            currentVertexOffset++;
+        }
+    }
+}
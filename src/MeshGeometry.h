@@ -0,0 +1,38 @@
+#pragma once
+#include "Vertex.h"
+
+/// <summary>
+/// Procedural meshes of the models: sphere, icosahedron and torus.
+/// </summary>
+class MeshGeometry {
+public:
+    /// <summary>
+    /// Generates vertices and indices of a sphere with radius 0.5.
+    /// </summary>
+    /// <param name="resTheta">Vertical resolution.</param>
+    /// <param name="resPhi">Horizontal resolution.</param>
+    /// <param name="vertices">Output vertices.</param>
+    /// <param name="indices">Output indices.</param>
+    static void GenerateSphereGeometry(int resTheta, int resPhi,
+        std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+    /// <summary>
+    /// Generates vertices and indices of an icosahedron around the sphere of
+    /// GenerateSphereGeometry(): its faces touch the sphere, so it covers all of
+    /// it, e.g. as a light volume with 12 vertices instead of thousands.
+    /// </summary>
+    /// <param name="vertices">Output vertices.</param>
+    /// <param name="indices">Output indices, same winding as the sphere.</param>
+    static void GenerateIcosahedronGeometry(std::vector<Vertex>& vertices,
+        std::vector<unsigned int>& indices);
+
+    /// <summary>
+    /// Generates vertices and indices of a torus (donut).
+    /// </summary>
+    /// <param name="resT">Toroidal resolution (big circle).</param>
+    /// <param name="resP">Poloidal resolution (small circle).</param>
+    /// <param name="vertices">Output vertices.</param>
+    /// <param name="indices">Output indices.</param>
+    static void GenerateTorusGeometry(int resT, int resP,
+        std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+};
@@ -16,7 +16,8 @@ ModelClass::ModelClass(
         sm::Vector4 initRotation,
         unsigned int fileFormat,
         std::wstring vertexShaderName,
-        std::wstring pixelShaderName) {
+        std::wstring pixelShaderName,
+        unsigned int chunkTriangleCnt) {
     // Store information.
     m_d3dDevice = d3dDevice;
     m_d3dContext = d3dContext;
@@ -25,9 +26,11 @@ ModelClass::ModelClass(
     m_name = name;
     m_modelExtraFlags = modelExtraFlags;
     m_fileFormat = fileFormat;
+    m_chunkTriangleCnt = chunkTriangleCnt;
     m_vertexShaderName = vertexShaderName;
     m_pixelShaderName = pixelShaderName;
     m_baseType = ModelClass::BaseType::LOADED;
+    ResourceRegistry::ScopedOwner resourceOwner(m_name);
 
     // Setup model path.
     switch (fileFormat) {
@@ -42,14 +45,9 @@ ModelClass::ModelClass(
     }
 
     // Information about the model.
-    m_state = ModelState(initScale, initPosition, sm::Quaternion(initRotation));
-    m_modelMat = sm::Matrix::CreateTranslation(m_state.position)
-        * sm::Matrix::CreateFromQuaternion(m_state.orientation)
-        * sm::Matrix::CreateScale(m_state.scale);
-
-    // Transpose at the end is missing on purpose, since the matrix will get
-    // transposed afterwards one more time (for GPU upload).
-    m_normalMat = ((*m_viewMat) * m_modelMat).Invert().Transpose();
+    m_transform = TransformSystem::Default().Create(
+        ModelState(initScale, initPosition, sm::Quaternion(initRotation)));
+    m_uploadedVersion = 0;
 
     // Load data and create necessary vertex/index buffers, textures, ...
     loadModel();
@@ -79,16 +77,13 @@ ModelClass::ModelClass(ModelClass::BaseType modelType,
     m_vertexShaderName = vertexShaderName;
     m_pixelShaderName = pixelShaderName;
     m_baseType = modelType;
+    ResourceRegistry::ScopedOwner resourceOwner(
+        Helper::ConvertWideToUtf8(m_vertexShaderName));
 
     // Information about the model.
-    m_state = ModelState(initScale, initPosition, sm::Quaternion(initRotation));
-    m_modelMat = sm::Matrix::CreateTranslation(m_state.position)
-        * sm::Matrix::CreateFromQuaternion(m_state.orientation)
-        * sm::Matrix::CreateScale(m_state.scale);
-
-    // Transpose at the end is missing on purpose, since the matrix will get
-    // transposed afterwards one more time (for GPU upload).
-    m_normalMat = ((*m_viewMat) * m_modelMat).Invert().Transpose();
+    m_transform = TransformSystem::Default().Create(
+        ModelState(initScale, initPosition, sm::Quaternion(initRotation)));
+    m_uploadedVersion = 0;
 
     // Load data and create necessary vertex/index buffers, textures, ...
     if (m_baseType == ModelClass::BaseType::CUBE) {
@@ -97,6 +92,8 @@ ModelClass::ModelClass(ModelClass::BaseType modelType,
         createSphereMesh(color, false);
     } else if (m_baseType == ModelClass::BaseType::TORUS) {
         createTorusMesh(color, false);
+    } else if (m_baseType == ModelClass::BaseType::ICOSAHEDRON) {
+        createIcosahedronMesh(color, false);
     } else {
        throw std::invalid_argument("Type not implemented.");
     }
@@ -127,21 +124,17 @@ ModelClass::ModelClass(
     m_vertexShaderName = vertexShaderName;
     m_pixelShaderName = pixelShaderName;
     m_baseType = modelType;
+    ResourceRegistry::ScopedOwner resourceOwner(
+        Helper::ConvertWideToUtf8(m_vertexShaderName));
 
     // Information about the model. TODO: Fix model state creation.
-    m_state = ModelState(1.0, sm::Vector3(0.0,0.0,0.0),
-        sm::Quaternion(sm::Vector4(0.0,0.0,0.0,1.0)));
-
-    // TODO: Fix. Not used for this case.
-    m_modelMat = sm::Matrix::CreateTranslation(m_state.position)
-        * sm::Matrix::CreateFromQuaternion(m_state.orientation)
-        * sm::Matrix::CreateScale(m_state.scale);
-
-    // TODO: Fix. Not used for this case.
-    m_normalMat = ((*m_viewMat) * m_modelMat).Invert().Transpose();
+    m_transform = TransformSystem::Default().Create(ModelState(1.0,
+        sm::Vector3(0.0,0.0,0.0), sm::Quaternion(sm::Vector4(0.0,0.0,0.0,1.0))));
+    m_uploadedVersion = 0;
 
     // Create instance buffer.
     m_instanceCount = positions.size();
+    m_visibleInstanceCnt = m_instanceCount;
     m_instanceStride = sizeof(InstanceType);
 
     // Color is ignored here. Since we use the color from the instance buffer.
@@ -151,30 +144,32 @@ ModelClass::ModelClass(
         createSphereMesh(sm::Vector3(0.0, 0.0, 0.0), m_instanceCount);
     } else if (m_baseType == ModelClass::BaseType::TORUS) {
         createTorusMesh(sm::Vector3(0.0, 0.0, 0.0), m_instanceCount);
+    } else if (m_baseType == ModelClass::BaseType::ICOSAHEDRON) {
+        createIcosahedronMesh(sm::Vector3(0.0, 0.0, 0.0), m_instanceCount);
     } else {
         throw std::invalid_argument("Type not implemented.");
     }
 
-    std::vector<InstanceType> iBufferData;
+    // Kept on the CPU for drawing subsets (see SetVisibleInstances()).
     for (unsigned int i = 0; i < m_instanceCount; i++) {
         InstanceType element;
         element.iPos = positions[i];
         element.iScale = scales[i];
         element.iColor = colors[i];
-        iBufferData.push_back(element);
+        m_instanceData.push_back(element);
     }
 
     // Fill in a buffer description.
     D3D11_BUFFER_DESC vertexBufferDesc;
-    vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
     vertexBufferDesc.ByteWidth = sizeof(InstanceType) * m_instanceCount;
     vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    vertexBufferDesc.CPUAccessFlags = 0;
+    vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
     vertexBufferDesc.MiscFlags = 0;
 
     // Fill in the subresource data.
     D3D11_SUBRESOURCE_DATA vertexInitData;
-    vertexInitData.pSysMem = iBufferData.data();
+    vertexInitData.pSysMem = m_instanceData.data();
     vertexInitData.SysMemPitch = 0;
     vertexInitData.SysMemSlicePitch = 0;
 
@@ -182,6 +177,8 @@ ModelClass::ModelClass(
     HRESULT hr = m_d3dDevice->CreateBuffer(&vertexBufferDesc, &vertexInitData,
         m_instanceBuffer.GetAddressOf());
     assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_instanceBuffer.Get(),
+        ResourceRegistry::Category::INSTANCE_BUFFER, "m_instanceBuffer");
 
     // Pass information to the only Mesh object of this ModelClass instance.
     m_meshes[0].SetupInstancing(m_instanceBuffer, m_instanceCount, m_instanceStride);
@@ -214,16 +211,13 @@ ModelClass::ModelClass(
     m_vertexShaderName = vertexShaderName;
     m_pixelShaderName = pixelShaderName;
     m_baseType = ModelClass::BaseType::CUSTOM;
+    ResourceRegistry::ScopedOwner resourceOwner(
+        Helper::ConvertWideToUtf8(m_vertexShaderName));
 
     // Information about the model.
-    m_state = ModelState(initScale, initPosition, sm::Quaternion(initRotation));
-    m_modelMat = sm::Matrix::CreateTranslation(m_state.position)
-        * sm::Matrix::CreateFromQuaternion(m_state.orientation)
-        * sm::Matrix::CreateScale(m_state.scale);
-
-    // Transpose at the end is missing on purpose, since the matrix will get
-    // transposed afterwards one more time (for GPU upload).
-    m_normalMat = ((*m_viewMat) * m_modelMat).Invert().Transpose();
+    m_transform = TransformSystem::Default().Create(
+        ModelState(initScale, initPosition, sm::Quaternion(initRotation)));
+    m_uploadedVersion = 0;
 
     // Create Mesh object.
     loadModel(vertices, indices, vertexLayout, matDefinition);
@@ -240,32 +234,567 @@ void ModelClass::Draw(bool depthPass) {
     // Update state information for the current frame.
     update();
 
+    m_sceneGraph.Update();
+
     // ALWAYS Bind per-model constant buffer to slot 0. Contains model matrix etc.
-    m_d3dContext->VSSetConstantBuffers(0, 1, m_constBuffer.GetAddressOf());
+    // Meshes of nodes with their own transform use the buffer of the node.
+    ID3D11Buffer* boundBuffer = nullptr;
 
     // Loop over all meshes that define the model and draw them.
-    for (unsigned int i = 0; i < m_meshes.size(); i++) {
-        m_meshes[i].Draw(depthPass);
+    for (UINT32 i = 0; i < m_meshes.size(); i++) {
+        drawMesh(i, depthPass, boundBuffer);
+    }
+}
+
+
+/*
+ * ModelClass::Draw
+ */
+void ModelClass::Draw(bool depthPass, const std::vector<UINT32>& meshes) {
+    update();
+
+    m_sceneGraph.Update();
+
+    ID3D11Buffer* boundBuffer = nullptr;
+    for (UINT32 mesh : meshes) {
+        drawMesh(mesh, depthPass, boundBuffer);
+    }
+}
+
+
+/*
+ * ModelClass::Cull
+ */
+void ModelClass::Cull(const FrustumCuller::Planes& planes,
+        std::vector<UINT32>& visibleMeshes,
+        const FrustumCuller::Contribution& contribution) {
+    updateCullingBounds();
+    if (m_useBvh) {
+        // Mesh order keeps materials and node buffers together when drawing.
+        m_bvh.Cull(planes, visibleMeshes);
+        if (contribution.minRadius > 0.0f) {
+            auto visibleEnd = std::remove_if(visibleMeshes.begin(), visibleMeshes.end(),
+                [this, &contribution](UINT32 mesh) {
+                    return !FrustumCuller::TestContribution(contribution,
+                        m_cullBounds[mesh]);
+                });
+            visibleMeshes.erase(visibleEnd, visibleMeshes.end());
+        }
+        std::sort(visibleMeshes.begin(), visibleMeshes.end());
+    } else {
+        m_culler.Cull(planes, contribution, visibleMeshes);
+    }
+}
+
+
+/*
+ * ModelClass::Cull
+ */
+void ModelClass::Cull(const FrustumCuller::Planes& planes,
+        const std::vector<UINT32>& candidates, std::vector<UINT32>& visibleMeshes,
+        const FrustumCuller::Contribution& contribution) {
+    updateCullingBounds();
+    visibleMeshes.clear();
+    for (UINT32 mesh : candidates) {
+        if (FrustumCuller::TestBox(planes, m_cullBounds[mesh]) &&
+                FrustumCuller::TestContribution(contribution, m_cullBounds[mesh])) {
+            visibleMeshes.push_back(mesh);
+        }
+    }
+}
+
+
+/*
+ * ModelClass::SetUseBvh
+ */
+void ModelClass::SetUseBvh(bool useBvh) {
+    m_useBvh = useBvh;
+}
+
+
+/*
+ * ModelClass::GetUseBvh
+ */
+bool ModelClass::GetUseBvh() const {
+    return m_useBvh;
+}
+
+
+/*
+ * ModelClass::AddOccluders
+ */
+void ModelClass::AddOccluders(OcclusionCuller& culler) {
+    if (!m_occludersSelected) {
+        selectOccluders();
+    }
+
+    m_sceneGraph.Update();
+    const sm::Matrix& modelMat = TransformSystem::Default().GetModelMatrix(m_transform);
+    for (UINT32 mesh : m_occluderMeshes) {
+        sm::Matrix worldMat = m_meshNodes.empty() ? modelMat :
+            m_sceneGraph.GetWorldMatrix(m_meshNodes[mesh]) * modelMat;
+        const std::vector<Vertex>& vertices = m_meshes[mesh].GetVertices();
+        const std::vector<unsigned int>& indices = m_meshes[mesh].GetIndices();
+        culler.AddOccluder(&vertices[0].Position, vertices.size(), sizeof(Vertex),
+            indices.data(), indices.size(), worldMat);
+    }
+}
+
+
+/*
+ * ModelClass::CullOccluded
+ */
+void ModelClass::CullOccluded(const OcclusionCuller& culler,
+        std::vector<UINT32>& meshes) {
+    updateCullingBounds();
+    auto visibleEnd = std::remove_if(meshes.begin(), meshes.end(),
+        [this, &culler](UINT32 mesh) {
+            return !culler.TestBox(m_cullBounds[mesh]);
+        });
+    meshes.erase(visibleEnd, meshes.end());
+}
+
+
+/*
+ * ModelClass::CullOccluded
+ */
+void ModelClass::CullOccluded(const HiZCuller& culler, std::vector<UINT32>& meshes) {
+    updateCullingBounds();
+    auto visibleEnd = std::remove_if(meshes.begin(), meshes.end(),
+        [this, &culler](UINT32 mesh) {
+            return !culler.TestBox(m_cullBounds[mesh]);
+        });
+    meshes.erase(visibleEnd, meshes.end());
+}
+
+
+/*
+ * ModelClass::AddPvsMeshes
+ */
+void ModelClass::AddPvsMeshes(Pvs& pvs) {
+    // Model space, so the sets stay valid if the model is moved as a whole.
+    m_sceneGraph.Update();
+    for (UINT32 mesh = 0; mesh < m_meshes.size(); mesh++) {
+        sm::Matrix nodeMat = m_meshNodes.empty() ? sm::Matrix::Identity :
+            m_sceneGraph.GetWorldMatrix(m_meshNodes[mesh]);
+        const std::vector<Vertex>& vertices = m_meshes[mesh].GetVertices();
+        const std::vector<unsigned int>& indices = m_meshes[mesh].GetIndices();
+        pvs.AddMesh(vertices.empty() ? nullptr : &vertices[0].Position,
+            vertices.size(), sizeof(Vertex), indices.data(), indices.size(), nodeMat,
+            m_meshes[mesh].IsOpaque());
+    }
+}
+
+
+/*
+ * ModelClass::FindPvsCell
+ */
+UINT32 ModelClass::FindPvsCell(const Pvs& pvs, const sm::Vector3& position) const {
+    const sm::Matrix& modelMat = TransformSystem::Default().GetModelMatrix(m_transform);
+    return pvs.FindCell(sm::Vector3::Transform(position, modelMat.Invert()));
+}
+
+
+/*
+ * ModelClass::GetMeshCount
+ */
+UINT32 ModelClass::GetMeshCount() const {
+    return static_cast<UINT32>(m_meshes.size());
+}
+
+
+/*
+ * ModelClass::GetInstanceCount
+ */
+UINT32 ModelClass::GetInstanceCount() const {
+    return static_cast<UINT32>(m_instanceData.size());
+}
+
+
+/*
+ * ModelClass::GetInstanceBounds
+ */
+dx::BoundingBox ModelClass::GetInstanceBounds(UINT32 instance) const {
+    // The instanced shaders scale and translate the mesh, nothing else.
+    const InstanceType& data = m_instanceData[instance];
+    const dx::BoundingBox& meshBounds = m_meshes[0].GetBounds();
+    sm::Vector3 scale(std::abs(data.iScale.x), std::abs(data.iScale.y),
+        std::abs(data.iScale.z));
+    return dx::BoundingBox(sm::Vector3(meshBounds.Center) * data.iScale + data.iPos,
+        sm::Vector3(meshBounds.Extents) * scale);
+}
+
+
+/*
+ * ModelClass::SetVisibleInstances
+ */
+void ModelClass::SetVisibleInstances(const std::vector<UINT32>& instances) {
+    assert(!m_instanceData.empty() && instances.size() <= m_instanceData.size());
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    HRESULT hr = m_d3dContext->Map(m_instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD,
+        0, &mappedResource);
+    assert(SUCCEEDED(hr));
+    InstanceType* dataPtr = static_cast<InstanceType*>(mappedResource.pData);
+    for (size_t i = 0; i < instances.size(); i++) {
+        dataPtr[i] = m_instanceData[instances[i]];
+    }
+    m_d3dContext->Unmap(m_instanceBuffer.Get(), 0);
+    RenderStats::Add(RenderStats::Counter::BYTES_UPLOADED,
+        sizeof(InstanceType) * instances.size());
+
+    m_visibleInstanceCnt = static_cast<unsigned int>(instances.size());
+    m_meshes[0].SetupInstancing(m_instanceBuffer, m_visibleInstanceCnt,
+        m_instanceStride);
+}
+
+
+/*
+ * ModelClass::MapVisibleInstances
+ */
+void* ModelClass::MapVisibleInstances(UINT32 count) {
+    assert(!m_instanceData.empty() && count <= m_instanceCount);
+    static_assert(offsetof(InstanceType, iScale) == 3 * sizeof(float) &&
+        offsetof(InstanceType, iColor) == 6 * sizeof(float),
+        "Unexpected instance layout");
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    HRESULT hr = m_d3dContext->Map(m_instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD,
+        0, &mappedResource);
+    assert(SUCCEEDED(hr));
+    m_visibleInstanceCnt = count;
+    return mappedResource.pData;
+}
+
+
+/*
+ * ModelClass::UnmapVisibleInstances
+ */
+void ModelClass::UnmapVisibleInstances() {
+    m_d3dContext->Unmap(m_instanceBuffer.Get(), 0);
+    RenderStats::Add(RenderStats::Counter::BYTES_UPLOADED,
+        sizeof(InstanceType) * m_visibleInstanceCnt);
+    m_meshes[0].SetupInstancing(m_instanceBuffer, m_visibleInstanceCnt,
+        m_instanceStride);
+}
+
+
+/*
+ * ModelClass::GetInstanceStride
+ */
+UINT32 ModelClass::GetInstanceStride() const {
+    return m_instanceStride;
+}
+
+
+/*
+ * ModelClass::ShareInstances
+ */
+void ModelClass::ShareInstances(const ModelClass& source) {
+    assert(!m_instanceData.empty() && m_instanceStride == source.m_instanceStride);
+    m_meshes[0].SetupInstancing(source.m_instanceBuffer, source.m_visibleInstanceCnt,
+        m_instanceStride);
+}
+
+
+/*
+ * ModelClass::SetInstances
+ */
+void ModelClass::SetInstances(const std::vector<sm::Vector3>& positions,
+        const std::vector<sm::Vector3>& colors, const std::vector<sm::Vector3>& scales) {
+    assert(!m_instanceData.empty());
+    assert(positions.size() == colors.size() && positions.size() == scales.size());
+    m_instanceData.resize(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        m_instanceData[i].iPos = positions[i];
+        m_instanceData[i].iScale = scales[i];
+        m_instanceData[i].iColor = colors[i];
+    }
+
+    // The buffer only grows, SetVisibleInstances() draws the first instances of it.
+    if (m_instanceData.size() > m_instanceCount) {
+        m_instanceCount = static_cast<unsigned int>(m_instanceData.size());
+        D3D11_BUFFER_DESC vertexBufferDesc = {};
+        vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        vertexBufferDesc.ByteWidth = sizeof(InstanceType) * m_instanceCount;
+        vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        HRESULT hr = m_d3dDevice->CreateBuffer(&vertexBufferDesc, nullptr,
+            m_instanceBuffer.ReleaseAndGetAddressOf());
+        assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(m_instanceBuffer.Get(),
+            ResourceRegistry::Category::INSTANCE_BUFFER, "m_instanceBuffer");
+    }
+}
+
+
+/*
+ * ModelClass::GetWorldBounds
+ */
+dx::BoundingBox ModelClass::GetWorldBounds() {
+    updateCullingBounds();
+    return m_bvh.GetBounds();
+}
+
+
+/*
+ * ModelClass::GetCuller
+ */
+FrustumCuller& ModelClass::GetCuller() {
+    updateCullingBounds();
+    return m_culler;
+}
+
+
+/*
+ * ModelClass::drawMesh
+ */
+void ModelClass::drawMesh(UINT32 mesh, bool depthPass, ID3D11Buffer*& boundBuffer) {
+    ID3D11Buffer* buffer = m_meshNodes.empty() ? m_constBuffer.Get() :
+        getNodeConstBuffer(m_meshNodes[mesh]);
+    if (buffer != boundBuffer) {
+        m_d3dContext->VSSetConstantBuffers(0, 1, &buffer);
+        RenderStats::Add(RenderStats::Counter::BUFFER_BINDS);
+        boundBuffer = buffer;
+    }
+    m_meshes[mesh].Draw(depthPass);
+}
+
+
+/*
+ * ModelClass::updateCullingBounds
+ */
+void ModelClass::updateCullingBounds() {
+    m_sceneGraph.Update();
+
+    // One box per mesh. Meshes are only added while loading.
+    bool rebuild = m_culler.GetCount() != m_meshes.size();
+    if (rebuild) {
+        m_culler.Clear();
+        for (const Mesh& mesh : m_meshes) {
+            m_culler.AddBox(mesh.GetBounds());
+        }
+        m_cullBounds.resize(m_meshes.size());
+        m_cullNodeVersions.assign(m_meshes.size(), 0);
+    }
+
+    // The camera changes the version of the transform, not the model matrix. So
+    // compare the matrix itself.
+    const sm::Matrix& modelMat = TransformSystem::Default().GetModelMatrix(m_transform);
+    bool modelMoved = rebuild || modelMat != m_cullModelMat;
+    m_cullModelMat = modelMat;
+
+    bool boundsChanged = false;
+    for (UINT32 i = 0; i < m_meshes.size(); i++) {
+        UINT32 nodeVersion = m_meshNodes.empty() ? 0 :
+            m_sceneGraph.GetVersion(m_meshNodes[i]);
+        if (!modelMoved && nodeVersion == m_cullNodeVersions[i]) {
+            continue;
+        }
+        m_cullNodeVersions[i] = nodeVersion;
+
+        sm::Matrix worldMat = m_meshNodes.empty() ? modelMat :
+            m_sceneGraph.GetWorldMatrix(m_meshNodes[i]) * modelMat;
+        m_meshes[i].GetBounds().Transform(m_cullBounds[i], worldMat);
+        m_culler.SetBox(i, m_cullBounds[i]);
+        if (!rebuild) {
+            m_bvh.SetPrimitiveBounds(i, m_cullBounds[i]);
+        }
+        boundsChanged = true;
+    }
+
+    // Moving meshes keep the topology of the hierarchy.
+    if (rebuild) {
+        m_bvh.Build(m_cullBounds);
+    } else if (boundsChanged) {
+        m_bvh.Refit();
     }
 }
 
 
+/*
+ * ModelClass::selectOccluders
+ */
+void ModelClass::selectOccluders() {
+    m_occludersSelected = true;
+    m_occluderMeshes.clear();
+
+    // Largest meshes first, measured by the surface of their bounds relative to
+    // their triangles. Walls and pillars rank high, detailed props low.
+    std::vector<std::pair<float, UINT32>> candidates;
+    for (UINT32 i = 0; i < m_meshes.size(); i++) {
+        const Mesh& mesh = m_meshes[i];
+        UINT32 triangleCnt = static_cast<UINT32>(mesh.GetIndices().size() / 3);
+        if (triangleCnt == 0 || triangleCnt > MAX_OCCLUDER_TRIANGLES ||
+                !mesh.IsOpaque()) {
+            continue;
+        }
+        const sm::Vector3 e = mesh.GetBounds().Extents;
+        float area = e.x * e.y + e.y * e.z + e.z * e.x;
+        candidates.push_back({ area / triangleCnt, i });
+    }
+    std::sort(candidates.begin(), candidates.end(),
+        [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    UINT32 triangleCnt = 0;
+    for (const auto& candidate : candidates) {
+        UINT32 meshTriangleCnt =
+            static_cast<UINT32>(m_meshes[candidate.second].GetIndices().size() / 3);
+        if (triangleCnt + meshTriangleCnt > OCCLUDER_TRIANGLE_BUDGET) {
+            continue;
+        }
+        triangleCnt += meshTriangleCnt;
+        m_occluderMeshes.push_back(candidate.second);
+    }
+}
+
+
+/*
+ * ModelClass::getNodeConstBuffer
+ */
+ID3D11Buffer* ModelClass::getNodeConstBuffer(UINT32 node) {
+    if (m_sceneGraph.IsWorldIdentity(node)) {
+        return m_constBuffer.Get();
+    }
+
+    // Create on first use.
+    NodeConstBuffer& nodeBuffer = m_nodeConstBuffers[node];
+    if (!nodeBuffer.buffer) {
+        D3D11_BUFFER_DESC cbDesc = {};
+        cbDesc.ByteWidth = sizeof(VS_PER_MODEL_CONSTANT_BUFFER);
+        cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+        cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        HRESULT hr = m_d3dDevice->CreateBuffer(&cbDesc, nullptr,
+            nodeBuffer.buffer.GetAddressOf());
+        assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(nodeBuffer.buffer.Get(),
+            ResourceRegistry::Category::CONSTANT_BUFFER, "m_nodeConstBuffers");
+    }
+
+    // Upload if the model or the node moved (or the camera, which changes the
+    // version of the transform).
+    TransformSystem& transforms = TransformSystem::Default();
+    UINT32 transformVersion = transforms.GetVersion(m_transform);
+    UINT32 nodeVersion = m_sceneGraph.GetVersion(node);
+    if (nodeBuffer.transformVersion != transformVersion ||
+            nodeBuffer.nodeVersion != nodeVersion) {
+        nodeBuffer.transformVersion = transformVersion;
+        nodeBuffer.nodeVersion = nodeVersion;
+
+        sm::Matrix modelMat = m_sceneGraph.GetWorldMatrix(node) *
+            transforms.GetModelMatrix(m_transform);
+        D3D11_MAPPED_SUBRESOURCE mappedResource;
+        m_d3dContext->Map(nodeBuffer.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0,
+            &mappedResource);
+        VS_PER_MODEL_CONSTANT_BUFFER* dataPtr =
+            (VS_PER_MODEL_CONSTANT_BUFFER*)mappedResource.pData;
+        dataPtr->modelMat = modelMat.Transpose();
+        dataPtr->normalMat = TransformSystem::ComputeNormalMatrix(modelMat,
+            *m_viewMat).Transpose();
+        m_d3dContext->Unmap(nodeBuffer.buffer.Get(), 0);
+        RenderStats::AddUpload(sizeof(VS_PER_MODEL_CONSTANT_BUFFER));
+    }
+    return nodeBuffer.buffer.Get();
+}
+
+
+/*
+ * ModelClass::~ModelClass
+ */
+ModelClass::~ModelClass() {
+    TransformSystem::Default().Destroy(m_transform);
+}
+
+
 /*
  * ModelClass::GetState
  */
-ModelState* ModelClass::GetState() {
-    return &m_state;
+ModelState ModelClass::GetState() const {
+    return TransformSystem::Default().GetState(m_transform);
+}
+
+
+/*
+ * ModelClass::GetSceneGraph
+ */
+SceneGraph& ModelClass::GetSceneGraph() {
+    return m_sceneGraph;
+}
+
+
+/*
+ * ModelClass::SetState
+ */
+void ModelClass::SetState(const ModelState& state) {
+    TransformSystem::Default().SetState(m_transform, state);
 }
 
 
 /*
  * ModelClass::processMesh
  */
-Mesh ModelClass::processMesh(aiMesh* mesh, const aiScene* scene) {
+std::vector<Mesh> ModelClass::processMesh(aiMesh* mesh, const aiScene* scene) {
     // Geometry of mesh.
-    unsigned int vertexCnt = mesh->mNumVertices;
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
+    ConvertMeshData(mesh, vertices, indices);
+
+    // Materials (textures) were loaded up front in loadMaterials().
+    // A mesh only uses a single material (defined by constants and textures)!
+    std::vector<Texture> textures;
+    Material matDefinition;
+    if (mesh->mMaterialIndex < m_materialTextures.size()) {
+        textures = m_materialTextures[mesh->mMaterialIndex];
+        matDefinition = m_materials[mesh->mMaterialIndex];
+    }
+
+    // Define vertex layout.
+    std::vector<D3D11_INPUT_ELEMENT_DESC> vertexLayout = {
+        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Second entry (0) defines semantic index --> TEXCOORD0
+
+        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // D3D11_APPEND_ALIGNED_ELEMENT for automatic packing
+        {"TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Second entry (0) defines semantic index --> TEXCOORD0
+        {"BINORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 } // Second entry (0) defines semantic index --> TEXCOORD0
+    };
+
+    // Return configured Mesh objects.
+    std::vector<Mesh> meshes;
+    if (m_chunkTriangleCnt == 0 || indices.size() / 3 <= m_chunkTriangleCnt) {
+        meshes.push_back(Mesh(vertices, indices, vertexLayout, textures, matDefinition,
+            m_vertexShaderName, m_pixelShaderName, m_d3dDevice, m_d3dContext));
+        return meshes;
+    }
+
+    std::vector<MeshChunker::Chunk> chunks;
+    MeshChunker::Split(&vertices[0].Position, vertices.size(), sizeof(Vertex),
+        indices.data(), indices.size(), m_chunkTriangleCnt, chunks);
+    meshes.reserve(chunks.size());
+    for (const MeshChunker::Chunk& chunk : chunks) {
+        std::vector<Vertex> chunkVertices;
+        chunkVertices.reserve(chunk.vertices.size());
+        for (UINT32 vertex : chunk.vertices) {
+            chunkVertices.push_back(vertices[vertex]);
+        }
+        std::vector<unsigned int> chunkIndices(chunk.indices.begin(),
+            chunk.indices.end());
+        meshes.push_back(Mesh(chunkVertices, chunkIndices, vertexLayout, textures,
+            matDefinition, m_vertexShaderName, m_pixelShaderName, m_d3dDevice,
+            m_d3dContext));
+    }
+    return meshes;
+}
+
+
+/*
+ * ModelClass::ConvertMeshData
+ */
+void ModelClass::ConvertMeshData(const aiMesh* mesh, std::vector<Vertex>& vertices,
+        std::vector<unsigned int>& indices) {
+    unsigned int vertexCnt = mesh->mNumVertices;
+    vertices.clear();
+    indices.clear();
+    vertices.reserve(vertexCnt);
+    indices.reserve(mesh->mNumFaces * 3);
 
     for (unsigned int vertexIdx = 0; vertexIdx < vertexCnt; vertexIdx++) {
         Vertex vertex;
@@ -306,73 +835,13 @@ Mesh ModelClass::processMesh(aiMesh* mesh, const aiScene* scene) {
         vertices.push_back(vertex);
     }
 
-    // Process indices. Mesh is given by array of faces.
+    // Process indices. Mesh is given by array of faces. Reference, since copying
+    // an aiFace allocates.
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
+        const aiFace& face = mesh->mFaces[i];
         for (unsigned int j = 0; j < face.mNumIndices; j++)
             indices.push_back(face.mIndices[j]);
     }
-
-    // Process materials (textures).
-    // A mesh only uses a single material (defined by constants and textures)!
-    std::vector<Texture> textures;
-    Material matDefinition;
-    if (mesh->mMaterialIndex >= 0) {
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-        // Ambient (map_Ka).
-        std::vector<Texture> ambientMaps = loadMaterialTextures(material,
-            aiTextureType_AMBIENT, "texture_ambient");
-        textures.insert(textures.end(), ambientMaps.begin(), ambientMaps.end());
-
-        // Diffuse (map_Kd).
-        std::vector<Texture> diffuseMaps = loadMaterialTextures(material,
-            aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-        // Specular (map_Ks).
-        std::vector<Texture> specularMaps = loadMaterialTextures(material,
-            aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-
-        // Normal (map_Kn).
-        std::vector<Texture> normalMaps = loadMaterialTextures(material,
-            aiTextureType_NORMALS, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-
-        // Bump (map_bump).
-        std::vector<Texture> bumpMaps = loadMaterialTextures(material,
-            aiTextureType_HEIGHT, "texture_bump");
-        textures.insert(textures.end(), bumpMaps.begin(), bumpMaps.end());
-
-        // Shininess/Dissolve (map_d).
-        std::vector<Texture> dissolveMaps = loadMaterialTextures(material,
-            aiTextureType_SHININESS, "texture_dissolve");
-        textures.insert(textures.end(), dissolveMaps.begin(), dissolveMaps.end());
-
-        // Dissolve (map_Ke).
-        std::vector<Texture> emissiveMaps = loadMaterialTextures(material,
-            aiTextureType_EMISSIVE, "texture_emissive");
-        textures.insert(textures.end(), emissiveMaps.begin(), emissiveMaps.end());
-
-        // Load material constants. TODO: Make matColorViaTex more flexible.
-        matDefinition = loadMaterial(material);
-        matDefinition.matColorViaTex = (textures.size() > 0) ? true : false;
-    }
-
-    // Define vertex layout.
-    std::vector<D3D11_INPUT_ELEMENT_DESC> vertexLayout = {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Second entry (0) defines semantic index --> TEXCOORD0
-
-        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // D3D11_APPEND_ALIGNED_ELEMENT for automatic packing
-        {"TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Second entry (0) defines semantic index --> TEXCOORD0
-        {"BINORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 } // Second entry (0) defines semantic index --> TEXCOORD0
-    };
-
-    // Return a configured Mesh object.
-    return Mesh(vertices, indices, vertexLayout, textures, matDefinition, m_vertexShaderName,
-        m_pixelShaderName,m_d3dDevice, m_d3dContext);
 }
 
 
@@ -424,6 +893,8 @@ std::vector<Texture> ModelClass::loadMaterialTextures(
                     texture.srv.GetAddressOf());
                 assert(SUCCEEDED(hr));
             }
+            ResourceRegistry::Register(texture.srv.Get(),
+                ResourceRegistry::Category::TEXTURE, str.C_Str());
 
             // Setup other fields.
             texture.type = typeName;            // Diffuse, specular, normal, ...
@@ -469,45 +940,22 @@ Material ModelClass::loadMaterial(aiMaterial* mat) {
 }
 
 
-/*
- * ModelClass::computeNormalMatrix
- */
-sm::Matrix ModelClass::computeNormalMatrix(
-        const sm::Matrix& modelMatrix,
-        const sm::Matrix& viewMatrix) {
-    // Compute normal matrix.
-    sm::Matrix modelViewMatrix = modelMatrix * viewMatrix;
-    sm::Matrix normalMatrix4x4 = modelViewMatrix.Invert().Transpose();
-
-    // Extract relevant 3x3 part, which is the only thing we need.
-    sm::Matrix normalMatrix3x3;
-    normalMatrix3x3._11 = normalMatrix4x4._11;
-    normalMatrix3x3._12 = normalMatrix4x4._12;
-    normalMatrix3x3._13 = normalMatrix4x4._13;
-
-    normalMatrix3x3._21 = normalMatrix4x4._21;
-    normalMatrix3x3._22 = normalMatrix4x4._22;
-    normalMatrix3x3._23 = normalMatrix4x4._23;
-
-    normalMatrix3x3._31 = normalMatrix4x4._31;
-    normalMatrix3x3._32 = normalMatrix4x4._32;
-    normalMatrix3x3._33 = normalMatrix4x4._33;
-
-    return normalMatrix3x3;
-}
-
-
 /*
  * ModelClass::update
  */
 void ModelClass::update() {
-    // Re-compute model matrix.
-    m_modelMat = sm::Matrix::CreateScale(m_state.scale)
-        * sm::Matrix::CreateFromQuaternion(m_state.orientation)
-        * sm::Matrix::CreateTranslation(m_state.position);
-
-    // Pre-compute the normal matrix.
-    m_normalMat = computeNormalMatrix(m_modelMat, *m_viewMat);
+    // The scene composes all matrices in one batch before rendering. Flush here as
+    // well, in case a state was changed afterwards (no-op if nothing is dirty).
+    TransformSystem& transforms = TransformSystem::Default();
+    transforms.SetViewMatrix(*m_viewMat);
+    transforms.Update();
+
+    // A model drawn in several passes gets uploaded once per change.
+    UINT32 version = transforms.GetVersion(m_transform);
+    if (version == m_uploadedVersion) {
+        return;
+    }
+    m_uploadedVersion = version;
 
     // Upload updated state of model to GPU.
     {
@@ -516,9 +964,10 @@ void ModelClass::update() {
             &mappedResource);
         VS_PER_MODEL_CONSTANT_BUFFER* dataPtr = 
             (VS_PER_MODEL_CONSTANT_BUFFER*)mappedResource.pData;
-        dataPtr->modelMat = m_modelMat.Transpose();
-        dataPtr->normalMat = m_normalMat.Transpose();
+        dataPtr->modelMat = transforms.GetModelMatrix(m_transform).Transpose();
+        dataPtr->normalMat = transforms.GetNormalMatrix(m_transform).Transpose();
         m_d3dContext->Unmap(m_constBuffer.Get(), 0);
+        RenderStats::AddUpload(sizeof(VS_PER_MODEL_CONSTANT_BUFFER));
     }
 }
 
@@ -529,7 +978,8 @@ void ModelClass::update() {
 void ModelClass::initBuffers() {
     // Create constant buffer.
     VS_PER_MODEL_CONSTANT_BUFFER constBufferData;
-    constBufferData.modelMat = m_modelMat.Transpose();
+    constBufferData.modelMat = sm::Matrix::Identity;
+    constBufferData.normalMat = sm::Matrix::Identity;
 
     // Fill in a buffer description.
     D3D11_BUFFER_DESC cbDesc;
@@ -550,6 +1000,8 @@ void ModelClass::initBuffers() {
     HRESULT hr = m_d3dDevice->CreateBuffer(&cbDesc, &constInitData,
         m_constBuffer.GetAddressOf());
     assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_constBuffer.Get(),
+        ResourceRegistry::Category::CONSTANT_BUFFER, "m_constBuffer");
 }
 
 
@@ -649,83 +1101,10 @@ void ModelClass::createCubeMesh(sm::Vector3 color, bool usesInstancing) {
  * ModelClass::createSphereMesh
  */
 void ModelClass::createSphereMesh(sm::Vector3 color, bool usesInstancing) {
-    const int resTheta = 128;
-    const int resPhi = 64;
-    const double radiusSphere = 0.5;
-    constexpr float pi = 3.14159265358979323846f;  // TODO: Use lib.
-
-    // Vectors holding sphere vertex/uv/index information.
+    // Vectors holding sphere vertex/index information.
     std::vector<Vertex> vertices;
-    std::vector<float> texCoords;
     std::vector<unsigned int> indices;
-
-    // Vertex-coords and uv-coords.
-    float x, y, z;
-    float u, v;
-
-    // Renaming for easier understanding.
-    int verticalResolution = resTheta;
-    int horizontalResolution = resPhi;
-
-    // Step sizes and angles for vertices calculation.
-    float verticalStep = DirectX::XMConvertToRadians(
-        180.0f / float(verticalResolution));
-    float horizontalStep = DirectX::XMConvertToRadians(
-        360.0f / float(horizontalResolution));
-    float verticalAngle = 0.0f;
-    float horizontalAngle = 0.0f;
-
-    //Calculate vertices by looping over angles.
-    for (int i = 0; i <= horizontalResolution; i++) {
-        horizontalAngle = i * horizontalStep;
-        for (int j = 0; j <= verticalResolution; j++) {
-            verticalAngle = j * verticalStep;
-
-            // Calculate vertex position.
-            x = radiusSphere * sin(verticalAngle) * cos(horizontalAngle);
-            y = radiusSphere * sin(verticalAngle) * sin(horizontalAngle);
-            z = radiusSphere * cos(verticalAngle);
-
-            // Calculate texture coordinate.
-            u = horizontalAngle / (2 * pi);
-            v = verticalAngle / (pi);
-            texCoords.push_back(u);
-            texCoords.push_back(v);
-
-            // Add to vertices. Position also acts as the normal.
-            vertices.push_back(Vertex(sm::Vector3(x, y, z), sm::Vector3(x, y, z),
-                sm::Vector2(u, v)));
-        }
-    }
-
-    // Calculate indices. Similar to http://www.songho.ca/opengl/gl_sphere.html
-    // Visualization:     (k1)----(k1+verticalResolution + 1)
-    //                     |                   |
-    //                     |                   |
-    //                    (k2)----(k2+verticalResolution+1)
-    int k1, k2;
-    for (int i = 0; i < horizontalResolution; i++) {
-        for (int j = 0; j < verticalResolution; j++) {
-            k1 = i * (verticalResolution + 1) + j;
-            k2 = k1 + 1;
-
-            // Skip geographic north pole.
-            if (j != 0) {
-                // k1 => k2 => k1+1 vertex.
-                indices.push_back(k1);
-                indices.push_back(k2);
-                indices.push_back(k1 + verticalResolution + 1);
-            }
-
-            // Skip geographic south pole.
-            if (j != (verticalResolution - 1)) {
-                // k1+1 => k2 => k2+1 vertex.
-                indices.push_back(k1 + verticalResolution + 1);
-                indices.push_back(k2);
-                indices.push_back(k2 + verticalResolution + 1);
-            }
-        }
-    }
+    MeshGeometry::GenerateSphereGeometry(128, 64, vertices, indices);
 
     // Define materials.
     Material matDefinition;
@@ -759,72 +1138,53 @@ void ModelClass::createSphereMesh(sm::Vector3 color, bool usesInstancing) {
 
 
 /*
- * ModelClass::createTorusMesh
+ * ModelClass::createIcosahedronMesh
  */
-void ModelClass::createTorusMesh(sm::Vector3 color, bool usesInstancing) {
-    const int resT = 64; // Toroidal    Big circle
-    const int resP = 64; // Poloidal    Small circle
-    const float radiusOut = 0.34f;
-    const float radiusIn = 0.16f;
-    constexpr float pi = 3.14159265358979323846f;  // TODO: Use lib.
-
-    // Step sizes.
-    constexpr float outCircleStep = DirectX::XMConvertToRadians(360.0f / float(resT));
-    constexpr float inCircleStep = DirectX::XMConvertToRadians(360.0f / float(resP));
-
-    // Vectors holding torus vertex/normal/params/index information.
+void ModelClass::createIcosahedronMesh(sm::Vector3 color, bool usesInstancing) {
+    // Vectors holding icosahedron vertex/index information.
     std::vector<Vertex> vertices;
-    std::vector<float> normals;
     std::vector<unsigned int> indices;
+    MeshGeometry::GenerateIcosahedronGeometry(vertices, indices);
 
-    // Normal and angles for vertices calculation.
-    float nx, ny, nz, normalLength;
-    float currOutAngle = 0.0f;
-    float currInAngle = 0.0f;
-
-    // Calculate vertices of torus.
-    for (int i = 0; i <= resT; i++) {
-        currInAngle = 0.0f;
-        for (int j = 0; j <= resP; j++) {
-            // Add vertex to vertex list.
-            float x = (radiusOut + radiusIn * cos(currInAngle)) * cos(currOutAngle);
-            float y = (radiusOut + radiusIn * cos(currInAngle)) * sin(currOutAngle);
-            float z = radiusIn * sin(currInAngle);
-
-            // Add normals to normal list.
-            nx = cos(currInAngle) * cos(currOutAngle);
-            ny = sin(currOutAngle) * cos(currInAngle);
-            nz = sin(currInAngle);
-            normalLength = sqrt(pow(nx, 2) + pow(ny, 2) + pow(nz, 2));
-            float normalX = nx / normalLength;
-            float normalY = ny / normalLength;
-            float normalZ = nz / normalLength;
-
-            // Add step size to inner angle.
-            currInAngle += inCircleStep;
-
-            // Add to vertices. Position also acts as the normal.
-            vertices.push_back(Vertex(sm::Vector3(x, y, z),
-                sm::Vector3(normalX, normalY, normalZ),
-                sm::Vector2(0, 0)));
-        }
+    // Define materials.
+    Material matDefinition;
+    matDefinition.matAmbientColor = color;
+    matDefinition.matDiffuseColor = color;
+    matDefinition.matSpecularColor = color;
+    matDefinition.matShininess = 1.0f;
+    matDefinition.matOpticalDensity = 1.0f;
+    matDefinition.matDissolveFactor = 1.0f;
+    matDefinition.matColorViaTex = false;
+    matDefinition.matPadding0 = 0.0f;
+    matDefinition.matPadding1 = 0.0f;
+    matDefinition.matPadding2 = 0.0f;
 
-        // Add step size to outer angle.
-        currOutAngle += outCircleStep;
-    }
+    // Store the single mesh of this ModelClass object.
+    std::vector<Texture> textures;
+    std::vector<D3D11_INPUT_ELEMENT_DESC> vertexLayout =
+        createVertexInputLayout(usesInstancing);
 
-    // Calculate indices of torus.
-    unsigned int currentVertexOffset = 0;
-    for (auto i = 0; i < resT; i++) {
-        for (auto j = 0; j <= resP; j++) {
-            unsigned int vertexA = currentVertexOffset;
-            indices.push_back(vertexA);
+    m_meshes.push_back(Mesh(
+        vertices,
+        indices,
+        vertexLayout,
+        textures,
+        matDefinition,
+        m_vertexShaderName,
+        m_pixelShaderName,
+        m_d3dDevice,
+        m_d3dContext));
+}
 
-            unsigned int vertexB = currentVertexOffset + resP + 1;
-            indices.push_back(vertexB);
-            currentVertexOffset++;
-        }
-    }
+
+/*
+ * ModelClass::createTorusMesh
+ */
+void ModelClass::createTorusMesh(sm::Vector3 color, bool usesInstancing) {
+    // Vectors holding torus vertex/index information.
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MeshGeometry::GenerateTorusGeometry(64, 64, vertices, indices);
 
     // Define materials.
     Material matDefinition;
@@ -911,19 +1271,24 @@ std::vector<D3D11_INPUT_ELEMENT_DESC> ModelClass::createVertexInputLayout(bool u
 /*
  * ModelClass::processNode
  */
-void ModelClass::processNode(aiNode* node, const aiScene* scene) {
-    // Process all meshes of the node (if any).
+void ModelClass::processNode(aiNode* node, const aiScene* scene, UINT32 parent,
+        std::vector<aiMesh*>& meshes) {
+    // Keep the node and its transform. Assimp matrices are row-major for column
+    // vectors, SimpleMath uses row vectors.
+    sm::Matrix localMat = sm::Matrix(&node->mTransformation.a1).Transpose();
+    UINT32 sceneNode = m_sceneGraph.AddNode(parent, localMat, node->mName.C_Str());
+
+    // Collect all meshes of the node (if any).
     for (unsigned int meshIdx = 0; meshIdx < node->mNumMeshes; meshIdx++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[meshIdx]];
-        m_meshes.push_back(processMesh(mesh, scene));
+        meshes.push_back(scene->mMeshes[node->mMeshes[meshIdx]]);
+        m_meshNodes.push_back(sceneNode);
     }
 
-    // Do the same for each of its children.
+    // Do the same for each of its children (depth-first, as the scene graph
+    // requires).
     for (unsigned int childIdx = 0; childIdx < node->mNumChildren; childIdx++) {
-        processNode(node->mChildren[childIdx], scene);
+        processNode(node->mChildren[childIdx], scene, sceneNode, meshes);
     }
-
-    // TODO: Extend on parent-child relationship.
 }
 
 
@@ -945,8 +1310,142 @@ void ModelClass::loadModel() {
         assert(false);
     }
 
-    // Start recursive processing.
-    processNode(scene->mRootNode, scene);
+    // Textures are loaded with the immediate context (mip generation), so all
+    // materials are loaded on this thread first.
+    loadMaterials(scene);
+
+    // Collect the meshes in node order.
+    std::vector<aiMesh*> meshes;
+    processNode(scene->mRootNode, scene, SceneGraph::NO_PARENT, meshes);
+
+    // Vertex conversion and buffer creation only need the (free-threaded) device,
+    // so chunks of meshes are processed in parallel.
+    const unsigned int chunkSize = 16;
+    std::vector<std::vector<Mesh>> processedMeshes(meshes.size());
+    TaskGraph graph;
+    for (unsigned int first = 0; first < meshes.size(); first += chunkSize) {
+        unsigned int last = std::min(first + chunkSize,
+            static_cast<unsigned int>(meshes.size()));
+        graph.AddTask("Meshes " + std::to_string(first) + "-" +
+                std::to_string(last - 1), [&, first, last]() {
+            ResourceRegistry::ScopedOwner resourceOwner(m_name);
+            for (unsigned int i = first; i < last; i++) {
+                processedMeshes[i] = processMesh(meshes[i], scene);
+            }
+        });
+    }
+    graph.Run();
+    graph.Report("ModelClass::loadModel (" + m_name + ")");
+
+    // Keep the original order. Chunks take the place of their mesh and its node.
+    std::vector<UINT32> sourceNodes;
+    sourceNodes.swap(m_meshNodes);
+    UINT32 splitCnt = 0;
+    double sourceArea = 0.0;
+    double chunkArea = 0.0;
+    for (unsigned int i = 0; i < processedMeshes.size(); i++) {
+        std::vector<Mesh>& chunks = processedMeshes[i];
+        if (chunks.size() > 1) {
+            // Bounds surface area that every triangle gets culled with, summed over
+            // the triangles, before and after the split.
+            dx::BoundingBox sourceBounds = chunks[0].GetBounds();
+            for (const Mesh& chunk : chunks) {
+                dx::BoundingBox::CreateMerged(sourceBounds, sourceBounds,
+                    chunk.GetBounds());
+            }
+            for (const Mesh& chunk : chunks) {
+                double triangleCnt = chunk.GetIndices().size() / 3.0;
+                chunkArea += triangleCnt * MeshChunker::GetSurfaceArea(chunk.GetBounds());
+                sourceArea += triangleCnt * MeshChunker::GetSurfaceArea(sourceBounds);
+            }
+            splitCnt++;
+        }
+        for (Mesh& chunk : chunks) {
+            m_meshes.push_back(std::move(chunk));
+            m_meshNodes.push_back(sourceNodes[i]);
+        }
+    }
+    if (m_chunkTriangleCnt > 0) {
+        char report[256];
+        snprintf(report, sizeof(report), "ModelClass::loadModel (%s): %u of %zu "
+            "meshes split, %zu meshes, triangle bounds area %.1f%% of unsplit\n",
+            m_name.c_str(), splitCnt, processedMeshes.size(), m_meshes.size(),
+            sourceArea > 0.0 ? 100.0 * chunkArea / sourceArea : 100.0);
+        OutputDebugStringA(report);
+    }
+
+    // Bounds of the geometry of every node, then the initial world matrices.
+    std::vector<dx::BoundingBox> nodeBounds(m_sceneGraph.GetNodeCount());
+    std::vector<bool> hasBounds(m_sceneGraph.GetNodeCount(), false);
+    for (unsigned int i = 0; i < m_meshes.size(); i++) {
+        UINT32 node = m_meshNodes[i];
+        if (hasBounds[node]) {
+            dx::BoundingBox::CreateMerged(nodeBounds[node], nodeBounds[node],
+                m_meshes[i].GetBounds());
+        } else {
+            nodeBounds[node] = m_meshes[i].GetBounds();
+            hasBounds[node] = true;
+        }
+    }
+    for (UINT32 node = 0; node < m_sceneGraph.GetNodeCount(); node++) {
+        if (hasBounds[node]) {
+            m_sceneGraph.SetLocalBounds(node, nodeBounds[node]);
+        }
+    }
+    m_sceneGraph.Update();
+    m_nodeConstBuffers.resize(m_sceneGraph.GetNodeCount());
+}
+
+
+/*
+ * ModelClass::loadMaterials
+ */
+void ModelClass::loadMaterials(const aiScene* scene) {
+    m_materialTextures.resize(scene->mNumMaterials);
+    m_materials.resize(scene->mNumMaterials);
+    for (unsigned int matIdx = 0; matIdx < scene->mNumMaterials; matIdx++) {
+        aiMaterial* material = scene->mMaterials[matIdx];
+        std::vector<Texture>& textures = m_materialTextures[matIdx];
+
+        // Ambient (map_Ka).
+        std::vector<Texture> ambientMaps = loadMaterialTextures(material,
+            aiTextureType_AMBIENT, "texture_ambient");
+        textures.insert(textures.end(), ambientMaps.begin(), ambientMaps.end());
+
+        // Diffuse (map_Kd).
+        std::vector<Texture> diffuseMaps = loadMaterialTextures(material,
+            aiTextureType_DIFFUSE, "texture_diffuse");
+        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+
+        // Specular (map_Ks).
+        std::vector<Texture> specularMaps = loadMaterialTextures(material,
+            aiTextureType_SPECULAR, "texture_specular");
+        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+
+        // Normal (map_Kn).
+        std::vector<Texture> normalMaps = loadMaterialTextures(material,
+            aiTextureType_NORMALS, "texture_normal");
+        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+
+        // Bump (map_bump).
+        std::vector<Texture> bumpMaps = loadMaterialTextures(material,
+            aiTextureType_HEIGHT, "texture_bump");
+        textures.insert(textures.end(), bumpMaps.begin(), bumpMaps.end());
+
+        // Shininess/Dissolve (map_d).
+        std::vector<Texture> dissolveMaps = loadMaterialTextures(material,
+            aiTextureType_SHININESS, "texture_dissolve");
+        textures.insert(textures.end(), dissolveMaps.begin(), dissolveMaps.end());
+
+        // Dissolve (map_Ke).
+        std::vector<Texture> emissiveMaps = loadMaterialTextures(material,
+            aiTextureType_EMISSIVE, "texture_emissive");
+        textures.insert(textures.end(), emissiveMaps.begin(), emissiveMaps.end());
+
+        // Load material constants. TODO: Make matColorViaTex more flexible.
+        m_materials[matIdx] = loadMaterial(material);
+        m_materials[matIdx].matColorViaTex = (textures.size() > 0) ? true : false;
+    }
 }
 
 
@@ -1,29 +1,15 @@
 #pragma once
 #include "Mesh.h"
-
-/// <summary>
-/// Defines the state of a ModelClass object.
-/// </summary>
-struct ModelState {
-    float scale;
-    sm::Vector3 position;
-    sm::Quaternion orientation;
-
-    // Constructor.
-    ModelState(float scale, sm::Vector3 position, sm::Vector4 rotation) :
-        scale(scale), position(position),
-        orientation(sm::Quaternion(rotation)) {
-        orientation.Normalize();
-    };
-
-    // Default constructor.
-    ModelState() {
-        scale = 1.0;
-        position = sm::Vector3(0.0, 0.0, 0.0);
-        orientation = sm::Quaternion::Identity;
-        orientation.Normalize();
-    }
-};
+#include "TaskGraph.h"
+#include "TransformSystem.h"
+#include "SceneGraph.h"
+#include "FrustumCuller.h"
+#include "Bvh.h"
+#include "OcclusionCuller.h"
+#include "HiZCuller.h"
+#include "Pvs.h"
+#include "MeshChunker.h"
+#include "MeshGeometry.h"
 
 /// <summary>
 /// Represents a complex model, that consists of multiple meshes.
@@ -41,6 +27,7 @@ public:
         CUBE,       // Defined in this class.
         SPHERE,     // Defined in this class.
         TORUS,      // Defined in this class.
+        ICOSAHEDRON, // Defined in this class, around the sphere.
         LOADED,     // Mesh defined via file on disk.
         CUSTOM      // Mesh defined outside and passed in via constructor.
     };
@@ -62,6 +49,9 @@ public:
     /// <param name="initRotation">Initial rotation of the object. Used for modelMat
     ///  construction.</param>
     /// <param name="fileFormat">0 = .obj (wavefront), 1 = .dae (Collada)</param>
+    /// <param name="chunkTriangleCnt">Meshes with more triangles are split into
+    /// spatial chunks of at most this many triangles (see MeshChunker). 0 keeps the
+    /// meshes of the file.</param>
     ModelClass(
         std::string directory,
         std::string name,
@@ -74,7 +64,8 @@ public:
         sm::Vector4 initRotation,
         unsigned int fileFormat,
         std::wstring vertexShaderName,
-        std::wstring pixelShaderName);
+        std::wstring pixelShaderName,
+        unsigned int chunkTriangleCnt = 0);
 
     /// <summary>
     /// Constructor that is used when creating a model for a pre-defined mesh (cube,
@@ -168,12 +159,180 @@ public:
     /// <param name="depthPass">Set true if no framebuffer is bound. Used only in the
     /// first phase of shadow mapping.</param>
     void Draw(bool depthPass);
+
+    /// <summary>
+    /// Draws only the given meshes, e.g. the visible ones returned by Cull().
+    /// </summary>
+    /// <param name="depthPass">See Draw(bool).</param>
+    /// <param name="meshes">Indices of the meshes to draw.</param>
+    void Draw(bool depthPass, const std::vector<UINT32>& meshes);
+
+    /// <summary>
+    /// Collects the meshes whose world-space bounds intersect a view frustum.
+    /// </summary>
+    /// <remarks>
+    /// Uses the matrices of the last TransformSystem update. The world bounds of the
+    /// meshes are only recomputed if the model or one of its nodes moved. The bounds
+    /// do not cover the instances of instanced models.
+    /// </remarks>
+    /// <param name="planes">Frustum planes (see FrustumCuller::ExtractPlanes).
+    /// </param>
+    /// <param name="visibleMeshes">Output. Indices of the visible meshes.</param>
+    /// <param name="contribution">Optional contribution culling, drops meshes that
+    /// are too small on screen.</param>
+    void Cull(const FrustumCuller::Planes& planes, std::vector<UINT32>& visibleMeshes,
+        const FrustumCuller::Contribution& contribution = FrustumCuller::Contribution());
+
+    /// <summary>
+    /// Collects the meshes of a candidate list whose bounds intersect a view
+    /// frustum, e.g. the meshes of a potentially visible set.
+    /// </summary>
+    /// <param name="planes">Frustum planes.</param>
+    /// <param name="candidates">Indices of the meshes to test. The order is kept.
+    /// </param>
+    /// <param name="visibleMeshes">Output. Indices of the visible meshes.</param>
+    /// <param name="contribution">Optional contribution culling.</param>
+    void Cull(const FrustumCuller::Planes& planes, const std::vector<UINT32>& candidates,
+        std::vector<UINT32>& visibleMeshes,
+        const FrustumCuller::Contribution& contribution = FrustumCuller::Contribution());
+
+    /// <summary>
+    /// Selects between the hierarchical (BVH) and the flat (SIMD) mesh culling.
+    /// Both are conservative and agree up to rounding at the frustum planes.
+    /// </summary>
+    void SetUseBvh(bool useBvh);
+    bool GetUseBvh() const;
+
+    /// <summary>
+    /// Adds the occluder meshes to a software occlusion culler. Occluders are
+    /// opaque, large meshes with few triangles. They are selected on the first call.
+    /// </summary>
+    void AddOccluders(OcclusionCuller& culler);
+
+    /// <summary>
+    /// Removes the meshes that are hidden behind the occluders of a culler.
+    /// </summary>
+    /// <param name="culler">Culler after Rasterize().</param>
+    /// <param name="meshes">Indices of meshes, e.g. the output of Cull(). The order
+    /// is kept.</param>
+    void CullOccluded(const OcclusionCuller& culler, std::vector<UINT32>& meshes);
+
+    /// <summary>
+    /// Removes the meshes that are hidden in the reprojected depth of a culler.
+    /// </summary>
+    /// <param name="culler">Culler after Update().</param>
+    /// <param name="meshes">Indices of meshes. The order is kept.</param>
+    void CullOccluded(const HiZCuller& culler, std::vector<UINT32>& meshes);
+
+    /// <summary>
+    /// Adds all meshes to a PVS for baking, in model space. Opaque meshes occlude.
+    /// </summary>
+    void AddPvsMeshes(Pvs& pvs);
+
+    /// <summary>
+    /// Returns the PVS cell of a world-space position, e.g. of the camera.
+    /// </summary>
+    /// <param name="pvs">PVS baked from AddPvsMeshes().</param>
+    /// <param name="position">World-space position.</param>
+    UINT32 FindPvsCell(const Pvs& pvs, const sm::Vector3& position) const;
+
+    /// <summary>
+    /// Returns the number of meshes.
+    /// </summary>
+    UINT32 GetMeshCount() const;
+
+    /// <summary>
+    /// Returns the number of instances of an instanced model. 0 for others.
+    /// </summary>
+    UINT32 GetInstanceCount() const;
+
+    /// <summary>
+    /// Returns the world-space bounds of an instance.
+    /// </summary>
+    dx::BoundingBox GetInstanceBounds(UINT32 instance) const;
+
+    /// <summary>
+    /// Restricts the drawing of an instanced model to a subset of its instances,
+    /// e.g. the ones that survived culling. Uploads the instance data.
+    /// </summary>
+    /// <param name="instances">Indices of the instances to draw.</param>
+    void SetVisibleInstances(const std::vector<UINT32>& instances);
+
+    /// <summary>
+    /// Replaces the instances of an instanced model, e.g. of moving lights. Grows
+    /// the instance buffer if needed. Uploaded by the next SetVisibleInstances().
+    /// </summary>
+    void SetInstances(const std::vector<sm::Vector3>& positions,
+        const std::vector<sm::Vector3>& colors, const std::vector<sm::Vector3>& scales);
+
+    /// <summary>
+    /// Like SetVisibleInstances(), but the caller writes the instances straight into
+    /// the mapped instance buffer, e.g. from another layout. An instance is 3 floats
+    /// each of position, scale and color, GetInstanceStride() bytes apart. The
+    /// instances of SetInstances() stay as they are.
+    /// </summary>
+    /// <param name="count">Number of instances to draw, at most GetInstanceCount().
+    /// </param>
+    /// <returns>The first instance. Valid until UnmapVisibleInstances().</returns>
+    void* MapVisibleInstances(UINT32 count);
+    void UnmapVisibleInstances();
+
+    UINT32 GetInstanceStride() const;
+
+    /// <summary>
+    /// Draws the visible instances of another instanced model instead of its own,
+    /// e.g. the same lights as another mesh. Has to be called again after every
+    /// upload of the other model.
+    /// </summary>
+    void ShareInstances(const ModelClass& source);
+
+    /// <summary>
+    /// Returns the world-space bounds of all meshes.
+    /// </summary>
+    dx::BoundingBox GetWorldBounds();
+
+    /// <summary>
+    /// Returns the culler that holds the world-space bounds of the meshes.
+    /// </summary>
+    /// <returns></returns>
+    FrustumCuller& GetCuller();
+
+    // Owns a transform. Copies would destroy it twice.
+    ModelClass(const ModelClass&) = delete;
+    ModelClass& operator=(const ModelClass&) = delete;
+
+    /// <summary>
+    /// Releases the transform of the model.
+    /// </summary>
+    ~ModelClass();
     
     /// <summary>
-    /// Returns pointer to the state of the model (position, rotation, scale).
+    /// Returns the state of the model (position, rotation, scale).
     /// </summary>
     /// <returns></returns>
-    ModelState* GetState();
+    ModelState GetState() const;
+
+    /// <summary>
+    /// Returns the node hierarchy of a loaded model. Empty for other models.
+    /// </summary>
+    /// <returns></returns>
+    SceneGraph& GetSceneGraph();
+
+    /// <summary>
+    /// Sets the state of the model. The matrices get recomputed with the next batch
+    /// update of the TransformSystem.
+    /// </summary>
+    /// <param name="state">New state.</param>
+    void SetState(const ModelState& state);
+
+    /// <summary>
+    /// Converts the geometry of an assimp mesh into the vertex format of Mesh.
+    /// </summary>
+    /// <param name="mesh">Pointer to the mesh.</param>
+    /// <param name="vertices">Output vertices.</param>
+    /// <param name="indices">Output indices.</param>
+    static void ConvertMeshData(const aiMesh* mesh, std::vector<Vertex>& vertices,
+        std::vector<unsigned int>& indices);
 
 private:
     /// <summary>
@@ -194,19 +353,59 @@ private:
         Material matDefinition);
 
     /// <summary>
-    /// Processes a node in an assimp graph.
+    /// Processes a node in an assimp graph and collects its meshes.
     /// </summary>
     /// <param name="node">Pointer to the node of the graph.</param>
     /// <param name="scene">Current assimp scene.</param>
-    void processNode(aiNode* node, const aiScene* scene);
+    /// <param name="parent">Scene graph node of the parent.</param>
+    /// <param name="meshes">Meshes of the node and its children get appended.
+    /// </param>
+    void processNode(aiNode* node, const aiScene* scene, UINT32 parent,
+        std::vector<aiMesh*>& meshes);
+
+    /// <summary>
+    /// Returns the constant buffer for the meshes of a scene graph node. Nodes
+    /// without a transform of their own share the constant buffer of the model,
+    /// all others get one that is created and updated on demand.
+    /// </summary>
+    /// <param name="node">Scene graph node.</param>
+    /// <returns>Constant buffer with the matrices of the node.</returns>
+    ID3D11Buffer* getNodeConstBuffer(UINT32 node);
+
+    /// <summary>
+    /// Draws a mesh and binds the constant buffer of its node, if it differs from
+    /// the bound one.
+    /// </summary>
+    /// <param name="mesh">Index of the mesh.</param>
+    /// <param name="depthPass">See Draw(bool).</param>
+    /// <param name="boundBuffer">Currently bound constant buffer. Updated.</param>
+    void drawMesh(UINT32 mesh, bool depthPass, ID3D11Buffer*& boundBuffer);
+
+    /// <summary>
+    /// Recomputes the world-space bounds of all meshes that moved since the last
+    /// call.
+    /// </summary>
+    void updateCullingBounds();
+
+    /// <summary>
+    /// Selects the meshes that get rasterized as occluders.
+    /// </summary>
+    void selectOccluders();
+
+    /// <summary>
+    /// Loads textures and constants of all materials of an assimp scene.
+    /// </summary>
+    /// <param name="scene">Current assimp scene.</param>
+    void loadMaterials(const aiScene* scene);
 
     /// <summary>
     /// Process mesh of an assimp node.
     /// </summary>
     /// <param name="mesh">Pointer to the mesh.</param>
     /// <param name="scene">Current assimp scene.</param>
-    /// <returns>Created Mesh object.</returns>
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    /// <returns>Created Mesh objects. One per chunk if the mesh has more than
+    /// m_chunkTriangleCnt triangles, otherwise one.</returns>
+    std::vector<Mesh> processMesh(aiMesh* mesh, const aiScene* scene);
 
     /// <summary>
     /// Loads textures from disk and stores them efficiently.
@@ -226,7 +425,8 @@ private:
     Material loadMaterial(aiMaterial* mat);
 
     /// <summary>
-    /// Called every frame. Updates all relevant resources.
+    /// Called on every Draw(). Uploads the matrices, if the TransformSystem
+    /// recomputed them since the last upload.
     /// </summary>
     void update();
     
@@ -252,6 +452,12 @@ private:
     /// <param name="color">Color of the sphere.</param>
     void createSphereMesh(sm::Vector3 color, bool usesInstancing);
 
+    /// <summary>
+    /// Creates mesh data for an icosahedron around a sphere.
+    /// </summary>
+    /// <param name="color">Color of the icosahedron.</param>
+    void createIcosahedronMesh(sm::Vector3 color, bool usesInstancing);
+
     /// <summary>
     /// Creates mesh data for a torus (donut).
     /// </summary>
@@ -264,26 +470,19 @@ private:
     /// <returns></returns>
     std::vector<D3D11_INPUT_ELEMENT_DESC> createVertexInputLayout(bool usesInstancing);
 
-    /// <summary>
-    /// Computes the normal matrix.
-    /// </summary>
-    /// <param name="modelMatrix">Model matrix of the ModelClass object.</param>
-    /// <param name="viewMatrix">View matrix of the ModelClass object.</param>
-    /// <returns></returns>
-    sm::Matrix computeNormalMatrix(
-        const sm::Matrix& modelMatrix,
-        const sm::Matrix& viewMatrix);
-
     // Data for models that were loaded from disk.
     std::string m_directory;
     std::string m_name;
     std::string m_fullModelPath;
     unsigned int m_modelExtraFlags; // For assimp loading.
     unsigned int m_fileFormat;
+    unsigned int m_chunkTriangleCnt = 0;
 
     // All the meshes and textures that define the model.
     std::vector<Mesh> m_meshes;
     std::vector<Texture> textures_loaded;
+    std::vector<std::vector<Texture>> m_materialTextures;   // Per material index.
+    std::vector<Material> m_materials;                      // Per material index.
 
     // D3D11 information.
     wrl::ComPtr<ID3D11Device> m_d3dDevice;
@@ -296,11 +495,35 @@ private:
     };
     wrl::ComPtr<ID3D11Buffer> m_constBuffer;
 
+    // Node hierarchy of loaded models. Meshes are drawn with the world matrix of
+    // their node.
+    struct NodeConstBuffer {
+        wrl::ComPtr<ID3D11Buffer> buffer;
+        UINT32 transformVersion = 0;    // Versions of the uploaded matrices.
+        UINT32 nodeVersion = 0;
+    };
+    SceneGraph m_sceneGraph;
+    std::vector<UINT32> m_meshNodes;                // Node per mesh.
+    std::vector<NodeConstBuffer> m_nodeConstBuffers; // Per node.
+
+    // World-space bounds of the meshes for culling, flat and as hierarchy.
+    std::vector<dx::BoundingBox> m_cullBounds;
+    FrustumCuller m_culler;
+    Bvh m_bvh;
+    bool m_useBvh = true;
+    sm::Matrix m_cullModelMat;              // Model matrix of the bounds.
+    std::vector<UINT32> m_cullNodeVersions; // Node version of the bounds per mesh.
+
+    // Occluders for the software occlusion culling. Budgets in triangles.
+    static const UINT32 MAX_OCCLUDER_TRIANGLES = 2048;      // Per mesh.
+    static const UINT32 OCCLUDER_TRIANGLE_BUDGET = 16384;   // Per model.
+    std::vector<UINT32> m_occluderMeshes;
+    bool m_occludersSelected = false;
+
     // Important information about the model.
-    ModelState m_state;
+    TransformHandle m_transform;
+    UINT32 m_uploadedVersion;   // Transform version in the constant buffer.
     const sm::Matrix* m_viewMat;
-    sm::Matrix m_modelMat;      // Combination of scale, position and rotation.
-    sm::Matrix m_normalMat;
     std::wstring m_vertexShaderName;
     std::wstring m_pixelShaderName;
 
@@ -318,7 +541,9 @@ private:
         sm::Vector3 iScale;
         sm::Vector3 iColor;
     };
-    unsigned int m_instanceCount;
+    unsigned int m_instanceCount;                   // Capacity of the buffer.
+    unsigned int m_visibleInstanceCnt;              // Last upload.
     unsigned int m_instanceStride;
-    wrl::ComPtr<ID3D11Buffer> m_instanceBuffer;
+    wrl::ComPtr<ID3D11Buffer> m_instanceBuffer;     // Dynamic, see SetVisibleInstances().
+    std::vector<InstanceType> m_instanceData;       // All instances.
 };
\ No newline at end of file
@@ -0,0 +1,477 @@
+#include "stdafx.h"
+#include "OcclusionCuller.h"
+#include "Platform.h"
+#include "WorkerPool.h"
+
+// AVX2.
+#include <immintrin.h>
+
+
+/*
+ * OcclusionCuller::OcclusionCuller
+ */
+OcclusionCuller::OcclusionCuller(UINT32 width, UINT32 height) {
+    assert(width % TILE_WIDTH == 0 && height % TILE_HEIGHT == 0);
+    m_width = width;
+    m_height = height;
+    m_tilesX = width / TILE_WIDTH;
+    m_tilesY = height / TILE_HEIGHT;
+    m_path = Platform::IsAvx2Supported() ? Path::AVX2 : Path::SCALAR;
+
+    m_depth.assign(static_cast<size_t>(width) * height, 1.0f);
+    m_tileMaxDepths.assign(m_tilesX * m_tilesY, 1.0f);
+    m_tileBins.resize(m_tilesX * m_tilesY);
+}
+
+
+/*
+ * OcclusionCuller::BeginFrame
+ */
+void OcclusionCuller::BeginFrame(const sm::Matrix& viewProj) {
+    m_viewProj = viewProj;
+    std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+    std::fill(m_tileMaxDepths.begin(), m_tileMaxDepths.end(), 1.0f);
+    m_triangles.clear();
+    for (std::vector<UINT32>& bin : m_tileBins) {
+        bin.clear();
+    }
+}
+
+
+/*
+ * OcclusionCuller::AddOccluder
+ */
+void OcclusionCuller::AddOccluder(const sm::Vector3* positions, size_t positionCnt,
+        size_t positionStride, const UINT32* indices, size_t indexCnt,
+        const sm::Matrix& worldMat) {
+    // Vertices are shared between triangles, transform them once.
+    sm::Matrix worldViewProj = worldMat * m_viewProj;
+    m_clipPositions.resize(positionCnt);
+    const UINT8* position = reinterpret_cast<const UINT8*>(positions);
+    for (size_t i = 0; i < positionCnt; i++, position += positionStride) {
+        const sm::Vector3& modelPos = *reinterpret_cast<const sm::Vector3*>(position);
+        m_clipPositions[i] = sm::Vector4::Transform(
+            sm::Vector4(modelPos.x, modelPos.y, modelPos.z, 1.0f), worldViewProj);
+    }
+
+    for (size_t i = 0; i + 2 < indexCnt; i += 3) {
+        addTriangle(m_clipPositions[indices[i]], m_clipPositions[indices[i + 1]],
+            m_clipPositions[indices[i + 2]]);
+    }
+}
+
+
+/*
+ * OcclusionCuller::Rasterize
+ */
+void OcclusionCuller::Rasterize() {
+    // Bin by the bounding rectangle of the triangles.
+    for (UINT32 i = 0; i < m_triangles.size(); i++) {
+        const Triangle& triangle = m_triangles[i];
+        for (UINT32 ty = triangle.minY / TILE_HEIGHT; ty <= triangle.maxY / TILE_HEIGHT;
+                ty++) {
+            for (UINT32 tx = triangle.minX / TILE_WIDTH;
+                    tx <= triangle.maxX / TILE_WIDTH; tx++) {
+                m_tileBins[ty * m_tilesX + tx].push_back(i);
+            }
+        }
+    }
+
+    // Tiles are independent. Threads take the next free tile.
+    UINT32 tileCnt = m_tilesX * m_tilesY;
+    if (m_threadCnt <= 1) {
+        for (UINT32 tile = 0; tile < tileCnt; tile++) {
+            rasterizeTile(tile);
+        }
+        return;
+    }
+
+    std::atomic<UINT32> nextTile = 0;
+    WorkerPool::Get().Run(m_threadCnt, [this, &nextTile, tileCnt](unsigned int) {
+        for (UINT32 tile = nextTile++; tile < tileCnt; tile = nextTile++) {
+            rasterizeTile(tile);
+        }
+    });
+}
+
+
+/*
+ * OcclusionCuller::TestBox
+ */
+bool OcclusionCuller::TestBox(const dx::BoundingBox& box) const {
+    // Screen rectangle and nearest depth of the corners.
+    std::array<sm::Vector3, 8> corners;
+    box.GetCorners(corners.data());
+    float minX = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float minY = FLT_MAX;
+    float maxY = -FLT_MAX;
+    float minZ = FLT_MAX;
+    for (const sm::Vector3& corner : corners) {
+        sm::Vector4 clip = sm::Vector4::Transform(
+            sm::Vector4(corner.x, corner.y, corner.z, 1.0f), m_viewProj);
+        if (clip.z < 0.0f || clip.w <= 0.0f) {
+            return true;    // Crosses the near plane.
+        }
+        float screenX = (clip.x / clip.w * 0.5f + 0.5f) * m_width;
+        float screenY = (0.5f - clip.y / clip.w * 0.5f) * m_height;
+        minX = std::min(minX, screenX);
+        maxX = std::max(maxX, screenX);
+        minY = std::min(minY, screenY);
+        maxY = std::max(maxY, screenY);
+        minZ = std::min(minZ, clip.z / clip.w);
+    }
+    if (maxX < 0.0f || minX >= m_width || maxY < 0.0f || minY >= m_height) {
+        return true;    // Off screen, left to the frustum culling.
+    }
+
+    // All pixels that the rectangle touches.
+    UINT32 x0 = static_cast<UINT32>(std::max(0.0f, std::floor(minX)));
+    UINT32 x1 = static_cast<UINT32>(std::min(m_width - 1.0f, std::floor(maxX)));
+    UINT32 y0 = static_cast<UINT32>(std::max(0.0f, std::floor(minY)));
+    UINT32 y1 = static_cast<UINT32>(std::min(m_height - 1.0f, std::floor(maxY)));
+
+    for (UINT32 ty = y0 / TILE_HEIGHT; ty <= y1 / TILE_HEIGHT; ty++) {
+        for (UINT32 tx = x0 / TILE_WIDTH; tx <= x1 / TILE_WIDTH; tx++) {
+            // Every occluder of the tile is in front of the box.
+            if (m_tileMaxDepths[ty * m_tilesX + tx] < minZ) {
+                continue;
+            }
+            UINT32 py0 = std::max(y0, ty * TILE_HEIGHT);
+            UINT32 py1 = std::min(y1, (ty + 1) * TILE_HEIGHT - 1);
+            UINT32 px0 = std::max(x0, tx * TILE_WIDTH);
+            UINT32 px1 = std::min(x1, (tx + 1) * TILE_WIDTH - 1);
+            for (UINT32 y = py0; y <= py1; y++) {
+                const float* row = &m_depth[static_cast<size_t>(y) * m_width];
+                for (UINT32 x = px0; x <= px1; x++) {
+                    if (row[x] >= minZ) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+
+/*
+ * OcclusionCuller::GetTileMaxDepth
+ */
+void OcclusionCuller::GetTileMaxDepth(UINT32 screenWidth, UINT32 screenHeight,
+        UINT32 tileSize, std::vector<float>& maxDepth) const {
+    assert(screenWidth > 0 && screenHeight > 0 && tileSize > 0);
+    UINT32 tilesX = (screenWidth + tileSize - 1) / tileSize;
+    UINT32 tilesY = (screenHeight + tileSize - 1) / tileSize;
+    maxDepth.assign(static_cast<size_t>(tilesX) * tilesY, 0.0f);
+
+    // Pixels of the buffer that overlap the screen pixels [begin, end).
+    auto toFirst = [](UINT32 begin, UINT32 bufferSize, UINT32 screenSize) {
+        return static_cast<UINT32>(UINT64(begin) * bufferSize / screenSize);
+    };
+    auto toLast = [](UINT32 end, UINT32 bufferSize, UINT32 screenSize) {
+        return static_cast<UINT32>((UINT64(end) * bufferSize + screenSize - 1) /
+            screenSize);
+    };
+    for (UINT32 tileY = 0; tileY < tilesY; tileY++) {
+        UINT32 y0 = toFirst(tileY * tileSize, m_height, screenHeight);
+        UINT32 y1 = toLast(std::min((tileY + 1) * tileSize, screenHeight), m_height,
+            screenHeight);
+        for (UINT32 tileX = 0; tileX < tilesX; tileX++) {
+            UINT32 x0 = toFirst(tileX * tileSize, m_width, screenWidth);
+            UINT32 x1 = toLast(std::min((tileX + 1) * tileSize, screenWidth), m_width,
+                screenWidth);
+            float tileDepth = 0.0f;
+            for (UINT32 y = y0; y < y1; y++) {
+                const float* row = &m_depth[static_cast<size_t>(y) * m_width];
+                tileDepth = std::max(tileDepth, *std::max_element(row + x0, row + x1));
+            }
+            maxDepth[static_cast<size_t>(tileY) * tilesX + tileX] = tileDepth;
+        }
+    }
+}
+
+
+/*
+ * OcclusionCuller::SetPath
+ */
+void OcclusionCuller::SetPath(Path path) {
+    m_path = path == Path::AVX2 && !Platform::IsAvx2Supported() ?
+        Path::SCALAR : path;
+}
+
+
+/*
+ * OcclusionCuller::GetPath
+ */
+OcclusionCuller::Path OcclusionCuller::GetPath() const {
+    return m_path;
+}
+
+
+/*
+ * OcclusionCuller::SetThreadCount
+ */
+void OcclusionCuller::SetThreadCount(UINT32 threadCnt) {
+    m_threadCnt = std::max(1u, threadCnt);
+}
+
+
+/*
+ * OcclusionCuller::GetWidth
+ */
+UINT32 OcclusionCuller::GetWidth() const {
+    return m_width;
+}
+
+
+/*
+ * OcclusionCuller::GetHeight
+ */
+UINT32 OcclusionCuller::GetHeight() const {
+    return m_height;
+}
+
+
+/*
+ * OcclusionCuller::GetTriangleCount
+ */
+UINT32 OcclusionCuller::GetTriangleCount() const {
+    return static_cast<UINT32>(m_triangles.size());
+}
+
+
+/*
+ * OcclusionCuller::GetDepth
+ */
+const std::vector<float>& OcclusionCuller::GetDepth() const {
+    return m_depth;
+}
+
+
+/*
+ * OcclusionCuller::addTriangle
+ */
+void OcclusionCuller::addTriangle(const sm::Vector4& clip0, const sm::Vector4& clip1,
+        const sm::Vector4& clip2) {
+    Triangle triangle;
+    if (clip0.z >= 0.0f && clip1.z >= 0.0f && clip2.z >= 0.0f) {
+        if (setupTriangle(clip0, clip1, clip2, triangle)) {
+            m_triangles.push_back(triangle);
+        }
+        return;
+    }
+
+    // Clip against the near plane (z = 0), which leaves a triangle or a quad. Walls
+    // next to the camera are the best occluders, dropping them loses most of the
+    // occlusion.
+    const sm::Vector4* clip[3] = { &clip0, &clip1, &clip2 };
+    std::array<sm::Vector4, 4> polygon;
+    UINT32 vertexCnt = 0;
+    for (int i = 0; i < 3; i++) {
+        const sm::Vector4& current = *clip[i];
+        const sm::Vector4& next = *clip[(i + 1) % 3];
+        if (current.z >= 0.0f) {
+            polygon[vertexCnt++] = current;
+        }
+        if ((current.z >= 0.0f) != (next.z >= 0.0f)) {
+            float t = current.z / (current.z - next.z);
+            sm::Vector4 intersection = current + (next - current) * t;
+            intersection.z = 0.0f;
+            polygon[vertexCnt++] = intersection;
+        }
+    }
+    for (UINT32 i = 1; i + 1 < vertexCnt; i++) {
+        if (setupTriangle(polygon[0], polygon[i], polygon[i + 1], triangle)) {
+            m_triangles.push_back(triangle);
+        }
+    }
+}
+
+
+/*
+ * OcclusionCuller::setupTriangle
+ */
+bool OcclusionCuller::setupTriangle(const sm::Vector4& clip0, const sm::Vector4& clip1,
+        const sm::Vector4& clip2, Triangle& triangle) const {
+    const std::array<const sm::Vector4*, 3> clip = { &clip0, &clip1, &clip2 };
+    std::array<float, 3> x;
+    std::array<float, 3> y;
+    std::array<float, 3> z;
+    for (int i = 0; i < 3; i++) {
+        if (clip[i]->z < 0.0f || clip[i]->w <= 0.0f) {
+            return false;
+        }
+        x[i] = (clip[i]->x / clip[i]->w * 0.5f + 0.5f) * m_width;
+        y[i] = (0.5f - clip[i]->y / clip[i]->w * 0.5f) * m_height;
+        z[i] = clip[i]->z / clip[i]->w;
+    }
+
+    float minX = std::min({ x[0], x[1], x[2] });
+    float maxX = std::max({ x[0], x[1], x[2] });
+    float minY = std::min({ y[0], y[1], y[2] });
+    float maxY = std::max({ y[0], y[1], y[2] });
+    if (maxX < 0.0f || minX >= m_width || maxY < 0.0f || minY >= m_height) {
+        return false;
+    }
+
+    // Twice the signed area. Both windings are occluders.
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f) {
+        return false;
+    }
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+
+    // Edge i goes from vertex i to vertex i + 1. It is positive on the side of the
+    // third vertex for positive areas. The edges are evaluated at pixel centers,
+    // but moved inwards by half a pixel: an edge function changes by at most
+    // (|a| + |b|) / 2 between the center and the corners, so only pixels that the
+    // triangle covers completely pass.
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3;
+        triangle.edgeA[i] = sign * (y[i] - y[j]);
+        triangle.edgeB[i] = sign * (x[j] - x[i]);
+        triangle.edgeC[i] = sign * (x[i] * y[j] - y[i] * x[j]) -
+            0.5f * (fabsf(triangle.edgeA[i]) + fabsf(triangle.edgeB[i]));
+    }
+
+    // z/w is linear in screen space. Likewise, the depth at the center is moved to
+    // the farthest depth of the triangle inside of the pixel.
+    triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) /
+        area;
+    triangle.depthB = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) /
+        area;
+    triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0] +
+        0.5f * (fabsf(triangle.depthA) + fabsf(triangle.depthB));
+
+    // Pixels that may be covered.
+    triangle.minX = static_cast<UINT16>(std::max(0.0f, std::floor(minX)));
+    triangle.maxX = static_cast<UINT16>(std::min(m_width - 1.0f, std::floor(maxX)));
+    triangle.minY = static_cast<UINT16>(std::max(0.0f, std::floor(minY)));
+    triangle.maxY = static_cast<UINT16>(std::min(m_height - 1.0f, std::floor(maxY)));
+    return true;
+}
+
+
+/*
+ * OcclusionCuller::rasterizeTile
+ */
+void OcclusionCuller::rasterizeTile(UINT32 tile) {
+    UINT32 tileX0 = (tile % m_tilesX) * TILE_WIDTH;
+    UINT32 tileY0 = (tile / m_tilesX) * TILE_HEIGHT;
+    if (m_path == Path::AVX2) {
+        rasterizeTileAvx2(tile, tileX0, tileY0);
+    } else {
+        rasterizeTileScalar(tile, tileX0, tileY0);
+    }
+
+    float maxDepth = 0.0f;
+    for (UINT32 y = tileY0; y < tileY0 + TILE_HEIGHT; y++) {
+        const float* row = &m_depth[static_cast<size_t>(y) * m_width];
+        for (UINT32 x = tileX0; x < tileX0 + TILE_WIDTH; x++) {
+            maxDepth = std::max(maxDepth, row[x]);
+        }
+    }
+    m_tileMaxDepths[tile] = maxDepth;
+}
+
+
+/*
+ * OcclusionCuller::rasterizeTileScalar
+ */
+void OcclusionCuller::rasterizeTileScalar(UINT32 tile, UINT32 tileX0, UINT32 tileY0) {
+    for (UINT32 triangleIdx : m_tileBins[tile]) {
+        const Triangle& tri = m_triangles[triangleIdx];
+        UINT32 x0 = std::max<UINT32>(tri.minX, tileX0);
+        UINT32 x1 = std::min<UINT32>(tri.maxX, tileX0 + TILE_WIDTH - 1);
+        UINT32 y0 = std::max<UINT32>(tri.minY, tileY0);
+        UINT32 y1 = std::min<UINT32>(tri.maxY, tileY0 + TILE_HEIGHT - 1);
+
+        for (UINT32 y = y0; y <= y1; y++) {
+            float py = float(y) + 0.5f;
+            float* row = &m_depth[static_cast<size_t>(y) * m_width];
+            for (UINT32 x = x0; x <= x1; x++) {
+                // Pixel center.
+                float px = float(x) + 0.5f;
+                float edge0 = tri.edgeA[0] * px + tri.edgeB[0] * py + tri.edgeC[0];
+                float edge1 = tri.edgeA[1] * px + tri.edgeB[1] * py + tri.edgeC[1];
+                float edge2 = tri.edgeA[2] * px + tri.edgeB[2] * py + tri.edgeC[2];
+                if (edge0 < 0.0f || edge1 < 0.0f || edge2 < 0.0f) {
+                    continue;
+                }
+                float depth = tri.depthA * px + tri.depthB * py + tri.depthC;
+                if (depth < row[x]) {
+                    row[x] = depth;
+                }
+            }
+        }
+    }
+}
+
+
+/*
+ * OcclusionCuller::rasterizeTileAvx2
+ */
+AVX2_FUNCTION
+void OcclusionCuller::rasterizeTileAvx2(UINT32 tile, UINT32 tileX0, UINT32 tileY0) {
+    // Pixel centers of 8 neighbours and their offsets.
+    const __m256 centerOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f,
+        6.5f, 7.5f);
+    const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 zero = _mm256_setzero_ps();
+
+    for (UINT32 triangleIdx : m_tileBins[tile]) {
+        const Triangle& tri = m_triangles[triangleIdx];
+        UINT32 x0 = std::max<UINT32>(tri.minX, tileX0);
+        UINT32 x1 = std::min<UINT32>(tri.maxX, tileX0 + TILE_WIDTH - 1);
+        UINT32 y0 = std::max<UINT32>(tri.minY, tileY0);
+        UINT32 y1 = std::min<UINT32>(tri.maxY, tileY0 + TILE_HEIGHT - 1);
+
+        __m256 edgeA[3], edgeB[3], edgeC[3];
+        for (int i = 0; i < 3; i++) {
+            edgeA[i] = _mm256_set1_ps(tri.edgeA[i]);
+            edgeB[i] = _mm256_set1_ps(tri.edgeB[i]);
+            edgeC[i] = _mm256_set1_ps(tri.edgeC[i]);
+        }
+        __m256 depthA = _mm256_set1_ps(tri.depthA);
+        __m256 depthB = _mm256_set1_ps(tri.depthB);
+        __m256 depthC = _mm256_set1_ps(tri.depthC);
+
+        // Lanes outside of the bounding rectangle are masked, the scalar path does
+        // not visit them either.
+        __m256i rangeMin = _mm256_set1_epi32(static_cast<int>(x0) - 1);
+        __m256i rangeMax = _mm256_set1_epi32(static_cast<int>(x1) + 1);
+        UINT32 groupX0 = x0 & ~7u;  // Tiles start at multiples of 8.
+
+        for (UINT32 y = y0; y <= y1; y++) {
+            __m256 py = _mm256_set1_ps(float(y) + 0.5f);
+            float* row = &m_depth[static_cast<size_t>(y) * m_width];
+            for (UINT32 x = groupX0; x <= x1; x += 8) {
+                __m256 px = _mm256_add_ps(_mm256_set1_ps(float(x)), centerOffsets);
+                __m256i lanes = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(x)),
+                    laneOffsets);
+                __m256 inside = _mm256_castsi256_ps(_mm256_and_si256(
+                    _mm256_cmpgt_epi32(lanes, rangeMin),
+                    _mm256_cmpgt_epi32(rangeMax, lanes)));
+
+                // Same order of operations as the scalar path.
+                for (int i = 0; i < 3; i++) {
+                    __m256 edge = _mm256_add_ps(_mm256_add_ps(
+                        _mm256_mul_ps(edgeA[i], px), _mm256_mul_ps(edgeB[i], py)),
+                        edgeC[i]);
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge, zero, _CMP_GE_OQ));
+                }
+                if (_mm256_movemask_ps(inside) == 0) {
+                    continue;
+                }
+
+                __m256 depth = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(depthA, px),
+                    _mm256_mul_ps(depthB, py)), depthC);
+                __m256 bufferDepth = _mm256_loadu_ps(row + x);
+                __m256 write = _mm256_and_ps(inside,
+                    _mm256_cmp_ps(depth, bufferDepth, _CMP_LT_OQ));
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(bufferDepth, depth, write));
+            }
+        }
+    }
+}
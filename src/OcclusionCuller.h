@@ -0,0 +1,166 @@
+#pragma once
+
+/// <summary>
+/// Software depth rasterizer for occlusion culling. Occluder triangles are drawn
+/// into a small depth buffer on the CPU, then bounding boxes are tested against it
+/// before their geometry gets submitted to the GPU.
+/// </summary>
+/// <remarks>
+/// Depth is z/w of D3D (0 near, 1 far), the nearest occluder per pixel is kept.
+/// Triangles are set up once and binned into tiles. Tiles are rasterized in
+/// parallel, each by a single thread, so no synchronization is needed per pixel.
+/// The AVX2 path shades 8 pixels of a row at once and produces exactly the same
+/// buffer as the scalar reference.
+/// Rasterization is conservative: an occluder only writes pixels it covers
+/// completely, with its farthest depth inside of the pixel. A box is therefore
+/// never hidden by a pixel it could be seen through. Triangles that cross the near
+/// plane are clipped.
+/// </remarks>
+class OcclusionCuller {
+public:
+    static const UINT32 TILE_WIDTH = 32;
+    static const UINT32 TILE_HEIGHT = 32;
+
+    /// <summary>
+    /// Implementation of the rasterizer.
+    /// </summary>
+    enum class Path {
+        SCALAR,
+        AVX2
+    };
+
+    /// <summary>
+    /// Constructor.
+    /// </summary>
+    /// <param name="width">Width of the depth buffer. Multiple of TILE_WIDTH.
+    /// </param>
+    /// <param name="height">Height of the depth buffer. Multiple of TILE_HEIGHT.
+    /// </param>
+    OcclusionCuller(UINT32 width = 320, UINT32 height = 192);
+
+    /// <summary>
+    /// Starts a new frame: clears the depth buffer and all occluders.
+    /// </summary>
+    /// <param name="viewProj">View projection matrix of the camera.</param>
+    void BeginFrame(const sm::Matrix& viewProj);
+
+    /// <summary>
+    /// Adds the triangles of an occluder. Only call between BeginFrame() and
+    /// Rasterize().
+    /// </summary>
+    /// <param name="positions">First position. Model space.</param>
+    /// <param name="positionCnt">Number of positions.</param>
+    /// <param name="positionStride">Bytes between two positions.</param>
+    /// <param name="indices">Triangle list.</param>
+    /// <param name="indexCnt">Number of indices.</param>
+    /// <param name="worldMat">Model to world matrix.</param>
+    void AddOccluder(const sm::Vector3* positions, size_t positionCnt,
+        size_t positionStride, const UINT32* indices, size_t indexCnt,
+        const sm::Matrix& worldMat);
+
+    /// <summary>
+    /// Rasterizes all occluders of the frame.
+    /// </summary>
+    void Rasterize();
+
+    /// <summary>
+    /// Tests a box against the rasterized occluders.
+    /// </summary>
+    /// <param name="box">World space bounds.</param>
+    /// <returns>False if the box is completely hidden. True if it may be visible,
+    /// which includes boxes that intersect the near plane or lie off screen.
+    /// </returns>
+    bool TestBox(const dx::BoundingBox& box) const;
+
+    /// <summary>
+    /// Computes the farthest depth over the tiles of a screen of another size. A
+    /// tile gets the maximum of all pixels of the buffer that overlap it. Visible
+    /// surfaces are never behind an occluder, so this bounds every surface of the
+    /// tile in the current frame.
+    /// </summary>
+    /// <param name="screenWidth">Width of the screen in pixels.</param>
+    /// <param name="screenHeight">Height of the screen in pixels.</param>
+    /// <param name="tileSize">Pixels per side of a tile.</param>
+    /// <param name="maxDepth">Receives the depth per tile (row-major, top row first).
+    /// </param>
+    void GetTileMaxDepth(UINT32 screenWidth, UINT32 screenHeight, UINT32 tileSize,
+        std::vector<float>& maxDepth) const;
+
+    /// <summary>
+    /// Selects the rasterizer. AVX2 falls back to SCALAR if not supported.
+    /// </summary>
+    void SetPath(Path path);
+    Path GetPath() const;
+
+    /// <summary>
+    /// Number of threads for rasterizing tiles. 1 rasterizes on the calling thread.
+    /// </summary>
+    void SetThreadCount(UINT32 threadCnt);
+
+    UINT32 GetWidth() const;
+    UINT32 GetHeight() const;
+
+    /// <summary>
+    /// Returns the number of triangles rasterized in the current frame.
+    /// </summary>
+    UINT32 GetTriangleCount() const;
+
+    /// <summary>
+    /// Returns the depth buffer (row-major, top row first).
+    /// </summary>
+    const std::vector<float>& GetDepth() const;
+
+private:
+    /// <summary>
+    /// Triangle in screen space. Edge functions and depth are planes
+    /// a * x + b * y + c over pixel centers. Edges are >= 0 for pixels that the
+    /// triangle covers completely, depth is the farthest one inside of the pixel.
+    /// </summary>
+    struct Triangle {
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        float depthA;
+        float depthB;
+        float depthC;
+        UINT16 minX;
+        UINT16 maxX;
+        UINT16 minY;
+        UINT16 maxY;
+    };
+
+    /// <summary>
+    /// Clips a triangle in clip space against the near plane and adds what is left.
+    /// </summary>
+    void addTriangle(const sm::Vector4& clip0, const sm::Vector4& clip1,
+        const sm::Vector4& clip2);
+
+    /// <summary>
+    /// Computes screen space edges and depth plane of a triangle in clip space.
+    /// </summary>
+    /// <returns>False if the triangle is degenerate, off screen or crosses the near
+    /// plane.</returns>
+    bool setupTriangle(const sm::Vector4& clip0, const sm::Vector4& clip1,
+        const sm::Vector4& clip2, Triangle& triangle) const;
+
+    /// <summary>
+    /// Rasterizes all triangles of a tile and updates its maximum depth.
+    /// </summary>
+    void rasterizeTile(UINT32 tile);
+    void rasterizeTileScalar(UINT32 tile, UINT32 tileX0, UINT32 tileY0);
+    void rasterizeTileAvx2(UINT32 tile, UINT32 tileX0, UINT32 tileY0);
+
+    UINT32 m_width;
+    UINT32 m_height;
+    UINT32 m_tilesX;
+    UINT32 m_tilesY;
+    Path m_path;
+    UINT32 m_threadCnt = 1;
+
+    sm::Matrix m_viewProj;
+    std::vector<float> m_depth;
+    std::vector<float> m_tileMaxDepths;             // For fast rejection in TestBox().
+    std::vector<Triangle> m_triangles;
+    std::vector<sm::Vector4> m_clipPositions;       // Scratch memory of AddOccluder().
+    std::vector<std::vector<UINT32>> m_tileBins;    // Triangles per tile.
+};
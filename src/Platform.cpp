@@ -0,0 +1,310 @@
+#include "stdafx.h"
+#include "Platform.h"
+
+// cpuid and xgetbv.
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <unistd.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+#ifdef _WIN32
+/// <summary>
+/// Returns the name of a session local file mapping.
+/// </summary>
+static std::wstring getMappingName(const std::string& name) {
+    return L"Local\\" + std::wstring(name.begin(), name.end());
+}
+#else
+/// <summary>
+/// Returns the name of a POSIX shared memory object.
+/// </summary>
+static std::string getMappingName(const std::string& name) {
+    return "/" + name;
+}
+#endif
+
+
+/// <summary>
+/// Executes cpuid for a leaf and subleaf.
+/// </summary>
+/// <param name="registers">EAX, EBX, ECX and EDX.</param>
+static void queryCpuid(UINT32 leaf, UINT32 subleaf, std::array<UINT32, 4>& registers) {
+#ifdef _WIN32
+    int cpuInfo[4];
+    __cpuidex(cpuInfo, static_cast<int>(leaf), static_cast<int>(subleaf));
+    memcpy(registers.data(), cpuInfo, sizeof(cpuInfo));
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2],
+        registers[3]);
+#endif
+}
+
+
+/// <summary>
+/// Returns the low half of the extended control register 0, the state components
+/// the OS saves on a context switch.
+/// </summary>
+static UINT64 queryXcr0() {
+#ifdef _WIN32
+    return _xgetbv(0);
+#else
+    UINT32 low = 0;
+    UINT32 high = 0;
+    __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return (static_cast<UINT64>(high) << 32) | low;
+#endif
+}
+
+
+/*
+ * Platform::GetCpuName
+ */
+std::string Platform::GetCpuName() {
+    // Brand string via cpuid leaves 0x80000002-0x80000004.
+    std::array<UINT32, 4> registers = {};
+    char brand[49] = {};
+    queryCpuid(0x80000000, 0, registers);
+    if (registers[0] >= 0x80000004) {
+        for (UINT32 leaf = 0; leaf < 3; leaf++) {
+            queryCpuid(0x80000002 + leaf, 0, registers);
+            memcpy(brand + 16 * leaf, registers.data(), sizeof(registers));
+        }
+    }
+    std::string name = brand;
+    name.erase(0, std::min(name.find_first_not_of(' '), name.size()));
+    return name;
+}
+
+
+/*
+ * Platform::GetPhysicalMemory
+ */
+UINT64 Platform::GetPhysicalMemory() {
+#ifdef _WIN32
+    MEMORYSTATUSEX memoryStatus = {};
+    memoryStatus.dwLength = sizeof(memoryStatus);
+    return GlobalMemoryStatusEx(&memoryStatus) ? memoryStatus.ullTotalPhys : 0;
+#else
+    long pageCnt = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    return pageCnt > 0 && pageSize > 0 ?
+        static_cast<UINT64>(pageCnt) * static_cast<UINT64>(pageSize) : 0;
+#endif
+}
+
+
+/*
+ * Platform::GetCompilerName
+ */
+std::string Platform::GetCompilerName() {
+#if defined(_MSC_FULL_VER)
+    return "MSVC " + std::to_string(_MSC_FULL_VER);
+#elif defined(__clang__)
+    return "Clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "GCC " __VERSION__;
+#else
+    return "unknown";
+#endif
+}
+
+
+/*
+ * Platform::IsAvx2Supported
+ */
+bool Platform::IsAvx2Supported() {
+    static const bool supported = []() {
+        std::array<UINT32, 4> registers;
+        queryCpuid(0, 0, registers);
+        if (registers[0] < 7) {
+            return false;
+        }
+
+        // The OS has to save the YMM registers (OSXSAVE and XCR0 bits 1 and 2).
+        queryCpuid(1, 0, registers);
+        bool osxsave = (registers[2] & (1u << 27)) != 0;
+        bool avx = (registers[2] & (1u << 28)) != 0;
+        if (!osxsave || !avx || (queryXcr0() & 0x6) != 0x6) {
+            return false;
+        }
+
+        queryCpuid(7, 0, registers);
+        return (registers[1] & (1u << 5)) != 0;
+    }();
+    return supported;
+}
+
+
+/*
+ * Platform::ToUtc
+ */
+std::tm Platform::ToUtc(std::time_t time) {
+    std::tm utc = {};
+#ifdef _WIN32
+    gmtime_s(&utc, &time);
+#else
+    gmtime_r(&time, &utc);
+#endif
+    return utc;
+}
+
+
+/*
+ * Platform::AlignedAlloc
+ */
+void* Platform::AlignedAlloc(size_t size, size_t alignment) {
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    // aligned_alloc wants a multiple of the alignment, and at least a pointer.
+    alignment = std::max(alignment, sizeof(void*));
+    size_t alignedSize = (std::max<size_t>(size, 1) + alignment - 1) & ~(alignment - 1);
+    return aligned_alloc(alignment, alignedSize);
+#endif
+}
+
+
+/*
+ * Platform::AlignedFree
+ */
+void Platform::AlignedFree(void* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+
+/*
+ * Platform::CaptureStack
+ */
+unsigned int Platform::CaptureStack(unsigned int skipCnt, unsigned int maxDepth,
+        void** frames) {
+    // Leave out this function as well.
+    skipCnt++;
+#ifdef _WIN32
+    return CaptureStackBackTrace(skipCnt, maxDepth, frames, nullptr);
+#else
+    // backtrace() has no skip count, so capture into a larger buffer first.
+    static const unsigned int MAX_FRAMES = 64;
+    void* allFrames[MAX_FRAMES];
+    int depth = backtrace(allFrames, MAX_FRAMES);
+    unsigned int frameCnt = depth > static_cast<int>(skipCnt) ?
+        std::min(static_cast<unsigned int>(depth) - skipCnt, maxDepth) : 0;
+    std::copy(allFrames + skipCnt, allFrames + skipCnt + frameCnt, frames);
+    return frameCnt;
+#endif
+}
+
+
+/*
+ * Platform::CreateSharedMemory
+ */
+void* Platform::CreateSharedMemory(const std::string& name, size_t size,
+        bool& existed) {
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(static_cast<UINT64>(size) >> 32),
+        static_cast<DWORD>(size), getMappingName(name).c_str());
+    existed = GetLastError() == ERROR_ALREADY_EXISTS;
+    if (!mapping) {
+        return nullptr;
+    }
+    // The view keeps the mapping alive. Fails if an existing mapping is smaller.
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    CloseHandle(mapping);
+    return view;
+#else
+    std::string path = getMappingName(name);
+    int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    existed = fd < 0 && errno == EEXIST;
+    if (existed) {
+        fd = shm_open(path.c_str(), O_RDWR, 0);
+    }
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    bool sized = existed ?
+        fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= size :
+        ftruncate(fd, static_cast<off_t>(size)) == 0;
+    void* view = sized ?
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    return view != MAP_FAILED ? view : nullptr;
+#endif
+}
+
+
+/*
+ * Platform::OpenSharedMemory
+ */
+const void* Platform::OpenSharedMemory(const std::string& name, size_t size) {
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingW(FILE_MAP_READ, FALSE,
+        getMappingName(name).c_str());
+    if (!mapping) {
+        return nullptr;
+    }
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+    CloseHandle(mapping);
+    return view;
+#else
+    int fd = shm_open(getMappingName(name).c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    bool sized = fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= size;
+    void* view = sized ?
+        mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    return view != MAP_FAILED ? view : nullptr;
+#endif
+}
+
+
+/*
+ * Platform::CloseSharedMemory
+ */
+void Platform::CloseSharedMemory(const void* view, size_t size) {
+    if (!view) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(view);
+#else
+    munmap(const_cast<void*>(view), size);
+#endif
+}
+
+
+/*
+ * Platform::RemoveSharedMemory
+ */
+void Platform::RemoveSharedMemory(const std::string& name) {
+#ifndef _WIN32
+    shm_unlink(getMappingName(name).c_str());
+#endif
+}
+
+
+/*
+ * Platform::AttachParentConsole
+ */
+void Platform::AttachParentConsole() {
+#ifdef _WIN32
+    FILE* console = nullptr;
+    if (AttachConsole(ATTACH_PARENT_PROCESS)) {
+        freopen_s(&console, "CONOUT$", "w", stdout);
+    }
+#endif
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+// Outside of Windows, the Win32 functions that the portable code uses. The Win32
+// types come from the WSL adapter of DirectX-Headers (see stdafx.h).
+#ifndef _WIN32
+/// <summary>
+/// Writes to stderr, where the debugger output goes on Windows.
+/// </summary>
+inline void OutputDebugStringA(const char* text) {
+    fputs(text, stderr);
+}
+
+/// <summary>
+/// Finds the lowest set bit. Returns 0 if mask is 0.
+/// </summary>
+inline unsigned char _BitScanForward(unsigned long* index, unsigned long mask) {
+    if (mask == 0) {
+        return 0;
+    }
+    *index = static_cast<unsigned long>(__builtin_ctzl(mask));
+    return 1;
+}
+#endif
+
+// Marks a function that uses AVX2 and FMA intrinsics. MSVC compiles these without
+// a flag, GCC and Clang need the target per function so that the rest of the file
+// still runs on CPUs without AVX2.
+#ifdef _MSC_VER
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2,fma")))
+#endif
+
+
+/// <summary>
+/// The operating system and CPU queries of the benchmarks and the culling and
+/// lighting cores, so that these do not depend on Windows.
+/// </summary>
+/// <remarks>
+/// Implemented for Win32 and POSIX on x86.
+/// </remarks>
+class Platform {
+public:
+    /// <summary>
+    /// Returns the brand string of the CPU, empty if unknown.
+    /// </summary>
+    static std::string GetCpuName();
+
+    /// <summary>
+    /// Returns the installed memory in bytes, 0 if unknown.
+    /// </summary>
+    static UINT64 GetPhysicalMemory();
+
+    /// <summary>
+    /// Returns name and version of the compiler this was built with.
+    /// </summary>
+    static std::string GetCompilerName();
+
+    /// <summary>
+    /// Returns true if the CPU and OS support AVX2.
+    /// </summary>
+    static bool IsAvx2Supported();
+
+    /// <summary>
+    /// Converts a time into UTC calendar time.
+    /// </summary>
+    static std::tm ToUtc(std::time_t time);
+
+    /// <summary>
+    /// Allocates memory with the given alignment, bypassing operator new. Returns
+    /// nullptr on failure. Has to be released with AlignedFree().
+    /// </summary>
+    /// <param name="alignment">Power of two.</param>
+    static void* AlignedAlloc(size_t size, size_t alignment);
+
+    /// <summary>
+    /// Releases memory of AlignedAlloc(). Does nothing for nullptr.
+    /// </summary>
+    static void AlignedFree(void* ptr);
+
+    /// <summary>
+    /// Writes the return addresses of the calling thread's stack to frames.
+    /// </summary>
+    /// <remarks>
+    /// The first call on POSIX may allocate while the unwinder is loaded.
+    /// </remarks>
+    /// <param name="skipCnt">Number of innermost frames to leave out, not counting
+    /// this function.</param>
+    /// <returns>Number of frames written, at most maxDepth.</returns>
+    static unsigned int CaptureStack(unsigned int skipCnt, unsigned int maxDepth,
+        void** frames);
+
+    /// <summary>
+    /// Creates named shared memory, or opens it if another process created it, and
+    /// maps it for reading and writing. Memory that was created is zeroed.
+    /// </summary>
+    /// <param name="name">ASCII name without slashes. Local to the user session on
+    /// Windows.</param>
+    /// <param name="existed">Set to true if the memory existed already.</param>
+    /// <returns>The mapping, nullptr on failure or if existing memory is smaller
+    /// than size.</returns>
+    static void* CreateSharedMemory(const std::string& name, size_t size,
+        bool& existed);
+
+    /// <summary>
+    /// Maps existing named shared memory for reading.
+    /// </summary>
+    /// <returns>The mapping, nullptr if there is no memory of at least size bytes
+    /// under the name.</returns>
+    static const void* OpenSharedMemory(const std::string& name, size_t size);
+
+    /// <summary>
+    /// Unmaps memory of CreateSharedMemory() or OpenSharedMemory().
+    /// </summary>
+    static void CloseSharedMemory(const void* view, size_t size);
+
+    /// <summary>
+    /// Removes the name of shared memory, so it goes away once the last process
+    /// unmapped it. Windows does that by itself, POSIX keeps the memory until then.
+    /// </summary>
+    static void RemoveSharedMemory(const std::string& name);
+
+    /// <summary>
+    /// Sends stdout to the console the process was started from. Windows GUI
+    /// applications have none of their own.
+    /// </summary>
+    static void AttachParentConsole();
+};
+
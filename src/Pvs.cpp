@@ -0,0 +1,849 @@
+#include "stdafx.h"
+#include "Pvs.h"
+#include "TaskGraph.h"
+#include "WorkerPool.h"
+
+// Mesh ID of pixels that no occluder covers.
+static const UINT32 NO_MESH = UINT32_MAX;
+
+// File header.
+static const char PVS_MAGIC[4] = { 'P', 'V', 'S', '2' };
+
+// FNV-1a.
+static const UINT64 HASH_OFFSET = 14695981039346656037ull;
+static const UINT64 HASH_PRIME = 1099511628211ull;
+
+
+/*
+ * writeValue
+ */
+template<typename T>
+static void writeValue(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+/*
+ * readValue
+ */
+template<typename T>
+static T readValue(std::ifstream& file) {
+    T value = {};
+    file.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return value;
+}
+
+
+/*
+ * hashBytes
+ */
+static void hashBytes(UINT64& hash, const void* data, size_t size) {
+    const UINT8* bytes = static_cast<const UINT8*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * HASH_PRIME;
+    }
+}
+
+
+/*
+ * hashValue
+ */
+template<typename T>
+static void hashValue(UINT64& hash, const T& value) {
+    hashBytes(hash, &value, sizeof(T));
+}
+
+
+/*
+ * Pvs::AddMesh
+ */
+UINT32 Pvs::AddMesh(const sm::Vector3* positions, size_t positionCnt,
+        size_t positionStride, const UINT32* indices, size_t indexCnt,
+        const sm::Matrix& worldMat, bool isOccluder) {
+    BakeMesh mesh;
+    mesh.positions.resize(positionCnt);
+    const UINT8* position = reinterpret_cast<const UINT8*>(positions);
+    for (size_t i = 0; i < positionCnt; i++) {
+        mesh.positions[i] = sm::Vector3::Transform(
+            *reinterpret_cast<const sm::Vector3*>(position + i * positionStride),
+            worldMat);
+    }
+    mesh.indices.assign(indices, indices + indexCnt);
+    dx::BoundingBox::CreateFromPoints(mesh.bounds, mesh.positions.size(),
+        mesh.positions.data(), sizeof(sm::Vector3));
+    mesh.isOccluder = isOccluder;
+    m_meshes.push_back(std::move(mesh));
+    return static_cast<UINT32>(m_meshes.size() - 1);
+}
+
+
+/*
+ * Pvs::ClearMeshes
+ */
+void Pvs::ClearMeshes() {
+    m_meshes.clear();
+    m_meshes.shrink_to_fit();
+}
+
+
+/*
+ * Pvs::Bake
+ */
+void Pvs::Bake(const Settings& settings) {
+    assert(settings.cellSize > 0.0f && settings.resolution > 0);
+    m_resolution = settings.resolution;
+    m_nearPlane = settings.nearPlane;
+    m_erosion = settings.erosion;
+    m_meshCnt = static_cast<UINT32>(m_meshes.size());
+    m_hash = ComputeHash(settings);
+
+    // Grid over the navigable volume.
+    dx::BoundingBox sceneBounds(sm::Vector3::Zero, sm::Vector3::Zero);
+    for (size_t i = 0; i < m_meshes.size(); i++) {
+        if (i == 0) {
+            sceneBounds = m_meshes[i].bounds;
+        } else {
+            dx::BoundingBox::CreateMerged(sceneBounds, sceneBounds, m_meshes[i].bounds);
+        }
+    }
+    sm::Vector3 volumeExtents = settings.volume.Extents;
+    dx::BoundingBox volume = volumeExtents == sm::Vector3::Zero ? sceneBounds :
+        settings.volume;
+    m_cellSize = settings.cellSize;
+    m_gridMin = sm::Vector3(volume.Center) - sm::Vector3(volume.Extents);
+    std::array<float, 3> extents = { volume.Extents.x, volume.Extents.y,
+        volume.Extents.z };
+    for (UINT32 axis = 0; axis < 3; axis++) {
+        m_gridSize[axis] = std::max(1u,
+            static_cast<UINT32>(std::ceil(2.0f * extents[axis] / m_cellSize)));
+    }
+
+    // Everything is seen from everywhere within the far plane.
+    dx::BoundingBox allBounds;
+    dx::BoundingBox::CreateMerged(allBounds, sceneBounds, volume);
+    m_farPlane = 2.0f * sm::Vector3(allBounds.Extents).Length() + m_cellSize +
+        m_nearPlane;
+
+    // Corners of the cells first, every corner is shared by up to 8 cells. Then the
+    // cells, which add their inner viewpoints. Threads take the next free item.
+    std::array<UINT32, 3> cornerGridSize = { m_gridSize[0] + 1, m_gridSize[1] + 1,
+        m_gridSize[2] + 1 };
+    UINT32 cornerCnt = cornerGridSize[0] * cornerGridSize[1] * cornerGridSize[2];
+    UINT32 cellCnt = m_gridSize[0] * m_gridSize[1] * m_gridSize[2];
+    size_t wordCnt = (m_meshCnt + 63) / 64;
+    std::vector<std::vector<UINT64>> cornerVisible(cornerCnt);
+    std::vector<std::vector<UINT64>> cellVisible(cellCnt);
+    std::atomic<UINT32> nextItem = 0;
+    auto bakeCorner = [&](UINT32 corner, View& view) {
+        UINT32 x = corner % cornerGridSize[0];
+        UINT32 y = corner / cornerGridSize[0] % cornerGridSize[1];
+        UINT32 z = corner / (cornerGridSize[0] * cornerGridSize[1]);
+        cornerVisible[corner].assign(wordCnt, 0);
+        bakePoint(m_gridMin + sm::Vector3(float(x), float(y), float(z)) * m_cellSize,
+            view, cornerVisible[corner]);
+    };
+    auto bakeCell = [&](UINT32 cell, View& view) {
+        std::vector<UINT64>& visible = cellVisible[cell];
+        visible.assign(wordCnt, 0);
+        UINT32 x = cell % m_gridSize[0];
+        UINT32 y = cell / m_gridSize[0] % m_gridSize[1];
+        UINT32 z = cell / (m_gridSize[0] * m_gridSize[1]);
+        for (UINT32 corner = 0; corner < 8; corner++) {
+            UINT32 cornerIdx = x + (corner & 1) + cornerGridSize[0] *
+                (y + ((corner >> 1) & 1) + cornerGridSize[1] * (z + (corner >> 2)));
+            for (size_t word = 0; word < wordCnt; word++) {
+                visible[word] |= cornerVisible[cornerIdx][word];
+            }
+        }
+
+        // The camera may be inside of these.
+        dx::BoundingBox cellBounds = GetCellBounds(cell);
+        for (UINT32 mesh = 0; mesh < m_meshCnt; mesh++) {
+            if (m_meshes[mesh].bounds.Intersects(cellBounds)) {
+                visible[mesh / 64] |= UINT64(1) << (mesh % 64);
+            }
+        }
+
+        // Center, then random points.
+        std::default_random_engine generator(settings.seed + cell);
+        std::uniform_real_distribution<float> randomFloats(-1.0f, 1.0f);
+        for (UINT32 sample = 0; sample < settings.innerSampleCnt; sample++) {
+            sm::Vector3 offset = sample == 0 ? sm::Vector3::Zero :
+                sm::Vector3(randomFloats(generator), randomFloats(generator),
+                    randomFloats(generator));
+            bakePoint(sm::Vector3(cellBounds.Center) +
+                offset * sm::Vector3(cellBounds.Extents), view, visible);
+        }
+    };
+    auto bakeItems = [&](UINT32 itemCnt,
+            const std::function<void(UINT32, View&)>& bakeItem) {
+        View view;
+        view.depth.resize(size_t(m_resolution) * m_resolution);
+        view.ids.resize(size_t(m_resolution) * m_resolution);
+        for (UINT32 item = nextItem++; item < itemCnt; item = nextItem++) {
+            bakeItem(item, view);
+        }
+    };
+
+    UINT32 threadCnt = settings.threadCnt ? settings.threadCnt :
+        WorkerPool::Get().GetWorkerCount() + 1;
+    TaskGraph graph;
+    std::vector<unsigned int> cornerTasks;
+    for (UINT32 i = 0; i < threadCnt; i++) {
+        cornerTasks.push_back(graph.AddTask("Pvs::bakeCorners", [&]() {
+            bakeItems(cornerCnt, bakeCorner);
+        }));
+    }
+    unsigned int resetTask = graph.AddTask("Pvs::resetItems", [&]() {
+        nextItem = 0;
+    }, cornerTasks);
+    for (UINT32 i = 0; i < threadCnt; i++) {
+        graph.AddTask("Pvs::bakeCells", [&]() {
+            bakeItems(cellCnt, bakeCell);
+        }, { resetTask });
+    }
+    graph.Run(threadCnt);
+    dilateSets(settings.dilation, cellVisible);
+
+    // Encode and share the sets.
+    m_setData.clear();
+    m_setOffsets.assign(1, 0);
+    m_cellSets.resize(cellCnt);
+    std::unordered_map<std::string, UINT32> setLookup;
+    for (UINT32 cell = 0; cell < cellCnt; cell++) {
+        m_cellSets[cell] = addSet(cellVisible[cell], setLookup);
+    }
+}
+
+
+/*
+ * Pvs::ComputeHash
+ */
+UINT64 Pvs::ComputeHash(const Settings& settings) const {
+    UINT64 hash = HASH_OFFSET;
+    hashValue(hash, static_cast<UINT32>(m_meshes.size()));
+    for (const BakeMesh& mesh : m_meshes) {
+        hashValue(hash, static_cast<UINT32>(mesh.positions.size()));
+        hashBytes(hash, mesh.positions.data(), mesh.positions.size() *
+            sizeof(sm::Vector3));
+        hashValue(hash, static_cast<UINT32>(mesh.indices.size()));
+        hashBytes(hash, mesh.indices.data(), mesh.indices.size() * sizeof(UINT32));
+        hashValue(hash, mesh.isOccluder);
+    }
+
+    // Everything but the thread count changes the grid or the sets.
+    hashValue(hash, settings.volume.Center);
+    hashValue(hash, settings.volume.Extents);
+    hashValue(hash, settings.cellSize);
+    hashValue(hash, settings.innerSampleCnt);
+    hashValue(hash, settings.resolution);
+    hashValue(hash, settings.erosion);
+    hashValue(hash, settings.dilation);
+    hashValue(hash, settings.nearPlane);
+    hashValue(hash, settings.seed);
+    return hash;
+}
+
+
+/*
+ * Pvs::GetHash
+ */
+UINT64 Pvs::GetHash() const {
+    return m_hash;
+}
+
+
+/*
+ * Pvs::IsBaked
+ */
+bool Pvs::IsBaked() const {
+    return !m_cellSets.empty();
+}
+
+
+/*
+ * Pvs::FindCell
+ */
+UINT32 Pvs::FindCell(const sm::Vector3& position) const {
+    if (m_cellSets.empty()) {
+        return NO_CELL;
+    }
+    sm::Vector3 gridPos = (position - m_gridMin) / m_cellSize;
+    std::array<float, 3> coords = { gridPos.x, gridPos.y, gridPos.z };
+    UINT32 cell = 0;
+    for (int axis = 2; axis >= 0; axis--) {
+        if (!(coords[axis] >= 0.0f && coords[axis] < float(m_gridSize[axis]))) {
+            return NO_CELL;
+        }
+        UINT32 coord = std::min(m_gridSize[axis] - 1,
+            static_cast<UINT32>(coords[axis]));
+        cell = cell * m_gridSize[axis] + coord;
+    }
+    return cell;
+}
+
+
+/*
+ * Pvs::GetVisibleMeshes
+ */
+void Pvs::GetVisibleMeshes(UINT32 cell, std::vector<UINT32>& meshes) const {
+    meshes.clear();
+    UINT32 set = m_cellSets[cell];
+    const UINT8* data = m_setData.data() + m_setOffsets[set];
+    const UINT8* end = m_setData.data() + m_setOffsets[set + 1];
+
+    // Runs alternate between hidden and visible, starting with hidden.
+    UINT32 mesh = 0;
+    bool isVisible = false;
+    while (data < end) {
+        UINT32 run = 0;
+        for (UINT32 shift = 0; data < end; shift += 7) {
+            UINT8 byte = *data++;
+            run |= UINT32(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        if (isVisible) {
+            for (UINT32 i = 0; i < run; i++) {
+                meshes.push_back(mesh + i);
+            }
+        }
+        mesh += run;
+        isVisible = !isVisible;
+    }
+}
+
+
+/*
+ * Pvs::GetCellBounds
+ */
+dx::BoundingBox Pvs::GetCellBounds(UINT32 cell) const {
+    UINT32 x = cell % m_gridSize[0];
+    UINT32 y = cell / m_gridSize[0] % m_gridSize[1];
+    UINT32 z = cell / (m_gridSize[0] * m_gridSize[1]);
+    sm::Vector3 center = m_gridMin +
+        (sm::Vector3(float(x), float(y), float(z)) + sm::Vector3(0.5f)) * m_cellSize;
+    return dx::BoundingBox(center, sm::Vector3(0.5f * m_cellSize));
+}
+
+
+/*
+ * Pvs::GetCellCount
+ */
+UINT32 Pvs::GetCellCount() const {
+    return static_cast<UINT32>(m_cellSets.size());
+}
+
+
+/*
+ * Pvs::GetMeshCount
+ */
+UINT32 Pvs::GetMeshCount() const {
+    return m_meshCnt;
+}
+
+
+/*
+ * Pvs::GetSetCount
+ */
+UINT32 Pvs::GetSetCount() const {
+    return m_setOffsets.empty() ? 0 : static_cast<UINT32>(m_setOffsets.size() - 1);
+}
+
+
+/*
+ * Pvs::GetCompressedSize
+ */
+size_t Pvs::GetCompressedSize() const {
+    return m_setData.size() + m_setOffsets.size() * sizeof(UINT32) +
+        m_cellSets.size() * sizeof(UINT32);
+}
+
+
+/*
+ * Pvs::Save
+ */
+void Pvs::Save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::invalid_argument("Could not open " + path + " for writing.");
+    }
+
+    file.write(PVS_MAGIC, sizeof(PVS_MAGIC));
+    writeValue(file, m_meshCnt);
+    writeValue(file, m_hash);
+    writeValue(file, m_gridMin);
+    writeValue(file, m_cellSize);
+    writeValue(file, m_gridSize);
+    writeValue(file, static_cast<UINT32>(m_setOffsets.size()));
+    file.write(reinterpret_cast<const char*>(m_setOffsets.data()),
+        m_setOffsets.size() * sizeof(UINT32));
+    file.write(reinterpret_cast<const char*>(m_setData.data()), m_setData.size());
+    file.write(reinterpret_cast<const char*>(m_cellSets.data()),
+        m_cellSets.size() * sizeof(UINT32));
+    if (!file.good()) {
+        throw std::invalid_argument("Could not write " + path + ".");
+    }
+}
+
+
+/*
+ * Pvs::Load
+ */
+void Pvs::Load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::invalid_argument("Could not open " + path + ".");
+    }
+
+    char magic[sizeof(PVS_MAGIC)] = {};
+    file.read(magic, sizeof(magic));
+    if (!file.good() || memcmp(magic, PVS_MAGIC, sizeof(PVS_MAGIC)) != 0) {
+        throw std::invalid_argument(path + " is not a PVS file.");
+    }
+    UINT32 meshCnt = readValue<UINT32>(file);
+    UINT64 hash = readValue<UINT64>(file);
+    sm::Vector3 gridMin = readValue<sm::Vector3>(file);
+    float cellSize = readValue<float>(file);
+    std::array<UINT32, 3> gridSize = readValue<std::array<UINT32, 3>>(file);
+    UINT32 offsetCnt = readValue<UINT32>(file);
+    UINT64 cellCnt = UINT64(gridSize[0]) * gridSize[1] * gridSize[2];
+    if (!file.good() || !(cellSize > 0.0f) || offsetCnt == 0 || cellCnt == 0 ||
+            cellCnt > UINT32_MAX) {
+        throw std::invalid_argument(path + " is corrupt.");
+    }
+
+    std::vector<UINT32> setOffsets(offsetCnt);
+    file.read(reinterpret_cast<char*>(setOffsets.data()), offsetCnt * sizeof(UINT32));
+    std::vector<UINT8> setData(file.good() ? setOffsets.back() : 0);
+    file.read(reinterpret_cast<char*>(setData.data()), setData.size());
+    std::vector<UINT32> cellSets(static_cast<size_t>(cellCnt));
+    file.read(reinterpret_cast<char*>(cellSets.data()), cellSets.size() * sizeof(UINT32));
+    bool isValid = file.good() && setOffsets[0] == 0 &&
+        std::is_sorted(setOffsets.begin(), setOffsets.end()) &&
+        std::all_of(cellSets.begin(), cellSets.end(),
+            [offsetCnt](UINT32 set) { return set + 1 < offsetCnt; });
+    if (!isValid) {
+        throw std::invalid_argument(path + " is corrupt.");
+    }
+
+    m_meshCnt = meshCnt;
+    m_hash = hash;
+    m_gridMin = gridMin;
+    m_cellSize = cellSize;
+    m_gridSize = gridSize;
+    m_setOffsets = std::move(setOffsets);
+    m_setData = std::move(setData);
+    m_cellSets = std::move(cellSets);
+}
+
+
+/*
+ * Pvs::bakePoint
+ */
+void Pvs::bakePoint(const sm::Vector3& eye, View& view,
+        std::vector<UINT64>& visible) const {
+    // Six 90 degree views cover all directions.
+    static const std::array<std::pair<sm::Vector3, sm::Vector3>, 6> faces = {
+        std::make_pair(sm::Vector3::UnitX, sm::Vector3::UnitY),
+        std::make_pair(-sm::Vector3::UnitX, sm::Vector3::UnitY),
+        std::make_pair(sm::Vector3::UnitY, sm::Vector3::UnitZ),
+        std::make_pair(-sm::Vector3::UnitY, sm::Vector3::UnitZ),
+        std::make_pair(sm::Vector3::UnitZ, sm::Vector3::UnitY),
+        std::make_pair(-sm::Vector3::UnitZ, sm::Vector3::UnitY) };
+    sm::Matrix projMat = sm::Matrix::CreatePerspectiveFieldOfView(dx::XM_PIDIV2, 1.0f,
+        m_nearPlane, m_farPlane);
+    for (const auto& face : faces) {
+        sm::Matrix viewMat = sm::Matrix::CreateLookAt(eye, eye + face.first,
+            face.second);
+        bakeFace(viewMat * projMat, view, visible);
+    }
+}
+
+
+/*
+ * Pvs::bakeFace
+ */
+void Pvs::bakeFace(const sm::Matrix& viewProj, View& view,
+        std::vector<UINT64>& visible) const {
+    std::fill(view.depth.begin(), view.depth.end(), 1.0f);
+    std::fill(view.ids.begin(), view.ids.end(), NO_MESH);
+
+    // Meshes in the frustum. Occluders always, they may hide others.
+    view.candidates.clear();
+    view.smallMeshes.clear();
+    float resolution = float(m_resolution);
+    for (UINT32 mesh = 0; mesh < m_meshCnt; mesh++) {
+        bool isVisible = (visible[mesh / 64] >> (mesh % 64)) & 1;
+        if (isVisible && !m_meshes[mesh].isOccluder) {
+            continue;
+        }
+
+        std::array<sm::Vector3, 8> corners;
+        m_meshes[mesh].bounds.GetCorners(corners.data());
+        UINT32 outsideAll = 0x3F;
+        bool crossesNear = false;
+        float minX = FLT_MAX;
+        float maxX = -FLT_MAX;
+        float minY = FLT_MAX;
+        float maxY = -FLT_MAX;
+        float minW = FLT_MAX;
+        for (const sm::Vector3& corner : corners) {
+            sm::Vector4 clip = sm::Vector4::Transform(
+                sm::Vector4(corner.x, corner.y, corner.z, 1.0f), viewProj);
+            minW = std::min(minW, clip.w);
+            UINT32 outside = (clip.x < -clip.w ? 1 : 0) | (clip.x > clip.w ? 2 : 0) |
+                (clip.y < -clip.w ? 4 : 0) | (clip.y > clip.w ? 8 : 0) |
+                (clip.z < 0.0f ? 16 : 0) | (clip.z > clip.w ? 32 : 0);
+            outsideAll &= outside;
+            if (clip.z < 0.0f) {
+                crossesNear = true;
+            } else {
+                minX = std::min(minX, clip.x / clip.w * 0.5f * resolution);
+                maxX = std::max(maxX, clip.x / clip.w * 0.5f * resolution);
+                minY = std::min(minY, clip.y / clip.w * 0.5f * resolution);
+                maxY = std::max(maxY, clip.y / clip.w * 0.5f * resolution);
+            }
+        }
+        if (outsideAll) {
+            continue;
+        }
+        if (crossesNear && !isVisible) {
+            // Eye (almost) inside of the bounds.
+            visible[mesh / 64] |= UINT64(1) << (mesh % 64);
+            isVisible = true;
+        }
+        if (!crossesNear && !isVisible && std::min(maxX - minX, maxY - minY) < 2.0f) {
+            view.smallMeshes.push_back(mesh);
+        }
+        view.candidates.push_back(std::make_pair(minW, mesh));
+    }
+
+    // Occluders write depth and ID, front to back. Occluders behind the depth so far
+    // can not leave an ID.
+    std::sort(view.candidates.begin(), view.candidates.end());
+    for (const auto& candidate : view.candidates) {
+        UINT32 mesh = candidate.second;
+        if (m_meshes[mesh].isOccluder && testBounds(mesh, viewProj, view.depth)) {
+            rasterizeMesh(mesh, viewProj, true, view);
+        }
+    }
+    for (UINT32 id : view.ids) {
+        if (id != NO_MESH) {
+            visible[id / 64] |= UINT64(1) << (id % 64);
+        }
+    }
+
+    // The rest only needs a single pixel in front of the eroded occluders.
+    erodeDepth(view);
+    for (const auto& candidate : view.candidates) {
+        UINT32 mesh = candidate.second;
+        bool isVisible = (visible[mesh / 64] >> (mesh % 64)) & 1;
+        if (!isVisible && testBounds(mesh, viewProj, view.testDepth) &&
+                rasterizeMesh(mesh, viewProj, false, view)) {
+            visible[mesh / 64] |= UINT64(1) << (mesh % 64);
+        }
+    }
+
+    // Meshes that may fall between the pixel centers.
+    for (UINT32 mesh : view.smallMeshes) {
+        bool isVisible = (visible[mesh / 64] >> (mesh % 64)) & 1;
+        if (!isVisible && testBounds(mesh, viewProj, view.testDepth)) {
+            visible[mesh / 64] |= UINT64(1) << (mesh % 64);
+        }
+    }
+}
+
+
+/*
+ * Pvs::rasterizeMesh
+ */
+bool Pvs::rasterizeMesh(UINT32 mesh, const sm::Matrix& viewProj, bool writes,
+        View& view) const {
+    const BakeMesh& bakeMesh = m_meshes[mesh];
+    view.clipPositions.resize(bakeMesh.positions.size());
+    for (size_t i = 0; i < bakeMesh.positions.size(); i++) {
+        const sm::Vector3& position = bakeMesh.positions[i];
+        view.clipPositions[i] = sm::Vector4::Transform(
+            sm::Vector4(position.x, position.y, position.z, 1.0f), viewProj);
+    }
+
+    bool passed = false;
+    for (size_t i = 0; i + 2 < bakeMesh.indices.size(); i += 3) {
+        std::array<sm::Vector4, 3> triangle = {
+            view.clipPositions[bakeMesh.indices[i]],
+            view.clipPositions[bakeMesh.indices[i + 1]],
+            view.clipPositions[bakeMesh.indices[i + 2]] };
+
+        // Outside of a frustum plane.
+        UINT32 outsideAll = 0x3F;
+        UINT32 behindCnt = 0;
+        for (const sm::Vector4& v : triangle) {
+            outsideAll &= (v.x < -v.w ? 1 : 0) | (v.x > v.w ? 2 : 0) |
+                (v.y < -v.w ? 4 : 0) | (v.y > v.w ? 8 : 0) |
+                (v.z < 0.0f ? 16 : 0) | (v.z > v.w ? 32 : 0);
+            behindCnt += v.z < 0.0f ? 1 : 0;
+        }
+        if (outsideAll) {
+            continue;
+        }
+
+        if (behindCnt == 0) {
+            passed |= rasterizeTriangle(triangle[0], triangle[1], triangle[2], mesh,
+                writes, view);
+        } else {
+            // Clip against the near plane (z = 0), which leaves 3 or 4 vertices.
+            std::array<sm::Vector4, 4> polygon;
+            UINT32 vertexCnt = 0;
+            for (UINT32 j = 0; j < 3; j++) {
+                const sm::Vector4& a = triangle[j];
+                const sm::Vector4& b = triangle[(j + 1) % 3];
+                if (a.z >= 0.0f) {
+                    polygon[vertexCnt++] = a;
+                }
+                if ((a.z >= 0.0f) != (b.z >= 0.0f)) {
+                    polygon[vertexCnt++] = sm::Vector4::Lerp(a, b, a.z / (a.z - b.z));
+                }
+            }
+            for (UINT32 j = 2; j < vertexCnt; j++) {
+                passed |= rasterizeTriangle(polygon[0], polygon[j - 1], polygon[j],
+                    mesh, writes, view);
+            }
+        }
+        if (passed && !writes) {
+            return true;
+        }
+    }
+    return passed;
+}
+
+
+/*
+ * Pvs::rasterizeTriangle
+ */
+bool Pvs::rasterizeTriangle(const sm::Vector4& v0, const sm::Vector4& v1,
+        const sm::Vector4& v2, UINT32 id, bool writes, View& view) const {
+    // Screen space, y down.
+    float resolution = float(m_resolution);
+    std::array<sm::Vector3, 3> s;
+    const std::array<const sm::Vector4*, 3> clip = { &v0, &v1, &v2 };
+    for (UINT32 i = 0; i < 3; i++) {
+        float invW = 1.0f / clip[i]->w;
+        s[i] = sm::Vector3((clip[i]->x * invW * 0.5f + 0.5f) * resolution,
+            (0.5f - clip[i]->y * invW * 0.5f) * resolution, clip[i]->z * invW);
+    }
+
+    // Both sides are drawn.
+    float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) -
+        (s[1].y - s[0].y) * (s[2].x - s[0].x);
+    if (area == 0.0f) {
+        return false;
+    }
+    if (area < 0.0f) {
+        std::swap(s[1], s[2]);
+        area = -area;
+    }
+
+    float minX = std::max(0.0f, std::floor(std::min({ s[0].x, s[1].x, s[2].x })));
+    float maxX = std::min(resolution - 1.0f,
+        std::ceil(std::max({ s[0].x, s[1].x, s[2].x })));
+    float minY = std::max(0.0f, std::floor(std::min({ s[0].y, s[1].y, s[2].y })));
+    float maxY = std::min(resolution - 1.0f,
+        std::ceil(std::max({ s[0].y, s[1].y, s[2].y })));
+    if (minX > maxX || minY > maxY) {
+        return false;
+    }
+
+    // Edge functions at the first pixel center, stepped per pixel. The weight of a
+    // vertex is the edge function of the opposite edge.
+    std::array<float, 3> rowWeights;
+    std::array<float, 3> stepX;
+    std::array<float, 3> stepY;
+    for (UINT32 i = 0; i < 3; i++) {
+        const sm::Vector3& a = s[(i + 1) % 3];
+        const sm::Vector3& b = s[(i + 2) % 3];
+        stepX[i] = a.y - b.y;
+        stepY[i] = b.x - a.x;
+        rowWeights[i] = (b.x - a.x) * (minY + 0.5f - a.y) -
+            (b.y - a.y) * (minX + 0.5f - a.x);
+    }
+
+    bool passed = false;
+    float invArea = 1.0f / area;
+    std::vector<float>& depth = writes ? view.depth : view.testDepth;
+    for (UINT32 y = UINT32(minY); y <= UINT32(maxY); y++) {
+        std::array<float, 3> weights = rowWeights;
+        for (UINT32 x = UINT32(minX); x <= UINT32(maxX); x++) {
+            if (weights[0] >= 0.0f && weights[1] >= 0.0f && weights[2] >= 0.0f) {
+                float z = (weights[0] * s[0].z + weights[1] * s[1].z +
+                    weights[2] * s[2].z) * invArea;
+                size_t pixel = size_t(y) * m_resolution + x;
+                if (z < depth[pixel]) {
+                    if (!writes) {
+                        return true;
+                    }
+                    depth[pixel] = z;
+                    view.ids[pixel] = id;
+                    passed = true;
+                }
+            }
+            for (UINT32 i = 0; i < 3; i++) {
+                weights[i] += stepX[i];
+            }
+        }
+        for (UINT32 i = 0; i < 3; i++) {
+            rowWeights[i] += stepY[i];
+        }
+    }
+    return passed;
+}
+
+
+/*
+ * Pvs::erodeDepth
+ */
+void Pvs::erodeDepth(View& view) const {
+    // Farthest depth within the erosion radius. Separable, rows first.
+    int radius = static_cast<int>(m_erosion);
+    int resolution = static_cast<int>(m_resolution);
+    view.erodedRows.resize(view.depth.size());
+    view.testDepth.resize(view.depth.size());
+    for (int y = 0; y < resolution; y++) {
+        const float* row = &view.depth[size_t(y) * resolution];
+        for (int x = 0; x < resolution; x++) {
+            int last = std::min(resolution - 1, x + radius);
+            float farthest = 0.0f;
+            for (int i = std::max(0, x - radius); i <= last; i++) {
+                farthest = std::max(farthest, row[i]);
+            }
+            view.erodedRows[size_t(y) * resolution + x] = farthest;
+        }
+    }
+    for (int y = 0; y < resolution; y++) {
+        int last = std::min(resolution - 1, y + radius);
+        for (int x = 0; x < resolution; x++) {
+            float farthest = 0.0f;
+            for (int i = std::max(0, y - radius); i <= last; i++) {
+                farthest = std::max(farthest,
+                    view.erodedRows[size_t(i) * resolution + x]);
+            }
+            view.testDepth[size_t(y) * resolution + x] = farthest;
+        }
+    }
+}
+
+
+/*
+ * Pvs::testBounds
+ */
+bool Pvs::testBounds(UINT32 mesh, const sm::Matrix& viewProj,
+        const std::vector<float>& depth) const {
+    // Screen rectangle and nearest depth of the corners.
+    std::array<sm::Vector3, 8> corners;
+    m_meshes[mesh].bounds.GetCorners(corners.data());
+    float resolution = float(m_resolution);
+    float minX = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float minY = FLT_MAX;
+    float maxY = -FLT_MAX;
+    float minZ = FLT_MAX;
+    for (const sm::Vector3& corner : corners) {
+        sm::Vector4 clip = sm::Vector4::Transform(
+            sm::Vector4(corner.x, corner.y, corner.z, 1.0f), viewProj);
+        if (clip.z < 0.0f) {
+            return true;
+        }
+        float screenX = (clip.x / clip.w * 0.5f + 0.5f) * resolution;
+        float screenY = (0.5f - clip.y / clip.w * 0.5f) * resolution;
+        minX = std::min(minX, screenX);
+        maxX = std::max(maxX, screenX);
+        minY = std::min(minY, screenY);
+        maxY = std::max(maxY, screenY);
+        minZ = std::min(minZ, clip.z / clip.w);
+    }
+    if (maxX < 0.0f || minX >= resolution || maxY < 0.0f || minY >= resolution) {
+        return false;
+    }
+
+    // Visible if in front of the depth of any pixel it touches.
+    UINT32 x0 = static_cast<UINT32>(std::max(0.0f, std::floor(minX)));
+    UINT32 x1 = static_cast<UINT32>(std::min(resolution - 1.0f, std::floor(maxX)));
+    UINT32 y0 = static_cast<UINT32>(std::max(0.0f, std::floor(minY)));
+    UINT32 y1 = static_cast<UINT32>(std::min(resolution - 1.0f, std::floor(maxY)));
+    for (UINT32 y = y0; y <= y1; y++) {
+        for (UINT32 x = x0; x <= x1; x++) {
+            if (minZ < depth[size_t(y) * m_resolution + x]) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+/*
+ * Pvs::dilateSets
+ */
+void Pvs::dilateSets(UINT32 dilation,
+        std::vector<std::vector<UINT64>>& cellVisible) const {
+    // Separable like a box filter: OR along x, then y, then z.
+    int radius = static_cast<int>(dilation);
+    std::vector<std::vector<UINT64>> source;
+    UINT32 stride = 1;
+    for (UINT32 axis = 0; axis < 3 && radius > 0; axis++) {
+        source = cellVisible;
+        int size = static_cast<int>(m_gridSize[axis]);
+        for (UINT32 cell = 0; cell < cellVisible.size(); cell++) {
+            int coord = static_cast<int>(cell / stride % m_gridSize[axis]);
+            int last = std::min(size - 1, coord + radius);
+            for (int i = std::max(0, coord - radius); i <= last; i++) {
+                const std::vector<UINT64>& neighbour =
+                    source[cell + (i - coord) * static_cast<int>(stride)];
+                for (size_t word = 0; word < neighbour.size(); word++) {
+                    cellVisible[cell][word] |= neighbour[word];
+                }
+            }
+        }
+        stride *= m_gridSize[axis];
+    }
+}
+
+
+/*
+ * Pvs::addSet
+ */
+UINT32 Pvs::addSet(const std::vector<UINT64>& visible,
+        std::unordered_map<std::string, UINT32>& setLookup) {
+    // Alternating run lengths, starting with hidden meshes.
+    std::string encoded;
+    auto addRun = [&encoded](UINT32 run) {
+        do {
+            UINT8 byte = run & 0x7F;
+            run >>= 7;
+            encoded.push_back(static_cast<char>(run ? byte | 0x80 : byte));
+        } while (run);
+    };
+    bool runVisible = false;
+    UINT32 run = 0;
+    for (UINT32 mesh = 0; mesh < m_meshCnt; mesh++) {
+        bool isVisible = (visible[mesh / 64] >> (mesh % 64)) & 1;
+        if (isVisible != runVisible) {
+            addRun(run);
+            runVisible = isVisible;
+            run = 0;
+        }
+        run++;
+    }
+    addRun(run);
+
+    auto found = setLookup.find(encoded);
+    if (found != setLookup.end()) {
+        return found->second;
+    }
+    UINT32 set = static_cast<UINT32>(m_setOffsets.size() - 1);
+    m_setData.insert(m_setData.end(), encoded.begin(), encoded.end());
+    m_setOffsets.push_back(static_cast<UINT32>(m_setData.size()));
+    setLookup.emplace(std::move(encoded), set);
+    return set;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+/// <summary>
+/// Potentially visible sets of a static scene. The navigable volume is divided into
+/// a grid of view cells, each cell stores the meshes that can be seen from it.
+/// Baked offline, looked up at runtime before the frustum culling.
+/// </summary>
+/// <remarks>
+/// Baking renders the scene from a few viewpoints per cell into the six faces of a
+/// cube map: the corners of the cell, which neighbours share, its center and random
+/// points. A small scalar rasterizer writes depth and mesh IDs of the occluders
+/// (opaque meshes), every ID left in a buffer is visible. All other meshes only
+/// need a pixel in front of the occluders, eroded by a pixel or two to account for
+/// the viewpoints in between. Alpha-tested or transparent meshes therefore never
+/// hide anything. Meshes that project to less than a couple of pixels are tested
+/// with their bounds, so they are not lost between pixel centers. Meshes that touch
+/// the cell are always visible.
+/// A sampled set alone may miss a mesh that is only visible from points between the
+/// samples. Each cell therefore also takes the sets of its neighbours (dilation),
+/// whose samples surround it, which keeps the sets conservative in practice.
+/// Sets are stored as run lengths of the bitset over all meshes (alternating
+/// hidden/visible runs, LEB128 encoded). Cells with the same set share it.
+/// The sets store a hash of the geometry and the settings they were baked from, so
+/// stale sets can be detected after loading.
+/// No Direct3D is involved, so baking and lookup also run outside of the renderer.
+/// </remarks>
+class Pvs {
+public:
+    /// <summary>
+    /// Returned by FindCell() for positions outside of the baked volume.
+    /// </summary>
+    static const UINT32 NO_CELL = UINT32_MAX;
+
+    /// <summary>
+    /// Parameters of Bake().
+    /// </summary>
+    struct Settings {
+        dx::BoundingBox volume;     // Navigable volume. Zero extents: all meshes.
+        float cellSize = 20.0f;     // Edge length of a (cubic) cell.
+        UINT32 innerSampleCnt = 1;  // Viewpoints in a cell besides its corners:
+                                    // center, then random.
+        UINT32 resolution = 64;     // Pixels per side of a cube map face.
+        UINT32 erosion = 1;         // Pixels occluders shrink by for the tests.
+        UINT32 dilation = 1;        // Neighbour cells (per direction) whose sets
+                                    // are added to a cell.
+        float nearPlane = 0.1f;
+        UINT32 threadCnt = 0;       // 0 uses all threads of the WorkerPool.
+        UINT32 seed = 42;           // Random viewpoints.
+        Settings() : volume(sm::Vector3::Zero, sm::Vector3::Zero) {}
+    };
+
+    /// <summary>
+    /// Adds a mesh for baking. Its index is the index of the mesh in the sets.
+    /// </summary>
+    /// <param name="positions">First position. Model space.</param>
+    /// <param name="positionCnt">Number of positions.</param>
+    /// <param name="positionStride">Bytes between two positions.</param>
+    /// <param name="indices">Triangle list.</param>
+    /// <param name="indexCnt">Number of indices.</param>
+    /// <param name="worldMat">Model to world matrix.</param>
+    /// <param name="isOccluder">True if the mesh hides what is behind it.</param>
+    /// <returns>Index of the mesh.</returns>
+    UINT32 AddMesh(const sm::Vector3* positions, size_t positionCnt,
+        size_t positionStride, const UINT32* indices, size_t indexCnt,
+        const sm::Matrix& worldMat, bool isOccluder);
+
+    /// <summary>
+    /// Releases the geometry of the added meshes. The baked sets are kept.
+    /// </summary>
+    void ClearMeshes();
+
+    /// <summary>
+    /// Computes the sets of all cells from the added meshes. Replaces earlier sets.
+    /// </summary>
+    void Bake(const Settings& settings);
+
+    /// <summary>
+    /// Hashes the added meshes and the settings. Sets baked from the same geometry
+    /// with the same settings have the same hash.
+    /// </summary>
+    UINT64 ComputeHash(const Settings& settings) const;
+
+    /// <summary>
+    /// Returns the ComputeHash() of the baked or loaded sets.
+    /// </summary>
+    UINT64 GetHash() const;
+
+    /// <summary>
+    /// Returns true if there are sets, either baked or loaded.
+    /// </summary>
+    bool IsBaked() const;
+
+    /// <summary>
+    /// Returns the cell that contains a position, or NO_CELL.
+    /// </summary>
+    /// <param name="position">Position in the space of the meshes.</param>
+    UINT32 FindCell(const sm::Vector3& position) const;
+
+    /// <summary>
+    /// Collects the meshes that are visible from a cell.
+    /// </summary>
+    /// <param name="cell">Cell index from FindCell().</param>
+    /// <param name="meshes">Output. Cleared first, in ascending order.</param>
+    void GetVisibleMeshes(UINT32 cell, std::vector<UINT32>& meshes) const;
+
+    /// <summary>
+    /// Returns the bounds of a cell.
+    /// </summary>
+    dx::BoundingBox GetCellBounds(UINT32 cell) const;
+
+    UINT32 GetCellCount() const;
+    UINT32 GetMeshCount() const;
+
+    /// <summary>
+    /// Returns the number of distinct sets.
+    /// </summary>
+    UINT32 GetSetCount() const;
+
+    /// <summary>
+    /// Returns the bytes of the encoded sets and the cell table.
+    /// </summary>
+    size_t GetCompressedSize() const;
+
+    /// <summary>
+    /// Writes the sets to a binary file. Throws std::invalid_argument if the file
+    /// can not be written.
+    /// </summary>
+    void Save(const std::string& path) const;
+
+    /// <summary>
+    /// Reads sets written by Save(). Throws std::invalid_argument if the file can
+    /// not be read or is no PVS file.
+    /// </summary>
+    void Load(const std::string& path);
+
+private:
+    /// <summary>
+    /// Geometry of a mesh in world space.
+    /// </summary>
+    struct BakeMesh {
+        std::vector<sm::Vector3> positions;
+        std::vector<UINT32> indices;
+        dx::BoundingBox bounds;
+        bool isOccluder;
+    };
+
+    /// <summary>
+    /// Render target and scratch memory of a bake thread.
+    /// </summary>
+    struct View {
+        std::vector<float> depth;
+        std::vector<UINT32> ids;
+        std::vector<float> testDepth;           // Depth of the eroded occluders.
+        std::vector<float> erodedRows;
+        std::vector<sm::Vector4> clipPositions;
+        std::vector<std::pair<float, UINT32>> candidates;  // Meshes in the frustum
+                                                            // by nearest distance.
+        std::vector<UINT32> smallMeshes;        // Meshes of a few pixels.
+    };
+
+    /// <summary>
+    /// Marks the meshes that are visible from a point into a bitset.
+    /// </summary>
+    void bakePoint(const sm::Vector3& eye, View& view, std::vector<UINT64>& visible)
+        const;
+
+    /// <summary>
+    /// Renders the meshes of a cube map face and marks the visible ones.
+    /// </summary>
+    void bakeFace(const sm::Matrix& viewProj, View& view, std::vector<UINT64>& visible)
+        const;
+
+    /// <summary>
+    /// Rasterizes a mesh. Either writes depth and ID or only tests against the
+    /// eroded depth.
+    /// </summary>
+    /// <returns>True if a pixel passed the depth test.</returns>
+    bool rasterizeMesh(UINT32 mesh, const sm::Matrix& viewProj, bool writes,
+        View& view) const;
+
+    /// <summary>
+    /// Rasterizes a triangle in clip space that is in front of the near plane.
+    /// </summary>
+    bool rasterizeTriangle(const sm::Vector4& v0, const sm::Vector4& v1,
+        const sm::Vector4& v2, UINT32 id, bool writes, View& view) const;
+
+    /// <summary>
+    /// Computes the test depth: every pixel gets the farthest depth within the
+    /// erosion radius.
+    /// </summary>
+    void erodeDepth(View& view) const;
+
+    /// <summary>
+    /// Tests the bounds of a mesh against a depth buffer of a face.
+    /// </summary>
+    /// <returns>True if the bounds are in front of the depth of a pixel.</returns>
+    bool testBounds(UINT32 mesh, const sm::Matrix& viewProj,
+        const std::vector<float>& depth) const;
+
+    /// <summary>
+    /// Adds the sets of the neighbours within the dilation to every cell.
+    /// </summary>
+    void dilateSets(UINT32 dilation, std::vector<std::vector<UINT64>>& cellVisible)
+        const;
+
+    /// <summary>
+    /// Run length encodes a bitset into m_setData, unless the same set exists.
+    /// </summary>
+    /// <returns>Index of the set.</returns>
+    UINT32 addSet(const std::vector<UINT64>& visible,
+        std::unordered_map<std::string, UINT32>& setLookup);
+
+    // Geometry for baking.
+    std::vector<BakeMesh> m_meshes;
+    UINT32 m_resolution = 64;
+    float m_nearPlane = 0.1f;
+    UINT32 m_erosion = 1;
+    float m_farPlane = 1.0f;
+
+    // Grid of cells.
+    sm::Vector3 m_gridMin;
+    float m_cellSize = 1.0f;
+    std::array<UINT32, 3> m_gridSize = { 0, 0, 0 };
+
+    // Sets.
+    UINT32 m_meshCnt = 0;                   // Meshes when the sets were baked.
+    UINT64 m_hash = 0;                      // ComputeHash() when the sets were baked.
+    std::vector<UINT8> m_setData;           // Encoded sets, back to back.
+    std::vector<UINT32> m_setOffsets;       // Start per set, plus the end.
+    std::vector<UINT32> m_cellSets;         // Set per cell, x fastest.
+};
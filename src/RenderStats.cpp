@@ -0,0 +1,243 @@
+#include "stdafx.h"
+#include "RenderStats.h"
+
+// ImGui.
+#ifndef PORTABLE_CORE
+#include "Helper.h"
+#include "imgui.h"
+#endif
+
+static const size_t PASS_COUNT = static_cast<size_t>(RenderStats::Pass::COUNT);
+static const size_t COUNTER_COUNT = static_cast<size_t>(RenderStats::Counter::COUNT);
+
+/// <summary>
+/// Counters of the running frame (atomics) and of the last completed frame. The
+/// history is only touched by the render thread.
+/// </summary>
+struct RenderStatsState {
+    std::atomic<UINT64> current[PASS_COUNT][COUNTER_COUNT];
+    std::atomic<UINT64> lastFrame[PASS_COUNT][COUNTER_COUNT];
+    std::atomic<int> pass{ 0 };
+
+    bool frameStarted = false;
+    UINT64 history[RenderStats::HISTORY_FRAMES][PASS_COUNT][COUNTER_COUNT];
+    size_t historyCnt = 0;
+    size_t historyNext = 0;     // Slot of the next completed frame.
+};
+
+// Zero-initialized.
+static RenderStatsState g_stats;
+
+
+/*
+ * RenderStats::BeginFrame
+ */
+void RenderStats::BeginFrame() {
+    for (size_t pass = 0; pass < PASS_COUNT; pass++) {
+        for (size_t counter = 0; counter < COUNTER_COUNT; counter++) {
+            g_stats.lastFrame[pass][counter].store(
+                g_stats.current[pass][counter].exchange(0, std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        }
+    }
+
+    // The first call has no frame to complete.
+    if (g_stats.frameStarted) {
+        auto& frame = g_stats.history[g_stats.historyNext];
+        for (size_t pass = 0; pass < PASS_COUNT; pass++) {
+            for (size_t counter = 0; counter < COUNTER_COUNT; counter++) {
+                frame[pass][counter] =
+                    g_stats.lastFrame[pass][counter].load(std::memory_order_relaxed);
+            }
+        }
+        g_stats.historyNext = (g_stats.historyNext + 1) % HISTORY_FRAMES;
+        g_stats.historyCnt = std::min(g_stats.historyCnt + 1, HISTORY_FRAMES);
+    }
+    g_stats.frameStarted = true;
+    SetPass(Pass::UPDATE);
+}
+
+
+/*
+ * RenderStats::Reset
+ */
+void RenderStats::Reset() {
+    for (size_t pass = 0; pass < PASS_COUNT; pass++) {
+        for (size_t counter = 0; counter < COUNTER_COUNT; counter++) {
+            g_stats.current[pass][counter].store(0, std::memory_order_relaxed);
+            g_stats.lastFrame[pass][counter].store(0, std::memory_order_relaxed);
+        }
+    }
+    g_stats.frameStarted = false;
+    g_stats.historyCnt = 0;
+    g_stats.historyNext = 0;
+    SetPass(Pass::UPDATE);
+}
+
+
+/*
+ * RenderStats::SetPass
+ */
+void RenderStats::SetPass(Pass pass) {
+    g_stats.pass.store(static_cast<int>(pass), std::memory_order_relaxed);
+}
+
+
+/*
+ * RenderStats::Add
+ */
+void RenderStats::Add(Counter counter, UINT64 value) {
+    int pass = g_stats.pass.load(std::memory_order_relaxed);
+    g_stats.current[pass][static_cast<size_t>(counter)].fetch_add(value,
+        std::memory_order_relaxed);
+}
+
+
+/*
+ * RenderStats::AddUpload
+ */
+void RenderStats::AddUpload(UINT64 bytes) {
+    Add(Counter::CB_MAPS);
+    Add(Counter::BYTES_UPLOADED, bytes);
+}
+
+
+/*
+ * RenderStats::addDraw
+ */
+void RenderStats::addDraw(UINT64 primitiveCnt, UINT64 instanceCnt) {
+    Add(Counter::DRAW_CALLS);
+    Add(Counter::PRIMITIVES, primitiveCnt * instanceCnt);
+    Add(Counter::INSTANCES, instanceCnt);
+}
+
+
+/*
+ * RenderStats::Get
+ */
+UINT64 RenderStats::Get(Pass pass, Counter counter) {
+    return g_stats.lastFrame[static_cast<size_t>(pass)][static_cast<size_t>(counter)]
+        .load(std::memory_order_relaxed);
+}
+
+
+/*
+ * RenderStats::GetFrameTotal
+ */
+UINT64 RenderStats::GetFrameTotal(Counter counter) {
+    UINT64 total = 0;
+    for (size_t pass = 0; pass < PASS_COUNT; pass++) {
+        total += Get(static_cast<Pass>(pass), counter);
+    }
+    return total;
+}
+
+
+/*
+ * RenderStats::GetPassName
+ */
+const char* RenderStats::GetPassName(Pass pass) {
+    switch (pass) {
+    case Pass::UPDATE: return "Update";
+    case Pass::LIGHT_VIEW: return "Light Camera";
+    case Pass::GEOMETRY: return "Geometry Pass";
+    case Pass::LIGHT_VOLUMES: return "Light Volumes";
+    case Pass::SSAO: return "SSAO";
+    case Pass::COMBINATION: return "Lighting Pass";
+    case Pass::FORWARD: return "Forward Pass";
+    case Pass::OVERLAY: return "Overlay";
+    default: return "Unknown";
+    }
+}
+
+
+/*
+ * RenderStats::GetCounterName
+ */
+const char* RenderStats::GetCounterName(Counter counter) {
+    switch (counter) {
+    case Counter::DRAW_CALLS: return "Draws";
+    case Counter::PRIMITIVES: return "Primitives";
+    case Counter::INSTANCES: return "Instances";
+    case Counter::SHADER_SWITCHES: return "Shaders";
+    case Counter::BUFFER_BINDS: return "Buffers";
+    case Counter::SRV_BINDS: return "SRVs";
+    case Counter::CB_MAPS: return "CB Maps";
+    case Counter::BYTES_UPLOADED: return "Bytes Up";
+    default: return "Unknown";
+    }
+}
+
+
+/*
+ * RenderStats::GetHistoryFrameCount
+ */
+size_t RenderStats::GetHistoryFrameCount() {
+    return g_stats.historyCnt;
+}
+
+
+#ifndef PORTABLE_CORE
+/*
+ * RenderStats::DefineImGui
+ */
+void RenderStats::DefineImGui() {
+    if (ImGui::BeginTable("RenderStatsTable", static_cast<int>(COUNTER_COUNT) + 1,
+            ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+            ImGuiTableFlags_SizingFixedFit)) {
+        ImGui::TableSetupColumn("Pass");
+        for (size_t counter = 0; counter < COUNTER_COUNT; counter++) {
+            ImGui::TableSetupColumn(GetCounterName(static_cast<Counter>(counter)));
+        }
+        ImGui::TableHeadersRow();
+
+        for (size_t pass = 0; pass <= PASS_COUNT; pass++) {
+            // Last row holds the frame totals.
+            bool isTotal = pass == PASS_COUNT;
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", isTotal ? "Frame" : GetPassName(static_cast<Pass>(pass)));
+            for (size_t counter = 0; counter < COUNTER_COUNT; counter++) {
+                ImGui::TableNextColumn();
+                UINT64 value = isTotal ? GetFrameTotal(static_cast<Counter>(counter)) :
+                    Get(static_cast<Pass>(pass), static_cast<Counter>(counter));
+                ImGui::Text("%llu", value);
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    if (ImGui::Button("Export Counters")) {
+        BenchmarkStore::ResultSet resultSet =
+            BenchmarkStore::CreateResultSet("render_stats");
+        AppendMetrics(resultSet);
+        BenchmarkStore::Save(resultSet,
+            Helper::GetAssetFullPathString("\\render_stats.json"));
+    }
+}
+#endif
+
+
+/*
+ * RenderStats::AppendMetrics
+ */
+void RenderStats::AppendMetrics(BenchmarkStore::ResultSet& resultSet) {
+    // Oldest frame first.
+    size_t first = (g_stats.historyNext + HISTORY_FRAMES - g_stats.historyCnt) %
+        HISTORY_FRAMES;
+    for (size_t pass = 0; pass < PASS_COUNT && g_stats.historyCnt > 0; pass++) {
+        for (size_t counter = 0; counter < COUNTER_COUNT; counter++) {
+            BenchmarkStore::Metric metric;
+            metric.name = std::string(GetPassName(static_cast<Pass>(pass))) + "/" +
+                GetCounterName(static_cast<Counter>(counter));
+            metric.unit = "count";
+            metric.samples.reserve(g_stats.historyCnt);
+            for (size_t i = 0; i < g_stats.historyCnt; i++) {
+                size_t frame = (first + i) % HISTORY_FRAMES;
+                metric.samples.push_back(static_cast<double>(
+                    g_stats.history[frame][pass][counter]));
+            }
+            resultSet.metrics.push_back(metric);
+        }
+    }
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include "BenchmarkStore.h"
+
+/// <summary>
+/// Counts draw calls and state changes per render pass and frame, to explain why a
+/// pass takes the time the GPU queries report.
+/// </summary>
+/// <remarks>
+/// The counters are atomics that only get incremented (relaxed), so recording is
+/// lock-free and can be done from any thread. The current pass is set by the scene
+/// via SetPass(). BeginFrame() publishes the counts of the previous frame and resets
+/// the counters. The last HISTORY_FRAMES completed frames are kept, so exported
+/// counters are distributions that BenchmarkStore::Compare can test.
+/// Draw calls go through Draw(), DrawIndexed() and DrawIndexedInstanced(), which
+/// forward to the device context and count the call.
+/// </remarks>
+class RenderStats {
+public:
+    /// <summary>
+    /// Render passes of a frame. Follows the pass order of SponzaScene::Render.
+    /// </summary>
+    enum class Pass {
+        UPDATE,             // Per-frame buffer updates before the first pass.
+        LIGHT_VIEW,         // Directional light shadow map.
+        GEOMETRY,           // G-Buffer.
+        LIGHT_VOLUMES,      // Point light volumes.
+        SSAO,               // Occlusion map and blur.
+        COMBINATION,        // Deferred lighting.
+        FORWARD,            // Sky box and visualizations.
+        OVERLAY,            // Texture visualization and GUI.
+        COUNT               // Number of passes. Keep last.
+    };
+
+    /// <summary>
+    /// Counted quantities.
+    /// </summary>
+    enum class Counter {
+        DRAW_CALLS,
+        PRIMITIVES,         // Triangles of indexed draws (times instances).
+        INSTANCES,
+        SHADER_SWITCHES,    // VSSetShader/PSSetShader calls.
+        BUFFER_BINDS,       // Vertex, index and constant buffers.
+        SRV_BINDS,
+        CB_MAPS,            // Map() of constant buffers.
+        BYTES_UPLOADED,     // Written through Map().
+        COUNT               // Number of counters. Keep last.
+    };
+
+    /// <summary>
+    /// Number of completed frames kept for AppendMetrics().
+    /// </summary>
+    static constexpr size_t HISTORY_FRAMES = 256;
+
+    /// <summary>
+    /// Publishes the counts of the previous frame and starts a new one in
+    /// Pass::UPDATE.
+    /// </summary>
+    static void BeginFrame();
+
+    /// <summary>
+    /// Drops the running frame and the history. Should be called after events that
+    /// change what gets rendered (scene change, ...).
+    /// </summary>
+    static void Reset();
+
+    /// <summary>
+    /// Sets the pass all following counts are attributed to.
+    /// </summary>
+    static void SetPass(Pass pass);
+
+    /// <summary>
+    /// Adds to a counter of the current pass.
+    /// </summary>
+    static void Add(Counter counter, UINT64 value = 1);
+
+    /// <summary>
+    /// Records a constant buffer Map() of the current pass.
+    /// </summary>
+    /// <param name="bytes">Number of bytes written through the mapping.</param>
+    static void AddUpload(UINT64 bytes);
+
+    /// <summary>
+    /// Issues a non-indexed draw of triangles and counts it.
+    /// </summary>
+    /// <param name="context">ID3D11DeviceContext or anything with the same Draw().
+    /// </param>
+    template <typename Context>
+    static void Draw(Context* context, UINT vertexCnt) {
+        context->Draw(vertexCnt, 0);
+        addDraw(vertexCnt / 3, 1);
+    }
+
+    /// <summary>
+    /// Issues an indexed draw of triangles and counts it.
+    /// </summary>
+    template <typename Context>
+    static void DrawIndexed(Context* context, UINT indexCnt) {
+        context->DrawIndexed(indexCnt, 0, 0);
+        addDraw(indexCnt / 3, 1);
+    }
+
+    /// <summary>
+    /// Issues an indexed, instanced draw of triangles and counts it.
+    /// </summary>
+    template <typename Context>
+    static void DrawIndexedInstanced(Context* context, UINT indexCnt,
+            UINT instanceCnt) {
+        context->DrawIndexedInstanced(indexCnt, instanceCnt, 0, 0, 0);
+        addDraw(indexCnt / 3, instanceCnt);
+    }
+
+    /// <summary>
+    /// Returns a counter of the last completed frame.
+    /// </summary>
+    static UINT64 Get(Pass pass, Counter counter);
+
+    /// <summary>
+    /// Returns a counter of the last completed frame summed over all passes.
+    /// </summary>
+    static UINT64 GetFrameTotal(Counter counter);
+
+    /// <summary>
+    /// Returns the display name of a pass.
+    /// </summary>
+    static const char* GetPassName(Pass pass);
+
+    /// <summary>
+    /// Returns the display name of a counter.
+    /// </summary>
+    static const char* GetCounterName(Counter counter);
+
+    /// <summary>
+    /// Defines an ImGui table with the counts of the last frame. Has to be called
+    /// inside of an ImGui window.
+    /// </summary>
+    static void DefineImGui();
+
+    /// <summary>
+    /// Returns the number of completed frames in the history.
+    /// </summary>
+    static size_t GetHistoryFrameCount();
+
+    /// <summary>
+    /// Adds the counts as metrics ("pass/counter") to a result set, so they are
+    /// exported together with benchmark results. Every frame of the history is a
+    /// sample. Adds nothing if no frame was completed.
+    /// </summary>
+    static void AppendMetrics(BenchmarkStore::ResultSet& resultSet);
+
+private:
+    /// <summary>
+    /// Counts a draw call with the number of triangles per instance.
+    /// </summary>
+    static void addDraw(UINT64 primitiveCnt, UINT64 instanceCnt);
+};
@@ -0,0 +1,423 @@
+#include "stdafx.h"
+#include "ResourceRegistry.h"
+#include "TextureFormat.h"
+#include "Helper.h"
+
+// ImGui.
+#include "imgui.h"
+
+/// <summary>
+/// GUID under which the release tracker is stored as private data of a resource.
+/// </summary>
+static const GUID RESOURCE_TRACKER_GUID =
+    { 0x5e1c7a3b, 0x2f44, 0x4c1d, { 0x9b, 0x6e, 0x3a, 0x71, 0x0d, 0x52, 0xe8, 0x19 } };
+
+/// <summary>
+/// State of the registry. All accesses are guarded by the mutex, since textures
+/// can be created from multiple threads.
+/// </summary>
+struct ResourceRegistryState {
+    std::mutex mutex;
+    UINT64 nextId = 1;
+    std::unordered_map<UINT64, ResourceRegistry::Entry> entries;
+    std::array<ResourceRegistry::CategoryStats,
+        static_cast<size_t>(ResourceRegistry::Category::COUNT)> categories;
+    UINT64 totalBytes = 0;
+    UINT64 peakBytes = 0;
+};
+
+static ResourceRegistryState& getState() {
+    static ResourceRegistryState state;
+    return state;
+}
+
+/// <summary>
+/// Owner name for resources created by the current thread.
+/// </summary>
+static thread_local std::string g_currentOwner = "Unknown";
+
+
+/// <summary>
+/// Minimal COM object that gets attached to a tracked resource. D3D11 releases it
+/// when the resource is destroyed, which removes the corresponding entry.
+/// </summary>
+class ResourceReleaseTracker : public IUnknown {
+public:
+    ResourceReleaseTracker(UINT64 id) : m_refCount(1), m_id(id) {/*empty*/ }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override {
+        if (!ppvObject) {
+            return E_POINTER;
+        }
+        if (riid == __uuidof(IUnknown)) {
+            *ppvObject = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *ppvObject = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() override {
+        return InterlockedIncrement(&m_refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = InterlockedDecrement(&m_refCount);
+        if (count == 0) {
+            ResourceRegistry::unregister(m_id);
+            delete this;
+        }
+        return count;
+    }
+
+private:
+    ULONG m_refCount;
+    UINT64 m_id;
+};
+
+
+/*
+ * ResourceRegistry::ScopedOwner::ScopedOwner
+ */
+ResourceRegistry::ScopedOwner::ScopedOwner(const std::string& owner) {
+    m_previousOwner = g_currentOwner;
+    g_currentOwner = owner;
+}
+
+
+/*
+ * ResourceRegistry::ScopedOwner::~ScopedOwner
+ */
+ResourceRegistry::ScopedOwner::~ScopedOwner() {
+    g_currentOwner = m_previousOwner;
+}
+
+
+/*
+ * ResourceRegistry::Register
+ */
+void ResourceRegistry::Register(ID3D11Resource* resource, Category category,
+        const std::string& name) {
+    if (!resource) {
+        return;
+    }
+
+    Entry entry = describe(resource);
+    entry.category = category;
+    entry.owner = g_currentOwner;
+    entry.name = name;
+    add(resource, entry);
+}
+
+
+/*
+ * ResourceRegistry::Register
+ */
+void ResourceRegistry::Register(ID3D11ShaderResourceView* srv, Category category,
+        const std::string& name) {
+    if (!srv) {
+        return;
+    }
+
+    // Get the texture the view belongs to.
+    wrl::ComPtr<ID3D11Resource> resource;
+    srv->GetResource(resource.GetAddressOf());
+    Register(resource.Get(), category, name);
+}
+
+
+/*
+ * ResourceRegistry::GetTotalBytes
+ */
+UINT64 ResourceRegistry::GetTotalBytes() {
+    ResourceRegistryState& state = getState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.totalBytes;
+}
+
+
+/*
+ * ResourceRegistry::GetPeakBytes
+ */
+UINT64 ResourceRegistry::GetPeakBytes() {
+    ResourceRegistryState& state = getState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.peakBytes;
+}
+
+
+/*
+ * ResourceRegistry::GetCategoryStats
+ */
+ResourceRegistry::CategoryStats ResourceRegistry::GetCategoryStats(
+        Category category) {
+    ResourceRegistryState& state = getState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.categories[static_cast<size_t>(category)];
+}
+
+
+/*
+ * ResourceRegistry::ResetPeak
+ */
+void ResourceRegistry::ResetPeak() {
+    ResourceRegistryState& state = getState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.peakBytes = state.totalBytes;
+    for (CategoryStats& stats : state.categories) {
+        stats.peakBytes = stats.currentBytes;
+    }
+}
+
+
+/*
+ * ResourceRegistry::DefineImGui
+ */
+void ResourceRegistry::DefineImGui() {
+    // Copy the totals, so the lock is not held while ImGui is busy.
+    std::array<CategoryStats, static_cast<size_t>(Category::COUNT)> categories;
+    UINT64 totalBytes;
+    UINT64 peakBytes;
+    {
+        ResourceRegistryState& state = getState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        categories = state.categories;
+        totalBytes = state.totalBytes;
+        peakBytes = state.peakBytes;
+    }
+    const float toMB = 1.0f / (1024.0f * 1024.0f);
+
+    ImVec2 vpSize = ImGui::GetMainViewport()->Size;
+    ImVec2 wPos = ImVec2(0.75 * vpSize[0], 0.33 * vpSize[1]);
+    ImVec2 wSize = ImVec2(0.245 * vpSize[0], 0.3 * vpSize[1]);
+    ImGui::SetNextWindowPos(wPos, ImGuiCond_Appearing, ImVec2(0.0f, 0.0f));
+    ImGui::SetNextWindowSize(wSize, ImGuiCond_Appearing);
+    ImGui::Begin("GPU Memory");
+    ImGui::Text("Total: %.2f MB (Peak: %.2f MB)", totalBytes * toMB,
+        peakBytes * toMB);
+
+    if (ImGui::BeginTable("MemoryTable", 4, ImGuiTableFlags_Borders |
+            ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Category");
+        ImGui::TableSetupColumn("Count");
+        ImGui::TableSetupColumn("MB");
+        ImGui::TableSetupColumn("Peak MB");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < categories.size(); i++) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", GetCategoryName(static_cast<Category>(i)));
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", categories[i].count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", categories[i].currentBytes * toMB);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", categories[i].peakBytes * toMB);
+        }
+        ImGui::EndTable();
+    }
+
+    if (ImGui::Button("Reset Peak")) {
+        ResetPeak();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Dump Report")) {
+        DumpReport(Helper::GetAssetFullPathString("\\gpu_memory_report.txt"));
+    }
+    ImGui::End();
+}
+
+
+/*
+ * ResourceRegistry::DumpReport
+ */
+bool ResourceRegistry::DumpReport(const std::string& path) {
+    // Copy all data, so the file IO happens without holding the lock.
+    std::vector<Entry> entries;
+    std::array<CategoryStats, static_cast<size_t>(Category::COUNT)> categories;
+    UINT64 totalBytes;
+    UINT64 peakBytes;
+    {
+        ResourceRegistryState& state = getState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        entries.reserve(state.entries.size());
+        for (const auto& pair : state.entries) {
+            entries.push_back(pair.second);
+        }
+        categories = state.categories;
+        totalBytes = state.totalBytes;
+        peakBytes = state.peakBytes;
+    }
+
+    // Biggest resources first.
+    std::sort(entries.begin(), entries.end(),
+        [](const Entry& a, const Entry& b) { return a.sizeBytes > b.sizeBytes; });
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    const double toMB = 1.0 / (1024.0 * 1024.0);
+    file << "GPU memory report\n";
+    file << "Total: " << totalBytes * toMB << " MB, Peak: " << peakBytes * toMB
+        << " MB\n\n";
+
+    file << "Category;Count;Bytes;PeakBytes\n";
+    for (size_t i = 0; i < categories.size(); i++) {
+        file << GetCategoryName(static_cast<Category>(i)) << ";"
+            << categories[i].count << ";"
+            << categories[i].currentBytes << ";"
+            << categories[i].peakBytes << "\n";
+    }
+
+    file << "\nCategory;Owner;Name;Format;Width;Height;DepthOrArraySize;Mips;Bytes\n";
+    for (const Entry& entry : entries) {
+        file << GetCategoryName(entry.category) << ";"
+            << entry.owner << ";"
+            << entry.name << ";"
+            << static_cast<unsigned int>(entry.format) << ";"
+            << entry.width << ";"
+            << entry.height << ";"
+            << entry.depthOrArraySize << ";"
+            << entry.mipLevels << ";"
+            << entry.sizeBytes << "\n";
+    }
+
+    return true;
+}
+
+
+/*
+ * ResourceRegistry::GetCategoryName
+ */
+const char* ResourceRegistry::GetCategoryName(Category category) {
+    switch (category) {
+    case Category::GBUFFER:         return "G-Buffer";
+    case Category::LIGHTING:        return "Lighting";
+    case Category::SSAO:            return "SSAO";
+    case Category::SHADOW_MAP:      return "Shadow Map";
+    case Category::TEXTURE:         return "Textures";
+    case Category::VERTEX_BUFFER:   return "Vertex Buffers";
+    case Category::INDEX_BUFFER:    return "Index Buffers";
+    case Category::INSTANCE_BUFFER: return "Instance Buffers";
+    case Category::CONSTANT_BUFFER: return "Constant Buffers";
+    default:                        return "Other";
+    }
+}
+
+
+/*
+ * ResourceRegistry::unregister
+ */
+void ResourceRegistry::unregister(UINT64 id) {
+    ResourceRegistryState& state = getState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    auto it = state.entries.find(id);
+    if (it == state.entries.end()) {
+        return;
+    }
+
+    CategoryStats& stats = state.categories[static_cast<size_t>(it->second.category)];
+    stats.count--;
+    stats.currentBytes -= it->second.sizeBytes;
+    state.totalBytes -= it->second.sizeBytes;
+    state.entries.erase(it);
+}
+
+
+/*
+ * ResourceRegistry::add
+ */
+void ResourceRegistry::add(ID3D11Resource* resource, Entry entry) {
+    UINT64 id;
+    {
+        ResourceRegistryState& state = getState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        id = state.nextId++;
+
+        CategoryStats& stats = state.categories[static_cast<size_t>(entry.category)];
+        stats.count++;
+        stats.currentBytes += entry.sizeBytes;
+        stats.peakBytes = std::max(stats.peakBytes, stats.currentBytes);
+        state.totalBytes += entry.sizeBytes;
+        state.peakBytes = std::max(state.peakBytes, state.totalBytes);
+        state.entries[id] = entry;
+    }
+
+    // The resource holds the only reference to the tracker afterwards. Registering
+    // the same resource twice releases the previous tracker (and its entry).
+    ResourceReleaseTracker* tracker = new ResourceReleaseTracker(id);
+    HRESULT hr = resource->SetPrivateDataInterface(RESOURCE_TRACKER_GUID, tracker);
+    tracker->Release();
+    assert(SUCCEEDED(hr));
+}
+
+
+/*
+ * ResourceRegistry::describe
+ */
+ResourceRegistry::Entry ResourceRegistry::describe(ID3D11Resource* resource) {
+    Entry entry = {};
+    entry.format = DXGI_FORMAT_UNKNOWN;
+
+    D3D11_RESOURCE_DIMENSION dimension;
+    resource->GetType(&dimension);
+    switch (dimension) {
+    case D3D11_RESOURCE_DIMENSION_BUFFER:
+    {
+        D3D11_BUFFER_DESC desc;
+        static_cast<ID3D11Buffer*>(resource)->GetDesc(&desc);
+        entry.width = desc.ByteWidth;
+        entry.height = 1;
+        entry.depthOrArraySize = 1;
+        entry.mipLevels = 1;
+        entry.sizeBytes = desc.ByteWidth;
+        break;
+    }
+    case D3D11_RESOURCE_DIMENSION_TEXTURE1D:
+    {
+        D3D11_TEXTURE1D_DESC desc;
+        static_cast<ID3D11Texture1D*>(resource)->GetDesc(&desc);
+        entry.format = desc.Format;
+        entry.width = desc.Width;
+        entry.height = 1;
+        entry.depthOrArraySize = desc.ArraySize;
+        entry.mipLevels = desc.MipLevels;
+        entry.sizeBytes = TextureFormat::ComputeTextureSize(desc.Format, desc.Width,
+            1, 1, desc.MipLevels, desc.ArraySize, 1);
+        break;
+    }
+    case D3D11_RESOURCE_DIMENSION_TEXTURE2D:
+    {
+        D3D11_TEXTURE2D_DESC desc;
+        static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+        entry.format = desc.Format;
+        entry.width = desc.Width;
+        entry.height = desc.Height;
+        entry.depthOrArraySize = desc.ArraySize;
+        entry.mipLevels = desc.MipLevels;
+        entry.sizeBytes = TextureFormat::ComputeTextureSize(desc.Format, desc.Width,
+            desc.Height, 1, desc.MipLevels, desc.ArraySize, desc.SampleDesc.Count);
+        break;
+    }
+    case D3D11_RESOURCE_DIMENSION_TEXTURE3D:
+    {
+        D3D11_TEXTURE3D_DESC desc;
+        static_cast<ID3D11Texture3D*>(resource)->GetDesc(&desc);
+        entry.format = desc.Format;
+        entry.width = desc.Width;
+        entry.height = desc.Height;
+        entry.depthOrArraySize = desc.Depth;
+        entry.mipLevels = desc.MipLevels;
+        entry.sizeBytes = TextureFormat::ComputeTextureSize(desc.Format, desc.Width,
+            desc.Height, desc.Depth, desc.MipLevels, 1, 1);
+        break;
+    }
+    default:
+        break;
+    }
+
+    return entry;
+}
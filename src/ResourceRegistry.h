@@ -0,0 +1,141 @@
+#pragma once
+
+/// <summary>
+/// Keeps track of all GPU resources (buffers and textures) that were created by the
+/// application, so the VRAM usage can be inspected at runtime.
+/// </summary>
+/// <remarks>
+/// Resources are registered right after creation. Unregistering happens
+/// automatically: a small tracker object is attached to the resource via
+/// SetPrivateDataInterface() and gets released by D3D11 once the resource itself is
+/// destroyed.
+/// </remarks>
+class ResourceRegistry {
+public:
+    /// <summary>
+    /// Groups resources by their function in the renderer.
+    /// </summary>
+    enum class Category {
+        GBUFFER,            // G-Buffer render targets and depth.
+        LIGHTING,           // Point light lighting textures.
+        SSAO,               // Occlusion maps, noise texture and sample kernel.
+        SHADOW_MAP,         // Directional light depth texture.
+        TEXTURE,            // Textures loaded from disk (DDS/WIC).
+        VERTEX_BUFFER,
+        INDEX_BUFFER,
+        INSTANCE_BUFFER,
+        CONSTANT_BUFFER,
+        OTHER,
+        COUNT               // Number of categories. Keep last.
+    };
+
+    /// <summary>
+    /// Information about a single registered resource.
+    /// </summary>
+    struct Entry {
+        Category category;
+        std::string owner;      // ModelClass/Scene that created the resource.
+        std::string name;       // Name or file path of the resource.
+        DXGI_FORMAT format;     // DXGI_FORMAT_UNKNOWN for buffers.
+        unsigned int width;     // Byte width for buffers.
+        unsigned int height;
+        unsigned int depthOrArraySize;
+        unsigned int mipLevels;
+        UINT64 sizeBytes;
+    };
+
+    /// <summary>
+    /// Totals of a single category.
+    /// </summary>
+    struct CategoryStats {
+        unsigned int count = 0;
+        UINT64 currentBytes = 0;
+        UINT64 peakBytes = 0;
+    };
+
+    /// <summary>
+    /// Sets the owner name for all resources that get registered by the current
+    /// thread while the object is alive. Scopes can be nested.
+    /// </summary>
+    class ScopedOwner {
+    public:
+        ScopedOwner(const std::string& owner);
+        ~ScopedOwner();
+    private:
+        std::string m_previousOwner;
+    };
+
+    /// <summary>
+    /// Registers a buffer or texture.
+    /// </summary>
+    /// <param name="resource">The created D3D11 resource.</param>
+    /// <param name="category">Category of the resource.</param>
+    /// <param name="name">Name of the resource (e.g. member or file name).</param>
+    static void Register(ID3D11Resource* resource, Category category,
+        const std::string& name);
+
+    /// <summary>
+    /// Registers the resource behind a SRV. Used for textures that were created by
+    /// the DDS/WIC texture loaders, which only hand out the view.
+    /// </summary>
+    /// <param name="srv">Shader resource view of the texture.</param>
+    /// <param name="category">Category of the resource.</param>
+    /// <param name="name">Name of the resource (e.g. file name).</param>
+    static void Register(ID3D11ShaderResourceView* srv, Category category,
+        const std::string& name);
+
+    /// <summary>
+    /// Returns the total amount of bytes that are currently registered.
+    /// </summary>
+    static UINT64 GetTotalBytes();
+
+    /// <summary>
+    /// Returns the highest total amount of registered bytes so far.
+    /// </summary>
+    static UINT64 GetPeakBytes();
+
+    /// <summary>
+    /// Returns the totals of a single category.
+    /// </summary>
+    static CategoryStats GetCategoryStats(Category category);
+
+    /// <summary>
+    /// Resets the peak values to the current values.
+    /// </summary>
+    static void ResetPeak();
+
+    /// <summary>
+    /// Defines an ImGui window that lists the totals per category.
+    /// </summary>
+    static void DefineImGui();
+
+    /// <summary>
+    /// Writes a report with totals per category and all registered resources.
+    /// </summary>
+    /// <param name="path">Path of the report file.</param>
+    /// <returns>If the file could be written or not.</returns>
+    static bool DumpReport(const std::string& path);
+
+    /// <summary>
+    /// Returns a readable name of the category.
+    /// </summary>
+    static const char* GetCategoryName(Category category);
+
+private:
+    friend class ResourceReleaseTracker;
+
+    /// <summary>
+    /// Removes an entry. Called when the tracked resource gets destroyed.
+    /// </summary>
+    static void unregister(UINT64 id);
+
+    /// <summary>
+    /// Adds an entry and attaches a release tracker to the resource.
+    /// </summary>
+    static void add(ID3D11Resource* resource, Entry entry);
+
+    /// <summary>
+    /// Fills in an entry from the description of the resource.
+    /// </summary>
+    static Entry describe(ID3D11Resource* resource);
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "Helper.h"
+#include "AllocationTracker.h"
 #include "ModelClass.h"
 
 /// <summary>
@@ -38,8 +39,8 @@ public:
 	/// Performs necessary rendering calls for drawing the scene. 
 	/// </summary>
 	virtual void Render(
-		wrl::ComPtr<ID3D11RenderTargetView> d3dFrameBufferView,
-		wrl::ComPtr<ID3D11DepthStencilView>d3dFrameBufferDepthStencilView) = 0;
+		const wrl::ComPtr<ID3D11RenderTargetView>& d3dFrameBufferView,
+		const wrl::ComPtr<ID3D11DepthStencilView>& d3dFrameBufferDepthStencilView) = 0;
 
 	/// <summary>
 	/// Returns name of the scene.
@@ -0,0 +1,312 @@
+#include "stdafx.h"
+#include "SceneGraph.h"
+
+
+/*
+ * SceneGraph::AddNode
+ */
+UINT32 SceneGraph::AddNode(UINT32 parent, const sm::Matrix& localMat,
+        const std::string& name) {
+    UINT32 node = static_cast<UINT32>(m_parents.size());
+    // Depth-first order: the parent has to be on the path to the last node.
+    if (parent != NO_PARENT) {
+        UINT32 ancestor = node - 1;
+        while (ancestor != NO_PARENT && ancestor != parent) {
+            ancestor = m_parents[ancestor];
+        }
+        if (ancestor != parent) {
+            throw std::invalid_argument("Parent of node '" + name +
+                "' is not on the path to the last node.");
+        }
+    }
+
+    m_parents.push_back(parent);
+    m_subtreeEnds.push_back(node + 1);
+    m_names.push_back(name);
+    m_localMats.push_back(localMat);
+    m_worldMats.push_back(sm::Matrix::Identity);
+    m_localBounds.push_back(dx::BoundingBox());
+    m_worldBounds.push_back(dx::BoundingBox());
+    m_subtreeBounds.push_back(dx::BoundingBox());
+    m_hasBounds.push_back(0);
+    m_hasSubtreeBounds.push_back(0);
+    m_isIdentity.push_back(1);
+    m_versions.push_back(0);
+    m_dirtyFlags.push_back(0);
+    m_structureDirty = true;
+    return node;
+}
+
+
+/*
+ * SceneGraph::Clear
+ */
+void SceneGraph::Clear() {
+    *this = SceneGraph();
+}
+
+
+/*
+ * SceneGraph::SetLocalMatrix
+ */
+void SceneGraph::SetLocalMatrix(UINT32 node, const sm::Matrix& localMat) {
+    m_localMats[node] = localMat;
+    if (!m_dirtyFlags[node]) {
+        m_dirtyFlags[node] = 1;
+        m_dirtyNodes.push_back(node);
+    }
+}
+
+
+/*
+ * SceneGraph::SetLocalBounds
+ */
+void SceneGraph::SetLocalBounds(UINT32 node, const dx::BoundingBox& bounds) {
+    m_localBounds[node] = bounds;
+    m_hasBounds[node] = 1;
+    if (!m_dirtyFlags[node]) {
+        m_dirtyFlags[node] = 1;
+        m_dirtyNodes.push_back(node);
+    }
+}
+
+
+/*
+ * SceneGraph::Update
+ */
+void SceneGraph::Update() {
+    m_lastUpdateCount = 0;
+
+    // New nodes: recompute everything once.
+    if (m_structureDirty) {
+        updateStructure();
+        m_dirtyNodes.clear();
+        for (UINT32 node = 0; node < m_parents.size(); node++) {
+            m_dirtyFlags[node] = 0;
+            if (m_parents[node] == NO_PARENT) {
+                m_dirtyNodes.push_back(node);
+            }
+        }
+        m_structureDirty = false;
+    }
+    if (m_dirtyNodes.empty()) {
+        return;
+    }
+
+    // In index order, a dirty node inside an already propagated subtree is covered
+    // by it.
+    std::sort(m_dirtyNodes.begin(), m_dirtyNodes.end());
+    UINT32 propagatedEnd = 0;
+    for (UINT32 node : m_dirtyNodes) {
+        m_dirtyFlags[node] = 0;
+        if (node < propagatedEnd) {
+            continue;
+        }
+        propagate(node);
+        propagatedEnd = m_subtreeEnds[node];
+
+        // Collect the ancestors, their bounds contain the subtree. Shared ancestors
+        // are only collected once (flags are reused as markers).
+        for (UINT32 ancestor = m_parents[node];
+                ancestor != NO_PARENT && !m_dirtyFlags[ancestor];
+                ancestor = m_parents[ancestor]) {
+            m_dirtyFlags[ancestor] = 1;
+            m_ancestors.push_back(ancestor);
+        }
+    }
+    m_dirtyNodes.clear();
+
+    // Deepest ancestors first (higher index), so parents see updated children.
+    std::sort(m_ancestors.begin(), m_ancestors.end(), std::greater<UINT32>());
+    for (UINT32 ancestor : m_ancestors) {
+        mergeChildBounds(ancestor);
+        m_dirtyFlags[ancestor] = 0;
+    }
+    m_ancestors.clear();
+}
+
+
+/*
+ * SceneGraph::GetNodeCount
+ */
+UINT32 SceneGraph::GetNodeCount() const {
+    return static_cast<UINT32>(m_parents.size());
+}
+
+
+/*
+ * SceneGraph::GetParent
+ */
+UINT32 SceneGraph::GetParent(UINT32 node) const {
+    return m_parents[node];
+}
+
+
+/*
+ * SceneGraph::GetSubtreeEnd
+ */
+UINT32 SceneGraph::GetSubtreeEnd(UINT32 node) const {
+    return m_subtreeEnds[node];
+}
+
+
+/*
+ * SceneGraph::GetName
+ */
+const std::string& SceneGraph::GetName(UINT32 node) const {
+    return m_names[node];
+}
+
+
+/*
+ * SceneGraph::GetLocalMatrix
+ */
+const sm::Matrix& SceneGraph::GetLocalMatrix(UINT32 node) const {
+    return m_localMats[node];
+}
+
+
+/*
+ * SceneGraph::GetWorldMatrix
+ */
+const sm::Matrix& SceneGraph::GetWorldMatrix(UINT32 node) const {
+    return m_worldMats[node];
+}
+
+
+/*
+ * SceneGraph::IsWorldIdentity
+ */
+bool SceneGraph::IsWorldIdentity(UINT32 node) const {
+    return m_isIdentity[node] != 0;
+}
+
+
+/*
+ * SceneGraph::HasBounds
+ */
+bool SceneGraph::HasBounds(UINT32 node) const {
+    return m_hasBounds[node] != 0;
+}
+
+
+/*
+ * SceneGraph::GetWorldBounds
+ */
+const dx::BoundingBox& SceneGraph::GetWorldBounds(UINT32 node) const {
+    return m_worldBounds[node];
+}
+
+
+/*
+ * SceneGraph::HasSubtreeBounds
+ */
+bool SceneGraph::HasSubtreeBounds(UINT32 node) const {
+    return m_hasSubtreeBounds[node] != 0;
+}
+
+
+/*
+ * SceneGraph::GetSubtreeBounds
+ */
+const dx::BoundingBox& SceneGraph::GetSubtreeBounds(UINT32 node) const {
+    return m_subtreeBounds[node];
+}
+
+
+/*
+ * SceneGraph::GetVersion
+ */
+UINT32 SceneGraph::GetVersion(UINT32 node) const {
+    return m_versions[node];
+}
+
+
+/*
+ * SceneGraph::GetLastUpdateCount
+ */
+UINT32 SceneGraph::GetLastUpdateCount() const {
+    return m_lastUpdateCount;
+}
+
+
+/*
+ * SceneGraph::updateStructure
+ */
+void SceneGraph::updateStructure() {
+    // Children come after their parent, so a backwards pass sees every child before
+    // its parent.
+    UINT32 nodeCnt = static_cast<UINT32>(m_parents.size());
+    for (UINT32 node = 0; node < nodeCnt; node++) {
+        m_subtreeEnds[node] = node + 1;
+    }
+    for (UINT32 node = nodeCnt; node-- > 0;) {
+        UINT32 parent = m_parents[node];
+        if (parent != NO_PARENT) {
+            m_subtreeEnds[parent] = std::max(m_subtreeEnds[parent], m_subtreeEnds[node]);
+        }
+    }
+}
+
+
+/*
+ * SceneGraph::propagate
+ */
+void SceneGraph::propagate(UINT32 node) {
+    UINT32 end = m_subtreeEnds[node];
+
+    // Forward: parents are done before their children.
+    for (UINT32 i = node; i < end; i++) {
+        UINT32 parent = m_parents[i];
+        m_worldMats[i] = parent == NO_PARENT ? m_localMats[i] :
+            m_localMats[i] * m_worldMats[parent];
+        m_isIdentity[i] = m_worldMats[i] == sm::Matrix::Identity ? 1 : 0;
+        if (m_hasBounds[i]) {
+            m_localBounds[i].Transform(m_worldBounds[i], m_worldMats[i]);
+        }
+        m_subtreeBounds[i] = m_worldBounds[i];
+        m_hasSubtreeBounds[i] = m_hasBounds[i];
+        m_versions[i]++;
+    }
+
+    // Backward: children are merged into their parents.
+    for (UINT32 i = end - 1; i > node; i--) {
+        if (!m_hasSubtreeBounds[i]) {
+            continue;
+        }
+        UINT32 parent = m_parents[i];
+        if (m_hasSubtreeBounds[parent]) {
+            dx::BoundingBox::CreateMerged(m_subtreeBounds[parent],
+                m_subtreeBounds[parent], m_subtreeBounds[i]);
+        } else {
+            m_subtreeBounds[parent] = m_subtreeBounds[i];
+            m_hasSubtreeBounds[parent] = 1;
+        }
+    }
+
+    m_lastUpdateCount += end - node;
+}
+
+
+/*
+ * SceneGraph::mergeChildBounds
+ */
+void SceneGraph::mergeChildBounds(UINT32 node) {
+    m_subtreeBounds[node] = m_worldBounds[node];
+    m_hasSubtreeBounds[node] = m_hasBounds[node];
+
+    // Direct children: skip over their subtrees.
+    for (UINT32 child = node + 1; child < m_subtreeEnds[node];
+            child = m_subtreeEnds[child]) {
+        if (!m_hasSubtreeBounds[child]) {
+            continue;
+        }
+        if (m_hasSubtreeBounds[node]) {
+            dx::BoundingBox::CreateMerged(m_subtreeBounds[node],
+                m_subtreeBounds[node], m_subtreeBounds[child]);
+        } else {
+            m_subtreeBounds[node] = m_subtreeBounds[child];
+            m_hasSubtreeBounds[node] = 1;
+        }
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+/// <summary>
+/// Node hierarchy of a model with local transforms, cached world matrices and
+/// bounds. World space here is the space of the model (before its model matrix).
+/// </summary>
+/// <remarks>
+/// Nodes are stored flattened in depth-first order: a parent always comes before
+/// its children and every subtree is a contiguous range [node, subtree end). World
+/// matrices therefore propagate in a single forward pass. Changing a local matrix
+/// only marks the node. Update() recomputes the dirty subtrees and nothing else,
+/// then refreshes the subtree bounds of their ancestors.
+/// Every recomputed node gets a new version, so owners of per-node GPU data know
+/// when to upload.
+/// </remarks>
+class SceneGraph {
+public:
+    static const UINT32 NO_PARENT = UINT32_MAX;
+
+    /// <summary>
+    /// Appends a node. Nodes have to be added in depth-first order, i.e. the parent
+    /// has to be the last added node or one of its ancestors. Throws
+    /// std::invalid_argument otherwise.
+    /// </summary>
+    /// <param name="parent">Index of the parent or NO_PARENT for a root.</param>
+    /// <param name="localMat">Transform relative to the parent.</param>
+    /// <param name="name">Name of the node (debugging).</param>
+    /// <returns>Index of the node.</returns>
+    UINT32 AddNode(UINT32 parent, const sm::Matrix& localMat, const std::string& name);
+
+    /// <summary>
+    /// Removes all nodes.
+    /// </summary>
+    void Clear();
+
+    /// <summary>
+    /// Sets the transform of a node relative to its parent. The node and its
+    /// subtree get recomputed with the next Update().
+    /// </summary>
+    void SetLocalMatrix(UINT32 node, const sm::Matrix& localMat);
+
+    /// <summary>
+    /// Sets the bounds of the geometry attached to a node, in node space.
+    /// </summary>
+    void SetLocalBounds(UINT32 node, const dx::BoundingBox& bounds);
+
+    /// <summary>
+    /// Propagates the world matrices and bounds of all dirty subtrees.
+    /// </summary>
+    void Update();
+
+    UINT32 GetNodeCount() const;
+    UINT32 GetParent(UINT32 node) const;
+
+    /// <summary>
+    /// Returns the index after the last node of the subtree of a node.
+    /// </summary>
+    UINT32 GetSubtreeEnd(UINT32 node) const;
+    const std::string& GetName(UINT32 node) const;
+    const sm::Matrix& GetLocalMatrix(UINT32 node) const;
+
+    /// <summary>
+    /// Returns the world matrix of a node as of the last Update().
+    /// </summary>
+    const sm::Matrix& GetWorldMatrix(UINT32 node) const;
+
+    /// <summary>
+    /// Returns true if the world matrix of a node is the identity, i.e. its
+    /// geometry can be drawn with the model matrix alone.
+    /// </summary>
+    bool IsWorldIdentity(UINT32 node) const;
+
+    /// <summary>
+    /// Returns true if geometry is attached to the node.
+    /// </summary>
+    bool HasBounds(UINT32 node) const;
+
+    /// <summary>
+    /// Returns the world bounds of the geometry of a node. Only valid if
+    /// HasBounds() is true.
+    /// </summary>
+    const dx::BoundingBox& GetWorldBounds(UINT32 node) const;
+
+    /// <summary>
+    /// Returns true if geometry is attached to the node or any of its descendants.
+    /// </summary>
+    bool HasSubtreeBounds(UINT32 node) const;
+
+    /// <summary>
+    /// Returns the world bounds of the geometry of a node and all its descendants,
+    /// so whole subtrees can be culled at once. Only valid if HasSubtreeBounds() is
+    /// true.
+    /// </summary>
+    const dx::BoundingBox& GetSubtreeBounds(UINT32 node) const;
+
+    /// <summary>
+    /// Returns a counter that increases every time the world matrix of a node is
+    /// recomputed.
+    /// </summary>
+    UINT32 GetVersion(UINT32 node) const;
+
+    /// <summary>
+    /// Returns the number of nodes recomputed by the last Update().
+    /// </summary>
+    UINT32 GetLastUpdateCount() const;
+
+private:
+    /// <summary>
+    /// Recomputes the subtree ends after nodes were added.
+    /// </summary>
+    void updateStructure();
+
+    /// <summary>
+    /// Recomputes world matrices and bounds of a subtree.
+    /// </summary>
+    void propagate(UINT32 node);
+
+    /// <summary>
+    /// Recomputes the subtree bounds of a node from its own bounds and the subtree
+    /// bounds of its children.
+    /// </summary>
+    void mergeChildBounds(UINT32 node);
+
+    // Nodes (depth-first order).
+    std::vector<UINT32> m_parents;
+    std::vector<UINT32> m_subtreeEnds;
+    std::vector<std::string> m_names;
+    std::vector<sm::Matrix> m_localMats;
+    std::vector<sm::Matrix> m_worldMats;
+    std::vector<dx::BoundingBox> m_localBounds;
+    std::vector<dx::BoundingBox> m_worldBounds;
+    std::vector<dx::BoundingBox> m_subtreeBounds;
+    std::vector<UINT8> m_hasBounds;
+    std::vector<UINT8> m_hasSubtreeBounds;
+    std::vector<UINT8> m_isIdentity;
+    std::vector<UINT32> m_versions;
+
+    // Dirty tracking.
+    std::vector<UINT8> m_dirtyFlags;
+    std::vector<UINT32> m_dirtyNodes;
+    std::vector<UINT32> m_ancestors;    // Scratch memory of Update().
+    bool m_structureDirty = false;
+    UINT32 m_lastUpdateCount = 0;
+};
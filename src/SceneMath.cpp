@@ -0,0 +1,204 @@
+#include "stdafx.h"
+#include "SceneMath.h"
+#include "shader/LightAttenuation.hlsli"
+
+
+/*
+ * SceneMath::ComputeShadowMatrices
+ */
+void SceneMath::ComputeShadowMatrices(const sm::Matrix& viewMat,
+        const sm::Matrix& projMat, const sm::Vector3& lightPos, float farClip,
+        const dx::BoundingBox& casterBounds, sm::Matrix& lightViewMatOut,
+        sm::Matrix& lightProjMatOut) {
+    // Frustum corners of camera in normalized device coordinates (NDC). In D3D11
+    // the depth range is 0-1!
+    const std::array<sm::Vector4,8> ndcCorners = {
+        sm::Vector4(-1, -1, 0, 1), // Near bottom-left
+        sm::Vector4(1, -1, 0, 1), // Near bottom-right
+        sm::Vector4(-1,  1, 0, 1), // Near top-left
+        sm::Vector4(1,  1, 0, 1), // Near top-right
+        sm::Vector4(-1, -1, 1, 1), // Far bottom-left
+        sm::Vector4(1, -1, 1, 1), // Far bottom-right
+        sm::Vector4(-1,  1, 1, 1), // Far top-left
+        sm::Vector4(1,  1, 1, 1)  // Far top-right
+    };
+
+    // Compute the combined view-projection matrix.
+    sm::Matrix viewProjectionMatrix = viewMat * projMat;
+
+    // Invert the combined matrix
+    sm::Matrix invertedViewProjectionMatrix = viewProjectionMatrix.Invert();
+
+    // Transform NDC frustum corners to world space.
+    std::array<sm::Vector4, 8> worldSpaceCorners;
+    for (int i = 0; i < 8; i++) {
+        sm::Vector4 ndcCorner = ndcCorners[i];
+        sm::Vector4 worldSpaceCorner = sm::Vector4::Transform(ndcCorner,
+            invertedViewProjectionMatrix);
+        worldSpaceCorners[i] = worldSpaceCorner / worldSpaceCorner.w;
+    }
+
+    // Compute centroid of the frustum (world space).
+    sm::Vector3 centroid;
+    for (sm::Vector4& corner : worldSpaceCorners) {
+        centroid += sm::Vector3(corner.x, corner.y, corner.z);
+    }
+    centroid = centroid / 8.0;
+
+    // Compute temporary working position for the light.
+    sm::Vector3 lightDir = dx::XMVector3Normalize(-lightPos);  // TODO: Separate.
+    sm::Vector3 tempPosition = centroid - farClip * lightDir; // Go towards light.
+
+    // lookAt view matrix that looks towards centroid.
+    sm::Matrix lightViewMat = sm::Matrix::CreateLookAt(
+        tempPosition, centroid,
+        sm::Vector3(0.0, 1.0, 0.0));
+
+    // Transform world space frustum corners into view space of light.
+    // At the same time find Min and Max X, Y and Z.
+    std::array<sm::Vector4, 8> lightViewSpaceCorners;
+    float minX = 0.0;
+    float maxX = 0.0;
+    float minY = 0.0;
+    float maxY = 0.0;
+    float minZ = 0.0;
+    float maxZ = 0.0;
+    for (int i = 0; i < 8; i++) {
+        // Transform frustum corners from world space to light view space.
+        sm::Vector4 worldCorner = worldSpaceCorners[i];
+        lightViewSpaceCorners[i] = sm::Vector4::Transform(worldCorner, lightViewMat);
+
+        // Compute Min and Max X,Y,Z.
+        minX = std::min(minX, lightViewSpaceCorners[i].x);
+        maxX = std::max(maxX, lightViewSpaceCorners[i].x);
+        
+        minY = std::min(minY, lightViewSpaceCorners[i].y);
+        maxY = std::max(maxY, lightViewSpaceCorners[i].y);
+        
+        minZ = std::min(minZ, lightViewSpaceCorners[i].z);
+        maxZ = std::max(maxZ, lightViewSpaceCorners[i].z);
+    }
+
+    // Casters between the light and the camera frustum still throw shadows into
+    // it. Move the near plane towards the light (+z) until it contains all of them.
+    std::array<sm::Vector3, 8> casterCorners;
+    casterBounds.GetCorners(casterCorners.data());
+    float nearZ = maxZ;
+    for (const sm::Vector3& corner : casterCorners) {
+        nearZ = std::min(nearZ, -sm::Vector3::Transform(corner, lightViewMat).z);
+    }
+
+    // Compute off center orthographic projection matrix.
+    sm::Matrix offCenterProj = sm::Matrix::CreateOrthographicOffCenter(minX, maxX,
+        minY, maxY, nearZ, -minZ);
+
+    // Set computed matrices.
+    lightViewMatOut = lightViewMat;
+    lightProjMatOut = offCenterProj;
+}
+
+/*
+ * SceneMath::GenerateLights
+ */
+std::vector<SceneMath::Light> SceneMath::GenerateLights(unsigned int lightCnt,
+        unsigned int seed) {
+    std::vector<Light> lights;
+    lights.reserve(lightCnt);
+    std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // random floats between [0.0, 1.0]
+    std::seed_seq seedSequence = { seed };
+    std::default_random_engine generator(seedSequence);
+
+    for (unsigned int i = 0; i < lightCnt; i++) {
+        // Generate position.
+        sm::Vector3 posSample = sm::Vector3(
+            randomFloats(generator),
+            randomFloats(generator),
+            randomFloats(generator)
+        );
+
+        // Sponza relevant area for lights:
+        // X=[139,-111], Y=[-6,23],Z=[54,-49]
+        float posX = -111.0 + posSample.x * (139.0 - (-111.0));
+        float posY = -6 + posSample.y * (23.0 - (-6.0));
+        float posZ = -49 + posSample.z * (54.0 - (-49));
+
+        // Generate color.
+        sm::Vector3 colorSample = sm::Vector3(
+            randomFloats(generator),
+            randomFloats(generator),
+            randomFloats(generator)
+        );
+        //colorSample.Normalize();    // To ensure bright colors.
+
+        // Store the light.
+        Light newLight;
+        newLight.Position = sm::Vector4(posX, posY, posZ, 1.0);
+        newLight.Color = sm::Vector4(colorSample.x, colorSample.y, colorSample.z, 1.0);
+        float scale = 2.0f * ComputeLightRadius(colorSample, 1.0f, LIGHT_CUTOFF);
+        newLight.Scale = sm::Vector4(scale, scale, scale, 1.0);
+        lights.push_back(newLight);
+    }
+
+    return lights;
+}
+
+/*
+ * SceneMath::ComputeLightRadius
+ */
+float SceneMath::ComputeLightRadius(const sm::Vector3& color, float intensity,
+        float cutoff) {
+    // brightest / (c + l * d + q * d^2) = cutoff, the positive root of
+    // q * d^2 + l * d + (c - brightest / cutoff) = 0.
+    float brightest = intensity * std::max(std::max(color.x, color.y), color.z);
+    float c = LIGHT_ATTENUATION_CONSTANT - brightest / cutoff;
+    if (c >= 0.0f) {
+        return 0.0f;
+    }
+    float l = LIGHT_ATTENUATION_LINEAR;
+    float q = LIGHT_ATTENUATION_QUADRATIC;
+    return (-l + std::sqrt(l * l - 4.0f * q * c)) / (2.0f * q);
+}
+
+/*
+ * SceneMath::ComputeLightAttenuation
+ */
+float SceneMath::ComputeLightAttenuation(float dist, float radius) {
+    float ratio = dist / radius;
+    float fade = std::min(std::max(1.0f - ratio * ratio * ratio * ratio, 0.0f), 1.0f);
+    return fade * fade / (LIGHT_ATTENUATION_CONSTANT + LIGHT_ATTENUATION_LINEAR * dist +
+        LIGHT_ATTENUATION_QUADRATIC * dist * dist);
+}
+
+/*
+ * SceneMath::GenerateSSAOKernel
+ */
+std::vector<sm::Vector4> SceneMath::GenerateSSAOKernel(unsigned int sampleCnt,
+        unsigned int seed) {
+    std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // random floats between [0.0, 1.0]
+    std::seed_seq seedSequence = { seed };
+    std::default_random_engine generator(seedSequence);
+    std::vector<sm::Vector4> ssaoKernel;
+    ssaoKernel.reserve(sampleCnt);
+    for (unsigned int i = 0; i < sampleCnt; ++i) {
+        sm::Vector3 sample(
+            randomFloats(generator) * 2.0 - 1.0,    // -1 to 1
+            randomFloats(generator) * 2.0 - 1.0,    // -1 to 1
+            randomFloats(generator)                 // 0 to 1
+        );
+        sample.Normalize();
+
+        float scale = (float)i / (float)sampleCnt;
+        scale = lerp(0.1f, 1.0f, scale * scale);
+        sample *= scale;
+        ssaoKernel.push_back(sm::Vector4(sample.x,sample.y,sample.z,1.0));
+    }
+
+    return ssaoKernel;
+}
+
+/*
+ * SceneMath::lerp
+ */
+float SceneMath::lerp(float a, float b, float f) {
+    return a + f * (b - a);
+}
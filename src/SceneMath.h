@@ -0,0 +1,85 @@
+#pragma once
+
+/// <summary>
+/// The computations of SponzaScene that need no Direct3D: shadow frustum fitting,
+/// light generation and attenuation and the SSAO sample kernel.
+/// </summary>
+class SceneMath {
+public:
+    /// <summary>
+    /// Point light as stored in the light constant buffer.
+    /// </summary>
+    struct Light {
+        sm::Vector4 Position;
+        sm::Vector4 Color;
+        sm::Vector4 Scale;
+    };
+
+    /// <summary>
+    /// Fits the orthographic projection of the directional light to the view
+    /// frustum of the camera.
+    /// </summary>
+    /// <param name="viewMat">View matrix of the camera.</param>
+    /// <param name="projMat">Projection matrix of the camera.</param>
+    /// <param name="lightPos">Position of the directional light.</param>
+    /// <param name="farClip">Far clipping distance of the camera.</param>
+    /// <param name="casterBounds">World bounds of all shadow casters. The near
+    /// plane is moved towards the light until it contains them, so casters outside
+    /// of the camera frustum are not clipped.</param>
+    /// <param name="lightViewMatOut">Resulting view matrix of the light.</param>
+    /// <param name="lightProjMatOut">Resulting projection matrix of the light.
+    /// </param>
+    static void ComputeShadowMatrices(const sm::Matrix& viewMat,
+        const sm::Matrix& projMat, const sm::Vector3& lightPos, float farClip,
+        const dx::BoundingBox& casterBounds, sm::Matrix& lightViewMatOut,
+        sm::Matrix& lightProjMatOut);
+
+    /// <summary>
+    /// Generates randomly placed and colored point lights inside of Sponza. Their
+    /// scale is twice the radius of ComputeLightRadius().
+    /// </summary>
+    /// <param name="lightCnt">Number of lights.</param>
+    /// <param name="seed">Seed of the random number generator.</param>
+    /// <returns>Generated lights.</returns>
+    static std::vector<Light> GenerateLights(unsigned int lightCnt,
+        unsigned int seed);
+
+    /// <summary>
+    /// Computes the distance at which a point light falls below a cutoff: its
+    /// brightest channel times the attenuation of the lighting shaders.
+    /// </summary>
+    /// <param name="color">Color of the light.</param>
+    /// <param name="intensity">Scale of the color.</param>
+    /// <param name="cutoff">Smallest contribution that is not dropped, e.g. a few
+    /// levels of an 8 bit channel.</param>
+    /// <returns>Radius of the light, 0 if it never reaches the cutoff.</returns>
+    static float ComputeLightRadius(const sm::Vector3& color, float intensity,
+        float cutoff);
+
+    /// <summary>
+    /// Computes the attenuation of the lighting shaders, faded out towards the
+    /// radius of the light.
+    /// </summary>
+    /// <param name="dist">Distance to the light.</param>
+    /// <param name="radius">Radius of the light.</param>
+    static float ComputeLightAttenuation(float dist, float radius);
+
+    /// <summary>
+    /// Generates the hemisphere sample kernel for SSAO.
+    /// </summary>
+    /// <param name="sampleCnt">Number of samples.</param>
+    /// <param name="seed">Seed of the random number generator.</param>
+    /// <returns>Sample positions (w = 1).</returns>
+    static std::vector<sm::Vector4> GenerateSSAOKernel(unsigned int sampleCnt,
+        unsigned int seed);
+
+private:
+    /// <summary>
+    /// Linear interpolation.
+    /// </summary>
+    /// <param name="a"></param>
+    /// <param name="b"></param>
+    /// <param name="f"></param>
+    /// <returns></returns>
+    static float lerp(float a, float b, float f);
+};
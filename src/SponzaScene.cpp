@@ -1,5 +1,13 @@
 #include "stdafx.h"
 #include "SponzaScene.h"
+#include "Telemetry.h"
+#include "WorkerPool.h"
+
+
+// Loose bounds of the light culling: the radius is scaled and extended, which
+// covers the animated lights for about a second of moving and flickering.
+static const float LIGHT_BOUNDS_SCALE = 1.25f;
+static const float LIGHT_BOUNDS_MARGIN = 2.0f;
 
 
 /*
@@ -35,10 +43,16 @@ wrl::ComPtr <ID3D11Query> SponzaScene::createDisjointQuery(
 /*
  * SponzaScene::Render
  */
-void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView,
-    wrl::ComPtr<ID3D11DepthStencilView>		d3dFrameBufferDepthStencilView) {
+void SponzaScene::Render(
+        const wrl::ComPtr<ID3D11RenderTargetView>& d3dFrameBufferView,
+        const wrl::ComPtr<ID3D11DepthStencilView>& d3dFrameBufferDepthStencilView) {
     // Update matrices, buffers etc.
-    update();
+    {
+        AllocationTracker::Scope scope("SponzaScene::update");
+        update();
+    }
+
+    cullModels();
 
     ID3D11ShaderResourceView* nullSRV[10] = { nullptr };
     ID3D11Buffer* nullBuffers[10] = { nullptr };
@@ -54,6 +68,7 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
     //##############################################################################
     // Light view pass (directional light shadow mapping).
     pUDA->BeginEvent(L"Directional Light View Pass");
+    RenderStats::SetPass(RenderStats::Pass::LIGHT_VIEW);
 
     if (m_useShadows) {
         m_d3dContext->ClearDepthStencilView(m_shadowDepthView.Get(),
@@ -71,9 +86,10 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
         // for ModelClass information.
         m_d3dContext->VSSetConstantBuffers(1, 1,
             m_shadowConstBufferVS.GetAddressOf());
+        RenderStats::Add(RenderStats::Counter::BUFFER_BINDS, 1);
 
         // Draw all models that can cause shadows.
-        m_sponzaModel->Draw(true);
+        m_sponzaModel->Draw(true, m_lightVisibleMeshes);
 
         // Cleanup.
         m_d3dContext->OMSetDepthStencilState(nullptr, 0);
@@ -90,6 +106,7 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
     //##############################################################################
     // Deferred: G-Pass.
     pUDA->BeginEvent(L"Deferred: G-Pass");
+    RenderStats::SetPass(RenderStats::Pass::GEOMETRY);
     {
         // Clear g-buffer every frame.
         for (const auto& ptr : m_gBufferRTVs) {
@@ -109,9 +126,17 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
 
         // First slot is always reserved for ModelClass information.
         m_d3dContext->VSSetConstantBuffers(1, 1, m_sceneBufferVS.GetAddressOf());
+        RenderStats::Add(RenderStats::Counter::BUFFER_BINDS, 1);
 
         // Draw the sponza scene.
-        m_sponzaModel->Draw(false);
+        m_sponzaModel->Draw(false, m_cameraVisibleMeshes);
+
+        // Depth for the occlusion culling or the tiled lighting of a later frame.
+        if ((m_useFrustumCulling && m_occlusionMode == OcclusionMode::REPROJECTION) ||
+                (usePointLights && m_lightingMode == LightingMode::TILED)) {
+            m_d3dContext->OMSetRenderTargets(0, nullptr, nullptr);
+            m_depthReadback.Downsample(m_gBufferDepthSRV.Get(), m_viewMat * m_projMat);
+        }
 
         // Cleanup.
         m_d3dContext->OMSetDepthStencilState(nullptr, 0);
@@ -127,6 +152,7 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
     //##############################################################################
     // Deferred: Lighting pass
     pUDA->BeginEvent(L"Deferred: Lighting Pass");
+    RenderStats::SetPass(RenderStats::Pass::LIGHT_VOLUMES);
     {
         // Clear all render targets.
         for (const auto& ptr : m_lightingTextureRTVs) {
@@ -157,10 +183,18 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
         // Bind G-Buffer.
         m_d3dContext->PSSetShaderResources(0, 1, m_gBufferDepthSRV.GetAddressOf());
         m_d3dContext->PSSetShaderResources(1, 1, m_gBufferSRVs[0].GetAddressOf());
-
-        // Draw light volumes.
-        if (usePointLights) {
+        RenderStats::Add(RenderStats::Counter::BUFFER_BINDS, 2);
+        RenderStats::Add(RenderStats::Counter::SRV_BINDS, 2);
+
+        // Draw light volumes, or all lights at once with the lists of the tiles or
+        // clusters.
+        if (usePointLights && m_lightingMode != LightingMode::VOLUMES) {
+            m_tiledLighting.Draw();
+        } else if (usePointLights) {
             m_lightVolumes->Draw(false);
+            if (m_lightLodActive) {
+                m_virtualLightVolumes->Draw(false);
+            }
         }
 
         // Cleanup.
@@ -177,6 +211,7 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
     //##############################################################################
     // SSAO.
     pUDA->BeginEvent(L"SSAO: Occlusion Map");
+    RenderStats::SetPass(RenderStats::Pass::SSAO);
 
     if (m_useSSAO) {
         // Set every frame.
@@ -203,6 +238,8 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
          m_d3dContext->PSSetShaderResources(0, 1, m_gBufferDepthSRV.GetAddressOf());        // gBuffer depth.
          m_d3dContext->PSSetShaderResources(1, 1, m_gBufferSRVs[0].GetAddressOf());
          m_d3dContext->PSSetShaderResources(2, 1, m_randomVectorTextureSRV.GetAddressOf()); // 4x4 random vector noise texture.
+         RenderStats::Add(RenderStats::Counter::BUFFER_BINDS, 4);
+         RenderStats::Add(RenderStats::Counter::SRV_BINDS, 3);
 
         // Compute occlusion map.
          m_ssaoQuad->Draw(false);
@@ -239,6 +276,8 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
 
         // Bind the unblurred occlusion texture.
         m_d3dContext->PSSetShaderResources(0, 1, m_occlusionTextureSRV.GetAddressOf());
+        RenderStats::Add(RenderStats::Counter::BUFFER_BINDS, 2);
+        RenderStats::Add(RenderStats::Counter::SRV_BINDS, 1);
 
        // Draw window-filling quad and perform blur.
         m_ssaoQuadBlur->Draw(false);
@@ -258,6 +297,7 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
     //##############################################################################
     // Deferred: Combination pass.
     pUDA->BeginEvent(L"Deferred: Combination Pass.");
+    RenderStats::SetPass(RenderStats::Pass::COMBINATION);
     {
         // Clearing of the framebuffer is done outside in Graphics::Render.
         m_d3dContext->RSSetViewports(1, &m_viewport);
@@ -294,6 +334,8 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
         } else {
             m_d3dContext->PSSetShaderResources(6, 1, m_occlusionTextureSRV.GetAddressOf());
         }
+        RenderStats::Add(RenderStats::Counter::BUFFER_BINDS, 5);
+        RenderStats::Add(RenderStats::Counter::SRV_BINDS, 7);
 
         // Draw the quad.
         m_lightingPassQuad->Draw(false);
@@ -313,6 +355,7 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
     //##############################################################################
     // Forward pass after the lighting pass.
     pUDA->BeginEvent(L"Forward Pass");
+    RenderStats::SetPass(RenderStats::Pass::FORWARD);
     {
         m_d3dContext->RSSetViewports(1, &m_viewport);
         m_d3dContext->RSSetState(m_rasterizerState.Get()); // Set every frame.
@@ -328,6 +371,8 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
             m_d3dContext->VSSetConstantBuffers(1, 1, m_sceneBufferVS.GetAddressOf());
             m_d3dContext->PSSetConstantBuffers(1, 1, m_sceneBufferPS.GetAddressOf());
             m_d3dContext->PSSetShaderResources(0, 1, m_skyBoxTexture.srv.GetAddressOf());
+            RenderStats::Add(RenderStats::Counter::BUFFER_BINDS, 2);
+            RenderStats::Add(RenderStats::Counter::SRV_BINDS, 1);
 
             // Draw the skybox cube using the cube map.
             m_skyBoxCube->Draw(false);
@@ -346,6 +391,7 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
             // First slot is always reserved for Mesh material information.
             m_d3dContext->VSSetConstantBuffers(1, 1, m_sceneBufferVS.GetAddressOf());
             m_d3dContext->PSSetConstantBuffers(1, 1, m_sceneBufferPS.GetAddressOf());
+            RenderStats::Add(RenderStats::Counter::BUFFER_BINDS, 2);
 
             // Draw origin visualization.
             if (m_showOriginVis) {
@@ -371,6 +417,7 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
     // Render things on top of everything in the framebuffer (GUI, ...).
     
     // Render texture visualization quad.
+    RenderStats::SetPass(RenderStats::Pass::OVERLAY);
     if (m_showTexVis) {
         m_d3dContext->RSSetViewports(1, &m_viewport);
         m_d3dContext->OMSetDepthStencilState(m_d3dFrameBufferDepthState.Get(), 1);
@@ -388,6 +435,8 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
         m_d3dContext->PSSetShaderResources(3, 1, m_lightingTextureSRVs[1].GetAddressOf());
         m_d3dContext->PSSetShaderResources(4, 1, m_occlusionTextureSRV.GetAddressOf());
         m_d3dContext->PSSetShaderResources(5, 1, m_occlusionTextureBlurSRV.GetAddressOf());
+        RenderStats::Add(RenderStats::Counter::BUFFER_BINDS, 2);
+        RenderStats::Add(RenderStats::Counter::SRV_BINDS, 6);
 
         // Set samplers.
         m_d3dContext->PSSetSamplers(1, 1, m_gBufferSampler.GetAddressOf());
@@ -418,7 +467,10 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
     processPerformanceMetrics();
 
     // Define GUI.
-    this->defineImGui();
+    {
+        AllocationTracker::Scope scope("SponzaScene::defineImGui");
+        this->defineImGui();
+    }
 }
 
 
@@ -426,6 +478,9 @@ void SponzaScene::Render(wrl::ComPtr<ID3D11RenderTargetView>		d3dFrameBufferView
  * SponzaScene::Init
  */
 void SponzaScene::Init() {
+    // All GPU resources created from here on belong to this scene.
+    ResourceRegistry::ScopedOwner resourceOwner("SponzaScene");
+
     // GUI related variables.
     m_showWireframe = false;
     useAnimation = false;
@@ -462,35 +517,55 @@ void SponzaScene::Init() {
     HRESULT hr = m_d3dDevice->CreateRasterizerState(
         &m_rasterDesc, m_rasterizerState.GetAddressOf());
 
+    // The init phases are independent of each other (except for the light
+    // visualization, which needs the lights) and run in parallel. The device is
+    // free-threaded, phases that load textures use the immediate context and are
+    // flagged, so they never overlap.
+    TaskGraph graph;
+    auto addPhase = [&](const std::string& name, void (SponzaScene::*phase)(),
+            const std::vector<unsigned int>& dependencies = {},
+            bool usesImmediateContext = false) {
+        return graph.AddTask(name, [this, phase]() {
+            ResourceRegistry::ScopedOwner resourceOwner("SponzaScene");
+            (this->*phase)();
+        }, dependencies, usesImmediateContext);
+    };
+
     // Init the G-Buffer for deferred rendering.
-    initGBuffer();
+    addPhase("initGBuffer", &SponzaScene::initGBuffer);
 
     // Init lights in the scene.
-    initLights();
+    unsigned int lightsTask = addPhase("initLights", &SponzaScene::initLights);
 
     // Init models of the scene.
-    initModels();
+    addPhase("initModels", &SponzaScene::initModels, { lightsTask }, true);
 
     // Init all scene related buffers.
-    initSceneBuffers();
+    addPhase("initSceneBuffers", &SponzaScene::initSceneBuffers);
 
     // Init resources for texture visualization quad.
-    initTextureVisualization();
+    addPhase("initTextureVisualization", &SponzaScene::initTextureVisualization);
 
     // Init shadow mapping via directional light.
-    initShadows();
+    addPhase("initShadows", &SponzaScene::initShadows);
 
     // Create cube and load cube map from disk for skybox.
-    initSkyBox();
+    addPhase("initSkyBox", &SponzaScene::initSkyBox, {}, true);
 
     // Init window-filling quad for lighting pass.
-    initLightingPass();
+    addPhase("initLightingPass", &SponzaScene::initLightingPass);
 
     // Init textures and buffers for SSAO.
-    initSSAO();
+    addPhase("initSSAO", &SponzaScene::initSSAO);
 
     // Init queries for profiling.
-    initProfiling();
+    addPhase("initProfiling", &SponzaScene::initProfiling);
+
+    graph.Run();
+    graph.Report("SponzaScene::Init");
+    m_initTimings = graph.GetTimings();
+    m_msInitTotal = graph.GetTotalMs();
+    m_msInitSerial = graph.GetSerialMs();
 }
 
 
@@ -508,7 +583,9 @@ void SponzaScene::initModels() {
         m_d3dDevice, m_d3dContext,
         &m_viewMat, 1, sm::Vector3{ 0.0, -10.0, 0.0 },
         sm::Vector4{ 0.0, 0.0, 0.0, 1.0 }, 1, L"\\src\\shader\\Sponza_vs.hlsl",
-        L"\\src\\shader\\Sponza_ps.hlsl");
+        L"\\src\\shader\\Sponza_ps.hlsl", SPONZA_CHUNK_TRIANGLES);
+    m_pvsPath = modelPath + modelName + ".pvs";
+    loadPvs();
 
     // Create world origin visualization cube.
     m_originVisualization = std::make_shared<ModelClass>(ModelClass::BaseType::CUBE,
@@ -541,9 +618,10 @@ void SponzaScene::initModels() {
         L"\\src\\shader\\BasicInstanced_vs.hlsl",
         L"\\src\\shader\\BasicInstanced_ps.hlsl");
 
-    // Use the data and a custom shader for light volume instanced rendering.
+    // Use the data and a custom shader for light volume instanced rendering. The
+    // icosahedron covers the sphere of the light with a fraction of its vertices.
     m_lightVolumes = std::make_shared<ModelClass>(
-        ModelClass::BaseType::SPHERE,
+        ModelClass::BaseType::ICOSAHEDRON,
         positions,
         colors,
         scales,
@@ -553,6 +631,29 @@ void SponzaScene::initModels() {
         &m_viewMat,
         L"\\src\\shader\\LightVolumeInstanced_vs.hlsl",
         L"\\src\\shader\\LightVolumeInstanced_ps.hlsl");
+
+    // Virtual lights of the light LOD, their instances are set every frame.
+    m_virtualLightVolumes = std::make_shared<ModelClass>(
+        ModelClass::BaseType::ICOSAHEDRON,
+        std::vector<sm::Vector3>(1, sm::Vector3::Zero),
+        std::vector<sm::Vector3>(1, sm::Vector3::Zero),
+        std::vector<sm::Vector3>(1, sm::Vector3::Zero),
+        std::vector<sm::Vector4>(1, sm::Vector4(0.0, 0.0, 0.0, 1.0)),
+        m_d3dDevice,
+        m_d3dContext,
+        &m_viewMat,
+        L"\\src\\shader\\LightVolumeInstanced_vs.hlsl",
+        L"\\src\\shader\\LightVolumeInstanced_ps.hlsl");
+
+    // The culling passes share the worker pool with the calling thread.
+    const UINT32 cullThreadCnt = WorkerPool::Get().GetWorkerCount() + 1;
+    m_occlusionCuller.SetThreadCount(cullThreadCnt);
+
+    m_tiledLightCuller.SetThreadCount(cullThreadCnt);
+    m_clusteredLightCuller.SetThreadCount(cullThreadCnt);
+    m_clusteredLightCuller.SetLightBvh(&m_lightBvh);
+    m_lodClusteredLightCuller.SetThreadCount(cullThreadCnt);
+    m_tiledLighting.Init(m_d3dDevice, m_d3dContext);
 }
 
 
@@ -578,6 +679,7 @@ void SponzaScene::resizeEvent() {
     }
 
     // Create new textures for G-Buffer and lighting pass textures.
+    ResourceRegistry::ScopedOwner resourceOwner("SponzaScene");
     initGBuffer();
 
     // Release SSAO occlusion maps.
@@ -624,6 +726,17 @@ void SponzaScene::defineImGui() {
     ImGui::Text("Forward Pass : %.2f ms", m_msForwardPass);
     ImGui::Text("_______________________");
     ImGui::Text("Frame Time   : %.2f ms", m_msFrameTime);
+    if (ImGui::CollapsingHeader("Draw Statistics")) {
+        RenderStats::DefineImGui();
+    }
+    if (ImGui::CollapsingHeader("Start-up")) {
+        ImGui::Text("Init: %.2f ms (%.2f ms if serial)", m_msInitTotal,
+            m_msInitSerial);
+        for (const TaskGraph::TaskTiming& timing : m_initTimings) {
+            ImGui::Text("%-26s %8.2f ms", timing.name.c_str(),
+                timing.endMs - timing.startMs);
+        }
+    }
     ImGui::End();
 
     //Settings Menu
@@ -634,12 +747,11 @@ void SponzaScene::defineImGui() {
     ImGui::Begin("Settings");
     // Combo example from https://github.com/ocornut/imgui/issues/1658
     {
-        std::string currentItem = DrawModeStrings[m_drawMode];
+        const std::string& currentItem = DrawModeStrings[m_drawMode];
         if (ImGui::BeginCombo("DrawMode", currentItem.c_str())) {
             for (int n = 0; n < DrawModeStrings.size(); n++) {
                 bool isSelected = (currentItem == DrawModeStrings[n]);
                 if (ImGui::Selectable(DrawModeStrings[n].c_str(), isSelected)) {
-                    currentItem = DrawModeStrings[n];
                     m_drawMode = n;
                 }
                 if (isSelected) {
@@ -653,12 +765,11 @@ void SponzaScene::defineImGui() {
     // Texture visualization Quad.
     ImGui::Checkbox("Texture Visualization", &m_showTexVis);
     if (m_showTexVis) {
-        std::string currentTexVis = TexVisStrings[m_texVisTextureIdx];
+        const std::string& currentTexVis = TexVisStrings[m_texVisTextureIdx];
         if (ImGui::BeginCombo("Texture", currentTexVis.c_str())) {
             for (int n = 0; n < TexVisStrings.size(); n++) {
                 bool isSelected = (currentTexVis == TexVisStrings[n]);
                 if (ImGui::Selectable(TexVisStrings[n].c_str(), isSelected)) {
-                    currentTexVis = TexVisStrings[n];
                     m_texVisTextureIdx = n;
                 }
                 if (isSelected) {
@@ -670,8 +781,11 @@ void SponzaScene::defineImGui() {
     }
 
     // Show state information of the sponza model.
-    ModelState* sponzaState = m_sponzaModel->GetState();
-    modelStateChanged |= ImGui::SliderFloat("Scaling", &sponzaState->scale, 0.01f, 8.0f);
+    ModelState sponzaState = m_sponzaModel->GetState();
+    if (ImGui::SliderFloat("Scaling", &sponzaState.scale, 0.01f, 8.0f)) {
+        m_sponzaModel->SetState(sponzaState);
+        modelStateChanged = true;
+    }
     modelStateChanged |= ImGui::SliderFloat("Yaw", &m_modelYaw, 0.0f, 360.0f);
     modelStateChanged |= ImGui::SliderFloat("Pitch", &m_modelPitch, -90.0f, 90.0f);
     modelStateChanged |= ImGui::SliderFloat("Roll", &m_modelRoll, -90.0f, 90.0f);
@@ -689,6 +803,75 @@ void SponzaScene::defineImGui() {
     // Light information.
     ImGui::Text("Point Lights:");
     ImGui::Checkbox("Activate", &usePointLights);
+    bool animationChanged = ImGui::Checkbox("Animate", &m_animateLights);
+    if (m_animateLights) {
+        animationChanged |= ImGui::SliderInt("Animated lights", &m_animatedLightCnt, 32,
+            262144, "%d", ImGuiSliderFlags_Logarithmic);
+    }
+    if (animationChanged) {
+        resetLightAnimation();
+    }
+    const std::string& currentLightingMode =
+        m_lightingModes[static_cast<size_t>(m_lightingMode)];
+    if (ImGui::BeginCombo("Lighting", currentLightingMode.c_str())) {
+        for (int n = 0; n < m_lightingModes.size(); n++) {
+            bool isSelected = (currentLightingMode == m_lightingModes[n]);
+            if (ImGui::Selectable(m_lightingModes[n].c_str(), isSelected)) {
+                m_lightingMode = static_cast<LightingMode>(n);
+            }
+            if (isSelected) {
+                ImGui::SetItemDefaultFocus();
+            }
+        }
+        ImGui::EndCombo();
+    }
+    // Distant lights merged into virtual ones, if they span few pixels.
+    ImGui::Checkbox("Light LOD", &m_useLightLod);
+    if (m_useLightLod) {
+        LightLod::Settings settings = m_lightLod.GetSettings();
+        bool settingsChanged = ImGui::SliderFloat("LOD merge size (pixels)",
+            &settings.maxMergeSize, 0.25f, 64.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+        settingsChanged |= ImGui::SliderFloat("LOD distance", &settings.minDistance,
+            0.0f, 300.0f);
+        if (settingsChanged) {
+            m_lightLod.SetSettings(settings);
+        }
+        ImGui::Text("%zu lights kept, %zu merged into %zu virtual lights",
+            m_lightLod.GetKeptLights().size(), m_lightLod.GetMergedLights().size(),
+            m_lightLod.GetVirtualLights().size());
+    }
+    if (m_lightingMode != LightingMode::VOLUMES) {
+        // Random lights like the initial ones, removed newest first.
+        if (ImGui::Button("Add 32 lights")) {
+            for (const Light& light : SceneMath::GenerateLights(32,
+                    ++m_addedLightSeed)) {
+                m_addedLights.push_back(m_lightPool.Add(sm::Vector3(light.Position.x,
+                    light.Position.y, light.Position.z), 0.5f * light.Scale.x,
+                    sm::Vector3(light.Color.x, light.Color.y, light.Color.z)));
+            }
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Remove 32 lights")) {
+            for (UINT32 i = 0; i < 32 && !m_addedLights.empty(); i++) {
+                m_lightPool.Remove(m_addedLights.back());
+                m_addedLights.pop_back();
+            }
+        }
+        ImGui::Text("%u lights, %llu bytes uploaded", m_lightPool.GetCount(),
+            m_lightBuffer.GetUploadedBytes());
+    }
+
+    // Nearest light along the view direction, e.g. to pick one.
+    float pickT = FLT_MAX;
+    UINT32 pickedLight = m_lightBvh.RaycastNearest(m_viewPos,
+        m_cameraLookAt - m_viewPos, pickT);
+    if (pickedLight != LightBvh::NO_LIGHT) {
+        ImGui::Text("Light BVH: %u nodes, light %u ahead at %.1f",
+            m_lightBvh.GetBvh().GetNodeCount(), pickedLight, pickT);
+    } else {
+        ImGui::Text("Light BVH: %u nodes, no light ahead",
+            m_lightBvh.GetBvh().GetNodeCount());
+    }
     lightChanged |= ImGui::SliderFloat("lightAmbient", &m_lightingScales.x,
         0.0f, 1.0f);
     lightChanged |= ImGui::SliderFloat("lightDiffuse", &m_lightingScales.y,
@@ -719,12 +902,11 @@ void SponzaScene::defineImGui() {
         }
 
         // Type of shadow.
-        std::string currentShadowType = m_shadowTypes[m_shadowTypeIdx];
+        const std::string& currentShadowType = m_shadowTypes[m_shadowTypeIdx];
         if (ImGui::BeginCombo("Texture", currentShadowType.c_str())) {
             for (int n = 0; n < m_shadowTypes.size(); n++) {
                 bool isSelected = (currentShadowType == m_shadowTypes[n]);
                 if (ImGui::Selectable(m_shadowTypes[n].c_str(), isSelected)) {
-                    currentShadowType = m_shadowTypes[n];
                     m_shadowTypeIdx = n;
                 }
                 if (isSelected) {
@@ -752,6 +934,75 @@ void SponzaScene::defineImGui() {
     // Other settings.
     ImGui::Text("Other Settings:");
     ImGui::Checkbox("Show origin visualization", &m_showOriginVis);
+    ImGui::Checkbox("Frustum Culling", &m_useFrustumCulling);
+    if (m_useFrustumCulling) {
+        bool useBvh = m_sponzaModel->GetUseBvh();
+        if (ImGui::Checkbox("Hierarchical (BVH)", &useBvh)) {
+            m_sponzaModel->SetUseBvh(useBvh);
+        }
+        const std::string& currentOcclusionMode =
+            m_occlusionModes[static_cast<size_t>(m_occlusionMode)];
+        if (ImGui::BeginCombo("Occlusion Culling", currentOcclusionMode.c_str())) {
+            for (int n = 0; n < m_occlusionModes.size(); n++) {
+                bool isSelected = (currentOcclusionMode == m_occlusionModes[n]);
+                if (ImGui::Selectable(m_occlusionModes[n].c_str(), isSelected)) {
+                    m_occlusionMode = static_cast<OcclusionMode>(n);
+                }
+                if (isSelected) {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+            ImGui::EndCombo();
+        }
+    }
+    if (m_useFrustumCulling) {
+        ImGui::SliderFloat("Min. Screen Size (px)", &m_minScreenSize, 0.0f, 16.0f);
+        ImGui::SliderFloat("Min. Shadow Size (texels)", &m_minShadowScreenSize, 0.0f,
+            32.0f);
+        if (m_pvs.IsBaked()) {
+            ImGui::Checkbox("Potentially Visible Sets", &m_usePvs);
+            ImGui::SameLine();
+        }
+        if (m_pvsBake.valid()) {
+            ImGui::Text("Baking PVS...");
+        } else if (ImGui::Button("Bake PVS")) {
+            bakePvs();
+        }
+        if (m_pvs.IsBaked() && m_usePvs) {
+            if (m_pvsCell == Pvs::NO_CELL) {
+                ImGui::Text("PVS: camera outside of the %u cells", m_pvs.GetCellCount());
+            } else {
+                ImGui::Text("PVS: cell %u of %u, %zu meshes", m_pvsCell,
+                    m_pvs.GetCellCount(), m_pvsMeshes.size());
+            }
+        }
+    }
+    ImGui::Text("Visible meshes: camera %zu, casters %zu of %u",
+        m_cameraVisibleMeshes.size(), m_lightVisibleMeshes.size(),
+        m_sponzaModel->GetMeshCount());
+    if (m_useFrustumCulling && m_occlusionMode == OcclusionMode::SOFTWARE) {
+        ImGui::Text("Occluded meshes: %zu (%u occluder triangles)", m_occludedMeshCnt,
+            m_occlusionCuller.GetTriangleCount());
+    } else if (m_useFrustumCulling && m_occlusionMode == OcclusionMode::REPROJECTION) {
+        ImGui::Text("Occluded meshes: %zu (%u of %ux%u texels not reprojected)",
+            m_occludedMeshCnt, m_hiZCuller.GetHoleCount(), m_hiZCuller.GetWidth(),
+            m_hiZCuller.GetHeight());
+    }
+    ImGui::Text("Visible lights: %zu of %u", m_visibleLights.size(),
+        m_lightVolumes->GetInstanceCount());
+    if (usePointLights && m_lightingMode == LightingMode::TILED) {
+        ImGui::Text("Tiled lights: %u in %ux%u tiles, %zu list entries",
+            m_tiledLightCuller.GetVisibleLightCount(), m_tiledLightCuller.GetTilesX(),
+            m_tiledLightCuller.GetTilesY(), m_tiledLightCuller.GetLightIndices().size());
+    } else if (usePointLights && m_lightingMode == LightingMode::CLUSTERED) {
+        const ClusteredLightCuller& culler = m_lightLodActive ?
+            m_lodClusteredLightCuller : m_clusteredLightCuller;
+        ImGui::Text("Clustered lights: %u transformed, %u reassigned",
+            culler.GetTransformedLightCount(), culler.GetReassignedLightCount());
+        ImGui::Text("%ux%ux%u clusters, %zu entries", culler.GetClustersX(),
+            culler.GetClustersY(), culler.GetClustersZ(),
+            culler.GetLightIndices().size());
+    }
 
 
     // End of ImGui element definitions.
@@ -768,16 +1019,18 @@ void SponzaScene::defineImGui() {
         newOrientation.Normalize();
 
         // Update model.
-        ModelState* bagState = m_sponzaModel->GetState();
-        bagState->orientation = newOrientation;
+        ModelState bagState = m_sponzaModel->GetState();
+        bagState.orientation = newOrientation;
+        m_sponzaModel->SetState(bagState);
     }
 
     if (resetModelState) {
         // Reset the state of the model.
-        ModelState* bagState = m_sponzaModel->GetState();
-        bagState->position = { 0.0,0.0,0.0 };
-        bagState->orientation = sm::Quaternion::Identity;
-        bagState->scale = 1.0;
+        ModelState bagState = m_sponzaModel->GetState();
+        bagState.position = { 0.0,0.0,0.0 };
+        bagState.orientation = sm::Quaternion::Identity;
+        bagState.scale = 1.0;
+        m_sponzaModel->SetState(bagState);
         resetModelState = false;
     }
 
@@ -798,6 +1051,7 @@ void SponzaScene::defineImGui() {
 
     if (shadowMapResChanged) {
         //Resize textures.
+        ResourceRegistry::ScopedOwner resourceOwner("SponzaScene");
         initShadowTextures();
     }
 }
@@ -813,6 +1067,19 @@ void SponzaScene::update() {
     // Updates states of all models in the scene.
     updateModels();
 
+    // Use the sets of a bake that finished in the background.
+    finishPvsBake();
+
+    // Move the animated lights before they are culled.
+    if (m_animateLights) {
+        animateLights();
+    }
+
+    // Compose the matrices of all models that moved (or of all models, if the
+    // camera moved) in one batch. Shadows need the bounds of the moved models.
+    TransformSystem::Default().SetViewMatrix(m_viewMat);
+    TransformSystem::Default().Update();
+
     // Update resources related to shadow mapping.
     updateShadows();
 
@@ -898,6 +1165,560 @@ void SponzaScene::updateCamera() {
 }
 
 
+/*
+ * SponzaScene::cullModels
+ */
+void SponzaScene::cullModels() {
+    // The culling below queries the light BVH.
+    updateLights();
+
+    if (!m_useFrustumCulling) {
+        UINT32 meshCnt = m_sponzaModel->GetMeshCount();
+        m_cameraVisibleMeshes.resize(meshCnt);
+        for (UINT32 i = 0; i < meshCnt; i++) {
+            m_cameraVisibleMeshes[i] = i;
+        }
+        m_lightVisibleMeshes = m_cameraVisibleMeshes;
+
+        m_visibleLights.resize(m_lightVolumes->GetInstanceCount());
+        for (UINT32 i = 0; i < m_visibleLights.size(); i++) {
+            m_visibleLights[i] = i;
+        }
+    } else {
+        cullCameraAndLights();
+        cullShadowCasters();
+    }
+
+    bool useLightLod = usePointLights && m_useLightLod;
+    if (useLightLod != m_lightLodActive) {
+        m_lightLodActive = useLightLod;
+        m_lightLodBuilt = false;
+        m_lightInstancesChanged = true;
+    }
+
+    // With the light LOD the volumes draw less of the visible lights.
+    if (useLightLod) {
+        mergeDistantLights();
+    } else {
+        uploadLightInstances(m_visibleLights);
+    }
+
+    // The tiled and clustered lighting shade the lights of the pool, or the set of
+    // the LOD.
+    if (usePointLights && m_lightingMode != LightingMode::VOLUMES) {
+        if (useLightLod) {
+            gatherLodLights();
+        }
+        m_tiledLighting.SetLights(useLightLod ? m_lodLightBuffer.GetSrv() :
+            m_lightBuffer.GetSrv());
+    }
+    if (usePointLights && m_lightingMode == LightingMode::TILED) {
+        cullTiledLights();
+    } else if (usePointLights && m_lightingMode == LightingMode::CLUSTERED) {
+        cullClusteredLights();
+    }
+}
+
+
+/*
+ * SponzaScene::cullCameraAndLights
+ */
+void SponzaScene::cullCameraAndLights() {
+    // Camera view for the G-pass.
+    sm::Matrix viewProj = m_viewMat * m_projMat;
+    FrustumCuller::Planes cameraPlanes = FrustumCuller::ExtractPlanes(viewProj);
+    FrustumCuller::Contribution contribution = FrustumCuller::ComputeContribution(
+        viewProj, float(m_wWidth), float(m_wHeight), m_minScreenSize);
+    UINT32 pvsCell = Pvs::NO_CELL;
+    if (m_usePvs && m_pvs.IsBaked()) {
+        pvsCell = m_sponzaModel->FindPvsCell(m_pvs, m_viewPos);
+    }
+    if (pvsCell != Pvs::NO_CELL) {
+        // Sets are only decoded when the camera enters another cell.
+        if (pvsCell != m_pvsCell) {
+            m_pvs.GetVisibleMeshes(pvsCell, m_pvsMeshes);
+        }
+        m_sponzaModel->Cull(cameraPlanes, m_pvsMeshes, m_cameraVisibleMeshes,
+            contribution);
+    } else {
+        m_sponzaModel->Cull(cameraPlanes, m_cameraVisibleMeshes, contribution);
+    }
+    m_pvsCell = pvsCell;
+
+    // Hidden behind the large meshes of Sponza, or behind the depth of an earlier
+    // frame. The readback lags a few frames, until then nothing is culled.
+    m_occludedMeshCnt = 0;
+    size_t visibleCnt = m_cameraVisibleMeshes.size();
+    if (m_occlusionMode == OcclusionMode::SOFTWARE) {
+        m_occlusionCuller.BeginFrame(viewProj);
+        m_sponzaModel->AddOccluders(m_occlusionCuller);
+        m_occlusionCuller.Rasterize();
+        m_sponzaModel->CullOccluded(m_occlusionCuller, m_cameraVisibleMeshes);
+    } else if (m_occlusionMode == OcclusionMode::REPROJECTION) {
+        m_depthReadback.Read(m_hiZCuller);
+        if (m_hiZCuller.HasDepth()) {
+            m_hiZCuller.Update(viewProj);
+            m_sponzaModel->CullOccluded(m_hiZCuller, m_cameraVisibleMeshes);
+        }
+    }
+    m_occludedMeshCnt = visibleCnt - m_cameraVisibleMeshes.size();
+
+    // A light only shades the G-buffer pixels inside of its sphere, so the same
+    // tests apply. The BVH finds the lights near the frustum, the volumes are
+    // instances of the first lights of the pool.
+    m_lightBvh.QueryFrustum(cameraPlanes, m_frustumLights);
+    std::sort(m_frustumLights.begin(), m_frustumLights.end());
+    m_visibleLights.clear();
+    for (UINT32 i : m_frustumLights) {
+        if (i >= m_lightVolumes->GetInstanceCount()) {
+            break;
+        }
+        const sm::Vector4& sphere = m_lightSpheres[i];
+        dx::BoundingBox bounds(sm::Vector3(sphere.x, sphere.y, sphere.z),
+            sm::Vector3(sphere.w));
+        // The BVH holds loose bounds.
+        if (!FrustumCuller::TestBox(cameraPlanes, bounds) ||
+                !FrustumCuller::TestContribution(contribution, bounds)) {
+            continue;
+        }
+        if (m_occlusionMode == OcclusionMode::SOFTWARE &&
+                !m_occlusionCuller.TestBox(bounds)) {
+            continue;
+        }
+        if (m_occlusionMode == OcclusionMode::REPROJECTION && m_hiZCuller.HasDepth() &&
+                !m_hiZCuller.TestBox(bounds)) {
+            continue;
+        }
+        m_visibleLights.push_back(i);
+    }
+}
+
+
+/*
+ * SponzaScene::cullTiledLights
+ */
+void SponzaScene::cullTiledLights() {
+    // The occlusion culling may already have read the depth for this frame.
+    if (!m_useFrustumCulling || m_occlusionMode != OcclusionMode::REPROJECTION) {
+        m_depthReadback.Read(m_hiZCuller);
+        if (m_hiZCuller.HasDepth()) {
+            m_hiZCuller.Update(m_viewMat * m_projMat);
+        }
+    }
+
+    // The readback keeps the farthest depth of 4x4 pixels, so it only bounds the
+    // far side of a tile: lights behind all surfaces are culled, lights in front of
+    // them are kept. It is from an earlier frame; after a reprojection its holes are
+    // at the far plane and the tiles take the texels around them as well. The
+    // software occluders are from this frame and bound the tiles too.
+    UINT32 tilesX = m_tiledLightCuller.GetTilesX();
+    UINT32 tilesY = m_tiledLightCuller.GetTilesY();
+    m_tileMinDepth.assign(static_cast<size_t>(tilesX) * tilesY, 0.0f);
+    bool hasHiZ = m_hiZCuller.HasDepth() && (m_hiZCuller.GetWidth() + 3) / 4 == tilesX &&
+        (m_hiZCuller.GetHeight() + 3) / 4 == tilesY;
+    bool hasOccluders = m_useFrustumCulling &&
+        m_occlusionMode == OcclusionMode::SOFTWARE;
+    if (hasHiZ) {
+        m_hiZCuller.GetTileMaxDepth(m_wWidth, m_wHeight, TiledLightCuller::TILE_SIZE,
+            m_tileMaxDepth);
+    } else {
+        m_tileMaxDepth.assign(m_tileMinDepth.size(), 1.0f);
+    }
+    if (hasOccluders) {
+        m_occlusionCuller.GetTileMaxDepth(m_wWidth, m_wHeight,
+            TiledLightCuller::TILE_SIZE, m_tileOccluderDepth);
+        for (size_t tile = 0; tile < m_tileMaxDepth.size(); tile++) {
+            m_tileMaxDepth[tile] = std::min(m_tileMaxDepth[tile],
+                m_tileOccluderDepth[tile]);
+        }
+    }
+    if (hasHiZ || hasOccluders) {
+        m_tiledLightCuller.SetDepthBounds(m_tileMinDepth.data(), m_tileMaxDepth.data(),
+            tilesX);
+    } else {
+        m_tiledLightCuller.ClearDepthBounds();
+    }
+
+    // Only the lights in the frustum need to be projected. The set of the LOD holds
+    // no others.
+    if (m_lightLodActive) {
+        m_tiledLightCuller.Cull(m_viewMat, m_projMat, m_lodLightSpheres);
+    } else if (m_useFrustumCulling) {
+        m_tiledLightCuller.Cull(m_viewMat, m_projMat, m_lightSpheres, m_frustumLights);
+    } else {
+        m_tiledLightCuller.Cull(m_viewMat, m_projMat, m_lightSpheres);
+    }
+    m_tiledLighting.Update(m_tiledLightCuller);
+}
+
+
+/*
+ * SponzaScene::cullClusteredLights
+ */
+void SponzaScene::cullClusteredLights() {
+    // A change of the camera reassigns the lights in the view frustum, which the
+    // culler finds with the light BVH. Moved lights are reassigned by updateLights().
+    // The set of the LOD changes every frame and has a culler without a BVH, which
+    // reassigns the lights that differ from the last frame.
+    ClusteredLightCuller& culler = m_lightLodActive ? m_lodClusteredLightCuller :
+        m_clusteredLightCuller;
+    if (m_lightLodActive) {
+        m_lodClusteredLightCuller.SetLights(m_lodLightSpheres);
+    }
+    culler.SetProjection(m_projMat);
+    culler.SetView(m_viewMat);
+    culler.Update();
+    m_tiledLighting.Update(culler, m_projMat);
+}
+
+
+/*
+ * SponzaScene::updateLights
+ */
+void SponzaScene::updateLights() {
+    // Added or removed lights change the indices, which needs a new BVH. Moved
+    // lights that left their loose bounds only refit it.
+    auto loosen = [](const sm::Vector4& sphere) {
+        return sm::Vector4(sphere.x, sphere.y, sphere.z,
+            sphere.w * LIGHT_BOUNDS_SCALE + LIGHT_BOUNDS_MARGIN);
+    };
+    bool lightsChanged = m_lightPool.IsResized() ||
+        m_lightPool.GetDirtyBegin() != m_lightPool.GetDirtyEnd();
+    const std::vector<LightPool::PackedLight>& lights = m_lightPool.GetLights();
+    if (m_lightPool.IsResized()) {
+        m_lightSpheres.resize(m_lightPool.GetCount());
+        m_lightBounds.resize(m_lightPool.GetCount());
+        for (UINT32 i = 0; i < m_lightPool.GetCount(); i++) {
+            m_lightSpheres[i] = lights[i].positionRadius;
+            m_lightBounds[i] = loosen(m_lightSpheres[i]);
+        }
+        m_lightBvh.Build(m_lightBounds);
+        m_clusteredLightCuller.SetLights(m_lightBounds);
+        m_lightLodBuilt = false;
+    } else if (lightsChanged) {
+        // The LOD only covers the lights of the volumes and needs them exactly.
+        UINT32 leftCnt = 0;
+        for (UINT32 i = m_lightPool.GetDirtyBegin(); i < m_lightPool.GetDirtyEnd(); i++) {
+            const sm::Vector4& sphere = lights[i].positionRadius;
+            m_lightSpheres[i] = sphere;
+            if (m_lightLodBuilt && i < m_lightLod.GetCount()) {
+                m_lightLod.SetLight(i, sphere, LightPool::UnpackColor(lights[i].color));
+            }
+            const sm::Vector4& bounds = m_lightBounds[i];
+            float reach = sm::Vector3::Distance(sm::Vector3(sphere.x, sphere.y, sphere.z),
+                sm::Vector3(bounds.x, bounds.y, bounds.z)) + sphere.w;
+            if (reach > bounds.w) {
+                m_lightBounds[i] = loosen(sphere);
+                m_lightBvh.SetLight(i, m_lightBounds[i]);
+                m_clusteredLightCuller.SetLight(i, m_lightBounds[i]);
+                leftCnt++;
+            }
+        }
+        if (leftCnt > 0) {
+            m_lightBvh.Refit();
+        }
+        if (m_lightLodBuilt) {
+            m_lightLod.Refit();
+        }
+    }
+
+    // May grow the buffer, which replaces its view. cullModels() passes it on.
+    m_lightBuffer.Upload(m_lightPool);
+}
+
+
+/*
+ * SponzaScene::mergeDistantLights
+ */
+void SponzaScene::mergeDistantLights() {
+    // Lights added from the GUI have no volume, they are not part of the LOD.
+    if (!m_lightLodBuilt) {
+        UINT32 volumeCnt = m_lightVolumes->GetInstanceCount();
+        std::vector<sm::Vector3> colors(volumeCnt);
+        for (UINT32 i = 0; i < volumeCnt; i++) {
+            colors[i] = LightPool::UnpackColor(m_lightPool.GetLights()[i].color);
+        }
+        m_lightLod.Build(std::vector<sm::Vector4>(m_lightSpheres.begin(),
+            m_lightSpheres.begin() + volumeCnt), colors);
+        m_lightLodBuilt = true;
+    }
+
+    // Pixels per unit at a distance of 1.
+    m_lightLod.Update(m_viewPos, 0.5f * float(m_wHeight) * m_projMat._22);
+
+    // Both lists are sorted.
+    const std::vector<UINT32>& keptLights = m_lightLod.GetKeptLights();
+    m_keptVisibleLights.clear();
+    std::set_intersection(m_visibleLights.begin(), m_visibleLights.end(),
+        keptLights.begin(), keptLights.end(), std::back_inserter(m_keptVisibleLights));
+    uploadLightInstances(m_keptVisibleLights);
+
+    // The buffer of the virtual volumes keeps its last instances if there are none.
+    FrustumCuller::Planes cameraPlanes = FrustumCuller::ExtractPlanes(
+        m_viewMat * m_projMat);
+    m_virtualPositions.clear();
+    m_virtualColors.clear();
+    m_virtualScales.clear();
+    for (const LightLod::VirtualLight& light : m_lightLod.GetVirtualLights()) {
+        dx::BoundingBox bounds(light.position, sm::Vector3(light.radius));
+        if (m_useFrustumCulling && !FrustumCuller::TestBox(cameraPlanes, bounds)) {
+            continue;
+        }
+        m_virtualPositions.push_back(light.position);
+        m_virtualColors.push_back(light.color);
+        m_virtualScales.push_back(sm::Vector3(2.0f * light.radius));
+    }
+    m_visibleVirtualLights.resize(m_virtualPositions.size());
+    for (UINT32 i = 0; i < m_visibleVirtualLights.size(); i++) {
+        m_visibleVirtualLights[i] = i;
+    }
+    if (!m_virtualPositions.empty()) {
+        m_virtualLightVolumes->SetInstances(m_virtualPositions, m_virtualColors,
+            m_virtualScales);
+    }
+    m_virtualLightVolumes->SetVisibleInstances(m_visibleVirtualLights);
+}
+
+
+/*
+ * SponzaScene::gatherLodLights
+ */
+void SponzaScene::gatherLodLights() {
+    // The LOD only covers the lights of the volumes, the ones added from the GUI are
+    // always kept. Both lists are sorted. The colors of the pool hold the summed
+    // colors of the virtual lights as well.
+    const std::vector<UINT32>& keptLights = m_lightLod.GetKeptLights();
+    const std::vector<LightPool::PackedLight>& lights = m_lightPool.GetLights();
+    m_lodLightPool.Clear();
+    m_lodLightSpheres.clear();
+    auto kept = keptLights.begin();
+    auto addIfKept = [&](UINT32 i) {
+        kept = std::lower_bound(kept, keptLights.end(), i);
+        if (i >= m_lightLod.GetCount() || (kept != keptLights.end() && *kept == i)) {
+            const sm::Vector4& sphere = m_lightSpheres[i];
+            m_lodLightPool.Add(sm::Vector3(sphere.x, sphere.y, sphere.z), sphere.w,
+                LightPool::UnpackColor(lights[i].color));
+            m_lodLightSpheres.push_back(sphere);
+        }
+    };
+    if (m_useFrustumCulling) {
+        for (UINT32 i : m_frustumLights) {
+            addIfKept(i);
+        }
+    } else {
+        for (UINT32 i = 0; i < m_lightPool.GetCount(); i++) {
+            addIfKept(i);
+        }
+    }
+
+    // The virtual lights in the frustum, see mergeDistantLights().
+    for (size_t i = 0; i < m_virtualPositions.size(); i++) {
+        const sm::Vector3& position = m_virtualPositions[i];
+        float radius = 0.5f * m_virtualScales[i].x;
+        m_lodLightPool.Add(position, radius, m_virtualColors[i]);
+        m_lodLightSpheres.push_back(sm::Vector4(position.x, position.y, position.z,
+            radius));
+    }
+    m_lodLightBuffer.Upload(m_lodLightPool);
+}
+
+
+/*
+ * SponzaScene::uploadLightInstances
+ */
+void SponzaScene::uploadLightInstances(const std::vector<UINT32>& lights) {
+    // The volumes hold the instances, the visualization draws their buffer. Animated
+    // lights change every frame and are written straight from the animation, the
+    // others only when other lights are visible.
+    if (m_animateLights) {
+        void* instances = m_lightVolumes->MapVisibleInstances(
+            static_cast<UINT32>(lights.size()));
+        m_lightAnimation.WriteInstances(lights, instances,
+            m_lightVolumes->GetInstanceStride());
+        m_lightVolumes->UnmapVisibleInstances();
+    } else if (lights != m_uploadedLights || m_lightInstancesChanged) {
+        m_lightVolumes->SetVisibleInstances(lights);
+        m_uploadedLights = lights;
+        m_lightInstancesChanged = false;
+    } else {
+        return;
+    }
+    m_pointLightVisualization->ShareInstances(*m_lightVolumes);
+}
+
+
+/*
+ * SponzaScene::resetLightAnimation
+ */
+void SponzaScene::resetLightAnimation() {
+    std::vector<Light> lights = m_animateLights ?
+        SceneMath::GenerateLights(static_cast<unsigned int>(m_animatedLightCnt),
+            m_seedValue) :
+        m_lights;
+
+    // Everything runs through the pool, lights added from the GUI are dropped. The
+    // animated lights are its first ones, the GUI cannot add any while they run.
+    m_lightPool.Clear();
+    m_addedLights.clear();
+    std::vector<sm::Vector3> positions;
+    std::vector<sm::Vector3> colors;
+    std::vector<sm::Vector3> scales;
+    for (const Light& light : lights) {
+        positions.push_back(sm::Vector3(light.Position.x, light.Position.y,
+            light.Position.z));
+        colors.push_back(sm::Vector3(light.Color.x, light.Color.y, light.Color.z));
+        scales.push_back(sm::Vector3(light.Scale.x, light.Scale.y, light.Scale.z));
+        m_lightPool.Add(positions.back(), 0.5f * scales.back().x, colors.back());
+    }
+    m_lightVolumes->SetInstances(positions, colors, scales);
+    m_lightInstancesChanged = true;
+    if (!m_animateLights) {
+        m_lightAnimation.Resize(0);
+        return;
+    }
+
+    // The area of GenerateLights(), walking speed, a few flickers per second.
+    std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
+    std::default_random_engine generator(m_seedValue);
+    m_lightAnimation.Resize(static_cast<UINT32>(lights.size()));
+    m_lightAnimation.SetBounds(sm::Vector3(-111.0f, -6.0f, -49.0f),
+        sm::Vector3(139.0f, 23.0f, 54.0f));
+    for (UINT32 i = 0; i < lights.size(); i++) {
+        sm::Vector3 velocity(randomFloats(generator) - 0.5f,
+            0.2f * (randomFloats(generator) - 0.5f), randomFloats(generator) - 0.5f);
+        m_lightAnimation.SetLight(i, positions[i], 20.0f * velocity, colors[i], 1.0f,
+            0.5f * scales[i].x, randomFloats(generator),
+            0.5f + 3.0f * randomFloats(generator));
+    }
+}
+
+
+/*
+ * SponzaScene::animateLights
+ */
+void SponzaScene::animateLights() {
+    // Long frames (e.g. loading) must not move the lights through the bounds.
+    m_lightAnimation.Update(std::min(ImGui::GetIO().DeltaTime, 0.1f));
+
+    // All of them at once into the pool, the intensity is part of the color.
+    UINT32 lightCnt = m_lightAnimation.GetCount();
+    if (lightCnt > 0) {
+        m_lightAnimation.WriteLights(0, lightCnt, m_lightPool.EditLights(0, lightCnt));
+    }
+}
+
+
+/*
+ * SponzaScene::bakePvs
+ */
+void SponzaScene::bakePvs() {
+    if (m_pvsBake.valid()) {
+        return;
+    }
+
+    // The geometry is copied here, so the bake does not touch the model.
+    std::unique_ptr<Pvs> pvs = std::make_unique<Pvs>();
+    m_sponzaModel->AddPvsMeshes(*pvs);
+    m_pvsBake = std::async(std::launch::async, [pvs = std::move(pvs)]() mutable {
+        pvs->Bake(getPvsSettings());
+        pvs->ClearMeshes();
+        return std::move(pvs);
+    });
+}
+
+
+/*
+ * SponzaScene::finishPvsBake
+ */
+void SponzaScene::finishPvsBake() {
+    if (!m_pvsBake.valid() ||
+            m_pvsBake.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    m_pvs = std::move(*m_pvsBake.get());
+    m_pvsCell = Pvs::NO_CELL;
+
+    try {
+        m_pvs.Save(m_pvsPath);
+    } catch (const std::invalid_argument& e) {
+        OutputDebugStringA((std::string(e.what()) + "\n").c_str());
+    }
+
+    std::string report = "PVS: " + std::to_string(m_pvs.GetCellCount()) + " cells, " +
+        std::to_string(m_pvs.GetSetCount()) + " sets, " +
+        std::to_string(m_pvs.GetCompressedSize()) + " bytes\n";
+    OutputDebugStringA(report.c_str());
+}
+
+
+/*
+ * SponzaScene::loadPvs
+ */
+void SponzaScene::loadPvs() {
+    m_pvs = Pvs();
+    m_pvsCell = Pvs::NO_CELL;
+    if (!std::filesystem::exists(m_pvsPath)) {
+        return;
+    }
+
+    try {
+        m_pvs.Load(m_pvsPath);
+    } catch (const std::invalid_argument& e) {
+        OutputDebugStringA((std::string(e.what()) + "\n").c_str());
+        m_pvs = Pvs();
+    }
+
+    // Sets of another version of the model or of other settings would hide the
+    // wrong meshes, even with the same mesh count.
+    if (m_pvs.IsBaked()) {
+        Pvs current;
+        m_sponzaModel->AddPvsMeshes(current);
+        if (m_pvs.GetHash() != current.ComputeHash(getPvsSettings())) {
+            OutputDebugStringA("PVS: geometry or settings changed, bake again\n");
+            m_pvs = Pvs();
+        }
+    }
+}
+
+
+/*
+ * SponzaScene::getPvsSettings
+ */
+Pvs::Settings SponzaScene::getPvsSettings() {
+    return Pvs::Settings();
+}
+
+
+/*
+ * SponzaScene::cullShadowCasters
+ */
+void SponzaScene::cullShadowCasters() {
+    FrustumCuller::Planes cameraPlanes =
+        FrustumCuller::ExtractPlanes(m_viewMat * m_projMat);
+
+    // Casters: light frustum extended towards the light (see ComputeShadowMatrices)
+    // and with a shadow that reaches the camera frustum.
+    sm::Matrix lightViewProj =
+        m_directionalLightViewMat * m_directionalLightProjectionMat;
+    FrustumCuller::Planes lightPlanes = FrustumCuller::ExtractPlanes(lightViewProj);
+    FrustumCuller::DisablePlane(lightPlanes, FrustumCuller::NEAR_PLANE);
+    float shadowMapSize = float(m_shadowMapSizes[m_shadowMapSizeIdx]);
+    m_sponzaModel->Cull(lightPlanes, m_lightVisibleMeshes,
+        FrustumCuller::ComputeContribution(lightViewProj, shadowMapSize, shadowMapSize,
+            m_minShadowScreenSize));
+
+    sm::Vector3 lightDir = dx::XMVector3Normalize(-m_directionalLightPos);
+    m_sponzaModel->Cull(FrustumCuller::SweepPlanes(cameraPlanes, lightDir),
+        m_shadowReceiverMeshes);
+
+    // Both lists are sorted.
+    auto casterEnd = std::set_intersection(m_lightVisibleMeshes.begin(),
+        m_lightVisibleMeshes.end(), m_shadowReceiverMeshes.begin(),
+        m_shadowReceiverMeshes.end(), m_lightVisibleMeshes.begin());
+    m_lightVisibleMeshes.erase(casterEnd, m_lightVisibleMeshes.end());
+}
+
+
 /*
  * SponzaScene::updateBuffers
  */
@@ -919,6 +1740,7 @@ void SponzaScene::updateBuffers() {
         dataPtr->lightViewMat = m_directionalLightViewMat.Transpose();
         dataPtr->lightProjMat = m_directionalLightProjectionMat.Transpose();
         m_d3dContext->Unmap(m_sceneBufferVS.Get(), 0);
+        RenderStats::AddUpload(sizeof(VS_CONSTANT_BUFFER));
     }
 
     {
@@ -944,6 +1766,7 @@ void SponzaScene::updateBuffers() {
         dataPtr->viewPos = m_viewPos;
         dataPtr->pixelSize = m_pixelSize;
         m_d3dContext->Unmap(m_sceneBufferPS.Get(), 0);
+        RenderStats::AddUpload(sizeof(PS_CONSTANT_BUFFER));
     }
 
     {
@@ -957,6 +1780,7 @@ void SponzaScene::updateBuffers() {
         dataPtr->lightViewMat = m_directionalLightViewMat.Transpose();
         dataPtr->lightProjMat = m_directionalLightProjectionMat.Transpose();
         m_d3dContext->Unmap(m_shadowConstBufferVS.Get(), 0);
+        RenderStats::AddUpload(sizeof(VS_SHADOW_CONSTANT_BUFFER));
     }
 
     {
@@ -973,6 +1797,7 @@ void SponzaScene::updateBuffers() {
         dataPtr->shadowType = m_shadowTypeIdx;
         dataPtr->useShadows = m_useShadows;
         m_d3dContext->Unmap(m_shadowConstBufferPS.Get(), 0);
+        RenderStats::AddUpload(sizeof(PS_SHADOW_CONSTANT_BUFFER));
     }
 
     {
@@ -986,6 +1811,7 @@ void SponzaScene::updateBuffers() {
         dataPtr->modelMat = m_texVisModelMat.Transpose();
         dataPtr->projectionMat = m_texVisProjMat.Transpose();
         m_d3dContext->Unmap(m_texVisConstBuffer.Get(), 0);
+        RenderStats::AddUpload(sizeof(VS_MP_BUFFER));
     }
 
     {
@@ -998,6 +1824,7 @@ void SponzaScene::updateBuffers() {
         // Extra information for visualization quad in pixel shader stage.
         dataPtr->textureIdx = m_texVisTextureIdx;
         m_d3dContext->Unmap(m_texVisPSBuffer.Get(), 0);
+        RenderStats::AddUpload(sizeof(PS_TexVis_BUFFER));
     }
 
     {
@@ -1013,6 +1840,7 @@ void SponzaScene::updateBuffers() {
 
         // Unmap.
         m_d3dContext->Unmap(m_lightingPassQuadVSBuffer.Get(), 0);
+        RenderStats::AddUpload(sizeof(VS_MP_BUFFER));
     }
 
     {
@@ -1026,6 +1854,7 @@ void SponzaScene::updateBuffers() {
         dataPtr->modelMat = m_windowQuadModelMat.Transpose();
         dataPtr->projectionMat = m_windowQuadProjMat.Transpose();
         m_d3dContext->Unmap(m_ssaoMPBuffer.Get(), 0);
+        RenderStats::AddUpload(sizeof(VS_MP_BUFFER));
     }
 
     {
@@ -1042,6 +1871,7 @@ void SponzaScene::updateBuffers() {
         dataPtr->useSSAO = m_useSSAO;
 
         m_d3dContext->Unmap(m_ssaoParameterBuffer.Get(), 0);
+        RenderStats::AddUpload(sizeof(SSAO_PARAMETER_BUFFER));
     }
 }
 
@@ -1052,8 +1882,9 @@ void SponzaScene::updateBuffers() {
 void SponzaScene::updateModels() {
     // Update skybox cube position to match camera position. Keeps skybox
     // always infinetly far away.
-    ModelState* skyBoxState = m_skyBoxCube->GetState();
-    skyBoxState->position = m_viewPos;
+    ModelState skyBoxState = m_skyBoxCube->GetState();
+    skyBoxState.position = m_viewPos;
+    m_skyBoxCube->SetState(skyBoxState);
 }
 
 
@@ -1083,82 +1914,9 @@ void SponzaScene::updateTexVisQuad() {
  * SponzaScene::updateShadows
  */
 void SponzaScene::updateShadows() {
-    // Frustum corners of camera in normalized device coordinates (NDC). In D3D11
-    // the depth range is 0-1!
-    const std::array<sm::Vector4,8> ndcCorners = {
-        sm::Vector4(-1, -1, 0, 1), // Near bottom-left
-        sm::Vector4(1, -1, 0, 1), // Near bottom-right
-        sm::Vector4(-1,  1, 0, 1), // Near top-left
-        sm::Vector4(1,  1, 0, 1), // Near top-right
-        sm::Vector4(-1, -1, 1, 1), // Far bottom-left
-        sm::Vector4(1, -1, 1, 1), // Far bottom-right
-        sm::Vector4(-1,  1, 1, 1), // Far top-left
-        sm::Vector4(1,  1, 1, 1)  // Far top-right
-    };
-
-    // Compute the combined view-projection matrix.
-    sm::Matrix viewProjectionMatrix = m_viewMat * m_projMat;
-
-    // Invert the combined matrix
-    sm::Matrix invertedViewProjectionMatrix = viewProjectionMatrix.Invert();
-
-    // Transform NDC frustum corners to world space.
-    std::array<sm::Vector4, 8> worldSpaceCorners;
-    for (int i = 0; i < 8; i++) {
-        sm::Vector4 ndcCorner = ndcCorners[i];
-        sm::Vector4 worldSpaceCorner = sm::Vector4::Transform(ndcCorner,
-            invertedViewProjectionMatrix);
-        worldSpaceCorners[i] = worldSpaceCorner / worldSpaceCorner.w;
-    }
-
-    // Compute centroid of the frustum (world space).
-    sm::Vector3 centroid;
-    for (sm::Vector4& corner : worldSpaceCorners) {
-        centroid += sm::Vector3(corner.x, corner.y, corner.z);
-    }
-    centroid = centroid / 8.0;
-
-    // Compute temporary working position for the light.
-    sm::Vector3 lightDir = dx::XMVector3Normalize(-m_directionalLightPos);  // TODO: Separate.
-    sm::Vector3 tempPosition = centroid - m_cameraFarClip * lightDir; // Go towards light.
-
-    // lookAt view matrix that looks towards centroid.
-    sm::Matrix lightViewMat = sm::Matrix::CreateLookAt(
-        tempPosition, centroid,
-        sm::Vector3(0.0, 1.0, 0.0));
-
-    // Transform world space frustum corners into view space of light.
-    // At the same time find Min and Max X, Y and Z.
-    std::array<sm::Vector4, 8> lightViewSpaceCorners;
-    float minX = 0.0;
-    float maxX = 0.0;
-    float minY = 0.0;
-    float maxY = 0.0;
-    float minZ = 0.0;
-    float maxZ = 0.0;
-    for (int i = 0; i < 8; i++) {
-        // Transform frustum corners from world space to light view space.
-        sm::Vector4 worldCorner = worldSpaceCorners[i];
-        lightViewSpaceCorners[i] = sm::Vector4::Transform(worldCorner, lightViewMat);
-
-        // Compute Min and Max X,Y,Z.
-        minX = std::min(minX, lightViewSpaceCorners[i].x);
-        maxX = std::max(maxX, lightViewSpaceCorners[i].x);
-        
-        minY = std::min(minY, lightViewSpaceCorners[i].y);
-        maxY = std::max(maxY, lightViewSpaceCorners[i].y);
-        
-        minZ = std::min(minZ, lightViewSpaceCorners[i].z);
-        maxZ = std::max(maxZ, lightViewSpaceCorners[i].z);
-    }
-
-    // Compute off center orthographic projection matrix.
-    sm::Matrix offCenterProj = sm::Matrix::CreateOrthographicOffCenter(minX, maxX,
-        minY, maxY, maxZ, -minZ);
-
-    // Set computed matrices.
-    m_directionalLightViewMat = lightViewMat;
-    m_directionalLightProjectionMat = offCenterProj;
+    SceneMath::ComputeShadowMatrices(m_viewMat, m_projMat, m_directionalLightPos,
+        m_cameraFarClip, m_sponzaModel->GetWorldBounds(), m_directionalLightViewMat,
+        m_directionalLightProjectionMat);
 }
 
 
@@ -1210,6 +1968,8 @@ void SponzaScene::initGBuffer() {
         HRESULT hr = m_d3dDevice->CreateTexture2D(&textureDesc, nullptr,
             m_gBufferTextures[0].GetAddressOf());
         assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(m_gBufferTextures[0].Get(),
+            ResourceRegistry::Category::GBUFFER, "m_gBufferTextures[0]");
 
         // Create a RENDERTARGET view on the texture (used in geometry pass).
         D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
@@ -1247,6 +2007,8 @@ void SponzaScene::initGBuffer() {
         HRESULT hr = m_d3dDevice->CreateTexture2D(&textureDesc, nullptr,
             m_gBufferTextures[1].GetAddressOf());
         assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(m_gBufferTextures[1].Get(),
+            ResourceRegistry::Category::GBUFFER, "m_gBufferTextures[1]");
 
         // Create a RENDERTARGET view on the texture (used in geometry pass).
         D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
@@ -1285,6 +2047,8 @@ void SponzaScene::initGBuffer() {
             m_gBufferDepthTexture.GetAddressOf()
         );
         assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(m_gBufferDepthTexture.Get(),
+            ResourceRegistry::Category::GBUFFER, "m_gBufferDepthTexture");
 
         // Create depth stencil view.
         D3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc;
@@ -1314,6 +2078,10 @@ void SponzaScene::initGBuffer() {
         assert(SUCCEEDED(hr));
     }
 
+    // Downsampled copies of the depth for the reprojection occlusion culling.
+    m_depthReadback.Init(m_d3dDevice, m_d3dContext, m_wWidth, m_wHeight);
+    m_tiledLightCuller.Resize(m_wWidth, m_wHeight);
+
     // Create two textures for the lighting calculations. Will be used when
     // light volumes (spheres, ...).
     for (int i = 0; i < 2; ++i) {
@@ -1332,6 +2100,9 @@ void SponzaScene::initGBuffer() {
         HRESULT hr = m_d3dDevice->CreateTexture2D(&textureDesc, nullptr,
             m_lightingTextures[i].GetAddressOf());
         assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(m_lightingTextures[i].Get(),
+            ResourceRegistry::Category::LIGHTING,
+            "m_lightingTextures[" + std::to_string(i) + "]");
 
         // Create a RENDERTARGET view on the texture (used in geometry pass).
         D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
@@ -1425,6 +2196,8 @@ void SponzaScene::initShadows() {
         hr = m_d3dDevice->CreateBuffer(&cbDesc, &constInitData,
             m_shadowConstBufferVS.GetAddressOf());
         assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(m_shadowConstBufferVS.Get(),
+            ResourceRegistry::Category::CONSTANT_BUFFER, "m_shadowConstBufferVS");
     }
 
     {
@@ -1456,6 +2229,8 @@ void SponzaScene::initShadows() {
         hr = m_d3dDevice->CreateBuffer(&cbDesc, &constInitData,
             m_shadowConstBufferPS.GetAddressOf());
         assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(m_shadowConstBufferPS.Get(),
+            ResourceRegistry::Category::CONSTANT_BUFFER, "m_shadowConstBufferPS");
     }
         
     // Create depth stencil state.
@@ -1503,6 +2278,8 @@ void SponzaScene::initShadowTextures() {
         m_shadowMap.GetAddressOf()
     );
     assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_shadowMap.Get(),
+        ResourceRegistry::Category::SHADOW_MAP, "m_shadowMap");
 
     // Create depth stencil view.
     D3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc;
@@ -1538,56 +2315,19 @@ void SponzaScene::initShadowTextures() {
  * SponzaScene::initLights
  */
 void SponzaScene::initLights() {
-    std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // random floats between [0.0, 1.0]
-    std::seed_seq seedSequence = { m_seedValue };
-    std::default_random_engine generator(seedSequence);
-
-    for (unsigned int i = 0; i < m_NR_LIGHTS; i++) {
-        // Generate position.
-        sm::Vector3 posSample = sm::Vector3(
-            randomFloats(generator),
-            randomFloats(generator),
-            randomFloats(generator)
-        );
-
-        // Sponza relevant area for lights:
-        // X=[139,-111], Y=[-6,23],Z=[54,-49]
-        float posX = -111.0 + posSample.x * (139.0 - (-111.0));
-        float posY = -6 + posSample.y * (23.0 - (-6.0));
-        float posZ = -49 + posSample.z * (54.0 - (-49));
-
-        // Generate color.
-        sm::Vector3 colorSample = sm::Vector3(
-            randomFloats(generator),
-            randomFloats(generator),
-            randomFloats(generator)
-        );
-        //colorSample.Normalize();    // To ensure bright colors.
+    m_lights = SceneMath::GenerateLights(m_NR_LIGHTS, m_seedValue);
 
-        // Store the light.
-        Light newLight;
-        newLight.Position = sm::Vector4(posX, posY, posZ, 1.0);
-        newLight.Color = sm::Vector4(colorSample.x, colorSample.y, colorSample.z, 1.0);
-        newLight.Scale = sm::Vector4(32.0, 32.0, 32.0, 1.0);
-        m_lights.push_back(newLight);
+    // A light reaches half of its scale, its light volume covers that sphere. The
+    // pool is uploaded with the first frame.
+    m_lightPool.Clear();
+    m_addedLights.clear();
+    for (const Light& light : m_lights) {
+        m_lightPool.Add(sm::Vector3(light.Position.x, light.Position.y,
+            light.Position.z), 0.5f * light.Scale.x,
+            sm::Vector3(light.Color.x, light.Color.y, light.Color.z));
     }
-
-    D3D11_BUFFER_DESC bufferDesc;
-    ZeroMemory(&bufferDesc, sizeof(bufferDesc));
-    bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    bufferDesc.ByteWidth = sizeof(Light) * m_NR_LIGHTS;
-    bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    bufferDesc.CPUAccessFlags = 0;
-
-    // Initialize the buffer with the light data.
-    D3D11_SUBRESOURCE_DATA initData;
-    ZeroMemory(&initData, sizeof(initData));
-    initData.pSysMem = m_lights.data();
-
-    // Create the constant buffer.
-    HRESULT hr = m_d3dDevice->CreateBuffer(&bufferDesc, &initData,
-        m_lightPosColorBuffer.GetAddressOf());
-
+    m_lightBuffer.Init(m_d3dDevice, m_d3dContext);
+    m_lodLightBuffer.Init(m_d3dDevice, m_d3dContext);
 }
 
 
@@ -1625,6 +2365,8 @@ void SponzaScene::initTextureVisualization() {
     HRESULT hr = m_d3dDevice->CreateBuffer(&mpBufferDesc, &mpInitData,
         m_texVisConstBuffer.GetAddressOf());
     assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_texVisConstBuffer.Get(),
+        ResourceRegistry::Category::CONSTANT_BUFFER, "m_texVisConstBuffer");
 
     // Create the PS constant buffer.
     PS_TexVis_BUFFER psTexVisBufferData;
@@ -1649,6 +2391,8 @@ void SponzaScene::initTextureVisualization() {
     hr = m_d3dDevice->CreateBuffer(&psTexVisBufferDesc,
         &psTexVisBufferInitData, m_texVisPSBuffer.GetAddressOf());
     assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_texVisPSBuffer.Get(),
+        ResourceRegistry::Category::CONSTANT_BUFFER, "m_texVisPSBuffer");
 
     // Create texture visualization quad.In Direct3D, the origin (0, 0) for textures
     //  is typically at the top-left corner.
@@ -1730,6 +2474,8 @@ void SponzaScene::initLightingPass() {
     HRESULT hr = m_d3dDevice->CreateBuffer(&mpBufferDesc, &mpInitData,
         m_lightingPassQuadVSBuffer.GetAddressOf());
     assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_lightingPassQuadVSBuffer.Get(),
+        ResourceRegistry::Category::CONSTANT_BUFFER, "m_lightingPassQuadVSBuffer");
 
     // Create window-filling quad. In Direct3D, the origin (0, 0) for textures is
     // typically at the top-left corner.
@@ -1830,6 +2576,8 @@ void SponzaScene::initSceneBuffers() {
     HRESULT hr = m_d3dDevice->CreateBuffer(&cbDesc, &constInitData,
         m_sceneBufferVS.GetAddressOf());
     assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_sceneBufferVS.Get(),
+        ResourceRegistry::Category::CONSTANT_BUFFER, "m_sceneBufferVS");
 
     // Create constant buffer for pixel shader.
     PS_CONSTANT_BUFFER constBufferPSData = {};
@@ -1863,6 +2611,8 @@ void SponzaScene::initSceneBuffers() {
     hr = m_d3dDevice->CreateBuffer(&cbPSDesc, &constInitDataPS,
         m_sceneBufferPS.GetAddressOf());
     assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_sceneBufferPS.Get(),
+        ResourceRegistry::Category::CONSTANT_BUFFER, "m_sceneBufferPS");
 }
 
 
@@ -1886,14 +2636,8 @@ void SponzaScene::initSkyBox() {
         m_d3dContext.Get(), skyBoxTexturePath.c_str(), nullptr,
         m_skyBoxTexture.srv.GetAddressOf());
     assert(SUCCEEDED(hr));
-}
-
-
-/*
- * SponzaScene::lerp
- */
-float SponzaScene::lerp(float a, float b, float f) {
-    return a + f * (b - a);
+    ResourceRegistry::Register(m_skyBoxTexture.srv.Get(),
+        ResourceRegistry::Category::TEXTURE, "learnopengl.dds");
 }
 
 
@@ -1937,23 +2681,8 @@ void SponzaScene::initSSAO() {
     }
 
     // Create hemishphere sample kernel.
-    std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // random floats between [0.0, 1.0]
-    std::seed_seq seedSequence = { m_seedValue };
-    std::default_random_engine generator(seedSequence);
-    std::vector<sm::Vector4> ssaoKernel;
-    for (unsigned int i = 0; i < 64; ++i) {
-        sm::Vector3 sample(
-            randomFloats(generator) * 2.0 - 1.0,    // -1 to 1
-            randomFloats(generator) * 2.0 - 1.0,    // -1 to 1
-            randomFloats(generator)                 // 0 to 1
-        );
-        sample.Normalize();
-
-        float scale = (float)i / 64.0;
-        scale = lerp(0.1f, 1.0f, scale * scale);
-        sample *= scale;
-        ssaoKernel.push_back(sm::Vector4(sample.x,sample.y,sample.z,1.0));
-    }
+    std::vector<sm::Vector4> ssaoKernel = SceneMath::GenerateSSAOKernel(64,
+        m_seedValue);
 
     // Create hemisphere sample kernel constant buffer.
     {
@@ -1972,6 +2701,8 @@ void SponzaScene::initSSAO() {
         // Create the constant buffer.
         HRESULT hr = m_d3dDevice->CreateBuffer(&bufferDesc, &initData,
             m_hemisphereKernelBuffer.GetAddressOf());
+        ResourceRegistry::Register(m_hemisphereKernelBuffer.Get(),
+            ResourceRegistry::Category::SSAO, "m_hemisphereKernelBuffer");
     }
 
     // Create 4x4 random rotation vectors.
@@ -2007,6 +2738,8 @@ void SponzaScene::initSSAO() {
         HRESULT hr = m_d3dDevice->CreateTexture2D(&randomVectorTextureDesc, &initialData,
             m_randomVectorTexture.GetAddressOf());
         assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(m_randomVectorTexture.Get(),
+            ResourceRegistry::Category::SSAO, "m_randomVectorTexture");
 
         // Create a SHADER RESOURCE view on the texture.
         D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {}; // Fill in SRV description
@@ -2109,6 +2842,8 @@ void SponzaScene::initSSAO() {
         HRESULT hr = m_d3dDevice->CreateBuffer(&mpBufferDesc, &mpInitData,
             m_ssaoMPBuffer.GetAddressOf());
         assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(m_ssaoMPBuffer.Get(),
+            ResourceRegistry::Category::CONSTANT_BUFFER, "m_ssaoMPBuffer");
     }
 
     {
@@ -2138,6 +2873,8 @@ void SponzaScene::initSSAO() {
         HRESULT hr = m_d3dDevice->CreateBuffer(&mpBufferDesc, &mpInitData,
             m_ssaoParameterBuffer.GetAddressOf());
         assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(m_ssaoParameterBuffer.Get(),
+            ResourceRegistry::Category::CONSTANT_BUFFER, "m_ssaoParameterBuffer");
     }
 
     // Create the main occlusion texture and the blurred version texture.
@@ -2167,6 +2904,8 @@ void SponzaScene::initSSAOOccMaps() {
         HRESULT hr = m_d3dDevice->CreateTexture2D(&occlusionTextureDesc, nullptr,
             m_occlusionTexture.GetAddressOf());
         assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(m_occlusionTexture.Get(),
+            ResourceRegistry::Category::SSAO, "m_occlusionTexture");
 
         // Create a RENDERTARGET view on the texture.
         D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
@@ -2206,6 +2945,8 @@ void SponzaScene::initSSAOOccMaps() {
         HRESULT hr = m_d3dDevice->CreateTexture2D(&occlusionTextureDesc, nullptr,
             m_occlusionTextureBlur.GetAddressOf());
         assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(m_occlusionTextureBlur.Get(),
+            ResourceRegistry::Category::SSAO, "m_occlusionTextureBlur");
 
         // Create a RENDERTARGET view on the texture.
         D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
@@ -2330,6 +3071,10 @@ void SponzaScene::processPerformanceMetrics() {
     float msForwardPass = float(tsForwardPass - tsCombinationPass) /
         float(tsDisjoint.Frequency) * 1000.0f;
 
+    // Telemetry gets the timings of every frame.
+    Telemetry::SetGpuTimings(msFrameTime, { msLightViewPass, msGeometryPass,
+        msLightVolumePass, msSSAO, msCombinationPass, msForwardPass });
+
     // Every QUERY_BUFFER_CNT frames, the timings will be updated.
     if (m_currentQueryIdx == 0) {
         m_msFrameTime = msFrameTime;
@@ -1,6 +1,13 @@
 #pragma once
 #include "Scene.h"
 #include "ModelClass.h"
+#include "DepthReadback.h"
+#include "TiledLighting.h"
+#include "LightBuffer.h"
+#include "LightAnimation.h"
+#include "LightBvh.h"
+#include "LightLod.h"
+#include "SceneMath.h"
 
 // ImGui.
 #include "imgui.h"
@@ -19,13 +26,15 @@ public:
 
 	/// <inheritdoc />
 	virtual void Render(
-		wrl::ComPtr<ID3D11RenderTargetView>	d3dFrameBufferView,
-		wrl::ComPtr<ID3D11DepthStencilView>	d3dFrameBufferDepthStencilView)
+		const wrl::ComPtr<ID3D11RenderTargetView>&	d3dFrameBufferView,
+		const wrl::ComPtr<ID3D11DepthStencilView>&	d3dFrameBufferDepthStencilView)
 		override;
 
 	/// <inheritdoc />
 	virtual void Init() override;
 
+	typedef SceneMath::Light Light;
+
 protected:
 	/// <inheritdoc />
 	virtual void initModels() override;
@@ -49,6 +58,112 @@ private:
 	/// </summary>
 	void updateCamera();
 
+	/// <summary>
+	/// Collects the meshes of Sponza that are visible from the camera and the shadow
+	/// casters of the directional light.
+	/// </summary>
+	/// <remarks>
+	/// Casters have to be inside of the light frustum (without near plane) and their
+	/// shadow, i.e. their bounds swept along the light direction, has to reach the
+	/// camera frustum. Receivers outside of the camera frustum do not matter.
+	/// With occlusion culling, the camera meshes and the light volumes are also
+	/// tested against the occluders of Sponza rasterized from the camera, or against
+	/// the G-buffer depth of a previous frame reprojected into the camera.
+	/// Meshes, casters and light volumes that are too small on screen or in the
+	/// shadow map are dropped (contribution culling).
+	/// </remarks>
+	void cullModels();
+
+	/// <summary>
+	/// Collects the visible meshes of the camera and the visible light volumes.
+	/// </summary>
+	/// <remarks>
+	/// With a baked PVS only the meshes of the camera cell are frustum culled.
+	/// </remarks>
+	void cullCameraAndLights();
+
+	/// <summary>
+	/// Builds the light lists of the tiled lighting and uploads them.
+	/// </summary>
+	void cullTiledLights();
+
+	/// <summary>
+	/// Assigns the lights to the clusters of the clustered lighting and uploads the
+	/// lists.
+	/// </summary>
+	void cullClusteredLights();
+
+	/// <summary>
+	/// Uploads the lights of the pool that changed and updates their bounds and
+	/// m_lightBvh.
+	/// </summary>
+	/// <remarks>
+	/// The BVH and the clustered culling work on loose bounds, which only change
+	/// when a light leaves them. Lights that move a little each frame are refit and
+	/// reassigned every few frames instead of every frame.
+	/// </remarks>
+	void updateLights();
+
+	/// <summary>
+	/// Uploads the instances of the light volumes to draw, which their
+	/// visualization draws as well.
+	/// </summary>
+	/// <param name="lights">Indices of the lights, sorted.</param>
+	void uploadLightInstances(const std::vector<UINT32>& lights);
+
+	/// <summary>
+	/// Lets the light volumes draw the visible lights that m_lightLod kept and the
+	/// virtual lights it merged the others into.
+	/// </summary>
+	void mergeDistantLights();
+
+	/// <summary>
+	/// Collects the lights the tiled or clustered lighting shades with the light
+	/// LOD into m_lodLightPool: the lights in the frustum that m_lightLod kept or
+	/// does not cover, and the visible virtual lights.
+	/// </summary>
+	void gatherLodLights();
+
+	/// <summary>
+	/// Replaces all lights by m_animatedLightCnt animated ones, or by the static
+	/// m_lights if the animation is off.
+	/// </summary>
+	void resetLightAnimation();
+
+	/// <summary>
+	/// Advances the animated lights and writes them to the pool. Their instances are
+	/// written by uploadLightInstances().
+	/// </summary>
+	void animateLights();
+
+	/// <summary>
+	/// Starts baking the potentially visible sets of Sponza on a background thread,
+	/// which takes a while. Rendering goes on with the current sets.
+	/// </summary>
+	void bakePvs();
+
+	/// <summary>
+	/// Takes over the sets of a finished bake and writes them next to the model.
+	/// Does nothing while the bake is running.
+	/// </summary>
+	void finishPvsBake();
+
+	/// <summary>
+	/// Loads the sets written by bakePvs(), if there are any for this model and
+	/// they were baked from its current geometry.
+	/// </summary>
+	void loadPvs();
+
+	/// <summary>
+	/// Settings of bakePvs(). loadPvs() rejects sets baked with other settings.
+	/// </summary>
+	static Pvs::Settings getPvsSettings();
+
+	/// <summary>
+	/// Collects the shadow casters of the directional light.
+	/// </summary>
+	void cullShadowCasters();
+
 	/// <summary>
 	/// Updates all buffers on the GPU.
 	/// </summary>
@@ -164,15 +279,6 @@ private:
 	wrl::ComPtr <ID3D11Query> createDisjointQuery(
 		wrl::ComPtr<ID3D11Device> device);
 
-	/// <summary>
-	/// Linear interpolation.
-	/// </summary>
-	/// <param name="a"></param>
-	/// <param name="b"></param>
-	/// <param name="f"></param>
-	/// <returns></returns>
-	float lerp(float a, float b, float f);
-
 	// Camera.
 	sm::Matrix m_viewMat;
 	sm::Matrix m_projMat;
@@ -188,13 +294,57 @@ private:
 	const float ROTATION_GAIN = 0.04f;
 	const float MOVEMENT_GAIN = 0.37f;
 
-	// Scene ModelClass objects.
+	// Frustum culling. Visible meshes of Sponza per view, reused every frame.
+	bool m_useFrustumCulling = true;
+	std::vector<UINT32> m_cameraVisibleMeshes;
+	std::vector<UINT32> m_lightVisibleMeshes;		// Shadow casters.
+	std::vector<UINT32> m_shadowReceiverMeshes;	// Scratch memory of cullModels().
+
+	// Contribution culling: meshes and light volumes whose bounding sphere
+	// projects to fewer pixels (diameter) are dropped. Shadow map texels are
+	// larger on screen than pixels, and a missing caster leaves a hole instead of a
+	// missing detail, hence the own threshold. 0 disables.
+	float m_minScreenSize = 2.0f;
+	float m_minShadowScreenSize = 4.0f;
+
+	// Occlusion culling with a software rasterized depth buffer or with the
+	// reprojected G-buffer depth of a previous frame.
+	enum class OcclusionMode {
+		OFF,
+		SOFTWARE,
+		REPROJECTION
+	};
+	std::array<std::string, 3> m_occlusionModes = {
+	"OFF",
+	"SOFTWARE RASTERIZER",
+	"REPROJECTED DEPTH"};
+	OcclusionMode m_occlusionMode = OcclusionMode::SOFTWARE;
+	OcclusionCuller m_occlusionCuller;
+	DepthReadback m_depthReadback;
+	HiZCuller m_hiZCuller;
+	size_t m_occludedMeshCnt = 0;
+
+	// Potentially visible sets of Sponza, baked from the GUI and cached on disk.
+	Pvs m_pvs;
+	std::string m_pvsPath;
+	bool m_usePvs = true;
+	UINT32 m_pvsCell = Pvs::NO_CELL;		// Cell of m_pvsMeshes.
+	std::vector<UINT32> m_pvsMeshes;
+	std::future<std::unique_ptr<Pvs>> m_pvsBake;	// Running bake, if valid.
+	std::vector<UINT32> m_visibleLights;			// Instances of the light volumes.
+	std::vector<UINT32> m_uploadedLights;			// Last uploadLightInstances().
+	bool m_lightInstancesChanged = false;			// Since m_uploadedLights.
+
+	// Scene ModelClass objects. The meshes of Sponza are per material and many
+	// span the whole atrium, so they are split into chunks that can be culled.
+	const unsigned int SPONZA_CHUNK_TRIANGLES = 4096;
 	std::shared_ptr <ModelClass> m_sponzaModel;
 	std::shared_ptr <ModelClass> m_originVisualization;
 	std::shared_ptr <ModelClass> m_pointLightVisualization;
 	std::shared_ptr <ModelClass> m_texVisQuad;
 	std::shared_ptr <ModelClass> m_skyBoxCube;
 	std::shared_ptr <ModelClass> m_lightVolumes;
+	std::shared_ptr <ModelClass> m_virtualLightVolumes;	// Of m_lightLod.
 
 	// GUI variables.
 	bool useAnimation;
@@ -378,15 +528,62 @@ private:
 	sm::Vector3 m_lightingScales;	// Weight/scale for ambient, diffuse and specular term.
 	bool usePointLights = false;
 	float m_shininessExp;
-	struct Light {
-		sm::Vector4 Position;
-		sm::Vector4 Color;
-		sm::Vector4 Scale;
-	};
 	unsigned int m_seedValue = 42;
 	unsigned int m_NR_LIGHTS = 32;
-	std::vector<Light> m_lights;
-	wrl::ComPtr<ID3D11Buffer> m_lightPosColorBuffer;
+	std::vector<Light> m_lights;					// Of the light volumes.
+
+	// Lights of the tiled and clustered lighting, which can be added and removed at
+	// runtime. Starts with m_lights.
+	LightPool m_lightPool;
+	LightBuffer m_lightBuffer;
+	std::vector<LightPool::Handle> m_addedLights;	// From the GUI, newest last.
+	unsigned int m_addedLightSeed = 0;
+
+	// Moving and flickering lights for stress tests. Replace the static lights.
+	bool m_animateLights = false;
+	int m_animatedLightCnt = 1024;
+	LightAnimation m_lightAnimation;				// The first lights of the pool.
+
+	// Tiled or clustered lighting: a single fullscreen pass instead of the light
+	// volumes, with the lights of every tile culled on the CPU against the depth
+	// readback, or of every cluster against its bounds.
+	enum class LightingMode {
+		VOLUMES,
+		TILED,
+		CLUSTERED
+	};
+	std::array<std::string, 3> m_lightingModes = {
+	"LIGHT VOLUMES",
+	"TILED",
+	"CLUSTERED"};
+	LightingMode m_lightingMode = LightingMode::VOLUMES;
+	TiledLightCuller m_tiledLightCuller;
+	ClusteredLightCuller m_clusteredLightCuller;
+	TiledLighting m_tiledLighting;
+	std::vector<sm::Vector4> m_lightSpheres;		// Bounds of m_lightPool.
+	std::vector<sm::Vector4> m_lightBounds;			// Loose m_lightSpheres.
+	LightBvh m_lightBvh;							// Over m_lightBounds.
+	std::vector<UINT32> m_frustumLights;			// In the camera frustum, sorted.
+
+	// Light LOD: distant lights are merged into virtual ones. The light volumes draw
+	// them as instances of their own, the tiled and clustered lighting shade a set of
+	// the kept and the virtual lights that is rebuilt every frame.
+	bool m_useLightLod = false;
+	bool m_lightLodActive = false;				// In the last cullModels().
+	bool m_lightLodBuilt = false;				// Over the current light volumes.
+	LightLod m_lightLod;
+	std::vector<UINT32> m_keptVisibleLights;		// Of m_visibleLights.
+	std::vector<UINT32> m_visibleVirtualLights;
+	std::vector<sm::Vector3> m_virtualPositions;	// Instances of the volumes.
+	std::vector<sm::Vector3> m_virtualColors;
+	std::vector<sm::Vector3> m_virtualScales;
+	LightPool m_lodLightPool;						// Of the tiled and clustered lighting.
+	LightBuffer m_lodLightBuffer;
+	std::vector<sm::Vector4> m_lodLightSpheres;		// Bounds of m_lodLightPool.
+	ClusteredLightCuller m_lodClusteredLightCuller;	// Over m_lodLightSpheres.
+	std::vector<float> m_tileMinDepth;
+	std::vector<float> m_tileMaxDepth;
+	std::vector<float> m_tileOccluderDepth;
 	wrl::ComPtr < ID3D11BlendState> m_additiveBlendState;
 	wrl::ComPtr<ID3D11RasterizerState> m_rasterizerStateLightVolumes;
 
@@ -473,4 +670,9 @@ private:
 	float m_msCombinationPass = 0.0;
 	float m_msForwardPass = 0.0;
 	float m_msFrameTime = 0.0;
+
+	// Start-up timings of the init phases (see Init()).
+	std::vector<TaskGraph::TaskTiming> m_initTimings;
+	float m_msInitTotal = 0.0;
+	float m_msInitSerial = 0.0;
 };
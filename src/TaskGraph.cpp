@@ -0,0 +1,202 @@
+#include "stdafx.h"
+#include "TaskGraph.h"
+#include "WorkerPool.h"
+
+/*
+ * TaskGraph::AddTask
+ */
+unsigned int TaskGraph::AddTask(const std::string& name, std::function<void()> work,
+        const std::vector<unsigned int>& dependencies, bool usesImmediateContext) {
+    unsigned int taskId = static_cast<unsigned int>(m_tasks.size());
+
+    Task task;
+    task.name = name;
+    task.work = work;
+    task.usesImmediateContext = usesImmediateContext;
+    for (unsigned int dependency : dependencies) {
+        if (dependency >= taskId) {
+            throw std::invalid_argument("Dependency of task '" + name +
+                "' does not exist yet.");
+        }
+        m_tasks[dependency].dependents.push_back(taskId);
+        task.dependencyCnt++;
+    }
+    m_tasks.push_back(task);
+
+    return taskId;
+}
+
+
+/*
+ * TaskGraph::Run
+ */
+void TaskGraph::Run(unsigned int threadCount) {
+    // Reset scheduling state.
+    m_timings.assign(m_tasks.size(), TaskTiming());
+    for (unsigned int i = 0; i < m_tasks.size(); i++) {
+        m_tasks[i].pendingCnt = m_tasks[i].dependencyCnt;
+        m_tasks[i].started = false;
+        m_timings[i].name = m_tasks[i].name;
+    }
+    m_finishedCnt = 0;
+    m_runningCnt = 0;
+    m_contextInUse = false;
+    m_exception = nullptr;
+    m_startTime = std::chrono::steady_clock::now();
+
+    if (threadCount == 0) {
+        threadCount = WorkerPool::Get().GetWorkerCount() + 1;
+    }
+    threadCount = std::min(threadCount,
+        std::max(1u, static_cast<unsigned int>(m_tasks.size())));
+
+    if (threadCount == 1) {
+        // Dependencies always point to earlier tasks, so the insertion order is a
+        // valid execution order.
+        for (unsigned int i = 0; i < m_tasks.size(); i++) {
+            m_timings[i].startMs = elapsedMs();
+            m_tasks[i].work();
+            m_timings[i].endMs = elapsedMs();
+        }
+    } else {
+        // The calling thread works as well. Loops that start after all tasks are
+        // done return right away.
+        WorkerPool::Get().Run(threadCount, [this](unsigned int threadIdx) {
+            workerLoop(threadIdx);
+        });
+    }
+    m_totalMs = elapsedMs();
+
+    if (m_exception) {
+        std::rethrow_exception(m_exception);
+    }
+}
+
+
+/*
+ * TaskGraph::GetTimings
+ */
+const std::vector<TaskGraph::TaskTiming>& TaskGraph::GetTimings() const {
+    return m_timings;
+}
+
+
+/*
+ * TaskGraph::GetTotalMs
+ */
+float TaskGraph::GetTotalMs() const {
+    return m_totalMs;
+}
+
+
+/*
+ * TaskGraph::GetSerialMs
+ */
+float TaskGraph::GetSerialMs() const {
+    float serialMs = 0.0f;
+    for (const TaskTiming& timing : m_timings) {
+        serialMs += timing.endMs - timing.startMs;
+    }
+    return serialMs;
+}
+
+
+/*
+ * TaskGraph::Report
+ */
+void TaskGraph::Report(const std::string& title) const {
+    char line[256];
+    snprintf(line, sizeof(line), "%s: %.2f ms (%.2f ms if serial)\n", title.c_str(),
+        GetTotalMs(), GetSerialMs());
+    OutputDebugStringA(line);
+
+    for (const TaskTiming& timing : m_timings) {
+        snprintf(line, sizeof(line), "    %-28s %8.2f ms  [%8.2f - %8.2f] thread %u\n",
+            timing.name.c_str(), timing.endMs - timing.startMs, timing.startMs,
+            timing.endMs, timing.threadIdx);
+        OutputDebugStringA(line);
+    }
+}
+
+
+/*
+ * TaskGraph::workerLoop
+ */
+void TaskGraph::workerLoop(unsigned int threadIdx) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        // Done, or aborted and nothing is running anymore.
+        if (m_finishedCnt == m_tasks.size() || (m_exception && m_runningCnt == 0)) {
+            m_condition.notify_all();
+            return;
+        }
+
+        int taskIdx = m_exception ? -1 : findReadyTask();
+        if (taskIdx < 0) {
+            m_condition.wait(lock);
+            continue;
+        }
+
+        // Claim the task.
+        Task& task = m_tasks[taskIdx];
+        task.started = true;
+        m_runningCnt++;
+        if (task.usesImmediateContext) {
+            m_contextInUse = true;
+        }
+        m_timings[taskIdx].threadIdx = threadIdx;
+        m_timings[taskIdx].startMs = elapsedMs();
+
+        // Execute without holding the lock.
+        lock.unlock();
+        try {
+            task.work();
+        } catch (...) {
+            std::lock_guard<std::mutex> exceptionLock(m_mutex);
+            if (!m_exception) {
+                m_exception = std::current_exception();
+            }
+        }
+        lock.lock();
+
+        // Release dependents.
+        m_timings[taskIdx].endMs = elapsedMs();
+        if (task.usesImmediateContext) {
+            m_contextInUse = false;
+        }
+        for (unsigned int dependent : task.dependents) {
+            m_tasks[dependent].pendingCnt--;
+        }
+        m_runningCnt--;
+        m_finishedCnt++;
+        m_condition.notify_all();
+    }
+}
+
+
+/*
+ * TaskGraph::findReadyTask
+ */
+int TaskGraph::findReadyTask() const {
+    for (unsigned int i = 0; i < m_tasks.size(); i++) {
+        const Task& task = m_tasks[i];
+        if (task.started || task.pendingCnt > 0) {
+            continue;
+        }
+        if (task.usesImmediateContext && m_contextInUse) {
+            continue;
+        }
+        return static_cast<int>(i);
+    }
+    return -1;
+}
+
+
+/*
+ * TaskGraph::elapsedMs
+ */
+float TaskGraph::elapsedMs() const {
+    std::chrono::duration<float, std::milli> elapsed =
+        std::chrono::steady_clock::now() - m_startTime;
+    return elapsed.count();
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+/// <summary>
+/// Runs a set of named tasks with dependencies on the WorkerPool and measures how
+/// long every task took.
+/// </summary>
+/// <remarks>
+/// Used for scene initialization. Tasks may run graphs of their own, these share
+/// the same workers. The D3D11 device is free-threaded, the immediate context is
+/// not. Tasks that use the immediate context (e.g. texture loaders that generate
+/// mips) have to be flagged, so they never run at the same time.
+/// </remarks>
+class TaskGraph {
+public:
+    /// <summary>
+    /// Measured execution of a single task. Times are relative to the start of Run().
+    /// </summary>
+    struct TaskTiming {
+        std::string name;
+        float startMs = 0.0f;
+        float endMs = 0.0f;
+        unsigned int threadIdx = 0;
+    };
+
+    /// <summary>
+    /// Adds a task to the graph.
+    /// </summary>
+    /// <param name="name">Name of the task. Used for the timing report.</param>
+    /// <param name="work">Function that will be executed.</param>
+    /// <param name="dependencies">Ids of tasks that have to be finished first. Only
+    /// already added tasks are allowed, which keeps the graph free of cycles.
+    /// </param>
+    /// <param name="usesImmediateContext">If true, the task will not run
+    /// concurrently to other tasks that use the immediate context.</param>
+    /// <returns>Id of the task.</returns>
+    unsigned int AddTask(const std::string& name, std::function<void()> work,
+        const std::vector<unsigned int>& dependencies = {},
+        bool usesImmediateContext = false);
+
+    /// <summary>
+    /// Executes all tasks and blocks until they are done. If a task throws, the
+    /// remaining tasks are skipped and the first exception is rethrown.
+    /// </summary>
+    /// <param name="threadCount">Number of threads, including the calling one. 0
+    /// uses all workers of the pool. 1 runs all tasks in insertion order on the
+    /// calling thread.</param>
+    void Run(unsigned int threadCount = 0);
+
+    /// <summary>
+    /// Returns the timings of the last Run() in the order the tasks were added.
+    /// </summary>
+    const std::vector<TaskTiming>& GetTimings() const;
+
+    /// <summary>
+    /// Returns the wall clock time of the last Run() in milliseconds.
+    /// </summary>
+    float GetTotalMs() const;
+
+    /// <summary>
+    /// Returns the summed up time of all tasks of the last Run() in milliseconds.
+    /// The ratio to GetTotalMs() shows how much was gained by running in parallel.
+    /// </summary>
+    float GetSerialMs() const;
+
+    /// <summary>
+    /// Writes the timings of the last Run() to the debug output.
+    /// </summary>
+    /// <param name="title">Headline of the report.</param>
+    void Report(const std::string& title) const;
+
+private:
+    /// <summary>
+    /// Internal task representation.
+    /// </summary>
+    struct Task {
+        std::string name;
+        std::function<void()> work;
+        std::vector<unsigned int> dependents;   // Tasks that wait for this one.
+        unsigned int dependencyCnt = 0;         // Total number of dependencies.
+        unsigned int pendingCnt = 0;            // Unfinished dependencies.
+        bool usesImmediateContext = false;
+        bool started = false;
+    };
+
+    /// <summary>
+    /// Main loop of a worker thread.
+    /// </summary>
+    void workerLoop(unsigned int threadIdx);
+
+    /// <summary>
+    /// Returns the index of a task that can be started or -1. Has to be called
+    /// with m_mutex held.
+    /// </summary>
+    int findReadyTask() const;
+
+    /// <summary>
+    /// Returns the time since the start of Run() in milliseconds.
+    /// </summary>
+    float elapsedMs() const;
+
+    std::vector<Task> m_tasks;
+    std::vector<TaskTiming> m_timings;
+
+    // Scheduling state. Only valid during Run().
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    unsigned int m_finishedCnt = 0;
+    unsigned int m_runningCnt = 0;
+    bool m_contextInUse = false;
+    std::exception_ptr m_exception;
+    std::chrono::steady_clock::time_point m_startTime;
+    float m_totalMs = 0.0f;
+};
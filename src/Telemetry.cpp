@@ -0,0 +1,361 @@
+#include "stdafx.h"
+#include "Telemetry.h"
+#include "AllocationTracker.h"
+#include "Platform.h"
+
+// GPU resources only exist in the application.
+#ifndef PORTABLE_CORE
+#include "ResourceRegistry.h"
+#endif
+
+// The reader gives up after the publisher sent nothing for this long.
+static const std::chrono::milliseconds READER_TIMEOUT(5000);
+
+/// <summary>
+/// Start of the shared memory.
+/// </summary>
+struct SharedHeader {
+    UINT32 magic;
+    UINT32 version;
+    UINT32 slotCount;
+    UINT32 frameSize;
+    std::atomic<UINT64> writeIdx;           // Number of published frames.
+    std::atomic<UINT32> publisherAlive;
+    UINT32 padding;
+};
+
+/// <summary>
+/// Slot of the ring. sequence is 2 * frame number + 1 while being written and
+/// 2 * frame number + 2 once complete.
+/// </summary>
+struct SharedSlot {
+    std::atomic<UINT64> sequence;
+    Telemetry::Frame frame;
+};
+
+static_assert(std::atomic<UINT64>::is_always_lock_free,
+    "Shared memory atomics have to be lock-free.");
+static_assert(std::is_trivially_copyable<Telemetry::Frame>::value,
+    "Telemetry::Frame is copied with memcpy.");
+
+static const size_t MAPPING_SIZE = sizeof(SharedHeader) +
+    Telemetry::SLOT_COUNT * sizeof(SharedSlot);
+
+/// <summary>
+/// State of the publisher. Only touched by the render thread.
+/// </summary>
+struct TelemetryState {
+    std::string mappingName;
+    SharedHeader* header = nullptr;
+    SharedSlot* slots = nullptr;
+    Telemetry::Frame staged = {};
+    UINT64 frameIdx = 0;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+static TelemetryState g_telemetry;
+
+
+/*
+ * Telemetry::Initialize
+ */
+bool Telemetry::Initialize(const std::string& mappingName) {
+    if (g_telemetry.header) {
+        return true;
+    }
+
+    bool existed = false;
+    void* view = Platform::CreateSharedMemory(mappingName, MAPPING_SIZE, existed);
+    if (!view) {
+        OutputDebugStringA("Telemetry: Could not create shared memory.\n");
+        return false;
+    }
+    SharedHeader* header = existed ? static_cast<SharedHeader*>(view) :
+        new (view) SharedHeader();
+
+    // The ring of another instance stays untouched. If the previous owner shut
+    // down, the ring is taken over, possibly while readers still have it mapped.
+    UINT32 alive = 0;
+    if (!header->publisherAlive.compare_exchange_strong(alive, 1,
+            std::memory_order_acq_rel)) {
+        Platform::CloseSharedMemory(view, MAPPING_SIZE);
+        OutputDebugStringA("Telemetry: Another instance is publishing already.\n");
+        return false;
+    }
+    SharedSlot* slots = reinterpret_cast<SharedSlot*>(header + 1);
+    if (existed) {
+        header->writeIdx.store(0, std::memory_order_relaxed);
+        for (UINT32 i = 0; i < SLOT_COUNT; i++) {
+            slots[i].sequence.store(0, std::memory_order_relaxed);
+        }
+    }
+    header->magic = MAGIC;
+    header->version = VERSION;
+    header->slotCount = SLOT_COUNT;
+    header->frameSize = sizeof(Frame);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    g_telemetry.mappingName = mappingName;
+    g_telemetry.header = header;
+    g_telemetry.slots = slots;
+    g_telemetry.frameIdx = 0;
+    g_telemetry.startTime = std::chrono::steady_clock::now();
+
+    return true;
+}
+
+
+/*
+ * Telemetry::Shutdown
+ */
+void Telemetry::Shutdown() {
+    if (!g_telemetry.header) {
+        return;
+    }
+    g_telemetry.header->publisherAlive.store(0, std::memory_order_release);
+    Platform::CloseSharedMemory(g_telemetry.header, MAPPING_SIZE);
+    Platform::RemoveSharedMemory(g_telemetry.mappingName);
+    g_telemetry.header = nullptr;
+    g_telemetry.slots = nullptr;
+}
+
+
+/*
+ * Telemetry::SetGpuTimings
+ */
+void Telemetry::SetGpuTimings(float frameMs,
+        const std::array<float, GPU_PASS_COUNT>& passMs) {
+    g_telemetry.staged.gpuFrameMs = frameMs;
+    for (UINT32 i = 0; i < GPU_PASS_COUNT; i++) {
+        g_telemetry.staged.gpuPassMs[i] = passMs[i];
+    }
+}
+
+
+/*
+ * Telemetry::PublishFrame
+ */
+void Telemetry::PublishFrame(float cpuFrameMs) {
+    if (!g_telemetry.header) {
+        return;
+    }
+
+    // Complete the staged frame.
+    Frame& frame = g_telemetry.staged;
+    frame.frameIdx = g_telemetry.frameIdx;
+    frame.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - g_telemetry.startTime).count();
+    frame.cpuFrameMs = cpuFrameMs;
+    for (size_t i = 0; i < static_cast<size_t>(RenderStats::Counter::COUNT); i++) {
+        frame.counters[i] = RenderStats::GetFrameTotal(
+            static_cast<RenderStats::Counter>(i));
+    }
+    for (size_t i = 0; i < static_cast<size_t>(RenderStats::Pass::COUNT); i++) {
+        frame.passDrawCalls[i] = static_cast<UINT32>(RenderStats::Get(
+            static_cast<RenderStats::Pass>(i), RenderStats::Counter::DRAW_CALLS));
+    }
+#ifndef PORTABLE_CORE
+    frame.gpuMemoryBytes = ResourceRegistry::GetTotalBytes();
+#endif
+    AllocationTracker::FrameStats allocations = AllocationTracker::GetLastFrameStats();
+    frame.allocCount = allocations.allocCount;
+    frame.allocBytes = allocations.allocBytes;
+
+    // Seqlock write.
+    UINT64 idx = g_telemetry.frameIdx++;
+    SharedSlot& slot = g_telemetry.slots[idx % SLOT_COUNT];
+    slot.sequence.store(2 * idx + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot.frame, &frame, sizeof(Frame));
+    slot.sequence.store(2 * idx + 2, std::memory_order_release);
+    g_telemetry.header->writeIdx.store(idx + 1, std::memory_order_release);
+}
+
+
+/*
+ * Telemetry::Reader::~Reader
+ */
+Telemetry::Reader::~Reader() {
+    Platform::CloseSharedMemory(m_view, MAPPING_SIZE);
+}
+
+
+/*
+ * Telemetry::Reader::Open
+ */
+bool Telemetry::Reader::Open(const std::string& mappingName) {
+    Platform::CloseSharedMemory(m_view, MAPPING_SIZE);
+    m_view = Platform::OpenSharedMemory(mappingName, MAPPING_SIZE);
+    if (!m_view) {
+        return false;
+    }
+
+    const SharedHeader* header = static_cast<const SharedHeader*>(m_view);
+    if (header->magic != MAGIC || header->version != VERSION ||
+            header->frameSize != sizeof(Frame)) {
+        UINT32 version = header->version;
+        Platform::CloseSharedMemory(m_view, MAPPING_SIZE);
+        m_view = nullptr;
+        throw std::runtime_error("Telemetry layout does not match (version " +
+            std::to_string(version) + ").");
+    }
+
+    // Start with the most recent frame.
+    m_readIdx = header->writeIdx.load(std::memory_order_acquire);
+    m_lostFrames = 0;
+    return true;
+}
+
+
+/*
+ * Telemetry::Reader::IsPublisherAlive
+ */
+bool Telemetry::Reader::IsPublisherAlive() const {
+    return m_view && static_cast<const SharedHeader*>(m_view)->publisherAlive.load(
+        std::memory_order_acquire) != 0;
+}
+
+
+/*
+ * Telemetry::Reader::ReadNext
+ */
+bool Telemetry::Reader::ReadNext(Frame& frame) {
+    if (!m_view) {
+        return false;
+    }
+    const SharedHeader* header = static_cast<const SharedHeader*>(m_view);
+    const SharedSlot* slots = reinterpret_cast<const SharedSlot*>(header + 1);
+
+    while (true) {
+        // A publisher that took over the ring counts from 0 again.
+        UINT64 writeIdx = header->writeIdx.load(std::memory_order_acquire);
+        if (writeIdx < m_readIdx) {
+            m_readIdx = writeIdx;
+        }
+        if (m_readIdx == writeIdx) {
+            return false;
+        }
+
+        // Skip what was overwritten already.
+        if (writeIdx - m_readIdx > SLOT_COUNT) {
+            m_lostFrames += writeIdx - m_readIdx - SLOT_COUNT;
+            m_readIdx = writeIdx - SLOT_COUNT;
+        }
+
+        // Seqlock read. The slot may get overwritten while being copied.
+        const SharedSlot& slot = slots[m_readIdx % SLOT_COUNT];
+        UINT64 expected = 2 * m_readIdx + 2;
+        UINT64 before = slot.sequence.load(std::memory_order_acquire);
+        memcpy(&frame, &slot.frame, sizeof(Frame));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        UINT64 after = slot.sequence.load(std::memory_order_relaxed);
+        m_readIdx++;
+        if (before == expected && after == expected) {
+            return true;
+        }
+        m_lostFrames++;
+    }
+}
+
+
+/*
+ * Telemetry::Reader::GetLostFrameCount
+ */
+UINT64 Telemetry::Reader::GetLostFrameCount() const {
+    return m_lostFrames;
+}
+
+
+/*
+ * Telemetry::RunReader
+ */
+int Telemetry::RunReader(const std::string& outputPath) {
+    // The application has no console of its own. Use the one it was started from.
+    Platform::AttachParentConsole();
+
+    std::ofstream file;
+    if (!outputPath.empty()) {
+        file.open(outputPath);
+        if (!file.is_open()) {
+            printf("Could not open %s.\n", outputPath.c_str());
+            return 1;
+        }
+    }
+
+    // Wait for a publisher.
+    Reader reader;
+    try {
+        for (int attempt = 0; attempt < 100 && !reader.Open(); attempt++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    } catch (const std::runtime_error& e) {
+        printf("%s\n", e.what());
+        return 1;
+    }
+    if (!reader.IsPublisherAlive()) {
+        printf("No telemetry publisher found.\n");
+        return 1;
+    }
+
+    // CSV header.
+    std::string line = "frame,time_us,cpu_ms,gpu_ms";
+    const char* passNames[GPU_PASS_COUNT] = { "light_view", "geometry",
+        "light_volumes", "ssao", "lighting", "forward" };
+    for (const char* passName : passNames) {
+        line += std::string(",gpu_") + passName + "_ms";
+    }
+    for (size_t i = 0; i < static_cast<size_t>(RenderStats::Counter::COUNT); i++) {
+        line += std::string(",") + RenderStats::GetCounterName(
+            static_cast<RenderStats::Counter>(i));
+    }
+    for (size_t i = 0; i < static_cast<size_t>(RenderStats::Pass::COUNT); i++) {
+        line += std::string(",draws_") +
+            RenderStats::GetPassName(static_cast<RenderStats::Pass>(i));
+    }
+    line += ",gpu_memory_bytes,alloc_count,alloc_bytes,lost_frames\n";
+    printf("%s", line.c_str());
+    file << line;
+
+    // Sleeping 1 ms takes up to a timer tick (15.6 ms by default on Windows), so
+    // the idle time is measured instead of counted.
+    auto lastFrameTime = std::chrono::steady_clock::now();
+    Frame frame;
+    while (reader.IsPublisherAlive()) {
+        if (!reader.ReadNext(frame)) {
+            if (std::chrono::steady_clock::now() - lastFrameTime >= READER_TIMEOUT) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        lastFrameTime = std::chrono::steady_clock::now();
+
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "%llu,%llu,%.3f,%.3f",
+            static_cast<unsigned long long>(frame.frameIdx),
+            static_cast<unsigned long long>(frame.timestampUs), frame.cpuFrameMs,
+            frame.gpuFrameMs);
+        line = buffer;
+        for (float passMs : frame.gpuPassMs) {
+            snprintf(buffer, sizeof(buffer), ",%.3f", passMs);
+            line += buffer;
+        }
+        for (UINT64 counter : frame.counters) {
+            line += "," + std::to_string(counter);
+        }
+        for (UINT32 drawCalls : frame.passDrawCalls) {
+            line += "," + std::to_string(drawCalls);
+        }
+        snprintf(buffer, sizeof(buffer), ",%llu,%llu,%llu,%llu\n",
+            static_cast<unsigned long long>(frame.gpuMemoryBytes),
+            static_cast<unsigned long long>(frame.allocCount),
+            static_cast<unsigned long long>(frame.allocBytes),
+            static_cast<unsigned long long>(reader.GetLostFrameCount()));
+        line += buffer;
+        printf("%s", line.c_str());
+        file << line;
+    }
+    fflush(stdout);
+
+    return 0;
+}
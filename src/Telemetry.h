@@ -0,0 +1,123 @@
+#pragma once
+#include "RenderStats.h"
+
+/// <summary>
+/// Streams per-frame statistics into a named shared memory ring buffer, so long
+/// runs can be watched from another process.
+/// </summary>
+/// <remarks>
+/// The ring has a single writer (the render thread) and any number of readers.
+/// Every slot is guarded by a sequence number (seqlock): the writer marks the slot
+/// as busy, copies the frame and publishes the new sequence number. Readers copy a
+/// slot and discard it, if the sequence number changed in the meantime. Publishing
+/// therefore never waits. A slow reader only loses frames.
+/// The reader is part of the executable (--telemetry-reader) and prints CSV.
+/// Only one publisher can own a ring. A second instance leaves it alone.
+/// </remarks>
+class Telemetry {
+public:
+    // Identification of the shared memory layout. Bump the version if Frame changes.
+    static const UINT32 MAGIC = 0x544C4D54;     // "TMLT"
+    static const UINT32 VERSION = 1;
+    static const UINT32 SLOT_COUNT = 256;
+    static const UINT32 GPU_PASS_COUNT = 6;
+
+    // Name of the shared memory, see Platform::CreateSharedMemory.
+    static constexpr const char* MAPPING_NAME = "d3d11_project_telemetry";
+
+    /// <summary>
+    /// Statistics of a single frame. Plain data with a fixed layout, since it gets
+    /// copied into shared memory.
+    /// </summary>
+    struct Frame {
+        UINT64 frameIdx;
+        UINT64 timestampUs;         // Since the publisher started.
+        float cpuFrameMs;           // Time between two published frames.
+        float gpuFrameMs;
+        float gpuPassMs[GPU_PASS_COUNT];    // Light view, geometry, light volumes,
+                                            // SSAO, lighting, forward.
+        UINT64 counters[static_cast<size_t>(RenderStats::Counter::COUNT)];
+        UINT32 passDrawCalls[static_cast<size_t>(RenderStats::Pass::COUNT)];
+        UINT64 gpuMemoryBytes;
+        UINT64 allocCount;
+        UINT64 allocBytes;
+    };
+
+    /// <summary>
+    /// Reads the frames of a publisher in order. Not thread-safe.
+    /// </summary>
+    class Reader {
+    public:
+        Reader() = default;
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        ~Reader();
+
+        /// <summary>
+        /// Attaches to the ring of a publisher. Reading starts with the next frame
+        /// published. Throws std::runtime_error, if the ring has a different
+        /// layout.
+        /// </summary>
+        /// <returns>False if there is no publisher.</returns>
+        bool Open(const std::string& mappingName = MAPPING_NAME);
+
+        /// <summary>
+        /// Returns true while the publisher has not shut down.
+        /// </summary>
+        bool IsPublisherAlive() const;
+
+        /// <summary>
+        /// Copies the oldest frame that was not read yet. Frames that were
+        /// overwritten before they could be read are skipped and counted as lost.
+        /// </summary>
+        /// <returns>False if all published frames were read.</returns>
+        bool ReadNext(Frame& frame);
+
+        /// <summary>
+        /// Returns the number of frames skipped so far.
+        /// </summary>
+        UINT64 GetLostFrameCount() const;
+
+    private:
+        const void* m_view = nullptr;
+        UINT64 m_readIdx = 0;
+        UINT64 m_lostFrames = 0;
+    };
+
+    /// <summary>
+    /// Creates the shared memory, or takes over the ring of a publisher that shut
+    /// down. Fails if another publisher is alive. Publishing is a no-op if this
+    /// failed.
+    /// </summary>
+    /// <returns>True on success.</returns>
+    static bool Initialize(const std::string& mappingName = MAPPING_NAME);
+
+    /// <summary>
+    /// Marks the publisher as gone and releases the shared memory.
+    /// </summary>
+    static void Shutdown();
+
+    /// <summary>
+    /// Stores the GPU timings that will be sent with the next published frame.
+    /// </summary>
+    /// <param name="frameMs">GPU time of the whole frame.</param>
+    /// <param name="passMs">GPU time per pass.</param>
+    static void SetGpuTimings(float frameMs,
+        const std::array<float, GPU_PASS_COUNT>& passMs);
+
+    /// <summary>
+    /// Collects counters and memory totals of the last frame and writes them into
+    /// the ring. Has to be called by the render thread once per frame.
+    /// </summary>
+    /// <param name="cpuFrameMs">CPU time of the frame.</param>
+    static void PublishFrame(float cpuFrameMs);
+
+    /// <summary>
+    /// Reads frames of a running publisher and prints them as CSV to the console
+    /// of the parent process (and optionally to a file). Returns once the publisher
+    /// shut down or sent nothing for a few seconds.
+    /// </summary>
+    /// <param name="outputPath">CSV file. Empty for console output only.</param>
+    /// <returns>Process exit code.</returns>
+    static int RunReader(const std::string& outputPath);
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+/// <summary>
+/// Memory footprint of DXGI formats. Used by ResourceRegistry to account the size
+/// of textures.
+/// </summary>
+class TextureFormat {
+public:
+    /// <summary>
+    /// Returns the bits per pixel (or per texel for block compressed formats) of a
+    /// DXGI format. Adapted from DirectXTex.
+    /// </summary>
+    /// <param name="format">DXGI format.</param>
+    /// <returns>Bits per pixel. 0 if the format is unknown.</returns>
+    static unsigned int BitsPerPixel(DXGI_FORMAT format);
+
+    /// <summary>
+    /// Returns true for BC1-BC7 formats.
+    /// </summary>
+    static bool IsBlockCompressed(DXGI_FORMAT format);
+
+    /// <summary>
+    /// Computes the size of a single 2D surface (one mip of one slice). Handles
+    /// block compressed, packed and planar formats.
+    /// </summary>
+    /// <param name="format">DXGI format.</param>
+    /// <param name="width">Width in pixels.</param>
+    /// <param name="height">Height in pixels.</param>
+    /// <returns>Size in bytes.</returns>
+    static UINT64 ComputeSurfaceSize(DXGI_FORMAT format, unsigned int width,
+        unsigned int height);
+
+    /// <summary>
+    /// Computes the size of a texture including all mip levels, array slices and
+    /// samples.
+    /// </summary>
+    /// <param name="format">DXGI format.</param>
+    /// <param name="width">Width of the top mip level.</param>
+    /// <param name="height">Height of the top mip level (1 for 1D textures).</param>
+    /// <param name="depth">Depth of the top mip level (1 for 1D/2D textures).</param>
+    /// <param name="mipLevels">Number of mip levels. 0 means full mip chain.</param>
+    /// <param name="arraySize">Number of array slices (6 per cube).</param>
+    /// <param name="sampleCount">MSAA sample count.</param>
+    /// <returns>Size in bytes.</returns>
+    static UINT64 ComputeTextureSize(DXGI_FORMAT format, unsigned int width,
+        unsigned int height, unsigned int depth, unsigned int mipLevels,
+        unsigned int arraySize, unsigned int sampleCount);
+};
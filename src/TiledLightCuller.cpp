@@ -0,0 +1,490 @@
+#include "stdafx.h"
+#include "TiledLightCuller.h"
+#include "WorkerPool.h"
+
+// SSE.
+#include <immintrin.h>
+
+
+// Lights a thread projects at once.
+static const UINT32 LIGHT_BLOCK_SIZE = 256;
+
+
+/*
+ * TiledLightCuller::Resize
+ */
+void TiledLightCuller::Resize(UINT32 width, UINT32 height) {
+    assert(width > 0 && height > 0);
+    m_width = width;
+    m_height = height;
+    m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    m_rowPitch = (m_tilesX + 3) & ~3u;
+    m_rowLights.resize(m_tilesY);
+    m_tileLights.resize(static_cast<size_t>(m_tilesX) * m_tilesY);
+    m_tileRanges.assign(m_tileLights.size(), { 0, 0 });
+    m_lightIndices.clear();
+    ClearDepthBounds();
+}
+
+
+/*
+ * TiledLightCuller::SetDepthBounds
+ */
+void TiledLightCuller::SetDepthBounds(const float* minDepth, const float* maxDepth,
+        size_t rowPitch) {
+    assert(rowPitch >= m_tilesX);
+    for (UINT32 y = 0; y < m_tilesY; y++) {
+        std::memcpy(&m_minDepth[static_cast<size_t>(y) * m_rowPitch],
+            minDepth + y * rowPitch, m_tilesX * sizeof(float));
+        std::memcpy(&m_maxDepth[static_cast<size_t>(y) * m_rowPitch],
+            maxDepth + y * rowPitch, m_tilesX * sizeof(float));
+        m_rowDepth[y] = { *std::min_element(minDepth + y * rowPitch,
+            minDepth + y * rowPitch + m_tilesX), *std::max_element(
+            maxDepth + y * rowPitch, maxDepth + y * rowPitch + m_tilesX) };
+    }
+}
+
+
+/*
+ * TiledLightCuller::ClearDepthBounds
+ */
+void TiledLightCuller::ClearDepthBounds() {
+    m_minDepth.assign(static_cast<size_t>(m_rowPitch) * m_tilesY, 0.0f);
+    m_maxDepth.assign(static_cast<size_t>(m_rowPitch) * m_tilesY, 1.0f);
+    m_rowDepth.assign(m_tilesY, { 0.0f, 1.0f });
+}
+
+
+/*
+ * TiledLightCuller::Cull
+ */
+void TiledLightCuller::Cull(const sm::Matrix& viewMat, const sm::Matrix& projMat,
+        const std::vector<sm::Vector4>& lights) {
+    cull(viewMat, projMat, lights, nullptr);
+}
+
+
+/*
+ * TiledLightCuller::Cull
+ */
+void TiledLightCuller::Cull(const sm::Matrix& viewMat, const sm::Matrix& projMat,
+        const std::vector<sm::Vector4>& lights, const std::vector<UINT32>& lightIds) {
+    assert(std::is_sorted(lightIds.begin(), lightIds.end()));
+    m_candidates.resize(lightIds.size());
+    for (size_t i = 0; i < lightIds.size(); i++) {
+        m_candidates[i] = lights[lightIds[i]];
+    }
+    cull(viewMat, projMat, m_candidates, &lightIds);
+}
+
+
+/*
+ * TiledLightCuller::cull
+ */
+void TiledLightCuller::cull(const sm::Matrix& viewMat, const sm::Matrix& projMat,
+        const std::vector<sm::Vector4>& lights, const std::vector<UINT32>* lightIds) {
+    assert(m_tilesX > 0);
+    assert(projMat._34 == -1.0f && projMat._44 == 0.0f);
+
+    // Clip space of a right-handed perspective: w is the depth in front of the eye,
+    // x / w = _11 * x / depth - _31.
+    Projection projection;
+    projection.viewMat = viewMat;
+    projection.scaleX = projMat._11;
+    projection.scaleY = projMat._22;
+    projection.offsetX = -projMat._31;
+    projection.offsetY = -projMat._32;
+    projection.depthScale = projMat._43;
+    projection.depthOffset = -projMat._33;
+    projection.nearPlane = projMat._43 / projMat._33;
+
+    m_footprints.resize(lights.size());
+    UINT32 blockCnt = static_cast<UINT32>(
+        (lights.size() + LIGHT_BLOCK_SIZE - 1) / LIGHT_BLOCK_SIZE);
+    auto projectBlock = [this, &projection, &lights](UINT32 block) {
+        size_t first = static_cast<size_t>(block) * LIGHT_BLOCK_SIZE;
+        size_t last = std::min(first + LIGHT_BLOCK_SIZE, lights.size());
+        if (m_path == Path::SSE) {
+            projectSse(projection, lights, first, last);
+        } else {
+            projectScalar(projection, lights, first, last);
+        }
+    };
+
+    // Rows get the lights in ascending order, so do the tiles. A light that misses
+    // the depth range of a whole row needs no tile tests.
+    auto binRows = [this]() {
+        for (std::vector<UINT32>& row : m_rowLights) {
+            row.clear();
+        }
+        m_visibleLightCnt = 0;
+        for (UINT32 i = 0; i < m_footprints.size(); i++) {
+            const Footprint& footprint = m_footprints[i];
+            if (footprint.x0 > footprint.x1) {
+                continue;
+            }
+            m_visibleLightCnt++;
+            for (INT32 y = footprint.y0; y <= footprint.y1; y++) {
+                if (footprint.minDepth <= m_rowDepth[y].second &&
+                        footprint.maxDepth >= m_rowDepth[y].first) {
+                    m_rowLights[y].push_back(i);
+                }
+            }
+        }
+    };
+
+    auto cullRow = [this](UINT32 row) {
+        if (m_path == Path::SSE) {
+            cullRowSse(row);
+        } else {
+            cullRowScalar(row);
+        }
+    };
+
+    if (m_threadCnt <= 1) {
+        for (UINT32 block = 0; block < blockCnt; block++) {
+            projectBlock(block);
+        }
+        binRows();
+        for (UINT32 row = 0; row < m_tilesY; row++) {
+            cullRow(row);
+        }
+    } else {
+        // Threads take the next free block of lights, then the next free row.
+        std::atomic<UINT32> nextBlock = 0;
+        std::atomic<UINT32> nextRow = 0;
+        WorkerPool& pool = WorkerPool::Get();
+        pool.Run(m_threadCnt, [&nextBlock, blockCnt, &projectBlock](unsigned int) {
+            for (UINT32 block = nextBlock++; block < blockCnt; block = nextBlock++) {
+                projectBlock(block);
+            }
+        });
+        binRows();
+        pool.Run(m_threadCnt, [this, &nextRow, &cullRow](unsigned int) {
+            for (UINT32 row = nextRow++; row < m_tilesY; row = nextRow++) {
+                cullRow(row);
+            }
+        });
+    }
+
+    // Compaction.
+    UINT32 offset = 0;
+    for (size_t tile = 0; tile < m_tileLights.size(); tile++) {
+        UINT32 count = static_cast<UINT32>(m_tileLights[tile].size());
+        m_tileRanges[tile] = { offset, count };
+        offset += count;
+    }
+    m_lightIndices.resize(offset);
+    for (size_t tile = 0; tile < m_tileLights.size(); tile++) {
+        std::copy(m_tileLights[tile].begin(), m_tileLights[tile].end(),
+            m_lightIndices.begin() + m_tileRanges[tile].offset);
+    }
+    if (lightIds != nullptr) {
+        for (UINT32& lightIdx : m_lightIndices) {
+            lightIdx = (*lightIds)[lightIdx];
+        }
+    }
+}
+
+
+/*
+ * TiledLightCuller::SetPath
+ */
+void TiledLightCuller::SetPath(Path path) {
+    m_path = path;
+}
+
+
+/*
+ * TiledLightCuller::GetPath
+ */
+TiledLightCuller::Path TiledLightCuller::GetPath() const {
+    return m_path;
+}
+
+
+/*
+ * TiledLightCuller::SetThreadCount
+ */
+void TiledLightCuller::SetThreadCount(UINT32 threadCnt) {
+    m_threadCnt = std::max(threadCnt, 1u);
+}
+
+
+/*
+ * TiledLightCuller::GetTilesX
+ */
+UINT32 TiledLightCuller::GetTilesX() const {
+    return m_tilesX;
+}
+
+
+/*
+ * TiledLightCuller::GetTilesY
+ */
+UINT32 TiledLightCuller::GetTilesY() const {
+    return m_tilesY;
+}
+
+
+/*
+ * TiledLightCuller::GetTileRanges
+ */
+const std::vector<TiledLightCuller::TileRange>& TiledLightCuller::GetTileRanges() const {
+    return m_tileRanges;
+}
+
+
+/*
+ * TiledLightCuller::GetLightIndices
+ */
+const std::vector<UINT32>& TiledLightCuller::GetLightIndices() const {
+    return m_lightIndices;
+}
+
+
+/*
+ * TiledLightCuller::GetVisibleLightCount
+ */
+UINT32 TiledLightCuller::GetVisibleLightCount() const {
+    return m_visibleLightCnt;
+}
+
+
+/*
+ * TiledLightCuller::projectScalar
+ */
+void TiledLightCuller::projectScalar(const Projection& projection,
+        const std::vector<sm::Vector4>& lights, size_t first, size_t last) {
+    const sm::Matrix& m = projection.viewMat;
+    float halfTilesX = 0.5f * m_width / TILE_SIZE;
+    float halfTilesY = 0.5f * m_height / TILE_SIZE;
+    float lastX = float(m_tilesX - 1);
+    float lastY = float(m_tilesY - 1);
+
+    for (size_t i = first; i < last; i++) {
+        const sm::Vector4& light = lights[i];
+        Footprint& footprint = m_footprints[i];
+        footprint = { 0, 0, -1, -1, 0.0f, 0.0f };
+
+        float viewX = light.x * m._11 + light.y * m._21 + light.z * m._31 + m._41;
+        float viewY = light.x * m._12 + light.y * m._22 + light.z * m._32 + m._42;
+        float depth = -(light.x * m._13 + light.y * m._23 + light.z * m._33 + m._43);
+        float radius = light.w;
+        if (depth + radius <= projection.nearPlane) {
+            continue;   // Behind the eye.
+        }
+        float minDepth = projection.depthOffset +
+            projection.depthScale / std::max(depth - radius, projection.nearPlane);
+        float maxDepth = projection.depthOffset + projection.depthScale / (depth + radius);
+        if (minDepth > 1.0f) {
+            continue;   // Behind the far plane.
+        }
+
+        // The tangents from the eye to the circle in the plane of an axis and the
+        // view direction bound the sphere. Spheres around the eye have none.
+        float x0 = 0.0f;
+        float x1 = lastX;
+        float y0 = 0.0f;
+        float y1 = lastY;
+        if (depth > radius) {
+            float denom = depth * depth - radius * radius;
+            float rootX = std::sqrt(viewX * viewX + denom);
+            float rootY = std::sqrt(viewY * viewY + denom);
+            float minX = (viewX * depth - radius * rootX) / denom;
+            float maxX = (viewX * depth + radius * rootX) / denom;
+            float minY = (viewY * depth - radius * rootY) / denom;
+            float maxY = (viewY * depth + radius * rootY) / denom;
+            x0 = (minX * projection.scaleX + projection.offsetX) * halfTilesX + halfTilesX;
+            x1 = (maxX * projection.scaleX + projection.offsetX) * halfTilesX + halfTilesX;
+            y0 = halfTilesY - (maxY * projection.scaleY + projection.offsetY) * halfTilesY;
+            y1 = halfTilesY - (minY * projection.scaleY + projection.offsetY) * halfTilesY;
+            if (x1 < 0.0f || x0 >= 2.0f * halfTilesX || y1 < 0.0f ||
+                    y0 >= 2.0f * halfTilesY) {
+                continue;   // Off screen.
+            }
+        }
+
+        footprint.x0 = static_cast<INT32>(std::min(std::max(x0, 0.0f), lastX));
+        footprint.x1 = static_cast<INT32>(std::min(x1, lastX));
+        footprint.y0 = static_cast<INT32>(std::min(std::max(y0, 0.0f), lastY));
+        footprint.y1 = static_cast<INT32>(std::min(y1, lastY));
+        footprint.minDepth = minDepth;
+        footprint.maxDepth = maxDepth;
+    }
+}
+
+
+/*
+ * TiledLightCuller::projectSse
+ */
+void TiledLightCuller::projectSse(const Projection& projection,
+        const std::vector<sm::Vector4>& lights, size_t first, size_t last) {
+    const sm::Matrix& m = projection.viewMat;
+    const __m128 m11 = _mm_set1_ps(m._11);
+    const __m128 m21 = _mm_set1_ps(m._21);
+    const __m128 m31 = _mm_set1_ps(m._31);
+    const __m128 m41 = _mm_set1_ps(m._41);
+    const __m128 m12 = _mm_set1_ps(m._12);
+    const __m128 m22 = _mm_set1_ps(m._22);
+    const __m128 m32 = _mm_set1_ps(m._32);
+    const __m128 m42 = _mm_set1_ps(m._42);
+    const __m128 m13 = _mm_set1_ps(m._13);
+    const __m128 m23 = _mm_set1_ps(m._23);
+    const __m128 m33 = _mm_set1_ps(m._33);
+    const __m128 m43 = _mm_set1_ps(m._43);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 nearPlane = _mm_set1_ps(projection.nearPlane);
+    const __m128 depthScale = _mm_set1_ps(projection.depthScale);
+    const __m128 depthOffset = _mm_set1_ps(projection.depthOffset);
+    const __m128 scaleX = _mm_set1_ps(projection.scaleX);
+    const __m128 scaleY = _mm_set1_ps(projection.scaleY);
+    const __m128 offsetX = _mm_set1_ps(projection.offsetX);
+    const __m128 offsetY = _mm_set1_ps(projection.offsetY);
+    const __m128 halfTilesX = _mm_set1_ps(0.5f * m_width / TILE_SIZE);
+    const __m128 halfTilesY = _mm_set1_ps(0.5f * m_height / TILE_SIZE);
+    const __m128 tilesX = _mm_add_ps(halfTilesX, halfTilesX);
+    const __m128 tilesY = _mm_add_ps(halfTilesY, halfTilesY);
+    const __m128 lastX = _mm_set1_ps(float(m_tilesX - 1));
+    const __m128 lastY = _mm_set1_ps(float(m_tilesY - 1));
+
+    size_t i = first;
+    for (; i + 4 <= last; i += 4) {
+        __m128 x = _mm_loadu_ps(&lights[i].x);
+        __m128 y = _mm_loadu_ps(&lights[i + 1].x);
+        __m128 z = _mm_loadu_ps(&lights[i + 2].x);
+        __m128 radius = _mm_loadu_ps(&lights[i + 3].x);
+        _MM_TRANSPOSE4_PS(x, y, z, radius);
+
+        __m128 viewX = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m11),
+            _mm_mul_ps(y, m21)), _mm_mul_ps(z, m31)), m41);
+        __m128 viewY = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m12),
+            _mm_mul_ps(y, m22)), _mm_mul_ps(z, m32)), m42);
+        __m128 depth = _mm_xor_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m13),
+            _mm_mul_ps(y, m23)), _mm_mul_ps(z, m33)), m43), signMask);
+        __m128 minDepth = _mm_add_ps(depthOffset, _mm_div_ps(depthScale,
+            _mm_max_ps(_mm_sub_ps(depth, radius), nearPlane)));
+        __m128 maxDepth = _mm_add_ps(depthOffset, _mm_div_ps(depthScale,
+            _mm_add_ps(depth, radius)));
+
+        // Tangents like projectScalar(). Lanes of spheres around the eye produce
+        // garbage that gets replaced by the whole screen.
+        __m128 denom = _mm_sub_ps(_mm_mul_ps(depth, depth), _mm_mul_ps(radius, radius));
+        __m128 rootX = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(viewX, viewX), denom));
+        __m128 rootY = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(viewY, viewY), denom));
+        __m128 minX = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(viewX, depth),
+            _mm_mul_ps(radius, rootX)), denom);
+        __m128 maxX = _mm_div_ps(_mm_add_ps(_mm_mul_ps(viewX, depth),
+            _mm_mul_ps(radius, rootX)), denom);
+        __m128 minY = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(viewY, depth),
+            _mm_mul_ps(radius, rootY)), denom);
+        __m128 maxY = _mm_div_ps(_mm_add_ps(_mm_mul_ps(viewY, depth),
+            _mm_mul_ps(radius, rootY)), denom);
+        __m128 x0 = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(minX, scaleX), offsetX),
+            halfTilesX), halfTilesX);
+        __m128 x1 = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(maxX, scaleX), offsetX),
+            halfTilesX), halfTilesX);
+        __m128 y0 = _mm_sub_ps(halfTilesY, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(maxY, scaleY),
+            offsetY), halfTilesY));
+        __m128 y1 = _mm_sub_ps(halfTilesY, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(minY, scaleY),
+            offsetY), halfTilesY));
+
+        __m128 outside = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(x1, zero),
+            _mm_cmpge_ps(x0, tilesX)), _mm_or_ps(_mm_cmplt_ps(y1, zero),
+            _mm_cmpge_ps(y0, tilesY)));
+        __m128 aroundEye = _mm_cmple_ps(depth, radius);
+        x0 = _mm_andnot_ps(aroundEye, x0);
+        x1 = _mm_or_ps(_mm_and_ps(aroundEye, lastX), _mm_andnot_ps(aroundEye, x1));
+        y0 = _mm_andnot_ps(aroundEye, y0);
+        y1 = _mm_or_ps(_mm_and_ps(aroundEye, lastY), _mm_andnot_ps(aroundEye, y1));
+        outside = _mm_andnot_ps(aroundEye, outside);
+        outside = _mm_or_ps(outside, _mm_or_ps(
+            _mm_cmple_ps(_mm_add_ps(depth, radius), nearPlane), _mm_cmpgt_ps(minDepth, one)));
+
+        alignas(16) INT32 rect[4][4];
+        alignas(16) float depthRange[2][4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(rect[0]),
+            _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(x0, zero), lastX)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(rect[1]),
+            _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(y0, zero), lastY)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(rect[2]),
+            _mm_cvttps_epi32(_mm_min_ps(x1, lastX)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(rect[3]),
+            _mm_cvttps_epi32(_mm_min_ps(y1, lastY)));
+        _mm_store_ps(depthRange[0], minDepth);
+        _mm_store_ps(depthRange[1], maxDepth);
+        int outsideMask = _mm_movemask_ps(outside);
+        for (UINT32 lane = 0; lane < 4; lane++) {
+            if (outsideMask & (1 << lane)) {
+                m_footprints[i + lane] = { 0, 0, -1, -1, 0.0f, 0.0f };
+            } else {
+                m_footprints[i + lane] = { rect[0][lane], rect[1][lane], rect[2][lane],
+                    rect[3][lane], depthRange[0][lane], depthRange[1][lane] };
+            }
+        }
+    }
+    projectScalar(projection, lights, i, last);
+}
+
+
+/*
+ * TiledLightCuller::cullRowScalar
+ */
+void TiledLightCuller::cullRowScalar(UINT32 row) {
+    std::vector<UINT32>* tiles = &m_tileLights[static_cast<size_t>(row) * m_tilesX];
+    const float* minDepth = &m_minDepth[static_cast<size_t>(row) * m_rowPitch];
+    const float* maxDepth = &m_maxDepth[static_cast<size_t>(row) * m_rowPitch];
+    for (UINT32 x = 0; x < m_tilesX; x++) {
+        tiles[x].clear();
+    }
+
+    for (UINT32 light : m_rowLights[row]) {
+        const Footprint& footprint = m_footprints[light];
+        for (INT32 x = footprint.x0; x <= footprint.x1; x++) {
+            if (footprint.minDepth <= maxDepth[x] && footprint.maxDepth >= minDepth[x]) {
+                tiles[x].push_back(light);
+            }
+        }
+    }
+}
+
+
+/*
+ * TiledLightCuller::cullRowSse
+ */
+void TiledLightCuller::cullRowSse(UINT32 row) {
+    std::vector<UINT32>* tiles = &m_tileLights[static_cast<size_t>(row) * m_tilesX];
+    const float* minDepth = &m_minDepth[static_cast<size_t>(row) * m_rowPitch];
+    const float* maxDepth = &m_maxDepth[static_cast<size_t>(row) * m_rowPitch];
+    for (UINT32 x = 0; x < m_tilesX; x++) {
+        tiles[x].clear();
+    }
+
+    // Groups of 4 tiles start at multiples of 4, the rows of the bounds are padded.
+    const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+    for (UINT32 light : m_rowLights[row]) {
+        const Footprint& footprint = m_footprints[light];
+        __m128 lightMin = _mm_set1_ps(footprint.minDepth);
+        __m128 lightMax = _mm_set1_ps(footprint.maxDepth);
+        __m128i first = _mm_set1_epi32(footprint.x0 - 1);
+        __m128i last = _mm_set1_epi32(footprint.x1 + 1);
+        for (INT32 x = footprint.x0 & ~3; x <= footprint.x1; x += 4) {
+            __m128i lanes = _mm_add_epi32(_mm_set1_epi32(x), laneOffsets);
+            __m128i covered = _mm_and_si128(_mm_cmpgt_epi32(lanes, first),
+                _mm_cmplt_epi32(lanes, last));
+            __m128 overlaps = _mm_and_ps(
+                _mm_cmple_ps(lightMin, _mm_load_ps(&maxDepth[x])),
+                _mm_cmpge_ps(lightMax, _mm_load_ps(&minDepth[x])));
+            int mask = _mm_movemask_ps(_mm_and_ps(overlaps, _mm_castsi128_ps(covered)));
+            while (mask != 0) {
+                unsigned long lane;
+                _BitScanForward(&lane, mask);
+                tiles[x + lane].push_back(light);
+                mask &= mask - 1;
+            }
+        }
+    }
+}
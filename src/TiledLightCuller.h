@@ -0,0 +1,180 @@
+#pragma once
+
+/// <summary>
+/// Assigns point lights to screen tiles on the CPU, so a single lighting pass only
+/// evaluates the lights that can reach the pixels of a tile.
+/// </summary>
+/// <remarks>
+/// The bounding sphere of every light is projected exactly (tangent lines per
+/// axis) to a rectangle of tiles and to a depth range (z/w of D3D, 0 near, 1 far).
+/// A light is added to a tile if its rectangle covers the tile and its depth range
+/// overlaps the depth bounds of the tile, e.g. the nearest and farthest depth of a
+/// downsampled depth buffer. Without bounds a tile spans all depths. Spheres that
+/// reach behind the eye cover the whole screen.
+/// Culling runs in three steps: the lights are projected 4 at a time (SSE), then
+/// sorted into the rows of tiles whose depth range they overlap, then the rows are
+/// processed in parallel, testing 4 tiles of a row at a time against a light. The
+/// lists are compacted into one index array, the lights of a tile in ascending
+/// order. Scalar and SSE produce the same lists. No Direct3D is involved.
+/// </remarks>
+class TiledLightCuller {
+public:
+    /// <summary>
+    /// Pixels per side of a tile.
+    /// </summary>
+    static const UINT32 TILE_SIZE = 16;
+
+    /// <summary>
+    /// Implementation of the projection and the tile tests.
+    /// </summary>
+    enum class Path {
+        SCALAR,
+        SSE
+    };
+
+    /// <summary>
+    /// Lights of a tile in GetLightIndices().
+    /// </summary>
+    struct TileRange {
+        UINT32 offset;
+        UINT32 count;
+    };
+
+    /// <summary>
+    /// Sets the size of the screen. Resets the depth bounds.
+    /// </summary>
+    void Resize(UINT32 width, UINT32 height);
+
+    /// <summary>
+    /// Sets the depth bounds of all tiles.
+    /// </summary>
+    /// <param name="minDepth">Nearest depth per tile (row-major, top row first).
+    /// </param>
+    /// <param name="maxDepth">Farthest depth per tile.</param>
+    /// <param name="rowPitch">Values between two rows. At least GetTilesX().</param>
+    void SetDepthBounds(const float* minDepth, const float* maxDepth, size_t rowPitch);
+
+    /// <summary>
+    /// Lets every tile span all depths.
+    /// </summary>
+    void ClearDepthBounds();
+
+    /// <summary>
+    /// Builds the light lists of all tiles.
+    /// </summary>
+    /// <param name="viewMat">View matrix (right-handed).</param>
+    /// <param name="projMat">Perspective projection matrix (right-handed, D3D depth
+    /// range 0-1).</param>
+    /// <param name="lights">Bounding spheres, world space center in xyz and radius
+    /// in w.</param>
+    void Cull(const sm::Matrix& viewMat, const sm::Matrix& projMat,
+        const std::vector<sm::Vector4>& lights);
+
+    /// <summary>
+    /// Builds the light lists of all tiles from a subset of the lights, e.g. the
+    /// ones a LightBvh found in the view frustum.
+    /// </summary>
+    /// <param name="lights">All bounding spheres (see above).</param>
+    /// <param name="lightIds">Indices into lights of the candidates, ascending.
+    /// The lists hold these indices.</param>
+    void Cull(const sm::Matrix& viewMat, const sm::Matrix& projMat,
+        const std::vector<sm::Vector4>& lights, const std::vector<UINT32>& lightIds);
+
+    void SetPath(Path path);
+    Path GetPath() const;
+
+    /// <summary>
+    /// Number of threads for the rows of tiles. 1 culls on the calling thread.
+    /// </summary>
+    void SetThreadCount(UINT32 threadCnt);
+
+    UINT32 GetTilesX() const;
+    UINT32 GetTilesY() const;
+
+    /// <summary>
+    /// Returns the lights per tile (row-major, top row first) of the last Cull().
+    /// </summary>
+    const std::vector<TileRange>& GetTileRanges() const;
+
+    /// <summary>
+    /// Returns the light indices of all tiles, back to back.
+    /// </summary>
+    const std::vector<UINT32>& GetLightIndices() const;
+
+    /// <summary>
+    /// Returns the number of lights of the last Cull() that cover at least one tile.
+    /// </summary>
+    UINT32 GetVisibleLightCount() const;
+
+private:
+    /// <summary>
+    /// Screen footprint of a light. Tiles are inclusive, an empty footprint has
+    /// x0 > x1.
+    /// </summary>
+    struct Footprint {
+        INT32 x0;
+        INT32 y0;
+        INT32 x1;
+        INT32 y1;
+        float minDepth;
+        float maxDepth;
+    };
+
+    /// <summary>
+    /// Projection of the current Cull().
+    /// </summary>
+    struct Projection {
+        sm::Matrix viewMat;
+        float scaleX;       // NDC per unit of x / depth.
+        float scaleY;
+        float offsetX;      // NDC of the view axis.
+        float offsetY;
+        float depthScale;   // z/w = depthOffset + depthScale / depth.
+        float depthOffset;
+        float nearPlane;
+    };
+
+    /// <summary>
+    /// Implementation of Cull(). Without lightIds all lights are candidates.
+    /// </summary>
+    void cull(const sm::Matrix& viewMat, const sm::Matrix& projMat,
+        const std::vector<sm::Vector4>& lights, const std::vector<UINT32>* lightIds);
+
+    /// <summary>
+    /// Computes the footprints of the lights [first, last).
+    /// </summary>
+    void projectScalar(const Projection& projection,
+        const std::vector<sm::Vector4>& lights, size_t first, size_t last);
+    void projectSse(const Projection& projection, const std::vector<sm::Vector4>& lights,
+        size_t first, size_t last);
+
+    /// <summary>
+    /// Adds the lights of a row to the lists of its tiles.
+    /// </summary>
+    void cullRowScalar(UINT32 row);
+    void cullRowSse(UINT32 row);
+
+    UINT32 m_width = 0;
+    UINT32 m_height = 0;
+    UINT32 m_tilesX = 0;
+    UINT32 m_tilesY = 0;
+    UINT32 m_rowPitch = 0;          // Tiles per row of the bounds, multiple of 4.
+    Path m_path = Path::SSE;
+    UINT32 m_threadCnt = 1;
+
+    // Depth bounds per tile, m_rowPitch per row, and of every row.
+    std::vector<float> m_minDepth;
+    std::vector<float> m_maxDepth;
+    std::vector<std::pair<float, float>> m_rowDepth;
+
+    // Scratch memory of Cull().
+    std::vector<sm::Vector4> m_candidates;     // Spheres of the lightIds.
+    std::vector<Footprint> m_footprints;
+    std::vector<std::vector<UINT32>> m_rowLights;
+    std::vector<std::vector<UINT32>> m_tileLights;
+    UINT32 m_visibleLightCnt = 0;
+
+    // Result.
+    std::vector<TileRange> m_tileRanges;
+    std::vector<UINT32> m_lightIndices;
+};
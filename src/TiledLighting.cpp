@@ -0,0 +1,181 @@
+#include "stdafx.h"
+#include "TiledLighting.h"
+#include "Helper.h"
+#include "ResourceRegistry.h"
+#include "RenderStats.h"
+
+
+/*
+ * TiledLighting::Init
+ */
+void TiledLighting::Init(wrl::ComPtr<ID3D11Device> d3dDevice,
+        wrl::ComPtr<ID3D11DeviceContext> d3dContext) {
+    m_d3dDevice = d3dDevice;
+    m_d3dContext = d3dContext;
+
+    // The grid, to find the tile or cluster of a pixel.
+    D3D11_BUFFER_DESC bufferDesc = {};
+    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    bufferDesc.ByteWidth = sizeof(Constants);
+    bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    HRESULT hr = m_d3dDevice->CreateBuffer(&bufferDesc, nullptr,
+        m_constBuffer.ReleaseAndGetAddressOf());
+    assert(SUCCEEDED(hr));
+    ResourceRegistry::Register(m_constBuffer.Get(),
+        ResourceRegistry::Category::CONSTANT_BUFFER, "TiledLighting::m_constBuffer");
+    m_constants = {};
+
+    // The fullscreen triangle of the depth downsampling.
+    Helper::CreateVertexShader(L"\\src\\shader\\DepthDownsample_vs.hlsl",
+        m_vertexShaderByteCode, m_vertexShader, m_d3dDevice);
+    Helper::CreatePixelShader(L"\\src\\shader\\TiledLighting_ps.hlsl",
+        m_pixelShaderByteCode, m_pixelShader, m_d3dDevice);
+    Helper::CreatePixelShader(L"\\src\\shader\\ClusteredLighting_ps.hlsl",
+        m_clusteredPixelShaderByteCode, m_clusteredPixelShader, m_d3dDevice);
+}
+
+
+/*
+ * TiledLighting::SetLights
+ */
+void TiledLighting::SetLights(wrl::ComPtr<ID3D11ShaderResourceView> lights) {
+    m_lights = lights;
+}
+
+
+/*
+ * TiledLighting::Update
+ */
+void TiledLighting::Update(const TiledLightCuller& culler) {
+    const std::vector<TiledLightCuller::TileRange>& tileRanges = culler.GetTileRanges();
+    const std::vector<UINT32>& lightIndices = culler.GetLightIndices();
+    upload(m_tileRanges, tileRanges.data(), static_cast<UINT32>(tileRanges.size()),
+        sizeof(TiledLightCuller::TileRange), DXGI_FORMAT_R32G32_UINT,
+        "TiledLighting::m_tileRanges");
+    upload(m_lightIndices, lightIndices.data(), static_cast<UINT32>(lightIndices.size()),
+        sizeof(UINT32), DXGI_FORMAT_R32_UINT, "TiledLighting::m_lightIndices");
+
+    Constants constants = {};
+    constants.gridX = culler.GetTilesX();
+    constants.gridY = culler.GetTilesY();
+    updateConstants(constants);
+    m_useClusters = false;
+}
+
+
+/*
+ * TiledLighting::Update
+ */
+void TiledLighting::Update(const ClusteredLightCuller& culler, const sm::Matrix& projMat) {
+    const std::vector<ClusteredLightCuller::ClusterRange>& clusterRanges =
+        culler.GetClusterRanges();
+    const std::vector<UINT32>& lightIndices = culler.GetLightIndices();
+    upload(m_tileRanges, clusterRanges.data(),
+        static_cast<UINT32>(clusterRanges.size()),
+        sizeof(ClusteredLightCuller::ClusterRange), DXGI_FORMAT_R32G32_UINT,
+        "TiledLighting::m_tileRanges");
+    upload(m_lightIndices, lightIndices.data(), static_cast<UINT32>(lightIndices.size()),
+        sizeof(UINT32), DXGI_FORMAT_R32_UINT, "TiledLighting::m_lightIndices");
+
+    // z/w = -_33 + _43 / depth of the right-handed projection.
+    Constants constants = {};
+    constants.gridX = culler.GetClustersX();
+    constants.gridY = culler.GetClustersY();
+    constants.gridZ = culler.GetClustersZ();
+    constants.sliceScale = culler.GetSliceScale();
+    constants.sliceBias = culler.GetSliceBias();
+    constants.depthScale = projMat._43;
+    constants.depthOffset = projMat._33;
+    updateConstants(constants);
+    m_useClusters = true;
+}
+
+
+/*
+ * TiledLighting::Draw
+ */
+void TiledLighting::Draw() {
+    // A single triangle, generated in the vertex shader.
+    m_d3dContext->RSSetState(nullptr);
+    m_d3dContext->IASetInputLayout(nullptr);
+    m_d3dContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    m_d3dContext->VSSetShader(m_vertexShader.Get(), nullptr, 0);
+    m_d3dContext->PSSetShader(m_useClusters ? m_clusteredPixelShader.Get() :
+        m_pixelShader.Get(), nullptr, 0);
+    m_d3dContext->PSSetConstantBuffers(2, 1, m_constBuffer.GetAddressOf());
+    std::array<ID3D11ShaderResourceView*, 3> srvs = { m_lights.Get(),
+        m_tileRanges.srv.Get(), m_lightIndices.srv.Get() };
+    m_d3dContext->PSSetShaderResources(2, static_cast<UINT>(srvs.size()), srvs.data());
+    RenderStats::Draw(m_d3dContext.Get(), 3);
+    RenderStats::Add(RenderStats::Counter::SHADER_SWITCHES, 2);
+    RenderStats::Add(RenderStats::Counter::BUFFER_BINDS);
+    RenderStats::Add(RenderStats::Counter::SRV_BINDS, srvs.size());
+}
+
+
+/*
+ * TiledLighting::updateConstants
+ */
+void TiledLighting::updateConstants(const Constants& constants) {
+    if (std::memcmp(&constants, &m_constants, sizeof(Constants)) == 0) {
+        return;
+    }
+    m_constants = constants;
+
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    HRESULT hr = m_d3dContext->Map(m_constBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0,
+        &mappedResource);
+    assert(SUCCEEDED(hr));
+    std::memcpy(mappedResource.pData, &m_constants, sizeof(Constants));
+    m_d3dContext->Unmap(m_constBuffer.Get(), 0);
+    RenderStats::AddUpload(sizeof(Constants));
+}
+
+
+/*
+ * TiledLighting::upload
+ */
+void TiledLighting::upload(DynamicBuffer& target, const void* data, UINT32 elementCnt,
+        UINT32 stride, DXGI_FORMAT format, const char* name) {
+    // Grow by half of the size, so a slowly rising number of lights does not
+    // recreate the buffer every frame. Empty buffers are not allowed.
+    if (elementCnt > target.capacity || !target.buffer) {
+        target.capacity = std::max(elementCnt + elementCnt / 2, 1u);
+
+        D3D11_BUFFER_DESC bufferDesc = {};
+        bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        bufferDesc.ByteWidth = target.capacity * stride;
+        bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        if (format == DXGI_FORMAT_UNKNOWN) {
+            bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+            bufferDesc.StructureByteStride = stride;
+        }
+        HRESULT hr = m_d3dDevice->CreateBuffer(&bufferDesc, nullptr,
+            target.buffer.ReleaseAndGetAddressOf());
+        assert(SUCCEEDED(hr));
+        ResourceRegistry::Register(target.buffer.Get(), ResourceRegistry::Category::OTHER,
+            name);
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = format;
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+        srvDesc.Buffer.FirstElement = 0;
+        srvDesc.Buffer.NumElements = target.capacity;
+        hr = m_d3dDevice->CreateShaderResourceView(target.buffer.Get(), &srvDesc,
+            target.srv.ReleaseAndGetAddressOf());
+        assert(SUCCEEDED(hr));
+    }
+    if (elementCnt == 0) {
+        return;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    HRESULT hr = m_d3dContext->Map(target.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0,
+        &mappedResource);
+    assert(SUCCEEDED(hr));
+    std::memcpy(mappedResource.pData, data, static_cast<size_t>(elementCnt) * stride);
+    m_d3dContext->Unmap(target.buffer.Get(), 0);
+    RenderStats::AddUpload(static_cast<UINT64>(elementCnt) * stride);
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "TiledLightCuller.h"
+#include "ClusteredLightCuller.h"
+
+/// <summary>
+/// Shades all point lights in a single fullscreen pass, using the per-tile light
+/// lists of a TiledLightCuller or the per-cluster lists of a ClusteredLightCuller.
+/// Every pixel reads the G-buffer once and only loops over the lights of its tile
+/// or cluster, instead of one light volume per light.
+/// </summary>
+/// <remarks>
+/// The lights are the structured buffer of a LightBuffer, the lists are uploaded
+/// every frame into dynamic buffers that grow when needed. The lighting matches
+/// the instanced light volumes (LightVolumeInstanced_ps.hlsl): a light reaches up
+/// to its radius, half the scale of the volume sphere. The cluster of a pixel
+/// follows from its position and the linear depth of the G-buffer.
+/// </remarks>
+class TiledLighting {
+public:
+    /// <summary>
+    /// Creates the shaders and the constant buffer.
+    /// </summary>
+    void Init(wrl::ComPtr<ID3D11Device> d3dDevice,
+        wrl::ComPtr<ID3D11DeviceContext> d3dContext);
+
+    /// <summary>
+    /// Sets the lights to shade. Call again when the LightBuffer grows.
+    /// </summary>
+    /// <param name="lights">StructuredBuffer of LightPool::PackedLight, see
+    /// LightBuffer.</param>
+    void SetLights(wrl::ComPtr<ID3D11ShaderResourceView> lights);
+
+    /// <summary>
+    /// Uploads the light lists of the last Cull() of a culler. Draw() shades by tile.
+    /// </summary>
+    void Update(const TiledLightCuller& culler);
+
+    /// <summary>
+    /// Uploads the light lists of the last Update() of a culler. Draw() shades by
+    /// cluster.
+    /// </summary>
+    /// <param name="projMat">Projection of the culler, to linearize the depth.
+    /// </param>
+    void Update(const ClusteredLightCuller& culler, const sm::Matrix& projMat);
+
+    /// <summary>
+    /// Draws a fullscreen triangle that shades every pixel. Expects the lighting
+    /// render targets, the blend state, the G-buffer (depth t0, normals t1), its
+    /// sampler (s1) and the scene constants (b1) of the light volume pass to be
+    /// bound. Binds t2 to t4, b2, the shaders and the rasterizer state.
+    /// </summary>
+    void Draw();
+
+private:
+    /// <summary>
+    /// Dynamic buffer with a shader resource view that grows on demand.
+    /// </summary>
+    struct DynamicBuffer {
+        wrl::ComPtr<ID3D11Buffer> buffer;
+        wrl::ComPtr<ID3D11ShaderResourceView> srv;
+        UINT32 capacity = 0;    // Elements.
+    };
+
+    /// <summary>
+    /// Content of the constant buffer, shared by both pixel shaders.
+    /// </summary>
+    struct Constants {
+        UINT32 gridX;           // Tiles or clusters per row.
+        UINT32 gridY;
+        UINT32 gridZ;           // Slices, 0 for tiles.
+        UINT32 padding;
+        float sliceScale;       // slice = log(depth) * sliceScale + sliceBias.
+        float sliceBias;
+        float depthScale;       // depth = depthScale / (z + depthOffset).
+        float depthOffset;
+    };
+
+    /// <summary>
+    /// Writes the constant buffer if the constants changed.
+    /// </summary>
+    void updateConstants(const Constants& constants);
+
+    /// <summary>
+    /// Uploads elements into a buffer, recreating it if too small.
+    /// </summary>
+    /// <param name="format">DXGI_FORMAT_UNKNOWN for a structured buffer.</param>
+    void upload(DynamicBuffer& target, const void* data, UINT32 elementCnt,
+        UINT32 stride, DXGI_FORMAT format, const char* name);
+
+    wrl::ComPtr<ID3D11ShaderResourceView> m_lights;
+    DynamicBuffer m_tileRanges;     // Offset and count per tile or cluster.
+    DynamicBuffer m_lightIndices;
+    wrl::ComPtr<ID3D11Buffer> m_constBuffer;
+    Constants m_constants = {};     // Content of m_constBuffer.
+    bool m_useClusters = false;
+
+    // Shaders.
+    wrl::ComPtr<ID3DBlob> m_vertexShaderByteCode;
+    wrl::ComPtr<ID3DBlob> m_pixelShaderByteCode;
+    wrl::ComPtr<ID3D11VertexShader> m_vertexShader;
+    wrl::ComPtr<ID3D11PixelShader> m_pixelShader;
+    wrl::ComPtr<ID3DBlob> m_clusteredPixelShaderByteCode;
+    wrl::ComPtr<ID3D11PixelShader> m_clusteredPixelShader;
+
+    // Direct3D stuff.
+    wrl::ComPtr<ID3D11Device> m_d3dDevice;
+    wrl::ComPtr<ID3D11DeviceContext> m_d3dContext;
+};
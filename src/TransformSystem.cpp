@@ -0,0 +1,491 @@
+#include "stdafx.h"
+#include "TransformSystem.h"
+#include "Platform.h"
+
+// AVX2.
+#include <immintrin.h>
+
+
+/*
+ * TransformSystem::Default
+ */
+TransformSystem& TransformSystem::Default() {
+    static TransformSystem system;
+    return system;
+}
+
+
+/*
+ * TransformSystem::IsAvx2Supported
+ */
+bool TransformSystem::IsAvx2Supported() {
+    return Platform::IsAvx2Supported();
+}
+
+
+/*
+ * TransformSystem::ComputeModelMatrix
+ */
+sm::Matrix TransformSystem::ComputeModelMatrix(const ModelState& state) {
+    // Scale * Rotation * Translation without the two matrix products: the scale
+    // only multiplies the rotation rows and the translation only fills the last row.
+    sm::Matrix modelMatrix = sm::Matrix::CreateFromQuaternion(state.orientation);
+    modelMatrix._11 *= state.scale;
+    modelMatrix._12 *= state.scale;
+    modelMatrix._13 *= state.scale;
+    modelMatrix._21 *= state.scale;
+    modelMatrix._22 *= state.scale;
+    modelMatrix._23 *= state.scale;
+    modelMatrix._31 *= state.scale;
+    modelMatrix._32 *= state.scale;
+    modelMatrix._33 *= state.scale;
+    modelMatrix._41 = state.position.x;
+    modelMatrix._42 = state.position.y;
+    modelMatrix._43 = state.position.z;
+    return modelMatrix;
+}
+
+
+/*
+ * TransformSystem::ComputeNormalMatrix
+ */
+sm::Matrix TransformSystem::ComputeNormalMatrix(
+        const sm::Matrix& modelMatrix,
+        const sm::Matrix& viewMatrix) {
+    // Only the 3x3 part of the model view matrix matters. Its inverse transpose is
+    // the cofactor matrix divided by the determinant. The rows of the cofactor
+    // matrix are cross products of the rows of the 3x3 part.
+    sm::Matrix modelViewMatrix = modelMatrix * viewMatrix;
+    sm::Vector3 row0(modelViewMatrix._11, modelViewMatrix._12, modelViewMatrix._13);
+    sm::Vector3 row1(modelViewMatrix._21, modelViewMatrix._22, modelViewMatrix._23);
+    sm::Vector3 row2(modelViewMatrix._31, modelViewMatrix._32, modelViewMatrix._33);
+    sm::Vector3 cofactor0 = row1.Cross(row2);
+    sm::Vector3 cofactor1 = row2.Cross(row0);
+    sm::Vector3 cofactor2 = row0.Cross(row1);
+    float invDet = 1.0f / row0.Dot(cofactor0);
+    cofactor0 *= invDet;
+    cofactor1 *= invDet;
+    cofactor2 *= invDet;
+
+    sm::Matrix normalMatrix3x3;
+    normalMatrix3x3._11 = cofactor0.x;
+    normalMatrix3x3._12 = cofactor0.y;
+    normalMatrix3x3._13 = cofactor0.z;
+
+    normalMatrix3x3._21 = cofactor1.x;
+    normalMatrix3x3._22 = cofactor1.y;
+    normalMatrix3x3._23 = cofactor1.z;
+
+    normalMatrix3x3._31 = cofactor2.x;
+    normalMatrix3x3._32 = cofactor2.y;
+    normalMatrix3x3._33 = cofactor2.z;
+
+    return normalMatrix3x3;
+}
+
+
+/*
+ * TransformSystem::ComputeNormalMatrixReference
+ */
+sm::Matrix TransformSystem::ComputeNormalMatrixReference(
+        const sm::Matrix& modelMatrix,
+        const sm::Matrix& viewMatrix) {
+    // Compute normal matrix.
+    sm::Matrix modelViewMatrix = modelMatrix * viewMatrix;
+    sm::Matrix normalMatrix4x4 = modelViewMatrix.Invert().Transpose();
+
+    // Extract relevant 3x3 part, which is the only thing we need.
+    sm::Matrix normalMatrix3x3;
+    normalMatrix3x3._11 = normalMatrix4x4._11;
+    normalMatrix3x3._12 = normalMatrix4x4._12;
+    normalMatrix3x3._13 = normalMatrix4x4._13;
+
+    normalMatrix3x3._21 = normalMatrix4x4._21;
+    normalMatrix3x3._22 = normalMatrix4x4._22;
+    normalMatrix3x3._23 = normalMatrix4x4._23;
+
+    normalMatrix3x3._31 = normalMatrix4x4._31;
+    normalMatrix3x3._32 = normalMatrix4x4._32;
+    normalMatrix3x3._33 = normalMatrix4x4._33;
+
+    return normalMatrix3x3;
+}
+
+
+/*
+ * TransformSystem::Create
+ */
+TransformHandle TransformSystem::Create(const ModelState& state) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    UINT32 denseIdx = static_cast<UINT32>(m_posX.size());
+    m_posX.push_back(state.position.x);
+    m_posY.push_back(state.position.y);
+    m_posZ.push_back(state.position.z);
+    m_rotX.push_back(state.orientation.x);
+    m_rotY.push_back(state.orientation.y);
+    m_rotZ.push_back(state.orientation.z);
+    m_rotW.push_back(state.orientation.w);
+    m_scale.push_back(state.scale);
+    m_modelMats.push_back(sm::Matrix::Identity);
+    m_normalMats.push_back(sm::Matrix::Identity);
+    m_versions.push_back(0);
+    m_dirtyFlags.push_back(0);
+
+    // Reuse a free slot, its generation was bumped on destruction.
+    TransformHandle handle;
+    if (!m_freeSlots.empty()) {
+        handle.slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else {
+        handle.slot = static_cast<UINT32>(m_slots.size());
+        m_slots.push_back({ 0, 0 });
+    }
+    m_slots[handle.slot].denseIdx = denseIdx;
+    handle.generation = m_slots[handle.slot].generation;
+    m_denseToSlot.push_back(handle.slot);
+
+    markDirty(denseIdx);
+    return handle;
+}
+
+
+/*
+ * TransformSystem::Destroy
+ */
+void TransformSystem::Destroy(TransformHandle handle) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    UINT32 denseIdx = denseIndex(handle);
+    UINT32 lastIdx = static_cast<UINT32>(m_posX.size()) - 1;
+
+    // Move the last transform into the gap.
+    if (denseIdx != lastIdx) {
+        m_posX[denseIdx] = m_posX[lastIdx];
+        m_posY[denseIdx] = m_posY[lastIdx];
+        m_posZ[denseIdx] = m_posZ[lastIdx];
+        m_rotX[denseIdx] = m_rotX[lastIdx];
+        m_rotY[denseIdx] = m_rotY[lastIdx];
+        m_rotZ[denseIdx] = m_rotZ[lastIdx];
+        m_rotW[denseIdx] = m_rotW[lastIdx];
+        m_scale[denseIdx] = m_scale[lastIdx];
+        m_modelMats[denseIdx] = m_modelMats[lastIdx];
+        m_normalMats[denseIdx] = m_normalMats[lastIdx];
+        m_versions[denseIdx] = m_versions[lastIdx];
+        m_dirtyFlags[denseIdx] = m_dirtyFlags[lastIdx];
+        m_denseToSlot[denseIdx] = m_denseToSlot[lastIdx];
+        m_slots[m_denseToSlot[denseIdx]].denseIdx = denseIdx;
+        m_dirtyListStale = true;
+    }
+    m_posX.pop_back();
+    m_posY.pop_back();
+    m_posZ.pop_back();
+    m_rotX.pop_back();
+    m_rotY.pop_back();
+    m_rotZ.pop_back();
+    m_rotW.pop_back();
+    m_scale.pop_back();
+    m_modelMats.pop_back();
+    m_normalMats.pop_back();
+    m_versions.pop_back();
+    m_dirtyFlags.pop_back();
+    m_denseToSlot.pop_back();
+
+    // Invalidate all handles of the slot.
+    m_slots[handle.slot].generation++;
+    m_freeSlots.push_back(handle.slot);
+    if (!m_dirtyList.empty()) {
+        m_dirtyListStale = true;
+    }
+}
+
+
+/*
+ * TransformSystem::IsValid
+ */
+bool TransformSystem::IsValid(TransformHandle handle) const {
+    return handle.slot < m_slots.size() &&
+        m_slots[handle.slot].generation == handle.generation;
+}
+
+
+/*
+ * TransformSystem::GetState
+ */
+ModelState TransformSystem::GetState(TransformHandle handle) const {
+    UINT32 idx = denseIndex(handle);
+    ModelState state;
+    state.scale = m_scale[idx];
+    state.position = sm::Vector3(m_posX[idx], m_posY[idx], m_posZ[idx]);
+    state.orientation = sm::Quaternion(m_rotX[idx], m_rotY[idx], m_rotZ[idx],
+        m_rotW[idx]);
+    return state;
+}
+
+
+/*
+ * TransformSystem::SetState
+ */
+void TransformSystem::SetState(TransformHandle handle, const ModelState& state) {
+    // Models set their state while others are still being created.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    UINT32 idx = denseIndex(handle);
+    if (GetState(handle) == state) {
+        return;
+    }
+    m_posX[idx] = state.position.x;
+    m_posY[idx] = state.position.y;
+    m_posZ[idx] = state.position.z;
+    m_rotX[idx] = state.orientation.x;
+    m_rotY[idx] = state.orientation.y;
+    m_rotZ[idx] = state.orientation.z;
+    m_rotW[idx] = state.orientation.w;
+    m_scale[idx] = state.scale;
+    markDirty(idx);
+}
+
+
+/*
+ * TransformSystem::SetViewMatrix
+ */
+void TransformSystem::SetViewMatrix(const sm::Matrix& viewMat) {
+    if (viewMat != m_viewMat) {
+        m_viewMat = viewMat;
+        m_allDirty = true;
+    }
+}
+
+
+/*
+ * TransformSystem::Update
+ */
+void TransformSystem::Update() {
+    if (m_allDirty) {
+        m_dirtyList.resize(m_posX.size());
+        for (UINT32 i = 0; i < m_dirtyList.size(); i++) {
+            m_dirtyList[i] = i;
+        }
+    } else if (m_dirtyListStale) {
+        m_dirtyList.clear();
+        for (UINT32 i = 0; i < m_dirtyFlags.size(); i++) {
+            if (m_dirtyFlags[i]) {
+                m_dirtyList.push_back(i);
+            }
+        }
+    }
+    if (m_dirtyList.empty()) {
+        return;
+    }
+
+    if (m_useAvx2) {
+        composeAvx2(m_dirtyList.data(), m_dirtyList.size());
+    } else {
+        composeScalar(m_dirtyList.data(), m_dirtyList.size());
+    }
+
+    for (UINT32 idx : m_dirtyList) {
+        m_dirtyFlags[idx] = 0;
+        m_versions[idx]++;
+    }
+    m_dirtyList.clear();
+    m_allDirty = false;
+    m_dirtyListStale = false;
+}
+
+
+/*
+ * TransformSystem::GetModelMatrix
+ */
+const sm::Matrix& TransformSystem::GetModelMatrix(TransformHandle handle) const {
+    return m_modelMats[denseIndex(handle)];
+}
+
+
+/*
+ * TransformSystem::GetNormalMatrix
+ */
+const sm::Matrix& TransformSystem::GetNormalMatrix(TransformHandle handle) const {
+    return m_normalMats[denseIndex(handle)];
+}
+
+
+/*
+ * TransformSystem::GetVersion
+ */
+UINT32 TransformSystem::GetVersion(TransformHandle handle) const {
+    return m_versions[denseIndex(handle)];
+}
+
+
+/*
+ * TransformSystem::GetCount
+ */
+size_t TransformSystem::GetCount() const {
+    return m_posX.size();
+}
+
+
+/*
+ * TransformSystem::SetUseAvx2
+ */
+void TransformSystem::SetUseAvx2(bool useAvx2) {
+    m_useAvx2 = useAvx2 && IsAvx2Supported();
+}
+
+
+/*
+ * TransformSystem::GetUseAvx2
+ */
+bool TransformSystem::GetUseAvx2() const {
+    return m_useAvx2;
+}
+
+
+/*
+ * TransformSystem::denseIndex
+ */
+UINT32 TransformSystem::denseIndex(TransformHandle handle) const {
+    assert(IsValid(handle));
+    return m_slots[handle.slot].denseIdx;
+}
+
+
+/*
+ * TransformSystem::markDirty
+ */
+void TransformSystem::markDirty(UINT32 denseIdx) {
+    if (!m_dirtyFlags[denseIdx]) {
+        m_dirtyFlags[denseIdx] = 1;
+        m_dirtyList.push_back(denseIdx);
+    }
+}
+
+
+/*
+ * TransformSystem::composeScalar
+ */
+void TransformSystem::composeScalar(const UINT32* indices, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        UINT32 idx = indices[i];
+        ModelState state;
+        state.scale = m_scale[idx];
+        state.position = sm::Vector3(m_posX[idx], m_posY[idx], m_posZ[idx]);
+        state.orientation = sm::Quaternion(m_rotX[idx], m_rotY[idx], m_rotZ[idx],
+            m_rotW[idx]);
+        m_modelMats[idx] = ComputeModelMatrix(state);
+        m_normalMats[idx] = ComputeNormalMatrix(m_modelMats[idx], m_viewMat);
+    }
+}
+
+
+/*
+ * TransformSystem::composeAvx2
+ */
+AVX2_FUNCTION
+void TransformSystem::composeAvx2(const UINT32* indices, size_t count) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+
+    // 3x3 part of the view matrix. The translation does not affect normals.
+    __m256 view[3][3];
+    for (int row = 0; row < 3; row++) {
+        for (int col = 0; col < 3; col++) {
+            view[row][col] = _mm256_set1_ps(m_viewMat.m[row][col]);
+        }
+    }
+
+    size_t batchEnd = count - count % 8;
+    for (size_t batch = 0; batch < batchEnd; batch += 8) {
+        // Gather 8 transforms from the SoA arrays.
+        __m256i idx = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(indices + batch));
+        __m256 x = _mm256_i32gather_ps(m_rotX.data(), idx, 4);
+        __m256 y = _mm256_i32gather_ps(m_rotY.data(), idx, 4);
+        __m256 z = _mm256_i32gather_ps(m_rotZ.data(), idx, 4);
+        __m256 w = _mm256_i32gather_ps(m_rotW.data(), idx, 4);
+        __m256 s = _mm256_i32gather_ps(m_scale.data(), idx, 4);
+
+        // Rotation matrix of the quaternion (row vector convention, like
+        // XMMatrixRotationQuaternion), scaled.
+        __m256 xx = _mm256_mul_ps(x, x);
+        __m256 yy = _mm256_mul_ps(y, y);
+        __m256 zz = _mm256_mul_ps(z, z);
+        __m256 xy = _mm256_mul_ps(x, y);
+        __m256 xz = _mm256_mul_ps(x, z);
+        __m256 yz = _mm256_mul_ps(y, z);
+        __m256 xw = _mm256_mul_ps(x, w);
+        __m256 yw = _mm256_mul_ps(y, w);
+        __m256 zw = _mm256_mul_ps(z, w);
+        __m256 twoS = _mm256_mul_ps(two, s);
+
+        __m256 m[3][3];
+        m[0][0] = _mm256_mul_ps(s, _mm256_sub_ps(one,
+            _mm256_mul_ps(two, _mm256_add_ps(yy, zz))));
+        m[0][1] = _mm256_mul_ps(twoS, _mm256_add_ps(xy, zw));
+        m[0][2] = _mm256_mul_ps(twoS, _mm256_sub_ps(xz, yw));
+        m[1][0] = _mm256_mul_ps(twoS, _mm256_sub_ps(xy, zw));
+        m[1][1] = _mm256_mul_ps(s, _mm256_sub_ps(one,
+            _mm256_mul_ps(two, _mm256_add_ps(xx, zz))));
+        m[1][2] = _mm256_mul_ps(twoS, _mm256_add_ps(yz, xw));
+        m[2][0] = _mm256_mul_ps(twoS, _mm256_add_ps(xz, yw));
+        m[2][1] = _mm256_mul_ps(twoS, _mm256_sub_ps(yz, xw));
+        m[2][2] = _mm256_mul_ps(s, _mm256_sub_ps(one,
+            _mm256_mul_ps(two, _mm256_add_ps(xx, yy))));
+
+        // 3x3 part of the model view matrix.
+        __m256 mv[3][3];
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) {
+                mv[row][col] = _mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(m[row][0], view[0][col]),
+                    _mm256_mul_ps(m[row][1], view[1][col])),
+                    _mm256_mul_ps(m[row][2], view[2][col]));
+            }
+        }
+
+        // Inverse transpose: rows of the cofactor matrix divided by the determinant.
+        __m256 n[3][3];
+        for (int row = 0; row < 3; row++) {
+            const __m256* a = mv[(row + 1) % 3];
+            const __m256* b = mv[(row + 2) % 3];
+            n[row][0] = _mm256_sub_ps(_mm256_mul_ps(a[1], b[2]), _mm256_mul_ps(a[2], b[1]));
+            n[row][1] = _mm256_sub_ps(_mm256_mul_ps(a[2], b[0]), _mm256_mul_ps(a[0], b[2]));
+            n[row][2] = _mm256_sub_ps(_mm256_mul_ps(a[0], b[1]), _mm256_mul_ps(a[1], b[0]));
+        }
+        __m256 det = _mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(mv[0][0], n[0][0]), _mm256_mul_ps(mv[0][1], n[0][1])),
+            _mm256_mul_ps(mv[0][2], n[0][2]));
+        __m256 invDet = _mm256_div_ps(one, det);
+
+        // Transpose to the per-transform matrices (AoS) through a small buffer.
+        alignas(32) float modelOut[9][8];
+        alignas(32) float normalOut[9][8];
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) {
+                _mm256_store_ps(modelOut[row * 3 + col], m[row][col]);
+                _mm256_store_ps(normalOut[row * 3 + col],
+                    _mm256_mul_ps(n[row][col], invDet));
+            }
+        }
+        for (int lane = 0; lane < 8; lane++) {
+            UINT32 i = indices[batch + lane];
+            sm::Matrix& modelMat = m_modelMats[i];
+            sm::Matrix& normalMat = m_normalMats[i];
+            for (int row = 0; row < 3; row++) {
+                for (int col = 0; col < 3; col++) {
+                    modelMat.m[row][col] = modelOut[row * 3 + col][lane];
+                    normalMat.m[row][col] = normalOut[row * 3 + col][lane];
+                }
+                modelMat.m[row][3] = 0.0f;
+                normalMat.m[row][3] = 0.0f;
+                normalMat.m[3][row] = 0.0f;
+            }
+            modelMat._41 = m_posX[i];
+            modelMat._42 = m_posY[i];
+            modelMat._43 = m_posZ[i];
+            modelMat._44 = 1.0f;
+            normalMat._44 = 1.0f;
+        }
+    }
+
+    composeScalar(indices + batchEnd, count - batchEnd);
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+/// <summary>
+/// Defines the state of a transform (position, rotation, scale).
+/// </summary>
+struct ModelState {
+    float scale;
+    sm::Vector3 position;
+    sm::Quaternion orientation;
+
+    // Constructor.
+    ModelState(float scale, sm::Vector3 position, sm::Vector4 rotation) :
+        scale(scale), position(position),
+        orientation(sm::Quaternion(rotation)) {
+        orientation.Normalize();
+    };
+
+    // Default constructor.
+    ModelState() {
+        scale = 1.0;
+        position = sm::Vector3(0.0, 0.0, 0.0);
+        orientation = sm::Quaternion::Identity;
+        orientation.Normalize();
+    }
+
+    bool operator==(const ModelState& other) const {
+        return scale == other.scale && position == other.position &&
+            orientation == other.orientation;
+    }
+
+    bool operator!=(const ModelState& other) const {
+        return !(*this == other);
+    }
+};
+
+/// <summary>
+/// Reference to a transform of a TransformSystem. Stays valid until the transform
+/// gets destroyed, even if other transforms are created or destroyed in between.
+/// </summary>
+struct TransformHandle {
+    UINT32 slot = UINT32_MAX;
+    UINT32 generation = 0;      // Has to match the generation of the slot.
+};
+
+/// <summary>
+/// Stores the transforms of all models in contiguous arrays (structure of arrays)
+/// and computes their model and normal matrices in batches.
+/// </summary>
+/// <remarks>
+/// Transforms are addressed by generational handles. A handle points to a slot,
+/// which knows the position of the transform in the dense arrays. Destroying a
+/// transform moves the last one into the gap and bumps the generation of the slot,
+/// so stale handles are detected.
+/// Changing a transform only marks it as dirty. Update() composes the matrices of
+/// all dirty transforms in one pass, with AVX2 (8 transforms at once) if the CPU
+/// supports it and a scalar fallback otherwise. A new view matrix marks all
+/// transforms dirty, since the normal matrices live in view space. Every
+/// recomputation bumps the version of a transform, so owners know when to upload.
+/// Create(), Destroy() and SetState() may be called from multiple threads (scene
+/// initialization). Everything else is meant for the render thread.
+/// </remarks>
+class TransformSystem {
+public:
+    /// <summary>
+    /// Returns the system used by all ModelClass objects.
+    /// </summary>
+    static TransformSystem& Default();
+
+    /// <summary>
+    /// Returns true if the CPU and OS support AVX2.
+    /// </summary>
+    static bool IsAvx2Supported();
+
+    /// <summary>
+    /// Composes the model matrix (scale, rotation, translation) of a state.
+    /// </summary>
+    /// <param name="state">State of a transform.</param>
+    /// <returns>Model matrix.</returns>
+    static sm::Matrix ComputeModelMatrix(const ModelState& state);
+
+    /// <summary>
+    /// Computes the normal matrix (inverse transpose of the 3x3 part of the model
+    /// view matrix) in closed form.
+    /// </summary>
+    /// <param name="modelMatrix">Model matrix.</param>
+    /// <param name="viewMatrix">View matrix.</param>
+    /// <returns>Normal matrix.</returns>
+    static sm::Matrix ComputeNormalMatrix(
+        const sm::Matrix& modelMatrix,
+        const sm::Matrix& viewMatrix);
+
+    /// <summary>
+    /// Computes the normal matrix via a full 4x4 inverse. Slower than
+    /// ComputeNormalMatrix(), kept as reference for validation and benchmarks.
+    /// </summary>
+    /// <param name="modelMatrix">Model matrix.</param>
+    /// <param name="viewMatrix">View matrix.</param>
+    /// <returns>Normal matrix.</returns>
+    static sm::Matrix ComputeNormalMatrixReference(
+        const sm::Matrix& modelMatrix,
+        const sm::Matrix& viewMatrix);
+
+    /// <summary>
+    /// Creates a transform. It is dirty until the next Update().
+    /// </summary>
+    /// <param name="state">Initial state.</param>
+    /// <returns>Handle of the transform.</returns>
+    TransformHandle Create(const ModelState& state);
+
+    /// <summary>
+    /// Destroys a transform. The handle becomes invalid.
+    /// </summary>
+    void Destroy(TransformHandle handle);
+
+    /// <summary>
+    /// Returns true if the handle refers to an existing transform.
+    /// </summary>
+    bool IsValid(TransformHandle handle) const;
+
+    /// <summary>
+    /// Returns the state of a transform.
+    /// </summary>
+    ModelState GetState(TransformHandle handle) const;
+
+    /// <summary>
+    /// Sets the state of a transform and marks it as dirty, if it changed.
+    /// </summary>
+    void SetState(TransformHandle handle, const ModelState& state);
+
+    /// <summary>
+    /// Sets the view matrix used for the normal matrices. Marks all transforms as
+    /// dirty, if it changed.
+    /// </summary>
+    void SetViewMatrix(const sm::Matrix& viewMat);
+
+    /// <summary>
+    /// Composes model and normal matrices of all dirty transforms.
+    /// </summary>
+    void Update();
+
+    /// <summary>
+    /// Returns the model matrix of a transform as of the last Update().
+    /// </summary>
+    const sm::Matrix& GetModelMatrix(TransformHandle handle) const;
+
+    /// <summary>
+    /// Returns the normal matrix of a transform as of the last Update().
+    /// </summary>
+    const sm::Matrix& GetNormalMatrix(TransformHandle handle) const;
+
+    /// <summary>
+    /// Returns a counter that increases every time the matrices of a transform are
+    /// recomputed. Starts at 0 before the first Update().
+    /// </summary>
+    UINT32 GetVersion(TransformHandle handle) const;
+
+    /// <summary>
+    /// Returns the number of transforms.
+    /// </summary>
+    size_t GetCount() const;
+
+    /// <summary>
+    /// Enables or disables the AVX2 path. Ignored if AVX2 is not supported.
+    /// </summary>
+    void SetUseAvx2(bool useAvx2);
+
+    /// <summary>
+    /// Returns true if Update() uses the AVX2 path.
+    /// </summary>
+    bool GetUseAvx2() const;
+
+private:
+    /// <summary>
+    /// Slot of a handle.
+    /// </summary>
+    struct Slot {
+        UINT32 denseIdx;
+        UINT32 generation;
+    };
+
+    /// <summary>
+    /// Returns the dense index of a valid handle.
+    /// </summary>
+    UINT32 denseIndex(TransformHandle handle) const;
+
+    /// <summary>
+    /// Marks a transform as dirty. The caller has to hold m_mutex.
+    /// </summary>
+    void markDirty(UINT32 denseIdx);
+
+    /// <summary>
+    /// Composes the matrices of the given transforms one by one.
+    /// </summary>
+    /// <param name="indices">Dense indices.</param>
+    /// <param name="count">Number of indices.</param>
+    void composeScalar(const UINT32* indices, size_t count);
+
+    /// <summary>
+    /// Composes the matrices of the given transforms 8 at a time. The remainder is
+    /// passed to composeScalar().
+    /// </summary>
+    /// <param name="indices">Dense indices.</param>
+    /// <param name="count">Number of indices.</param>
+    void composeAvx2(const UINT32* indices, size_t count);
+
+    // Transforms (dense, structure of arrays).
+    std::vector<float> m_posX;
+    std::vector<float> m_posY;
+    std::vector<float> m_posZ;
+    std::vector<float> m_rotX;
+    std::vector<float> m_rotY;
+    std::vector<float> m_rotZ;
+    std::vector<float> m_rotW;
+    std::vector<float> m_scale;
+
+    // Results (dense).
+    std::vector<sm::Matrix> m_modelMats;
+    std::vector<sm::Matrix> m_normalMats;
+    std::vector<UINT32> m_versions;
+
+    // Handle management.
+    std::vector<Slot> m_slots;
+    std::vector<UINT32> m_freeSlots;
+    std::vector<UINT32> m_denseToSlot;
+    std::mutex m_mutex;
+
+    // Dirty tracking. The list holds dense indices, flags prevent duplicates.
+    std::vector<UINT8> m_dirtyFlags;
+    std::vector<UINT32> m_dirtyList;
+    bool m_allDirty = false;
+    bool m_dirtyListStale = false;      // Dense indices moved (Destroy()).
+
+    sm::Matrix m_viewMat;
+    bool m_useAvx2 = IsAvx2Supported();
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+/// <summary>
+/// Describes contents of a vertex.
+/// </summary>
+/// <remarks>
+/// Currently used for all possible models. Sometimes space is wasted. TODO: Improve.
+/// </remarks>
+struct alignas(16) Vertex {
+    sm::Vector3 Position;
+    sm::Vector2 TexCoords;
+
+    // Normal Mapping.
+    sm::Vector3 Normal;     // Object/model space.
+    sm::Vector3 Tangent;    // Object/model space.
+    sm::Vector3 Bitangent;  // Object/model space.
+
+    Vertex(sm::Vector3 pos, sm::Vector2 texCoords, sm::Vector3 normal,
+            sm::Vector3 tangent, sm::Vector3 bitangent) {
+        Position = pos;
+        TexCoords = texCoords;
+
+        Normal = normal;
+        Tangent = tangent;
+        Bitangent = bitangent;
+    }
+
+    // For supporting cube, sphere, ...
+    Vertex(sm::Vector3 pos, sm::Vector3 normal, sm::Vector2 texCoords) {
+        Position = pos;
+        TexCoords = texCoords;
+
+        Normal = normal;
+        Tangent = sm::Vector3(0.0,0.0,0.0);
+        Bitangent = sm::Vector3(0.0, 0.0, 0.0);
+    }
+
+    // For custom mesh.
+    Vertex(sm::Vector3 pos, sm::Vector2 texCoords) {
+        Position = pos;
+        TexCoords = texCoords;
+
+        Normal = sm::Vector3(0.0, 0.0, 0.0);
+        Tangent = sm::Vector3(0.0, 0.0, 0.0);
+        Bitangent = sm::Vector3(0.0, 0.0, 0.0);
+    }
+
+    // Default.
+    Vertex() {
+        Position = sm::Vector3(0.0,0.0,0.0);
+        TexCoords = sm::Vector2(0.0, 0.0);
+
+        Normal = sm::Vector3(0.0, 0.0, 0.0);
+        Tangent = sm::Vector3(0.0, 0.0, 0.0);
+        Bitangent = sm::Vector3(0.0, 0.0, 0.0);
+    }
+};
@@ -0,0 +1,139 @@
+#include "stdafx.h"
+#include "WorkerPool.h"
+
+/*
+ * WorkerPool::Get
+ */
+WorkerPool& WorkerPool::Get() {
+    static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+
+/*
+ * WorkerPool::WorkerPool
+ */
+WorkerPool::WorkerPool(unsigned int workerCnt) {
+    for (unsigned int i = 0; i < workerCnt; i++) {
+        m_workers.push_back(std::thread(&WorkerPool::workerLoop, this));
+    }
+}
+
+
+/*
+ * WorkerPool::~WorkerPool
+ */
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_workAvailable.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+
+/*
+ * WorkerPool::GetWorkerCount
+ */
+unsigned int WorkerPool::GetWorkerCount() const {
+    return static_cast<unsigned int>(m_workers.size());
+}
+
+
+/*
+ * WorkerPool::Run
+ */
+void WorkerPool::Run(unsigned int count, const std::function<void(unsigned int)>& work) {
+    if (count == 0) {
+        return;
+    }
+
+    Batch batch;
+    if (count > 1 && !m_workers.empty()) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (unsigned int idx = 1; idx < count; idx++) {
+            m_queue.push_back({ &work, idx, &batch });
+        }
+        m_workAvailable.notify_all();
+    }
+
+    std::exception_ptr exception;
+    execute({ &work, 0, &batch }, exception);
+    if (m_workers.empty()) {
+        for (unsigned int idx = 1; idx < count; idx++) {
+            execute({ &work, idx, &batch }, exception);
+        }
+    }
+
+    // Take back what no worker started, then wait for the rest.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        auto it = std::find_if(m_queue.begin(), m_queue.end(),
+            [&batch](const Job& job) { return job.batch == &batch; });
+        if (it != m_queue.end()) {
+            Job job = *it;
+            m_queue.erase(it);
+            lock.unlock();
+            execute(job, exception);
+            lock.lock();
+        } else if (batch.runningCnt > 0) {
+            m_jobDone.wait(lock);
+        } else {
+            break;
+        }
+    }
+    if (!exception) {
+        exception = batch.exception;
+    }
+    lock.unlock();
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+
+/*
+ * WorkerPool::workerLoop
+ */
+void WorkerPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_workAvailable.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+        if (m_stop) {
+            return;
+        }
+
+        Job job = m_queue.front();
+        m_queue.pop_front();
+        job.batch->runningCnt++;
+        lock.unlock();
+
+        std::exception_ptr exception;
+        execute(job, exception);
+
+        lock.lock();
+        if (exception && !job.batch->exception) {
+            job.batch->exception = exception;
+        }
+        job.batch->runningCnt--;
+        m_jobDone.notify_all();
+    }
+}
+
+
+/*
+ * WorkerPool::execute
+ */
+void WorkerPool::execute(const Job& job, std::exception_ptr& exception) {
+    try {
+        (*job.work)(job.idx);
+    } catch (...) {
+        if (!exception) {
+            exception = std::current_exception();
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+/// <summary>
+/// Persistent worker threads shared by all parallel work of the renderer: task
+/// graphs at start-up and the culling passes every frame.
+/// </summary>
+/// <remarks>
+/// The pool is created on first use with one thread less than the hardware has,
+/// since the thread that submits always works as well. Run() pushes every call but
+/// the first onto a shared queue and wakes the workers. Once the caller finished
+/// its own share, it takes back the calls of its Run() that no worker has started
+/// yet and runs them itself, so nested Run() calls (a task that runs a task graph)
+/// neither wait for busy workers nor add threads.
+/// </remarks>
+class WorkerPool {
+public:
+    /// <summary>
+    /// Returns the pool of the process.
+    /// </summary>
+    static WorkerPool& Get();
+
+    /// <summary>
+    /// Starts a pool of its own. Everything else shares the one of Get().
+    /// </summary>
+    explicit WorkerPool(unsigned int workerCnt);
+
+    /// <summary>
+    /// Returns the number of worker threads, not counting the calling thread.
+    /// </summary>
+    unsigned int GetWorkerCount() const;
+
+    /// <summary>
+    /// Calls work(idx) for every idx in [0, count) and blocks until all calls
+    /// returned. idx 0 runs on the calling thread. If a call throws, the first
+    /// exception is rethrown once all calls are done.
+    /// </summary>
+    /// <param name="count">Number of calls. More than GetWorkerCount() + 1 calls
+    /// are allowed, but do not run in parallel.</param>
+    /// <param name="work">Function to call.</param>
+    void Run(unsigned int count, const std::function<void(unsigned int)>& work);
+
+    ~WorkerPool();
+
+private:
+    /// <summary>
+    /// Calls of a single Run().
+    /// </summary>
+    struct Batch {
+        unsigned int runningCnt = 0;    // Calls taken by workers and not done.
+        std::exception_ptr exception;
+    };
+
+    /// <summary>
+    /// A single call that waits for a worker.
+    /// </summary>
+    struct Job {
+        const std::function<void(unsigned int)>* work;
+        unsigned int idx;
+        Batch* batch;
+    };
+
+    /// <summary>
+    /// Main loop of a worker thread.
+    /// </summary>
+    void workerLoop();
+
+    /// <summary>
+    /// Runs a job. Keeps the first exception in exception.
+    /// </summary>
+    static void execute(const Job& job, std::exception_ptr& exception);
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_jobDone;
+    std::deque<Job> m_queue;                // Kept in submit order.
+    bool m_stop = false;
+};
@@ -0,0 +1,139 @@
+#include "LightAttenuation.hlsli"
+#include "PackedLight.hlsli"
+
+
+// Samplers.
+SamplerState gBufferSampler : register(s1);	// Nearest Neighbor, clamp to edge.
+
+
+// Textures.
+Texture2D<float> gBufferDepth	: register(t0);
+Texture2D gNormal				: register(t1);	// World space.
+
+
+// Point lights, LightPool::PackedLight.
+StructuredBuffer<Light> lights	: register(t2);
+Buffer<uint2> clusterRanges		: register(t3);	// Offset and count per cluster.
+Buffer<uint> lightIndices		: register(t4);	// Lights of all clusters.
+
+
+// Input of the pixel shader.
+struct ps_in {
+	float4 FragPos : SV_POSITION;	// Clip space.
+};
+
+
+// Output of the pixel shader.
+struct ps_out {
+	float4 diffuseLighting	: SV_Target0;	// Diffuse lighting, 1 empty entry.
+	float4 specularLighting	: SV_Target1;	// Specular lighting, 1 empty entry.
+};
+
+
+// Information from scene.
+cbuffer PS_CONSTANT_BUFFER : register(b1) {
+	// Shading information information.
+	float3 lightingScales;	// Weighting of phong terms.
+	float shininessExp;
+
+	// For visualization of normals in view space (matches sponza reference).
+	float4x4 viewMat;
+
+	// For SSAO.
+	float4x4 projMat;
+
+	// For rendering of light volumes.
+	float4x4 invViewProjMat;
+
+	// Other information.
+	int drawMode;
+	float3 viewPos;		// World space.
+	float4 pixelSize;
+};
+
+
+// Clusters of the light lists, see ClusteredLightCuller.
+cbuffer CLUSTERED_LIGHTING_CONSTANT_BUFFER : register(b2) {
+	uint3 clusters;			// Per row, per column and slices.
+	uint clusterPadding;
+	float sliceScale;		// slice = log(depth) * sliceScale + sliceBias.
+	float sliceBias;
+	float depthScale;		// depth = depthScale / (z + depthOffset).
+	float depthOffset;
+};
+
+
+// Reconstruct world position via depth buffer.
+float3 reconstructWorldPos(float2 uv, float z) {
+	float4 sPos = float4(uv * 2.0 - 1.0, z, 1.0);
+	sPos.y *= -1.0;
+	sPos = mul(sPos, invViewProjMat);
+	return (sPos.xyz / sPos.w);
+}
+
+
+// Octahedron-normal vectors.
+float3 DecodeNormal(float2 f) {
+	f = f * 2.0 - 1.0;
+
+	// https://twitter.com/Stubbesaurus/status/937994790553227264
+	float3 n = float3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+
+// Entry point of shader.
+ps_out main(ps_in input){
+	float2 texCoords = float2(input.FragPos.x * pixelSize.x,
+		input.FragPos.y * pixelSize.y);
+
+	// The G-buffer is read once for all lights of the cluster.
+	float z = gBufferDepth.Sample(gBufferSampler, texCoords).r;
+	float3 fragPosWorld = reconstructWorldPos(texCoords, z);
+	float3 normal = normalize(DecodeNormal(gNormal.Sample(gBufferSampler, texCoords)));
+	float3 viewDir = normalize(viewPos - fragPosWorld);
+
+	// Tile of the screen position, slice of the linear depth.
+	uint2 tile = min(uint2(texCoords * clusters.xy), clusters.xy - 1);
+	float depth = depthScale / (z + depthOffset);
+	uint slice = uint(clamp(log(depth) * sliceScale + sliceBias, 0.0,
+		clusters.z - 1.0));
+	uint2 range = clusterRanges[(slice * clusters.y + tile.y) * clusters.x + tile.x];
+
+	float3 diffuse = 0.0;
+	float3 specular = 0.0;
+	for (uint i = 0; i < range.y; i++) {
+		Light light = lights[lightIndices[range.x + i]];
+
+		// Same attenuation as the light volumes, which also end at the surface of
+		// their sphere, the radius (half the scale).
+		float3 lightPos = light.PositionRadius.xyz;
+		float radius = light.PositionRadius.w;
+		float dist = length(lightPos - fragPosWorld);
+		if (dist >= radius) {
+			continue;
+		}
+		float atten = attenuate(dist, radius);
+		float3 color = unpackColor(light.Color);
+
+		// Compute important directions.
+		float3 incident = normalize(lightPos - fragPosWorld);
+		float3 halfDir = normalize(incident + viewDir);
+
+		// Compute Phong shading terms.
+		float lambert = clamp(dot(incident, normal), 0.0, 1.0);
+		float rFactor = clamp(dot(halfDir, normal), 0.0, 1.0);
+		float sFactor = pow(rFactor, shininessExp);
+
+		diffuse += color * lambert * atten;
+		specular += color * sFactor * atten;
+	}
+
+	// Construct output. Same targets as the light volumes.
+	ps_out output;
+	output.diffuseLighting = float4(diffuse, 1.0);
+	output.specularLighting = float4(specular, 1.0);
+	return output;
+}
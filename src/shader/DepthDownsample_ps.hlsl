@@ -0,0 +1,31 @@
+// Textures.
+Texture2D depthTexture : register(t0);	// G-buffer depth.
+
+
+// Information from vertex shader.
+struct ps_in {
+	float4 FragPos : SV_POSITION;	// Clip space.
+};
+
+
+// Set by DepthReadback.
+cbuffer DOWNSAMPLE_BUFFER : register(b0) {
+	uint2 sourceSize;		// Texels of the depth texture.
+	uint factor;			// Depth texels per target pixel and axis.
+	uint padding0;
+};
+
+
+// Entry point of shader.
+float main(ps_in input) : SV_TARGET {
+	// Farthest depth of the block, so occlusion tests on the CPU stay conservative.
+	uint2 first = uint2(input.FragPos.xy) * factor;
+	uint2 last = min(first + factor, sourceSize) - 1;
+	float result = 0.0;
+	for (uint y = first.y; y <= last.y; ++y) {
+		for (uint x = first.x; x <= last.x; ++x) {
+			result = max(result, depthTexture.Load(int3(x, y, 0)).r);
+		}
+	}
+	return result;
+}
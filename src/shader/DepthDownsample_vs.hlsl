@@ -0,0 +1,15 @@
+// Input of the pixel shader.
+struct ps_in {
+	float4 FragPos : SV_POSITION;	// Clip space.
+};
+
+
+// Entry point of shader. Creates a single triangle that covers the whole viewport,
+// so no vertex buffer is needed.
+ps_in main(uint vertexId : SV_VertexID) {
+	float2 corner = float2((vertexId << 1) & 2, vertexId & 2);
+
+	ps_in output;
+	output.FragPos = float4(corner * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+	return output;
+}
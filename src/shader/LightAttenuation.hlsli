@@ -0,0 +1,23 @@
+// Attenuation of the point lights, shared by the lighting shaders and SceneMath.cpp,
+// which computes the radii of the lights from it. Only the constants are C++ as well.
+
+
+// 1 / (constant + linear * d + quadratic * d^2), for a range of about 20 units (see
+// the table of https://learnopengl.com/Lighting/Light-casters).
+static const float LIGHT_ATTENUATION_CONSTANT = 1.0f;
+static const float LIGHT_ATTENUATION_LINEAR = 0.22f;	// Decrease with distance.
+static const float LIGHT_ATTENUATION_QUADRATIC = 0.2f;	// Quicker falloff further out.
+
+// Lights end where their brightest channel falls below 5 levels of 8 bits.
+static const float LIGHT_CUTOFF = 5.0f / 256.0f;
+
+
+#ifndef __cplusplus
+// Attenuation faded out towards the radius of the light, where it reaches 0. Matches
+// SceneMath::ComputeLightAttenuation().
+float attenuate(float dist, float radius) {
+	float fade = saturate(1.0 - pow(dist / radius, 4.0));
+	return fade * fade / (LIGHT_ATTENUATION_CONSTANT + LIGHT_ATTENUATION_LINEAR * dist +
+		LIGHT_ATTENUATION_QUADRATIC * (dist * dist));
+}
+#endif
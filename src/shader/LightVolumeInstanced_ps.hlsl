@@ -1,3 +1,6 @@
+#include "LightAttenuation.hlsli"
+
+
 // Samplers.
 SamplerState sampleStyle: register(s0);		// Defines reconstruction filter etc.
 SamplerState gBufferSampler : register(s1);	// Nearest Neighbor, clamp to edge.
@@ -97,21 +100,12 @@ ps_out main(ps_in input){
 	// Reconstruct world position vida depth buffer.
 	float3 fragPosWorld = reconstructWorldPos(texCoords);
 
-	// Check if we are inside the volume. TODO: There is a weird error somewhere.
-	// It's currently necessary to add 14 to the distance, otherwise the results
-	// are not as expected.
+	// Check if we are inside the volume, which covers more than the sphere.
 	float dist = length(input.LightPos - fragPosWorld);
-	float atten = 1.0 - clamp((dist + 15) / input.LightRadius, 0.0, 1.0);
-	if (atten == 0.0) {
+	if (dist >= input.LightRadius) {
 		discard;
 	}
-
-	// Compute attenuation in more detail according to table of
-	// https://learnopengl.com/Lighting/Light-casters
-	float lconst = 1.0;
-	float llin = 0.14;	// Linear decrease with distance.
-	float lquad = 0.07;	// Becomes large with higher distances. Quicker falloff.
-	//atten = 1.0 / (lconst + llin * dist + lquad * (dist * dist));
+	float atten = attenuate(dist, input.LightRadius);
 
 	// Sample normal from gBuffer.
 	float3 normal = normalize(DecodeNormal(gNormal.Sample(gBufferSampler, texCoords)));
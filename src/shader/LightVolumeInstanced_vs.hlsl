@@ -56,7 +56,7 @@ ps_in main(vs_in0 input0, vs_in1 input1) {
 	ps_in output;
 	output.FragPos = screenCoord;
 	output.LightPos = input1.instancePosition.xyz;
-	output.LightRadius = input1.instanceScale.x;
+	output.LightRadius = 0.5 * input1.instanceScale.x;	// Of the unit sphere.
 	output.LightColor = input1.instanceColor;
 	return output;
 }
\ No newline at end of file
@@ -0,0 +1,16 @@
+// Point lights as LightPool::PackedLight stores them, shared by the tiled and the
+// clustered lighting.
+
+
+struct Light {
+	float4 PositionRadius;	// World space.
+	uint Color;				// RGB9E5, red in the lowest bits.
+};
+
+
+// Color of a light including its intensity, see LightPool::UnpackColor(). As
+// DXGI_FORMAT_R9G9B9E5_SHAREDEXP: 9 bit mantissas scaled by 2^(exponent - 15 - 9).
+float3 unpackColor(uint color) {
+	return float3(color & 0x1FF, (color >> 9) & 0x1FF, (color >> 18) & 0x1FF) *
+		exp2(float(color >> 27) - 24.0);
+}
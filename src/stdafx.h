@@ -1,6 +1,9 @@
 // Pre-compiled header.
 #pragma once
 
+// PORTABLE_CORE builds the Direct3D-free cores only (see CMakeLists.txt): math and
+// the standard library, on any OS.
+#ifndef PORTABLE_CORE
 #ifndef UNICODE
 #define UNICODE
 #endif 
@@ -11,6 +14,7 @@
 #endif
 #define NOMINMAX
 #include <Windows.h>
+#include <tchar.h>
 
 // DirectX 11 specific headers.
 #include <d3d11.h>
@@ -47,16 +51,49 @@ namespace sm = DirectX::SimpleMath;
 #include <wrl.h>
 namespace wrl = Microsoft::WRL;
 
+#else
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <wsl/winadapter.h>
+#endif
+
+// Math.
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "SimpleMath.h"
+#include <dxgiformat.h>
+namespace dx = DirectX;
+namespace sm = DirectX::SimpleMath;
+#endif
+
 // STL Headers.
 #include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <string>
-#include <tchar.h>
 #include <queue>
+#include <deque>
 #include <array>
 #include <thread>
+#include <future>
 #include <iostream>
 #include <locale>
 #include <codecvt>
-#include <random>
\ No newline at end of file
+#include <random>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <fstream>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "Platform.h"
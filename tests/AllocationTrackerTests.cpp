@@ -0,0 +1,111 @@
+#include "Test.h"
+#include "AllocationTracker.h"
+
+/// <summary>
+/// Puts the tracker into a known state with a warm-up of warmUpFrames frames.
+/// </summary>
+static void resetTracker(unsigned int warmUpFrames) {
+    AllocationTracker::SetEnabled(true);
+    AllocationTracker::SetAssertOnAllocation(false);
+    AllocationTracker::SetCaptureStacks(false);
+    AllocationTracker::SetWarmUpFrames(warmUpFrames);
+    AllocationTracker::Reset();
+}
+
+
+/// <summary>
+/// Runs a frame with allocCnt allocations of the render thread.
+/// </summary>
+static void runFrame(unsigned int allocCnt) {
+    AllocationTracker::BeginFrame();
+    for (unsigned int i = 0; i < allocCnt; i++) {
+        AllocationTracker::OnAllocation(16);
+    }
+    AllocationTracker::EndFrame();
+}
+
+
+TEST(AllocationTracker, CountsTheAllocationsOfAFrame) {
+    resetTracker(0);
+    AllocationTracker::BeginFrame();
+    AllocationTracker::OnAllocation(100);
+    {
+        AllocationTracker::Scope scope("AllocationTrackerTests");
+        AllocationTracker::OnAllocation(28);
+    }
+    AllocationTracker::OnFree();
+    AllocationTracker::EndFrame();
+
+    AllocationTracker::FrameStats stats = AllocationTracker::GetLastFrameStats();
+    CHECK(stats.allocCount == 2);
+    CHECK(stats.allocBytes == 128);
+    CHECK(stats.freeCount == 1);
+
+    // BeginFrame starts counting from zero.
+    runFrame(0);
+    AllocationTracker::FrameStats next = AllocationTracker::GetLastFrameStats();
+    CHECK(next.frameIdx == stats.frameIdx + 1);
+    CHECK(next.allocCount == 0);
+    CHECK(next.allocBytes == 0);
+    CHECK(next.freeCount == 0);
+
+    // Nothing is counted while disabled.
+    AllocationTracker::SetEnabled(false);
+    runFrame(3);
+    CHECK(AllocationTracker::GetLastFrameStats().allocCount == 0);
+    AllocationTracker::SetEnabled(true);
+}
+
+
+TEST(AllocationTracker, IgnoresAllocationsDuringWarmUp) {
+    resetTracker(3);
+    UINT64 violationCnt = AllocationTracker::GetViolationFrameCount();
+    for (unsigned int i = 0; i < 3; i++) {
+        runFrame(5);
+        CHECK(AllocationTracker::GetLastFrameStats().allocCount == 5);
+    }
+    CHECK(AllocationTracker::GetViolationFrameCount() == violationCnt);
+
+    runFrame(1);
+    CHECK(AllocationTracker::GetViolationFrameCount() == violationCnt + 1);
+
+    // Reset restarts the warm-up.
+    AllocationTracker::Reset();
+    runFrame(1);
+    CHECK(AllocationTracker::GetViolationFrameCount() == violationCnt + 1);
+}
+
+
+TEST(AllocationTracker, ReportsEveryAllocatingFrameAfterWarmUp) {
+    resetTracker(0);
+    UINT64 violationCnt = AllocationTracker::GetViolationFrameCount();
+    runFrame(0);
+    CHECK(AllocationTracker::GetViolationFrameCount() == violationCnt);
+    runFrame(2);
+    CHECK(AllocationTracker::GetViolationFrameCount() == violationCnt + 1);
+    runFrame(0);
+    CHECK(AllocationTracker::GetViolationFrameCount() == violationCnt + 1);
+    runFrame(1);
+    CHECK(AllocationTracker::GetViolationFrameCount() == violationCnt + 2);
+}
+
+
+TEST(AllocationTracker, IgnoresOtherThreads) {
+    resetTracker(0);
+    UINT64 violationCnt = AllocationTracker::GetViolationFrameCount();
+    AllocationTracker::BeginFrame();
+    std::thread worker([]() {
+        AllocationTracker::OnAllocation(64);
+        AllocationTracker::OnAllocation(64);
+        AllocationTracker::OnFree();
+    });
+    worker.join();
+    AllocationTracker::EndFrame();
+
+    AllocationTracker::FrameStats stats = AllocationTracker::GetLastFrameStats();
+    CHECK(stats.allocCount == 0);
+    CHECK(stats.allocBytes == 0);
+    CHECK(stats.freeCount == 0);
+    CHECK(stats.otherThreadAllocCount == 2);
+    CHECK(AllocationTracker::GetViolationFrameCount() == violationCnt);
+}
@@ -0,0 +1,154 @@
+#include "Test.h"
+#include "BenchmarkStore.h"
+
+/// <summary>
+/// Returns a metric with count samples value, value + step, ...
+/// </summary>
+static BenchmarkStore::Metric makeMetric(const std::string& name, double value,
+        double step, unsigned int count) {
+    BenchmarkStore::Metric metric;
+    metric.name = name;
+    for (unsigned int i = 0; i < count; i++) {
+        metric.samples.push_back(value + step * i);
+    }
+    return metric;
+}
+
+
+/// <summary>
+/// Returns the comparison of a metric.
+/// </summary>
+static const BenchmarkStore::Comparison* findComparison(
+        const std::vector<BenchmarkStore::Comparison>& comparisons,
+        const std::string& name) {
+    for (const BenchmarkStore::Comparison& comparison : comparisons) {
+        if (comparison.name == name) {
+            return &comparison;
+        }
+    }
+    return nullptr;
+}
+
+
+TEST(BenchmarkStore, MannWhitneyUMatchesTheNormalApproximation) {
+    // U = 0, mean 12.5, variance 25 * 11 / 12. z = 12 / sqrt(22.9167) = 2.5067.
+    double p = BenchmarkStore::MannWhitneyU({ 1, 2, 3, 4, 5 }, { 6, 7, 8, 9, 10 });
+    CHECK_NEAR(p, 0.012186, 1e-5);
+    CHECK_NEAR(BenchmarkStore::MannWhitneyU({ 6, 7, 8, 9, 10 }, { 1, 2, 3, 4, 5 }),
+        p, 1e-12);
+
+    // Overlapping samples without ties: 4 and 5 beat 3.5, so U = 2.
+    CHECK_NEAR(BenchmarkStore::MannWhitneyU({ 1, 2, 3, 4, 5 }, { 3.5, 5.5, 6, 7, 8 }),
+        0.036714, 1e-5);
+}
+
+
+TEST(BenchmarkStore, MannWhitneyUCorrectsForTies) {
+    // Ranks 1, 2.5, 2.5, 5, 5 | 5, 7.5, 7.5, 9.5, 9.5, so U = 1. Tie groups of
+    // 2, 3, 2 and 2 reduce the variance to 25 / 12 * (11 - 42 / 90).
+    double p = BenchmarkStore::MannWhitneyU({ 1, 2, 2, 3, 3 }, { 3, 4, 4, 5, 5 });
+    CHECK_NEAR(p, 0.018866, 1e-5);
+
+    // Identical samples are never different, even if every value is tied.
+    CHECK(BenchmarkStore::MannWhitneyU({ 1, 2, 3 }, { 1, 2, 3 }) == 1.0);
+    CHECK(BenchmarkStore::MannWhitneyU({ 4, 4, 4 }, { 4, 4, 4 }) == 1.0);
+    CHECK(BenchmarkStore::MannWhitneyU({}, { 1, 2, 3 }) == 1.0);
+}
+
+
+TEST(BenchmarkStore, CompareReportsSignificantChanges) {
+    BenchmarkStore::ResultSet base;
+    base.metrics.push_back(makeMetric("Slower", 10.0, 0.01, 20));
+    base.metrics.push_back(makeMetric("Faster", 10.0, 0.01, 20));
+    base.metrics.push_back(makeMetric("Same", 10.0, 0.01, 20));
+    base.metrics.push_back(makeMetric("Tiny", 10.0, 0.001, 20));
+    base.metrics.push_back(makeMetric("Removed", 10.0, 0.01, 20));
+
+    BenchmarkStore::ResultSet current;
+    current.metrics.push_back(makeMetric("Slower", 12.0, 0.01, 20));
+    current.metrics.push_back(makeMetric("Faster", 8.0, 0.01, 20));
+    current.metrics.push_back(makeMetric("Same", 10.005, 0.01, 20));
+    current.metrics.push_back(makeMetric("Tiny", 10.05, 0.001, 20));
+    current.metrics.push_back(makeMetric("Added", 10.0, 0.01, 20));
+
+    std::vector<BenchmarkStore::Comparison> comparisons =
+        BenchmarkStore::Compare(base, current);
+    CHECK(comparisons.size() == 6);
+
+    const BenchmarkStore::Comparison* slower = findComparison(comparisons, "Slower");
+    REQUIRE(slower != nullptr);
+    CHECK(slower->verdict == BenchmarkStore::Verdict::REGRESSION);
+    CHECK(slower->pValue < 0.05);
+    CHECK_NEAR(slower->changePercent, 100.0 * 2.0 / 10.095, 1e-6);
+
+    const BenchmarkStore::Comparison* faster = findComparison(comparisons, "Faster");
+    REQUIRE(faster != nullptr);
+    CHECK(faster->verdict == BenchmarkStore::Verdict::IMPROVEMENT);
+    CHECK(faster->changePercent < 0.0);
+
+    const BenchmarkStore::Comparison* same = findComparison(comparisons, "Same");
+    REQUIRE(same != nullptr);
+    CHECK(same->verdict == BenchmarkStore::Verdict::UNCHANGED);
+    CHECK(same->pValue >= 0.05);
+
+    // Significant, but below the minimum change of 2%.
+    const BenchmarkStore::Comparison* tiny = findComparison(comparisons, "Tiny");
+    REQUIRE(tiny != nullptr);
+    CHECK(tiny->verdict == BenchmarkStore::Verdict::UNCHANGED);
+    CHECK(tiny->pValue < 0.05);
+
+    for (const char* name : { "Added", "Removed" }) {
+        const BenchmarkStore::Comparison* missing = findComparison(comparisons, name);
+        REQUIRE(missing != nullptr);
+        CHECK(missing->verdict == BenchmarkStore::Verdict::MISSING);
+    }
+}
+
+
+TEST(BenchmarkStore, SaveAndLoadKeepEverything) {
+    BenchmarkStore::ResultSet resultSet;
+    resultSet.source = "frame \"sponza\"";
+    resultSet.timestamp = "2024-05-01T12:00:00Z";
+    resultSet.gitRevision = "0123456789abcdef";
+    resultSet.machine.cpu = "Test CPU\t@ 3.0\\GHz\x01";
+    resultSet.machine.logicalCores = 16;
+    resultSet.machine.memoryMB = 32768;
+    resultSet.machine.compiler = "Compiler\n1.0";
+    resultSet.machine.buildConfig = "Release";
+    resultSet.config.width = 1920;
+    resultSet.config.height = 1080;
+    resultSet.config.shadowMapSize = 2048;
+    resultSet.config.ssaoKernelSize = 32;
+    resultSet.config.lightCount = 512;
+    resultSet.metrics.push_back(makeMetric("Frame/cpu", 4.25, 0.125, 7));
+    resultSet.metrics.back().itemCnt = 3;
+    resultSet.metrics.push_back(makeMetric("GEOMETRY/DRAW_CALLS", 1200.0, 1.0, 3));
+    resultSet.metrics.back().unit = "count";
+
+    std::string path = (std::filesystem::temp_directory_path() /
+        "sponza_benchmark_store_test.json").string();
+    BenchmarkStore::Save(resultSet, path);
+    BenchmarkStore::ResultSet loaded = BenchmarkStore::Load(path);
+    std::filesystem::remove(path);
+
+    CHECK(loaded.source == resultSet.source);
+    CHECK(loaded.timestamp == resultSet.timestamp);
+    CHECK(loaded.gitRevision == resultSet.gitRevision);
+    CHECK(loaded.machine.cpu == resultSet.machine.cpu);
+    CHECK(loaded.machine.logicalCores == resultSet.machine.logicalCores);
+    CHECK(loaded.machine.memoryMB == resultSet.machine.memoryMB);
+    CHECK(loaded.machine.compiler == resultSet.machine.compiler);
+    CHECK(loaded.machine.buildConfig == resultSet.machine.buildConfig);
+    CHECK(loaded.config.width == resultSet.config.width);
+    CHECK(loaded.config.height == resultSet.config.height);
+    CHECK(loaded.config.shadowMapSize == resultSet.config.shadowMapSize);
+    CHECK(loaded.config.ssaoKernelSize == resultSet.config.ssaoKernelSize);
+    CHECK(loaded.config.lightCount == resultSet.config.lightCount);
+    REQUIRE(loaded.metrics.size() == resultSet.metrics.size());
+    for (size_t i = 0; i < resultSet.metrics.size(); i++) {
+        CHECK(loaded.metrics[i].name == resultSet.metrics[i].name);
+        CHECK(loaded.metrics[i].unit == resultSet.metrics[i].unit);
+        CHECK(loaded.metrics[i].itemCnt == resultSet.metrics[i].itemCnt);
+        CHECK(loaded.metrics[i].samples == resultSet.metrics[i].samples);
+    }
+}
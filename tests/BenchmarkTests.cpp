@@ -0,0 +1,26 @@
+#include "Test.h"
+#include "Benchmark.h"
+
+TEST(Benchmark, ResultSetNamesMetricsByKernelAndSize) {
+    Benchmark::Result result;
+    result.kernel = "Lights";
+    result.size = "stress";
+    result.itemCnt = 1024;
+    result.samplesMs = { 1.0, 2.0, 3.0 };
+    BenchmarkStore::ResultSet resultSet = Benchmark::CreateResultSet({ result });
+    REQUIRE(resultSet.metrics.size() == 1);
+    CHECK(resultSet.metrics[0].name == "Lights/stress");
+    CHECK(resultSet.metrics[0].itemCnt == 1024);
+    CHECK(resultSet.metrics[0].samples == result.samplesMs);
+}
+
+
+TEST(Benchmark, RejectsUnknownModes) {
+    bool thrown = false;
+    try {
+        Benchmark::RunCommand({ "--benchmark-nothing" });
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
@@ -0,0 +1,254 @@
+#include "Test.h"
+#include "Bvh.h"
+
+#include <numeric>
+
+/// <summary>
+/// Random boxes in a 100 unit cube: clusters of small boxes (like the meshes of a
+/// level) plus a few large ones.
+/// </summary>
+static std::vector<dx::BoundingBox> generateBoxes(size_t count, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> offset(-3.0f, 3.0f);
+    std::uniform_real_distribution<float> extent(0.05f, 1.0f);
+    std::vector<dx::BoundingBox> boxes(count);
+    sm::Vector3 cluster;
+    for (size_t i = 0; i < count; i++) {
+        if (i % 16 == 0) {
+            cluster = sm::Vector3(position(generator), position(generator),
+                position(generator));
+        }
+        boxes[i].Center = cluster + sm::Vector3(offset(generator), offset(generator),
+            offset(generator));
+        boxes[i].Extents = sm::Vector3(extent(generator), extent(generator),
+            extent(generator)) * (i % 50 == 0 ? 10.0f : 1.0f);
+    }
+    return boxes;
+}
+
+
+/// <summary>
+/// Sorts a query result, so it can be compared with brute force.
+/// </summary>
+static std::vector<UINT32> sorted(std::vector<UINT32> prims) {
+    std::sort(prims.begin(), prims.end());
+    return prims;
+}
+
+
+/// <summary>
+/// Slab test of a ray against a box. Returns the entry t or FLT_MAX.
+/// </summary>
+static float intersectBox(const sm::Vector3& origin, const sm::Vector3& direction,
+        const dx::BoundingBox& box) {
+    float tMin = 0.0f;
+    float tMax = FLT_MAX;
+    const float* o = &origin.x;
+    const float* d = &direction.x;
+    const float* c = &box.Center.x;
+    const float* e = &box.Extents.x;
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (c[axis] - e[axis] - o[axis]) / d[axis];
+        float t1 = (c[axis] + e[axis] - o[axis]) / d[axis];
+        tMin = std::max(tMin, std::min(t0, t1));
+        tMax = std::min(tMax, std::max(t0, t1));
+    }
+    return tMin <= tMax ? tMin : FLT_MAX;
+}
+
+
+/// <summary>
+/// Frustum of a camera somewhere in the cube.
+/// </summary>
+static FrustumCuller::Planes createPlanes(const sm::Vector3& eye,
+        const sm::Vector3& target) {
+    sm::Matrix viewMat = sm::Matrix::CreateLookAt(eye, target, sm::Vector3::UnitY);
+    sm::Matrix projMat = sm::Matrix::CreatePerspectiveFieldOfView(
+        dx::XM_PI / 3.0f, 16.0f / 9.0f, 0.1f, 60.0f);
+    return FrustumCuller::ExtractPlanes(viewMat * projMat);
+}
+
+
+/// <summary>
+/// Checks Cull() against testing every box on its own.
+/// </summary>
+static void checkCull(const Bvh& bvh, const std::vector<dx::BoundingBox>& boxes,
+        const FrustumCuller::Planes& planes) {
+    std::vector<UINT32> expected;
+    for (UINT32 prim = 0; prim < boxes.size(); prim++) {
+        sm::Vector3 center = boxes[prim].Center;
+        sm::Vector3 extents = boxes[prim].Extents;
+        if (Bvh::TestBox(planes, center - extents, center + extents)) {
+            expected.push_back(prim);
+        }
+    }
+    std::vector<UINT32> visible;
+    bvh.Cull(planes, visible);
+    CHECK(sorted(visible) == expected);
+}
+
+
+TEST(Bvh, CullMatchesBruteForce) {
+    std::vector<dx::BoundingBox> boxes = generateBoxes(2000, 1);
+    Bvh bvh;
+    bvh.Build(boxes);
+    REQUIRE(bvh.GetPrimitiveCount() == boxes.size());
+
+    checkCull(bvh, boxes, createPlanes(sm::Vector3(0.0f, 0.0f, -70.0f),
+        sm::Vector3::Zero));
+    checkCull(bvh, boxes, createPlanes(sm::Vector3(10.0f, 5.0f, 0.0f),
+        sm::Vector3(40.0f, 0.0f, 20.0f)));
+    checkCull(bvh, boxes, createPlanes(sm::Vector3(-80.0f, 0.0f, 0.0f),
+        sm::Vector3(-100.0f, 0.0f, 0.0f)));
+}
+
+
+TEST(Bvh, TreeCoversEveryPrimitiveOnce) {
+    std::vector<dx::BoundingBox> boxes = generateBoxes(1000, 2);
+    Bvh bvh;
+    bvh.Build(boxes);
+    const std::vector<UINT32>& ordered = bvh.GetOrderedPrimitives();
+    std::vector<UINT32> allPrims(boxes.size());
+    std::iota(allPrims.begin(), allPrims.end(), 0);
+    CHECK(sorted(ordered) == allPrims);
+
+    std::vector<UINT32> leafCounts(boxes.size(), 0);
+    bvh.Traverse([&](const sm::Vector3& boundsMin, const sm::Vector3& boundsMax,
+            UINT32 first, UINT32 count, bool isLeaf) {
+        // Nodes contain the primitives of their subtree.
+        for (UINT32 i = first; i < first + count; i++) {
+            sm::Vector3 center = boxes[ordered[i]].Center;
+            sm::Vector3 extents = boxes[ordered[i]].Extents;
+            sm::Vector3 primMin = center - extents;
+            sm::Vector3 primMax = center + extents;
+            CHECK(primMin.x >= boundsMin.x && primMin.y >= boundsMin.y &&
+                primMin.z >= boundsMin.z);
+            CHECK(primMax.x <= boundsMax.x && primMax.y <= boundsMax.y &&
+                primMax.z <= boundsMax.z);
+            leafCounts[ordered[i]] += isLeaf ? 1 : 0;
+        }
+        return true;
+    });
+    for (UINT32 count : leafCounts) {
+        CHECK(count == 1);
+    }
+}
+
+
+TEST(Bvh, RefitMatchesRebuild) {
+    std::vector<dx::BoundingBox> boxes = generateBoxes(1000, 3);
+    Bvh bvh;
+    bvh.Build(boxes);
+
+    std::mt19937 generator(4);
+    std::uniform_real_distribution<float> move(-5.0f, 5.0f);
+    for (UINT32 prim = 0; prim < boxes.size(); prim += 7) {
+        boxes[prim].Center = sm::Vector3(boxes[prim].Center) +
+            sm::Vector3(move(generator), move(generator), move(generator));
+        bvh.SetPrimitiveBounds(prim, boxes[prim]);
+    }
+    bvh.Refit();
+
+    checkCull(bvh, boxes, createPlanes(sm::Vector3(0.0f, 0.0f, -70.0f),
+        sm::Vector3::Zero));
+    Bvh rebuilt;
+    rebuilt.Build(boxes);
+    dx::BoundingBox refitBounds = bvh.GetBounds();
+    dx::BoundingBox rebuiltBounds = rebuilt.GetBounds();
+    for (int axis = 0; axis < 3; axis++) {
+        CHECK_NEAR((&refitBounds.Center.x)[axis], (&rebuiltBounds.Center.x)[axis],
+            1e-4f);
+        CHECK_NEAR((&refitBounds.Extents.x)[axis], (&rebuiltBounds.Extents.x)[axis],
+            1e-4f);
+    }
+}
+
+
+TEST(Bvh, BoxAndSphereQueriesMatchBruteForce) {
+    std::vector<dx::BoundingBox> boxes = generateBoxes(2000, 5);
+    Bvh bvh;
+    bvh.Build(boxes);
+
+    std::mt19937 generator(6);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> size(0.5f, 15.0f);
+    for (int query = 0; query < 50; query++) {
+        sm::Vector3 center(position(generator), position(generator),
+            position(generator));
+        float radius = size(generator);
+
+        dx::BoundingBox queryBox(center, sm::Vector3(radius));
+        dx::BoundingSphere querySphere(center, radius);
+        std::vector<UINT32> expectedBox;
+        std::vector<UINT32> expectedSphere;
+        for (UINT32 prim = 0; prim < boxes.size(); prim++) {
+            if (boxes[prim].Intersects(queryBox)) {
+                expectedBox.push_back(prim);
+            }
+            if (boxes[prim].Intersects(querySphere)) {
+                expectedSphere.push_back(prim);
+            }
+        }
+
+        std::vector<UINT32> result;
+        bvh.QueryBox(center - sm::Vector3(radius), center + sm::Vector3(radius),
+            result);
+        CHECK(sorted(result) == expectedBox);
+        bvh.QuerySphere(center, radius, result);
+        CHECK(sorted(result) == expectedSphere);
+    }
+}
+
+
+TEST(Bvh, RaycastFindsTheNearestHit) {
+    std::vector<dx::BoundingBox> boxes = generateBoxes(2000, 7);
+    Bvh bvh;
+    bvh.Build(boxes);
+
+    std::mt19937 generator(8);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    UINT32 hitCnt = 0;
+    for (int ray = 0; ray < 200; ray++) {
+        sm::Vector3 origin(unit(generator) * 60.0f, unit(generator) * 60.0f,
+            unit(generator) * 60.0f);
+        sm::Vector3 direction(unit(generator), unit(generator), unit(generator));
+        direction.Normalize();
+
+        UINT32 expected = Bvh::NO_PRIMITIVE;
+        float expectedT = 200.0f;
+        for (UINT32 prim = 0; prim < boxes.size(); prim++) {
+            float t = intersectBox(origin, direction, boxes[prim]);
+            if (t < expectedT) {
+                expectedT = t;
+                expected = prim;
+            }
+        }
+
+        float maxT = 200.0f;
+        UINT32 hit = bvh.Raycast(origin, direction, maxT,
+            [&](UINT32 prim, float& t) {
+                float primT = intersectBox(origin, direction, boxes[prim]);
+                if (primT < t) {
+                    t = primT;
+                    return true;
+                }
+                return false;
+            });
+        CHECK(hit == expected);
+        if (expected != Bvh::NO_PRIMITIVE) {
+            CHECK_NEAR(maxT, expectedT, 1e-4f);
+            hitCnt++;
+        }
+    }
+    CHECK(hitCnt > 0);
+}
+
+
+TEST(Bvh, SahBuildIsCheaperThanAFlatList) {
+    // A flat list tests every primitive: the cost is about the primitive count.
+    std::vector<dx::BoundingBox> boxes = generateBoxes(2000, 9);
+    Bvh bvh;
+    bvh.Build(boxes);
+    CHECK(bvh.ComputeCost() < 0.05f * boxes.size());
+}
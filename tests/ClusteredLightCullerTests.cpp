@@ -0,0 +1,246 @@
+#include "Test.h"
+#include "ClusteredLightCuller.h"
+
+/// <summary>
+/// Projection of the tests: 60 degrees, 16:9, depth 0.5 to 200.
+/// </summary>
+static sm::Matrix createProjection() {
+    return sm::Matrix::CreatePerspectiveFieldOfView(dx::XM_PI / 3.0f, 16.0f / 9.0f,
+        0.5f, 200.0f);
+}
+
+
+/// <summary>
+/// Camera at eye looking at target.
+/// </summary>
+static sm::Matrix createView(const sm::Vector3& eye, const sm::Vector3& target) {
+    return sm::Matrix::CreateLookAt(eye, target, sm::Vector3::UnitY);
+}
+
+
+/// <summary>
+/// Random lights in a 200 x 20 x 200 volume around the origin.
+/// </summary>
+static std::vector<sm::Vector4> generateLights(size_t count, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> height(0.0f, 20.0f);
+    std::uniform_real_distribution<float> radius(0.5f, 8.0f);
+    std::vector<sm::Vector4> lights(count);
+    for (sm::Vector4& light : lights) {
+        light = sm::Vector4(position(generator), height(generator), position(generator),
+            radius(generator));
+    }
+    return lights;
+}
+
+
+/// <summary>
+/// Returns true if both cullers hold the same lists.
+/// </summary>
+static bool haveSameLists(const ClusteredLightCuller& culler,
+        const ClusteredLightCuller& reference) {
+    if (culler.GetLightIndices() != reference.GetLightIndices()) {
+        return false;
+    }
+    for (size_t i = 0; i < culler.GetClusterRanges().size(); i++) {
+        const ClusteredLightCuller::ClusterRange& range = culler.GetClusterRanges()[i];
+        if (range.offset != reference.GetClusterRanges()[i].offset ||
+                range.count != reference.GetClusterRanges()[i].count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/// <summary>
+/// Assigns the lights from scratch.
+/// </summary>
+static void assignAll(ClusteredLightCuller& culler, const sm::Matrix& viewMat,
+        const std::vector<sm::Vector4>& lights) {
+    culler.SetProjection(createProjection());
+    culler.SetView(viewMat);
+    culler.SetLights(std::vector<sm::Vector4>());
+    culler.SetLights(lights);
+    culler.Update();
+}
+
+
+TEST(ClusteredLightCuller, ClustersGetEveryPointALightReaches) {
+    // Brute force: random points inside of every light are projected into their
+    // cluster, whose list has to contain the light.
+    std::vector<sm::Vector4> lights = generateLights(2000, 1);
+    sm::Matrix viewMat = createView(sm::Vector3(0.0f, 5.0f, 0.0f),
+        sm::Vector3(30.0f, 3.0f, 50.0f));
+    sm::Matrix projMat = createProjection();
+    ClusteredLightCuller culler;
+    assignAll(culler, viewMat, lights);
+
+    std::mt19937 generator(6);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    UINT32 pointCnt = 0;
+    UINT32 missCnt = 0;
+    for (UINT32 i = 0; i < lights.size(); i++) {
+        sm::Vector3 center(lights[i].x, lights[i].y, lights[i].z);
+        for (int sample = 0; sample < 64; sample++) {
+            sm::Vector3 offset(unit(generator), unit(generator), unit(generator));
+            if (offset.LengthSquared() > 1.0f) {
+                continue;
+            }
+            sm::Vector3 viewPoint = sm::Vector3::Transform(
+                center + offset * lights[i].w, viewMat);
+            sm::Vector4 clip = sm::Vector4::Transform(sm::Vector4(viewPoint.x,
+                viewPoint.y, viewPoint.z, 1.0f), projMat);
+            float depth = -viewPoint.z;
+            float ndcX = clip.x / clip.w;
+            float ndcY = clip.y / clip.w;
+            if (depth < 0.5f || depth >= 200.0f || std::fabs(ndcX) >= 1.0f ||
+                    std::fabs(ndcY) >= 1.0f) {
+                continue;
+            }
+            UINT32 x = static_cast<UINT32>((ndcX + 1.0f) * 0.5f * culler.GetClustersX());
+            UINT32 y = static_cast<UINT32>((1.0f - ndcY) * 0.5f * culler.GetClustersY());
+            UINT32 z = std::min(static_cast<UINT32>(std::max(std::log(depth) *
+                culler.GetSliceScale() + culler.GetSliceBias(), 0.0f)),
+                culler.GetClustersZ() - 1);
+            const ClusteredLightCuller::ClusterRange& range =
+                culler.GetClusterRanges()[culler.GetClusterIndex(x, y, z)];
+            const UINT32* first = culler.GetLightIndices().data() + range.offset;
+            missCnt += std::binary_search(first, first + range.count, i) ? 0 : 1;
+            pointCnt++;
+        }
+    }
+    CHECK(missCnt == 0);
+    CHECK(pointCnt > 1000);
+}
+
+
+TEST(ClusteredLightCuller, ViewChangesReassignTheLightsOfTheFrustum) {
+    std::vector<sm::Vector4> lights = generateLights(3000, 2);
+    ClusteredLightCuller culler;
+    assignAll(culler, createView(sm::Vector3::Zero, sm::Vector3(0.0f, 0.0f, 1.0f)),
+        lights);
+
+    // A camera walking and turning. Lights behind it never get reassigned.
+    for (int frame = 1; frame <= 10; frame++) {
+        sm::Vector3 eye(0.5f * frame, 2.0f, 1.0f * frame);
+        sm::Matrix viewMat = createView(eye,
+            eye + sm::Vector3(0.1f * frame, 0.0f, 1.0f));
+        culler.SetView(viewMat);
+        culler.Update();
+        CHECK(culler.GetReassignedLightCount() > 0);
+        CHECK(culler.GetReassignedLightCount() < lights.size() / 2);
+
+        ClusteredLightCuller reference;
+        assignAll(reference, viewMat, lights);
+        CHECK(haveSameLists(culler, reference));
+    }
+
+    // The same view again reassigns nothing.
+    culler.Update();
+    CHECK(culler.GetReassignedLightCount() == 0);
+}
+
+
+TEST(ClusteredLightCuller, MovedLightsAreReassignedIncrementally) {
+    std::vector<sm::Vector4> lights = generateLights(1000, 3);
+    sm::Matrix viewMat = createView(sm::Vector3(-20.0f, 4.0f, -30.0f),
+        sm::Vector3::Zero);
+    ClusteredLightCuller culler;
+    assignAll(culler, viewMat, lights);
+
+    // Lights moved in front of the camera, some with SetLight(), some with
+    // SetLights() of the same number of lights.
+    std::mt19937 generator(4);
+    std::uniform_int_distribution<UINT32> lightIdx(0, 999);
+    std::uniform_real_distribution<float> offset(-3.0f, 3.0f);
+    std::vector<UINT32> movedLights;
+    for (int i = 0; i < 20; i++) {
+        UINT32 light = lightIdx(generator);
+        lights[light] = sm::Vector4(offset(generator), 3.0f + offset(generator),
+            offset(generator), lights[light].w);
+        movedLights.push_back(light);
+        if (i % 2 == 0) {
+            culler.SetLight(light, lights[light]);
+        }
+    }
+    culler.SetLights(lights);
+    culler.Update();
+    std::sort(movedLights.begin(), movedLights.end());
+    movedLights.erase(std::unique(movedLights.begin(), movedLights.end()),
+        movedLights.end());
+    CHECK(culler.GetReassignedLightCount() == movedLights.size());
+
+    ClusteredLightCuller reference;
+    assignAll(reference, viewMat, lights);
+    CHECK(haveSameLists(culler, reference));
+
+    // Moving lights and the camera at once.
+    lights[5].x += 1.0f;
+    culler.SetLight(5, lights[5]);
+    viewMat = createView(sm::Vector3(-19.0f, 4.0f, -30.0f), sm::Vector3::Zero);
+    culler.SetView(viewMat);
+    culler.Update();
+    assignAll(reference, viewMat, lights);
+    CHECK(haveSameLists(culler, reference));
+}
+
+
+TEST(ClusteredLightCuller, ThreadsMatchASingleThread) {
+    std::vector<sm::Vector4> lights = generateLights(2000, 5);
+    ClusteredLightCuller single;
+    ClusteredLightCuller threaded;
+    threaded.SetThreadCount(4);
+    for (ClusteredLightCuller* culler : { &single, &threaded }) {
+        assignAll(*culler, createView(sm::Vector3::Zero,
+            sm::Vector3(1.0f, 0.0f, 1.0f)), lights);
+        culler->SetView(createView(sm::Vector3(2.0f, 1.0f, 0.0f),
+            sm::Vector3(0.0f, 0.0f, 1.0f)));
+        culler->SetLight(7, sm::Vector4(2.0f, 1.0f, 10.0f, 3.0f));
+        culler->Update();
+    }
+    CHECK(threaded.GetReassignedLightCount() == single.GetReassignedLightCount());
+    CHECK(haveSameLists(threaded, single));
+}
+
+
+TEST(ClusteredLightCuller, LightBvhFindsTheLightsOfTheSlices) {
+    // A camera walking through the lights, some of which move. With the BVH only
+    // the lights near the frustum are transformed, the lists stay the same.
+    std::vector<sm::Vector4> lights = generateLights(3000, 7);
+    LightBvh lightBvh;
+    lightBvh.Build(lights);
+    ClusteredLightCuller culler;
+    culler.SetLightBvh(&lightBvh);
+    assignAll(culler, createView(sm::Vector3::Zero, sm::Vector3(0.0f, 0.0f, 1.0f)),
+        lights);
+    CHECK(culler.GetTransformedLightCount() < lights.size() / 2);
+    ClusteredLightCuller reference;
+    assignAll(reference, createView(sm::Vector3::Zero, sm::Vector3(0.0f, 0.0f, 1.0f)),
+        lights);
+    CHECK(haveSameLists(culler, reference));
+
+    std::mt19937 generator(8);
+    std::uniform_int_distribution<UINT32> lightIdx(0, 2999);
+    std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+    for (int frame = 1; frame <= 10; frame++) {
+        for (int i = 0; i < 50; i++) {
+            UINT32 light = lightIdx(generator);
+            lights[light] += sm::Vector4(offset(generator), offset(generator),
+                offset(generator), 0.0f);
+            lightBvh.SetLight(light, lights[light]);
+            culler.SetLight(light, lights[light]);
+        }
+        lightBvh.Refit();
+        sm::Vector3 eye(-3.0f * frame, 4.0f, 2.0f * frame);
+        sm::Matrix viewMat = createView(eye, eye + sm::Vector3(-0.2f * frame, -0.1f,
+            1.0f));
+        culler.SetView(viewMat);
+        culler.Update();
+        CHECK(culler.GetTransformedLightCount() < lights.size() / 2);
+
+        assignAll(reference, viewMat, lights);
+        CHECK(haveSameLists(culler, reference));
+    }
+}
@@ -0,0 +1,308 @@
+#include "Test.h"
+#include "FrustumCuller.h"
+
+/// <summary>
+/// Camera at (0, 2, -10) looking at the origin, 60 degrees vertical field of view.
+/// </summary>
+static sm::Matrix createViewProj() {
+    sm::Matrix viewMat = sm::Matrix::CreateLookAt(sm::Vector3(0.0f, 2.0f, -10.0f),
+        sm::Vector3::Zero, sm::Vector3::UnitY);
+    sm::Matrix projMat = sm::Matrix::CreatePerspectiveFieldOfView(
+        dx::XM_PI / 3.0f, 16.0f / 9.0f, 0.5f, 50.0f);
+    return viewMat * projMat;
+}
+
+
+/// <summary>
+/// Random boxes around the frustum, from tiny to large.
+/// </summary>
+static std::vector<dx::BoundingBox> generateBoxes(size_t count, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+    std::uniform_real_distribution<float> logExtent(-3.0f, 1.0f);
+    std::vector<dx::BoundingBox> boxes(count);
+    for (dx::BoundingBox& box : boxes) {
+        box.Center = sm::Vector3(position(generator), position(generator) * 0.5f,
+            position(generator));
+        box.Extents = sm::Vector3(powf(10.0f, logExtent(generator)),
+            powf(10.0f, logExtent(generator)), powf(10.0f, logExtent(generator)));
+    }
+    return boxes;
+}
+
+
+/// <summary>
+/// Returns true if a point lies inside of the clip volume of a view projection.
+/// </summary>
+static bool isInsideClipVolume(const sm::Matrix& viewProj, const sm::Vector3& point) {
+    sm::Vector4 clip = sm::Vector4::Transform(
+        sm::Vector4(point.x, point.y, point.z, 1.0f), viewProj);
+    return fabsf(clip.x) <= clip.w && fabsf(clip.y) <= clip.w && clip.z >= 0.0f &&
+        clip.z <= clip.w;
+}
+
+
+TEST(FrustumCuller, PlanesMatchTheClipVolume) {
+    sm::Matrix viewProj = createViewProj();
+    FrustumCuller::Planes planes = FrustumCuller::ExtractPlanes(viewProj);
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+    for (int i = 0; i < 10000; i++) {
+        sm::Vector3 point(position(generator), position(generator),
+            position(generator));
+        float minDistance = FLT_MAX;
+        for (const sm::Vector4& plane : planes) {
+            minDistance = std::min(minDistance,
+                plane.x * point.x + plane.y * point.y + plane.z * point.z + plane.w);
+        }
+        // Points right on a plane may go either way.
+        if (fabsf(minDistance) > 1e-3f) {
+            CHECK((minDistance > 0.0f) == isInsideClipVolume(viewProj, point));
+        }
+    }
+}
+
+
+TEST(FrustumCuller, NeverCullsVisibleBoxes) {
+    // Brute force: a box with a sample point inside of the clip volume is visible.
+    sm::Matrix viewProj = createViewProj();
+    FrustumCuller::Planes planes = FrustumCuller::ExtractPlanes(viewProj);
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    UINT32 culledCnt = 0;
+    for (const dx::BoundingBox& box : generateBoxes(5000, 3)) {
+        bool isVisible = false;
+        for (int sample = 0; sample < 64 && !isVisible; sample++) {
+            sm::Vector3 offset(unit(generator), unit(generator), unit(generator));
+            if (sample < 8) {
+                // Corners first.
+                offset = sm::Vector3(sample & 1 ? 1.0f : -1.0f,
+                    sample & 2 ? 1.0f : -1.0f, sample & 4 ? 1.0f : -1.0f);
+            }
+            isVisible = isInsideClipVolume(viewProj, sm::Vector3(box.Center) +
+                offset * sm::Vector3(box.Extents));
+        }
+        bool isKept = FrustumCuller::TestBox(planes, box);
+        CHECK(isKept || !isVisible);
+        culledCnt += isKept ? 0 : 1;
+    }
+    // Most of the boxes are outside, the test has to cull some of them.
+    CHECK(culledCnt > 2500);
+}
+
+
+TEST(FrustumCuller, BatchedPathsMatchScalar) {
+    sm::Matrix viewProj = createViewProj();
+    FrustumCuller::Planes planes = FrustumCuller::ExtractPlanes(viewProj);
+    FrustumCuller::Contribution contribution = FrustumCuller::ComputeContribution(
+        viewProj, 1920.0f, 1080.0f, 4.0f);
+
+    // Not a multiple of 8 or 4, so the scalar remainder runs as well.
+    FrustumCuller culler;
+    for (const dx::BoundingBox& box : generateBoxes(1003, 4)) {
+        culler.AddBox(box);
+    }
+    std::vector<FrustumCuller::Path> paths = { FrustumCuller::Path::SSE };
+    if (FrustumCuller::GetBestPath() == FrustumCuller::Path::AVX) {
+        paths.push_back(FrustumCuller::Path::AVX);
+    }
+
+    for (bool withContribution : { false, true }) {
+        FrustumCuller::Contribution used = withContribution ? contribution :
+            FrustumCuller::Contribution();
+        std::vector<UINT32> expected;
+        culler.SetPath(FrustumCuller::Path::SCALAR);
+        culler.Cull(planes, used, expected);
+        CHECK(!expected.empty());
+
+        for (FrustumCuller::Path path : paths) {
+            culler.SetPath(path);
+            REQUIRE(culler.GetPath() == path);
+            std::vector<UINT32> visible;
+            culler.Cull(planes, used, visible);
+            CHECK(visible == expected);
+        }
+    }
+}
+
+
+TEST(FrustumCuller, ContributionDropsSmallBoxes) {
+    // 60 degree field of view on 1080 pixels: at distance 10 a unit of world space
+    // covers about 1080 / (2 * 10 * tan(30 degrees)) = 93.5 pixels.
+    sm::Matrix viewProj = createViewProj();
+    FrustumCuller::Contribution contribution = FrustumCuller::ComputeContribution(
+        viewProj, 1920.0f, 1080.0f, 8.0f);
+    sm::Vector3 center(0.0f, 2.0f, 0.0f);
+    float pixelsPerUnit = 1080.0f / (2.0f * 10.0f * tanf(dx::XM_PI / 6.0f));
+
+    // Bounding sphere diameters of 16 and 4 pixels.
+    float keptExtent = 8.0f / pixelsPerUnit / sqrtf(3.0f);
+    float droppedExtent = 2.0f / pixelsPerUnit / sqrtf(3.0f);
+    CHECK(FrustumCuller::TestContribution(contribution,
+        dx::BoundingBox(center, sm::Vector3(keptExtent))));
+    CHECK(!FrustumCuller::TestContribution(contribution,
+        dx::BoundingBox(center, sm::Vector3(droppedExtent))));
+
+    // Behind the eye: always kept.
+    CHECK(FrustumCuller::TestContribution(contribution,
+        dx::BoundingBox(sm::Vector3(0.0f, 2.0f, -20.0f), sm::Vector3(droppedExtent))));
+
+    // Disabled.
+    CHECK(FrustumCuller::TestContribution(FrustumCuller::Contribution(),
+        dx::BoundingBox(center, sm::Vector3(droppedExtent))));
+}
+
+
+TEST(FrustumCuller, SweptPlanesKeepCastersTowardsTheFrustum) {
+    FrustumCuller::Planes planes = FrustumCuller::ExtractPlanes(createViewProj());
+
+    // High above the frustum, the light shines straight down.
+    dx::BoundingBox caster(sm::Vector3(0.0f, 60.0f, 5.0f), sm::Vector3(1.0f));
+    CHECK(!FrustumCuller::TestBox(planes, caster));
+    FrustumCuller::Planes swept = FrustumCuller::SweepPlanes(planes,
+        sm::Vector3(0.0f, -1.0f, 0.0f));
+    CHECK(FrustumCuller::TestBox(swept, caster));
+
+    // The light shines upwards: the shadow falls away from the frustum.
+    swept = FrustumCuller::SweepPlanes(planes, sm::Vector3(0.0f, 1.0f, 0.0f));
+    CHECK(!FrustumCuller::TestBox(swept, caster));
+}
+
+
+/// <summary>
+/// Smallest width in pixels of the projection of a sphere in front of the eye (the
+/// minor axis of its ellipse), from points on its silhouette.
+/// </summary>
+static float measureProjectedWidth(const sm::Matrix& viewProj, const sm::Vector3& eye,
+        const dx::BoundingSphere& sphere, float width, float height) {
+    // The silhouette is the circle where the cone from the eye touches the sphere.
+    sm::Vector3 toCenter = sm::Vector3(sphere.Center) - eye;
+    float distance = toCenter.Length();
+    toCenter /= distance;
+    sm::Vector3 u = toCenter.Cross(fabsf(toCenter.y) < 0.9f ? sm::Vector3::UnitY :
+        sm::Vector3::UnitX);
+    u.Normalize();
+    sm::Vector3 v = toCenter.Cross(u);
+    float sinAngle = sphere.Radius / distance;
+    float cosAngle = sqrtf(1.0f - sinAngle * sinAngle);
+
+    std::vector<sm::Vector2> points;
+    for (int i = 0; i < 256; i++) {
+        float phi = dx::XM_2PI * i / 256.0f;
+        sm::Vector3 direction = toCenter * cosAngle +
+            (u * cosf(phi) + v * sinf(phi)) * sinAngle;
+        sm::Vector3 point = eye + direction * distance * cosAngle;
+        sm::Vector4 clip = sm::Vector4::Transform(
+            sm::Vector4(point.x, point.y, point.z, 1.0f), viewProj);
+        points.push_back(sm::Vector2(clip.x / clip.w * 0.5f * width,
+            clip.y / clip.w * 0.5f * height));
+    }
+    float minWidth = FLT_MAX;
+    for (int i = 0; i < 180; i++) {
+        sm::Vector2 axis(cosf(dx::XM_PI * i / 180.0f), sinf(dx::XM_PI * i / 180.0f));
+        float minProj = FLT_MAX;
+        float maxProj = -FLT_MAX;
+        for (const sm::Vector2& point : points) {
+            minProj = std::min(minProj, point.Dot(axis));
+            maxProj = std::max(maxProj, point.Dot(axis));
+        }
+        minWidth = std::min(minWidth, maxProj - minProj);
+    }
+    return minWidth;
+}
+
+
+TEST(FrustumCuller, ContributionKeepsSpheresAboveTheThreshold) {
+    // Brute force: a sphere whose projection is wider than the threshold in every
+    // direction is kept. The approximation may keep smaller ones as well.
+    sm::Vector3 eye(0.0f, 2.0f, -10.0f);
+    sm::Matrix viewProj = createViewProj();
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> logRadius(-3.0f, 0.0f);
+    for (float minPixels : { 1.0f, 4.0f, 16.0f }) {
+        FrustumCuller::Contribution contribution = FrustumCuller::ComputeContribution(
+            viewProj, 1920.0f, 1080.0f, minPixels);
+        UINT32 droppedCnt = 0;
+        for (int i = 0; i < 500; i++) {
+            // Inside of the frustum, up to 40 units away.
+            float depth = 1.0f + 40.0f * fabsf(unit(generator));
+            sm::Vector3 center = eye + sm::Vector3(unit(generator) * depth * 0.9f,
+                unit(generator) * depth * 0.5f, depth);
+            dx::BoundingSphere sphere(center, powf(10.0f, logRadius(generator)));
+            // The bounding sphere of a cube with these extents.
+            dx::BoundingBox box(center, sm::Vector3(sphere.Radius / sqrtf(3.0f)));
+            bool isKept = FrustumCuller::TestContribution(contribution, box);
+            float projectedWidth = measureProjectedWidth(viewProj, eye, sphere,
+                1920.0f, 1080.0f);
+            CHECK(isKept || projectedWidth < minPixels * 1.001f);
+            droppedCnt += isKept ? 0 : 1;
+        }
+        CHECK(droppedCnt > 0);
+    }
+}
+
+
+TEST(FrustumCuller, ContributionOfOrthographicViewsIsExact) {
+    // Shadow maps: the size does not depend on the depth.
+    sm::Matrix viewMat = sm::Matrix::CreateLookAt(sm::Vector3(0.0f, 100.0f, 0.0f),
+        sm::Vector3::Zero, sm::Vector3::UnitZ);
+    sm::Matrix viewProj = viewMat * sm::Matrix::CreateOrthographicOffCenter(-50.0f,
+        50.0f, -50.0f, 50.0f, 1.0f, 200.0f);
+    // 2048 texels over 100 units: 4 texels are 0.1953 units, a radius of 0.0977.
+    FrustumCuller::Contribution contribution = FrustumCuller::ComputeContribution(
+        viewProj, 2048.0f, 2048.0f, 4.0f);
+    float minRadius = 2.0f * 100.0f / 2048.0f;
+    for (float y : { -50.0f, 0.0f, 80.0f }) {
+        sm::Vector3 center(10.0f, y, -20.0f);
+        CHECK(FrustumCuller::TestContribution(contribution, dx::BoundingBox(center,
+            sm::Vector3(minRadius * 1.001f / sqrtf(3.0f)))));
+        CHECK(!FrustumCuller::TestContribution(contribution, dx::BoundingBox(center,
+            sm::Vector3(minRadius * 0.999f / sqrtf(3.0f)))));
+    }
+}
+
+
+TEST(FrustumCuller, ContributionPathsMatchScalarAtEveryThreshold) {
+    std::vector<sm::Matrix> viewProjs = { createViewProj(),
+        sm::Matrix::CreateLookAt(sm::Vector3(0.0f, 60.0f, 0.0f), sm::Vector3::Zero,
+            sm::Vector3::UnitZ) * sm::Matrix::CreateOrthographicOffCenter(-40.0f,
+            40.0f, -40.0f, 40.0f, 1.0f, 120.0f) };
+    FrustumCuller culler;
+    for (const dx::BoundingBox& box : generateBoxes(1003, 6)) {
+        culler.AddBox(box);
+    }
+    std::vector<FrustumCuller::Path> paths = { FrustumCuller::Path::SSE };
+    if (FrustumCuller::GetBestPath() == FrustumCuller::Path::AVX) {
+        paths.push_back(FrustumCuller::Path::AVX);
+    }
+
+    for (const sm::Matrix& viewProj : viewProjs) {
+        FrustumCuller::Planes planes = FrustumCuller::ExtractPlanes(viewProj);
+        std::vector<UINT32> unculled;
+        culler.SetPath(FrustumCuller::Path::SCALAR);
+        culler.Cull(planes, FrustumCuller::Contribution(), unculled);
+        for (float minPixels : { 0.5f, 2.0f, 8.0f, 32.0f, 128.0f }) {
+            FrustumCuller::Contribution contribution =
+                FrustumCuller::ComputeContribution(viewProj, 1920.0f, 1080.0f,
+                    minPixels);
+            std::vector<UINT32> expected;
+            culler.SetPath(FrustumCuller::Path::SCALAR);
+            culler.Cull(planes, contribution, expected);
+            CHECK(expected.size() <= unculled.size());
+
+            for (FrustumCuller::Path path : paths) {
+                culler.SetPath(path);
+                std::vector<UINT32> visible;
+                culler.Cull(planes, contribution, visible);
+                CHECK(visible == expected);
+            }
+        }
+        // The largest threshold drops some of the boxes.
+        std::vector<UINT32> largest;
+        culler.SetPath(FrustumCuller::Path::SCALAR);
+        culler.Cull(planes, FrustumCuller::ComputeContribution(viewProj, 1920.0f,
+            1080.0f, 128.0f), largest);
+        CHECK(largest.size() < unculled.size());
+    }
+}
@@ -0,0 +1,190 @@
+#include "Test.h"
+#include "HiZCuller.h"
+
+// Size of the depth buffers of the tests.
+static const UINT32 WIDTH = 96;
+static const UINT32 HEIGHT = 64;
+
+/// <summary>
+/// Camera at eye looking down +z with a 90 degree field of view.
+/// </summary>
+static sm::Matrix createViewProj(const sm::Vector3& eye) {
+    sm::Matrix viewMat = sm::Matrix::CreateLookAt(eye,
+        eye + sm::Vector3(0.0f, 0.0f, 1.0f), sm::Vector3::UnitY);
+    return viewMat * sm::Matrix::CreatePerspectiveFieldOfView(dx::XM_PI / 2.0f,
+        float(WIDTH) / float(HEIGHT), 0.5f, 100.0f);
+}
+
+
+/// <summary>
+/// Depth of a point straight in front of the camera at the origin.
+/// </summary>
+static float depthAt(float distance) {
+    sm::Vector4 clip = sm::Vector4::Transform(sm::Vector4(0.0f, 0.0f, distance, 1.0f),
+        createViewProj(sm::Vector3::Zero));
+    return clip.z / clip.w;
+}
+
+
+TEST(HiZCuller, StaticCameraHidesBoxesBehindAWall) {
+    std::vector<float> depth(WIDTH * HEIGHT, depthAt(10.0f));
+    sm::Matrix viewProj = createViewProj(sm::Vector3::Zero);
+    HiZCuller culler;
+    culler.SetDepth(depth.data(), WIDTH, HEIGHT, WIDTH * sizeof(float), viewProj);
+    culler.Update(viewProj);
+    CHECK(culler.GetHoleCount() == 0);
+
+    CHECK(!culler.TestBox(dx::BoundingBox(sm::Vector3(1.0f, 2.0f, 20.0f),
+        sm::Vector3(3.0f))));
+    CHECK(culler.TestBox(dx::BoundingBox(sm::Vector3(1.0f, 2.0f, 5.0f),
+        sm::Vector3(1.0f))));
+    // Behind the wall, but reaching through it.
+    CHECK(culler.TestBox(dx::BoundingBox(sm::Vector3(0.0f, 0.0f, 15.0f),
+        sm::Vector3(1.0f, 1.0f, 6.0f))));
+}
+
+
+TEST(HiZCuller, HolesDoNotHide) {
+    // A wall with a gap of one pixel that nothing was drawn into. A camera that
+    // moved a tiny bit keeps the gap a hole, which must not get the depth of the
+    // wall around it.
+    std::vector<float> depth(WIDTH * HEIGHT, depthAt(10.0f));
+    const UINT32 gapX = 50;
+    for (UINT32 y = 0; y < HEIGHT; y++) {
+        depth[y * WIDTH + gapX] = 1.0f;
+    }
+    HiZCuller culler;
+    culler.SetDepth(depth.data(), WIDTH, HEIGHT, WIDTH * sizeof(float),
+        createViewProj(sm::Vector3::Zero));
+    culler.Update(createViewProj(sm::Vector3(0.0f, 0.0f, 1e-4f)));
+    CHECK(culler.GetHoleCount() >= HEIGHT);
+
+    const std::vector<float>& level0 = culler.GetMaxDepth(0);
+    for (UINT32 y = 0; y < HEIGHT; y++) {
+        CHECK(level0[y * WIDTH + gapX] == 1.0f);
+    }
+
+    // A box far behind the wall, seen through the gap.
+    float gapNdcX = (gapX + 0.5f) * 2.0f / WIDTH - 1.0f;
+    float distance = 50.0f;
+    float gapWorldX = gapNdcX * distance * float(WIDTH) / float(HEIGHT);
+    // The view is right-handed: +x in world space is -x on the screen.
+    CHECK(culler.TestBox(dx::BoundingBox(sm::Vector3(-gapWorldX, 0.0f, distance),
+        sm::Vector3(0.05f, 1.0f, 1.0f))));
+    // Next to the gap it is hidden.
+    CHECK(!culler.TestBox(dx::BoundingBox(sm::Vector3(-gapWorldX + 5.0f, 0.0f,
+        distance), sm::Vector3(0.05f, 1.0f, 1.0f))));
+}
+
+
+TEST(HiZCuller, SseMatchesScalar) {
+    // A bumpy surface with gaps, seen from a camera that moved.
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> distance(5.0f, 60.0f);
+    std::uniform_int_distribution<int> gap(0, 9);
+    // Not a multiple of 4 or 8, so the remainders run as well.
+    const UINT32 width = 93;
+    const UINT32 height = 61;
+    std::vector<float> depth(width * height);
+    for (float& texel : depth) {
+        texel = gap(generator) == 0 ? 1.0f : depthAt(distance(generator));
+    }
+    sm::Matrix sourceViewProj = createViewProj(sm::Vector3::Zero);
+    sm::Matrix viewProj = createViewProj(sm::Vector3(0.7f, -0.3f, 1.5f));
+
+    HiZCuller scalar;
+    scalar.SetPath(HiZCuller::Path::SCALAR);
+    HiZCuller sse;
+    sse.SetPath(HiZCuller::Path::SSE);
+    for (HiZCuller* culler : { &scalar, &sse }) {
+        culler->SetDepth(depth.data(), width, height, width * sizeof(float),
+            sourceViewProj);
+        culler->Update(viewProj);
+    }
+
+    REQUIRE(sse.GetLevelCount() == scalar.GetLevelCount());
+    CHECK(sse.GetHoleCount() == scalar.GetHoleCount());
+    for (UINT32 level = 0; level < sse.GetLevelCount(); level++) {
+        CHECK(sse.GetMinDepth(level) == scalar.GetMinDepth(level));
+        CHECK(sse.GetMaxDepth(level) == scalar.GetMaxDepth(level));
+    }
+}
+
+
+TEST(HiZCuller, LevelsBoundTheTexelsBelow) {
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<float> texel(0.0f, 1.0f);
+    const UINT32 width = 45;
+    const UINT32 height = 27;
+    std::vector<float> depth(width * height);
+    for (float& value : depth) {
+        value = texel(generator);
+    }
+    sm::Matrix viewProj = createViewProj(sm::Vector3::Zero);
+    HiZCuller culler;
+    culler.SetDepth(depth.data(), width, height, width * sizeof(float), viewProj);
+    culler.Update(viewProj);
+
+    // Every texel of a level lies inside of the range of its parents.
+    UINT32 levelWidth = width;
+    UINT32 levelHeight = height;
+    for (UINT32 level = 0; level + 1 < culler.GetLevelCount(); level++) {
+        const std::vector<float>& maxDepth = culler.GetMaxDepth(level);
+        const std::vector<float>& minDepth = culler.GetMinDepth(level);
+        const std::vector<float>& parentMax = culler.GetMaxDepth(level + 1);
+        const std::vector<float>& parentMin = culler.GetMinDepth(level + 1);
+        UINT32 parentWidth = (levelWidth + 1) / 2;
+        for (UINT32 y = 0; y < levelHeight; y++) {
+            for (UINT32 x = 0; x < levelWidth; x++) {
+                size_t i = static_cast<size_t>(y) * levelWidth + x;
+                size_t parent = static_cast<size_t>(y / 2) * parentWidth + x / 2;
+                CHECK(maxDepth[i] <= parentMax[parent]);
+                CHECK(minDepth[i] >= parentMin[parent]);
+            }
+        }
+        levelWidth = parentWidth;
+        levelHeight = (levelHeight + 1) / 2;
+    }
+    const std::vector<float>& top = culler.GetMaxDepth(culler.GetLevelCount() - 1);
+    REQUIRE(top.size() == 1);
+    CHECK(top[0] == *std::max_element(depth.begin(), depth.end()));
+}
+
+
+TEST(HiZCuller, TileMaxDepthAddsABorderAfterReprojection) {
+    // A single far texel in a near wall. Tiles of 16 pixels cover 4x4 texels of a
+    // depth that was downsampled by 4.
+    std::vector<float> depth(WIDTH * HEIGHT, depthAt(10.0f));
+    const UINT32 farX = 44;
+    const UINT32 farY = 20;
+    depth[farY * WIDTH + farX] = depthAt(50.0f);
+    HiZCuller culler;
+    culler.SetDepth(depth.data(), WIDTH, HEIGHT, WIDTH * sizeof(float),
+        createViewProj(sm::Vector3::Zero));
+    culler.Update(createViewProj(sm::Vector3::Zero));
+
+    const UINT32 tilesX = WIDTH / 4;
+    std::vector<float> maxDepth;
+    culler.GetTileMaxDepth(WIDTH * 4, HEIGHT * 4, 16, maxDepth);
+    REQUIRE(maxDepth.size() == tilesX * (HEIGHT / 4));
+    CHECK(maxDepth == culler.GetMaxDepth(2));
+
+    // After a reprojection the neighbours of the tile of the texel get it as well.
+    culler.Update(createViewProj(sm::Vector3(0.0f, 0.0f, 1e-4f)));
+    culler.GetTileMaxDepth(WIDTH * 4, HEIGHT * 4, 16, maxDepth);
+    const std::vector<float>& level0 = culler.GetMaxDepth(0);
+    for (UINT32 tileY = 0; tileY < HEIGHT / 4; tileY++) {
+        for (UINT32 tileX = 0; tileX < tilesX; tileX++) {
+            float expected = 0.0f;
+            for (UINT32 y = tileY * 4; y < tileY * 4 + 6; y++) {
+                for (UINT32 x = tileX * 4; x < tileX * 4 + 6; x++) {
+                    if (x >= 1 && y >= 1 && x - 1 < WIDTH && y - 1 < HEIGHT) {
+                        expected = std::max(expected, level0[(y - 1) * WIDTH + x - 1]);
+                    }
+                }
+            }
+            CHECK(maxDepth[tileY * tilesX + tileX] == expected);
+        }
+    }
+    CHECK(maxDepth[(farY / 4) * tilesX + (farX - 4) / 4] >= depthAt(49.0f));
+}
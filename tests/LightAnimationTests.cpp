@@ -0,0 +1,144 @@
+#include "Test.h"
+#include "LightAnimation.h"
+
+// Box the lights of the tests move in.
+static const sm::Vector3 BOUNDS_MIN(-20.0f, 0.0f, -10.0f);
+static const sm::Vector3 BOUNDS_MAX(30.0f, 8.0f, 10.0f);
+
+/// <summary>
+/// Random lights inside of the bounds, some of them fast enough to hit a bound
+/// every few steps.
+/// </summary>
+static void generateLights(LightAnimation& animation, UINT32 count, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    animation.Resize(count);
+    animation.SetBounds(BOUNDS_MIN, BOUNDS_MAX);
+    for (UINT32 i = 0; i < count; i++) {
+        sm::Vector3 position = BOUNDS_MIN + (BOUNDS_MAX - BOUNDS_MIN) *
+            sm::Vector3(unit(generator), unit(generator), unit(generator));
+        sm::Vector3 velocity = 40.0f * sm::Vector3(unit(generator) - 0.5f,
+            unit(generator) - 0.5f, unit(generator) - 0.5f);
+        sm::Vector3 color(unit(generator), unit(generator), unit(generator));
+        animation.SetLight(i, position, velocity, color, 0.5f + unit(generator),
+            1.0f + 10.0f * unit(generator), unit(generator), 4.0f * unit(generator));
+    }
+}
+
+
+/// <summary>
+/// Returns true if both hold exactly the same values.
+/// </summary>
+static bool haveSameLights(const LightAnimation& animation,
+        const LightAnimation& reference) {
+    if (animation.GetCount() != reference.GetCount()) {
+        return false;
+    }
+    auto isSame = [&animation](const float* values, const float* referenceValues) {
+        return std::memcmp(values, referenceValues,
+            animation.GetCount() * sizeof(float)) == 0;
+    };
+    return isSame(animation.GetPositionX(), reference.GetPositionX()) &&
+        isSame(animation.GetPositionY(), reference.GetPositionY()) &&
+        isSame(animation.GetPositionZ(), reference.GetPositionZ()) &&
+        isSame(animation.GetColorR(), reference.GetColorR()) &&
+        isSame(animation.GetColorG(), reference.GetColorG()) &&
+        isSame(animation.GetColorB(), reference.GetColorB()) &&
+        isSame(animation.GetIntensity(), reference.GetIntensity()) &&
+        isSame(animation.GetRadius(), reference.GetRadius());
+}
+
+
+TEST(LightAnimation, Avx2MatchesScalar) {
+    LightAnimation scalar;
+    scalar.SetPath(LightAnimation::Path::SCALAR);
+    LightAnimation avx2;
+    avx2.SetPath(LightAnimation::Path::AVX2);
+    if (avx2.GetPath() != LightAnimation::Path::AVX2) {
+        return;
+    }
+
+    // Not a multiple of 8, so the remainder runs as well. Steps of different length,
+    // like frames.
+    for (LightAnimation* animation : { &scalar, &avx2 }) {
+        generateLights(*animation, 1003, 1);
+    }
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<float> dt(0.001f, 0.1f);
+    for (int step = 0; step < 300; step++) {
+        float stepDt = dt(generator);
+        scalar.Update(stepDt);
+        avx2.Update(stepDt);
+        REQUIRE(haveSameLights(avx2, scalar));
+    }
+}
+
+
+TEST(LightAnimation, LightsStayInsideOfTheBounds) {
+    LightAnimation animation;
+    generateLights(animation, 500, 3);
+    std::vector<float> baseRadius(animation.GetRadius(),
+        animation.GetRadius() + animation.GetCount());
+    UINT32 outsideCnt = 0;
+    float minFlicker = 1.0f;
+    for (int step = 0; step < 500; step++) {
+        animation.Update(0.05f);
+        for (UINT32 i = 0; i < animation.GetCount(); i++) {
+            sm::Vector3 position(animation.GetPositionX()[i],
+                animation.GetPositionY()[i], animation.GetPositionZ()[i]);
+            outsideCnt += position == sm::Vector3::Max(sm::Vector3::Min(position,
+                BOUNDS_MAX), BOUNDS_MIN) ? 0 : 1;
+
+            // The radius follows the square root of the dimming, down to 40%.
+            float radius = animation.GetRadius()[i] / baseRadius[i];
+            CHECK(radius <= 1.0f && radius >= std::sqrt(0.4f) - 1e-5f);
+            minFlicker = std::min(minFlicker, radius);
+        }
+    }
+    CHECK(outsideCnt == 0);
+    CHECK(minFlicker < 0.7f);
+}
+
+
+TEST(LightAnimation, WritesMatchTheLights) {
+    LightAnimation animation;
+    generateLights(animation, 40, 4);
+    animation.Update(0.3f);
+
+    // Into the middle of a pool.
+    LightPool pool;
+    for (UINT32 i = 0; i < 50; i++) {
+        pool.Add(sm::Vector3::Zero, 1.0f, sm::Vector3::Zero);
+    }
+    pool.ClearDirty();
+    animation.WriteLights(10, 30, pool.EditLights(5, 25));
+    CHECK(pool.GetDirtyBegin() == 5 && pool.GetDirtyEnd() == 25);
+    for (UINT32 i = 10; i < 30; i++) {
+        const LightPool::PackedLight& light = pool.GetLights()[i - 5];
+        CHECK(light.positionRadius == sm::Vector4(animation.GetPositionX()[i],
+            animation.GetPositionY()[i], animation.GetPositionZ()[i],
+            animation.GetRadius()[i]));
+        CHECK(light.color == LightPool::PackColor(animation.GetIntensity()[i] *
+            sm::Vector3(animation.GetColorR()[i], animation.GetColorG()[i],
+            animation.GetColorB()[i])));
+    }
+
+    // Instances of 9 floats, padded like the instance buffer.
+    std::vector<UINT32> lights = { 3, 7, 8, 39 };
+    const UINT32 stride = 12 * sizeof(float);
+    std::vector<float> instances(12 * lights.size(), -1.0f);
+    animation.WriteInstances(lights, instances.data(), stride);
+    for (size_t i = 0; i < lights.size(); i++) {
+        const float* instance = &instances[12 * i];
+        UINT32 light = lights[i];
+        float intensity = animation.GetIntensity()[light];
+        CHECK(sm::Vector3(instance) == sm::Vector3(animation.GetPositionX()[light],
+            animation.GetPositionY()[light], animation.GetPositionZ()[light]));
+        CHECK(sm::Vector3(instance + 3) == sm::Vector3(2.0f *
+            animation.GetRadius()[light]));
+        CHECK(sm::Vector3(instance + 6) == intensity * sm::Vector3(
+            animation.GetColorR()[light], animation.GetColorG()[light],
+            animation.GetColorB()[light]));
+        CHECK(instance[9] == -1.0f);
+    }
+}
@@ -0,0 +1,168 @@
+#include "Test.h"
+#include "LightBvh.h"
+
+/// <summary>
+/// Random lights in a 100 x 20 x 100 volume, some of them large.
+/// </summary>
+static std::vector<sm::Vector4> generateLights(size_t count, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> height(0.0f, 20.0f);
+    std::uniform_real_distribution<float> radius(0.2f, 4.0f);
+    std::vector<sm::Vector4> lights(count);
+    for (size_t i = 0; i < count; i++) {
+        lights[i] = sm::Vector4(position(generator), height(generator),
+            position(generator), radius(generator) * (i % 50 == 0 ? 5.0f : 1.0f));
+    }
+    return lights;
+}
+
+
+/// <summary>
+/// Returns a result sorted, the queries return them in no particular order.
+/// </summary>
+static std::vector<UINT32> sorted(std::vector<UINT32> result) {
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+
+/// <summary>
+/// Checks every query against testing every light.
+/// </summary>
+/// <returns>Number of rays that hit a light.</returns>
+static UINT32 checkQueries(const LightBvh& lightBvh,
+        const std::vector<sm::Vector4>& lights, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+    std::uniform_real_distribution<float> size(0.5f, 15.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<UINT32> result;
+    std::vector<UINT32> expected;
+    UINT32 hitCnt = 0;
+    for (int query = 0; query < 50; query++) {
+        sm::Vector3 point(position(generator), 0.5f * position(generator),
+            position(generator));
+        float extent = size(generator);
+
+        // Sphere.
+        expected.clear();
+        for (UINT32 i = 0; i < lights.size(); i++) {
+            float reach = extent + lights[i].w;
+            if (sm::Vector3::DistanceSquared(point, sm::Vector3(lights[i].x,
+                    lights[i].y, lights[i].z)) <= reach * reach) {
+                expected.push_back(i);
+            }
+        }
+        lightBvh.QuerySphere(point, extent, result);
+        CHECK(sorted(result) == expected);
+
+        // Box.
+        sm::Vector3 boxMin = point - sm::Vector3(extent, 0.5f * extent, 2.0f * extent);
+        sm::Vector3 boxMax = point + sm::Vector3(extent, 0.5f * extent, 2.0f * extent);
+        expected.clear();
+        for (UINT32 i = 0; i < lights.size(); i++) {
+            sm::Vector3 center(lights[i].x, lights[i].y, lights[i].z);
+            sm::Vector3 nearest = sm::Vector3::Max(sm::Vector3::Min(center, boxMax),
+                boxMin);
+            float radius = lights[i].w;
+            if (sm::Vector3::DistanceSquared(center, nearest) <= radius * radius) {
+                expected.push_back(i);
+            }
+        }
+        lightBvh.QueryBox(boxMin, boxMax, result);
+        CHECK(sorted(result) == expected);
+
+        // Frustum, a sphere is inside unless it is entirely outside of a plane.
+        sm::Vector3 direction(unit(generator), 0.3f * unit(generator), unit(generator));
+        sm::Matrix viewProj = sm::Matrix::CreateLookAt(point, point + direction,
+            sm::Vector3::UnitY) * sm::Matrix::CreatePerspectiveFieldOfView(
+            dx::XM_PI / 3.0f, 1.5f, 0.5f, 10.0f + 5.0f * extent);
+        FrustumCuller::Planes planes = FrustumCuller::ExtractPlanes(viewProj);
+        expected.clear();
+        for (UINT32 i = 0; i < lights.size(); i++) {
+            bool isOutside = false;
+            for (const sm::Vector4& plane : planes) {
+                isOutside |= plane.x * lights[i].x + plane.y * lights[i].y +
+                    plane.z * lights[i].z + plane.w < -lights[i].w;
+            }
+            if (!isOutside) {
+                expected.push_back(i);
+            }
+        }
+        lightBvh.QueryFrustum(planes, result);
+        CHECK(sorted(result) == expected);
+
+        // Ray, the nearest entry. A ray that starts inside hits at 0, so several
+        // lights can be the nearest one.
+        auto computeEntry = [&lights, &point, &direction](UINT32 i) {
+            sm::Vector3 offset = point - sm::Vector3(lights[i].x, lights[i].y,
+                lights[i].z);
+            float a = direction.Dot(direction);
+            float b = offset.Dot(direction);
+            float c = offset.Dot(offset) - lights[i].w * lights[i].w;
+            float discriminant = b * b - a * c;
+            if (discriminant < 0.0f || (-b + std::sqrt(discriminant)) / a < 0.0f) {
+                return FLT_MAX;
+            }
+            return std::max((-b - std::sqrt(discriminant)) / a, 0.0f);
+        };
+        float maxT = 3.0f * extent;
+        float expectedT = maxT;
+        for (UINT32 i = 0; i < lights.size(); i++) {
+            expectedT = std::min(expectedT, computeEntry(i));
+        }
+        UINT32 light = lightBvh.RaycastNearest(point, direction, maxT);
+        if (expectedT < 3.0f * extent) {
+            REQUIRE(light != LightBvh::NO_LIGHT);
+            CHECK_NEAR(maxT, expectedT, 1e-4f);
+            CHECK_NEAR(computeEntry(light), expectedT, 1e-4f);
+            hitCnt++;
+        } else {
+            CHECK(light == LightBvh::NO_LIGHT);
+        }
+    }
+    return hitCnt;
+}
+
+
+TEST(LightBvh, QueriesMatchTestingEveryLight) {
+    std::vector<sm::Vector4> lights = generateLights(2000, 1);
+    LightBvh lightBvh;
+    lightBvh.Build(lights);
+    REQUIRE(lightBvh.GetCount() == lights.size());
+    CHECK(checkQueries(lightBvh, lights, 2) > 0);
+
+    // Nothing to find.
+    LightBvh empty;
+    empty.Build(std::vector<sm::Vector4>());
+    std::vector<UINT32> result(1, 0);
+    empty.QuerySphere(sm::Vector3::Zero, 100.0f, result);
+    CHECK(result.empty());
+    float maxT = 100.0f;
+    CHECK(empty.RaycastNearest(sm::Vector3::Zero, sm::Vector3::UnitX, maxT) ==
+        LightBvh::NO_LIGHT);
+}
+
+
+TEST(LightBvh, RefitsMatchTestingEveryLight) {
+    // Lights drifting in one direction degrade the hierarchy until it is rebuilt.
+    std::vector<sm::Vector4> lights = generateLights(1000, 3);
+    LightBvh lightBvh;
+    lightBvh.Build(lights);
+    std::mt19937 generator(4);
+    std::uniform_real_distribution<float> offset(-1.0f, 3.0f);
+    std::uniform_real_distribution<float> radius(0.8f, 1.2f);
+    for (int frame = 0; frame < 64; frame++) {
+        for (UINT32 i = 0; i < lights.size(); i += 1 + frame % 3) {
+            lights[i] += sm::Vector4(offset(generator), 0.0f, offset(generator), 0.0f);
+            lights[i].w *= radius(generator);
+            lightBvh.SetLight(i, lights[i]);
+        }
+        lightBvh.Refit();
+        if (frame % 16 == 15) {
+            checkQueries(lightBvh, lights, 5 + frame);
+        }
+    }
+    CHECK(lightBvh.GetBuildCount() > 1);
+}
@@ -0,0 +1,151 @@
+#include "Test.h"
+#include "LightLod.h"
+#include "SceneMath.h"
+#include "shader/LightAttenuation.hlsli"
+
+/// <summary>
+/// Random lights in a 300 x 20 x 300 volume, with the radii of their colors like
+/// the lights of Sponza.
+/// </summary>
+static void generateLights(size_t count, unsigned int seed,
+        std::vector<sm::Vector4>& lights, std::vector<sm::Vector3>& colors) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+    std::uniform_real_distribution<float> height(0.0f, 20.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    lights.resize(count);
+    colors.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        colors[i] = sm::Vector3(unit(generator), unit(generator), unit(generator));
+        lights[i] = sm::Vector4(position(generator), height(generator),
+            position(generator), SceneMath::ComputeLightRadius(colors[i], 1.0f,
+            LIGHT_CUTOFF));
+    }
+}
+
+
+/// <summary>
+/// Random points on the floor of the lights.
+/// </summary>
+static std::vector<sm::Vector3> generatePoints(size_t count, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+    std::vector<sm::Vector3> points(count);
+    for (sm::Vector3& point : points) {
+        point = sm::Vector3(position(generator), 0.0f, position(generator));
+    }
+    return points;
+}
+
+
+TEST(LightLod, MergedLightsKeepTheirEnergy) {
+    std::vector<sm::Vector4> lights;
+    std::vector<sm::Vector3> colors;
+    generateLights(3000, 1, lights, colors);
+    LightLod lightLod;
+    lightLod.Build(lights, colors);
+    lightLod.Update(sm::Vector3(-150.0f, 10.0f, -150.0f), 500.0f);
+    REQUIRE(!lightLod.GetVirtualLights().empty());
+
+    // Every light is either kept or merged into a single virtual light, whose color
+    // is the sum and whose sphere holds the ones of the merged lights.
+    std::vector<UINT32> lightCnts(lights.size(), 0);
+    for (UINT32 i : lightLod.GetKeptLights()) {
+        lightCnts[i]++;
+    }
+    for (const LightLod::VirtualLight& virtualLight : lightLod.GetVirtualLights()) {
+        CHECK(virtualLight.count > 1);
+        sm::Vector3 color = sm::Vector3::Zero;
+        for (UINT32 j = virtualLight.first; j < virtualLight.first + virtualLight.count;
+                j++) {
+            UINT32 i = lightLod.GetMergedLights()[j];
+            lightCnts[i]++;
+            color += colors[i];
+            float reach = sm::Vector3::Distance(virtualLight.position,
+                sm::Vector3(lights[i].x, lights[i].y, lights[i].z)) + lights[i].w;
+            CHECK(reach <= virtualLight.radius * 1.0001f);
+        }
+        CHECK(sm::Vector3::Distance(color, virtualLight.color) < 1e-4f * color.Length());
+    }
+    size_t singleCnt = std::count(lightCnts.begin(), lightCnts.end(), 1u);
+    CHECK(singleCnt == lightCnts.size());
+}
+
+
+TEST(LightLod, ErrorComparesWithTheUnmergedLights) {
+    // Two lights of the same color, merged into one in the middle of them. At the
+    // middle the virtual light is brighter, far from both it is dark.
+    std::vector<sm::Vector4> lights = { sm::Vector4(0.0f, 0.0f, 0.0f, 10.0f),
+        sm::Vector4(2.0f, 0.0f, 0.0f, 10.0f) };
+    std::vector<sm::Vector3> colors(2, sm::Vector3(0.5f, 0.2f, 0.1f));
+    LightLod lightLod;
+    lightLod.Build(lights, colors);
+    LightLod::Settings settings;
+    settings.minDistance = 10.0f;
+    lightLod.SetSettings(settings);
+    lightLod.Update(sm::Vector3(0.0f, 0.0f, 1000.0f), 100.0f);
+    REQUIRE(lightLod.GetVirtualLights().size() == 1);
+    const LightLod::VirtualLight& virtualLight = lightLod.GetVirtualLights()[0];
+    CHECK(virtualLight.position == sm::Vector3(1.0f, 0.0f, 0.0f));
+    CHECK(virtualLight.radius == 11.0f);
+
+    auto attenuation = [](float dist, float radius) {
+        return SceneMath::ComputeLightAttenuation(dist, radius);
+    };
+    std::vector<sm::Vector3> points = { sm::Vector3(1.0f, 0.0f, 0.0f),
+        sm::Vector3(1.0f, 5.0f, 0.0f), sm::Vector3(100.0f, 0.0f, 0.0f) };
+    double errorSum = 0.0;
+    double referenceSum = 0.0;
+    for (const sm::Vector3& point : points) {
+        sm::Vector3 reference = colors[0] * (attenuation(sm::Vector3::Distance(point,
+            sm::Vector3(0.0f, 0.0f, 0.0f)), 10.0f) + attenuation(sm::Vector3::Distance(
+            point, sm::Vector3(2.0f, 0.0f, 0.0f)), 10.0f));
+        sm::Vector3 merged = 2.0f * colors[0] * attenuation(sm::Vector3::Distance(point,
+            virtualLight.position), virtualLight.radius);
+        errorSum += sm::Vector3::DistanceSquared(reference, merged);
+        referenceSum += reference.LengthSquared();
+    }
+    CHECK_NEAR(lightLod.ComputeError(points, attenuation),
+        float(std::sqrt(errorSum / referenceSum)), 1e-5f);
+
+    // Nothing merged, nothing lost.
+    settings.minDistance = 2000.0f;
+    lightLod.SetSettings(settings);
+    lightLod.Update(sm::Vector3(0.0f, 0.0f, 1000.0f), 100.0f);
+    CHECK(lightLod.GetVirtualLights().empty());
+    CHECK(lightLod.ComputeError(points, attenuation) == 0.0f);
+}
+
+
+TEST(LightLod, ErrorGrowsWithTheMergeSize) {
+    // Lights merged within the default size of a few pixels barely change the
+    // lighting of the floor. Larger sizes merge more lights at a larger error.
+    std::vector<sm::Vector4> lights;
+    std::vector<sm::Vector3> colors;
+    generateLights(2000, 2, lights, colors);
+    std::vector<sm::Vector3> points = generatePoints(2000, 3);
+    auto attenuation = [](float dist, float radius) {
+        return SceneMath::ComputeLightAttenuation(dist, radius);
+    };
+    LightLod lightLod;
+    lightLod.Build(lights, colors);
+    LightLod::Settings settings;
+    settings.minDistance = 30.0f;
+    float lastError = 0.0f;
+    size_t lastMergedCnt = 0;
+    for (float mergeSize : { 0.5f, 2.0f, 8.0f, 32.0f }) {
+        settings.maxMergeSize = mergeSize;
+        lightLod.SetSettings(settings);
+        lightLod.Update(sm::Vector3(-150.0f, 10.0f, -150.0f), 540.0f);
+        float error = lightLod.ComputeError(points, attenuation);
+        CHECK(error >= lastError);
+        CHECK(lightLod.GetMergedLights().size() >= lastMergedCnt);
+        if (mergeSize <= 2.0f) {
+            CHECK(error < 0.01f);
+        }
+        lastError = error;
+        lastMergedCnt = lightLod.GetMergedLights().size();
+    }
+    CHECK(lastError > 0.1f);
+    CHECK(lastMergedCnt > lights.size() / 4);
+}
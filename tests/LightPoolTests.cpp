@@ -0,0 +1,200 @@
+#include "Test.h"
+#include "LightPool.h"
+
+/// <summary>
+/// A light of the reference the pool is checked against.
+/// </summary>
+struct ReferenceLight {
+    sm::Vector3 position;
+    float radius;
+    sm::Vector3 color;
+};
+
+
+/// <summary>
+/// Checks that every light of the reference is in the pool under its handle, and
+/// that indices and handles agree.
+/// </summary>
+static void checkPool(const LightPool& pool,
+        const std::unordered_map<LightPool::Handle, ReferenceLight>& reference) {
+    REQUIRE(pool.GetCount() == reference.size());
+    for (const auto& [handle, light] : reference) {
+        REQUIRE(pool.IsValid(handle));
+        UINT32 index = pool.GetIndex(handle);
+        REQUIRE(index < pool.GetCount());
+        CHECK(pool.GetHandle(index) == handle);
+        const LightPool::PackedLight& packed = pool.GetLights()[index];
+        CHECK(packed.positionRadius == sm::Vector4(light.position.x, light.position.y,
+            light.position.z, light.radius));
+        CHECK(packed.color == LightPool::PackColor(light.color));
+    }
+}
+
+
+/// <summary>
+/// A random light.
+/// </summary>
+static ReferenceLight generateLight(std::mt19937& generator) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    return { sm::Vector3(unit(generator), unit(generator), unit(generator)) * 100.0f,
+        1.0f + unit(generator) * 10.0f,
+        sm::Vector3(unit(generator), unit(generator), unit(generator)) };
+}
+
+
+TEST(LightPool, HandlesFollowTheirLights) {
+    // Random adds, removes and changes against a map of the handles.
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> operation(0, 3);
+    LightPool pool;
+    std::unordered_map<LightPool::Handle, ReferenceLight> reference;
+    size_t removedCnt = 0;
+    size_t maxCount = 0;
+    for (int step = 0; step < 2000; step++) {
+        int op = reference.empty() ? 0 : operation(generator);
+        auto it = reference.begin();
+        if (!reference.empty()) {
+            std::advance(it, std::uniform_int_distribution<size_t>(0,
+                reference.size() - 1)(generator));
+        }
+        if (op == 0 || op == 1) {
+            ReferenceLight light = generateLight(generator);
+            LightPool::Handle handle = pool.Add(light.position, light.radius,
+                light.color);
+            CHECK(reference.find(handle) == reference.end());
+            reference[handle] = light;
+            maxCount = std::max(maxCount, reference.size());
+        } else if (op == 2) {
+            pool.Remove(it->first);
+            CHECK(!pool.IsValid(it->first));
+            removedCnt++;
+            reference.erase(it);
+        } else {
+            ReferenceLight light = generateLight(generator);
+            pool.SetLight(it->first, light.position, light.radius, light.color);
+            it->second = light;
+        }
+    }
+    checkPool(pool, reference);
+
+    // Removed handles are reused, so there are never more of them than lights.
+    for (const auto& [handle, light] : reference) {
+        CHECK(handle < maxCount);
+    }
+    CHECK(removedCnt > 0);
+}
+
+
+TEST(LightPool, RemovingMovesTheLastLight) {
+    LightPool pool;
+    std::vector<LightPool::Handle> handles;
+    for (int i = 0; i < 5; i++) {
+        handles.push_back(pool.Add(sm::Vector3(float(i)), 1.0f, sm::Vector3::One));
+    }
+    pool.Remove(handles[1]);
+    CHECK(pool.GetCount() == 4);
+    CHECK(pool.GetIndex(handles[4]) == 1);
+    CHECK(pool.GetLights()[1].positionRadius.x == 4.0f);
+    CHECK(pool.GetIndex(handles[3]) == 3);
+
+    // The next light gets the free handle.
+    LightPool::Handle handle = pool.Add(sm::Vector3(7.0f), 1.0f, sm::Vector3::One);
+    CHECK(handle == handles[1]);
+    CHECK(pool.GetIndex(handle) == 4);
+
+    pool.Clear();
+    CHECK(pool.GetCount() == 0);
+    CHECK(!pool.IsValid(handles[0]));
+    CHECK(pool.IsResized());
+}
+
+
+TEST(LightPool, DirtyRangeCoversEveryChange) {
+    // A copy that only receives the dirty range, like the structured buffer, has to
+    // stay equal to the pool.
+    std::mt19937 generator(2);
+    std::uniform_int_distribution<int> operation(0, 5);
+    LightPool pool;
+    std::vector<LightPool::Handle> handles;
+    for (int i = 0; i < 100; i++) {
+        ReferenceLight light = generateLight(generator);
+        handles.push_back(pool.Add(light.position, light.radius, light.color));
+    }
+    std::vector<LightPool::PackedLight> uploaded;
+    UINT32 uploadedCnt = 0;
+    for (int frame = 0; frame < 200; frame++) {
+        int changeCnt = std::uniform_int_distribution<int>(0, 4)(generator);
+        for (int change = 0; change < changeCnt; change++) {
+            size_t slot = std::uniform_int_distribution<size_t>(0,
+                handles.size() - 1)(generator);
+            ReferenceLight light = generateLight(generator);
+            int op = handles.size() < 10 ? 0 : operation(generator);
+            if (op == 0) {
+                handles.push_back(pool.Add(light.position, light.radius, light.color));
+            } else if (op == 1) {
+                pool.Remove(handles[slot]);
+                handles.erase(handles.begin() + slot);
+            } else if (op == 2) {
+                pool.SetPosition(handles[slot], light.position);
+            } else if (op == 3) {
+                // A few lights at once, like the animation writes them.
+                UINT32 begin = pool.GetIndex(handles[slot]);
+                UINT32 end = std::min(begin + 3, pool.GetCount());
+                LightPool::PackedLight* lights = pool.EditLights(begin, end);
+                for (UINT32 i = begin; i < end; i++) {
+                    lights[i - begin].positionRadius.y += 1.0f;
+                }
+            } else {
+                pool.SetLight(handles[slot], light.position, light.radius, light.color);
+            }
+        }
+
+        uploaded.resize(pool.GetCount());
+        for (UINT32 i = pool.GetDirtyBegin(); i < pool.GetDirtyEnd(); i++) {
+            uploaded[i] = pool.GetLights()[i];
+        }
+        CHECK(pool.GetDirtyEnd() <= pool.GetCount());
+        CHECK(uploadedCnt == pool.GetCount() || pool.IsResized());
+        uploadedCnt = pool.GetCount();
+        pool.ClearDirty();
+        CHECK(std::memcmp(uploaded.data(), pool.GetLights().data(),
+            uploaded.size() * sizeof(LightPool::PackedLight)) == 0);
+    }
+    CHECK(pool.GetDirtyBegin() == pool.GetDirtyEnd());
+    CHECK(!pool.IsResized());
+}
+
+
+TEST(LightPool, ColorsRoundTripThroughTheirPacking) {
+    // Within half a step of the mantissas, a 512th of the brightest channel, which
+    // may exceed 1, e.g. for the summed colors of merged lights.
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_real_distribution<float> exponent(-12.0f, 15.0f);
+    for (int i = 0; i < 10000; i++) {
+        sm::Vector3 color = std::exp2(exponent(generator)) *
+            sm::Vector3(unit(generator), unit(generator), unit(generator));
+        UINT32 packed = LightPool::PackColor(color);
+        sm::Vector3 unpacked = LightPool::UnpackColor(packed);
+        float tolerance = std::max(std::max(color.x, color.y), color.z) / 512.0f *
+            1.0001f;
+        CHECK_NEAR(unpacked.x, color.x, tolerance);
+        CHECK_NEAR(unpacked.y, color.y, tolerance);
+        CHECK_NEAR(unpacked.z, color.z, tolerance);
+
+        // Unpacked colors pack to themselves, e.g. copied from one pool to another.
+        CHECK(LightPool::PackColor(unpacked) == packed);
+    }
+
+    // 256 * 2^(16 - 24) in blue, exponent 16.
+    CHECK(LightPool::PackColor(sm::Vector3(0.0f, 0.0f, 1.0f)) == 0x84000000u);
+    CHECK(LightPool::UnpackColor(0x84000000u) == sm::Vector3(0.0f, 0.0f, 1.0f));
+    // A mantissa that rounds up to 512 takes the next exponent.
+    CHECK(LightPool::UnpackColor(LightPool::PackColor(sm::Vector3(0.99999f))) ==
+        sm::Vector3::One);
+    // Clamped to [0, MAX_COLOR].
+    CHECK(LightPool::PackColor(sm::Vector3(-1.0f, 0.0f, 0.0f)) ==
+        LightPool::PackColor(sm::Vector3::Zero));
+    CHECK(LightPool::UnpackColor(LightPool::PackColor(sm::Vector3(1e6f))) ==
+        sm::Vector3(LightPool::MAX_COLOR));
+}
@@ -0,0 +1,161 @@
+#include "Test.h"
+#include "MeshChunker.h"
+
+/// <summary>
+/// Vertex with more than a position, to test the stride.
+/// </summary>
+struct TestVertex {
+    sm::Vector3 position;
+    sm::Vector2 texCoord;
+};
+
+
+/// <summary>
+/// A bumpy grid of quads with shared vertices.
+/// </summary>
+static void createGrid(UINT32 quadsPerSide, std::vector<TestVertex>& vertices,
+        std::vector<UINT32>& indices) {
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> height(-0.5f, 0.5f);
+    UINT32 side = quadsPerSide + 1;
+    vertices.resize(side * side);
+    for (UINT32 y = 0; y < side; y++) {
+        for (UINT32 x = 0; x < side; x++) {
+            vertices[y * side + x].position = sm::Vector3(float(x), height(generator),
+                float(y) * 0.5f);
+        }
+    }
+    indices.clear();
+    for (UINT32 y = 0; y < quadsPerSide; y++) {
+        for (UINT32 x = 0; x < quadsPerSide; x++) {
+            UINT32 corner = y * side + x;
+            indices.insert(indices.end(), { corner, corner + side, corner + 1,
+                corner + 1, corner + side, corner + side + 1 });
+        }
+    }
+}
+
+
+/// <summary>
+/// Splits a grid with the stride of TestVertex.
+/// </summary>
+static std::vector<MeshChunker::Chunk> split(const std::vector<TestVertex>& vertices,
+        const std::vector<UINT32>& indices, UINT32 maxTriangleCnt) {
+    std::vector<MeshChunker::Chunk> chunks;
+    MeshChunker::Split(&vertices[0].position, vertices.size(), sizeof(TestVertex),
+        indices.data(), indices.size(), maxTriangleCnt, chunks);
+    return chunks;
+}
+
+
+TEST(MeshChunker, ChunksHoldEveryTriangleOnce) {
+    std::vector<TestVertex> vertices;
+    std::vector<UINT32> indices;
+    createGrid(40, vertices, indices);
+    const UINT32 maxTriangleCnt = 100;
+    std::vector<MeshChunker::Chunk> chunks = split(vertices, indices, maxTriangleCnt);
+    CHECK(chunks.size() > 1);
+
+    // Triangles in source vertices, in their winding.
+    std::vector<std::array<UINT32, 3>> expected;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        expected.push_back({ indices[i], indices[i + 1], indices[i + 2] });
+    }
+    std::vector<std::array<UINT32, 3>> actual;
+    for (const MeshChunker::Chunk& chunk : chunks) {
+        size_t triangleCnt = chunk.indices.size() / 3;
+        CHECK(triangleCnt <= maxTriangleCnt);
+        CHECK(triangleCnt >= maxTriangleCnt / 2);
+
+        std::vector<std::array<UINT32, 3>> chunkTriangles;
+        for (size_t i = 0; i < chunk.indices.size(); i += 3) {
+            chunkTriangles.push_back({ chunk.vertices[chunk.indices[i]],
+                chunk.vertices[chunk.indices[i + 1]],
+                chunk.vertices[chunk.indices[i + 2]] });
+        }
+        // Original order inside of a chunk.
+        std::vector<size_t> sourceIdx;
+        for (const std::array<UINT32, 3>& triangle : chunkTriangles) {
+            sourceIdx.push_back(std::find(expected.begin(), expected.end(), triangle) -
+                expected.begin());
+        }
+        CHECK(std::is_sorted(sourceIdx.begin(), sourceIdx.end()));
+        actual.insert(actual.end(), chunkTriangles.begin(), chunkTriangles.end());
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    CHECK(actual == expected);
+}
+
+
+TEST(MeshChunker, BoundsAreTightAroundTheChunk) {
+    std::vector<TestVertex> vertices;
+    std::vector<UINT32> indices;
+    createGrid(30, vertices, indices);
+    for (const MeshChunker::Chunk& chunk : split(vertices, indices, 64)) {
+        // Every chunk vertex is used, only once.
+        std::vector<UINT32> sorted = chunk.vertices;
+        std::sort(sorted.begin(), sorted.end());
+        CHECK(std::unique(sorted.begin(), sorted.end()) == sorted.end());
+
+        sm::Vector3 boundsMin(FLT_MAX);
+        sm::Vector3 boundsMax(-FLT_MAX);
+        for (UINT32 vertex : chunk.vertices) {
+            boundsMin = sm::Vector3::Min(boundsMin, vertices[vertex].position);
+            boundsMax = sm::Vector3::Max(boundsMax, vertices[vertex].position);
+        }
+        sm::Vector3 center = (boundsMin + boundsMax) * 0.5f;
+        sm::Vector3 extents = (boundsMax - boundsMin) * 0.5f;
+        CHECK_NEAR(chunk.bounds.Center.x, center.x, 1e-5f);
+        CHECK_NEAR(chunk.bounds.Center.y, center.y, 1e-5f);
+        CHECK_NEAR(chunk.bounds.Center.z, center.z, 1e-5f);
+        CHECK_NEAR(chunk.bounds.Extents.x, extents.x, 1e-5f);
+        CHECK_NEAR(chunk.bounds.Extents.y, extents.y, 1e-5f);
+        CHECK_NEAR(chunk.bounds.Extents.z, extents.z, 1e-5f);
+    }
+}
+
+
+TEST(MeshChunker, SplitShrinksTheBoundsOfTheTriangles) {
+    // The measure of the model loading report: bounds area per triangle.
+    std::vector<TestVertex> vertices;
+    std::vector<UINT32> indices;
+    createGrid(64, vertices, indices);
+    std::vector<MeshChunker::Chunk> whole = split(vertices, indices, UINT32_MAX);
+    REQUIRE(whole.size() == 1);
+    double wholeArea = MeshChunker::GetSurfaceArea(whole[0].bounds);
+
+    double chunkArea = 0.0;
+    for (const MeshChunker::Chunk& chunk : split(vertices, indices, 128)) {
+        chunkArea += chunk.indices.size() / double(indices.size()) *
+            MeshChunker::GetSurfaceArea(chunk.bounds);
+    }
+    // 64 chunks of 1/8 x 1/8 of the grid.
+    CHECK(chunkArea < 0.2 * wholeArea);
+}
+
+
+TEST(MeshChunker, KeepsSmallAndDegenerateMeshes) {
+    std::vector<TestVertex> vertices;
+    std::vector<UINT32> indices;
+    createGrid(4, vertices, indices);
+    std::vector<MeshChunker::Chunk> chunks = split(vertices, indices, 32);
+    REQUIRE(chunks.size() == 1);
+    CHECK(chunks[0].indices.size() == indices.size());
+
+    // All centroids in one point: nothing to split at.
+    std::vector<UINT32> stacked;
+    for (int i = 0; i < 50; i++) {
+        stacked.insert(stacked.end(), { 0, 1, 2 });
+    }
+    CHECK(split(vertices, stacked, 8).size() == 1);
+}
+
+
+TEST(MeshChunker, SurfaceAreaOfABox) {
+    CHECK_NEAR(MeshChunker::GetSurfaceArea(dx::BoundingBox(sm::Vector3(5.0f),
+        sm::Vector3(0.5f, 1.0f, 1.5f))), 22.0, 1e-9);
+    // Flat boxes still have an area.
+    CHECK_NEAR(MeshChunker::GetSurfaceArea(dx::BoundingBox(sm::Vector3::Zero,
+        sm::Vector3(1.0f, 0.0f, 2.0f))), 16.0, 1e-9);
+}
@@ -0,0 +1,38 @@
+#include "Test.h"
+#include "MeshGeometry.h"
+
+TEST(MeshGeometry, IcosahedronCoversTheSphere) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MeshGeometry::GenerateIcosahedronGeometry(vertices, indices);
+    REQUIRE(vertices.size() == 12 && indices.size() == 60);
+
+    // Every face faces outwards and lies outside of the sphere of radius 0.5, the
+    // radius of a light whose scale is its diameter, but only just.
+    std::vector<sm::Vector4> planes;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        sm::Vector3 a = vertices[indices[i]].Position;
+        sm::Vector3 b = vertices[indices[i + 1]].Position;
+        sm::Vector3 c = vertices[indices[i + 2]].Position;
+        sm::Vector3 normal = (b - a).Cross(c - a);
+        normal.Normalize();
+        float distance = normal.Dot(a);
+        CHECK(distance >= 0.5f);
+        CHECK(distance < 0.5f * 1.001f);
+        CHECK(normal.Dot((a + b + c) / 3.0f) > 0.0f);
+        planes.push_back(sm::Vector4(normal.x, normal.y, normal.z, distance));
+    }
+
+    // So every vertex of the sphere is inside of all faces.
+    std::vector<Vertex> sphereVertices;
+    std::vector<unsigned int> sphereIndices;
+    MeshGeometry::GenerateSphereGeometry(32, 64, sphereVertices, sphereIndices);
+    UINT32 outsideCnt = 0;
+    for (const Vertex& vertex : sphereVertices) {
+        for (const sm::Vector4& plane : planes) {
+            outsideCnt += vertex.Position.Dot(sm::Vector3(plane.x, plane.y,
+                plane.z)) > plane.w ? 1 : 0;
+        }
+    }
+    CHECK(outsideCnt == 0);
+}
@@ -0,0 +1,270 @@
+#include "Test.h"
+#include "OcclusionCuller.h"
+
+// Depth buffer size of the tests.
+static const UINT32 WIDTH = 128;
+static const UINT32 HEIGHT = 64;
+
+/// <summary>
+/// Orthographic projection in which world x and y are pixel coordinates (top row
+/// at y = 0) and z from 0 to -20 maps to the depth range.
+/// </summary>
+static sm::Matrix createPixelProjection() {
+    return sm::Matrix::CreateOrthographicOffCenter(0.0f, float(WIDTH), float(HEIGHT),
+        0.0f, 0.0f, 20.0f);
+}
+
+
+/// <summary>
+/// Camera at the origin looking down +z with a 90 degree field of view.
+/// </summary>
+static sm::Matrix createPerspective() {
+    sm::Matrix viewMat = sm::Matrix::CreateLookAt(sm::Vector3::Zero,
+        sm::Vector3(0.0f, 0.0f, 1.0f), sm::Vector3::UnitY);
+    return viewMat * sm::Matrix::CreatePerspectiveFieldOfView(dx::XM_PI / 2.0f,
+        float(WIDTH) / float(HEIGHT), 0.5f, 100.0f);
+}
+
+
+/// <summary>
+/// Adds world space triangles as a single occluder.
+/// </summary>
+static void addTriangles(OcclusionCuller& culler,
+        const std::vector<sm::Vector3>& vertices) {
+    std::vector<UINT32> indices(vertices.size());
+    for (UINT32 i = 0; i < indices.size(); i++) {
+        indices[i] = i;
+    }
+    culler.AddOccluder(vertices.data(), vertices.size(), sizeof(sm::Vector3),
+        indices.data(), indices.size(), sm::Matrix::Identity);
+}
+
+
+/// <summary>
+/// Random triangles in front of the perspective camera, 2 to 30 units away.
+/// </summary>
+static std::vector<sm::Vector3> generateTriangles(size_t count, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> distance(2.0f, 30.0f);
+    std::vector<sm::Vector3> vertices;
+    for (size_t i = 0; i < count; i++) {
+        float z = distance(generator);
+        sm::Vector3 center(unit(generator) * z, unit(generator) * z * 0.5f, z);
+        for (int vertex = 0; vertex < 3; vertex++) {
+            vertices.push_back(center + sm::Vector3(unit(generator),
+                unit(generator), unit(generator)) * z * 0.3f);
+        }
+    }
+    return vertices;
+}
+
+
+/// <summary>
+/// Exact depth of the nearest triangle at a point on the screen, 1 if there is none.
+/// </summary>
+static float occluderDepthAt(const std::vector<sm::Vector3>& screenVertices,
+        float x, float y) {
+    float nearest = 1.0f;
+    for (size_t i = 0; i + 2 < screenVertices.size(); i += 3) {
+        const sm::Vector3& a = screenVertices[i];
+        const sm::Vector3& b = screenVertices[i + 1];
+        const sm::Vector3& c = screenVertices[i + 2];
+        float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+        if (area == 0.0f) {
+            continue;
+        }
+        float u = ((b.x - x) * (c.y - y) - (c.x - x) * (b.y - y)) / area;
+        float v = ((c.x - x) * (a.y - y) - (a.x - x) * (c.y - y)) / area;
+        float w = 1.0f - u - v;
+        if (u >= 0.0f && v >= 0.0f && w >= 0.0f) {
+            nearest = std::min(nearest, u * a.z + v * b.z + w * c.z);
+        }
+    }
+    return nearest;
+}
+
+
+/// <summary>
+/// Projects a world space point to pixel coordinates and z/w.
+/// </summary>
+static sm::Vector3 toScreen(const sm::Matrix& viewProj, const sm::Vector3& point) {
+    sm::Vector4 clip = sm::Vector4::Transform(
+        sm::Vector4(point.x, point.y, point.z, 1.0f), viewProj);
+    return sm::Vector3((clip.x / clip.w * 0.5f + 0.5f) * WIDTH,
+        (0.5f - clip.y / clip.w * 0.5f) * HEIGHT, clip.z / clip.w);
+}
+
+
+TEST(OcclusionCuller, NeverHidesVisibleBoxes) {
+    // Brute force: a box is visible if one of its sample points is in front of the
+    // exact occluder depth at its position on the screen.
+    sm::Matrix viewProj = createPerspective();
+    std::vector<sm::Vector3> vertices = generateTriangles(60, 1);
+    OcclusionCuller culler(WIDTH, HEIGHT);
+    culler.SetPath(OcclusionCuller::Path::SCALAR);
+    culler.BeginFrame(viewProj);
+    addTriangles(culler, vertices);
+    culler.Rasterize();
+
+    std::vector<sm::Vector3> screenVertices;
+    for (const sm::Vector3& vertex : vertices) {
+        screenVertices.push_back(toScreen(viewProj, vertex));
+    }
+
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> distance(5.0f, 40.0f);
+    UINT32 hiddenCnt = 0;
+    for (int boxIdx = 0; boxIdx < 2000; boxIdx++) {
+        float z = distance(generator);
+        dx::BoundingBox box(sm::Vector3(unit(generator) * z, unit(generator) * z * 0.5f,
+            z), sm::Vector3(0.02f + 0.3f * fabsf(unit(generator))));
+
+        bool isVisible = false;
+        for (int sample = 0; sample < 200 && !isVisible; sample++) {
+            sm::Vector3 point = sm::Vector3(box.Center) + sm::Vector3(box.Extents) *
+                sm::Vector3(unit(generator), unit(generator), unit(generator));
+            sm::Vector3 screen = toScreen(viewProj, point);
+            if (screen.x < 0.0f || screen.x >= WIDTH || screen.y < 0.0f ||
+                    screen.y >= HEIGHT) {
+                continue;
+            }
+            isVisible = screen.z < occluderDepthAt(screenVertices, screen.x, screen.y);
+        }
+        bool isKept = culler.TestBox(box);
+        CHECK(isKept || !isVisible);
+        hiddenCnt += isKept ? 0 : 1;
+    }
+    // The test has to hide some boxes, otherwise it proves nothing.
+    CHECK(hiddenCnt > 100);
+}
+
+
+TEST(OcclusionCuller, PartiallyCoveredPixelsDoNotOcclude) {
+    // The occluder ends at x = 40.7. Pixel 40 has its center covered, but a box
+    // behind it at x = 40.8 to 40.9 is visible.
+    OcclusionCuller culler(WIDTH, HEIGHT);
+    culler.SetPath(OcclusionCuller::Path::SCALAR);
+    culler.BeginFrame(createPixelProjection());
+    addTriangles(culler, {
+        sm::Vector3(0.0f, 0.0f, -1.0f), sm::Vector3(40.7f, 0.0f, -1.0f),
+        sm::Vector3(40.7f, 64.0f, -1.0f),
+        sm::Vector3(0.0f, 0.0f, -1.0f), sm::Vector3(40.7f, 64.0f, -1.0f),
+        sm::Vector3(0.0f, 64.0f, -1.0f) });
+    culler.Rasterize();
+
+    const std::vector<float>& depth = culler.GetDepth();
+    CHECK_NEAR(depth[10 * WIDTH + 39], 0.05f, 1e-5f);
+    CHECK(depth[10 * WIDTH + 40] == 1.0f);
+
+    CHECK(culler.TestBox(dx::BoundingBox(sm::Vector3(40.85f, 10.5f, -5.0f),
+        sm::Vector3(0.05f, 0.4f, 0.1f))));
+    CHECK(!culler.TestBox(dx::BoundingBox(sm::Vector3(38.5f, 10.5f, -5.0f),
+        sm::Vector3(1.0f, 0.4f, 0.1f))));
+}
+
+
+TEST(OcclusionCuller, DepthIsTheFarthestInsideOfThePixel) {
+    // A slanted occluder: -z grows by 0.1 per pixel along x. The buffer keeps the
+    // far side of every pixel, so a box right behind its near side stays visible.
+    OcclusionCuller culler(WIDTH, HEIGHT);
+    culler.SetPath(OcclusionCuller::Path::SCALAR);
+    culler.BeginFrame(createPixelProjection());
+    addTriangles(culler, {
+        sm::Vector3(0.0f, 0.0f, -1.0f), sm::Vector3(128.0f, 0.0f, -13.8f),
+        sm::Vector3(128.0f, 64.0f, -13.8f),
+        sm::Vector3(0.0f, 0.0f, -1.0f), sm::Vector3(128.0f, 64.0f, -13.8f),
+        sm::Vector3(0.0f, 64.0f, -1.0f) });
+    culler.Rasterize();
+
+    // Pixel 20 spans -z from 3.0 to 3.1.
+    CHECK_NEAR(culler.GetDepth()[5 * WIDTH + 20], 3.1f / 20.0f, 1e-4f);
+    CHECK(culler.TestBox(dx::BoundingBox(sm::Vector3(20.1f, 5.5f, -3.08f),
+        sm::Vector3(0.05f, 0.2f, 0.01f))));
+}
+
+
+TEST(OcclusionCuller, ClipsOccludersAtTheNearPlane) {
+    // A slanted wall whose lower corners are behind the camera. The box is away from
+    // the diagonal, where neither half of the wall covers a pixel completely.
+    sm::Matrix viewProj = createPerspective();
+    OcclusionCuller culler(WIDTH, HEIGHT);
+    culler.SetPath(OcclusionCuller::Path::SCALAR);
+    culler.BeginFrame(viewProj);
+    addTriangles(culler, {
+        sm::Vector3(-50.0f, -50.0f, -5.0f), sm::Vector3(50.0f, -50.0f, -5.0f),
+        sm::Vector3(50.0f, 50.0f, 8.0f),
+        sm::Vector3(-50.0f, -50.0f, -5.0f), sm::Vector3(50.0f, 50.0f, 8.0f),
+        sm::Vector3(-50.0f, 50.0f, 8.0f) });
+    culler.Rasterize();
+
+    CHECK(culler.GetTriangleCount() >= 2);
+    CHECK(!culler.TestBox(dx::BoundingBox(sm::Vector3(-6.0f, 0.0f, 20.0f),
+        sm::Vector3(1.0f))));
+    // In front of the wall.
+    CHECK(culler.TestBox(dx::BoundingBox(sm::Vector3(0.0f, 0.0f, 1.5f),
+        sm::Vector3(0.2f))));
+}
+
+
+TEST(OcclusionCuller, TileMaxDepthBoundsTheOccluders) {
+    // A screen that is not a multiple of the buffer or of the tiles. Every pixel
+    // center of a tile lies on or in front of the depth of the tile.
+    sm::Matrix viewProj = createPerspective();
+    std::vector<sm::Vector3> vertices = generateTriangles(60, 4);
+    OcclusionCuller culler(WIDTH, HEIGHT);
+    culler.BeginFrame(viewProj);
+    addTriangles(culler, vertices);
+    culler.Rasterize();
+    std::vector<sm::Vector3> screenVertices;
+    for (const sm::Vector3& vertex : vertices) {
+        screenVertices.push_back(toScreen(viewProj, vertex));
+    }
+
+    const UINT32 screenWidth = 300;
+    const UINT32 screenHeight = 170;
+    const UINT32 tileSize = 16;
+    std::vector<float> maxDepth;
+    culler.GetTileMaxDepth(screenWidth, screenHeight, tileSize, maxDepth);
+    const UINT32 tilesX = (screenWidth + tileSize - 1) / tileSize;
+    REQUIRE(maxDepth.size() == tilesX * ((screenHeight + tileSize - 1) / tileSize));
+
+    UINT32 boundedCnt = 0;
+    for (UINT32 y = 0; y < screenHeight; y++) {
+        for (UINT32 x = 0; x < screenWidth; x++) {
+            float tileDepth = maxDepth[(y / tileSize) * tilesX + x / tileSize];
+            float depth = occluderDepthAt(screenVertices,
+                (x + 0.5f) * WIDTH / screenWidth, (y + 0.5f) * HEIGHT / screenHeight);
+            CHECK(depth <= tileDepth);
+            boundedCnt += tileDepth < 1.0f ? 1 : 0;
+        }
+    }
+    // Some tiles have to be covered, otherwise the test proves nothing.
+    CHECK(boundedCnt > 0);
+}
+
+
+TEST(OcclusionCuller, Avx2MatchesScalar) {
+    OcclusionCuller scalar(WIDTH, HEIGHT);
+    scalar.SetPath(OcclusionCuller::Path::SCALAR);
+    OcclusionCuller avx2(WIDTH, HEIGHT);
+    avx2.SetPath(OcclusionCuller::Path::AVX2);
+    if (avx2.GetPath() != OcclusionCuller::Path::AVX2) {
+        return;
+    }
+
+    sm::Matrix viewProj = createPerspective();
+    std::vector<sm::Vector3> vertices = generateTriangles(200, 3);
+    // Some of them cross the near plane.
+    for (size_t i = 0; i < vertices.size(); i += 9) {
+        vertices[i].z = -1.0f;
+    }
+    for (OcclusionCuller* culler : { &scalar, &avx2 }) {
+        culler->SetThreadCount(3);
+        culler->BeginFrame(viewProj);
+        addTriangles(*culler, vertices);
+        culler->Rasterize();
+    }
+    CHECK(avx2.GetDepth() == scalar.GetDepth());
+}
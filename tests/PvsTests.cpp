@@ -0,0 +1,176 @@
+#include "Test.h"
+#include "Pvs.h"
+
+/// <summary>
+/// Adds a box of 12 triangles.
+/// </summary>
+static void addBox(Pvs& pvs, const dx::BoundingBox& box, bool isOccluder) {
+    std::array<sm::Vector3, 8> corners;
+    for (UINT32 i = 0; i < 8; i++) {
+        corners[i] = sm::Vector3(box.Center) + sm::Vector3(box.Extents) *
+            sm::Vector3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f,
+                i & 4 ? 1.0f : -1.0f);
+    }
+    static const UINT32 indices[36] = {
+        0, 1, 3, 0, 3, 2,   4, 6, 7, 4, 7, 5,   0, 4, 5, 0, 5, 1,
+        2, 3, 7, 2, 7, 6,   0, 2, 6, 0, 6, 4,   1, 5, 7, 1, 7, 3 };
+    pvs.AddMesh(corners.data(), corners.size(), sizeof(sm::Vector3), indices, 36,
+        sm::Matrix::Identity, isOccluder);
+}
+
+
+/// <summary>
+/// A maze of thin walls in a 40 x 8 x 40 volume with small props between them.
+/// </summary>
+static void addMaze(Pvs& pvs, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> length(3.0f, 10.0f);
+    std::uniform_real_distribution<float> size(0.1f, 0.8f);
+    for (int wall = 0; wall < 30; wall++) {
+        bool alongX = wall % 2 == 0;
+        float wallLength = length(generator);
+        addBox(pvs, dx::BoundingBox(sm::Vector3(position(generator), 0.0f,
+            position(generator)), sm::Vector3(alongX ? wallLength : 0.2f, 4.0f,
+            alongX ? 0.2f : wallLength)), true);
+    }
+    for (int prop = 0; prop < 60; prop++) {
+        addBox(pvs, dx::BoundingBox(sm::Vector3(position(generator),
+            position(generator) * 0.15f, position(generator)), sm::Vector3(
+            size(generator), size(generator), size(generator))), prop % 3 == 0);
+    }
+}
+
+
+/// <summary>
+/// Settings of the tests: cells of 10 units over the maze.
+/// </summary>
+static Pvs::Settings createSettings() {
+    Pvs::Settings settings;
+    settings.volume = dx::BoundingBox(sm::Vector3::Zero, sm::Vector3(20.0f, 4.0f, 20.0f));
+    settings.cellSize = 10.0f;
+    settings.resolution = 48;
+    return settings;
+}
+
+
+TEST(Pvs, SetsContainADenseReference) {
+    // The reference bakes cells of a quarter of the size, each with many random
+    // viewpoints and without dilation. Whatever it sees from inside of a cell has
+    // to be in the set of the cell.
+    Pvs::Settings settings = createSettings();
+    Pvs pvs;
+    addMaze(pvs, 1);
+    pvs.Bake(settings);
+
+    Pvs::Settings referenceSettings = settings;
+    referenceSettings.cellSize = settings.cellSize / 4.0f;
+    referenceSettings.innerSampleCnt = 8;
+    referenceSettings.dilation = 0;
+    referenceSettings.erosion = 0;
+    Pvs reference;
+    addMaze(reference, 1);
+    reference.Bake(referenceSettings);
+    REQUIRE(reference.GetCellCount() == 64 * pvs.GetCellCount());
+
+    UINT32 missCnt = 0;
+    UINT32 hiddenCnt = 0;
+    std::vector<UINT32> meshes;
+    std::vector<UINT32> referenceMeshes;
+    for (UINT32 referenceCell = 0; referenceCell < reference.GetCellCount();
+            referenceCell++) {
+        UINT32 cell = pvs.FindCell(reference.GetCellBounds(referenceCell).Center);
+        REQUIRE(cell != Pvs::NO_CELL);
+        pvs.GetVisibleMeshes(cell, meshes);
+        reference.GetVisibleMeshes(referenceCell, referenceMeshes);
+        for (UINT32 mesh : referenceMeshes) {
+            missCnt += std::binary_search(meshes.begin(), meshes.end(), mesh) ? 0 : 1;
+        }
+    }
+    for (UINT32 cell = 0; cell < pvs.GetCellCount(); cell++) {
+        pvs.GetVisibleMeshes(cell, meshes);
+        hiddenCnt += pvs.GetMeshCount() - static_cast<UINT32>(meshes.size());
+    }
+    CHECK(missCnt == 0);
+    // The maze has to hide something, otherwise the test proves nothing.
+    CHECK(hiddenCnt > 0);
+}
+
+
+TEST(Pvs, DilationAddsTheNeighbours) {
+    Pvs::Settings settings = createSettings();
+    settings.dilation = 0;
+    Pvs sampled;
+    addMaze(sampled, 2);
+    sampled.Bake(settings);
+    settings.dilation = 1;
+    Pvs dilated;
+    addMaze(dilated, 2);
+    dilated.Bake(settings);
+
+    // Cells are 4 x 1 x 4, x fastest.
+    std::vector<UINT32> meshes;
+    std::vector<UINT32> expected;
+    for (UINT32 cell = 0; cell < dilated.GetCellCount(); cell++) {
+        int x = static_cast<int>(cell % 4);
+        int z = static_cast<int>(cell / 4);
+        expected.clear();
+        for (int nz = std::max(0, z - 1); nz <= std::min(3, z + 1); nz++) {
+            for (int nx = std::max(0, x - 1); nx <= std::min(3, x + 1); nx++) {
+                sampled.GetVisibleMeshes(nz * 4 + nx, meshes);
+                expected.insert(expected.end(), meshes.begin(), meshes.end());
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+        dilated.GetVisibleMeshes(cell, meshes);
+        CHECK(meshes == expected);
+    }
+}
+
+
+TEST(Pvs, HashDetectsChangedGeometryAndSettings) {
+    Pvs::Settings settings = createSettings();
+    Pvs pvs;
+    addMaze(pvs, 3);
+    pvs.Bake(settings);
+    CHECK(pvs.GetHash() == pvs.ComputeHash(settings));
+
+    // Same mesh count, different geometry.
+    Pvs changed;
+    addMaze(changed, 4);
+    CHECK(changed.ComputeHash(settings) != pvs.GetHash());
+
+    Pvs::Settings otherGrid = settings;
+    otherGrid.cellSize = 8.0f;
+    CHECK(pvs.ComputeHash(otherGrid) != pvs.GetHash());
+    Pvs::Settings otherThreads = settings;
+    otherThreads.threadCnt = 3;
+    CHECK(pvs.ComputeHash(otherThreads) == pvs.GetHash());
+}
+
+
+TEST(Pvs, SaveAndLoadKeepTheSets) {
+    Pvs::Settings settings = createSettings();
+    Pvs pvs;
+    addMaze(pvs, 5);
+    pvs.Bake(settings);
+
+    std::string path = (std::filesystem::temp_directory_path() /
+        "sponza_pvs_test.pvs").string();
+    pvs.Save(path);
+    Pvs loaded;
+    loaded.Load(path);
+    std::filesystem::remove(path);
+
+    CHECK(loaded.GetHash() == pvs.GetHash());
+    CHECK(loaded.GetMeshCount() == pvs.GetMeshCount());
+    REQUIRE(loaded.GetCellCount() == pvs.GetCellCount());
+    std::vector<UINT32> meshes;
+    std::vector<UINT32> loadedMeshes;
+    for (UINT32 cell = 0; cell < pvs.GetCellCount(); cell++) {
+        pvs.GetVisibleMeshes(cell, meshes);
+        loaded.GetVisibleMeshes(cell, loadedMeshes);
+        CHECK(loadedMeshes == meshes);
+    }
+}
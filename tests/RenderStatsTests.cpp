@@ -0,0 +1,144 @@
+#include "Test.h"
+#include "RenderStats.h"
+#include "Benchmark.h"
+#include "WorkerPool.h"
+
+/// <summary>
+/// Stands in for ID3D11DeviceContext. Remembers the draw calls it received.
+/// </summary>
+struct MockContext {
+    std::vector<std::array<UINT, 2>> draws;     // Index or vertex count, instances.
+
+    void Draw(UINT vertexCnt, UINT) {
+        draws.push_back({ vertexCnt, 1 });
+    }
+
+    void DrawIndexed(UINT indexCnt, UINT, INT) {
+        draws.push_back({ indexCnt, 1 });
+    }
+
+    void DrawIndexedInstanced(UINT indexCnt, UINT instanceCnt, UINT, INT, UINT) {
+        draws.push_back({ indexCnt, instanceCnt });
+    }
+};
+
+
+TEST(RenderStats, CountsDrawsPerPass) {
+    MockContext context;
+    RenderStats::Reset();
+    RenderStats::BeginFrame();
+    RenderStats::SetPass(RenderStats::Pass::GEOMETRY);
+    RenderStats::DrawIndexed(&context, 300);
+    RenderStats::DrawIndexedInstanced(&context, 36, 10);
+    RenderStats::SetPass(RenderStats::Pass::COMBINATION);
+    RenderStats::Draw(&context, 3);
+    RenderStats::AddUpload(64);
+    RenderStats::BeginFrame();
+
+    REQUIRE(context.draws.size() == 3);
+    CHECK(context.draws[1][0] == 36);
+    CHECK(context.draws[1][1] == 10);
+
+    using Counter = RenderStats::Counter;
+    const RenderStats::Pass geometry = RenderStats::Pass::GEOMETRY;
+    const RenderStats::Pass combination = RenderStats::Pass::COMBINATION;
+    CHECK(RenderStats::Get(geometry, Counter::DRAW_CALLS) == 2);
+    CHECK(RenderStats::Get(geometry, Counter::PRIMITIVES) == 100 + 12 * 10);
+    CHECK(RenderStats::Get(geometry, Counter::INSTANCES) == 11);
+    CHECK(RenderStats::Get(geometry, Counter::CB_MAPS) == 0);
+    CHECK(RenderStats::Get(combination, Counter::DRAW_CALLS) == 1);
+    CHECK(RenderStats::Get(combination, Counter::PRIMITIVES) == 1);
+    CHECK(RenderStats::Get(combination, Counter::CB_MAPS) == 1);
+    CHECK(RenderStats::Get(combination, Counter::BYTES_UPLOADED) == 64);
+    CHECK(RenderStats::Get(RenderStats::Pass::UPDATE, Counter::DRAW_CALLS) == 0);
+    CHECK(RenderStats::GetFrameTotal(Counter::DRAW_CALLS) == 3);
+    RenderStats::Reset();
+}
+
+
+TEST(RenderStats, BeginFrameStartsFromZero) {
+    MockContext context;
+    RenderStats::Reset();
+    RenderStats::BeginFrame();
+    RenderStats::SetPass(RenderStats::Pass::FORWARD);
+    RenderStats::DrawIndexed(&context, 6);
+    RenderStats::BeginFrame();
+    CHECK(RenderStats::GetFrameTotal(RenderStats::Counter::DRAW_CALLS) == 1);
+
+    // The new frame starts in the update pass and the last frame stays readable
+    // until the next BeginFrame.
+    RenderStats::Add(RenderStats::Counter::BUFFER_BINDS, 4);
+    CHECK(RenderStats::Get(RenderStats::Pass::FORWARD,
+        RenderStats::Counter::DRAW_CALLS) == 1);
+    RenderStats::BeginFrame();
+    CHECK(RenderStats::GetFrameTotal(RenderStats::Counter::DRAW_CALLS) == 0);
+    CHECK(RenderStats::Get(RenderStats::Pass::UPDATE,
+        RenderStats::Counter::BUFFER_BINDS) == 4);
+    RenderStats::BeginFrame();
+    CHECK(RenderStats::GetFrameTotal(RenderStats::Counter::BUFFER_BINDS) == 0);
+    RenderStats::Reset();
+}
+
+
+TEST(RenderStats, CountsConcurrentIncrements) {
+    const unsigned int taskCnt = 8;
+    const unsigned int addCnt = 20000;
+    WorkerPool pool(3);
+    RenderStats::Reset();
+    RenderStats::BeginFrame();
+    RenderStats::SetPass(RenderStats::Pass::LIGHT_VIEW);
+    pool.Run(taskCnt, [&](unsigned int) {
+        MockContext context;
+        for (unsigned int i = 0; i < addCnt; i++) {
+            RenderStats::Add(RenderStats::Counter::SRV_BINDS);
+            RenderStats::Draw(&context, 3);
+        }
+    });
+    RenderStats::BeginFrame();
+
+    const RenderStats::Pass lightView = RenderStats::Pass::LIGHT_VIEW;
+    CHECK(RenderStats::Get(lightView, RenderStats::Counter::SRV_BINDS) ==
+        taskCnt * addCnt);
+    CHECK(RenderStats::Get(lightView, RenderStats::Counter::DRAW_CALLS) ==
+        taskCnt * addCnt);
+    CHECK(RenderStats::Get(lightView, RenderStats::Counter::PRIMITIVES) ==
+        taskCnt * addCnt);
+    RenderStats::Reset();
+}
+
+
+TEST(RenderStats, ExportsEveryFrameAsASample) {
+    MockContext context;
+    RenderStats::Reset();
+    BenchmarkStore::ResultSet empty;
+    RenderStats::AppendMetrics(empty);
+    CHECK(empty.metrics.empty());
+
+    // Frame i draws i times. The first frames fall out of the history.
+    const size_t frameCnt = RenderStats::HISTORY_FRAMES + 3;
+    for (size_t frame = 0; frame <= frameCnt; frame++) {
+        RenderStats::BeginFrame();
+        RenderStats::SetPass(RenderStats::Pass::GEOMETRY);
+        for (size_t i = 0; i < frame; i++) {
+            RenderStats::DrawIndexed(&context, 3);
+        }
+    }
+    CHECK(RenderStats::GetHistoryFrameCount() == RenderStats::HISTORY_FRAMES);
+
+    BenchmarkStore::ResultSet resultSet = Benchmark::CreateResultSet({});
+    const size_t metricCnt = static_cast<size_t>(RenderStats::Pass::COUNT) *
+        static_cast<size_t>(RenderStats::Counter::COUNT);
+    REQUIRE(resultSet.metrics.size() == metricCnt);
+    auto draws = std::find_if(resultSet.metrics.begin(), resultSet.metrics.end(),
+        [](const BenchmarkStore::Metric& metric) {
+            return metric.name == "Geometry Pass/Draws";
+        });
+    REQUIRE(draws != resultSet.metrics.end());
+    CHECK(draws->unit == "count");
+    REQUIRE(draws->samples.size() == RenderStats::HISTORY_FRAMES);
+    for (size_t i = 0; i < draws->samples.size(); i++) {
+        CHECK(draws->samples[i] == static_cast<double>(frameCnt -
+            RenderStats::HISTORY_FRAMES + i));
+    }
+    RenderStats::Reset();
+}
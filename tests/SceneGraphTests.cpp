@@ -0,0 +1,163 @@
+#include "Test.h"
+#include "SceneGraph.h"
+
+/// <summary>
+/// Builds a random depth-first hierarchy: every node hangs below the last node or
+/// one of its ancestors. Every other node gets a unit box.
+/// </summary>
+static void buildRandomGraph(SceneGraph& graph, UINT32 nodeCnt, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for (UINT32 node = 0; node < nodeCnt; node++) {
+        UINT32 parent = SceneGraph::NO_PARENT;
+        if (node > 0) {
+            // Walk up from the last node a random number of steps.
+            parent = node - 1;
+            for (UINT32 steps = generator() % 4; steps > 0 &&
+                    parent != SceneGraph::NO_PARENT; steps--) {
+                parent = graph.GetParent(parent);
+            }
+        }
+        sm::Matrix localMat = sm::Matrix::CreateRotationY(unit(generator)) *
+            sm::Matrix::CreateTranslation(unit(generator), unit(generator),
+                unit(generator));
+        graph.AddNode(parent, localMat, "node" + std::to_string(node));
+        if (node % 2 == 0) {
+            graph.SetLocalBounds(node, dx::BoundingBox(
+                sm::Vector3(unit(generator), 0.0f, 0.0f), sm::Vector3(0.5f)));
+        }
+    }
+}
+
+
+/// <summary>
+/// World matrix as the product of all local matrices up to the root.
+/// </summary>
+static sm::Matrix referenceWorldMatrix(const SceneGraph& graph, UINT32 node) {
+    sm::Matrix worldMat = graph.GetLocalMatrix(node);
+    for (UINT32 parent = graph.GetParent(node); parent != SceneGraph::NO_PARENT;
+            parent = graph.GetParent(parent)) {
+        worldMat = worldMat * graph.GetLocalMatrix(parent);
+    }
+    return worldMat;
+}
+
+
+/// <summary>
+/// Checks world matrices and subtree bounds of all nodes against brute force.
+/// </summary>
+static void checkAgainstReference(const SceneGraph& graph) {
+    for (UINT32 node = 0; node < graph.GetNodeCount(); node++) {
+        sm::Matrix expected = referenceWorldMatrix(graph, node);
+        const float* actualValues = &graph.GetWorldMatrix(node)._11;
+        const float* expectedValues = &expected._11;
+        for (int i = 0; i < 16; i++) {
+            CHECK_NEAR(actualValues[i], expectedValues[i], 1e-4f);
+        }
+
+        // The subtree bounds contain the bounds of every node of the subtree.
+        bool anyBounds = false;
+        for (UINT32 i = node; i < graph.GetSubtreeEnd(node); i++) {
+            if (!graph.HasBounds(i)) {
+                continue;
+            }
+            anyBounds = true;
+            dx::BoundingBox grown = graph.GetSubtreeBounds(node);
+            grown.Extents = sm::Vector3(grown.Extents) + sm::Vector3(1e-4f);
+            CHECK(grown.Contains(graph.GetWorldBounds(i)) == dx::CONTAINS);
+        }
+        CHECK(graph.HasSubtreeBounds(node) == anyBounds);
+    }
+}
+
+
+TEST(SceneGraph, SubtreesAreContiguous) {
+    SceneGraph graph;
+    buildRandomGraph(graph, 200, 1);
+    graph.Update();
+
+    for (UINT32 node = 0; node < graph.GetNodeCount(); node++) {
+        for (UINT32 i = node + 1; i < graph.GetNodeCount(); i++) {
+            // i is in the subtree, if node is one of its ancestors.
+            bool isDescendant = false;
+            for (UINT32 ancestor = graph.GetParent(i);
+                    ancestor != SceneGraph::NO_PARENT;
+                    ancestor = graph.GetParent(ancestor)) {
+                isDescendant |= ancestor == node;
+            }
+            CHECK(isDescendant == (i < graph.GetSubtreeEnd(node)));
+        }
+    }
+}
+
+
+TEST(SceneGraph, PropagatesMatricesAndBounds) {
+    SceneGraph graph;
+    buildRandomGraph(graph, 200, 2);
+    graph.Update();
+    CHECK(graph.GetLastUpdateCount() == 200);
+    checkAgainstReference(graph);
+}
+
+
+TEST(SceneGraph, UpdatesOnlyDirtySubtrees) {
+    SceneGraph graph;
+    buildRandomGraph(graph, 200, 3);
+    graph.Update();
+    std::vector<UINT32> versions;
+    for (UINT32 node = 0; node < graph.GetNodeCount(); node++) {
+        versions.push_back(graph.GetVersion(node));
+    }
+
+    // Nothing changed.
+    graph.Update();
+    CHECK(graph.GetLastUpdateCount() == 0);
+
+    // Move two nodes, one of them inside of the subtree of the other.
+    UINT32 outer = 0;
+    while (outer < graph.GetNodeCount() && graph.GetSubtreeEnd(outer) - outer < 5) {
+        outer++;
+    }
+    REQUIRE(outer < graph.GetNodeCount());
+    UINT32 inner = outer + 2;
+    graph.SetLocalMatrix(inner, sm::Matrix::CreateTranslation(0.0f, 3.0f, 0.0f));
+    graph.SetLocalMatrix(outer, sm::Matrix::CreateRotationX(0.7f));
+    graph.Update();
+
+    CHECK(graph.GetLastUpdateCount() == graph.GetSubtreeEnd(outer) - outer);
+    for (UINT32 node = 0; node < graph.GetNodeCount(); node++) {
+        bool moved = node >= outer && node < graph.GetSubtreeEnd(outer);
+        CHECK(graph.GetVersion(node) == versions[node] + (moved ? 1 : 0));
+    }
+    checkAgainstReference(graph);
+}
+
+
+TEST(SceneGraph, TracksIdentityWorldMatrices) {
+    SceneGraph graph;
+    UINT32 root = graph.AddNode(SceneGraph::NO_PARENT, sm::Matrix::Identity, "root");
+    UINT32 child = graph.AddNode(root, sm::Matrix::Identity, "child");
+    UINT32 moved = graph.AddNode(root, sm::Matrix::CreateTranslation(1.0f, 0.0f, 0.0f),
+        "moved");
+    graph.Update();
+    CHECK(graph.IsWorldIdentity(root));
+    CHECK(graph.IsWorldIdentity(child));
+    CHECK(!graph.IsWorldIdentity(moved));
+}
+
+
+TEST(SceneGraph, RejectsNodesOutOfDepthFirstOrder) {
+    SceneGraph graph;
+    UINT32 root = graph.AddNode(SceneGraph::NO_PARENT, sm::Matrix::Identity, "root");
+    UINT32 a = graph.AddNode(root, sm::Matrix::Identity, "a");
+    graph.AddNode(root, sm::Matrix::Identity, "b");
+
+    // a is no longer on the path to the last node.
+    bool thrown = false;
+    try {
+        graph.AddNode(a, sm::Matrix::Identity, "late child of a");
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
@@ -0,0 +1,101 @@
+#include "Test.h"
+#include "SceneMath.h"
+#include "shader/LightAttenuation.hlsli"
+
+/// <summary>
+/// Transforms a point into the clip space of a view projection matrix.
+/// </summary>
+static sm::Vector4 toClip(const sm::Vector3& point, const sm::Matrix& viewProj) {
+    return sm::Vector4::Transform(sm::Vector4(point.x, point.y, point.z, 1.0f),
+        viewProj);
+}
+
+
+TEST(SceneMath, ShadowFrustumCoversCameraAndCasters) {
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    const float tolerance = 1e-3f;
+    for (int view = 0; view < 20; view++) {
+        sm::Vector3 eye(unit(generator) * 100.0f, 10.0f + unit(generator) * 5.0f,
+            unit(generator) * 40.0f);
+        sm::Vector3 target = eye + sm::Vector3(unit(generator), unit(generator) * 0.3f,
+            unit(generator));
+        sm::Matrix viewMat = sm::Matrix::CreateLookAt(eye, target, sm::Vector3::UnitY);
+        sm::Matrix projMat = sm::Matrix::CreatePerspectiveFieldOfView(
+            dx::XM_PI / 3.0f, 16.0f / 9.0f, 0.5f, 80.0f);
+        sm::Vector3 lightPos(20.0f + unit(generator) * 10.0f, 100.0f,
+            unit(generator) * 30.0f);
+        dx::BoundingBox casterBounds(sm::Vector3(15.0f, 30.0f, 0.0f),
+            sm::Vector3(140.0f, 40.0f, 60.0f));
+
+        sm::Matrix lightViewMat;
+        sm::Matrix lightProjMat;
+        SceneMath::ComputeShadowMatrices(viewMat, projMat, lightPos, 80.0f,
+            casterBounds, lightViewMat, lightProjMat);
+        sm::Matrix lightViewProj = lightViewMat * lightProjMat;
+
+        // Every point of the camera frustum is inside of the shadow map.
+        sm::Matrix invViewProj = (viewMat * projMat).Invert();
+        for (int corner = 0; corner < 8; corner++) {
+            sm::Vector4 ndc(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f,
+                corner & 4 ? 1.0f : 0.0f, 1.0f);
+            sm::Vector4 world = sm::Vector4::Transform(ndc, invViewProj);
+            world /= world.w;
+            sm::Vector4 clip = toClip(sm::Vector3(world.x, world.y, world.z),
+                lightViewProj);
+            CHECK(fabsf(clip.x) <= 1.0f + tolerance);
+            CHECK(fabsf(clip.y) <= 1.0f + tolerance);
+            CHECK(clip.z >= -tolerance && clip.z <= 1.0f + tolerance);
+        }
+
+        // Casters between the light and the frustum are not clipped by the near
+        // plane.
+        sm::Vector3 casterCorners[8];
+        casterBounds.GetCorners(casterCorners);
+        for (const sm::Vector3& corner : casterCorners) {
+            CHECK(toClip(corner, lightViewProj).z >= -tolerance);
+        }
+    }
+}
+
+
+TEST(SceneMath, LightsEndAtTheCutoff) {
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < 200; i++) {
+        sm::Vector3 color(unit(generator), unit(generator), unit(generator));
+        float intensity = 0.1f + 4.0f * unit(generator);
+        float brightest = intensity * std::max(std::max(color.x, color.y), color.z);
+        float radius = SceneMath::ComputeLightRadius(color, intensity, LIGHT_CUTOFF);
+        REQUIRE(radius > 0.0f);
+
+        // Without the fade the light reaches the cutoff at its radius, and never
+        // exceeds it further out, where the fade drops it.
+        auto unfaded = [brightest](float dist) {
+            return brightest / (LIGHT_ATTENUATION_CONSTANT + LIGHT_ATTENUATION_LINEAR *
+                dist + LIGHT_ATTENUATION_QUADRATIC * dist * dist);
+        };
+        CHECK_NEAR(unfaded(radius), LIGHT_CUTOFF, 1e-5f);
+        for (float dist = radius; dist < 3.0f * radius; dist += 0.1f * radius) {
+            CHECK(unfaded(dist) <= LIGHT_CUTOFF * 1.0001f);
+            CHECK(SceneMath::ComputeLightAttenuation(dist, radius) == 0.0f);
+        }
+        CHECK(SceneMath::ComputeLightAttenuation(0.5f * radius, radius) > 0.0f);
+
+        // Dimmed lights keep the square root of the dimming of the radius, as the
+        // animation does, which still covers them.
+        for (float dimming : { 0.05f, 0.4f, 0.7f }) {
+            CHECK(SceneMath::ComputeLightRadius(color, intensity * dimming,
+                LIGHT_CUTOFF) <= std::sqrt(dimming) * radius * 1.0001f);
+        }
+    }
+    CHECK(SceneMath::ComputeLightRadius(sm::Vector3(0.01f), 1.0f, LIGHT_CUTOFF) ==
+        0.0f);
+
+    // The scale of the generated lights is the diameter.
+    for (const SceneMath::Light& light : SceneMath::GenerateLights(50, 3)) {
+        sm::Vector3 color(light.Color.x, light.Color.y, light.Color.z);
+        CHECK(light.Scale.x == 2.0f * SceneMath::ComputeLightRadius(color, 1.0f,
+            LIGHT_CUTOFF));
+    }
+}
@@ -0,0 +1,217 @@
+#include "Test.h"
+#include "TaskGraph.h"
+#include "WorkerPool.h"
+
+/// <summary>
+/// Records the order in which mock tasks finish.
+/// </summary>
+class TaskLog {
+public:
+    void Add(unsigned int task) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_order.push_back(task);
+    }
+
+    /// <summary>
+    /// Position of a task in the log, -1 if it never ran.
+    /// </summary>
+    int PositionOf(unsigned int task) const {
+        auto it = std::find(m_order.begin(), m_order.end(), task);
+        return it == m_order.end() ? -1 : static_cast<int>(it - m_order.begin());
+    }
+
+    size_t GetCount() const {
+        return m_order.size();
+    }
+
+    const std::vector<unsigned int>& GetOrder() const {
+        return m_order;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<unsigned int> m_order;
+};
+
+
+TEST(TaskGraph, RunsTasksAfterTheirDependencies) {
+    // Diamonds of mock tasks: 0 -> {1, 2} -> 3, repeated, each layer on the last.
+    for (unsigned int threadCount : { 1u, 2u, 4u, 0u }) {
+        TaskLog log;
+        TaskGraph graph;
+        std::vector<std::vector<unsigned int>> dependencies;
+        unsigned int last = graph.AddTask("root", [&log]() { log.Add(0); });
+        dependencies.push_back({});
+        for (unsigned int layer = 0; layer < 8; layer++) {
+            unsigned int id = static_cast<unsigned int>(dependencies.size());
+            for (unsigned int i = 0; i < 2; i++) {
+                graph.AddTask("side", [&log, id, i]() {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50 * i));
+                    log.Add(id + i);
+                }, { last });
+                dependencies.push_back({ last });
+            }
+            last = graph.AddTask("join", [&log, id]() { log.Add(id + 2); },
+                { id, id + 1 });
+            dependencies.push_back({ id, id + 1 });
+        }
+        graph.Run(threadCount);
+
+        REQUIRE(log.GetCount() == dependencies.size());
+        for (unsigned int task = 0; task < dependencies.size(); task++) {
+            for (unsigned int dependency : dependencies[task]) {
+                CHECK(log.PositionOf(dependency) < log.PositionOf(task));
+            }
+        }
+    }
+}
+
+
+TEST(TaskGraph, SingleThreadRunsInInsertionOrder) {
+    TaskLog log;
+    TaskGraph graph;
+    for (unsigned int i = 0; i < 16; i++) {
+        graph.AddTask("task", [&log, i]() { log.Add(i); });
+    }
+    graph.Run(1);
+
+    REQUIRE(log.GetCount() == 16);
+    for (unsigned int i = 0; i < 16; i++) {
+        CHECK(log.GetOrder()[i] == i);
+    }
+    for (const TaskGraph::TaskTiming& timing : graph.GetTimings()) {
+        CHECK(timing.threadIdx == 0);
+    }
+}
+
+
+TEST(TaskGraph, RejectsUnknownDependencies) {
+    TaskGraph graph;
+    unsigned int first = graph.AddTask("first", []() {});
+    bool thrown = false;
+    try {
+        graph.AddTask("second", []() {}, { first + 1 });
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+
+TEST(TaskGraph, ImmediateContextTasksNeverOverlap) {
+    std::atomic<int> active = 0;
+    std::atomic<int> maxActive = 0;
+    TaskGraph graph;
+    for (unsigned int i = 0; i < 16; i++) {
+        graph.AddTask("context", [&active, &maxActive]() {
+            int now = ++active;
+            int seen = maxActive;
+            while (now > seen && !maxActive.compare_exchange_weak(seen, now)) {}
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            active--;
+        }, {}, true);
+        graph.AddTask("free", []() {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        });
+    }
+    graph.Run(4);
+
+    CHECK(maxActive == 1);
+}
+
+
+TEST(TaskGraph, RethrowsTheFirstExceptionAndSkipsDependents) {
+    for (unsigned int threadCount : { 1u, 4u }) {
+        bool dependentRan = false;
+        TaskGraph graph;
+        unsigned int failing = graph.AddTask("failing", []() {
+            throw std::runtime_error("task failed");
+        });
+        graph.AddTask("dependent", [&dependentRan]() { dependentRan = true; },
+            { failing });
+
+        std::string message;
+        try {
+            graph.Run(threadCount);
+        } catch (const std::runtime_error& e) {
+            message = e.what();
+        }
+        CHECK(message == "task failed");
+        CHECK(!dependentRan);
+    }
+}
+
+
+TEST(TaskGraph, NestedGraphsShareTheWorkers) {
+    // Every outer task runs a graph of its own, as models do during scene loading.
+    std::atomic<unsigned int> innerCnt = 0;
+    TaskGraph outer;
+    for (unsigned int i = 0; i < 8; i++) {
+        outer.AddTask("outer", [&innerCnt]() {
+            TaskGraph inner;
+            for (unsigned int j = 0; j < 8; j++) {
+                inner.AddTask("inner", [&innerCnt]() { innerCnt++; });
+            }
+            inner.Run();
+        });
+    }
+    outer.Run();
+
+    CHECK(innerCnt == 64);
+}
+
+
+TEST(TaskGraph, WorkerPoolCallsEveryIndexOnce) {
+    // A pool of its own, so that workers run even on single core machines.
+    WorkerPool pool(3);
+    for (unsigned int count : { 1u, 3u, 4u, 64u }) {
+        std::vector<std::atomic<unsigned int>> calls(count);
+        std::thread::id callerId = std::this_thread::get_id();
+        std::thread::id firstId;
+        pool.Run(count, [&calls, &firstId](unsigned int idx) {
+            if (idx == 0) {
+                firstId = std::this_thread::get_id();
+            }
+            calls[idx]++;
+        });
+
+        for (unsigned int idx = 0; idx < count; idx++) {
+            CHECK(calls[idx] == 1);
+        }
+        CHECK(firstId == callerId);
+    }
+}
+
+
+TEST(TaskGraph, WorkerPoolRunsNestedCallsWithoutWaitingForBusyWorkers) {
+    WorkerPool pool(2);
+    std::atomic<unsigned int> innerCnt = 0;
+    pool.Run(8, [&pool, &innerCnt](unsigned int) {
+        pool.Run(8, [&innerCnt](unsigned int) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            innerCnt++;
+        });
+    });
+
+    CHECK(innerCnt == 64);
+}
+
+
+TEST(TaskGraph, WorkerPoolRethrowsAfterAllCallsReturned) {
+    WorkerPool pool(3);
+    std::atomic<unsigned int> doneCnt = 0;
+    bool thrown = false;
+    try {
+        pool.Run(8, [&doneCnt](unsigned int idx) {
+            if (idx == 3) {
+                throw std::runtime_error("call failed");
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            doneCnt++;
+        });
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(doneCnt == 7);
+}
@@ -0,0 +1,134 @@
+#include "Test.h"
+#include "Telemetry.h"
+#include "Platform.h"
+
+// Own ring, so a running application is not disturbed.
+static const char* TEST_MAPPING_NAME = "sponza_telemetry_test";
+
+/// <summary>
+/// Publishes a frame whose timings all derive from value, so a reader can tell a
+/// torn copy from a complete one.
+/// </summary>
+static void publishFrame(UINT64 value) {
+    float ms = static_cast<float>(value % 4096);
+    std::array<float, Telemetry::GPU_PASS_COUNT> passMs;
+    passMs.fill(ms);
+    Telemetry::SetGpuTimings(ms, passMs);
+    Telemetry::PublishFrame(ms);
+}
+
+
+/// <summary>
+/// Returns true if all timings of a frame belong to its frame index.
+/// </summary>
+static bool isConsistent(const Telemetry::Frame& frame) {
+    float ms = static_cast<float>(frame.frameIdx % 4096);
+    bool consistent = frame.cpuFrameMs == ms && frame.gpuFrameMs == ms;
+    for (float passMs : frame.gpuPassMs) {
+        consistent = consistent && passMs == ms;
+    }
+    return consistent;
+}
+
+
+/// <summary>
+/// Starts publishing into the test ring. Removes what a crashed run left behind.
+/// </summary>
+static void initializePublisher() {
+    Platform::RemoveSharedMemory(TEST_MAPPING_NAME);
+    REQUIRE(Telemetry::Initialize(TEST_MAPPING_NAME));
+}
+
+
+TEST(Telemetry, ReaderGetsEveryPublishedFrame) {
+    initializePublisher();
+    Telemetry::Reader reader;
+    REQUIRE(reader.Open(TEST_MAPPING_NAME));
+    CHECK(reader.IsPublisherAlive());
+
+    const UINT64 frameCnt = 40;
+    for (UINT64 i = 0; i < frameCnt; i++) {
+        publishFrame(i);
+    }
+
+    Telemetry::Frame frame;
+    for (UINT64 i = 0; i < frameCnt; i++) {
+        REQUIRE(reader.ReadNext(frame));
+        CHECK(frame.frameIdx == i);
+        CHECK(isConsistent(frame));
+    }
+    CHECK(!reader.ReadNext(frame));
+    CHECK(reader.GetLostFrameCount() == 0);
+
+    Telemetry::Shutdown();
+    CHECK(!reader.IsPublisherAlive());
+}
+
+
+TEST(Telemetry, ReaderSkipsOverwrittenFrames) {
+    initializePublisher();
+    Telemetry::Reader reader;
+    REQUIRE(reader.Open(TEST_MAPPING_NAME));
+
+    // The ring wraps around more than once.
+    const UINT64 frameCnt = 2 * Telemetry::SLOT_COUNT + 10;
+    for (UINT64 i = 0; i < frameCnt; i++) {
+        publishFrame(i);
+    }
+
+    Telemetry::Frame frame;
+    UINT64 expectedIdx = frameCnt - Telemetry::SLOT_COUNT;
+    while (reader.ReadNext(frame)) {
+        CHECK(frame.frameIdx == expectedIdx);
+        CHECK(isConsistent(frame));
+        expectedIdx++;
+    }
+    CHECK(expectedIdx == frameCnt);
+    CHECK(reader.GetLostFrameCount() == frameCnt - Telemetry::SLOT_COUNT);
+    Telemetry::Shutdown();
+}
+
+
+TEST(Telemetry, ReaderNeverReturnsTornFrames) {
+    initializePublisher();
+    Telemetry::Reader reader;
+    REQUIRE(reader.Open(TEST_MAPPING_NAME));
+
+    // The publisher laps the reader all the time, so slots get overwritten while
+    // they are being copied.
+    const UINT64 frameCnt = 200000;
+    std::atomic<bool> done{ false };
+    std::thread publisher([&]() {
+        for (UINT64 i = 0; i < frameCnt; i++) {
+            publishFrame(i);
+        }
+        done = true;
+    });
+
+    Telemetry::Frame frame;
+    UINT64 readCnt = 0;
+    UINT64 lastIdx = 0;
+    bool consistent = true;
+    bool ordered = true;
+    while (true) {
+        // Checked before reading, so the last frames are not missed.
+        bool finished = done;
+        if (!reader.ReadNext(frame)) {
+            if (finished) {
+                break;
+            }
+            continue;
+        }
+        consistent = consistent && isConsistent(frame);
+        ordered = ordered && (readCnt == 0 || frame.frameIdx > lastIdx);
+        lastIdx = frame.frameIdx;
+        readCnt++;
+    }
+    publisher.join();
+
+    CHECK(consistent);
+    CHECK(ordered);
+    CHECK(readCnt > 0);
+    CHECK(readCnt + reader.GetLostFrameCount() == frameCnt);
+    Telemetry::Shutdown();
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "stdafx.h"
+
+/// <summary>
+/// Minimal test registry of the portable cores. A test is a function registered
+/// with TEST(Suite, Name); CHECK records a failure and continues, REQUIRE stops the
+/// test.
+/// </summary>
+class Test {
+public:
+    typedef std::function<void()> Body;
+
+    /// <summary>
+    /// Thrown by REQUIRE to leave the test.
+    /// </summary>
+    struct Abort {};
+
+    /// <summary>
+    /// Registers a test. Called by TEST before main().
+    /// </summary>
+    static bool Register(const char* suite, const char* name, Body body);
+
+    /// <summary>
+    /// Records a failed check of the running test.
+    /// </summary>
+    static void Fail(const char* file, int line, const std::string& message);
+
+    /// <summary>
+    /// Runs all tests of a suite, or all tests if suite is empty.
+    /// </summary>
+    /// <returns>Number of failed tests.</returns>
+    static int Run(const std::string& suite);
+};
+
+#define TEST_CONCAT_(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_(a, b)
+
+#define TEST(suite, name) \
+    static void TEST_CONCAT(suite##_##name, _body)(); \
+    static const bool TEST_CONCAT(suite##_##name, _registered) = \
+        Test::Register(#suite, #name, TEST_CONCAT(suite##_##name, _body)); \
+    static void TEST_CONCAT(suite##_##name, _body)()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            Test::Fail(__FILE__, __LINE__, #condition); \
+        } \
+    } while (false)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        double testActual = (actual); \
+        double testExpected = (expected); \
+        if (!(std::fabs(testActual - testExpected) <= (tolerance))) { \
+            Test::Fail(__FILE__, __LINE__, std::string(#actual) + " = " + \
+                std::to_string(testActual) + ", expected " + \
+                std::to_string(testExpected)); \
+        } \
+    } while (false)
+
+#define REQUIRE(condition) \
+    do { \
+        if (!(condition)) { \
+            Test::Fail(__FILE__, __LINE__, #condition); \
+            throw Test::Abort(); \
+        } \
+    } while (false)
@@ -0,0 +1,76 @@
+#include "Test.h"
+
+/// <summary>
+/// A registered test.
+/// </summary>
+struct TestCase {
+    const char* suite;
+    const char* name;
+    Test::Body body;
+};
+
+/// <summary>
+/// All registered tests. A function so that registration from other translation
+/// units does not depend on initialization order.
+/// </summary>
+static std::vector<TestCase>& getTests() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+// Failed checks of the running test.
+static int s_failures = 0;
+
+
+/*
+ * Test::Register
+ */
+bool Test::Register(const char* suite, const char* name, Body body) {
+    getTests().push_back({ suite, name, body });
+    return true;
+}
+
+
+/*
+ * Test::Fail
+ */
+void Test::Fail(const char* file, int line, const std::string& message) {
+    std::cerr << file << "(" << line << "): check failed: " << message << std::endl;
+    s_failures++;
+}
+
+
+/*
+ * Test::Run
+ */
+int Test::Run(const std::string& suite) {
+    int failedTests = 0;
+    int testCnt = 0;
+    for (const TestCase& test : getTests()) {
+        if (!suite.empty() && suite != test.suite) {
+            continue;
+        }
+        testCnt++;
+        s_failures = 0;
+        try {
+            test.body();
+        } catch (const Test::Abort&) {
+        } catch (const std::exception& e) {
+            Fail(__FILE__, __LINE__, std::string("exception: ") + e.what());
+        }
+        std::cout << (s_failures == 0 ? "[  OK  ] " : "[FAILED] ") << test.suite
+            << "." << test.name << std::endl;
+        failedTests += s_failures != 0 ? 1 : 0;
+    }
+    std::cout << testCnt - failedTests << "/" << testCnt << " tests passed"
+        << std::endl;
+    return testCnt == 0 ? 1 : failedTests;
+}
+
+
+/// <summary>
+/// Runs the tests of the suite given as first argument, or all tests.
+/// </summary>
+int main(int argc, char* argv[]) {
+    return Test::Run(argc > 1 ? argv[1] : "") == 0 ? 0 : 1;
+}
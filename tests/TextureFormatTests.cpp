@@ -0,0 +1,59 @@
+#include "Test.h"
+#include "TextureFormat.h"
+
+TEST(TextureFormat, BitsPerPixel) {
+    CHECK(TextureFormat::BitsPerPixel(DXGI_FORMAT_R32G32B32A32_FLOAT) == 128);
+    CHECK(TextureFormat::BitsPerPixel(DXGI_FORMAT_R8G8B8A8_UNORM) == 32);
+    CHECK(TextureFormat::BitsPerPixel(DXGI_FORMAT_R8G8_UNORM) == 16);
+    CHECK(TextureFormat::BitsPerPixel(DXGI_FORMAT_R24G8_TYPELESS) == 32);
+    CHECK(TextureFormat::BitsPerPixel(DXGI_FORMAT_BC1_UNORM) == 4);
+    CHECK(TextureFormat::BitsPerPixel(DXGI_FORMAT_BC3_UNORM) == 8);
+    CHECK(TextureFormat::BitsPerPixel(DXGI_FORMAT_NV12) == 12);
+    CHECK(TextureFormat::BitsPerPixel(DXGI_FORMAT_R1_UNORM) == 1);
+    CHECK(TextureFormat::BitsPerPixel(DXGI_FORMAT_UNKNOWN) == 0);
+}
+
+
+TEST(TextureFormat, SurfaceSizeOfBlockCompressedFormats) {
+    // 4x4 blocks of 8 (BC1) or 16 (BC3) bytes, partial blocks count as full ones.
+    CHECK(TextureFormat::ComputeSurfaceSize(DXGI_FORMAT_BC1_UNORM, 256, 256) == 32768);
+    CHECK(TextureFormat::ComputeSurfaceSize(DXGI_FORMAT_BC3_UNORM, 256, 256) == 65536);
+    CHECK(TextureFormat::ComputeSurfaceSize(DXGI_FORMAT_BC1_UNORM, 1, 1) == 8);
+    CHECK(TextureFormat::ComputeSurfaceSize(DXGI_FORMAT_BC7_UNORM, 5, 3) == 32);
+}
+
+
+TEST(TextureFormat, SurfaceSizeOfPackedAndPlanarFormats) {
+    CHECK(TextureFormat::ComputeSurfaceSize(DXGI_FORMAT_R1_UNORM, 9, 2) == 4);
+    CHECK(TextureFormat::ComputeSurfaceSize(DXGI_FORMAT_YUY2, 3, 2) == 16);
+    // Full luma plane plus a half resolution chroma plane.
+    CHECK(TextureFormat::ComputeSurfaceSize(DXGI_FORMAT_NV12, 4, 4) == 24);
+}
+
+
+TEST(TextureFormat, TextureSizeWithMipChainArraysAndSamples) {
+    // 256x256 RGBA8 with full mip chain: 4/3 of the top level, 9 levels.
+    UINT64 top = 256 * 256 * 4;
+    UINT64 chain = 0;
+    for (UINT64 size = 256; size >= 1; size /= 2) {
+        chain += size * size * 4;
+    }
+    CHECK(TextureFormat::ComputeTextureSize(DXGI_FORMAT_R8G8B8A8_UNORM, 256, 256, 1,
+        0, 1, 1) == chain);
+    CHECK(TextureFormat::ComputeTextureSize(DXGI_FORMAT_R8G8B8A8_UNORM, 256, 256, 1,
+        1, 1, 1) == top);
+    // Cube map: 6 slices. MSAA: per sample.
+    CHECK(TextureFormat::ComputeTextureSize(DXGI_FORMAT_R8G8B8A8_UNORM, 256, 256, 1,
+        1, 6, 1) == 6 * top);
+    CHECK(TextureFormat::ComputeTextureSize(DXGI_FORMAT_R8G8B8A8_UNORM, 256, 256, 1,
+        1, 1, 4) == 4 * top);
+    // Non square chains continue until both sides are 1.
+    CHECK(TextureFormat::ComputeTextureSize(DXGI_FORMAT_R32_FLOAT, 4, 1, 1, 0, 1, 1)
+        == (4 + 2 + 1) * 4);
+    // Volume mips halve the depth too.
+    CHECK(TextureFormat::ComputeTextureSize(DXGI_FORMAT_R8_UNORM, 4, 4, 4, 0, 1, 1)
+        == 64 + 8 + 1);
+    // BC mips below 4x4 still take a full block.
+    CHECK(TextureFormat::ComputeTextureSize(DXGI_FORMAT_BC1_UNORM, 8, 8, 1, 0, 1, 1)
+        == 4 * 8 + 8 + 8 + 8);
+}
@@ -0,0 +1,278 @@
+#include "Test.h"
+#include "HiZCuller.h"
+#include "TiledLightCuller.h"
+
+// Screen size of the tests: 8 x 6 tiles.
+static const UINT32 WIDTH = 128;
+static const UINT32 HEIGHT = 96;
+// Pixels per side of a texel of the depth readback.
+static const UINT32 READBACK_SCALE = 4;
+
+/// <summary>
+/// Camera of the tests.
+/// </summary>
+struct Camera {
+    sm::Matrix viewMat;
+    sm::Matrix projMat;
+};
+
+
+/// <summary>
+/// Camera at eye looking at target with a 90 degree field of view.
+/// </summary>
+static Camera createCamera(const sm::Vector3& eye, const sm::Vector3& target) {
+    return { sm::Matrix::CreateLookAt(eye, target, sm::Vector3::UnitY),
+        sm::Matrix::CreatePerspectiveFieldOfView(dx::XM_PI / 2.0f,
+            float(WIDTH) / float(HEIGHT), 0.5f, 100.0f) };
+}
+
+
+/// <summary>
+/// A closed room of 30 x 6 x 45 with a wall across the view and a few pillars.
+/// </summary>
+static std::vector<dx::BoundingBox> createScene() {
+    std::vector<dx::BoundingBox> boxes = {
+        dx::BoundingBox(sm::Vector3(0.0f, -0.5f, 15.0f), sm::Vector3(16.0f, 0.5f, 26.0f)),
+        dx::BoundingBox(sm::Vector3(0.0f, 6.5f, 15.0f), sm::Vector3(16.0f, 0.5f, 26.0f)),
+        dx::BoundingBox(sm::Vector3(-15.5f, 3.0f, 15.0f), sm::Vector3(0.5f, 3.0f, 26.0f)),
+        dx::BoundingBox(sm::Vector3(15.5f, 3.0f, 15.0f), sm::Vector3(0.5f, 3.0f, 26.0f)),
+        dx::BoundingBox(sm::Vector3(0.0f, 3.0f, 40.5f), sm::Vector3(16.0f, 3.0f, 0.5f)),
+        dx::BoundingBox(sm::Vector3(0.0f, 3.0f, -10.5f), sm::Vector3(16.0f, 3.0f, 0.5f)),
+        dx::BoundingBox(sm::Vector3(0.0f, 3.0f, 10.0f), sm::Vector3(6.0f, 3.0f, 0.3f)) };
+    for (int pillar = 0; pillar < 6; pillar++) {
+        boxes.push_back(dx::BoundingBox(sm::Vector3(-10.0f + 4.0f * pillar, 3.0f,
+            4.0f + 5.0f * (pillar % 3)), sm::Vector3(0.4f, 3.0f, 0.4f)));
+    }
+    return boxes;
+}
+
+
+/// <summary>
+/// Casts a ray through the center of a pixel.
+/// </summary>
+/// <returns>False if the ray hits nothing.</returns>
+static bool castRay(const Camera& camera, const std::vector<dx::BoundingBox>& boxes,
+        UINT32 x, UINT32 y, sm::Vector3& hit) {
+    sm::Matrix invViewProj = (camera.viewMat * camera.projMat).Invert();
+    float ndcX = (x + 0.5f) * 2.0f / WIDTH - 1.0f;
+    float ndcY = 1.0f - (y + 0.5f) * 2.0f / HEIGHT;
+    sm::Vector3 origin = sm::Vector3::Transform(sm::Vector3(ndcX, ndcY, 0.0f),
+        invViewProj);
+    sm::Vector3 direction = sm::Vector3::Transform(sm::Vector3(ndcX, ndcY, 1.0f),
+        invViewProj) - origin;
+    direction.Normalize();
+    float nearest = FLT_MAX;
+    for (const dx::BoundingBox& box : boxes) {
+        float distance;
+        if (box.Intersects(origin, direction, distance)) {
+            nearest = std::min(nearest, distance);
+        }
+    }
+    hit = origin + direction * nearest;
+    return nearest < FLT_MAX;
+}
+
+
+/// <summary>
+/// Depth readback of a camera: the farthest depth of READBACK_SCALE^2 pixels, 1 where
+/// nothing was drawn.
+/// </summary>
+static std::vector<float> renderReadback(const Camera& camera,
+        const std::vector<dx::BoundingBox>& boxes) {
+    sm::Matrix viewProj = camera.viewMat * camera.projMat;
+    std::vector<float> depth((WIDTH / READBACK_SCALE) * (HEIGHT / READBACK_SCALE), 0.0f);
+    for (UINT32 y = 0; y < HEIGHT; y++) {
+        for (UINT32 x = 0; x < WIDTH; x++) {
+            sm::Vector3 hit;
+            float pixelDepth = 1.0f;
+            if (castRay(camera, boxes, x, y, hit)) {
+                sm::Vector4 clip = sm::Vector4::Transform(
+                    sm::Vector4(hit.x, hit.y, hit.z, 1.0f), viewProj);
+                pixelDepth = clip.z / clip.w;
+            }
+            float& texel = depth[(y / READBACK_SCALE) * (WIDTH / READBACK_SCALE) +
+                x / READBACK_SCALE];
+            texel = std::max(texel, pixelDepth);
+        }
+    }
+    return depth;
+}
+
+
+/// <summary>
+/// Random lights over the scene.
+/// </summary>
+static std::vector<sm::Vector4> generateLights(size_t count, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> x(-15.0f, 15.0f);
+    std::uniform_real_distribution<float> y(0.0f, 5.0f);
+    std::uniform_real_distribution<float> z(-5.0f, 30.0f);
+    std::uniform_real_distribution<float> radius(0.5f, 3.0f);
+    std::vector<sm::Vector4> lights(count);
+    for (sm::Vector4& light : lights) {
+        light = sm::Vector4(x(generator), y(generator), z(generator), radius(generator));
+    }
+    return lights;
+}
+
+
+/// <summary>
+/// Returns true if the list of a tile contains a light.
+/// </summary>
+static bool hasLight(const TiledLightCuller& culler, UINT32 tile, UINT32 lightIdx) {
+    const TiledLightCuller::TileRange& range = culler.GetTileRanges()[tile];
+    const UINT32* first = culler.GetLightIndices().data() + range.offset;
+    return std::binary_search(first, first + range.count, lightIdx);
+}
+
+
+/// <summary>
+/// Counts the misses of the culler against the surfaces a camera sees: a light
+/// that reaches the surface of a pixel has to be in the list of its tile.
+/// </summary>
+static UINT32 countMissedLights(const TiledLightCuller& culler, const Camera& camera,
+        const std::vector<dx::BoundingBox>& boxes,
+        const std::vector<sm::Vector4>& lights) {
+    UINT32 missCnt = 0;
+    for (UINT32 y = 0; y < HEIGHT; y++) {
+        for (UINT32 x = 0; x < WIDTH; x++) {
+            sm::Vector3 hit;
+            if (!castRay(camera, boxes, x, y, hit)) {
+                continue;
+            }
+            UINT32 tile = (y / TiledLightCuller::TILE_SIZE) * culler.GetTilesX() +
+                x / TiledLightCuller::TILE_SIZE;
+            for (UINT32 i = 0; i < lights.size(); i++) {
+                sm::Vector3 center(lights[i].x, lights[i].y, lights[i].z);
+                if (sm::Vector3::Distance(hit, center) <= lights[i].w &&
+                        !hasLight(culler, tile, i)) {
+                    missCnt++;
+                }
+            }
+        }
+    }
+    return missCnt;
+}
+
+
+TEST(TiledLightCuller, ReprojectedBoundsKeepLitSurfaces) {
+    // The readback is from the previous frame, the camera has moved since. It
+    // reveals surfaces behind the wall and the pillars, some in holes of the
+    // reprojection, some in texels that points of the edges landed in. Without the
+    // border of GetTileMaxDepth() the latter lose lights.
+    std::vector<dx::BoundingBox> boxes = createScene();
+    Camera previous = createCamera(sm::Vector3(0.0f, 2.0f, -5.0f),
+        sm::Vector3(0.0f, 2.0f, 10.0f));
+    Camera current = createCamera(sm::Vector3(0.4f, 2.1f, -5.0f),
+        sm::Vector3(-0.3f, 2.0f, 10.0f));
+    std::vector<float> readback = renderReadback(previous, boxes);
+
+    HiZCuller hiZCuller;
+    hiZCuller.SetDepth(readback.data(), WIDTH / READBACK_SCALE, HEIGHT / READBACK_SCALE,
+        (WIDTH / READBACK_SCALE) * sizeof(float), previous.viewMat * previous.projMat);
+    hiZCuller.Update(current.viewMat * current.projMat);
+    CHECK(hiZCuller.GetHoleCount() > 0);
+
+    TiledLightCuller culler;
+    culler.Resize(WIDTH, HEIGHT);
+    std::vector<float> maxDepth;
+    hiZCuller.GetTileMaxDepth(WIDTH, HEIGHT, TiledLightCuller::TILE_SIZE, maxDepth);
+    std::vector<float> minDepth(maxDepth.size(), 0.0f);
+    culler.SetDepthBounds(minDepth.data(), maxDepth.data(), culler.GetTilesX());
+    std::vector<sm::Vector4> lights = generateLights(400, 1);
+    culler.Cull(current.viewMat, current.projMat, lights);
+    CHECK(countMissedLights(culler, current, boxes, lights) == 0);
+
+    // The bounds have to cull something, otherwise the test proves nothing.
+    size_t boundedCnt = culler.GetLightIndices().size();
+    culler.ClearDepthBounds();
+    culler.Cull(current.viewMat, current.projMat, lights);
+    CHECK(boundedCnt < culler.GetLightIndices().size());
+}
+
+
+TEST(TiledLightCuller, WallCullsTheLightsBehindIt) {
+    // A wall at depth 10 fills the screen.
+    Camera camera = createCamera(sm::Vector3::Zero, sm::Vector3(0.0f, 0.0f, 1.0f));
+    sm::Vector4 clip = sm::Vector4::Transform(sm::Vector4(0.0f, 0.0f, 10.0f, 1.0f),
+        camera.viewMat * camera.projMat);
+    TiledLightCuller culler;
+    culler.Resize(WIDTH, HEIGHT);
+    std::vector<float> minDepth(culler.GetTilesX() * culler.GetTilesY(), 0.0f);
+    std::vector<float> maxDepth(minDepth.size(), clip.z / clip.w);
+    // A tile the reprojection left a hole in.
+    const UINT32 holeTile = 2 * culler.GetTilesX() + 3;
+    maxDepth[holeTile] = 1.0f;
+    culler.SetDepthBounds(minDepth.data(), maxDepth.data(), culler.GetTilesX());
+
+    // Tiny lights in front of, behind and through the wall, on the axis of the
+    // view, which lies on the corner of 4 tiles. And one behind the hole tile.
+    float holeX = ((3.5f * TiledLightCuller::TILE_SIZE) * 2.0f / WIDTH - 1.0f) *
+        float(WIDTH) / float(HEIGHT) * 20.0f;
+    float holeY = (1.0f - (2.5f * TiledLightCuller::TILE_SIZE) * 2.0f / HEIGHT) *
+        20.0f;
+    std::vector<sm::Vector4> lights = {
+        sm::Vector4(0.0f, 0.0f, 5.0f, 0.1f), sm::Vector4(0.0f, 0.0f, 20.0f, 0.1f),
+        sm::Vector4(0.0f, 0.0f, 10.5f, 1.0f), sm::Vector4(-holeX, holeY, 20.0f, 0.1f) };
+    culler.Cull(camera.viewMat, camera.projMat, lights);
+
+    UINT32 centerTile = (culler.GetTilesY() / 2) * culler.GetTilesX() +
+        culler.GetTilesX() / 2;
+    CHECK(hasLight(culler, centerTile, 0));
+    CHECK(!hasLight(culler, centerTile, 1));
+    CHECK(hasLight(culler, centerTile, 2));
+    CHECK(hasLight(culler, holeTile, 3));
+    CHECK(culler.GetVisibleLightCount() == 4);
+}
+
+
+TEST(TiledLightCuller, SseMatchesScalar) {
+    std::vector<dx::BoundingBox> boxes = createScene();
+    Camera camera = createCamera(sm::Vector3(1.0f, 2.0f, -4.0f),
+        sm::Vector3(0.0f, 2.0f, 10.0f));
+    std::vector<float> readback = renderReadback(camera, boxes);
+    HiZCuller hiZCuller;
+    hiZCuller.SetDepth(readback.data(), WIDTH / READBACK_SCALE, HEIGHT / READBACK_SCALE,
+        (WIDTH / READBACK_SCALE) * sizeof(float), camera.viewMat * camera.projMat);
+    hiZCuller.Update(camera.viewMat * camera.projMat);
+
+    // Not a multiple of 4, so the remainders run as well. Some lights surround
+    // the eye.
+    std::vector<sm::Vector4> lights = generateLights(1003, 2);
+    lights[7] = sm::Vector4(1.0f, 2.0f, -4.0f, 2.0f);
+    std::vector<UINT32> lightIds;
+    for (UINT32 i = 0; i < lights.size(); i += 3) {
+        lightIds.push_back(i);
+    }
+
+    TiledLightCuller scalar;
+    scalar.SetPath(TiledLightCuller::Path::SCALAR);
+    TiledLightCuller sse;
+    sse.SetPath(TiledLightCuller::Path::SSE);
+    std::vector<float> maxDepth;
+    hiZCuller.GetTileMaxDepth(WIDTH, HEIGHT, TiledLightCuller::TILE_SIZE, maxDepth);
+    std::vector<float> minDepth(maxDepth.size(), 0.0f);
+    for (TiledLightCuller* culler : { &scalar, &sse }) {
+        culler->SetThreadCount(3);
+        culler->Resize(WIDTH, HEIGHT);
+        culler->SetDepthBounds(minDepth.data(), maxDepth.data(), culler->GetTilesX());
+    }
+
+    for (bool useIds : { false, true }) {
+        for (TiledLightCuller* culler : { &scalar, &sse }) {
+            if (useIds) {
+                culler->Cull(camera.viewMat, camera.projMat, lights, lightIds);
+            } else {
+                culler->Cull(camera.viewMat, camera.projMat, lights);
+            }
+        }
+        CHECK(sse.GetVisibleLightCount() == scalar.GetVisibleLightCount());
+        CHECK(sse.GetLightIndices() == scalar.GetLightIndices());
+        REQUIRE(sse.GetTileRanges().size() == scalar.GetTileRanges().size());
+        for (size_t tile = 0; tile < sse.GetTileRanges().size(); tile++) {
+            const TiledLightCuller::TileRange& range = sse.GetTileRanges()[tile];
+            CHECK(range.offset == scalar.GetTileRanges()[tile].offset);
+            CHECK(range.count == scalar.GetTileRanges()[tile].count);
+        }
+    }
+}
@@ -0,0 +1,199 @@
+#include "Test.h"
+#include "TransformSystem.h"
+
+/// <summary>
+/// Random transforms with non-uniform rotations, scales from 0.1 to 10 and
+/// positions inside of a few hundred units.
+/// </summary>
+static std::vector<ModelState> generateStates(size_t count, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> logScale(-1.0f, 1.0f);
+    std::vector<ModelState> states(count);
+    for (ModelState& state : states) {
+        state = ModelState(powf(10.0f, logScale(generator)),
+            sm::Vector3(unit(generator), unit(generator), unit(generator)) * 300.0f,
+            sm::Vector4(unit(generator), unit(generator), unit(generator),
+                unit(generator)));
+    }
+    return states;
+}
+
+
+/// <summary>
+/// Checks that two matrices match up to a tolerance relative to their entries.
+/// </summary>
+static void checkMatrixNear(const sm::Matrix& actual, const sm::Matrix& expected,
+        float tolerance) {
+    const float* actualValues = &actual._11;
+    const float* expectedValues = &expected._11;
+    for (int i = 0; i < 16; i++) {
+        CHECK_NEAR(actualValues[i], expectedValues[i],
+            tolerance * (1.0f + fabsf(expectedValues[i])));
+    }
+}
+
+
+TEST(TransformSystem, ModelMatrixMatchesMatrixProducts) {
+    for (const ModelState& state : generateStates(256, 1)) {
+        sm::Matrix reference = sm::Matrix::CreateScale(state.scale)
+            * sm::Matrix::CreateFromQuaternion(state.orientation)
+            * sm::Matrix::CreateTranslation(state.position);
+        checkMatrixNear(TransformSystem::ComputeModelMatrix(state), reference, 1e-5f);
+    }
+}
+
+
+TEST(TransformSystem, NormalMatrixMatchesInverseTranspose) {
+    sm::Matrix viewMat = sm::Matrix::CreateLookAt(sm::Vector3(120.0f, 80.0f, -40.0f),
+        sm::Vector3(0.0f, 20.0f, 10.0f), sm::Vector3::UnitY);
+    for (const ModelState& state : generateStates(256, 2)) {
+        sm::Matrix modelMat = TransformSystem::ComputeModelMatrix(state);
+        checkMatrixNear(TransformSystem::ComputeNormalMatrix(modelMat, viewMat),
+            TransformSystem::ComputeNormalMatrixReference(modelMat, viewMat), 1e-4f);
+    }
+}
+
+
+TEST(TransformSystem, NormalMatrixKeepsNormalsPerpendicular) {
+    // A tangent and the normal of a surface stay perpendicular after transforming
+    // the tangent with the model view and the normal with the normal matrix.
+    sm::Matrix viewMat = sm::Matrix::CreateLookAt(sm::Vector3(0.0f, 50.0f, 100.0f),
+        sm::Vector3::Zero, sm::Vector3::UnitY);
+    ModelState state(3.0f, sm::Vector3(10.0f, 0.0f, 0.0f),
+        sm::Vector4(0.3f, -0.2f, 0.5f, 0.8f));
+    sm::Matrix modelMat = TransformSystem::ComputeModelMatrix(state);
+    sm::Matrix normalMat = TransformSystem::ComputeNormalMatrix(modelMat, viewMat);
+
+    sm::Vector3 normal(0.0f, 1.0f, 0.0f);
+    sm::Vector3 tangent(1.0f, 0.0f, 1.0f);
+    sm::Vector3 viewNormal = sm::Vector3::TransformNormal(normal, normalMat);
+    sm::Vector3 viewTangent = sm::Vector3::TransformNormal(tangent, modelMat * viewMat);
+    CHECK_NEAR(viewNormal.Dot(viewTangent), 0.0f, 1e-4f);
+}
+
+
+TEST(TransformSystem, Avx2MatchesScalar) {
+    if (!TransformSystem::IsAvx2Supported()) {
+        return;
+    }
+    // 8 transforms per batch plus a scalar remainder.
+    std::vector<ModelState> states = generateStates(203, 3);
+    sm::Matrix viewMat = sm::Matrix::CreateLookAt(sm::Vector3(-60.0f, 30.0f, 90.0f),
+        sm::Vector3(5.0f, 0.0f, -5.0f), sm::Vector3::UnitY);
+    TransformSystem scalar;
+    TransformSystem avx2;
+    scalar.SetUseAvx2(false);
+    avx2.SetUseAvx2(true);
+    REQUIRE(avx2.GetUseAvx2());
+    std::vector<TransformHandle> scalarHandles;
+    std::vector<TransformHandle> avx2Handles;
+    for (const ModelState& state : states) {
+        scalarHandles.push_back(scalar.Create(state));
+        avx2Handles.push_back(avx2.Create(state));
+    }
+    scalar.SetViewMatrix(viewMat);
+    avx2.SetViewMatrix(viewMat);
+    scalar.Update();
+    avx2.Update();
+
+    for (size_t i = 0; i < states.size(); i++) {
+        checkMatrixNear(avx2.GetModelMatrix(avx2Handles[i]),
+            scalar.GetModelMatrix(scalarHandles[i]), 1e-5f);
+        checkMatrixNear(avx2.GetNormalMatrix(avx2Handles[i]),
+            scalar.GetNormalMatrix(scalarHandles[i]), 1e-4f);
+    }
+}
+
+
+TEST(TransformSystem, RecomposesOnlyDirtyTransforms) {
+    TransformSystem transforms;
+    std::vector<ModelState> states = generateStates(20, 4);
+    std::vector<TransformHandle> handles;
+    for (const ModelState& state : states) {
+        handles.push_back(transforms.Create(state));
+    }
+    transforms.Update();
+    for (TransformHandle handle : handles) {
+        CHECK(transforms.GetVersion(handle) == 1);
+    }
+
+    // Same state again: nothing to do.
+    transforms.SetState(handles[3], states[3]);
+    transforms.SetState(handles[7], states[0]);
+    transforms.Update();
+    for (size_t i = 0; i < handles.size(); i++) {
+        CHECK(transforms.GetVersion(handles[i]) == (i == 7 ? 2u : 1u));
+    }
+    checkMatrixNear(transforms.GetModelMatrix(handles[7]),
+        TransformSystem::ComputeModelMatrix(states[0]), 1e-5f);
+
+    // A new view matrix changes every normal matrix.
+    transforms.SetViewMatrix(sm::Matrix::CreateRotationY(0.5f));
+    transforms.Update();
+    CHECK(transforms.GetVersion(handles[0]) == 2);
+    CHECK(transforms.GetVersion(handles[7]) == 3);
+}
+
+
+TEST(TransformSystem, DestroyKeepsOtherHandlesValid) {
+    TransformSystem transforms;
+    std::vector<ModelState> states = generateStates(10, 5);
+    std::vector<TransformHandle> handles;
+    for (const ModelState& state : states) {
+        handles.push_back(transforms.Create(state));
+    }
+    transforms.SetState(handles[9], states[2]);
+    transforms.Destroy(handles[4]);
+    transforms.Destroy(handles[0]);
+    transforms.Update();
+
+    CHECK(!transforms.IsValid(handles[4]));
+    CHECK(!transforms.IsValid(handles[0]));
+    CHECK(transforms.GetCount() == 8);
+    for (size_t i = 1; i < handles.size(); i++) {
+        if (i == 4) {
+            continue;
+        }
+        const ModelState& expected = i == 9 ? states[2] : states[i];
+        CHECK(transforms.GetState(handles[i]) == expected);
+        CHECK(transforms.GetVersion(handles[i]) == 1);
+        checkMatrixNear(transforms.GetModelMatrix(handles[i]),
+            TransformSystem::ComputeModelMatrix(expected), 1e-5f);
+    }
+
+    // The slot gets reused, the stale handle stays invalid.
+    TransformHandle reused = transforms.Create(states[4]);
+    CHECK(reused.slot == handles[0].slot || reused.slot == handles[4].slot);
+    CHECK(transforms.IsValid(reused));
+    CHECK(!transforms.IsValid(handles[0]));
+    CHECK(!transforms.IsValid(handles[4]));
+}
+
+
+TEST(TransformSystem, CreatesAndSetsStatesFromMultipleThreads) {
+    // As models do while the scene loads in parallel.
+    TransformSystem transforms;
+    std::vector<ModelState> states = generateStates(4 * 500, 6);
+    std::vector<TransformHandle> handles(states.size());
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < 4; thread++) {
+        threads.push_back(std::thread([&, thread]() {
+            for (size_t i = thread * 500; i < (thread + 1) * 500; i++) {
+                handles[i] = transforms.Create(ModelState());
+                transforms.SetState(handles[i], states[i]);
+            }
+        }));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    transforms.Update();
+
+    REQUIRE(transforms.GetCount() == states.size());
+    for (size_t i = 0; i < states.size(); i++) {
+        CHECK(transforms.GetState(handles[i]) == states[i]);
+        checkMatrixNear(transforms.GetModelMatrix(handles[i]),
+            TransformSystem::ComputeModelMatrix(states[i]), 1e-5f);
+    }
+}